@@ -0,0 +1,1678 @@
+#include "BlockDecoder.h"
+#include "MappedFile.h"
+#include "Profiler.h"
+#include "TextureCooker.h"
+#include "TexturePacker.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <emmintrin.h>
+#include <functional>
+
+using namespace DirectX::DDSLayout;
+
+namespace
+{
+    const uint32_t BandTexels = 16384;  // texels per task, at least one row of blocks
+    const uint32_t MaxMipLevels = 15;   // D3D11_REQ_MIP_LEVELS
+
+    enum class SourceKind : uint32_t
+    {
+        BC1,
+        BC2,
+        BC3,
+        BC4,
+        BC4Signed,
+        BC5,
+        BC5Signed,
+        BC6H,
+        BC6HSigned,
+        BC7,
+        Texels,         // one texel after another
+        TexelPairs      // two texels in four bytes: RGBG, GRGB and YUY2
+    };
+
+    struct FormatInfo
+    {
+        SourceKind kind;
+        uint32_t bytes;         // of a block, a texel or a pair
+        bool floatTexels;       // decoded through floats, the rest through RGBA8
+        bool srgb;
+        bool snorm;
+    };
+
+    bool GetFormatInfo(DXGI_FORMAT format, FormatInfo& info)
+    {
+        switch (format)
+        {
+        case DXGI_FORMAT_BC1_TYPELESS:
+        case DXGI_FORMAT_BC1_UNORM:             info = { SourceKind::BC1, 8, false, false, false }; return true;
+        case DXGI_FORMAT_BC1_UNORM_SRGB:        info = { SourceKind::BC1, 8, false, true, false }; return true;
+        case DXGI_FORMAT_BC2_TYPELESS:
+        case DXGI_FORMAT_BC2_UNORM:             info = { SourceKind::BC2, 16, false, false, false }; return true;
+        case DXGI_FORMAT_BC2_UNORM_SRGB:        info = { SourceKind::BC2, 16, false, true, false }; return true;
+        case DXGI_FORMAT_BC3_TYPELESS:
+        case DXGI_FORMAT_BC3_UNORM:             info = { SourceKind::BC3, 16, false, false, false }; return true;
+        case DXGI_FORMAT_BC3_UNORM_SRGB:        info = { SourceKind::BC3, 16, false, true, false }; return true;
+        case DXGI_FORMAT_BC4_TYPELESS:
+        case DXGI_FORMAT_BC4_UNORM:             info = { SourceKind::BC4, 8, false, false, false }; return true;
+        case DXGI_FORMAT_BC4_SNORM:             info = { SourceKind::BC4Signed, 8, true, false, true }; return true;
+        case DXGI_FORMAT_BC5_TYPELESS:
+        case DXGI_FORMAT_BC5_UNORM:             info = { SourceKind::BC5, 16, false, false, false }; return true;
+        case DXGI_FORMAT_BC5_SNORM:             info = { SourceKind::BC5Signed, 16, true, false, true }; return true;
+        case DXGI_FORMAT_BC6H_TYPELESS:
+        case DXGI_FORMAT_BC6H_UF16:             info = { SourceKind::BC6H, 16, true, false, false }; return true;
+        case DXGI_FORMAT_BC6H_SF16:             info = { SourceKind::BC6HSigned, 16, true, false, false }; return true;
+        case DXGI_FORMAT_BC7_TYPELESS:
+        case DXGI_FORMAT_BC7_UNORM:             info = { SourceKind::BC7, 16, false, false, false }; return true;
+        case DXGI_FORMAT_BC7_UNORM_SRGB:        info = { SourceKind::BC7, 16, false, true, false }; return true;
+
+        case DXGI_FORMAT_R8G8B8A8_TYPELESS:
+        case DXGI_FORMAT_R8G8B8A8_UNORM:
+        case DXGI_FORMAT_B8G8R8A8_UNORM:
+        case DXGI_FORMAT_B8G8R8X8_UNORM:        info = { SourceKind::Texels, 4, false, false, false }; return true;
+        case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+        case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+        case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:   info = { SourceKind::Texels, 4, false, true, false }; return true;
+        case DXGI_FORMAT_B5G6R5_UNORM:
+        case DXGI_FORMAT_B5G5R5A1_UNORM:
+        case DXGI_FORMAT_B4G4R4A4_UNORM:
+        case DXGI_FORMAT_R8G8_UNORM:            info = { SourceKind::Texels, 2, false, false, false }; return true;
+        case DXGI_FORMAT_R8_UNORM:
+        case DXGI_FORMAT_A8_UNORM:              info = { SourceKind::Texels, 1, false, false, false }; return true;
+        case DXGI_FORMAT_R10G10B10A2_UNORM:
+        case DXGI_FORMAT_R16G16_UNORM:
+        case DXGI_FORMAT_R16G16_FLOAT:
+        case DXGI_FORMAT_R32_FLOAT:             info = { SourceKind::Texels, 4, true, false, false }; return true;
+        case DXGI_FORMAT_R16_UNORM:
+        case DXGI_FORMAT_R16_FLOAT:             info = { SourceKind::Texels, 2, true, false, false }; return true;
+        case DXGI_FORMAT_R16G16B16A16_UNORM:
+        case DXGI_FORMAT_R16G16B16A16_FLOAT:
+        case DXGI_FORMAT_R32G32_FLOAT:          info = { SourceKind::Texels, 8, true, false, false }; return true;
+        case DXGI_FORMAT_R32G32B32A32_FLOAT:    info = { SourceKind::Texels, 16, true, false, false }; return true;
+        case DXGI_FORMAT_R8G8B8A8_SNORM:
+        case DXGI_FORMAT_R16G16_SNORM:          info = { SourceKind::Texels, 4, true, false, true }; return true;
+        case DXGI_FORMAT_R8G8_SNORM:            info = { SourceKind::Texels, 2, true, false, true }; return true;
+        case DXGI_FORMAT_R16G16B16A16_SNORM:    info = { SourceKind::Texels, 8, true, false, true }; return true;
+        case DXGI_FORMAT_R8G8_B8G8_UNORM:
+        case DXGI_FORMAT_G8R8_G8B8_UNORM:
+        case DXGI_FORMAT_YUY2:                  info = { SourceKind::TexelPairs, 4, false, false, false }; return true;
+        default:
+            return false;
+        }
+    }
+
+    bool IsBlockKind(SourceKind kind)
+    {
+        return kind < SourceKind::Texels;
+    }
+
+    void RunParallel(ThreadPool* pPool, uint32_t count, const std::function<void(uint32_t)>& task)
+    {
+        if (pPool)
+            pPool->ParallelFor(count, [&task](uint32_t index, uint32_t) { task(index); });
+        else
+        {
+            for (uint32_t i = 0; i < count; i++)
+                task(i);
+        }
+    }
+
+    uint16_t Read16(const uint8_t* p)
+    {
+        uint16_t value;
+        memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    uint32_t Read32(const uint8_t* p)
+    {
+        uint32_t value;
+        memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    uint64_t Read48(const uint8_t* p)
+    {
+        return static_cast<uint64_t>(Read16(p)) | (static_cast<uint64_t>(Read32(p + 2)) << 16);
+    }
+
+    float HalfToFloat(uint32_t half)
+    {
+        uint32_t sign = (half & 0x8000u) << 16;
+        uint32_t exponent = (half >> 10) & 0x1F;
+        uint32_t mantissa = half & 0x3FF;
+        uint32_t bits;
+        if (exponent == 0)
+        {
+            // Zero and denormals, exact in float
+            float value = mantissa * (1.0f / 16777216.0f);
+            return sign ? -value : value;
+        }
+        if (exponent == 31)
+            bits = sign | 0x7F800000u | (mantissa << 13);
+        else
+            bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    const float* SrgbToLinearTable()
+    {
+        static const std::vector<float> table = []()
+        {
+            std::vector<float> values(256);
+            for (uint32_t i = 0; i < 256; i++)
+            {
+                double value = i / 255.0;
+                values[i] = static_cast<float>(value <= 0.04045 ? value / 12.92 : pow((value + 0.055) / 1.055, 2.4));
+            }
+            return values;
+        }();
+        return table.data();
+    }
+
+    uint32_t Expand5(uint32_t value) { return (value << 3) | (value >> 2); }
+    uint32_t Expand6(uint32_t value) { return (value << 2) | (value >> 4); }
+
+    // 128 bits of a BC6H or BC7 block, read from the lowest bit up
+    struct BlockBits
+    {
+        uint64_t low;
+        uint64_t high;
+        uint32_t position;
+
+        explicit BlockBits(const uint8_t* pBlock) : position(0)
+        {
+            memcpy(&low, pBlock, sizeof(low));
+            memcpy(&high, pBlock + 8, sizeof(high));
+        }
+
+        // count up to 16
+        uint32_t Read(uint32_t count)
+        {
+            uint64_t bits;
+            if (position >= 64)
+                bits = high >> (position - 64);
+            else
+                bits = position ? (low >> position) | (high << (64 - position)) : low;
+            position += count;
+            return static_cast<uint32_t>(bits) & ((1u << count) - 1);
+        }
+    };
+
+    // BC6H and BC7 partitions of two subsets, a bit per texel set for the second subset.
+    // BC6H uses the first 32.
+    const uint16_t Partitions2[64] =
+    {
+        0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80, 0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+        0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE, 0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+        0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A, 0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+        0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C, 0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22
+    };
+
+    // BC7 partitions of three subsets, two bits per texel
+    const uint32_t Partitions3[64] =
+    {
+        0xA8685050, 0x6A5A5040, 0x5A5A4200, 0x5450A0A8, 0xA5A50000, 0xA0A05050, 0x5555A0A0, 0x5A5A5050,
+        0xAA550000, 0xAA555500, 0xAAAA5500, 0x90909090, 0x94949494, 0xA4A4A4A4, 0xA9A59450, 0x2A0A4250,
+        0xA5945040, 0x0A425054, 0xA5A5A500, 0x55A0A0A0, 0xA8A85454, 0x6A6A4040, 0xA4A45000, 0x1A1A0500,
+        0x0050A4A4, 0xAAA59090, 0x14696914, 0x69691400, 0xA08585A0, 0xAA821414, 0x50A4A450, 0x6A5A0200,
+        0xA9A58000, 0x5090A0A8, 0xA8A09050, 0x24242424, 0x00AA5500, 0x24924924, 0x24499224, 0x50A50A50,
+        0x500AA550, 0xAAAA4444, 0x66660000, 0xA5A0A5A0, 0x50A050A0, 0x69286928, 0x44AAAA44, 0x66666600,
+        0xAA444444, 0x54A854A8, 0x95809580, 0x96969600, 0xA85454A8, 0x80959580, 0xAA141414, 0x96960000,
+        0xAAAA1414, 0xA05050A0, 0xA0A5A5A0, 0x96000000, 0x40804080, 0xA9A8A9A8, 0xAAAAAA44, 0x2A4A5254
+    };
+
+    // Texel holding the one bit shorter index of the second subset, and of the third
+    const uint8_t Anchors2[64] =
+    {
+        15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+        15,  2,  8,  2,  2,  8,  8, 15,  2,  8,  2,  2,  8,  8,  2,  2,
+        15, 15,  6,  8,  2,  8, 15, 15,  2,  8,  2,  2,  2, 15, 15,  6,
+         6,  2,  6,  8, 15, 15,  2,  2, 15, 15, 15, 15, 15,  2,  2, 15
+    };
+
+    const uint8_t Anchors3Second[64] =
+    {
+         3,  3, 15, 15,  8,  3, 15, 15,  8,  8,  6,  6,  6,  5,  3,  3,
+         3,  3,  8, 15,  3,  3,  6, 10,  5,  8,  8,  6,  8,  5, 15, 15,
+         8, 15,  3,  5,  6, 10,  8, 15, 15,  3, 15,  5, 15, 15, 15, 15,
+         3, 15,  5,  5,  5,  8,  5, 10,  5, 10,  8, 13, 15, 12,  3,  3
+    };
+
+    const uint8_t Anchors3Third[64] =
+    {
+        15,  8,  8,  3, 15, 15,  3,  8, 15, 15, 15, 15, 15, 15, 15,  8,
+        15,  8, 15,  3, 15,  8, 15,  8,  3, 15,  6, 10, 15, 15, 10,  8,
+        15,  3, 15, 10, 10,  8,  9, 10,  6, 15,  8, 15,  3,  6,  6,  8,
+        15,  3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,  3, 15, 15,  8
+    };
+
+    // Interpolation weights of 2, 3 and 4 bit indices, out of 64
+    const uint16_t Weights2[4] = { 0, 21, 43, 64 };
+    const uint16_t Weights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+    const uint16_t Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    const uint16_t* GetWeights(uint32_t indexBits)
+    {
+        return indexBits == 2 ? Weights2 : indexBits == 3 ? Weights3 : Weights4;
+    }
+
+    // Lanes of the four blocks of a group; blocks past count read as zero
+    __m128i LoadLanes(const uint8_t* pBlocks, size_t stride, uint32_t count, uint32_t offset, uint32_t lanes[4])
+    {
+        for (uint32_t i = 0; i < 4; i++)
+            lanes[i] = i < count ? Read32(pBlocks + i * stride + offset) : 0;
+        return _mm_loadu_si128(reinterpret_cast<const __m128i*>(lanes));
+    }
+
+    __m128i Select(__m128i mask, __m128i a, __m128i b)
+    {
+        return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+    }
+
+    // Channels of 565 colours, one per lane, expanded to 8 bits
+    void Expand565(__m128i colors, __m128i& r, __m128i& g, __m128i& b)
+    {
+        __m128i mask5 = _mm_set1_epi32(0x1F);
+        __m128i mask6 = _mm_set1_epi32(0x3F);
+        r = _mm_and_si128(_mm_srli_epi32(colors, 11), mask5);
+        g = _mm_and_si128(_mm_srli_epi32(colors, 5), mask6);
+        b = _mm_and_si128(colors, mask5);
+        r = _mm_or_si128(_mm_slli_epi32(r, 3), _mm_srli_epi32(r, 2));
+        g = _mm_or_si128(_mm_slli_epi32(g, 2), _mm_srli_epi32(g, 4));
+        b = _mm_or_si128(_mm_slli_epi32(b, 3), _mm_srli_epi32(b, 2));
+    }
+
+    // round((2a + b) / 3): the sum stays below 2^16, where the product with 2^16 / 3 truncates exactly
+    __m128i Third(__m128i a, __m128i b)
+    {
+        __m128i sum = _mm_add_epi32(_mm_add_epi32(_mm_slli_epi32(a, 1), b), _mm_set1_epi32(1));
+        return _mm_mulhi_epu16(sum, _mm_set1_epi32(21846));
+    }
+
+    __m128i PackColor(__m128i r, __m128i g, __m128i b, __m128i a)
+    {
+        return _mm_or_si128(_mm_or_si128(r, _mm_slli_epi32(g, 8)), _mm_or_si128(_mm_slli_epi32(b, 16), _mm_slli_epi32(a, 24)));
+    }
+
+    // BC1 colour blocks, also the colour half of BC2 and BC3, which never punch through
+    void DecodeColorGroup(const uint8_t* pBlocks, size_t stride, uint32_t count, bool punchThrough, uint32_t texels[4][16])
+    {
+        alignas(16) uint32_t endpoints[4];
+        alignas(16) uint32_t indices[4];
+        __m128i colors = LoadLanes(pBlocks, stride, count, 0, endpoints);
+        LoadLanes(pBlocks, stride, count, 4, indices);
+
+        __m128i c0 = _mm_and_si128(colors, _mm_set1_epi32(0xFFFF));
+        __m128i c1 = _mm_srli_epi32(colors, 16);
+        __m128i r0, g0, b0, r1, g1, b1;
+        Expand565(c0, r0, g0, b0);
+        Expand565(c1, r1, g1, b1);
+
+        // Four colours when c0 > c1, else the midpoint and transparent black
+        __m128i opaque = _mm_set1_epi32(0xFF);
+        __m128i fourColors = punchThrough ? _mm_cmpgt_epi32(c0, c1) : _mm_set1_epi32(-1);
+        __m128i one = _mm_set1_epi32(1);
+        __m128i r2 = Select(fourColors, Third(r0, r1), _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(r0, r1), one), 1));
+        __m128i g2 = Select(fourColors, Third(g0, g1), _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(g0, g1), one), 1));
+        __m128i b2 = Select(fourColors, Third(b0, b1), _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(b0, b1), one), 1));
+        __m128i r3 = _mm_and_si128(fourColors, Third(r1, r0));
+        __m128i g3 = _mm_and_si128(fourColors, Third(g1, g0));
+        __m128i b3 = _mm_and_si128(fourColors, Third(b1, b0));
+
+        alignas(16) uint32_t palette[4][4];     // [entry][block]
+        _mm_store_si128(reinterpret_cast<__m128i*>(palette[0]), PackColor(r0, g0, b0, opaque));
+        _mm_store_si128(reinterpret_cast<__m128i*>(palette[1]), PackColor(r1, g1, b1, opaque));
+        _mm_store_si128(reinterpret_cast<__m128i*>(palette[2]), PackColor(r2, g2, b2, opaque));
+        _mm_store_si128(reinterpret_cast<__m128i*>(palette[3]), PackColor(r3, g3, b3, _mm_and_si128(fourColors, opaque)));
+
+        for (uint32_t block = 0; block < count; block++)
+        {
+            uint32_t bits = indices[block];
+            for (uint32_t i = 0; i < 16; i++, bits >>= 2)
+                texels[block][i] = palette[bits & 3][block];
+        }
+    }
+
+    // BC4 UNORM blocks: the alpha of BC3 and both channels of BC5, written to the byte at shift
+    void DecodeChannelGroup(const uint8_t* pBlocks, size_t stride, uint32_t count, uint32_t shift, uint32_t texels[4][16])
+    {
+        alignas(16) uint32_t endpoints[4];
+        __m128i bytes = LoadLanes(pBlocks, stride, count, 0, endpoints);
+        __m128i a0 = _mm_and_si128(bytes, _mm_set1_epi32(0xFF));
+        __m128i a1 = _mm_and_si128(_mm_srli_epi32(bytes, 8), _mm_set1_epi32(0xFF));
+
+        // Eight levels when a0 > a1, else six and the two ends of the range. Rounded division by
+        // 7 and 5 as products with 2^16 / 7 and 2^16 / 5, exact for sums below 2^11.
+        __m128i eightLevels = _mm_cmpgt_epi32(a0, a1);
+        alignas(16) uint32_t palette[8][4];     // [entry][block]
+        _mm_store_si128(reinterpret_cast<__m128i*>(palette[0]), a0);
+        _mm_store_si128(reinterpret_cast<__m128i*>(palette[1]), a1);
+        for (uint32_t i = 1; i < 7; i++)
+        {
+            __m128i sum7 = _mm_add_epi32(_mm_add_epi32(_mm_mullo_epi16(a0, _mm_set1_epi32(7 - i)), _mm_mullo_epi16(a1, _mm_set1_epi32(i))),
+                _mm_set1_epi32(3));
+            __m128i level7 = _mm_mulhi_epu16(sum7, _mm_set1_epi32(9363));
+            __m128i level5;
+            if (i < 5)
+            {
+                __m128i sum5 = _mm_add_epi32(_mm_add_epi32(_mm_mullo_epi16(a0, _mm_set1_epi32(5 - i)), _mm_mullo_epi16(a1, _mm_set1_epi32(i))),
+                    _mm_set1_epi32(2));
+                level5 = _mm_mulhi_epu16(sum5, _mm_set1_epi32(13108));
+            }
+            else
+                level5 = _mm_set1_epi32(i == 5 ? 0 : 255);
+            _mm_store_si128(reinterpret_cast<__m128i*>(palette[i + 1]), Select(eightLevels, level7, level5));
+        }
+
+        uint32_t keep = ~(0xFFu << shift);
+        for (uint32_t block = 0; block < count; block++)
+        {
+            uint64_t bits = Read48(pBlocks + block * stride + 2);
+            for (uint32_t i = 0; i < 16; i++, bits >>= 3)
+                texels[block][i] = (texels[block][i] & keep) | (palette[bits & 7][block] << shift);
+        }
+    }
+
+    // BC2 alpha: sixteen explicit 4 bit values
+    void DecodeExplicitAlpha(const uint8_t* pBlock, uint32_t texels[16])
+    {
+        uint64_t bits = static_cast<uint64_t>(Read32(pBlock)) | (static_cast<uint64_t>(Read32(pBlock + 4)) << 32);
+        for (uint32_t i = 0; i < 16; i++, bits >>= 4)
+            texels[i] = (texels[i] & 0x00FFFFFFu) | (static_cast<uint32_t>((bits & 0xF) * 17) << 24);
+    }
+
+    // BC4 SNORM block into one float channel; -128 reads as -127 like the hardware does
+    void DecodeSignedChannel(const uint8_t* pBlock, uint32_t channel, float texels[16][4])
+    {
+        int32_t e0 = std::max(static_cast<int32_t>(static_cast<int8_t>(pBlock[0])), -127);
+        int32_t e1 = std::max(static_cast<int32_t>(static_cast<int8_t>(pBlock[1])), -127);
+        float f0 = e0 / 127.0f;
+        float f1 = e1 / 127.0f;
+        float palette[8] = { f0, f1 };
+        if (e0 > e1)
+        {
+            for (uint32_t i = 1; i < 7; i++)
+                palette[i + 1] = (f0 * (7 - i) + f1 * i) / 7.0f;
+        }
+        else
+        {
+            for (uint32_t i = 1; i < 5; i++)
+                palette[i + 1] = (f0 * (5 - i) + f1 * i) / 5.0f;
+            palette[6] = -1.0f;
+            palette[7] = 1.0f;
+        }
+
+        uint64_t bits = Read48(pBlock + 2);
+        for (uint32_t i = 0; i < 16; i++, bits >>= 3)
+            texels[i][channel] = palette[bits & 7];
+    }
+
+    // count entries between two RGBA8 endpoints, two entries per register
+    void InterpolatePalette(const uint32_t e0[4], const uint32_t e1[4], uint32_t indexBits, uint32_t palette[16])
+    {
+        const uint16_t* weights = GetWeights(indexBits);
+        __m128i a = _mm_setr_epi16(static_cast<short>(e0[0]), static_cast<short>(e0[1]), static_cast<short>(e0[2]), static_cast<short>(e0[3]),
+            static_cast<short>(e0[0]), static_cast<short>(e0[1]), static_cast<short>(e0[2]), static_cast<short>(e0[3]));
+        __m128i b = _mm_setr_epi16(static_cast<short>(e1[0]), static_cast<short>(e1[1]), static_cast<short>(e1[2]), static_cast<short>(e1[3]),
+            static_cast<short>(e1[0]), static_cast<short>(e1[1]), static_cast<short>(e1[2]), static_cast<short>(e1[3]));
+        __m128i full = _mm_set1_epi16(64);
+        __m128i round = _mm_set1_epi16(32);
+        uint32_t count = 1u << indexBits;
+        for (uint32_t k = 0; k < count; k += 2)
+        {
+            __m128i w = _mm_unpacklo_epi64(_mm_set1_epi16(static_cast<short>(weights[k])), _mm_set1_epi16(static_cast<short>(weights[k + 1])));
+            __m128i sum = _mm_add_epi16(_mm_mullo_epi16(a, _mm_sub_epi16(full, w)), _mm_mullo_epi16(b, w));
+            __m128i value = _mm_srli_epi16(_mm_add_epi16(sum, round), 6);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(palette + k), _mm_packus_epi16(value, value));
+        }
+    }
+
+    struct Bc7Mode
+    {
+        uint8_t subsets;
+        uint8_t partitionBits;
+        uint8_t rotationBits;
+        uint8_t indexSelectionBits;
+        uint8_t colorBits;
+        uint8_t alphaBits;
+        uint8_t endpointPBits;      // a p-bit per endpoint
+        uint8_t sharedPBits;        // a p-bit per subset
+        uint8_t indexBits;
+        uint8_t indexBits2;         // the separate alpha indices of modes 4 and 5
+    };
+
+    const Bc7Mode Bc7Modes[8] =
+    {
+        { 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+        { 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+        { 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+        { 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+        { 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+        { 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+        { 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+        { 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 }
+    };
+
+    void DecodeBc7Block(const uint8_t* pBlock, uint32_t texels[16])
+    {
+        uint32_t mode = 0;
+        while (mode < 8 && !(pBlock[0] & (1u << mode)))
+            mode++;
+        if (mode == 8)
+        {
+            // Reserved: transparent black
+            memset(texels, 0, 16 * sizeof(uint32_t));
+            return;
+        }
+
+        const Bc7Mode& info = Bc7Modes[mode];
+        BlockBits bits(pBlock);
+        bits.position = mode + 1;
+        uint32_t partition = bits.Read(info.partitionBits);
+        uint32_t rotation = bits.Read(info.rotationBits);
+        uint32_t indexSelection = bits.Read(info.indexSelectionBits);
+
+        uint32_t endpoints[3][2][4] = {};      // [subset][endpoint][channel]
+        for (uint32_t c = 0; c < 3; c++)
+        {
+            for (uint32_t s = 0; s < info.subsets; s++)
+            {
+                endpoints[s][0][c] = bits.Read(info.colorBits);
+                endpoints[s][1][c] = bits.Read(info.colorBits);
+            }
+        }
+        if (info.alphaBits)
+        {
+            for (uint32_t s = 0; s < info.subsets; s++)
+            {
+                endpoints[s][0][3] = bits.Read(info.alphaBits);
+                endpoints[s][1][3] = bits.Read(info.alphaBits);
+            }
+        }
+
+        uint32_t pBits[3][2] = {};
+        uint32_t extraBits = 0;
+        if (info.endpointPBits)
+        {
+            for (uint32_t s = 0; s < info.subsets; s++)
+            {
+                pBits[s][0] = bits.Read(1);
+                pBits[s][1] = bits.Read(1);
+            }
+            extraBits = 1;
+        }
+        else if (info.sharedPBits)
+        {
+            for (uint32_t s = 0; s < info.subsets; s++)
+                pBits[s][0] = pBits[s][1] = bits.Read(1);
+            extraBits = 1;
+        }
+
+        // Below the p-bit, then the top bits repeated into the low ones
+        for (uint32_t s = 0; s < info.subsets; s++)
+        {
+            for (uint32_t e = 0; e < 2; e++)
+            {
+                for (uint32_t c = 0; c < 4; c++)
+                {
+                    uint32_t precision = (c < 3 ? info.colorBits : info.alphaBits);
+                    if (!precision)
+                    {
+                        endpoints[s][e][c] = 255;
+                        continue;
+                    }
+                    uint32_t value = (endpoints[s][e][c] << extraBits) | (extraBits ? pBits[s][e] : 0);
+                    precision += extraBits;
+                    value <<= 8 - precision;
+                    endpoints[s][e][c] = value | (value >> precision);
+                }
+            }
+        }
+
+        uint32_t anchor1 = info.subsets == 2 ? Anchors2[partition] : info.subsets == 3 ? Anchors3Second[partition] : 0;
+        uint32_t anchor2 = info.subsets == 3 ? Anchors3Third[partition] : 0;
+        uint32_t subsetOf = info.subsets == 2 ? Partitions2[partition] : info.subsets == 3 ? Partitions3[partition] : 0;
+        uint32_t subsetShift = info.subsets == 3 ? 2 : 1;
+        uint32_t subsetMask = info.subsets == 3 ? 3 : 1;
+
+        uint32_t colorIndices[16];
+        uint32_t alphaIndices[16];
+        for (uint32_t i = 0; i < 16; i++)
+        {
+            bool anchor = i == 0 || (info.subsets > 1 && (i == anchor1 || (info.subsets == 3 && i == anchor2)));
+            colorIndices[i] = bits.Read(info.indexBits - (anchor ? 1 : 0));
+        }
+        uint32_t colorIndexBits = info.indexBits;
+        uint32_t alphaIndexBits = info.indexBits;
+        if (info.indexBits2)
+        {
+            for (uint32_t i = 0; i < 16; i++)
+                alphaIndices[i] = bits.Read(info.indexBits2 - (i == 0 ? 1 : 0));
+            alphaIndexBits = info.indexBits2;
+            if (indexSelection)
+            {
+                std::swap(colorIndices, alphaIndices);
+                std::swap(colorIndexBits, alphaIndexBits);
+            }
+        }
+
+        alignas(16) uint32_t palettes[3][16];
+        for (uint32_t s = 0; s < info.subsets; s++)
+            InterpolatePalette(endpoints[s][0], endpoints[s][1], colorIndexBits, palettes[s]);
+
+        if (!info.indexBits2)
+        {
+            for (uint32_t i = 0; i < 16; i++)
+                texels[i] = palettes[(subsetOf >> (i * subsetShift)) & subsetMask][colorIndices[i]];
+        }
+        else
+        {
+            alignas(16) uint32_t alphaPalette[16];
+            InterpolatePalette(endpoints[0][0], endpoints[0][1], alphaIndexBits, alphaPalette);
+            for (uint32_t i = 0; i < 16; i++)
+                texels[i] = (palettes[0][colorIndices[i]] & 0x00FFFFFFu) | (alphaPalette[alphaIndices[i]] & 0xFF000000u);
+        }
+
+        // Rotation swaps alpha with red, green or blue after the interpolation
+        if (rotation)
+        {
+            uint32_t shift = 8 * (rotation - 1);
+            for (uint32_t i = 0; i < 16; i++)
+            {
+                uint32_t alpha = texels[i] >> 24;
+                uint32_t other = (texels[i] >> shift) & 0xFF;
+                texels[i] = (texels[i] & ~(0xFFu << shift) & 0x00FFFFFFu) | (alpha << shift) | (other << 24);
+            }
+        }
+    }
+
+    // One run of endpoint bits of a BC6H mode: endpoint (w, x, y, z for the two ends of the two
+    // subsets), channel, first bit and count
+    struct Bc6Field
+    {
+        uint8_t endpoint;
+        uint8_t channel;
+        uint8_t shift;
+        uint8_t bits;
+    };
+
+    struct Bc6Mode
+    {
+        uint8_t value;              // the 2 or 5 mode bits
+        uint8_t subsets;
+        uint8_t precision;          // of endpoint w
+        uint8_t deltaBits[3];       // of the other endpoints, per channel
+        bool transformed;           // the other endpoints are deltas from w
+        Bc6Field fields[24];        // in the order of the block, after the mode bits
+    };
+
+    // Field order from the BC6H format description, in its notation: rw is the red of w, 9:0 a run
+    // of bits from high to low as the block stores them low to high
+    const Bc6Mode Bc6Modes[14] =
+    {
+        // gy4 by4 bz4 rw9:0 gw9:0 bw9:0 rx4:0 gz4 gy3:0 gx4:0 bz0 gz3:0 bx4:0 bz1 by3:0 ry4:0 bz2 rz4:0 bz3
+        { 0x00, 2, 10, { 5, 5, 5 }, true,
+            { { 2, 1, 4, 1 }, { 2, 2, 4, 1 }, { 3, 2, 4, 1 }, { 0, 0, 0, 10 }, { 0, 1, 0, 10 }, { 0, 2, 0, 10 }, { 1, 0, 0, 5 }, { 3, 1, 4, 1 },
+              { 2, 1, 0, 4 }, { 1, 1, 0, 5 }, { 3, 2, 0, 1 }, { 3, 1, 0, 4 }, { 1, 2, 0, 5 }, { 3, 2, 1, 1 }, { 2, 2, 0, 4 }, { 2, 0, 0, 5 },
+              { 3, 2, 2, 1 }, { 3, 0, 0, 5 }, { 3, 2, 3, 1 } } },
+        // gy5 gz4 gz5 rw6:0 bz0 bz1 by4 gw6:0 by5 bz2 gy4 bw6:0 bz3 bz5 bz4 rx5:0 gy3:0 gx5:0 gz3:0 bx5:0 by3:0 ry5:0 rz5:0
+        { 0x01, 2, 7, { 6, 6, 6 }, true,
+            { { 2, 1, 5, 1 }, { 3, 1, 4, 1 }, { 3, 1, 5, 1 }, { 0, 0, 0, 7 }, { 3, 2, 0, 1 }, { 3, 2, 1, 1 }, { 2, 2, 4, 1 }, { 0, 1, 0, 7 },
+              { 2, 2, 5, 1 }, { 3, 2, 2, 1 }, { 2, 1, 4, 1 }, { 0, 2, 0, 7 }, { 3, 2, 3, 1 }, { 3, 2, 5, 1 }, { 3, 2, 4, 1 }, { 1, 0, 0, 6 },
+              { 2, 1, 0, 4 }, { 1, 1, 0, 6 }, { 3, 1, 0, 4 }, { 1, 2, 0, 6 }, { 2, 2, 0, 4 }, { 2, 0, 0, 6 }, { 3, 0, 0, 6 } } },
+        // rw9:0 gw9:0 bw9:0 rx4:0 rw10 gy3:0 gx3:0 gw10 bz0 gz3:0 bx3:0 bw10 bz1 by3:0 ry4:0 bz2 rz4:0 bz3
+        { 0x02, 2, 11, { 5, 4, 4 }, true,
+            { { 0, 0, 0, 10 }, { 0, 1, 0, 10 }, { 0, 2, 0, 10 }, { 1, 0, 0, 5 }, { 0, 0, 10, 1 }, { 2, 1, 0, 4 }, { 1, 1, 0, 4 }, { 0, 1, 10, 1 },
+              { 3, 2, 0, 1 }, { 3, 1, 0, 4 }, { 1, 2, 0, 4 }, { 0, 2, 10, 1 }, { 3, 2, 1, 1 }, { 2, 2, 0, 4 }, { 2, 0, 0, 5 }, { 3, 2, 2, 1 },
+              { 3, 0, 0, 5 }, { 3, 2, 3, 1 } } },
+        // rw9:0 gw9:0 bw9:0 rx3:0 rw10 gz4 gy3:0 gx4:0 gw10 gz3:0 bx3:0 bw10 bz1 by3:0 ry3:0 bz0 bz2 rz3:0 gy4 bz3
+        { 0x06, 2, 11, { 4, 5, 4 }, true,
+            { { 0, 0, 0, 10 }, { 0, 1, 0, 10 }, { 0, 2, 0, 10 }, { 1, 0, 0, 4 }, { 0, 0, 10, 1 }, { 3, 1, 4, 1 }, { 2, 1, 0, 4 }, { 1, 1, 0, 5 },
+              { 0, 1, 10, 1 }, { 3, 1, 0, 4 }, { 1, 2, 0, 4 }, { 0, 2, 10, 1 }, { 3, 2, 1, 1 }, { 2, 2, 0, 4 }, { 2, 0, 0, 4 }, { 3, 2, 0, 1 },
+              { 3, 2, 2, 1 }, { 3, 0, 0, 4 }, { 2, 1, 4, 1 }, { 3, 2, 3, 1 } } },
+        // rw9:0 gw9:0 bw9:0 rx3:0 rw10 by4 gy3:0 gx3:0 gw10 bz0 gz3:0 bx4:0 bw10 by3:0 ry3:0 bz1 bz2 rz3:0 bz4 bz3
+        { 0x0A, 2, 11, { 4, 4, 5 }, true,
+            { { 0, 0, 0, 10 }, { 0, 1, 0, 10 }, { 0, 2, 0, 10 }, { 1, 0, 0, 4 }, { 0, 0, 10, 1 }, { 2, 2, 4, 1 }, { 2, 1, 0, 4 }, { 1, 1, 0, 4 },
+              { 0, 1, 10, 1 }, { 3, 2, 0, 1 }, { 3, 1, 0, 4 }, { 1, 2, 0, 5 }, { 0, 2, 10, 1 }, { 2, 2, 0, 4 }, { 2, 0, 0, 4 }, { 3, 2, 1, 1 },
+              { 3, 2, 2, 1 }, { 3, 0, 0, 4 }, { 3, 2, 4, 1 }, { 3, 2, 3, 1 } } },
+        // rw8:0 by4 gw8:0 gy4 bw8:0 bz4 rx4:0 gz4 gy3:0 gx4:0 bz0 gz3:0 bx4:0 bz1 by3:0 ry4:0 bz2 rz4:0 bz3
+        { 0x0E, 2, 9, { 5, 5, 5 }, true,
+            { { 0, 0, 0, 9 }, { 2, 2, 4, 1 }, { 0, 1, 0, 9 }, { 2, 1, 4, 1 }, { 0, 2, 0, 9 }, { 3, 2, 4, 1 }, { 1, 0, 0, 5 }, { 3, 1, 4, 1 },
+              { 2, 1, 0, 4 }, { 1, 1, 0, 5 }, { 3, 2, 0, 1 }, { 3, 1, 0, 4 }, { 1, 2, 0, 5 }, { 3, 2, 1, 1 }, { 2, 2, 0, 4 }, { 2, 0, 0, 5 },
+              { 3, 2, 2, 1 }, { 3, 0, 0, 5 }, { 3, 2, 3, 1 } } },
+        // rw7:0 gz4 by4 gw7:0 bz2 gy4 bw7:0 bz3 bz4 rx5:0 gy3:0 gx4:0 bz0 gz3:0 bx4:0 bz1 by3:0 ry5:0 rz5:0
+        { 0x12, 2, 8, { 6, 5, 5 }, true,
+            { { 0, 0, 0, 8 }, { 3, 1, 4, 1 }, { 2, 2, 4, 1 }, { 0, 1, 0, 8 }, { 3, 2, 2, 1 }, { 2, 1, 4, 1 }, { 0, 2, 0, 8 }, { 3, 2, 3, 1 },
+              { 3, 2, 4, 1 }, { 1, 0, 0, 6 }, { 2, 1, 0, 4 }, { 1, 1, 0, 5 }, { 3, 2, 0, 1 }, { 3, 1, 0, 4 }, { 1, 2, 0, 5 }, { 3, 2, 1, 1 },
+              { 2, 2, 0, 4 }, { 2, 0, 0, 6 }, { 3, 0, 0, 6 } } },
+        // rw7:0 bz0 by4 gw7:0 gy5 gy4 bw7:0 gz5 bz4 rx4:0 gz4 gy3:0 gx5:0 gz3:0 bx4:0 bz1 by3:0 ry4:0 bz2 rz4:0 bz3
+        { 0x16, 2, 8, { 5, 6, 5 }, true,
+            { { 0, 0, 0, 8 }, { 3, 2, 0, 1 }, { 2, 2, 4, 1 }, { 0, 1, 0, 8 }, { 2, 1, 5, 1 }, { 2, 1, 4, 1 }, { 0, 2, 0, 8 }, { 3, 1, 5, 1 },
+              { 3, 2, 4, 1 }, { 1, 0, 0, 5 }, { 3, 1, 4, 1 }, { 2, 1, 0, 4 }, { 1, 1, 0, 6 }, { 3, 1, 0, 4 }, { 1, 2, 0, 5 }, { 3, 2, 1, 1 },
+              { 2, 2, 0, 4 }, { 2, 0, 0, 5 }, { 3, 2, 2, 1 }, { 3, 0, 0, 5 }, { 3, 2, 3, 1 } } },
+        // rw7:0 bz1 by4 gw7:0 by5 gy4 bw7:0 bz5 bz4 rx4:0 gz4 gy3:0 gx4:0 bz0 gz3:0 bx5:0 by3:0 ry4:0 bz2 rz4:0 bz3
+        { 0x1A, 2, 8, { 5, 5, 6 }, true,
+            { { 0, 0, 0, 8 }, { 3, 2, 1, 1 }, { 2, 2, 4, 1 }, { 0, 1, 0, 8 }, { 2, 2, 5, 1 }, { 2, 1, 4, 1 }, { 0, 2, 0, 8 }, { 3, 2, 5, 1 },
+              { 3, 2, 4, 1 }, { 1, 0, 0, 5 }, { 3, 1, 4, 1 }, { 2, 1, 0, 4 }, { 1, 1, 0, 5 }, { 3, 2, 0, 1 }, { 3, 1, 0, 4 }, { 1, 2, 0, 6 },
+              { 2, 2, 0, 4 }, { 2, 0, 0, 5 }, { 3, 2, 2, 1 }, { 3, 0, 0, 5 }, { 3, 2, 3, 1 } } },
+        // rw5:0 gz4 bz0 bz1 by4 gw5:0 gy5 by5 bz2 gy4 bw5:0 gz5 bz3 bz5 bz4 rx5:0 gy3:0 gx5:0 gz3:0 bx5:0 by3:0 ry5:0 rz5:0
+        { 0x1E, 2, 6, { 6, 6, 6 }, false,
+            { { 0, 0, 0, 6 }, { 3, 1, 4, 1 }, { 3, 2, 0, 1 }, { 3, 2, 1, 1 }, { 2, 2, 4, 1 }, { 0, 1, 0, 6 }, { 2, 1, 5, 1 }, { 2, 2, 5, 1 },
+              { 3, 2, 2, 1 }, { 2, 1, 4, 1 }, { 0, 2, 0, 6 }, { 3, 1, 5, 1 }, { 3, 2, 3, 1 }, { 3, 2, 5, 1 }, { 3, 2, 4, 1 }, { 1, 0, 0, 6 },
+              { 2, 1, 0, 4 }, { 1, 1, 0, 6 }, { 3, 1, 0, 4 }, { 1, 2, 0, 6 }, { 2, 2, 0, 4 }, { 2, 0, 0, 6 }, { 3, 0, 0, 6 } } },
+        // rw9:0 gw9:0 bw9:0 rx9:0 gx9:0 bx9:0
+        { 0x03, 1, 10, { 10, 10, 10 }, false,
+            { { 0, 0, 0, 10 }, { 0, 1, 0, 10 }, { 0, 2, 0, 10 }, { 1, 0, 0, 10 }, { 1, 1, 0, 10 }, { 1, 2, 0, 10 } } },
+        // rw9:0 gw9:0 bw9:0 rx8:0 rw10 gx8:0 gw10 bx8:0 bw10
+        { 0x07, 1, 11, { 9, 9, 9 }, true,
+            { { 0, 0, 0, 10 }, { 0, 1, 0, 10 }, { 0, 2, 0, 10 }, { 1, 0, 0, 9 }, { 0, 0, 10, 1 }, { 1, 1, 0, 9 }, { 0, 1, 10, 1 }, { 1, 2, 0, 9 },
+              { 0, 2, 10, 1 } } },
+        // rw9:0 gw9:0 bw9:0 rx7:0 rw11 rw10 gx7:0 gw11 gw10 bx7:0 bw11 bw10
+        { 0x0B, 1, 12, { 8, 8, 8 }, true,
+            { { 0, 0, 0, 10 }, { 0, 1, 0, 10 }, { 0, 2, 0, 10 }, { 1, 0, 0, 8 }, { 0, 0, 11, 1 }, { 0, 0, 10, 1 }, { 1, 1, 0, 8 }, { 0, 1, 11, 1 },
+              { 0, 1, 10, 1 }, { 1, 2, 0, 8 }, { 0, 2, 11, 1 }, { 0, 2, 10, 1 } } },
+        // rw9:0 gw9:0 bw9:0 rx3:0 rw15 rw14 rw13 rw12 rw11 rw10 gx3:0 gw15 gw14 gw13 gw12 gw11 gw10 bx3:0 bw15 bw14 bw13 bw12 bw11 bw10
+        { 0x0F, 1, 16, { 4, 4, 4 }, true,
+            { { 0, 0, 0, 10 }, { 0, 1, 0, 10 }, { 0, 2, 0, 10 }, { 1, 0, 0, 4 }, { 0, 0, 15, 1 }, { 0, 0, 14, 1 }, { 0, 0, 13, 1 }, { 0, 0, 12, 1 },
+              { 0, 0, 11, 1 }, { 0, 0, 10, 1 }, { 1, 1, 0, 4 }, { 0, 1, 15, 1 }, { 0, 1, 14, 1 }, { 0, 1, 13, 1 }, { 0, 1, 12, 1 }, { 0, 1, 11, 1 },
+              { 0, 1, 10, 1 }, { 1, 2, 0, 4 }, { 0, 2, 15, 1 }, { 0, 2, 14, 1 }, { 0, 2, 13, 1 }, { 0, 2, 12, 1 }, { 0, 2, 11, 1 }, { 0, 2, 10, 1 } } },
+    };
+
+    // Mode of the five mode bits, for the modes whose low two bits are 10 or 11; -1 is reserved
+    int32_t Bc6ModeIndex(uint32_t value)
+    {
+        if (value < 2)
+            return static_cast<int32_t>(value);
+        for (uint32_t i = 2; i < 14; i++)
+        {
+            if (Bc6Modes[i].value == value)
+                return static_cast<int32_t>(i);
+        }
+        return -1;
+    }
+
+    int32_t SignExtend(int32_t value, uint32_t bits)
+    {
+        uint32_t shift = 32 - bits;
+        return static_cast<int32_t>(static_cast<uint32_t>(value) << shift) >> shift;
+    }
+
+    // Endpoint to the 16 bit range the interpolation works in
+    int32_t Unquantize(int32_t value, uint32_t bits, bool isSigned)
+    {
+        if (!isSigned)
+        {
+            if (bits >= 15 || value == 0)
+                return value;
+            if (value == (1 << bits) - 1)
+                return 0xFFFF;
+            return ((value << 16) + 0x8000) >> bits;
+        }
+
+        if (bits >= 16)
+            return value;
+        bool negative = value < 0;
+        int32_t magnitude = negative ? -value : value;
+        int32_t result;
+        if (magnitude == 0)
+            result = 0;
+        else if (magnitude >= (1 << (bits - 1)) - 1)
+            result = 0x7FFF;
+        else
+            result = ((magnitude << 15) + 0x4000) >> (bits - 1);
+        return negative ? -result : result;
+    }
+
+    // Interpolated value to the bits of a half
+    float FinishUnquantize(int32_t value, bool isSigned)
+    {
+        if (!isSigned)
+            return HalfToFloat(static_cast<uint32_t>((value * 31) >> 6));
+        uint32_t half = value < 0 ? 0x8000u | static_cast<uint32_t>(((-value) * 31) >> 5) : static_cast<uint32_t>((value * 31) >> 5);
+        return HalfToFloat(half);
+    }
+
+    void DecodeBc6hBlock(const uint8_t* pBlock, bool isSigned, float texels[16][4])
+    {
+        BlockBits bits(pBlock);
+        uint32_t modeValue = bits.Read(2);
+        if (modeValue >= 2)
+            modeValue |= bits.Read(3) << 2;
+        int32_t modeIndex = Bc6ModeIndex(modeValue);
+        if (modeIndex < 0)
+        {
+            // Reserved modes decode to black
+            for (uint32_t i = 0; i < 16; i++)
+            {
+                texels[i][0] = texels[i][1] = texels[i][2] = 0.0f;
+                texels[i][3] = 1.0f;
+            }
+            return;
+        }
+
+        const Bc6Mode& mode = Bc6Modes[modeIndex];
+        int32_t endpoints[4][3] = {};
+        for (const Bc6Field& field : mode.fields)
+        {
+            if (!field.bits)
+                break;
+            endpoints[field.endpoint][field.channel] |= static_cast<int32_t>(bits.Read(field.bits) << field.shift);
+        }
+        uint32_t partition = mode.subsets == 2 ? bits.Read(5) : 0;
+
+        uint32_t endpointCount = mode.subsets * 2;
+        int32_t precisionMask = (1 << mode.precision) - 1;
+        for (uint32_t c = 0; c < 3; c++)
+        {
+            if (isSigned)
+                endpoints[0][c] = SignExtend(endpoints[0][c], mode.precision);
+            for (uint32_t e = 1; e < endpointCount; e++)
+            {
+                if (isSigned || mode.transformed)
+                    endpoints[e][c] = SignExtend(endpoints[e][c], mode.deltaBits[c]);
+                if (mode.transformed)
+                {
+                    endpoints[e][c] = (endpoints[0][c] + endpoints[e][c]) & precisionMask;
+                    if (isSigned)
+                        endpoints[e][c] = SignExtend(endpoints[e][c], mode.precision);
+                }
+            }
+        }
+        for (uint32_t e = 0; e < endpointCount; e++)
+        {
+            for (uint32_t c = 0; c < 3; c++)
+                endpoints[e][c] = Unquantize(endpoints[e][c], mode.precision, isSigned);
+        }
+
+        // Palettes per subset, so the half conversion runs once per entry and not per texel
+        uint32_t indexBits = mode.subsets == 2 ? 3 : 4;
+        const uint16_t* weights = GetWeights(indexBits);
+        float palettes[2][16][3];
+        for (uint32_t s = 0; s < mode.subsets; s++)
+        {
+            for (uint32_t k = 0; k < (1u << indexBits); k++)
+            {
+                int32_t w = weights[k];
+                for (uint32_t c = 0; c < 3; c++)
+                {
+                    int32_t value = (endpoints[2 * s][c] * (64 - w) + endpoints[2 * s + 1][c] * w + 32) >> 6;
+                    palettes[s][k][c] = FinishUnquantize(value, isSigned);
+                }
+            }
+        }
+
+        uint32_t subsetOf = mode.subsets == 2 ? Partitions2[partition] : 0;
+        uint32_t anchor = mode.subsets == 2 ? Anchors2[partition] : 0;
+        for (uint32_t i = 0; i < 16; i++)
+        {
+            bool isAnchor = i == 0 || (mode.subsets == 2 && i == anchor);
+            uint32_t index = bits.Read(indexBits - (isAnchor ? 1 : 0));
+            const float* entry = palettes[(subsetOf >> i) & 1][index];
+            texels[i][0] = entry[0];
+            texels[i][1] = entry[1];
+            texels[i][2] = entry[2];
+            texels[i][3] = 1.0f;
+        }
+    }
+
+    // Up to four blocks of a row that decode to RGBA8
+    void DecodeLdrGroup(SourceKind kind, const uint8_t* pBlocks, size_t stride, uint32_t count, uint32_t texels[4][16])
+    {
+        switch (kind)
+        {
+        case SourceKind::BC1:
+            DecodeColorGroup(pBlocks, stride, count, true, texels);
+            break;
+        case SourceKind::BC2:
+            DecodeColorGroup(pBlocks + 8, stride, count, false, texels);
+            for (uint32_t i = 0; i < count; i++)
+                DecodeExplicitAlpha(pBlocks + i * stride, texels[i]);
+            break;
+        case SourceKind::BC3:
+            DecodeColorGroup(pBlocks + 8, stride, count, false, texels);
+            DecodeChannelGroup(pBlocks, stride, count, 24, texels);
+            break;
+        case SourceKind::BC4:
+        case SourceKind::BC5:
+            // Green and blue 0, alpha 1, as the GPU returns them
+            for (uint32_t i = 0; i < count; i++)
+            {
+                for (uint32_t t = 0; t < 16; t++)
+                    texels[i][t] = 0xFF000000u;
+            }
+            DecodeChannelGroup(pBlocks, stride, count, 0, texels);
+            if (kind == SourceKind::BC5)
+                DecodeChannelGroup(pBlocks + 8, stride, count, 8, texels);
+            break;
+        default:
+            for (uint32_t i = 0; i < count; i++)
+                DecodeBc7Block(pBlocks + i * stride, texels[i]);
+            break;
+        }
+    }
+
+    // The same for blocks that decode to floats
+    void DecodeFloatGroup(SourceKind kind, const uint8_t* pBlocks, size_t stride, uint32_t count, float texels[4][16][4])
+    {
+        for (uint32_t i = 0; i < count; i++)
+        {
+            const uint8_t* pBlock = pBlocks + i * stride;
+            if (kind == SourceKind::BC6H || kind == SourceKind::BC6HSigned)
+            {
+                DecodeBc6hBlock(pBlock, kind == SourceKind::BC6HSigned, texels[i]);
+                continue;
+            }
+            for (uint32_t t = 0; t < 16; t++)
+            {
+                texels[i][t][1] = texels[i][t][2] = 0.0f;
+                texels[i][t][3] = 1.0f;
+            }
+            DecodeSignedChannel(pBlock, 0, texels[i]);
+            if (kind == SourceKind::BC5Signed)
+                DecodeSignedChannel(pBlock + 8, 1, texels[i]);
+        }
+    }
+
+    uint32_t SwapRedBlue(uint32_t texel)
+    {
+        return (texel & 0xFF00FF00u) | ((texel >> 16) & 0xFF) | ((texel & 0xFF) << 16);
+    }
+
+    float Snorm8(uint8_t value)
+    {
+        return std::max(static_cast<int8_t>(value) / 127.0f, -1.0f);
+    }
+
+    float Snorm16(uint16_t value)
+    {
+        return std::max(static_cast<int16_t>(value) / 32767.0f, -1.0f);
+    }
+
+    // A row of a format that is not block compressed: RGBA8 into ldr, the rest into hdr with
+    // missing channels 0 and missing alpha 1
+    void DecodeTexelRow(DXGI_FORMAT format, const uint8_t* pSource, uint32_t width, uint32_t* ldr, float* hdr)
+    {
+        if (hdr)
+        {
+            for (uint32_t x = 0; x < width; x++)
+            {
+                hdr[x * 4 + 0] = hdr[x * 4 + 1] = hdr[x * 4 + 2] = 0.0f;
+                hdr[x * 4 + 3] = 1.0f;
+            }
+        }
+
+        switch (format)
+        {
+        case DXGI_FORMAT_R8G8B8A8_TYPELESS:
+        case DXGI_FORMAT_R8G8B8A8_UNORM:
+        case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+            memcpy(ldr, pSource, width * sizeof(uint32_t));
+            break;
+        case DXGI_FORMAT_B8G8R8A8_UNORM:
+        case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+            for (uint32_t x = 0; x < width; x++)
+                ldr[x] = SwapRedBlue(Read32(pSource + x * 4));
+            break;
+        case DXGI_FORMAT_B8G8R8X8_UNORM:
+        case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
+            for (uint32_t x = 0; x < width; x++)
+                ldr[x] = SwapRedBlue(Read32(pSource + x * 4)) | 0xFF000000u;
+            break;
+        case DXGI_FORMAT_B5G6R5_UNORM:
+            for (uint32_t x = 0; x < width; x++)
+            {
+                uint32_t value = Read16(pSource + x * 2);
+                ldr[x] = Expand5(value >> 11) | (Expand6((value >> 5) & 0x3F) << 8) | (Expand5(value & 0x1F) << 16) | 0xFF000000u;
+            }
+            break;
+        case DXGI_FORMAT_B5G5R5A1_UNORM:
+            for (uint32_t x = 0; x < width; x++)
+            {
+                uint32_t value = Read16(pSource + x * 2);
+                ldr[x] = Expand5((value >> 10) & 0x1F) | (Expand5((value >> 5) & 0x1F) << 8) | (Expand5(value & 0x1F) << 16) |
+                    ((value & 0x8000) ? 0xFF000000u : 0);
+            }
+            break;
+        case DXGI_FORMAT_B4G4R4A4_UNORM:
+            for (uint32_t x = 0; x < width; x++)
+            {
+                uint32_t value = Read16(pSource + x * 2);
+                ldr[x] = ((value >> 8) & 0xF) * 17 | (((value >> 4) & 0xF) * 17 << 8) | ((value & 0xF) * 17 << 16) | ((value >> 12) * 17 << 24);
+            }
+            break;
+        case DXGI_FORMAT_R8G8_UNORM:
+            for (uint32_t x = 0; x < width; x++)
+                ldr[x] = Read16(pSource + x * 2) | 0xFF000000u;
+            break;
+        case DXGI_FORMAT_R8_UNORM:
+            for (uint32_t x = 0; x < width; x++)
+                ldr[x] = pSource[x] | 0xFF000000u;
+            break;
+        case DXGI_FORMAT_A8_UNORM:
+            for (uint32_t x = 0; x < width; x++)
+                ldr[x] = static_cast<uint32_t>(pSource[x]) << 24;
+            break;
+
+        case DXGI_FORMAT_R10G10B10A2_UNORM:
+            for (uint32_t x = 0; x < width; x++)
+            {
+                uint32_t value = Read32(pSource + x * 4);
+                hdr[x * 4 + 0] = (value & 0x3FF) / 1023.0f;
+                hdr[x * 4 + 1] = ((value >> 10) & 0x3FF) / 1023.0f;
+                hdr[x * 4 + 2] = ((value >> 20) & 0x3FF) / 1023.0f;
+                hdr[x * 4 + 3] = (value >> 30) / 3.0f;
+            }
+            break;
+        case DXGI_FORMAT_R16_UNORM:
+        case DXGI_FORMAT_R16G16_UNORM:
+        case DXGI_FORMAT_R16G16B16A16_UNORM:
+        {
+            uint32_t channels = format == DXGI_FORMAT_R16_UNORM ? 1 : format == DXGI_FORMAT_R16G16_UNORM ? 2 : 4;
+            for (uint32_t x = 0; x < width; x++)
+            {
+                for (uint32_t c = 0; c < channels; c++)
+                    hdr[x * 4 + c] = Read16(pSource + (x * channels + c) * 2) / 65535.0f;
+            }
+            break;
+        }
+        case DXGI_FORMAT_R16G16_SNORM:
+        case DXGI_FORMAT_R16G16B16A16_SNORM:
+        {
+            uint32_t channels = format == DXGI_FORMAT_R16G16_SNORM ? 2 : 4;
+            for (uint32_t x = 0; x < width; x++)
+            {
+                for (uint32_t c = 0; c < channels; c++)
+                    hdr[x * 4 + c] = Snorm16(Read16(pSource + (x * channels + c) * 2));
+            }
+            break;
+        }
+        case DXGI_FORMAT_R8G8_SNORM:
+        case DXGI_FORMAT_R8G8B8A8_SNORM:
+        {
+            uint32_t channels = format == DXGI_FORMAT_R8G8_SNORM ? 2 : 4;
+            for (uint32_t x = 0; x < width; x++)
+            {
+                for (uint32_t c = 0; c < channels; c++)
+                    hdr[x * 4 + c] = Snorm8(pSource[x * channels + c]);
+            }
+            break;
+        }
+        case DXGI_FORMAT_R16_FLOAT:
+        case DXGI_FORMAT_R16G16_FLOAT:
+        case DXGI_FORMAT_R16G16B16A16_FLOAT:
+        {
+            uint32_t channels = format == DXGI_FORMAT_R16_FLOAT ? 1 : format == DXGI_FORMAT_R16G16_FLOAT ? 2 : 4;
+            for (uint32_t x = 0; x < width; x++)
+            {
+                for (uint32_t c = 0; c < channels; c++)
+                    hdr[x * 4 + c] = HalfToFloat(Read16(pSource + (x * channels + c) * 2));
+            }
+            break;
+        }
+        default:
+        {
+            // R32, R32G32 and R32G32B32A32 float
+            uint32_t channels = format == DXGI_FORMAT_R32_FLOAT ? 1 : format == DXGI_FORMAT_R32G32_FLOAT ? 2 : 4;
+            for (uint32_t x = 0; x < width; x++)
+                memcpy(hdr + x * 4, pSource + x * channels * 4, channels * sizeof(float));
+            break;
+        }
+        }
+    }
+
+    uint32_t ClampByte(int32_t value)
+    {
+        return static_cast<uint32_t>(std::min(std::max(value, 0), 255));
+    }
+
+    // Studio range BT.601, as the D3D video formats define YUY2
+    uint32_t YuvToRgb(int32_t y, int32_t u, int32_t v)
+    {
+        int32_t c = y - 16;
+        int32_t d = u - 128;
+        int32_t e = v - 128;
+        uint32_t r = ClampByte((298 * c + 409 * e + 128) >> 8);
+        uint32_t g = ClampByte((298 * c - 100 * d - 208 * e + 128) >> 8);
+        uint32_t b = ClampByte((298 * c + 516 * d + 128) >> 8);
+        return r | (g << 8) | (b << 16) | 0xFF000000u;
+    }
+
+    // Two texels sharing red and blue, or chroma, in every four bytes
+    void DecodePairRow(DXGI_FORMAT format, const uint8_t* pSource, uint32_t width, uint32_t* ldr)
+    {
+        for (uint32_t x = 0; x < width; x += 2)
+        {
+            const uint8_t* p = pSource + (x / 2) * 4;
+            uint32_t first, second;
+            if (format == DXGI_FORMAT_YUY2)
+            {
+                first = YuvToRgb(p[0], p[1], p[3]);
+                second = YuvToRgb(p[2], p[1], p[3]);
+            }
+            else
+            {
+                bool rgbg = format == DXGI_FORMAT_R8G8_B8G8_UNORM;
+                uint32_t rb = rgbg ? p[0] | (p[2] << 16) : p[1] | (p[3] << 16);
+                first = rb | ((rgbg ? p[1] : p[0]) << 8) | 0xFF000000u;
+                second = rb | ((rgbg ? p[3] : p[2]) << 8) | 0xFF000000u;
+            }
+            ldr[x] = first;
+            if (x + 1 < width)
+                ldr[x + 1] = second;
+        }
+    }
+
+    void WriteLdrTexels(const uint32_t* texels, uint32_t count, bool srgb, DecodeTarget target, uint8_t* pDest)
+    {
+        if (target == DecodeTarget::RGBA8)
+        {
+            memcpy(pDest, texels, count * sizeof(uint32_t));
+            return;
+        }
+
+        float* pOut = reinterpret_cast<float*>(pDest);
+        if (srgb)
+        {
+            const float* table = SrgbToLinearTable();
+            for (uint32_t i = 0; i < count; i++, pOut += 4)
+            {
+                uint32_t texel = texels[i];
+                pOut[0] = table[texel & 0xFF];
+                pOut[1] = table[(texel >> 8) & 0xFF];
+                pOut[2] = table[(texel >> 16) & 0xFF];
+                pOut[3] = (texel >> 24) * (1.0f / 255.0f);
+            }
+            return;
+        }
+
+        __m128i zero = _mm_setzero_si128();
+        __m128 scale = _mm_set1_ps(1.0f / 255.0f);
+        for (uint32_t i = 0; i < count; i++, pOut += 4)
+        {
+            __m128i value = _mm_cvtsi32_si128(static_cast<int>(texels[i]));
+            value = _mm_unpacklo_epi16(_mm_unpacklo_epi8(value, zero), zero);
+            _mm_storeu_ps(pOut, _mm_mul_ps(_mm_cvtepi32_ps(value), scale));
+        }
+    }
+
+    void WriteFloatTexels(const float* texels, uint32_t count, bool snorm, DecodeTarget target, uint8_t* pDest)
+    {
+        if (target == DecodeTarget::RGBA32F)
+        {
+            memcpy(pDest, texels, count * 4 * sizeof(float));
+            return;
+        }
+
+        // NaN fails the max and lands on 0
+        __m128 zero = _mm_setzero_ps();
+        __m128 one = _mm_set1_ps(1.0f);
+        __m128 half = _mm_set1_ps(0.5f);
+        __m128 scale = _mm_set1_ps(255.0f);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            __m128 value = _mm_loadu_ps(texels + i * 4);
+            if (snorm)
+                value = _mm_add_ps(_mm_mul_ps(value, half), half);
+            value = _mm_min_ps(_mm_max_ps(value, zero), one);
+            __m128i bytes = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(value, scale), half));
+            bytes = _mm_packs_epi32(bytes, bytes);
+            bytes = _mm_packus_epi16(bytes, bytes);
+            int packed = _mm_cvtsi128_si32(bytes);
+            memcpy(pDest + i * 4, &packed, sizeof(packed));
+        }
+    }
+
+    struct Band
+    {
+        const uint8_t* pSource;     // first row of blocks or texels
+        size_t sourcePitch;
+        uint8_t* pDest;             // first texel row
+        uint32_t width;
+        uint32_t rows;              // texel rows
+    };
+
+    void DecodeBand(DXGI_FORMAT format, const FormatInfo& info, const Band& band, DecodeTarget target)
+    {
+        size_t texelBytes = target == DecodeTarget::RGBA8 ? 4 : 16;
+        size_t destPitch = band.width * texelBytes;
+        if (IsBlockKind(info.kind))
+        {
+            uint32_t blocksX = (band.width + 3) / 4;
+            uint32_t blockRows = (band.rows + 3) / 4;
+            for (uint32_t by = 0; by < blockRows; by++)
+            {
+                const uint8_t* pRow = band.pSource + by * band.sourcePitch;
+                uint32_t rows = std::min(4u, band.rows - by * 4);
+                for (uint32_t bx = 0; bx < blocksX; bx += 4)
+                {
+                    uint32_t count = std::min(4u, blocksX - bx);
+                    const uint8_t* pBlocks = pRow + static_cast<size_t>(bx) * info.bytes;
+                    alignas(16) uint32_t ldr[4][16];
+                    alignas(16) float hdr[4][16][4];
+                    if (info.floatTexels)
+                        DecodeFloatGroup(info.kind, pBlocks, info.bytes, count, hdr);
+                    else
+                        DecodeLdrGroup(info.kind, pBlocks, info.bytes, count, ldr);
+
+                    // Edge blocks of small mips drop the texels past the edge
+                    for (uint32_t i = 0; i < count; i++)
+                    {
+                        uint32_t x = (bx + i) * 4;
+                        uint32_t columns = std::min(4u, band.width - x);
+                        for (uint32_t y = 0; y < rows; y++)
+                        {
+                            uint8_t* pDest = band.pDest + (by * 4 + y) * destPitch + x * texelBytes;
+                            if (info.floatTexels)
+                                WriteFloatTexels(hdr[i][y * 4], columns, info.snorm, target, pDest);
+                            else
+                                WriteLdrTexels(ldr[i] + y * 4, columns, info.srgb, target, pDest);
+                        }
+                    }
+                }
+            }
+            return;
+        }
+
+        std::vector<uint32_t> ldr(info.floatTexels ? 0 : band.width + 1);
+        std::vector<float> hdr(info.floatTexels ? band.width * 4 : 0);
+        for (uint32_t y = 0; y < band.rows; y++)
+        {
+            const uint8_t* pRow = band.pSource + y * band.sourcePitch;
+            uint8_t* pDest = band.pDest + y * destPitch;
+            if (info.kind == SourceKind::TexelPairs)
+                DecodePairRow(format, pRow, band.width, ldr.data());
+            else
+                DecodeTexelRow(format, pRow, band.width, ldr.data(), hdr.data());
+
+            if (info.floatTexels)
+                WriteFloatTexels(hdr.data(), band.width, info.snorm, target, pDest);
+            else
+                WriteLdrTexels(ldr.data(), band.width, info.srgb, target, pDest);
+        }
+    }
+
+    // DX10 header and data of one 2D texture, the way TextureCooker::BuildFile writes them
+    void BuildFile(DXGI_FORMAT format, uint32_t size, uint32_t mipCount, const std::vector<uint8_t>& data, std::vector<uint8_t>& file)
+    {
+        DDS_HEADER header = {};
+        header.size = sizeof(DDS_HEADER);
+        header.flags = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000;     // caps, height, width, pixel format, mip count
+        header.height = size;
+        header.width = size;
+        header.mipMapCount = mipCount;
+        header.ddspf.size = sizeof(DDS_PIXELFORMAT);
+        header.ddspf.flags = DDS_FOURCC;
+        header.ddspf.fourCC = MAKEFOURCC('D', 'X', '1', '0');
+        header.caps = 0x1000 | 0x8 | 0x400000;                  // texture, complex, mipmap
+
+        DDS_HEADER_DXT10 extension = {};
+        extension.dxgiFormat = format;
+        extension.resourceDimension = DDS_DIMENSION_TEXTURE2D;
+        extension.arraySize = 1;
+
+        file.resize(DDS_DX10_HEADER_SIZE + data.size());
+        memcpy(file.data(), &DDS_MAGIC, sizeof(uint32_t));
+        memcpy(file.data() + sizeof(uint32_t), &header, sizeof(header));
+        memcpy(file.data() + sizeof(uint32_t) + sizeof(header), &extension, sizeof(extension));
+        memcpy(file.data() + DDS_DX10_HEADER_SIZE, data.data(), data.size());
+    }
+
+    // Random blocks; BC6H and BC7 get their modes evenly instead of by the lowest set bit
+    void RandomBlocks(const FormatInfo& info, size_t blockCount, uint32_t& seed, std::vector<uint8_t>& data)
+    {
+        data.resize(blockCount * info.bytes);
+        for (size_t i = 0; i < data.size(); i++)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            data[i] = static_cast<uint8_t>(seed >> 24);
+        }
+        if (info.kind != SourceKind::BC7 && info.kind != SourceKind::BC6H && info.kind != SourceKind::BC6HSigned)
+            return;
+
+        for (size_t i = 0; i < blockCount; i++)
+        {
+            uint8_t& first = data[i * info.bytes];
+            seed = seed * 1664525u + 1013904223u;
+            if (info.kind == SourceKind::BC7)
+            {
+                uint32_t mode = (seed >> 24) % 8;
+                first = static_cast<uint8_t>((first & ~((2u << mode) - 1)) | (1u << mode));
+            }
+            else
+            {
+                const Bc6Mode& mode = Bc6Modes[(seed >> 24) % 14];
+                uint32_t modeMask = mode.value < 2 ? 0x3 : 0x1F;
+                first = static_cast<uint8_t>((first & ~modeMask) | mode.value);
+            }
+        }
+    }
+
+    // Bits of a block written from the lowest up, for the BC6H checks
+    struct BlockWriter
+    {
+        uint8_t bytes[16];
+        uint32_t position;
+
+        BlockWriter() : bytes(), position(0) {}
+
+        void Write(uint32_t value, uint32_t count)
+        {
+            for (uint32_t i = 0; i < count; i++, position++)
+            {
+                if ((value >> i) & 1)
+                    bytes[position / 8] |= static_cast<uint8_t>(1u << (position % 8));
+            }
+        }
+    };
+}
+
+BlockDecoder::BlockDecoder()
+    : m_pPool(nullptr), m_stats()
+{
+}
+
+bool BlockDecoder::IsSupported(DXGI_FORMAT format)
+{
+    FormatInfo info;
+    return GetFormatInfo(format, info);
+}
+
+const char* BlockDecoder::GetFormatName(DXGI_FORMAT format)
+{
+    switch (format)
+    {
+    case DXGI_FORMAT_BC1_TYPELESS:
+    case DXGI_FORMAT_BC1_UNORM:             return "BC1";
+    case DXGI_FORMAT_BC1_UNORM_SRGB:        return "BC1 sRGB";
+    case DXGI_FORMAT_BC2_TYPELESS:
+    case DXGI_FORMAT_BC2_UNORM:             return "BC2";
+    case DXGI_FORMAT_BC2_UNORM_SRGB:        return "BC2 sRGB";
+    case DXGI_FORMAT_BC3_TYPELESS:
+    case DXGI_FORMAT_BC3_UNORM:             return "BC3";
+    case DXGI_FORMAT_BC3_UNORM_SRGB:        return "BC3 sRGB";
+    case DXGI_FORMAT_BC4_TYPELESS:
+    case DXGI_FORMAT_BC4_UNORM:             return "BC4";
+    case DXGI_FORMAT_BC4_SNORM:             return "BC4 SNORM";
+    case DXGI_FORMAT_BC5_TYPELESS:
+    case DXGI_FORMAT_BC5_UNORM:             return "BC5";
+    case DXGI_FORMAT_BC5_SNORM:             return "BC5 SNORM";
+    case DXGI_FORMAT_BC6H_TYPELESS:
+    case DXGI_FORMAT_BC6H_UF16:             return "BC6H UF16";
+    case DXGI_FORMAT_BC6H_SF16:             return "BC6H SF16";
+    case DXGI_FORMAT_BC7_TYPELESS:
+    case DXGI_FORMAT_BC7_UNORM:             return "BC7";
+    case DXGI_FORMAT_BC7_UNORM_SRGB:        return "BC7 sRGB";
+    case DXGI_FORMAT_R8G8B8A8_TYPELESS:
+    case DXGI_FORMAT_R8G8B8A8_UNORM:        return "RGBA8";
+    case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:   return "RGBA8 sRGB";
+    case DXGI_FORMAT_B8G8R8A8_UNORM:        return "BGRA8";
+    case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:   return "BGRA8 sRGB";
+    case DXGI_FORMAT_B8G8R8X8_UNORM:        return "BGRX8";
+    case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:   return "BGRX8 sRGB";
+    case DXGI_FORMAT_B5G6R5_UNORM:          return "B5G6R5";
+    case DXGI_FORMAT_B5G5R5A1_UNORM:        return "B5G5R5A1";
+    case DXGI_FORMAT_B4G4R4A4_UNORM:        return "B4G4R4A4";
+    case DXGI_FORMAT_R8G8_UNORM:            return "RG8";
+    case DXGI_FORMAT_R8_UNORM:              return "R8";
+    case DXGI_FORMAT_A8_UNORM:              return "A8";
+    case DXGI_FORMAT_R10G10B10A2_UNORM:     return "RGB10A2";
+    case DXGI_FORMAT_R16_UNORM:             return "R16";
+    case DXGI_FORMAT_R16G16_UNORM:          return "RG16";
+    case DXGI_FORMAT_R16G16B16A16_UNORM:    return "RGBA16";
+    case DXGI_FORMAT_R8G8_SNORM:            return "RG8 SNORM";
+    case DXGI_FORMAT_R8G8B8A8_SNORM:        return "RGBA8 SNORM";
+    case DXGI_FORMAT_R16G16_SNORM:          return "RG16 SNORM";
+    case DXGI_FORMAT_R16G16B16A16_SNORM:    return "RGBA16 SNORM";
+    case DXGI_FORMAT_R16_FLOAT:             return "R16F";
+    case DXGI_FORMAT_R16G16_FLOAT:          return "RG16F";
+    case DXGI_FORMAT_R16G16B16A16_FLOAT:    return "RGBA16F";
+    case DXGI_FORMAT_R32_FLOAT:             return "R32F";
+    case DXGI_FORMAT_R32G32_FLOAT:          return "RG32F";
+    case DXGI_FORMAT_R32G32B32A32_FLOAT:    return "RGBA32F";
+    case DXGI_FORMAT_R8G8_B8G8_UNORM:       return "RGBG";
+    case DXGI_FORMAT_G8R8_G8B8_UNORM:       return "GRGB";
+    case DXGI_FORMAT_YUY2:                  return "YUY2";
+    default:                                return "unsupported";
+    }
+}
+
+bool BlockDecoder::Decode(const uint8_t* dds, size_t ddsSize, DecodeTarget target, DecodedTexture& texture)
+{
+    m_stats = {};
+    std::vector<uint8_t> unpacked;
+    if (TexturePacker::IsPacked(dds, ddsSize))
+    {
+        TexturePacker packer;
+        packer.SetThreadPool(m_pPool);
+        if (!packer.Unpack(dds, ddsSize, unpacked))
+            return false;
+        dds = unpacked.data();
+        ddsSize = unpacked.size();
+    }
+
+    const DDS_HEADER* header = nullptr;
+    const uint8_t* bitData = nullptr;
+    size_t bitSize = 0;
+    DDSTextureLayout layout = {};
+    FormatInfo info;
+    if (FAILED(LoadTextureDataFromMemory(dds, ddsSize, &header, &bitData, &bitSize)) || FAILED(GetTextureLayout(header, layout)) ||
+        !GetFormatInfo(layout.format, info))
+    {
+        return false;
+    }
+    // The limits of the device, so a broken header cannot ask for more subresources than a file holds
+    if (layout.width == 0 || layout.height == 0 || layout.depth == 0 || layout.mipCount > MaxMipLevels ||
+        layout.arraySize > DDS_MAX_TEXTURE2D_ARRAY_SIZE)
+    {
+        return false;
+    }
+
+    std::vector<DDSSubresourceData> initData(static_cast<size_t>(layout.mipCount) * layout.arraySize);
+    size_t twidth = 0, theight = 0, tdepth = 0, skipMip = 0;
+    if (FAILED(FillInitData(layout.width, layout.height, layout.depth, layout.mipCount, layout.arraySize, layout.format, 0,
+        bitSize, bitData, twidth, theight, tdepth, skipMip, initData.data())))
+    {
+        return false;
+    }
+
+    texture.sourceFormat = layout.format;
+    texture.target = target;
+    texture.width = layout.width;
+    texture.height = layout.height;
+    texture.depth = layout.depth;
+    texture.mipCount = layout.mipCount;
+    texture.arraySize = layout.arraySize;
+    texture.isCubeMap = layout.isCubeMap;
+    texture.subresources.resize(initData.size());
+
+    size_t texelBytes = target == DecodeTarget::RGBA8 ? 4 : 16;
+    size_t size = 0;
+    for (uint32_t slice = 0; slice < layout.arraySize; slice++)
+    {
+        for (uint32_t mip = 0; mip < layout.mipCount; mip++)
+        {
+            DecodedSubresource& subresource = texture.subresources[slice * layout.mipCount + mip];
+            subresource.width = std::max(layout.width >> mip, 1u);
+            subresource.height = std::max(layout.height >> mip, 1u);
+            subresource.depth = std::max(layout.depth >> mip, 1u);
+            subresource.offset = size;
+            size += static_cast<size_t>(subresource.width) * subresource.height * subresource.depth * texelBytes;
+            m_stats.texels += static_cast<uint64_t>(subresource.width) * subresource.height * subresource.depth;
+        }
+    }
+    texture.data.resize(size);
+
+    // Bands of whole block rows, so small mips are a task each and large ones are shared out
+    std::vector<Band> bands;
+    uint32_t rowHeight = IsBlockKind(info.kind) ? 4 : 1;
+    for (size_t i = 0; i < initData.size(); i++)
+    {
+        const DecodedSubresource& subresource = texture.subresources[i];
+        uint32_t units = (subresource.height + rowHeight - 1) / rowHeight;
+        uint32_t unitsPerBand = std::max(BandTexels / (subresource.width * rowHeight), 1u);
+        size_t destPitch = subresource.width * texelBytes;
+        for (uint32_t z = 0; z < subresource.depth; z++)
+        {
+            const uint8_t* pSource = static_cast<const uint8_t*>(initData[i].pSysMem) + static_cast<size_t>(z) * initData[i].SysMemSlicePitch;
+            uint8_t* pDest = texture.data.data() + subresource.offset + static_cast<size_t>(z) * subresource.height * destPitch;
+            for (uint32_t unit = 0; unit < units; unit += unitsPerBand)
+            {
+                Band band;
+                band.pSource = pSource + static_cast<size_t>(unit) * initData[i].SysMemPitch;
+                band.sourcePitch = initData[i].SysMemPitch;
+                band.pDest = pDest + static_cast<size_t>(unit) * rowHeight * destPitch;
+                band.width = subresource.width;
+                band.rows = std::min(unitsPerBand * rowHeight, subresource.height - unit * rowHeight);
+                bands.push_back(band);
+            }
+        }
+    }
+
+    uint64_t start = Profiler::NowNs();
+    DXGI_FORMAT format = layout.format;
+    RunParallel(m_pPool, static_cast<uint32_t>(bands.size()), [&bands, &info, format, target](uint32_t index)
+    {
+        DecodeBand(format, info, bands[index], target);
+    });
+
+    m_stats.subresources = static_cast<uint32_t>(initData.size());
+    m_stats.bands = static_cast<uint32_t>(bands.size());
+    m_stats.threads = m_pPool ? m_pPool->GetThreadCount() : 1;
+    m_stats.seconds = (Profiler::NowNs() - start) * 1.0e-9;
+    return true;
+}
+
+bool BlockDecoder::DecodeFile(const char* path, DecodeTarget target, DecodedTexture& texture)
+{
+    MappedFile file;
+    return file.Open(path) && Decode(file.GetData(), file.GetSize(), target, texture);
+}
+
+BlockDecodeBenchmarkResult BlockDecoder::Benchmark(ThreadPool* pPool, const std::vector<std::string>& paths,
+    uint32_t size, uint32_t passes)
+{
+    BlockDecodeBenchmarkResult result = {};
+    result.size = size;
+    result.passes = passes;
+    result.threads = pPool ? pPool->GetThreadCount() : 1;
+    if (size < 4 || passes == 0)
+        return result;
+
+    BlockDecoder single;
+    BlockDecoder parallel;
+    parallel.SetThreadPool(pPool);
+
+    // Random blocks of every block format, the whole mip chain
+    const DXGI_FORMAT formats[] =
+    {
+        DXGI_FORMAT_BC1_UNORM, DXGI_FORMAT_BC2_UNORM, DXGI_FORMAT_BC3_UNORM, DXGI_FORMAT_BC4_UNORM, DXGI_FORMAT_BC4_SNORM,
+        DXGI_FORMAT_BC5_UNORM, DXGI_FORMAT_BC5_SNORM, DXGI_FORMAT_BC6H_UF16, DXGI_FORMAT_BC6H_SF16, DXGI_FORMAT_BC7_UNORM
+    };
+    uint32_t mipCount = 1;
+    while ((size >> mipCount) > 0)
+        mipCount++;
+    uint32_t seed = 11;
+    for (DXGI_FORMAT format : formats)
+    {
+        FormatInfo info;
+        GetFormatInfo(format, info);
+        size_t blockCount = 0;
+        for (uint32_t mip = 0; mip < mipCount; mip++)
+        {
+            size_t blocks = (std::max(size >> mip, 1u) + 3) / 4;
+            blockCount += blocks * blocks;
+        }
+        std::vector<uint8_t> data;
+        std::vector<uint8_t> file;
+        RandomBlocks(info, blockCount, seed, data);
+        BuildFile(format, size, mipCount, data, file);
+
+        BlockDecodeFormatResult formatResult = {};
+        formatResult.format = format;
+        DecodedTexture rgba8, rgba32f, pooled;
+        double seconds[3] = {};
+        bool decoded = true;
+        for (uint32_t pass = 0; pass < passes && decoded; pass++)
+        {
+            decoded = single.Decode(file.data(), file.size(), DecodeTarget::RGBA8, rgba8);
+            seconds[0] += single.GetStats().seconds;
+            decoded = decoded && single.Decode(file.data(), file.size(), DecodeTarget::RGBA32F, rgba32f);
+            seconds[1] += single.GetStats().seconds;
+            decoded = decoded && parallel.Decode(file.data(), file.size(), DecodeTarget::RGBA8, pooled);
+            seconds[2] += parallel.GetStats().seconds;
+        }
+        if (!decoded)
+        {
+            formatResult.mismatches = 1;
+            result.formats.push_back(formatResult);
+            continue;
+        }
+
+        formatResult.texels = single.GetStats().texels;
+        double megapixels = formatResult.texels * 1.0e-6 * passes;
+        formatResult.rgba8Rate = seconds[0] > 0.0 ? megapixels / seconds[0] : 0.0;
+        formatResult.floatRate = seconds[1] > 0.0 ? megapixels / seconds[1] : 0.0;
+        formatResult.parallelRate = seconds[2] > 0.0 ? megapixels / seconds[2] : 0.0;
+
+        // The pool against one thread, and RGBA8 against the floats rounded the same way
+        std::vector<uint8_t> rounded(rgba8.data.size());
+        WriteFloatTexels(reinterpret_cast<const float*>(rgba32f.data.data()), static_cast<uint32_t>(formatResult.texels), info.snorm,
+            DecodeTarget::RGBA8, rounded.data());
+        for (size_t i = 0; i < rgba8.data.size(); i += 4)
+        {
+            if (memcmp(&rgba8.data[i], &pooled.data[i], 4) != 0 || memcmp(&rgba8.data[i], &rounded[i], 4) != 0)
+                formatResult.mismatches++;
+        }
+        result.formats.push_back(formatResult);
+    }
+
+    // Blocks TextureCooker wrote from a noisy gradient, against its reference decoder
+    const BlockFormat cooked[] = { BlockFormat::BC1, BlockFormat::BC3, BlockFormat::BC5, BlockFormat::BC7 };
+    for (BlockFormat blockFormat : cooked)
+    {
+        FormatInfo info;
+        GetFormatInfo(static_cast<DXGI_FORMAT>(TextureCooker::GetDxgiFormat(blockFormat)), info);
+        for (uint32_t block = 0; block < 256; block++)
+        {
+            alignas(16) uint32_t source[16];
+            for (uint32_t i = 0; i < 16; i++)
+            {
+                seed = seed * 1664525u + 1013904223u;
+                uint32_t x = (block % 16) * 4 + i % 4;
+                uint32_t y = (block / 16) * 4 + i / 4;
+                uint32_t noise = (seed >> 24) & 0x1F;
+                source[i] = std::min(x * 4 + noise, 255u) | (std::min(y * 4 + noise, 255u) << 8) | (((x + y) * 2) << 16) |
+                    ((255 - y * 2 - (noise & 7)) << 24);
+            }
+            uint8_t encoded[16];
+            uint32_t reference[16];
+            alignas(16) uint32_t decoded[4][16];
+            TextureCooker::CompressBlock(blockFormat, source, 1, encoded);
+            if (!TextureCooker::DecompressBlock(blockFormat, encoded, reference))
+                continue;
+            DecodeLdrGroup(info.kind, encoded, info.bytes, 1, decoded);
+            for (uint32_t i = 0; i < 16; i++)
+            {
+                result.referenceTexels++;
+                for (uint32_t c = 0; c < 4; c++)
+                {
+                    int32_t difference = static_cast<int32_t>((reference[i] >> (8 * c)) & 0xFF) - static_cast<int32_t>((decoded[0][i] >> (8 * c)) & 0xFF);
+                    if (difference > 1 || difference < -1)
+                    {
+                        result.referenceErrors++;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    // BC6H blocks written bit by bit in the two single subset modes with the widest endpoints:
+    // 16 bits with 4 bit deltas (mode 14, high bits stored reversed) in both signs, and mode 11
+    // with two 10 bit endpoints. Even texels take index 0, odd ones the last index, so every
+    // texel is one of the endpoints without rounding.
+    for (uint32_t variant = 0; variant < 3; variant++)
+    {
+        bool isSigned = variant == 1;
+        for (uint32_t block = 0; block < 64; block++)
+        {
+            BlockWriter writer;
+            float expected[2][3];
+            if (variant < 2)
+            {
+                int32_t w[3], x[3];
+                for (uint32_t c = 0; c < 3; c++)
+                {
+                    seed = seed * 1664525u + 1013904223u;
+                    int32_t delta = static_cast<int32_t>((seed >> 28) & 0xF) - 8;
+                    seed = seed * 1664525u + 1013904223u;
+                    uint32_t magnitude = (seed >> 8) % 0x7BF0;
+                    // Endpoints whose halves come out exactly: (e * 31) >> 6 unsigned, >> 5 signed
+                    int32_t endpoint = isSigned ? static_cast<int32_t>((magnitude * 32 + 30) / 31) : static_cast<int32_t>((magnitude * 64 + 30) / 31);
+                    if (isSigned && (seed & 1))
+                        endpoint = -endpoint;
+                    w[c] = endpoint;
+                    x[c] = delta;
+                    int32_t other = endpoint + delta;
+                    if (!isSigned)
+                        other &= 0xFFFF;
+                    for (uint32_t e = 0; e < 2; e++)
+                    {
+                        int32_t value = e ? other : endpoint;
+                        uint32_t half = isSigned ? (value < 0 ? 0x8000u | static_cast<uint32_t>((-value * 31) >> 5) : static_cast<uint32_t>((value * 31) >> 5))
+                            : static_cast<uint32_t>((value * 31) >> 6);
+                        expected[e][c] = HalfToFloat(half);
+                    }
+                }
+                writer.Write(0x0F, 5);
+                for (uint32_t c = 0; c < 3; c++)
+                    writer.Write(static_cast<uint32_t>(w[c]) & 0x3FF, 10);
+                for (uint32_t c = 0; c < 3; c++)
+                {
+                    writer.Write(static_cast<uint32_t>(x[c]) & 0xF, 4);
+                    for (uint32_t bit = 15; bit >= 10; bit--)
+                        writer.Write((static_cast<uint32_t>(w[c]) >> bit) & 1, 1);
+                }
+            }
+            else
+            {
+                uint32_t q[2][3];
+                for (uint32_t e = 0; e < 2; e++)
+                {
+                    for (uint32_t c = 0; c < 3; c++)
+                    {
+                        seed = seed * 1664525u + 1013904223u;
+                        q[e][c] = (seed >> 8) & 0x3FF;
+                        uint32_t unquantized = q[e][c] == 0 ? 0 : q[e][c] == 0x3FF ? 0xFFFF : ((q[e][c] << 16) + 0x8000) >> 10;
+                        expected[e][c] = HalfToFloat((unquantized * 31) >> 6);
+                    }
+                }
+                writer.Write(0x03, 5);
+                for (uint32_t e = 0; e < 2; e++)
+                {
+                    for (uint32_t c = 0; c < 3; c++)
+                        writer.Write(q[e][c], 10);
+                }
+            }
+            writer.Write(0, 3);
+            for (uint32_t i = 1; i < 16; i++)
+                writer.Write(i & 1 ? 15 : 0, 4);
+
+            float texels[16][4];
+            DecodeBc6hBlock(writer.bytes, isSigned, texels);
+            result.hdrChecks++;
+            for (uint32_t i = 0; i < 16; i++)
+            {
+                if (texels[i][0] != expected[i & 1][0] || texels[i][1] != expected[i & 1][1] || texels[i][2] != expected[i & 1][2])
+                {
+                    result.hdrErrors++;
+                    break;
+                }
+            }
+        }
+    }
+
+    for (const std::string& path : paths)
+    {
+        BlockDecodeFileResult fileResult = {};
+        fileResult.path = path;
+        DecodedTexture texture;
+        fileResult.decoded = parallel.DecodeFile(path.c_str(), DecodeTarget::RGBA8, texture);
+        if (fileResult.decoded)
+        {
+            fileResult.format = texture.sourceFormat;
+            fileResult.width = texture.width;
+            fileResult.height = texture.height;
+            fileResult.mipCount = texture.mipCount;
+            fileResult.arraySize = texture.arraySize;
+            fileResult.ms = parallel.GetStats().seconds * 1000.0;
+        }
+        result.files.push_back(fileResult);
+    }
+    return result;
+}
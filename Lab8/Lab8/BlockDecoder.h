@@ -0,0 +1,116 @@
+#ifndef BLOCK_DECODER_H
+#define BLOCK_DECODER_H
+
+#include "DDSLayout.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class ThreadPool;
+
+enum class DecodeTarget : uint32_t
+{
+    RGBA8,      // R in the low byte; sRGB stays encoded, SNORM is biased to 0..1 like a UNORM normal map
+    RGBA32F     // r, g, b, a floats as a shader reads them: sRGB decoded to linear, SNORM signed
+};
+
+struct DecodedSubresource
+{
+    uint32_t width;
+    uint32_t height;
+    uint32_t depth;
+    size_t offset;              // bytes into DecodedTexture::data, rows and depth slices tightly packed
+};
+
+struct DecodedTexture
+{
+    DXGI_FORMAT sourceFormat;
+    DecodeTarget target;
+    uint32_t width;
+    uint32_t height;
+    uint32_t depth;
+    uint32_t mipCount;
+    uint32_t arraySize;         // six per cube
+    bool isCubeMap;
+    std::vector<DecodedSubresource> subresources;   // slice * mipCount + mip, the order of D3D11 subresources
+    std::vector<uint8_t> data;
+};
+
+struct BlockDecodeStats
+{
+    uint32_t subresources;
+    uint64_t texels;
+    uint32_t bands;             // tasks the subresources were cut into
+    uint32_t threads;
+    double seconds;             // decoding only, without the parsing and the unpacking of packed files
+};
+
+struct BlockDecodeFormatResult
+{
+    DXGI_FORMAT format;
+    uint64_t texels;            // one pass, the whole mip chain
+    double rgba8Rate;           // megapixels per second on the calling thread
+    double floatRate;           // the same into RGBA32F
+    double parallelRate;        // RGBA8 on every thread of the pool
+    uint32_t mismatches;        // texels the pool decoded differently, or RGBA8 not the rounded RGBA32F
+};
+
+struct BlockDecodeFileResult
+{
+    std::string path;
+    DXGI_FORMAT format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t mipCount;
+    uint32_t arraySize;
+    double ms;                  // RGBA8 on the pool, reading excluded
+    bool decoded;
+};
+
+struct BlockDecodeBenchmarkResult
+{
+    uint32_t size;
+    uint32_t passes;
+    uint32_t threads;
+    std::vector<BlockDecodeFormatResult> formats;   // random blocks of every block format
+    std::vector<BlockDecodeFileResult> files;
+    uint32_t referenceTexels;   // blocks TextureCooker wrote, decoded here and by DecompressBlock
+    uint32_t referenceErrors;   // texels more than one step apart
+    uint32_t hdrChecks;         // BC6H blocks built bit by bit with known endpoints
+    uint32_t hdrErrors;
+};
+
+// CPU decoder of DDS files for the software paths: BC1 to BC7 including BC6H, and every other
+// format GetDXGIFormat maps a legacy header to, into RGBA8 or RGBA32F. Block formats decode a
+// row of four blocks at a time: BC1 to BC5 build the palettes of all four in the lanes of SSE
+// registers, one block per lane; BC6H and BC7 switch modes from block to block, so they read
+// their bits one block at a time and interpolate whole palettes in SSE before the indices are
+// looked up. Every mip of every slice is cut into bands of block rows that run on the thread
+// pool, so a tall mip chain keeps every thread busy; the result does not depend on the thread
+// count. Packed files of TexturePacker are unpacked first.
+class BlockDecoder
+{
+public:
+    BlockDecoder();
+
+    void SetThreadPool(ThreadPool* pPool) { m_pPool = pPool; }
+
+    bool Decode(const uint8_t* dds, size_t ddsSize, DecodeTarget target, DecodedTexture& texture);
+    // path is UTF-8
+    bool DecodeFile(const char* path, DecodeTarget target, DecodedTexture& texture);
+    const BlockDecodeStats& GetStats() const { return m_stats; }
+
+    static bool IsSupported(DXGI_FORMAT format);
+    static const char* GetFormatName(DXGI_FORMAT format);
+
+    // size x size random blocks of every block format with their mip chains, decoded passes
+    // times each way, then every file (UTF-8 paths) on the pool
+    static BlockDecodeBenchmarkResult Benchmark(ThreadPool* pPool, const std::vector<std::string>& paths,
+        uint32_t size, uint32_t passes);
+
+private:
+    ThreadPool* m_pPool;
+    BlockDecodeStats m_stats;
+};
+
+#endif
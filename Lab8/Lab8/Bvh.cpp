@@ -0,0 +1,200 @@
+#include "Bvh.h"
+#include <algorithm>
+#include <cfloat>
+
+namespace
+{
+    const uint32_t BinCount = 12;
+    // Cost of visiting a node relative to testing one primitive
+    const float TraversalCost = 1.0f;
+
+    void ResetBounds(BvhBounds& bounds)
+    {
+        for (int axis = 0; axis < 3; axis++)
+        {
+            bounds.min[axis] = FLT_MAX;
+            bounds.max[axis] = -FLT_MAX;
+        }
+    }
+
+    void GrowBounds(BvhBounds& bounds, const BvhBounds& other)
+    {
+        for (int axis = 0; axis < 3; axis++)
+        {
+            bounds.min[axis] = other.min[axis] < bounds.min[axis] ? other.min[axis] : bounds.min[axis];
+            bounds.max[axis] = other.max[axis] > bounds.max[axis] ? other.max[axis] : bounds.max[axis];
+        }
+    }
+
+    void GrowBounds(BvhBounds& bounds, const float point[3])
+    {
+        for (int axis = 0; axis < 3; axis++)
+        {
+            bounds.min[axis] = point[axis] < bounds.min[axis] ? point[axis] : bounds.min[axis];
+            bounds.max[axis] = point[axis] > bounds.max[axis] ? point[axis] : bounds.max[axis];
+        }
+    }
+
+    // Half the surface area, which is all the heuristic needs
+    float HalfArea(const BvhBounds& bounds)
+    {
+        float dx = bounds.max[0] - bounds.min[0];
+        float dy = bounds.max[1] - bounds.min[1];
+        float dz = bounds.max[2] - bounds.min[2];
+        if (dx < 0.0f || dy < 0.0f || dz < 0.0f)
+            return 0.0f;
+        return dx * dy + dy * dz + dz * dx;
+    }
+}
+
+void Bvh::Build(const BvhBounds* pBounds, uint32_t count, uint32_t maxLeafSize)
+{
+    m_nodes.clear();
+    m_indices.resize(count);
+    for (uint32_t i = 0; i < count; i++)
+        m_indices[i] = i;
+    if (count == 0)
+        return;
+    if (maxLeafSize == 0)
+        maxLeafSize = 1;
+
+    std::vector<float> centroids(static_cast<size_t>(count) * 3);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        for (int axis = 0; axis < 3; axis++)
+            centroids[i * 3 + axis] = (pBounds[i].min[axis] + pBounds[i].max[axis]) * 0.5f;
+    }
+
+    // A binary tree over count leaves never needs more nodes, so references stay valid while building
+    m_nodes.reserve(static_cast<size_t>(count) * 2 - 1);
+    BvhNode root = {};
+    root.leftFirst = 0;
+    root.count = count;
+    m_nodes.push_back(root);
+
+    std::vector<uint32_t> stack;
+    stack.push_back(0);
+    while (!stack.empty())
+    {
+        uint32_t nodeIndex = stack.back();
+        stack.pop_back();
+        BvhNode& node = m_nodes[nodeIndex];
+        uint32_t first = node.leftFirst;
+        uint32_t primCount = node.count;
+
+        BvhBounds bounds;
+        BvhBounds centroidBounds;
+        ResetBounds(bounds);
+        ResetBounds(centroidBounds);
+        for (uint32_t i = first; i < first + primCount; i++)
+        {
+            GrowBounds(bounds, pBounds[m_indices[i]]);
+            GrowBounds(centroidBounds, &centroids[m_indices[i] * 3]);
+        }
+        for (int axis = 0; axis < 3; axis++)
+        {
+            node.boundsMin[axis] = bounds.min[axis];
+            node.boundsMax[axis] = bounds.max[axis];
+        }
+
+        if (primCount == 1)
+            continue;
+
+        // Binned SAH: sweep the bins of every axis, keep the cheapest plane
+        float parentArea = HalfArea(bounds);
+        float bestCost = FLT_MAX;
+        int bestAxis = -1;
+        uint32_t bestSplit = 0;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float extent = centroidBounds.max[axis] - centroidBounds.min[axis];
+            if (extent <= 0.0f)
+                continue;
+
+            BvhBounds binBounds[BinCount];
+            uint32_t binCounts[BinCount] = {};
+            for (uint32_t b = 0; b < BinCount; b++)
+                ResetBounds(binBounds[b]);
+
+            float scale = BinCount / extent;
+            for (uint32_t i = first; i < first + primCount; i++)
+            {
+                uint32_t prim = m_indices[i];
+                uint32_t bin = static_cast<uint32_t>((centroids[prim * 3 + axis] - centroidBounds.min[axis]) * scale);
+                bin = bin < BinCount - 1 ? bin : BinCount - 1;
+                binCounts[bin]++;
+                GrowBounds(binBounds[bin], pBounds[prim]);
+            }
+
+            float leftArea[BinCount - 1];
+            uint32_t leftCount[BinCount - 1];
+            BvhBounds accumulated;
+            ResetBounds(accumulated);
+            uint32_t accumulatedCount = 0;
+            for (uint32_t b = 0; b < BinCount - 1; b++)
+            {
+                GrowBounds(accumulated, binBounds[b]);
+                accumulatedCount += binCounts[b];
+                leftArea[b] = HalfArea(accumulated);
+                leftCount[b] = accumulatedCount;
+            }
+
+            ResetBounds(accumulated);
+            accumulatedCount = 0;
+            for (uint32_t b = BinCount - 1; b > 0; b--)
+            {
+                GrowBounds(accumulated, binBounds[b]);
+                accumulatedCount += binCounts[b];
+                if (leftCount[b - 1] == 0 || accumulatedCount == 0)
+                    continue;
+
+                float cost = leftArea[b - 1] * leftCount[b - 1] + HalfArea(accumulated) * accumulatedCount;
+                if (cost < bestCost)
+                {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = b;
+                }
+            }
+        }
+
+        float splitCost = parentArea > 0.0f ? TraversalCost + bestCost / parentArea : FLT_MAX;
+        if (primCount <= maxLeafSize && splitCost >= static_cast<float>(primCount))
+            continue;
+
+        uint32_t leftCount;
+        if (bestAxis >= 0)
+        {
+            float extent = centroidBounds.max[bestAxis] - centroidBounds.min[bestAxis];
+            float scale = BinCount / extent;
+            float minCentroid = centroidBounds.min[bestAxis];
+            uint32_t* pMiddle = std::partition(m_indices.data() + first, m_indices.data() + first + primCount,
+                [&](uint32_t prim)
+                {
+                    uint32_t bin = static_cast<uint32_t>((centroids[prim * 3 + bestAxis] - minCentroid) * scale);
+                    return (bin < BinCount - 1 ? bin : BinCount - 1) < bestSplit;
+                });
+            leftCount = static_cast<uint32_t>(pMiddle - (m_indices.data() + first));
+        }
+        else
+        {
+            // Every centroid in the same spot: any split is as good as another
+            leftCount = primCount / 2;
+        }
+
+        uint32_t leftIndex = static_cast<uint32_t>(m_nodes.size());
+        BvhNode left = {};
+        left.leftFirst = first;
+        left.count = leftCount;
+        BvhNode right = {};
+        right.leftFirst = first + leftCount;
+        right.count = primCount - leftCount;
+
+        node.leftFirst = leftIndex;
+        node.count = 0;
+        m_nodes.push_back(left);
+        m_nodes.push_back(right);
+        stack.push_back(leftIndex);
+        stack.push_back(leftIndex + 1);
+    }
+}
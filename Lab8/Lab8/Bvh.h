@@ -0,0 +1,41 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <cstdint>
+#include <vector>
+
+struct BvhBounds
+{
+    float min[3];
+    float max[3];
+};
+
+// 32 bytes, two nodes per cache line. Inner nodes keep their children next to each
+// other at leftFirst and leftFirst + 1; leaves (count > 0) reference count primitive
+// indices starting at leftFirst.
+struct BvhNode
+{
+    float boundsMin[3];
+    uint32_t leftFirst;
+    float boundsMax[3];
+    uint32_t count;
+};
+
+// Bounding volume hierarchy over arbitrary primitives given by their bounds: triangles
+// of a mesh for the bottom level, instance boxes for the top level. Built top-down with
+// the binned surface area heuristic.
+class Bvh
+{
+public:
+    void Build(const BvhBounds* pBounds, uint32_t count, uint32_t maxLeafSize);
+
+    bool IsEmpty() const { return m_nodes.empty(); }
+    const std::vector<BvhNode>& GetNodes() const { return m_nodes; }
+    const std::vector<uint32_t>& GetPrimitiveIndices() const { return m_indices; }
+
+private:
+    std::vector<BvhNode> m_nodes;
+    std::vector<uint32_t> m_indices;
+};
+
+#endif
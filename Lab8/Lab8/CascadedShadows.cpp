@@ -0,0 +1,334 @@
+#include "CascadedShadows.h"
+#include "Profiler.h"
+#include "SoftwareRasterizer.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace
+{
+    float Dot3(const XMFLOAT3& a, const XMFLOAT3& b)
+    {
+        return a.x * b.x + a.y * b.y + a.z * b.z;
+    }
+
+    XMFLOAT3 Cross3(const XMFLOAT3& a, const XMFLOAT3& b)
+    {
+        return XMFLOAT3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+    }
+
+    XMFLOAT3 Normalize3(const XMFLOAT3& a)
+    {
+        float invLength = 1.0f / sqrtf(Dot3(a, a));
+        return XMFLOAT3(a.x * invLength, a.y * invLength, a.z * invLength);
+    }
+
+    // Padding lanes reach nowhere: no distance is below a negative reach
+    const float PaddingRadius = -1.0e30f;
+}
+
+// std::min binds the constant by reference, it needs storage
+const uint32_t CascadedShadows::MaxCascades;
+
+CascadedShadows::CascadedShadows()
+    : m_settings{ 4, 0.75f, 60.0f, 2048 },
+    m_cascadeCount(0),
+    m_cascades(),
+    m_lightAxes(),
+    m_casterCount(0),
+    m_casterNear(),
+    m_stats()
+{
+}
+
+void CascadedShadows::ComputeSplits(float nearZ, float farZ, uint32_t count, float lambda, float* pSplits)
+{
+    for (uint32_t i = 1; i <= count; i++)
+    {
+        float fraction = static_cast<float>(i) / count;
+        float logarithmic = nearZ * powf(farZ / nearZ, fraction);
+        float uniform = nearZ + (farZ - nearZ) * fraction;
+        pSplits[i - 1] = uniform + (logarithmic - uniform) * lambda;
+    }
+    pSplits[count - 1] = farZ;
+}
+
+void CascadedShadows::Update(const XMFLOAT4X4& view, const XMFLOAT4X4& proj, const XMFLOAT3& lightDirection,
+    const ShadowCaster* pCasters, uint32_t casterCount)
+{
+    PROFILE_SCOPE("Cascades");
+
+    uint64_t start = Profiler::NowNs();
+    FitCascades(view, proj, lightDirection);
+    LoadCasters(pCasters, casterCount);
+    CullSimd();
+    FinishCascades();
+    m_stats.updateMs = (Profiler::NowNs() - start) * 1.0e-6;
+}
+
+void CascadedShadows::FitCascades(const XMFLOAT4X4& view, const XMFLOAT4X4& proj, const XMFLOAT3& lightDirection)
+{
+    m_cascadeCount = std::min(std::max(m_settings.cascadeCount, 1u), MaxCascades);
+
+    // Planes and slopes of XMMatrixPerspectiveFovLH
+    float nearZ = -proj._43 / proj._33;
+    float farZ = proj._33 * nearZ / (proj._33 - 1.0f);
+    float shadowFar = m_settings.shadowDistance > nearZ ? std::min(m_settings.shadowDistance, farZ) : farZ;
+    float tanX = 1.0f / proj._11;
+    float tanY = 1.0f / proj._22;
+    float slopeSquared = tanX * tanX + tanY * tanY;
+
+    float splits[MaxCascades];
+    ComputeSplits(nearZ, shadowFar, m_cascadeCount, m_settings.splitLambda, splits);
+
+    // The view matrix is rigid: its rotation transposed takes view space back to the world
+    XMFLOAT3 forward(view._13, view._23, view._33);
+    XMFLOAT3 eye(
+        -(view._41 * view._11 + view._42 * view._12 + view._43 * view._13),
+        -(view._41 * view._21 + view._42 * view._22 + view._43 * view._23),
+        -(view._41 * view._31 + view._42 * view._32 + view._43 * view._33));
+
+    // Light space depends on the light only, so texel snapping holds from frame to frame
+    XMFLOAT3 direction = Normalize3(lightDirection);
+    XMFLOAT3 reference = fabsf(direction.y) < 0.99f ? XMFLOAT3(0.0f, 1.0f, 0.0f) : XMFLOAT3(1.0f, 0.0f, 0.0f);
+    XMFLOAT3 right = Normalize3(Cross3(reference, direction));
+    m_lightAxes[0] = right;
+    m_lightAxes[1] = Cross3(direction, right);
+    m_lightAxes[2] = direction;
+
+    for (uint32_t i = 0; i < m_cascadeCount; i++)
+    {
+        ShadowCascade& cascade = m_cascades[i];
+        cascade.splitNear = i == 0 ? nearZ : splits[i - 1];
+        cascade.splitFar = splits[i];
+
+        // Sphere centre on the view axis at the same distance from the near and the far
+        // corners of the slice, or at the far plane when the slice is too deep for that.
+        // The radius is rounded up so float noise cannot change the texel size.
+        float centerDepth = std::min(0.5f * (cascade.splitNear + cascade.splitFar) * (1.0f + slopeSquared), cascade.splitFar);
+        float farOffset = cascade.splitFar - centerDepth;
+        float radius = sqrtf(farOffset * farOffset + cascade.splitFar * cascade.splitFar * slopeSquared);
+        cascade.radius = ceilf(radius * 16.0f) / 16.0f;
+        cascade.center = XMFLOAT3(eye.x + forward.x * centerDepth, eye.y + forward.y * centerDepth, eye.z + forward.z * centerDepth);
+
+        float texel = 2.0f * cascade.radius / m_settings.mapSize;
+        cascade.lightCenter = XMFLOAT3(
+            floorf(Dot3(cascade.center, m_lightAxes[0]) / texel) * texel,
+            floorf(Dot3(cascade.center, m_lightAxes[1]) / texel) * texel,
+            Dot3(cascade.center, m_lightAxes[2]));
+    }
+}
+
+void CascadedShadows::LoadCasters(const ShadowCaster* pCasters, uint32_t casterCount)
+{
+    m_casterCount = casterCount;
+    uint32_t padded = (casterCount + 3) & ~3u;
+    m_x.assign(padded, 0.0f);
+    m_y.assign(padded, 0.0f);
+    m_z.assign(padded, 0.0f);
+    m_radius.assign(padded, PaddingRadius);
+    for (uint32_t i = 0; i < casterCount; i++)
+    {
+        m_x[i] = pCasters[i].center.x;
+        m_y[i] = pCasters[i].center.y;
+        m_z[i] = pCasters[i].center.z;
+        m_radius[i] = pCasters[i].radius;
+    }
+}
+
+void CascadedShadows::CullSimd()
+{
+    const SwFloat3 right(m_lightAxes[0].x, m_lightAxes[0].y, m_lightAxes[0].z);
+    const SwFloat3 up(m_lightAxes[1].x, m_lightAxes[1].y, m_lightAxes[1].z);
+    const SwFloat3 direction(m_lightAxes[2].x, m_lightAxes[2].y, m_lightAxes[2].z);
+    const SwFloat none(FLT_MAX);
+
+    SwFloat centerX[MaxCascades];
+    SwFloat centerY[MaxCascades];
+    SwFloat depthFar[MaxCascades];
+    SwFloat radius[MaxCascades];
+    SwFloat casterNear[MaxCascades];
+    for (uint32_t c = 0; c < m_cascadeCount; c++)
+    {
+        centerX[c] = SwFloat(m_cascades[c].lightCenter.x);
+        centerY[c] = SwFloat(m_cascades[c].lightCenter.y);
+        depthFar[c] = SwFloat(m_cascades[c].lightCenter.z + m_cascades[c].radius);
+        radius[c] = SwFloat(m_cascades[c].radius);
+        casterNear[c] = none;
+        m_cascadeCasters[c].clear();
+    }
+
+    // Every caster is read once; each cascade appends the lanes that pass its test
+    for (uint32_t i = 0; i < m_x.size(); i += 4)
+    {
+        SwFloat3 position(_mm_loadu_ps(&m_x[i]), _mm_loadu_ps(&m_y[i]), _mm_loadu_ps(&m_z[i]));
+        SwFloat casterRadius(_mm_loadu_ps(&m_radius[i]));
+        SwFloat x = Dot(position, right);
+        SwFloat y = Dot(position, up);
+        SwFloat nearest = Dot(position, direction) - casterRadius;
+        for (uint32_t c = 0; c < m_cascadeCount; c++)
+        {
+            SwFloat reach = radius[c] + casterRadius;
+            SwFloat inside = _mm_and_ps(_mm_and_ps(
+                _mm_cmple_ps(Abs(x - centerX[c]).v, reach.v),
+                _mm_cmple_ps(Abs(y - centerY[c]).v, reach.v)),
+                _mm_cmple_ps(nearest.v, depthFar[c].v));
+            int mask = _mm_movemask_ps(inside.v);
+            if (mask == 0)
+                continue;
+
+            casterNear[c] = Min(casterNear[c], Select(inside, nearest, none));
+            while (mask)
+            {
+                int lane = 0;
+                while (!(mask & (1 << lane)))
+                    lane++;
+                mask &= mask - 1;
+                m_cascadeCasters[c].push_back(i + lane);
+            }
+        }
+    }
+
+    for (uint32_t c = 0; c < m_cascadeCount; c++)
+    {
+        alignas(16) float lanes[4];
+        _mm_store_ps(lanes, casterNear[c].v);
+        m_casterNear[c] = std::min(std::min(lanes[0], lanes[1]), std::min(lanes[2], lanes[3]));
+    }
+}
+
+void CascadedShadows::CullScalar()
+{
+    for (uint32_t c = 0; c < m_cascadeCount; c++)
+    {
+        m_casterNear[c] = FLT_MAX;
+        m_cascadeCasters[c].clear();
+    }
+
+    for (uint32_t i = 0; i < m_casterCount; i++)
+    {
+        XMFLOAT3 position(m_x[i], m_y[i], m_z[i]);
+        float x = Dot3(position, m_lightAxes[0]);
+        float y = Dot3(position, m_lightAxes[1]);
+        float nearest = Dot3(position, m_lightAxes[2]) - m_radius[i];
+        for (uint32_t c = 0; c < m_cascadeCount; c++)
+        {
+            const ShadowCascade& cascade = m_cascades[c];
+            float reach = cascade.radius + m_radius[i];
+            if (fabsf(x - cascade.lightCenter.x) > reach || fabsf(y - cascade.lightCenter.y) > reach ||
+                nearest > cascade.lightCenter.z + cascade.radius)
+                continue;
+            m_casterNear[c] = std::min(m_casterNear[c], nearest);
+            m_cascadeCasters[c].push_back(i);
+        }
+    }
+}
+
+void CascadedShadows::FinishCascades()
+{
+    m_casters.clear();
+    m_stats.casters = m_casterCount;
+    for (uint32_t c = 0; c < m_cascadeCount; c++)
+    {
+        ShadowCascade& cascade = m_cascades[c];
+        cascade.firstCaster = static_cast<uint32_t>(m_casters.size());
+        cascade.casterCount = static_cast<uint32_t>(m_cascadeCasters[c].size());
+        m_casters.insert(m_casters.end(), m_cascadeCasters[c].begin(), m_cascadeCasters[c].end());
+
+        cascade.depthNear = std::min(cascade.lightCenter.z - cascade.radius, m_casterNear[c]);
+        cascade.depthFar = cascade.lightCenter.z + cascade.radius;
+
+        // Light view and orthographic projection in one matrix: x and y over the sphere,
+        // z from the nearest caster to the far side of the sphere
+        float scaleXY = 1.0f / cascade.radius;
+        float scaleZ = 1.0f / (cascade.depthFar - cascade.depthNear);
+        const XMFLOAT3& right = m_lightAxes[0];
+        const XMFLOAT3& up = m_lightAxes[1];
+        const XMFLOAT3& direction = m_lightAxes[2];
+        cascade.viewProj = XMFLOAT4X4(
+            right.x * scaleXY, up.x * scaleXY, direction.x * scaleZ, 0.0f,
+            right.y * scaleXY, up.y * scaleXY, direction.y * scaleZ, 0.0f,
+            right.z * scaleXY, up.z * scaleXY, direction.z * scaleZ, 0.0f,
+            -cascade.lightCenter.x * scaleXY, -cascade.lightCenter.y * scaleXY, -cascade.depthNear * scaleZ, 1.0f);
+    }
+    m_stats.casterReferences = static_cast<uint32_t>(m_casters.size());
+}
+
+CascadeBenchmarkResult CascadedShadows::Benchmark(uint32_t casterCount, uint32_t cascadeCount)
+{
+    std::vector<ShadowCaster> casters(casterCount);
+    uint32_t seed = 12345;
+    auto next = [&seed]()
+    {
+        seed = seed * 1664525u + 1013904223u;
+        return (seed >> 8) * (1.0f / 16777216.0f);
+    };
+    for (ShadowCaster& caster : casters)
+    {
+        caster = {};
+        caster.center = XMFLOAT3(next() * 200.0f - 100.0f, next() * 40.0f - 20.0f, next() * 200.0f - 100.0f);
+        caster.radius = 0.5f + next() * 1.5f;
+    }
+
+    // Camera at the origin looking down +z, as XMMatrixPerspectiveFovLH(pi / 4, 16 / 9, 0.1, 100) builds it
+    float yScale = 1.0f / tanf(XM_PIDIV4 * 0.5f);
+    float nearZ = 0.1f;
+    float farZ = 100.0f;
+    XMFLOAT4X4 view(
+        1.0f, 0.0f, 0.0f, 0.0f,
+        0.0f, 1.0f, 0.0f, 0.0f,
+        0.0f, 0.0f, 1.0f, 0.0f,
+        0.0f, 0.0f, 0.0f, 1.0f);
+    XMFLOAT4X4 proj(
+        yScale * 9.0f / 16.0f, 0.0f, 0.0f, 0.0f,
+        0.0f, yScale, 0.0f, 0.0f,
+        0.0f, 0.0f, farZ / (farZ - nearZ), 1.0f,
+        0.0f, 0.0f, -nearZ * farZ / (farZ - nearZ), 0.0f);
+    XMFLOAT3 lightDirection(0.3f, -1.0f, 0.4f);
+
+    CascadedShadows cascades;
+    CascadeSettings settings = cascades.GetSettings();
+    settings.cascadeCount = cascadeCount;
+    cascades.SetSettings(settings);
+
+    const uint32_t fitIterations = 1000;
+    uint64_t start = Profiler::NowNs();
+    for (uint32_t i = 0; i < fitIterations; i++)
+        cascades.FitCascades(view, proj, lightDirection);
+    uint64_t fitDone = Profiler::NowNs();
+    cascades.LoadCasters(casters.data(), casterCount);
+
+    uint64_t scalarStart = Profiler::NowNs();
+    cascades.CullScalar();
+    uint64_t scalarDone = Profiler::NowNs();
+    std::vector<uint32_t> scalarLists[MaxCascades];
+    float scalarNear[MaxCascades];
+    for (uint32_t c = 0; c < cascades.m_cascadeCount; c++)
+    {
+        scalarLists[c] = cascades.m_cascadeCasters[c];
+        scalarNear[c] = cascades.m_casterNear[c];
+    }
+
+    uint64_t simdStart = Profiler::NowNs();
+    cascades.CullSimd();
+    uint64_t simdDone = Profiler::NowNs();
+    cascades.FinishCascades();
+
+    CascadeBenchmarkResult result = {};
+    result.casterCount = casterCount;
+    result.cascadeCount = cascades.m_cascadeCount;
+    result.fitUs = (fitDone - start) * 1.0e-3 / fitIterations;
+    result.scalarMs = (scalarDone - scalarStart) * 1.0e-6;
+    result.simdMs = (simdDone - simdStart) * 1.0e-6;
+    result.references = cascades.GetStats().casterReferences;
+    for (uint32_t c = 0; c < cascades.m_cascadeCount; c++)
+    {
+        const std::vector<uint32_t>& simdList = cascades.m_cascadeCasters[c];
+        size_t common = std::min(simdList.size(), scalarLists[c].size());
+        result.mismatches += static_cast<uint32_t>(std::max(simdList.size(), scalarLists[c].size()) - common);
+        for (size_t i = 0; i < common; i++)
+            result.mismatches += simdList[i] != scalarLists[c][i] ? 1 : 0;
+        result.mismatches += scalarNear[c] != cascades.m_casterNear[c] ? 1 : 0;
+    }
+    return result;
+}
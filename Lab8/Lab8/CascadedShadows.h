@@ -0,0 +1,120 @@
+#ifndef CASCADED_SHADOWS_H
+#define CASCADED_SHADOWS_H
+
+#include <DirectXMath.h>
+#include <cstdint>
+#include <vector>
+
+#include "ShadowAtlas.h"
+
+using namespace DirectX;
+
+struct CascadeSettings
+{
+    uint32_t cascadeCount;      // 1 to CascadedShadows::MaxCascades
+    float splitLambda;          // 0 uniform splits, 1 logarithmic
+    float shadowDistance;       // end of the last cascade, clamped to the camera far plane
+    uint32_t mapSize;           // texels along one side of a cascade, the snapping step
+};
+
+struct ShadowCascade
+{
+    float splitNear;            // view space depth range of the frustum slice
+    float splitFar;
+    XMFLOAT3 center;            // bounding sphere of the slice, world space
+    float radius;
+    XMFLOAT3 lightCenter;       // the same centre in light space, snapped to texels
+    float depthNear;            // light space depth range, near pulled back to the casters
+    float depthFar;
+    XMFLOAT4X4 viewProj;        // row-vector, not transposed
+    uint32_t firstCaster;       // range in GetCasters
+    uint32_t casterCount;
+};
+
+// Layout of CascadeBuffer in CascadedShadows.hlsli, matrices transposed for HLSL
+struct CascadeConstants
+{
+    XMFLOAT4X4 viewProj[4];
+    XMFLOAT4 splits;            // far depth of each cascade
+    XMFLOAT4 sunDirection;      // towards the sun, cascade count in w, 0 without the sun
+    XMFLOAT4 sunColor;          // color * intensity
+};
+
+struct CascadeStats
+{
+    uint32_t casters;
+    uint32_t casterReferences;  // summed over all cascades
+    double updateMs;
+};
+
+struct CascadeBenchmarkResult
+{
+    uint32_t casterCount;
+    uint32_t cascadeCount;
+    double fitUs;               // splits, spheres and matrices
+    double scalarMs;            // one caster against one cascade at a time
+    double simdMs;              // four casters per SSE register, all cascades in one pass
+    uint32_t references;
+    uint32_t mismatches;        // list entries the two cullers disagree on, 0 expected
+};
+
+// Cascaded shadow maps for one directional light. The camera depth range is split with
+// the practical scheme, a blend of uniform and logarithmic splits. Each cascade covers the
+// bounding sphere of its frustum slice, so its size does not change when the camera turns,
+// and the sphere centre is snapped to whole shadow map texels in a fixed light space, so
+// the shadow edges do not crawl when the camera moves.
+// Casters are culled against all cascades in one pass over the scene, four at a time.
+// A cascade clips them sideways and behind its far plane only: anything between it and the
+// light can still throw a shadow into it, so the near plane is pulled back to the casters.
+class CascadedShadows
+{
+public:
+    static const uint32_t MaxCascades = 4;
+
+    CascadedShadows();
+
+    void SetSettings(const CascadeSettings& settings) { m_settings = settings; }
+    const CascadeSettings& GetSettings() const { return m_settings; }
+
+    // proj is a D3D left-handed perspective projection, lightDirection the way the light travels
+    void Update(const XMFLOAT4X4& view, const XMFLOAT4X4& proj, const XMFLOAT3& lightDirection,
+        const ShadowCaster* pCasters, uint32_t casterCount);
+
+    uint32_t GetCascadeCount() const { return m_cascadeCount; }
+    const ShadowCascade& GetCascade(uint32_t index) const { return m_cascades[index]; }
+    // Indices into the casters passed to Update, cascade by cascade
+    const std::vector<uint32_t>& GetCasters() const { return m_casters; }
+    const CascadeStats& GetStats() const { return m_stats; }
+
+    // Far depth of each split between nearZ and farZ, pSplits receives count values
+    static void ComputeSplits(float nearZ, float farZ, uint32_t count, float lambda, float* pSplits);
+
+    // Random casters around a fixed camera, checks the SIMD lists against the scalar ones
+    static CascadeBenchmarkResult Benchmark(uint32_t casterCount, uint32_t cascadeCount);
+
+private:
+    void FitCascades(const XMFLOAT4X4& view, const XMFLOAT4X4& proj, const XMFLOAT3& lightDirection);
+    void LoadCasters(const ShadowCaster* pCasters, uint32_t casterCount);
+    void CullSimd();
+    void CullScalar();
+    void FinishCascades();
+
+    CascadeSettings m_settings;
+    uint32_t m_cascadeCount;
+    ShadowCascade m_cascades[MaxCascades];
+    XMFLOAT3 m_lightAxes[3];    // right, up and the light direction in world space
+
+    // Light space SoA copy of the casters, padded to four with lanes that touch nothing
+    std::vector<float> m_x;
+    std::vector<float> m_y;
+    std::vector<float> m_z;
+    std::vector<float> m_radius;
+    uint32_t m_casterCount;
+
+    std::vector<uint32_t> m_cascadeCasters[MaxCascades];
+    float m_casterNear[MaxCascades];    // nearest light space depth of the culled casters
+    std::vector<uint32_t> m_casters;
+    CascadeStats m_stats;
+};
+
+#endif
@@ -0,0 +1,36 @@
+// Sun light with cascaded shadows, the cascades fitted by CascadedShadows on the CPU.
+// Uses shadowSampler of ShadowAtlas.hlsli, which must be included first.
+
+cbuffer CascadeBuffer : register(b6)
+{
+    float4x4 cascadeViewProj[4];
+    float4 cascadeSplits;       // far depth of each cascade
+    float4 sunDirection;        // towards the sun, cascade count in w
+    float4 sunColor;            // color * intensity
+};
+
+Texture2DArray<float> cascadeShadowMap : register(t10);
+
+bool SunEnabled()
+{
+    return sunDirection.w > 0.0f;
+}
+
+// 1 lit, 0 shadowed. Cascades go from near to far, the first one that holds the pixel wins
+float CalculateSunShadow(float3 worldPos)
+{
+    float3 mapSize;
+    cascadeShadowMap.GetDimensions(mapSize.x, mapSize.y, mapSize.z);
+    float2 texel = 1.0f / mapSize.xy;
+
+    uint cascadeCount = (uint)sunDirection.w;
+    for (uint i = 0; i < cascadeCount; i++)
+    {
+        float3 ndc = mul(float4(worldPos, 1.0f), cascadeViewProj[i]).xyz;
+        float2 uv = ndc.xy * float2(0.5f, -0.5f) + 0.5f;
+        // One texel inside the edge, so filtering never reads past the cascade
+        if (all(uv >= texel) && all(uv <= 1.0f - texel) && ndc.z <= 1.0f)
+            return cascadeShadowMap.SampleCmpLevelZero(shadowSampler, float3(uv, i), ndc.z);
+    }
+    return 1.0f;
+}
@@ -0,0 +1,33 @@
+// Point lights assigned to view frustum clusters by LightClusterGrid on the CPU
+
+struct PointLight
+{
+    float3 Position;
+    float Range;
+    float3 Color;
+    float Intensity;
+    int ShadowIndex;        // entry in shadowLights of ShadowAtlas.hlsli, -1 without a shadow
+    float3 Padding;
+};
+
+cbuffer ClusterBuffer : register(b2)
+{
+    uint3 clusterGrid;
+    float clusterDepthScale;
+    float clusterDepthBias;
+    float2 clusterScreenScale;
+    uint clusterLightCount;
+};
+
+StructuredBuffer<PointLight> pointLights : register(t2);
+StructuredBuffer<uint2> clusterRanges : register(t3);
+StructuredBuffer<uint> clusterLightIndices : register(t4);
+
+// (offset, count) into clusterLightIndices for the pixel; w of SV_Position is the view depth
+uint2 GetClusterLightRange(float4 svPosition)
+{
+    uint2 tile = min(uint2(svPosition.xy * clusterScreenScale), clusterGrid.xy - 1);
+    float slice = log(svPosition.w) * clusterDepthScale + clusterDepthBias;
+    uint z = (uint)clamp(slice, 0.0f, (float)(clusterGrid.z - 1));
+    return clusterRanges[(z * clusterGrid.y + tile.y) * clusterGrid.x + tile.x];
+}
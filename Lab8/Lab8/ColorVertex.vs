@@ -4,6 +4,8 @@ struct InstanceData
 {
     float4x4 model;
     uint texInd;
+    uint countInstance;
+    uint lightmapSlice;
 };
 
 cbuffer ModelBufferInst : register(b0)
@@ -11,6 +13,9 @@ cbuffer ModelBufferInst : register(b0)
     InstanceData modelBuffer[MAX_INSTANCES];
 };
 
+// Cube ids written by the culling compute shader; SV_InstanceID indexes this list
+StructuredBuffer<uint> visibleIds : register(t0);
+
 cbuffer CameraBuffer : register(b1)
 {
     matrix vp;
@@ -34,16 +39,20 @@ struct PS_INPUT
     float3 Bitangent : TEXCOORD4;
     float3 CameraPos : TEXCOORD5;
     uint TexInd : TEXCOORD6;
+    float2 LightmapUV : TEXCOORD7;
+    uint2 LightmapTile : TEXCOORD8;
+    uint InstanceID : TEXCOORD9;
 };
 
-PS_INPUT main(VS_INPUT input, uint instanceID : SV_InstanceID)
+PS_INPUT main(VS_INPUT input, uint instanceID : SV_InstanceID, uint vertexID : SV_VertexID)
 {
     PS_INPUT output;
-    
-    float4 worldPos = mul(float4(input.Pos, 1.0f), modelBuffer[instanceID].model);
+
+    uint objectID = visibleIds[instanceID];
+    float4 worldPos = mul(float4(input.Pos, 1.0f), modelBuffer[objectID].model);
     output.WorldPos = worldPos.xyz;
     output.Pos = mul(worldPos, vp);
-    output.Normal = mul(input.Normal, (float3x3)modelBuffer[instanceID].model);
+    output.Normal = mul(input.Normal, (float3x3)modelBuffer[objectID].model);
     output.TexCoord = input.TexCoord;
     output.CameraPos = CameraPos;
 
@@ -58,8 +67,14 @@ PS_INPUT main(VS_INPUT input, uint instanceID : SV_InstanceID)
     }
 
     float3 bitangent = cross(input.Normal, tangent);
-    output.Tangent = mul(tangent, (float3x3)modelBuffer[instanceID].model);
-    output.Bitangent = mul(bitangent, (float3x3)modelBuffer[instanceID].model);
-    output.TexInd = modelBuffer[instanceID].texInd;
+    output.Tangent = mul(tangent, (float3x3)modelBuffer[objectID].model);
+    output.Bitangent = mul(bitangent, (float3x3)modelBuffer[objectID].model);
+    output.TexInd = modelBuffer[objectID].texInd;
+
+    // Lightmap atlas tile: four vertices per face, one array slice per cube
+    output.LightmapUV = input.TexCoord;
+    output.LightmapTile = uint2(vertexID / 4, modelBuffer[objectID].lightmapSlice);
+    // Per-instance tables in the pixel shader are indexed by cube id
+    output.InstanceID = objectID;
     return output;
 }
\ No newline at end of file
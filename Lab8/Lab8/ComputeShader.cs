@@ -8,7 +8,8 @@ struct InstanceData
     float4x4 model; 
     uint texInd; 
     uint countInstance; 
-    float2 padding; // 
+    uint lightmapSlice;
+    uint padding; // 
 };
 
 StructuredBuffer<InstanceData> instanceData : register(t0); 
@@ -0,0 +1,525 @@
+#include "D3D11RenderBackend.h"
+#include <cstring>
+
+namespace
+{
+    template <typename T>
+    void SafeAddRef(T* pObject)
+    {
+        if (pObject) pObject->AddRef();
+    }
+
+    template <typename T>
+    void SafeRelease(T*& pObject)
+    {
+        if (pObject) pObject->Release();
+        pObject = nullptr;
+    }
+}
+
+D3D11RenderBackend::D3D11RenderBackend()
+    : m_pDevice(nullptr),
+    m_pContext(nullptr),
+    m_pProfiler(nullptr)
+{
+}
+
+D3D11RenderBackend::~D3D11RenderBackend()
+{
+    Terminate();
+}
+
+void D3D11RenderBackend::Init(ID3D11Device* pDevice, ID3D11DeviceContext* pContext)
+{
+    m_pDevice = pDevice;
+    m_pContext = pContext;
+}
+
+void D3D11RenderBackend::Terminate()
+{
+    for (auto& entry : m_buffers)
+        ReleaseEntry(entry);
+    m_buffers.clear();
+
+    for (auto& pipeline : m_pipelines)
+    {
+        SafeRelease(pipeline.pVertexShader);
+        SafeRelease(pipeline.pPixelShader);
+        SafeRelease(pipeline.pInputLayout);
+        SafeRelease(pipeline.pBlendState);
+        SafeRelease(pipeline.pDepthStencilState);
+        SafeRelease(pipeline.pRasterizerState);
+        SafeRelease(pipeline.pSampler);
+        SafeRelease(pipeline.pComputeShader);
+    }
+    m_pipelines.clear();
+
+    for (auto& pSampler : m_samplers)
+        SafeRelease(pSampler);
+    m_samplers.clear();
+
+    for (auto& pView : m_textures)
+        SafeRelease(pView);
+    m_textures.clear();
+
+    for (auto& target : m_targets)
+    {
+        SafeRelease(target.pColor);
+        SafeRelease(target.pDepth);
+    }
+    m_targets.clear();
+
+    m_pDevice = nullptr;
+    m_pContext = nullptr;
+    m_pProfiler = nullptr;
+}
+
+BackendHandle D3D11RenderBackend::RegisterBuffer(ID3D11Buffer* pBuffer, const BufferDesc& desc,
+    ID3D11ShaderResourceView* pView, ID3D11UnorderedAccessView* pUnorderedView)
+{
+    SafeAddRef(pBuffer);
+    SafeAddRef(pView);
+    SafeAddRef(pUnorderedView);
+
+    BufferEntry entry = { pBuffer, pView, pUnorderedView, desc };
+    m_buffers.push_back(entry);
+    CountBufferCreated(desc.size);
+    return static_cast<BackendHandle>(m_buffers.size());
+}
+
+BackendHandle D3D11RenderBackend::RegisterPipeline(const D3D11PipelineDesc& desc)
+{
+    SafeAddRef(desc.pVertexShader);
+    SafeAddRef(desc.pPixelShader);
+    SafeAddRef(desc.pInputLayout);
+    SafeAddRef(desc.pBlendState);
+    SafeAddRef(desc.pDepthStencilState);
+    SafeAddRef(desc.pRasterizerState);
+    SafeAddRef(desc.pSampler);
+    SafeAddRef(desc.pComputeShader);
+
+    m_pipelines.push_back(desc);
+    m_stats.pipelinesCreated++;
+    return static_cast<BackendHandle>(m_pipelines.size());
+}
+
+BackendHandle D3D11RenderBackend::RegisterSampler(ID3D11SamplerState* pSampler)
+{
+    SafeAddRef(pSampler);
+    m_samplers.push_back(pSampler);
+    return static_cast<BackendHandle>(m_samplers.size());
+}
+
+BackendHandle D3D11RenderBackend::RegisterTexture(ID3D11ShaderResourceView* pView)
+{
+    SafeAddRef(pView);
+
+    // Reuse a free slot so targets that are recreated on resize do not grow the table
+    for (size_t i = 0; i < m_textures.size(); i++)
+    {
+        if (!m_textures[i])
+        {
+            m_textures[i] = pView;
+            return static_cast<BackendHandle>(i + 1);
+        }
+    }
+
+    m_textures.push_back(pView);
+    return static_cast<BackendHandle>(m_textures.size());
+}
+
+void D3D11RenderBackend::UnregisterTexture(BackendHandle texture)
+{
+    if (texture != InvalidBackendHandle && texture <= m_textures.size())
+        SafeRelease(m_textures[texture - 1]);
+}
+
+BackendHandle D3D11RenderBackend::RegisterTarget(ID3D11RenderTargetView* pColor, ID3D11DepthStencilView* pDepth)
+{
+    SafeAddRef(pColor);
+    SafeAddRef(pDepth);
+
+    // The back buffer and the graph targets come back on every resize, like textures
+    TargetEntry entry = { pColor, pDepth };
+    for (size_t i = 0; i < m_targets.size(); i++)
+    {
+        if (!m_targets[i].pColor && !m_targets[i].pDepth)
+        {
+            m_targets[i] = entry;
+            return static_cast<BackendHandle>(i + 1);
+        }
+    }
+
+    m_targets.push_back(entry);
+    return static_cast<BackendHandle>(m_targets.size());
+}
+
+void D3D11RenderBackend::UnregisterTarget(BackendHandle target)
+{
+    if (target == InvalidBackendHandle || target > m_targets.size())
+        return;
+
+    SafeRelease(m_targets[target - 1].pColor);
+    SafeRelease(m_targets[target - 1].pDepth);
+}
+
+BackendHandle D3D11RenderBackend::CreateBuffer(const BufferDesc& desc, const void* pInitialData)
+{
+    if (!m_pDevice)
+        return InvalidBackendHandle;
+
+    D3D11_BUFFER_DESC bd = {};
+    bd.ByteWidth = desc.size;
+    bd.Usage = desc.dynamic ? D3D11_USAGE_DYNAMIC : D3D11_USAGE_DEFAULT;
+    bd.CPUAccessFlags = desc.dynamic ? D3D11_CPU_ACCESS_WRITE : 0;
+    switch (desc.kind)
+    {
+    case BufferKind::Vertex: bd.BindFlags = D3D11_BIND_VERTEX_BUFFER; break;
+    case BufferKind::Index: bd.BindFlags = D3D11_BIND_INDEX_BUFFER; break;
+    case BufferKind::Constant: bd.BindFlags = D3D11_BIND_CONSTANT_BUFFER; break;
+    case BufferKind::Structured:
+        // Dynamic buffers cannot be written by the GPU, so they only get a shader view
+        bd.BindFlags = desc.dynamic ? D3D11_BIND_SHADER_RESOURCE : D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS;
+        bd.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+        bd.StructureByteStride = desc.stride;
+        break;
+    case BufferKind::Arguments:
+        bd.Usage = D3D11_USAGE_DEFAULT;
+        bd.CPUAccessFlags = 0;
+        bd.BindFlags = D3D11_BIND_UNORDERED_ACCESS;
+        bd.MiscFlags = D3D11_RESOURCE_MISC_DRAWINDIRECT_ARGS | D3D11_RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS;
+        break;
+    case BufferKind::Readback:
+        bd.Usage = D3D11_USAGE_STAGING;
+        bd.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+        break;
+    }
+
+    D3D11_SUBRESOURCE_DATA initData = {};
+    initData.pSysMem = pInitialData;
+
+    ID3D11Buffer* pBuffer = nullptr;
+    HRESULT hr = m_pDevice->CreateBuffer(&bd, pInitialData ? &initData : nullptr, &pBuffer);
+    if (FAILED(hr))
+        return InvalidBackendHandle;
+
+    BufferEntry entry = { pBuffer, nullptr, nullptr, desc };
+    if (FAILED(CreateBufferViews(entry)))
+    {
+        ReleaseEntry(entry);
+        return InvalidBackendHandle;
+    }
+    m_buffers.push_back(entry);
+    CountBufferCreated(desc.size);
+    if (pInitialData)
+    {
+        m_stats.uploads++;
+        m_stats.bytesUploaded += desc.size;
+    }
+    return static_cast<BackendHandle>(m_buffers.size());
+}
+
+void D3D11RenderBackend::ReleaseBuffer(BackendHandle buffer)
+{
+    if (!GetBuffer(buffer))
+        return;
+
+    BufferEntry& entry = m_buffers[buffer - 1];
+    ReleaseEntry(entry);
+    CountBufferReleased(entry.desc.size);
+}
+
+void D3D11RenderBackend::UpdateBuffer(BackendHandle buffer, const void* pData, uint32_t size)
+{
+    ID3D11Buffer* pBuffer = GetBuffer(buffer);
+    if (!pBuffer || size > m_buffers[buffer - 1].desc.size)
+        return;
+
+    const BufferDesc& desc = m_buffers[buffer - 1].desc;
+    if (desc.dynamic)
+    {
+        D3D11_MAPPED_SUBRESOURCE mapped;
+        if (FAILED(m_pContext->Map(pBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+            return;
+        memcpy(mapped.pData, pData, size);
+        m_pContext->Unmap(pBuffer, 0);
+    }
+    else if (desc.kind == BufferKind::Constant)
+    {
+        // D3D11.0 only updates constant buffers whole: a short write is padded with zeros
+        // instead of letting UpdateSubresource read past the end of pData
+        if (size < desc.size)
+        {
+            m_constantScratch.assign(desc.size, 0);
+            memcpy(m_constantScratch.data(), pData, size);
+            pData = m_constantScratch.data();
+        }
+        m_pContext->UpdateSubresource(pBuffer, 0, nullptr, pData, 0, 0);
+    }
+    else
+    {
+        D3D11_BOX box = { 0, 0, 0, size, 1, 1 };
+        m_pContext->UpdateSubresource(pBuffer, 0, &box, pData, 0, 0);
+    }
+
+    m_stats.uploads++;
+    m_stats.bytesUploaded += size;
+}
+
+void D3D11RenderBackend::CopyBuffer(BackendHandle destination, BackendHandle source)
+{
+    ID3D11Buffer* pDestination = GetBuffer(destination);
+    ID3D11Buffer* pSource = GetBuffer(source);
+    if (pDestination && pSource)
+        m_pContext->CopyResource(pDestination, pSource);
+}
+
+bool D3D11RenderBackend::ReadBuffer(BackendHandle buffer, void* pData, uint32_t size)
+{
+    ID3D11Buffer* pBuffer = GetBuffer(buffer);
+    if (!pBuffer || m_buffers[buffer - 1].desc.kind != BufferKind::Readback || size > m_buffers[buffer - 1].desc.size)
+        return false;
+
+    D3D11_MAPPED_SUBRESOURCE mapped;
+    if (FAILED(m_pContext->Map(pBuffer, 0, D3D11_MAP_READ, 0, &mapped)))
+        return false;
+    memcpy(pData, mapped.pData, size);
+    m_pContext->Unmap(pBuffer, 0);
+    return true;
+}
+
+void D3D11RenderBackend::BindPipeline(BackendHandle pipeline)
+{
+    if (pipeline == InvalidBackendHandle || pipeline > m_pipelines.size())
+        return;
+
+    const D3D11PipelineDesc& desc = m_pipelines[pipeline - 1];
+    if (desc.pComputeShader)
+    {
+        m_pContext->CSSetShader(desc.pComputeShader, nullptr, 0);
+        m_stats.pipelineBinds++;
+        return;
+    }
+
+    m_pContext->VSSetShader(desc.pVertexShader, nullptr, 0);
+    m_pContext->PSSetShader(desc.pPixelShader, nullptr, 0);
+    m_pContext->IASetInputLayout(desc.pInputLayout);
+    m_pContext->IASetPrimitiveTopology(desc.topology);
+    m_pContext->OMSetBlendState(desc.pBlendState, nullptr, 0xFFFFFFFF);
+    m_pContext->OMSetDepthStencilState(desc.pDepthStencilState, 0);
+    m_pContext->RSSetState(desc.pRasterizerState);
+    if (desc.pSampler)
+        m_pContext->PSSetSamplers(0, 1, &desc.pSampler);
+
+    m_stats.pipelineBinds++;
+}
+
+void D3D11RenderBackend::BindVertexBuffer(BackendHandle buffer, uint32_t stride)
+{
+    ID3D11Buffer* pBuffer = GetBuffer(buffer);
+    UINT offset = 0;
+    m_pContext->IASetVertexBuffers(0, 1, &pBuffer, &stride, &offset);
+    m_stats.bufferBinds++;
+}
+
+void D3D11RenderBackend::BindIndexBuffer(BackendHandle buffer)
+{
+    m_pContext->IASetIndexBuffer(GetBuffer(buffer), DXGI_FORMAT_R16_UINT, 0);
+    m_stats.bufferBinds++;
+}
+
+void D3D11RenderBackend::BindConstantBuffer(ShaderStage stage, uint32_t slot, BackendHandle buffer)
+{
+    ID3D11Buffer* pBuffer = GetBuffer(buffer);
+    switch (stage)
+    {
+    case ShaderStage::Vertex: m_pContext->VSSetConstantBuffers(slot, 1, &pBuffer); break;
+    case ShaderStage::Pixel: m_pContext->PSSetConstantBuffers(slot, 1, &pBuffer); break;
+    case ShaderStage::Compute: m_pContext->CSSetConstantBuffers(slot, 1, &pBuffer); break;
+    }
+    m_stats.bufferBinds++;
+}
+
+void D3D11RenderBackend::BindTexture(ShaderStage stage, uint32_t slot, BackendHandle texture)
+{
+    ID3D11ShaderResourceView* pView = nullptr;
+    if (texture != InvalidBackendHandle && texture <= m_textures.size())
+        pView = m_textures[texture - 1];
+    BindShaderResource(stage, slot, pView);
+    m_stats.textureBinds++;
+}
+
+void D3D11RenderBackend::BindStructuredBuffer(ShaderStage stage, uint32_t slot, BackendHandle buffer)
+{
+    ID3D11ShaderResourceView* pView = GetBuffer(buffer) ? m_buffers[buffer - 1].pView : nullptr;
+    BindShaderResource(stage, slot, pView);
+    m_stats.bufferBinds++;
+}
+
+void D3D11RenderBackend::BindUnorderedAccess(uint32_t slot, BackendHandle buffer)
+{
+    ID3D11UnorderedAccessView* pView = GetBuffer(buffer) ? m_buffers[buffer - 1].pUnorderedView : nullptr;
+    m_pContext->CSSetUnorderedAccessViews(slot, 1, &pView, nullptr);
+    m_stats.bufferBinds++;
+}
+
+void D3D11RenderBackend::BindSampler(ShaderStage stage, uint32_t slot, BackendHandle sampler)
+{
+    ID3D11SamplerState* pSampler = nullptr;
+    if (sampler != InvalidBackendHandle && sampler <= m_samplers.size())
+        pSampler = m_samplers[sampler - 1];
+
+    switch (stage)
+    {
+    case ShaderStage::Vertex: m_pContext->VSSetSamplers(slot, 1, &pSampler); break;
+    case ShaderStage::Pixel: m_pContext->PSSetSamplers(slot, 1, &pSampler); break;
+    case ShaderStage::Compute: m_pContext->CSSetSamplers(slot, 1, &pSampler); break;
+    }
+}
+
+void D3D11RenderBackend::BindTarget(BackendHandle target)
+{
+    if (target == InvalidBackendHandle || target > m_targets.size())
+    {
+        m_pContext->OMSetRenderTargets(0, nullptr, nullptr);
+        return;
+    }
+
+    const TargetEntry& entry = m_targets[target - 1];
+    m_pContext->OMSetRenderTargets(entry.pColor ? 1 : 0, entry.pColor ? &entry.pColor : nullptr, entry.pDepth);
+}
+
+void D3D11RenderBackend::ClearColor(BackendHandle target, const float color[4])
+{
+    if (target != InvalidBackendHandle && target <= m_targets.size() && m_targets[target - 1].pColor)
+        m_pContext->ClearRenderTargetView(m_targets[target - 1].pColor, color);
+}
+
+void D3D11RenderBackend::ClearDepth(BackendHandle target, float depth)
+{
+    if (target != InvalidBackendHandle && target <= m_targets.size() && m_targets[target - 1].pDepth)
+        m_pContext->ClearDepthStencilView(m_targets[target - 1].pDepth, D3D11_CLEAR_DEPTH, depth, 0);
+}
+
+void D3D11RenderBackend::SetViewport(float x, float y, float width, float height)
+{
+    D3D11_VIEWPORT viewport = { x, y, width, height, 0.0f, 1.0f };
+    m_pContext->RSSetViewports(1, &viewport);
+}
+
+void D3D11RenderBackend::SetScissor(int32_t left, int32_t top, int32_t right, int32_t bottom)
+{
+    D3D11_RECT rect = { left, top, right, bottom };
+    m_pContext->RSSetScissorRects(1, &rect);
+}
+
+void D3D11RenderBackend::Draw(uint32_t vertexCount)
+{
+    m_pContext->Draw(vertexCount, 0);
+    m_stats.draws++;
+    m_stats.instances++;
+}
+
+void D3D11RenderBackend::DrawIndexed(uint32_t indexCount, uint32_t firstIndex, int32_t baseVertex)
+{
+    m_pContext->DrawIndexed(indexCount, firstIndex, baseVertex);
+    m_stats.draws++;
+    m_stats.instances++;
+}
+
+void D3D11RenderBackend::DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount)
+{
+    m_pContext->DrawIndexedInstanced(indexCount, instanceCount, 0, 0, 0);
+    m_stats.draws++;
+    m_stats.instances += instanceCount;
+}
+
+void D3D11RenderBackend::DrawIndexedInstancedIndirect(BackendHandle arguments)
+{
+    ID3D11Buffer* pBuffer = GetBuffer(arguments);
+    if (!pBuffer)
+        return;
+
+    // The instance count is only known to the GPU
+    m_pContext->DrawIndexedInstancedIndirect(pBuffer, 0);
+    m_stats.draws++;
+}
+
+void D3D11RenderBackend::Dispatch(uint32_t x, uint32_t y, uint32_t z)
+{
+    m_pContext->Dispatch(x, y, z);
+    m_stats.dispatches++;
+}
+
+void D3D11RenderBackend::BeginScope(const char* name)
+{
+    if (m_pProfiler)
+        m_pProfiler->BeginScope(name);
+}
+
+void D3D11RenderBackend::EndScope()
+{
+    if (m_pProfiler)
+        m_pProfiler->EndScope();
+}
+
+ID3D11Buffer* D3D11RenderBackend::GetBuffer(BackendHandle buffer) const
+{
+    if (buffer == InvalidBackendHandle || buffer > m_buffers.size())
+        return nullptr;
+    return m_buffers[buffer - 1].pBuffer;
+}
+
+HRESULT D3D11RenderBackend::CreateBufferViews(BufferEntry& entry)
+{
+    const BufferDesc& desc = entry.desc;
+    HRESULT hr = S_OK;
+    if (desc.kind == BufferKind::Structured && desc.stride > 0)
+    {
+        D3D11_SHADER_RESOURCE_VIEW_DESC viewDesc = {};
+        viewDesc.Format = DXGI_FORMAT_UNKNOWN;
+        viewDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+        viewDesc.Buffer.FirstElement = 0;
+        viewDesc.Buffer.NumElements = desc.size / desc.stride;
+        hr = m_pDevice->CreateShaderResourceView(entry.pBuffer, &viewDesc, &entry.pView);
+
+        if (SUCCEEDED(hr) && !desc.dynamic)
+        {
+            D3D11_UNORDERED_ACCESS_VIEW_DESC unorderedDesc = {};
+            unorderedDesc.Format = DXGI_FORMAT_UNKNOWN;
+            unorderedDesc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
+            unorderedDesc.Buffer.FirstElement = 0;
+            unorderedDesc.Buffer.NumElements = desc.size / desc.stride;
+            hr = m_pDevice->CreateUnorderedAccessView(entry.pBuffer, &unorderedDesc, &entry.pUnorderedView);
+        }
+    }
+    else if (desc.kind == BufferKind::Arguments)
+    {
+        // Written with InterlockedAdd through a byte address view
+        D3D11_UNORDERED_ACCESS_VIEW_DESC unorderedDesc = {};
+        unorderedDesc.Format = DXGI_FORMAT_R32_TYPELESS;
+        unorderedDesc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
+        unorderedDesc.Buffer.FirstElement = 0;
+        unorderedDesc.Buffer.NumElements = desc.size / 4;
+        unorderedDesc.Buffer.Flags = D3D11_BUFFER_UAV_FLAG_RAW;
+        hr = m_pDevice->CreateUnorderedAccessView(entry.pBuffer, &unorderedDesc, &entry.pUnorderedView);
+    }
+    return hr;
+}
+
+void D3D11RenderBackend::ReleaseEntry(BufferEntry& entry)
+{
+    SafeRelease(entry.pView);
+    SafeRelease(entry.pUnorderedView);
+    SafeRelease(entry.pBuffer);
+}
+
+void D3D11RenderBackend::BindShaderResource(ShaderStage stage, uint32_t slot, ID3D11ShaderResourceView* pView)
+{
+    switch (stage)
+    {
+    case ShaderStage::Vertex: m_pContext->VSSetShaderResources(slot, 1, &pView); break;
+    case ShaderStage::Pixel: m_pContext->PSSetShaderResources(slot, 1, &pView); break;
+    case ShaderStage::Compute: m_pContext->CSSetShaderResources(slot, 1, &pView); break;
+    }
+}
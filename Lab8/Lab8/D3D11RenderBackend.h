@@ -0,0 +1,109 @@
+#ifndef D3D11_RENDER_BACKEND_H
+#define D3D11_RENDER_BACKEND_H
+
+#include <d3d11.h>
+#include <vector>
+
+#include "GpuProfiler.h"
+#include "RenderBackend.h"
+
+struct D3D11PipelineDesc
+{
+    ID3D11VertexShader* pVertexShader;
+    ID3D11PixelShader* pPixelShader;
+    ID3D11InputLayout* pInputLayout;
+    ID3D11BlendState* pBlendState;              // nullptr = default state
+    ID3D11DepthStencilState* pDepthStencilState;
+    ID3D11RasterizerState* pRasterizerState;
+    ID3D11SamplerState* pSampler;               // bound to PS slot 0
+    D3D11_PRIMITIVE_TOPOLOGY topology;
+    ID3D11ComputeShader* pComputeShader;        // set for compute pipelines, everything else is ignored
+};
+
+// RenderBackend on top of an existing device and immediate context. Objects created
+// outside the backend (compiled shaders, DDS textures) are registered and AddRef'ed.
+class D3D11RenderBackend : public RenderBackend
+{
+public:
+    D3D11RenderBackend();
+    ~D3D11RenderBackend();
+
+    void Init(ID3D11Device* pDevice, ID3D11DeviceContext* pContext);
+    void Terminate();
+    // Scopes of the frame code become timings of this profiler; nullptr drops them
+    void SetGpuProfiler(GpuProfiler* pProfiler) { m_pProfiler = pProfiler; }
+
+    // pView and pUnorderedView are what BindStructuredBuffer and BindUnorderedAccess bind
+    BackendHandle RegisterBuffer(ID3D11Buffer* pBuffer, const BufferDesc& desc,
+        ID3D11ShaderResourceView* pView = nullptr, ID3D11UnorderedAccessView* pUnorderedView = nullptr);
+    BackendHandle RegisterPipeline(const D3D11PipelineDesc& desc);
+    BackendHandle RegisterSampler(ID3D11SamplerState* pSampler);
+    BackendHandle RegisterTexture(ID3D11ShaderResourceView* pView);
+    void UnregisterTexture(BackendHandle texture);
+    // Either view may be nullptr: shadow maps only have a depth view
+    BackendHandle RegisterTarget(ID3D11RenderTargetView* pColor, ID3D11DepthStencilView* pDepth);
+    void UnregisterTarget(BackendHandle target);
+
+    BackendHandle CreateBuffer(const BufferDesc& desc, const void* pInitialData) override;
+    void ReleaseBuffer(BackendHandle buffer) override;
+    void UpdateBuffer(BackendHandle buffer, const void* pData, uint32_t size) override;
+    void CopyBuffer(BackendHandle destination, BackendHandle source) override;
+    bool ReadBuffer(BackendHandle buffer, void* pData, uint32_t size) override;
+
+    void BindPipeline(BackendHandle pipeline) override;
+    void BindVertexBuffer(BackendHandle buffer, uint32_t stride) override;
+    void BindIndexBuffer(BackendHandle buffer) override;
+    void BindConstantBuffer(ShaderStage stage, uint32_t slot, BackendHandle buffer) override;
+    void BindTexture(ShaderStage stage, uint32_t slot, BackendHandle texture) override;
+    void BindStructuredBuffer(ShaderStage stage, uint32_t slot, BackendHandle buffer) override;
+    void BindUnorderedAccess(uint32_t slot, BackendHandle buffer) override;
+    void BindSampler(ShaderStage stage, uint32_t slot, BackendHandle sampler) override;
+
+    void BindTarget(BackendHandle target) override;
+    void ClearColor(BackendHandle target, const float color[4]) override;
+    void ClearDepth(BackendHandle target, float depth) override;
+    void SetViewport(float x, float y, float width, float height) override;
+    void SetScissor(int32_t left, int32_t top, int32_t right, int32_t bottom) override;
+
+    void Draw(uint32_t vertexCount) override;
+    void DrawIndexed(uint32_t indexCount, uint32_t firstIndex, int32_t baseVertex) override;
+    void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount) override;
+    void DrawIndexedInstancedIndirect(BackendHandle arguments) override;
+    void Dispatch(uint32_t x, uint32_t y, uint32_t z) override;
+
+    void BeginScope(const char* name) override;
+    void EndScope() override;
+
+private:
+    struct BufferEntry
+    {
+        ID3D11Buffer* pBuffer;
+        ID3D11ShaderResourceView* pView;
+        ID3D11UnorderedAccessView* pUnorderedView;
+        BufferDesc desc;
+    };
+
+    struct TargetEntry
+    {
+        ID3D11RenderTargetView* pColor;
+        ID3D11DepthStencilView* pDepth;
+    };
+
+    ID3D11Buffer* GetBuffer(BackendHandle buffer) const;
+    HRESULT CreateBufferViews(BufferEntry& entry);
+    void ReleaseEntry(BufferEntry& entry);
+    void BindShaderResource(ShaderStage stage, uint32_t slot, ID3D11ShaderResourceView* pView);
+
+    ID3D11Device* m_pDevice;
+    ID3D11DeviceContext* m_pContext;
+    GpuProfiler* m_pProfiler;
+
+    std::vector<BufferEntry> m_buffers;             // handle - 1
+    std::vector<D3D11PipelineDesc> m_pipelines;
+    std::vector<ID3D11SamplerState*> m_samplers;
+    std::vector<ID3D11ShaderResourceView*> m_textures;
+    std::vector<TargetEntry> m_targets;
+    std::vector<uint8_t> m_constantScratch;         // pads short constant buffer updates
+};
+
+#endif
@@ -0,0 +1,1307 @@
+//--------------------------------------------------------------------------------------
+// DDS header parsing and subresource layout, split out of DDSTextureLoader11.cpp
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//
+// http://go.microsoft.com/fwlink/?LinkId=248926
+//--------------------------------------------------------------------------------------
+
+#include "DDSLayout.h"
+#include "MappedFile.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <new>
+
+#ifdef __clang__
+#pragma clang diagnostic ignored "-Wcovered-switch-default"
+#pragma clang diagnostic ignored "-Wswitch-enum"
+#endif
+
+namespace DirectX
+{
+namespace DDSLayout
+{
+    //--------------------------------------------------------------------------------------
+    HRESULT LoadTextureDataFromMemory(
+        const uint8_t* ddsData,
+        size_t ddsDataSize,
+        const DDS_HEADER** header,
+        const uint8_t** bitData,
+        size_t* bitSize) noexcept
+    {
+        if (!header || !bitData || !bitSize)
+        {
+            return E_POINTER;
+        }
+
+        *bitSize = 0;
+
+        if (ddsDataSize > UINT32_MAX)
+        {
+            return E_FAIL;
+        }
+
+        if (ddsDataSize < DDS_MIN_HEADER_SIZE)
+        {
+            return E_FAIL;
+        }
+
+        // DDS files always start with the same magic number ("DDS ")
+        const auto dwMagicNumber = *reinterpret_cast<const uint32_t*>(ddsData);
+        if (dwMagicNumber != DDS_MAGIC)
+        {
+            return E_FAIL;
+        }
+
+        auto hdr = reinterpret_cast<const DDS_HEADER*>(ddsData + sizeof(uint32_t));
+
+        // Verify header to validate DDS file
+        if (hdr->size != sizeof(DDS_HEADER) ||
+            hdr->ddspf.size != sizeof(DDS_PIXELFORMAT))
+        {
+            return E_FAIL;
+        }
+
+        // Check for DX10 extension
+        bool bDXT10Header = false;
+        if ((hdr->ddspf.flags & DDS_FOURCC) &&
+            (MAKEFOURCC('D', 'X', '1', '0') == hdr->ddspf.fourCC))
+        {
+            // Must be long enough for both headers and magic value
+            if (ddsDataSize < DDS_DX10_HEADER_SIZE)
+            {
+                return E_FAIL;
+            }
+
+            bDXT10Header = true;
+        }
+
+        // setup the pointers in the process request
+        *header = hdr;
+        auto offset = DDS_MIN_HEADER_SIZE
+            + (bDXT10Header ? sizeof(DDS_HEADER_DXT10) : 0u);
+        *bitData = ddsData + offset;
+        *bitSize = ddsDataSize - offset;
+
+        return S_OK;
+    }
+
+
+
+    //--------------------------------------------------------------------------------------
+    // Return the BPP for a particular format
+    //--------------------------------------------------------------------------------------
+    size_t BitsPerPixel(DXGI_FORMAT fmt) noexcept
+    {
+        switch (fmt)
+        {
+        case DXGI_FORMAT_R32G32B32A32_TYPELESS:
+        case DXGI_FORMAT_R32G32B32A32_FLOAT:
+        case DXGI_FORMAT_R32G32B32A32_UINT:
+        case DXGI_FORMAT_R32G32B32A32_SINT:
+            return 128;
+
+        case DXGI_FORMAT_R32G32B32_TYPELESS:
+        case DXGI_FORMAT_R32G32B32_FLOAT:
+        case DXGI_FORMAT_R32G32B32_UINT:
+        case DXGI_FORMAT_R32G32B32_SINT:
+            return 96;
+
+        case DXGI_FORMAT_R16G16B16A16_TYPELESS:
+        case DXGI_FORMAT_R16G16B16A16_FLOAT:
+        case DXGI_FORMAT_R16G16B16A16_UNORM:
+        case DXGI_FORMAT_R16G16B16A16_UINT:
+        case DXGI_FORMAT_R16G16B16A16_SNORM:
+        case DXGI_FORMAT_R16G16B16A16_SINT:
+        case DXGI_FORMAT_R32G32_TYPELESS:
+        case DXGI_FORMAT_R32G32_FLOAT:
+        case DXGI_FORMAT_R32G32_UINT:
+        case DXGI_FORMAT_R32G32_SINT:
+        case DXGI_FORMAT_R32G8X24_TYPELESS:
+        case DXGI_FORMAT_D32_FLOAT_S8X24_UINT:
+        case DXGI_FORMAT_R32_FLOAT_X8X24_TYPELESS:
+        case DXGI_FORMAT_X32_TYPELESS_G8X24_UINT:
+        case DXGI_FORMAT_Y416:
+        case DXGI_FORMAT_Y210:
+        case DXGI_FORMAT_Y216:
+            return 64;
+
+        case DXGI_FORMAT_R10G10B10A2_TYPELESS:
+        case DXGI_FORMAT_R10G10B10A2_UNORM:
+        case DXGI_FORMAT_R10G10B10A2_UINT:
+        case DXGI_FORMAT_R11G11B10_FLOAT:
+        case DXGI_FORMAT_R8G8B8A8_TYPELESS:
+        case DXGI_FORMAT_R8G8B8A8_UNORM:
+        case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+        case DXGI_FORMAT_R8G8B8A8_UINT:
+        case DXGI_FORMAT_R8G8B8A8_SNORM:
+        case DXGI_FORMAT_R8G8B8A8_SINT:
+        case DXGI_FORMAT_R16G16_TYPELESS:
+        case DXGI_FORMAT_R16G16_FLOAT:
+        case DXGI_FORMAT_R16G16_UNORM:
+        case DXGI_FORMAT_R16G16_UINT:
+        case DXGI_FORMAT_R16G16_SNORM:
+        case DXGI_FORMAT_R16G16_SINT:
+        case DXGI_FORMAT_R32_TYPELESS:
+        case DXGI_FORMAT_D32_FLOAT:
+        case DXGI_FORMAT_R32_FLOAT:
+        case DXGI_FORMAT_R32_UINT:
+        case DXGI_FORMAT_R32_SINT:
+        case DXGI_FORMAT_R24G8_TYPELESS:
+        case DXGI_FORMAT_D24_UNORM_S8_UINT:
+        case DXGI_FORMAT_R24_UNORM_X8_TYPELESS:
+        case DXGI_FORMAT_X24_TYPELESS_G8_UINT:
+        case DXGI_FORMAT_R9G9B9E5_SHAREDEXP:
+        case DXGI_FORMAT_R8G8_B8G8_UNORM:
+        case DXGI_FORMAT_G8R8_G8B8_UNORM:
+        case DXGI_FORMAT_B8G8R8A8_UNORM:
+        case DXGI_FORMAT_B8G8R8X8_UNORM:
+        case DXGI_FORMAT_R10G10B10_XR_BIAS_A2_UNORM:
+        case DXGI_FORMAT_B8G8R8A8_TYPELESS:
+        case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+        case DXGI_FORMAT_B8G8R8X8_TYPELESS:
+        case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
+        case DXGI_FORMAT_AYUV:
+        case DXGI_FORMAT_Y410:
+        case DXGI_FORMAT_YUY2:
+            return 32;
+
+        case DXGI_FORMAT_P010:
+        case DXGI_FORMAT_P016:
+            return 24;
+
+        case DXGI_FORMAT_R8G8_TYPELESS:
+        case DXGI_FORMAT_R8G8_UNORM:
+        case DXGI_FORMAT_R8G8_UINT:
+        case DXGI_FORMAT_R8G8_SNORM:
+        case DXGI_FORMAT_R8G8_SINT:
+        case DXGI_FORMAT_R16_TYPELESS:
+        case DXGI_FORMAT_R16_FLOAT:
+        case DXGI_FORMAT_D16_UNORM:
+        case DXGI_FORMAT_R16_UNORM:
+        case DXGI_FORMAT_R16_UINT:
+        case DXGI_FORMAT_R16_SNORM:
+        case DXGI_FORMAT_R16_SINT:
+        case DXGI_FORMAT_B5G6R5_UNORM:
+        case DXGI_FORMAT_B5G5R5A1_UNORM:
+        case DXGI_FORMAT_A8P8:
+        case DXGI_FORMAT_B4G4R4A4_UNORM:
+            return 16;
+
+        case DXGI_FORMAT_NV12:
+        case DXGI_FORMAT_420_OPAQUE:
+        case DXGI_FORMAT_NV11:
+            return 12;
+
+        case DXGI_FORMAT_R8_TYPELESS:
+        case DXGI_FORMAT_R8_UNORM:
+        case DXGI_FORMAT_R8_UINT:
+        case DXGI_FORMAT_R8_SNORM:
+        case DXGI_FORMAT_R8_SINT:
+        case DXGI_FORMAT_A8_UNORM:
+        case DXGI_FORMAT_BC2_TYPELESS:
+        case DXGI_FORMAT_BC2_UNORM:
+        case DXGI_FORMAT_BC2_UNORM_SRGB:
+        case DXGI_FORMAT_BC3_TYPELESS:
+        case DXGI_FORMAT_BC3_UNORM:
+        case DXGI_FORMAT_BC3_UNORM_SRGB:
+        case DXGI_FORMAT_BC5_TYPELESS:
+        case DXGI_FORMAT_BC5_UNORM:
+        case DXGI_FORMAT_BC5_SNORM:
+        case DXGI_FORMAT_BC6H_TYPELESS:
+        case DXGI_FORMAT_BC6H_UF16:
+        case DXGI_FORMAT_BC6H_SF16:
+        case DXGI_FORMAT_BC7_TYPELESS:
+        case DXGI_FORMAT_BC7_UNORM:
+        case DXGI_FORMAT_BC7_UNORM_SRGB:
+        case DXGI_FORMAT_AI44:
+        case DXGI_FORMAT_IA44:
+        case DXGI_FORMAT_P8:
+            return 8;
+
+        case DXGI_FORMAT_R1_UNORM:
+            return 1;
+
+        case DXGI_FORMAT_BC1_TYPELESS:
+        case DXGI_FORMAT_BC1_UNORM:
+        case DXGI_FORMAT_BC1_UNORM_SRGB:
+        case DXGI_FORMAT_BC4_TYPELESS:
+        case DXGI_FORMAT_BC4_UNORM:
+        case DXGI_FORMAT_BC4_SNORM:
+            return 4;
+
+        default:
+            return 0;
+        }
+    }
+
+
+    //--------------------------------------------------------------------------------------
+    // Get surface information for a particular format
+    //--------------------------------------------------------------------------------------
+    HRESULT GetSurfaceInfo(
+        size_t width,
+        size_t height,
+        DXGI_FORMAT fmt,
+        size_t* outNumBytes,
+        size_t* outRowBytes,
+        size_t* outNumRows) noexcept
+    {
+        uint64_t numBytes = 0;
+        uint64_t rowBytes = 0;
+        uint64_t numRows = 0;
+
+        bool bc = false;
+        bool packed = false;
+        bool planar = false;
+        size_t bpe = 0;
+        switch (fmt)
+        {
+        case DXGI_FORMAT_UNKNOWN:
+            return E_INVALIDARG;
+
+        case DXGI_FORMAT_BC1_TYPELESS:
+        case DXGI_FORMAT_BC1_UNORM:
+        case DXGI_FORMAT_BC1_UNORM_SRGB:
+        case DXGI_FORMAT_BC4_TYPELESS:
+        case DXGI_FORMAT_BC4_UNORM:
+        case DXGI_FORMAT_BC4_SNORM:
+            bc = true;
+            bpe = 8;
+            break;
+
+        case DXGI_FORMAT_BC2_TYPELESS:
+        case DXGI_FORMAT_BC2_UNORM:
+        case DXGI_FORMAT_BC2_UNORM_SRGB:
+        case DXGI_FORMAT_BC3_TYPELESS:
+        case DXGI_FORMAT_BC3_UNORM:
+        case DXGI_FORMAT_BC3_UNORM_SRGB:
+        case DXGI_FORMAT_BC5_TYPELESS:
+        case DXGI_FORMAT_BC5_UNORM:
+        case DXGI_FORMAT_BC5_SNORM:
+        case DXGI_FORMAT_BC6H_TYPELESS:
+        case DXGI_FORMAT_BC6H_UF16:
+        case DXGI_FORMAT_BC6H_SF16:
+        case DXGI_FORMAT_BC7_TYPELESS:
+        case DXGI_FORMAT_BC7_UNORM:
+        case DXGI_FORMAT_BC7_UNORM_SRGB:
+            bc = true;
+            bpe = 16;
+            break;
+
+        case DXGI_FORMAT_R8G8_B8G8_UNORM:
+        case DXGI_FORMAT_G8R8_G8B8_UNORM:
+        case DXGI_FORMAT_YUY2:
+            packed = true;
+            bpe = 4;
+            break;
+
+        case DXGI_FORMAT_Y210:
+        case DXGI_FORMAT_Y216:
+            packed = true;
+            bpe = 8;
+            break;
+
+        case DXGI_FORMAT_NV12:
+        case DXGI_FORMAT_420_OPAQUE:
+            if ((height % 2) != 0)
+            {
+                // Requires a height alignment of 2.
+                return E_INVALIDARG;
+            }
+            planar = true;
+            bpe = 2;
+            break;
+
+        #if (_WIN32_WINNT >= _WIN32_WINNT_WIN10)
+
+        case DXGI_FORMAT_P208:
+            planar = true;
+            bpe = 2;
+            break;
+
+        #endif
+
+        case DXGI_FORMAT_P010:
+        case DXGI_FORMAT_P016:
+            if ((height % 2) != 0)
+            {
+                // Requires a height alignment of 2.
+                return E_INVALIDARG;
+            }
+            planar = true;
+            bpe = 4;
+            break;
+
+        default:
+            break;
+        }
+
+        if (bc)
+        {
+            uint64_t numBlocksWide = 0;
+            if (width > 0)
+            {
+                numBlocksWide = std::max<uint64_t>(1u, (uint64_t(width) + 3u) / 4u);
+            }
+            uint64_t numBlocksHigh = 0;
+            if (height > 0)
+            {
+                numBlocksHigh = std::max<uint64_t>(1u, (uint64_t(height) + 3u) / 4u);
+            }
+            rowBytes = numBlocksWide * bpe;
+            numRows = numBlocksHigh;
+            numBytes = rowBytes * numBlocksHigh;
+        }
+        else if (packed)
+        {
+            rowBytes = ((uint64_t(width) + 1u) >> 1) * bpe;
+            numRows = uint64_t(height);
+            numBytes = rowBytes * height;
+        }
+        else if (fmt == DXGI_FORMAT_NV11)
+        {
+            rowBytes = ((uint64_t(width) + 3u) >> 2) * 4u;
+            numRows = uint64_t(height) * 2u; // Direct3D makes this simplifying assumption, although it is larger than the 4:1:1 data
+            numBytes = rowBytes * numRows;
+        }
+        else if (planar)
+        {
+            rowBytes = ((uint64_t(width) + 1u) >> 1) * bpe;
+            numBytes = (rowBytes * uint64_t(height)) + ((rowBytes * uint64_t(height) + 1u) >> 1);
+            numRows = height + ((uint64_t(height) + 1u) >> 1);
+        }
+        else
+        {
+            const size_t bpp = BitsPerPixel(fmt);
+            if (!bpp)
+                return E_INVALIDARG;
+
+            rowBytes = (uint64_t(width) * bpp + 7u) / 8u; // round up to nearest byte
+            numRows = uint64_t(height);
+            numBytes = rowBytes * height;
+        }
+
+    #if defined(_M_IX86) || defined(_M_ARM) || defined(_M_HYBRID_X86_ARM64)
+        static_assert(sizeof(size_t) == 4, "Not a 32-bit platform!");
+        if (numBytes > UINT32_MAX || rowBytes > UINT32_MAX || numRows > UINT32_MAX)
+            return HRESULT_FROM_WIN32(ERROR_ARITHMETIC_OVERFLOW);
+    #else
+        static_assert(sizeof(size_t) == 8, "Not a 64-bit platform!");
+    #endif
+
+        if (outNumBytes)
+        {
+            *outNumBytes = static_cast<size_t>(numBytes);
+        }
+        if (outRowBytes)
+        {
+            *outRowBytes = static_cast<size_t>(rowBytes);
+        }
+        if (outNumRows)
+        {
+            *outNumRows = static_cast<size_t>(numRows);
+        }
+
+        return S_OK;
+    }
+
+
+    //--------------------------------------------------------------------------------------
+#define ISBITMASK( r,g,b,a ) ( ddpf.RBitMask == r && ddpf.GBitMask == g && ddpf.BBitMask == b && ddpf.ABitMask == a )
+
+    DXGI_FORMAT GetDXGIFormat(const DDS_PIXELFORMAT& ddpf) noexcept
+    {
+        if (ddpf.flags & DDS_RGB)
+        {
+            // Note that sRGB formats are written using the "DX10" extended header
+
+            switch (ddpf.RGBBitCount)
+            {
+            case 32:
+                if (ISBITMASK(0x000000ff, 0x0000ff00, 0x00ff0000, 0xff000000))
+                {
+                    return DXGI_FORMAT_R8G8B8A8_UNORM;
+                }
+
+                if (ISBITMASK(0x00ff0000, 0x0000ff00, 0x000000ff, 0xff000000))
+                {
+                    return DXGI_FORMAT_B8G8R8A8_UNORM;
+                }
+
+                if (ISBITMASK(0x00ff0000, 0x0000ff00, 0x000000ff, 0))
+                {
+                    return DXGI_FORMAT_B8G8R8X8_UNORM;
+                }
+
+                // No DXGI format maps to ISBITMASK(0x000000ff,0x0000ff00,0x00ff0000,0) aka D3DFMT_X8B8G8R8
+
+                // Note that many common DDS reader/writers (including D3DX) swap the
+                // the RED/BLUE masks for 10:10:10:2 formats. We assume
+                // below that the 'backwards' header mask is being used since it is most
+                // likely written by D3DX. The more robust solution is to use the 'DX10'
+                // header extension and specify the DXGI_FORMAT_R10G10B10A2_UNORM format directly
+
+                // For 'correct' writers, this should be 0x000003ff,0x000ffc00,0x3ff00000 for RGB data
+                if (ISBITMASK(0x3ff00000, 0x000ffc00, 0x000003ff, 0xc0000000))
+                {
+                    return DXGI_FORMAT_R10G10B10A2_UNORM;
+                }
+
+                // No DXGI format maps to ISBITMASK(0x000003ff,0x000ffc00,0x3ff00000,0xc0000000) aka D3DFMT_A2R10G10B10
+
+                if (ISBITMASK(0x0000ffff, 0xffff0000, 0, 0))
+                {
+                    return DXGI_FORMAT_R16G16_UNORM;
+                }
+
+                if (ISBITMASK(0xffffffff, 0, 0, 0))
+                {
+                    // Only 32-bit color channel format in D3D9 was R32F
+                    return DXGI_FORMAT_R32_FLOAT; // D3DX writes this out as a FourCC of 114
+                }
+                break;
+
+            case 24:
+                // No 24bpp DXGI formats aka D3DFMT_R8G8B8
+                break;
+
+            case 16:
+                if (ISBITMASK(0x7c00, 0x03e0, 0x001f, 0x8000))
+                {
+                    return DXGI_FORMAT_B5G5R5A1_UNORM;
+                }
+                if (ISBITMASK(0xf800, 0x07e0, 0x001f, 0))
+                {
+                    return DXGI_FORMAT_B5G6R5_UNORM;
+                }
+
+                // No DXGI format maps to ISBITMASK(0x7c00,0x03e0,0x001f,0) aka D3DFMT_X1R5G5B5
+
+                if (ISBITMASK(0x0f00, 0x00f0, 0x000f, 0xf000))
+                {
+                    return DXGI_FORMAT_B4G4R4A4_UNORM;
+                }
+
+                // NVTT versions 1.x wrote this as RGB instead of LUMINANCE
+                if (ISBITMASK(0x00ff, 0, 0, 0xff00))
+                {
+                    return DXGI_FORMAT_R8G8_UNORM;
+                }
+                if (ISBITMASK(0xffff, 0, 0, 0))
+                {
+                    return DXGI_FORMAT_R16_UNORM;
+                }
+
+                // No DXGI format maps to ISBITMASK(0x0f00,0x00f0,0x000f,0) aka D3DFMT_X4R4G4B4
+
+                // No 3:3:2:8 or paletted DXGI formats aka D3DFMT_A8R3G3B2, D3DFMT_A8P8, etc.
+                break;
+
+            case 8:
+                // NVTT versions 1.x wrote this as RGB instead of LUMINANCE
+                if (ISBITMASK(0xff, 0, 0, 0))
+                {
+                    return DXGI_FORMAT_R8_UNORM;
+                }
+
+                // No 3:3:2 or paletted DXGI formats aka D3DFMT_R3G3B2, D3DFMT_P8
+                break;
+
+            default:
+                return DXGI_FORMAT_UNKNOWN;
+            }
+        }
+        else if (ddpf.flags & DDS_LUMINANCE)
+        {
+            switch (ddpf.RGBBitCount)
+            {
+            case 16:
+                if (ISBITMASK(0xffff, 0, 0, 0))
+                {
+                    return DXGI_FORMAT_R16_UNORM; // D3DX10/11 writes this out as DX10 extension
+                }
+                if (ISBITMASK(0x00ff, 0, 0, 0xff00))
+                {
+                    return DXGI_FORMAT_R8G8_UNORM; // D3DX10/11 writes this out as DX10 extension
+                }
+                break;
+
+            case 8:
+                if (ISBITMASK(0xff, 0, 0, 0))
+                {
+                    return DXGI_FORMAT_R8_UNORM; // D3DX10/11 writes this out as DX10 extension
+                }
+
+                // No DXGI format maps to ISBITMASK(0x0f,0,0,0xf0) aka D3DFMT_A4L4
+
+                if (ISBITMASK(0x00ff, 0, 0, 0xff00))
+                {
+                    return DXGI_FORMAT_R8G8_UNORM; // Some DDS writers assume the bitcount should be 8 instead of 16
+                }
+                break;
+
+            default:
+                return DXGI_FORMAT_UNKNOWN;
+            }
+        }
+        else if (ddpf.flags & DDS_ALPHA)
+        {
+            if (8 == ddpf.RGBBitCount)
+            {
+                return DXGI_FORMAT_A8_UNORM;
+            }
+        }
+        else if (ddpf.flags & DDS_BUMPDUDV)
+        {
+            switch (ddpf.RGBBitCount)
+            {
+            case 32:
+                if (ISBITMASK(0x000000ff, 0x0000ff00, 0x00ff0000, 0xff000000))
+                {
+                    return DXGI_FORMAT_R8G8B8A8_SNORM; // D3DX10/11 writes this out as DX10 extension
+                }
+                if (ISBITMASK(0x0000ffff, 0xffff0000, 0, 0))
+                {
+                    return DXGI_FORMAT_R16G16_SNORM; // D3DX10/11 writes this out as DX10 extension
+                }
+
+                // No DXGI format maps to ISBITMASK(0x3ff00000, 0x000ffc00, 0x000003ff, 0xc0000000) aka D3DFMT_A2W10V10U10
+                break;
+
+            case 16:
+                if (ISBITMASK(0x00ff, 0xff00, 0, 0))
+                {
+                    return DXGI_FORMAT_R8G8_SNORM; // D3DX10/11 writes this out as DX10 extension
+                }
+                break;
+
+            default:
+                return DXGI_FORMAT_UNKNOWN;
+            }
+
+            // No DXGI format maps to DDPF_BUMPLUMINANCE aka D3DFMT_L6V5U5, D3DFMT_X8L8V8U8
+        }
+        else if (ddpf.flags & DDS_FOURCC)
+        {
+            if (MAKEFOURCC('D', 'X', 'T', '1') == ddpf.fourCC)
+            {
+                return DXGI_FORMAT_BC1_UNORM;
+            }
+            if (MAKEFOURCC('D', 'X', 'T', '3') == ddpf.fourCC)
+            {
+                return DXGI_FORMAT_BC2_UNORM;
+            }
+            if (MAKEFOURCC('D', 'X', 'T', '5') == ddpf.fourCC)
+            {
+                return DXGI_FORMAT_BC3_UNORM;
+            }
+
+            // While pre-multiplied alpha isn't directly supported by the DXGI formats,
+            // they are basically the same as these BC formats so they can be mapped
+            if (MAKEFOURCC('D', 'X', 'T', '2') == ddpf.fourCC)
+            {
+                return DXGI_FORMAT_BC2_UNORM;
+            }
+            if (MAKEFOURCC('D', 'X', 'T', '4') == ddpf.fourCC)
+            {
+                return DXGI_FORMAT_BC3_UNORM;
+            }
+
+            if (MAKEFOURCC('A', 'T', 'I', '1') == ddpf.fourCC)
+            {
+                return DXGI_FORMAT_BC4_UNORM;
+            }
+            if (MAKEFOURCC('B', 'C', '4', 'U') == ddpf.fourCC)
+            {
+                return DXGI_FORMAT_BC4_UNORM;
+            }
+            if (MAKEFOURCC('B', 'C', '4', 'S') == ddpf.fourCC)
+            {
+                return DXGI_FORMAT_BC4_SNORM;
+            }
+
+            if (MAKEFOURCC('A', 'T', 'I', '2') == ddpf.fourCC)
+            {
+                return DXGI_FORMAT_BC5_UNORM;
+            }
+            if (MAKEFOURCC('B', 'C', '5', 'U') == ddpf.fourCC)
+            {
+                return DXGI_FORMAT_BC5_UNORM;
+            }
+            if (MAKEFOURCC('B', 'C', '5', 'S') == ddpf.fourCC)
+            {
+                return DXGI_FORMAT_BC5_SNORM;
+            }
+
+            // BC6H and BC7 are written using the "DX10" extended header
+
+            if (MAKEFOURCC('R', 'G', 'B', 'G') == ddpf.fourCC)
+            {
+                return DXGI_FORMAT_R8G8_B8G8_UNORM;
+            }
+            if (MAKEFOURCC('G', 'R', 'G', 'B') == ddpf.fourCC)
+            {
+                return DXGI_FORMAT_G8R8_G8B8_UNORM;
+            }
+
+            if (MAKEFOURCC('Y', 'U', 'Y', '2') == ddpf.fourCC)
+            {
+                return DXGI_FORMAT_YUY2;
+            }
+
+            // Check for D3DFORMAT enums being set here
+            switch (ddpf.fourCC)
+            {
+            case 36: // D3DFMT_A16B16G16R16
+                return DXGI_FORMAT_R16G16B16A16_UNORM;
+
+            case 110: // D3DFMT_Q16W16V16U16
+                return DXGI_FORMAT_R16G16B16A16_SNORM;
+
+            case 111: // D3DFMT_R16F
+                return DXGI_FORMAT_R16_FLOAT;
+
+            case 112: // D3DFMT_G16R16F
+                return DXGI_FORMAT_R16G16_FLOAT;
+
+            case 113: // D3DFMT_A16B16G16R16F
+                return DXGI_FORMAT_R16G16B16A16_FLOAT;
+
+            case 114: // D3DFMT_R32F
+                return DXGI_FORMAT_R32_FLOAT;
+
+            case 115: // D3DFMT_G32R32F
+                return DXGI_FORMAT_R32G32_FLOAT;
+
+            case 116: // D3DFMT_A32B32G32R32F
+                return DXGI_FORMAT_R32G32B32A32_FLOAT;
+
+            // No DXGI format maps to D3DFMT_CxV8U8
+
+            default:
+                return DXGI_FORMAT_UNKNOWN;
+            }
+        }
+
+        return DXGI_FORMAT_UNKNOWN;
+    }
+
+#undef ISBITMASK
+
+
+    //--------------------------------------------------------------------------------------
+    HRESULT GetTextureLayout(const DDS_HEADER* header, DDSTextureLayout& layout) noexcept
+    {
+        const uint32_t width = header->width;
+        uint32_t height = header->height;
+        uint32_t depth = header->depth;
+
+        uint32_t resDim = 0u;
+        uint32_t arraySize = 1;
+        DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
+        bool isCubeMap = false;
+
+        uint32_t mipCount = header->mipMapCount;
+        if (0 == mipCount)
+        {
+            mipCount = 1;
+        }
+
+        if ((header->ddspf.flags & DDS_FOURCC) &&
+            (MAKEFOURCC('D', 'X', '1', '0') == header->ddspf.fourCC))
+        {
+            auto d3d10ext = reinterpret_cast<const DDS_HEADER_DXT10*>(reinterpret_cast<const uint8_t*>(header) + sizeof(DDS_HEADER));
+
+            arraySize = d3d10ext->arraySize;
+            if (arraySize == 0)
+            {
+                return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+            }
+
+            switch (d3d10ext->dxgiFormat)
+            {
+            case DXGI_FORMAT_NV12:
+            case DXGI_FORMAT_P010:
+            case DXGI_FORMAT_P016:
+            case DXGI_FORMAT_420_OPAQUE:
+                if ((d3d10ext->resourceDimension != DDS_DIMENSION_TEXTURE2D)
+                    || (width % 2) != 0 || (height % 2) != 0)
+                {
+                    return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+                }
+                break;
+
+            case DXGI_FORMAT_YUY2:
+            case DXGI_FORMAT_Y210:
+            case DXGI_FORMAT_Y216:
+            case DXGI_FORMAT_P208:
+                if ((width % 2) != 0)
+                {
+                    return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+                }
+                break;
+
+            case DXGI_FORMAT_NV11:
+                if ((width % 4) != 0)
+                {
+                    return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+                }
+                break;
+
+            case DXGI_FORMAT_AI44:
+            case DXGI_FORMAT_IA44:
+            case DXGI_FORMAT_P8:
+            case DXGI_FORMAT_A8P8:
+                return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+
+            default:
+                if (BitsPerPixel(d3d10ext->dxgiFormat) == 0)
+                {
+                    return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+                }
+            }
+
+            format = d3d10ext->dxgiFormat;
+
+            switch (d3d10ext->resourceDimension)
+            {
+            case DDS_DIMENSION_TEXTURE1D:
+                // D3DX writes 1D textures with a fixed Height of 1
+                if ((header->flags & DDS_HEIGHT) && height != 1)
+                {
+                    return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+                }
+                height = depth = 1;
+                break;
+
+            case DDS_DIMENSION_TEXTURE2D:
+                if (d3d10ext->miscFlag & DDS_RESOURCE_MISC_TEXTURECUBE)
+                {
+                    arraySize *= 6;
+                    isCubeMap = true;
+                }
+                depth = 1;
+                break;
+
+            case DDS_DIMENSION_TEXTURE3D:
+                if (!(header->flags & DDS_HEADER_FLAGS_VOLUME))
+                {
+                    return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+                }
+
+                if (arraySize > 1)
+                {
+                    return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+                }
+                break;
+
+            default:
+                return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+            }
+
+            resDim = d3d10ext->resourceDimension;
+        }
+        else
+        {
+            format = GetDXGIFormat(header->ddspf);
+
+            if (format == DXGI_FORMAT_UNKNOWN)
+            {
+                return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+            }
+
+            if (header->flags & DDS_HEADER_FLAGS_VOLUME)
+            {
+                resDim = DDS_DIMENSION_TEXTURE3D;
+            }
+            else
+            {
+                if (header->caps2 & DDS_CUBEMAP)
+                {
+                    // We require all six faces to be defined
+                    if ((header->caps2 & DDS_CUBEMAP_ALLFACES) != DDS_CUBEMAP_ALLFACES)
+                    {
+                        return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+                    }
+
+                    arraySize = 6;
+                    isCubeMap = true;
+                }
+
+                depth = 1;
+                resDim = DDS_DIMENSION_TEXTURE2D;
+
+                // Note there's no way for a legacy Direct3D 9 DDS to express a '1D' texture
+            }
+
+            assert(BitsPerPixel(format) != 0);
+        }
+
+        layout.resDim = resDim;
+        layout.width = width;
+        layout.height = height;
+        layout.depth = depth;
+        layout.mipCount = mipCount;
+        layout.arraySize = arraySize;
+        layout.format = format;
+        layout.isCubeMap = isCubeMap;
+        return S_OK;
+    }
+
+
+    //--------------------------------------------------------------------------------------
+    HRESULT FillInitData(
+        size_t width,
+        size_t height,
+        size_t depth,
+        size_t mipCount,
+        size_t arraySize,
+        DXGI_FORMAT format,
+        size_t maxsize,
+        size_t bitSize,
+        const uint8_t* bitData,
+        size_t& twidth,
+        size_t& theight,
+        size_t& tdepth,
+        size_t& skipMip,
+        DDSSubresourceData* initData) noexcept
+    {
+        if (!bitData || !initData)
+        {
+            return E_POINTER;
+        }
+
+        skipMip = 0;
+        twidth = 0;
+        theight = 0;
+        tdepth = 0;
+
+        size_t NumBytes = 0;
+        size_t RowBytes = 0;
+        const uint8_t* pSrcBits = bitData;
+        const uint8_t* pEndBits = bitData + bitSize;
+
+        size_t index = 0;
+        for (size_t j = 0; j < arraySize; j++)
+        {
+            size_t w = width;
+            size_t h = height;
+            size_t d = depth;
+            for (size_t i = 0; i < mipCount; i++)
+            {
+                HRESULT hr = GetSurfaceInfo(w, h, format, &NumBytes, &RowBytes, nullptr);
+                if (FAILED(hr))
+                    return hr;
+
+                if (NumBytes > UINT32_MAX || RowBytes > UINT32_MAX)
+                    return HRESULT_FROM_WIN32(ERROR_ARITHMETIC_OVERFLOW);
+
+                if ((mipCount <= 1) || !maxsize || (w <= maxsize && h <= maxsize && d <= maxsize))
+                {
+                    if (!twidth)
+                    {
+                        twidth = w;
+                        theight = h;
+                        tdepth = d;
+                    }
+
+                    assert(index < mipCount * arraySize);
+                    initData[index].pSysMem = pSrcBits;
+                    initData[index].SysMemPitch = static_cast<uint32_t>(RowBytes);
+                    initData[index].SysMemSlicePitch = static_cast<uint32_t>(NumBytes);
+                    ++index;
+                }
+                else if (!j)
+                {
+                    // Count number of skipped mipmaps (first item only)
+                    ++skipMip;
+                }
+
+                if (pSrcBits + (NumBytes*d) > pEndBits)
+                {
+                    return HRESULT_FROM_WIN32(ERROR_HANDLE_EOF);
+                }
+
+                pSrcBits += NumBytes * d;
+
+                w = w >> 1;
+                h = h >> 1;
+                d = d >> 1;
+                if (w == 0)
+                {
+                    w = 1;
+                }
+                if (h == 0)
+                {
+                    h = 1;
+                }
+                if (d == 0)
+                {
+                    d = 1;
+                }
+            }
+        }
+
+        return (index > 0) ? S_OK : E_FAIL;
+    }
+
+
+    //--------------------------------------------------------------------------------------
+    HRESULT GetArrayLayout(
+        const DDSFileView* files,
+        size_t fileCount,
+        size_t maxsize,
+        size_t maxArraySize,
+        DDSArrayLayout& arrayLayout) noexcept
+    {
+        arrayLayout.layout = {};
+        arrayLayout.skipMip = 0;
+        arrayLayout.failedFile = 0;
+        arrayLayout.initData.clear();
+        if (!files || !fileCount)
+        {
+            return E_INVALIDARG;
+        }
+
+        DDSTextureLayout first = {};
+        size_t arraySize = 0;
+        size_t keptMips = 0;
+        for (size_t i = 0; i < fileCount; i++)
+        {
+            arrayLayout.failedFile = i;
+
+            const DDS_HEADER* header = nullptr;
+            const uint8_t* bitData = nullptr;
+            size_t bitSize = 0;
+            DDSTextureLayout layout;
+            HRESULT hr = LoadTextureDataFromMemory(files[i].data, files[i].size, &header, &bitData, &bitSize);
+            if (SUCCEEDED(hr))
+                hr = GetTextureLayout(header, layout);
+            if (FAILED(hr))
+                return hr;
+
+            if (layout.resDim != DDS_DIMENSION_TEXTURE2D)
+                return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+            if (i == 0)
+            {
+                first = layout;
+            }
+            else if (layout.width != first.width || layout.height != first.height || layout.mipCount != first.mipCount ||
+                layout.format != first.format || layout.isCubeMap != first.isCubeMap)
+            {
+                return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+            }
+            if (arraySize + layout.arraySize > maxArraySize)
+                return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+
+            // Every file skips the same mips, so its slices land right after those of the file before
+            size_t offset = arraySize * (keptMips ? keptMips : layout.mipCount);
+            try
+            {
+                arrayLayout.initData.resize(offset + static_cast<size_t>(layout.arraySize) * layout.mipCount);
+            }
+            catch (const std::bad_alloc&)
+            {
+                return E_OUTOFMEMORY;
+            }
+
+            size_t twidth = 0;
+            size_t theight = 0;
+            size_t tdepth = 0;
+            size_t skipMip = 0;
+            hr = FillInitData(layout.width, layout.height, 1, layout.mipCount, layout.arraySize, layout.format, maxsize,
+                bitSize, bitData, twidth, theight, tdepth, skipMip, &arrayLayout.initData[offset]);
+            if (FAILED(hr))
+                return hr;
+
+            if (i == 0)
+            {
+                keptMips = layout.mipCount - skipMip;
+                arrayLayout.skipMip = skipMip;
+                arrayLayout.layout = layout;
+                arrayLayout.layout.width = static_cast<uint32_t>(twidth);
+                arrayLayout.layout.height = static_cast<uint32_t>(theight);
+                arrayLayout.layout.mipCount = static_cast<uint32_t>(keptMips);
+            }
+            arraySize += layout.arraySize;
+        }
+
+        arrayLayout.layout.arraySize = static_cast<uint32_t>(arraySize);
+        arrayLayout.initData.resize(arraySize * keptMips);
+        return S_OK;
+    }
+
+
+    //--------------------------------------------------------------------------------------
+    namespace
+    {
+        bool ReadWholeFile(const char* path, std::vector<uint8_t>& data)
+        {
+            FILE* file = nullptr;
+        #ifdef _MSC_VER
+            if (fopen_s(&file, path, "rb") != 0)
+                file = nullptr;
+        #else
+            file = fopen(path, "rb");
+        #endif
+            if (!file)
+                return false;
+
+            fseek(file, 0, SEEK_END);
+            long size = ftell(file);
+            fseek(file, 0, SEEK_SET);
+            bool read = size > 0;
+            if (read)
+            {
+                data.resize(static_cast<size_t>(size));
+                read = fread(data.data(), 1, data.size(), file) == data.size();
+            }
+            fclose(file);
+            return read;
+        }
+
+        // Lays the file out like CreateTextureFromDDS and copies every subresource into a
+        // texture sized buffer; returns the texture size or 0 when the file is not usable
+        uint64_t UploadTexture(const uint8_t* ddsData, size_t ddsDataSize, std::vector<DDSSubresourceData>& initData, uint64_t& sink)
+        {
+            const DDS_HEADER* header = nullptr;
+            const uint8_t* bitData = nullptr;
+            size_t bitSize = 0;
+            DDSTextureLayout layout;
+            if (FAILED(LoadTextureDataFromMemory(ddsData, ddsDataSize, &header, &bitData, &bitSize)) ||
+                FAILED(GetTextureLayout(header, layout)))
+            {
+                return 0;
+            }
+
+            initData.resize(static_cast<size_t>(layout.mipCount) * layout.arraySize);
+            size_t twidth = 0;
+            size_t theight = 0;
+            size_t tdepth = 0;
+            size_t skipMip = 0;
+            if (FAILED(FillInitData(layout.width, layout.height, layout.depth, layout.mipCount, layout.arraySize,
+                layout.format, 0, bitSize, bitData, twidth, theight, tdepth, skipMip, initData.data())))
+            {
+                return 0;
+            }
+
+            uint64_t textureBytes = 0;
+            for (size_t i = 0; i < initData.size(); i++)
+            {
+                const size_t mipDepth = std::max<size_t>(layout.depth >> (i % layout.mipCount), 1);
+                textureBytes += static_cast<uint64_t>(initData[i].SysMemSlicePitch) * mipDepth;
+            }
+
+            std::unique_ptr<uint8_t[]> texture(new (std::nothrow) uint8_t[static_cast<size_t>(textureBytes)]);
+            if (!texture)
+                return 0;
+            uint8_t* pDest = texture.get();
+            for (size_t i = 0; i < initData.size(); i++)
+            {
+                const size_t bytes = static_cast<size_t>(initData[i].SysMemSlicePitch) * std::max<size_t>(layout.depth >> (i % layout.mipCount), 1);
+                memcpy(pDest, initData[i].pSysMem, bytes);
+                pDest += bytes;
+            }
+            sink += texture[static_cast<size_t>(textureBytes) - 1];
+            return textureBytes;
+        }
+    }
+
+    DDSLoadBenchmarkResult BenchmarkLoading(const std::vector<std::string>& paths, uint32_t passes)
+    {
+        DDSLoadBenchmarkResult result = {};
+        result.passes = passes;
+        std::vector<DDSSubresourceData> initData;
+        std::vector<uint8_t> fileData;
+        uint64_t sink = 0;
+
+        // Warm-up, also finds the files worth timing
+        std::vector<const std::string*> usable;
+        for (const std::string& path : paths)
+        {
+            uint64_t textureBytes = 0;
+            if (ReadWholeFile(path.c_str(), fileData))
+                textureBytes = UploadTexture(fileData.data(), fileData.size(), initData, sink);
+            if (!textureBytes)
+            {
+                result.failedFiles++;
+                continue;
+            }
+            usable.push_back(&path);
+            result.fileBytes += fileData.size();
+            result.readPeakBytes = std::max<uint64_t>(result.readPeakBytes, fileData.size() + textureBytes);
+            result.mappedPeakBytes = std::max(result.mappedPeakBytes, textureBytes);
+        }
+        result.files = static_cast<uint32_t>(usable.size());
+
+        // Every file gets a fresh buffer, the way the loader allocates one per call
+        uint64_t start = Profiler::NowNs();
+        for (uint32_t pass = 0; pass < passes; pass++)
+        {
+            for (const std::string* pPath : usable)
+            {
+                std::vector<uint8_t> data;
+                if (ReadWholeFile(pPath->c_str(), data))
+                    UploadTexture(data.data(), data.size(), initData, sink);
+            }
+        }
+        uint64_t readDone = Profiler::NowNs();
+        for (uint32_t pass = 0; pass < passes; pass++)
+        {
+            for (const std::string* pPath : usable)
+            {
+                MappedFile file;
+                if (file.Open(pPath->c_str()))
+                    UploadTexture(file.GetData(), file.GetSize(), initData, sink);
+            }
+        }
+        uint64_t mappedDone = Profiler::NowNs();
+
+        result.readMs = (readDone - start) * 1.0e-6;
+        result.mappedMs = (mappedDone - readDone) * 1.0e-6;
+        // Keeps the copies alive for the optimizer
+        if (sink == UINT64_MAX)
+            result.failedFiles++;
+        return result;
+    }
+
+
+    //--------------------------------------------------------------------------------------
+    DDSArrayBenchmarkResult BenchmarkArrayLayout(const std::vector<std::string>& paths, uint32_t slices)
+    {
+        DDSArrayBenchmarkResult result = {};
+
+        // Every usable file alone: its layout and initial data are what the arrays must reproduce
+        struct FileInfo
+        {
+            DDSFileView view;
+            DDSTextureLayout layout;
+            std::vector<DDSSubresourceData> initData;
+        };
+        std::vector<std::unique_ptr<MappedFile>> mappedFiles;
+        std::vector<FileInfo> files;
+        for (const std::string& path : paths)
+        {
+            std::unique_ptr<MappedFile> file(new MappedFile());
+            if (!file->Open(path.c_str()))
+                continue;
+            FileInfo info;
+            info.view = { file->GetData(), file->GetSize() };
+            DDSArrayLayout alone;
+            if (FAILED(GetArrayLayout(&info.view, 1, 0, DDS_MAX_TEXTURE2D_ARRAY_SIZE, alone)))
+                continue;
+            info.layout = alone.layout;
+            info.initData = std::move(alone.initData);
+            files.push_back(std::move(info));
+            mappedFiles.push_back(std::move(file));
+        }
+        result.files = static_cast<uint32_t>(files.size());
+        if (files.empty())
+            return result;
+
+        auto matches = [](const DDSTextureLayout& a, const DDSTextureLayout& b)
+        {
+            return a.width == b.width && a.height == b.height && a.mipCount == b.mipCount &&
+                a.format == b.format && a.isCubeMap == b.isCubeMap;
+        };
+
+        // The large array: the files that match the first one in turn, until slices are reached
+        std::vector<size_t> compatible;
+        for (size_t i = 0; i < files.size(); i++)
+        {
+            if (matches(files[i].layout, files[0].layout))
+                compatible.push_back(i);
+        }
+        std::vector<DDSFileView> views;
+        std::vector<size_t> sources;
+        for (uint32_t slice = 0; slice < slices; slice += files[0].layout.arraySize)
+        {
+            sources.push_back(compatible[sources.size() % compatible.size()]);
+            views.push_back(files[sources.back()].view);
+        }
+
+        DDSArrayLayout arrayLayout;
+        uint64_t start = Profiler::NowNs();
+        HRESULT hr = GetArrayLayout(views.data(), views.size(), 0, DDS_MAX_TEXTURE2D_ARRAY_SIZE, arrayLayout);
+        result.layoutMs = (Profiler::NowNs() - start) * 1.0e-6;
+        if (FAILED(hr))
+        {
+            result.layoutErrors++;
+        }
+        else
+        {
+            const DDSTextureLayout& layout = arrayLayout.layout;
+            result.slices = layout.arraySize;
+            result.subresources = static_cast<uint32_t>(arrayLayout.initData.size());
+            size_t index = 0;
+            for (size_t source : sources)
+            {
+                for (const DDSSubresourceData& expected : files[source].initData)
+                {
+                    const DDSSubresourceData& actual = arrayLayout.initData[index++];
+                    if (actual.pSysMem != expected.pSysMem || actual.SysMemPitch != expected.SysMemPitch ||
+                        actual.SysMemSlicePitch != expected.SysMemSlicePitch)
+                    {
+                        result.layoutErrors++;
+                    }
+                    result.arrayBytes += actual.SysMemSlicePitch;
+                }
+            }
+            if (index != arrayLayout.initData.size())
+                result.layoutErrors++;
+        }
+
+        // Two files make an array exactly when their headers agree, their slice counts may differ
+        for (size_t a = 0; a < files.size(); a++)
+        {
+            for (size_t b = 0; b < files.size(); b++)
+            {
+                const DDSFileView pair[2] = { files[a].view, files[b].view };
+                DDSArrayLayout pairLayout;
+                bool accepted = SUCCEEDED(GetArrayLayout(pair, 2, 0, DDS_MAX_TEXTURE2D_ARRAY_SIZE, pairLayout));
+                bool expected = matches(files[a].layout, files[b].layout);
+                if (accepted != expected ||
+                    (accepted && (pairLayout.layout.arraySize != files[a].layout.arraySize + files[b].layout.arraySize ||
+                        pairLayout.failedFile != 1)) ||
+                    (!accepted && pairLayout.failedFile != 1))
+                {
+                    result.pairErrors++;
+                }
+                result.pairs++;
+            }
+        }
+
+        // What must fail, and mips above maxsize left out of every slice
+        const FileInfo& file = files[compatible.back()];
+        const DDSFileView truncated[2] = { file.view, { file.view.data, file.view.size - 1 } };
+        const DDSFileView twice[2] = { file.view, file.view };
+        DDSArrayLayout check;
+        result.checks = 4;
+        if (SUCCEEDED(GetArrayLayout(truncated, 2, 0, DDS_MAX_TEXTURE2D_ARRAY_SIZE, check)) || check.failedFile != 1)
+            result.checkErrors++;
+        if (SUCCEEDED(GetArrayLayout(twice, 2, 0, file.layout.arraySize * 2 - 1, check)) || check.failedFile != 1)
+            result.checkErrors++;
+        if (SUCCEEDED(GetArrayLayout(twice, 0, 0, DDS_MAX_TEXTURE2D_ARRAY_SIZE, check)))
+            result.checkErrors++;
+        if (file.layout.mipCount > 1 && std::max(file.layout.width, file.layout.height) > 1)
+        {
+            size_t maxsize = std::max(file.layout.width, file.layout.height) / 2;
+            if (FAILED(GetArrayLayout(twice, 2, maxsize, DDS_MAX_TEXTURE2D_ARRAY_SIZE, check)) || check.skipMip != 1 ||
+                check.layout.mipCount != file.layout.mipCount - 1 || check.layout.width != std::max(file.layout.width / 2, 1u) ||
+                check.initData.size() != static_cast<size_t>(check.layout.mipCount) * check.layout.arraySize ||
+                check.initData[0].pSysMem != file.initData[1].pSysMem)
+            {
+                result.checkErrors++;
+            }
+        }
+        return result;
+    }
+}
+}
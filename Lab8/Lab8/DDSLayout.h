@@ -0,0 +1,267 @@
+#ifndef DDS_LAYOUT_H
+#define DDS_LAYOUT_H
+
+#ifdef _WIN32
+#include <windows.h>
+#include <dxgiformat.h>
+#else
+// HRESULT and DXGI_FORMAT come from the DirectX-Headers package
+#include <wsl/winadapter.h>
+#include <directx/dxgiformat.h>
+#include <cerrno>
+
+#ifndef ERROR_ARITHMETIC_OVERFLOW
+#define ERROR_ARITHMETIC_OVERFLOW EOVERFLOW
+#endif
+#ifndef ERROR_HANDLE_EOF
+#define ERROR_HANDLE_EOF ENODATA
+#endif
+#ifndef ERROR_NOT_SUPPORTED
+#define ERROR_NOT_SUPPORTED ENOTSUP
+#endif
+#ifndef ERROR_INVALID_DATA
+#define ERROR_INVALID_DATA EINVAL
+#endif
+#endif
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#ifndef MAKEFOURCC
+#define MAKEFOURCC(ch0, ch1, ch2, ch3)                              \
+                ((uint32_t)(uint8_t)(ch0) | ((uint32_t)(uint8_t)(ch1) << 8) |       \
+                ((uint32_t)(uint8_t)(ch2) << 16) | ((uint32_t)(uint8_t)(ch3) << 24 ))
+#endif /* defined(MAKEFOURCC) */
+
+// The part of DDSTextureLoader11 that does not need Direct3D: the file structures, header
+// parsing and the layout of the pixel data in subresources. It only reads memory, so the
+// loader can run it over a heap copy of the file or straight over a mapped view, and it
+// builds on Linux against the DirectX-Headers package.
+namespace DirectX
+{
+namespace DDSLayout
+{
+    #pragma pack(push,1)
+
+    constexpr uint32_t DDS_MAGIC = 0x20534444; // "DDS "
+
+    struct DDS_PIXELFORMAT
+    {
+        uint32_t    size;
+        uint32_t    flags;
+        uint32_t    fourCC;
+        uint32_t    RGBBitCount;
+        uint32_t    RBitMask;
+        uint32_t    GBitMask;
+        uint32_t    BBitMask;
+        uint32_t    ABitMask;
+    };
+
+    #define DDS_FOURCC      0x00000004  // DDPF_FOURCC
+    #define DDS_RGB         0x00000040  // DDPF_RGB
+    #define DDS_LUMINANCE   0x00020000  // DDPF_LUMINANCE
+    #define DDS_ALPHA       0x00000002  // DDPF_ALPHA
+    #define DDS_BUMPDUDV    0x00080000  // DDPF_BUMPDUDV
+
+    #define DDS_HEADER_FLAGS_VOLUME         0x00800000  // DDSD_DEPTH
+
+    #define DDS_HEIGHT 0x00000002 // DDSD_HEIGHT
+
+    #define DDS_CUBEMAP_POSITIVEX 0x00000600 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_POSITIVEX
+    #define DDS_CUBEMAP_NEGATIVEX 0x00000a00 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_NEGATIVEX
+    #define DDS_CUBEMAP_POSITIVEY 0x00001200 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_POSITIVEY
+    #define DDS_CUBEMAP_NEGATIVEY 0x00002200 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_NEGATIVEY
+    #define DDS_CUBEMAP_POSITIVEZ 0x00004200 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_POSITIVEZ
+    #define DDS_CUBEMAP_NEGATIVEZ 0x00008200 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_NEGATIVEZ
+
+    #define DDS_CUBEMAP_ALLFACES ( DDS_CUBEMAP_POSITIVEX | DDS_CUBEMAP_NEGATIVEX |\
+                                DDS_CUBEMAP_POSITIVEY | DDS_CUBEMAP_NEGATIVEY |\
+                                DDS_CUBEMAP_POSITIVEZ | DDS_CUBEMAP_NEGATIVEZ )
+
+    #define DDS_CUBEMAP 0x00000200 // DDSCAPS2_CUBEMAP
+
+    enum DDS_MISC_FLAGS2
+    {
+        DDS_MISC_FLAGS2_ALPHA_MODE_MASK = 0x7L,
+    };
+
+    // DDS_HEADER_DXT10::resourceDimension, the values of D3D11_RESOURCE_DIMENSION
+    enum DDS_RESOURCE_DIMENSION : uint32_t
+    {
+        DDS_DIMENSION_TEXTURE1D = 2,
+        DDS_DIMENSION_TEXTURE2D = 3,
+        DDS_DIMENSION_TEXTURE3D = 4,
+    };
+
+    // DDS_HEADER_DXT10::miscFlag, D3D11_RESOURCE_MISC_TEXTURECUBE
+    constexpr uint32_t DDS_RESOURCE_MISC_TEXTURECUBE = 0x4;
+
+    // D3D11_REQ_TEXTURE2D_ARRAY_AXIS_DIMENSION
+    constexpr size_t DDS_MAX_TEXTURE2D_ARRAY_SIZE = 2048;
+
+    struct DDS_HEADER
+    {
+        uint32_t        size;
+        uint32_t        flags;
+        uint32_t        height;
+        uint32_t        width;
+        uint32_t        pitchOrLinearSize;
+        uint32_t        depth; // only if DDS_HEADER_FLAGS_VOLUME is set in flags
+        uint32_t        mipMapCount;
+        uint32_t        reserved1[11];
+        DDS_PIXELFORMAT ddspf;
+        uint32_t        caps;
+        uint32_t        caps2;
+        uint32_t        caps3;
+        uint32_t        caps4;
+        uint32_t        reserved2;
+    };
+
+    struct DDS_HEADER_DXT10
+    {
+        DXGI_FORMAT     dxgiFormat;
+        uint32_t        resourceDimension;
+        uint32_t        miscFlag; // see D3D11_RESOURCE_MISC_FLAG
+        uint32_t        arraySize;
+        uint32_t        miscFlags2;
+    };
+
+    #pragma pack(pop)
+
+    static_assert(sizeof(DDS_PIXELFORMAT) == 32, "DDS pixel format size mismatch");
+    static_assert(sizeof(DDS_HEADER) == 124, "DDS Header size mismatch");
+    static_assert(sizeof(DDS_HEADER_DXT10) == 20, "DDS DX10 Extended Header size mismatch");
+
+    constexpr size_t DDS_MIN_HEADER_SIZE = sizeof(uint32_t) + sizeof(DDS_HEADER);
+    constexpr size_t DDS_DX10_HEADER_SIZE = sizeof(uint32_t) + sizeof(DDS_HEADER) + sizeof(DDS_HEADER_DXT10);
+    static_assert(DDS_DX10_HEADER_SIZE > DDS_MIN_HEADER_SIZE, "DDS DX10 Header should be larger than standard header");
+
+    // Same layout as D3D11_SUBRESOURCE_DATA
+    struct DDSSubresourceData
+    {
+        const void* pSysMem;
+        uint32_t SysMemPitch;
+        uint32_t SysMemSlicePitch;
+    };
+
+    // What the header says about the resource, before any device limits are applied
+    struct DDSTextureLayout
+    {
+        uint32_t resDim;            // DDS_DIMENSION_*
+        uint32_t width;
+        uint32_t height;
+        uint32_t depth;
+        uint32_t mipCount;
+        uint32_t arraySize;         // six per cube
+        DXGI_FORMAT format;
+        bool isCubeMap;
+    };
+
+    // One whole DDS file, a heap copy or a mapped view
+    struct DDSFileView
+    {
+        const uint8_t* data;
+        size_t size;
+    };
+
+    // The 2D textures of several files as one array, the slices of every file one after another
+    struct DDSArrayLayout
+    {
+        DDSTextureLayout layout;                    // of the array: arraySize counts every slice, mips above maxsize are left out
+        size_t skipMip;
+        size_t failedFile;                          // on failure, the file that did not parse or did not match the first one
+        std::vector<DDSSubresourceData> initData;   // slice * mipCount + mip, the order of D3D11 subresources
+    };
+
+    struct DDSArrayBenchmarkResult
+    {
+        uint32_t files;             // paths that parsed
+        uint32_t slices;            // of the large array, the files that match the first one in turn
+        uint32_t subresources;
+        uint64_t arrayBytes;        // initial data of the large array, all of it pointing into the files
+        double layoutMs;            // GetArrayLayout of the large array, one call
+        uint32_t pairs;             // every ordered pair of files as a two file array
+        uint32_t pairErrors;        // pairs accepted or rejected against what their headers say
+        uint32_t layoutErrors;      // initial data that is not the same mip of the same file laid out alone
+        uint32_t checks;            // truncated file, too many slices, empty list, maxsize
+        uint32_t checkErrors;
+    };
+
+    struct DDSLoadBenchmarkResult
+    {
+        uint32_t files;             // files that parsed, per pass
+        uint32_t failedFiles;
+        uint32_t passes;
+        uint64_t fileBytes;         // one pass
+        double readMs;              // ReadFile style copy into a heap buffer, then the upload copy
+        double mappedMs;            // subresources straight over a mapped view, then the upload copy
+        uint64_t readPeakBytes;     // largest heap copy plus its texture, what the loader holds at once
+        uint64_t mappedPeakBytes;   // the texture only, mapped pages are shared with the file cache
+    };
+
+    // Checks the magic number and headers; bitData points into ddsData
+    HRESULT LoadTextureDataFromMemory(
+        const uint8_t* ddsData,
+        size_t ddsDataSize,
+        const DDS_HEADER** header,
+        const uint8_t** bitData,
+        size_t* bitSize) noexcept;
+
+    // Return the BPP for a particular format
+    size_t BitsPerPixel(DXGI_FORMAT fmt) noexcept;
+
+    // Get surface information for a particular format
+    HRESULT GetSurfaceInfo(
+        size_t width,
+        size_t height,
+        DXGI_FORMAT fmt,
+        size_t* outNumBytes,
+        size_t* outRowBytes,
+        size_t* outNumRows) noexcept;
+
+    DXGI_FORMAT GetDXGIFormat(const DDS_PIXELFORMAT& ddpf) noexcept;
+
+    // Format, dimension and sizes of the texture, validated against the file format only
+    HRESULT GetTextureLayout(const DDS_HEADER* header, DDSTextureLayout& layout) noexcept;
+
+    // Points initData[mipCount * arraySize] at the pixel data, skipping mips larger than maxsize
+    HRESULT FillInitData(
+        size_t width,
+        size_t height,
+        size_t depth,
+        size_t mipCount,
+        size_t arraySize,
+        DXGI_FORMAT format,
+        size_t maxsize,
+        size_t bitSize,
+        const uint8_t* bitData,
+        size_t& twidth,
+        size_t& theight,
+        size_t& tdepth,
+        size_t& skipMip,
+        DDSSubresourceData* initData) noexcept;
+
+    // Checks every file, and that all of them match the first one in size, format, mips and cube
+    // flag, then points initData into the files; nothing is copied, so the files stay alive until
+    // the texture is created. maxArraySize is the device limit on slices.
+    HRESULT GetArrayLayout(
+        const DDSFileView* files,
+        size_t fileCount,
+        size_t maxsize,
+        size_t maxArraySize,
+        DDSArrayLayout& arrayLayout) noexcept;
+
+    // Lays out an array of slices slices from the mapped files (UTF-8 paths) and checks it
+    // against every file laid out alone, then the files in pairs and the cases that must fail
+    DDSArrayBenchmarkResult BenchmarkArrayLayout(const std::vector<std::string>& paths, uint32_t slices);
+
+    // Loads every file (UTF-8 paths) passes times both ways after one warm-up pass, so both
+    // paths read from the file cache. The upload copy stands in for what the driver does with
+    // the initial data of CreateTexture2D.
+    DDSLoadBenchmarkResult BenchmarkLoading(const std::vector<std::string>& paths, uint32_t passes);
+}
+}
+
+#endif
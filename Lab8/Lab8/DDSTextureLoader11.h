@@ -46,6 +46,7 @@ namespace DirectX
         DDS_LOADER_DEFAULT = 0,
         DDS_LOADER_FORCE_SRGB = 0x1,
         DDS_LOADER_IGNORE_SRGB = 0x2,
+        DDS_LOADER_MEMORY_MAP = 0x8,    // file loads map the file instead of reading it into a heap copy
     };
 
 #ifdef __clang__
@@ -155,4 +156,19 @@ namespace DirectX
         _Outptr_opt_ ID3D11Resource** texture,
         _Outptr_opt_ ID3D11ShaderResourceView** textureView,
         _Out_opt_ DDS_ALPHA_MODE* alphaMode = nullptr) noexcept;
+
+    // One Texture2DArray of the slices of every file in turn, created with all of its initial
+    // data in one call. The files must match the first one in size, format, mips and cube
+    // flag; they are mapped, so the pixel data goes to the driver without a copy. A single
+    // file of a single slice gets a Texture2D view. failedFile receives the file that could
+    // not be opened or did not match.
+    HRESULT CreateDDSTextureArrayFromFiles(
+        _In_ ID3D11Device* d3dDevice,
+        _In_reads_(fileCount) const wchar_t* const* fileNames,
+        _In_ size_t fileCount,
+        _Outptr_opt_ ID3D11Resource** texture,
+        _Outptr_opt_ ID3D11ShaderResourceView** textureView,
+        _In_ size_t maxsize = 0,
+        _In_ DDS_LOADER_FLAGS loadFlags = DDS_LOADER_DEFAULT,
+        _Out_opt_ size_t* failedFile = nullptr) noexcept;
 }
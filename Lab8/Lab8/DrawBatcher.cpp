@@ -0,0 +1,96 @@
+#include "DrawBatcher.h"
+#include <algorithm>
+
+void DrawBatcher::Clear()
+{
+    m_items.clear();
+    m_batches.clear();
+    m_instances.clear();
+}
+
+void DrawBatcher::Add(const DrawItem& item)
+{
+    m_items.push_back(item);
+}
+
+void DrawBatcher::Build()
+{
+    m_batches.clear();
+    m_instances.clear();
+    m_instances.reserve(m_items.size());
+
+    std::vector<const DrawItem*> opaque;
+    std::vector<const DrawItem*> transparent;
+    for (const auto& item : m_items)
+    {
+        if (item.transparent)
+            transparent.push_back(&item);
+        else
+            opaque.push_back(&item);
+    }
+
+    // Opaque order does not matter, so everything with the same key ends up in one run
+    std::stable_sort(opaque.begin(), opaque.end(), [](const DrawItem* a, const DrawItem* b) {
+        return a->key < b->key;
+        });
+
+    // Transparent order does matter: farthest first, ties keep submission order
+    std::stable_sort(transparent.begin(), transparent.end(), [](const DrawItem* a, const DrawItem* b) {
+        return a->sortDepth > b->sortDepth;
+        });
+
+    AppendBatches(opaque, false);
+    AppendBatches(transparent, true);
+}
+
+void DrawBatcher::AppendBatches(const std::vector<const DrawItem*>& sorted, bool transparent)
+{
+    for (const DrawItem* item : sorted)
+    {
+        bool startNew = m_batches.empty() ||
+            m_batches.back().transparent != transparent ||
+            !(m_batches.back().key == item->key) ||
+            m_batches.back().instanceCount >= m_maxInstancesPerBatch;
+
+        if (startNew)
+        {
+            DrawBatch batch;
+            batch.key = item->key;
+            batch.firstInstance = static_cast<uint32_t>(m_instances.size());
+            batch.instanceCount = 0;
+            batch.transparent = transparent;
+            m_batches.push_back(batch);
+        }
+
+        m_instances.push_back(item->instance);
+        m_batches.back().instanceCount++;
+    }
+}
+
+uint32_t DrawBatcher::Submit(RenderBackend& backend, BackendHandle instanceBuffer,
+    const std::function<BatchBinding(const DrawKey&)>& resolve) const
+{
+    backend.BindConstantBuffer(ShaderStage::Vertex, 0, instanceBuffer);
+
+    bool hasBound = false;
+    DrawKey boundKey = {};
+    BatchBinding binding = {};
+    for (const auto& batch : m_batches)
+    {
+        if (!hasBound || !(batch.key == boundKey))
+        {
+            binding = resolve(batch.key);
+            backend.BindPipeline(binding.pipeline);
+            backend.BindVertexBuffer(binding.vertexBuffer, binding.vertexStride);
+            backend.BindIndexBuffer(binding.indexBuffer);
+            boundKey = batch.key;
+            hasBound = true;
+        }
+
+        backend.UpdateBuffer(instanceBuffer, &m_instances[batch.firstInstance],
+            static_cast<uint32_t>(sizeof(InstanceColorData) * batch.instanceCount));
+        backend.DrawIndexedInstanced(binding.indexCount, batch.instanceCount);
+    }
+
+    return static_cast<uint32_t>(m_batches.size());
+}
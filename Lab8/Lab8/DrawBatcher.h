@@ -0,0 +1,99 @@
+#ifndef DRAW_BATCHER_H
+#define DRAW_BATCHER_H
+
+#include <DirectXMath.h>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "RenderBackend.h"
+
+using namespace DirectX;
+
+// Identifies what a draw needs bound: draws with equal keys can share one instanced draw call.
+struct DrawKey
+{
+    uint32_t mesh;
+    uint32_t shader;
+    uint32_t state;
+
+    bool operator==(const DrawKey& other) const
+    {
+        return mesh == other.mesh && shader == other.shader && state == other.state;
+    }
+
+    bool operator<(const DrawKey& other) const
+    {
+        if (state != other.state) return state < other.state;
+        if (shader != other.shader) return shader < other.shader;
+        return mesh < other.mesh;
+    }
+};
+
+// Per-instance data as seen by InstancedVertex.vs (model is stored transposed, ready for upload).
+struct InstanceColorData
+{
+    XMFLOAT4X4 model;
+    XMFLOAT4 color;
+};
+
+struct DrawItem
+{
+    DrawKey key;
+    InstanceColorData instance;
+    bool transparent;
+    float sortDepth; // distance to the camera, used only for transparent items
+};
+
+// Backend resources a key resolves to when the batches are submitted
+struct BatchBinding
+{
+    BackendHandle pipeline;
+    BackendHandle vertexBuffer;
+    uint32_t vertexStride;
+    BackendHandle indexBuffer;
+    uint32_t indexCount;
+};
+
+struct DrawBatch
+{
+    DrawKey key;
+    uint32_t firstInstance;
+    uint32_t instanceCount;
+    bool transparent;
+};
+
+// Collects single draws for a frame and merges the ones sharing mesh, shader and state into
+// instanced batches. Opaque items are grouped by key, transparent items are sorted back to front
+// and only neighbours with the same key are merged, so blending order is preserved.
+class DrawBatcher
+{
+public:
+    DrawBatcher() : m_maxInstancesPerBatch(256) {}
+
+    void SetMaxInstancesPerBatch(uint32_t maxInstances) { m_maxInstancesPerBatch = maxInstances > 0 ? maxInstances : 1; }
+
+    void Clear();
+    void Add(const DrawItem& item);
+    void Build();
+
+    const std::vector<DrawBatch>& GetBatches() const { return m_batches; }
+    const std::vector<InstanceColorData>& GetInstances() const { return m_instances; }
+    size_t GetItemCount() const { return m_items.size(); }
+
+    // Issues the built batches: rebinds only when the key changes, uploads each batch's
+    // instances into instanceBuffer (VS slot 0) and draws it instanced. Returns the draw count.
+    uint32_t Submit(RenderBackend& backend, BackendHandle instanceBuffer,
+        const std::function<BatchBinding(const DrawKey&)>& resolve) const;
+
+private:
+    void AppendBatches(const std::vector<const DrawItem*>& sorted, bool transparent);
+
+    uint32_t m_maxInstancesPerBatch;
+    std::vector<DrawItem> m_items;
+    std::vector<DrawBatch> m_batches;
+    std::vector<InstanceColorData> m_instances;
+};
+
+#endif
@@ -0,0 +1,524 @@
+#include "EnvironmentLighting.h"
+#include "Profiler.h"
+#include "SoftwareRasterizer.h"
+#include "SoftwareTexture.h"
+#include "ThreadPool.h"
+#include <DirectXPackedVector.h>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+
+namespace
+{
+    const uint32_t DxgiFormatR16G16B16A16Float = 10;
+
+    void RunParallel(ThreadPool* pPool, uint32_t count, const std::function<void(uint32_t)>& task)
+    {
+        if (pPool)
+            pPool->ParallelFor(count, [&task](uint32_t index, uint32_t) { task(index); });
+        else
+        {
+            for (uint32_t i = 0; i < count; i++)
+                task(i);
+        }
+    }
+
+    // Direction through face coordinates sc, tc in [-1, 1], D3D cube map convention
+    // (the inverse of the face selection in SoftwareTexture::SampleCube)
+    SwFloat3 FaceDirection(uint32_t face, const SwFloat& sc, const SwFloat& tc)
+    {
+        SwFloat one(1.0f);
+        SwFloat minusOne(-1.0f);
+        SwFloat zero(0.0f);
+        switch (face)
+        {
+        case 0: return SwFloat3(one, zero - tc, zero - sc);
+        case 1: return SwFloat3(minusOne, zero - tc, sc);
+        case 2: return SwFloat3(sc, one, tc);
+        case 3: return SwFloat3(sc, minusOne, zero - tc);
+        case 4: return SwFloat3(sc, zero - tc, one);
+        default: return SwFloat3(zero - sc, zero - tc, minusOne);
+        }
+    }
+
+    // Real L2 basis in the usual order: Y00, Y1-1, Y10, Y11, Y2-2, Y2-1, Y20, Y21, Y22
+    void EvaluateBasis(const SwFloat3& d, SwFloat basis[9])
+    {
+        basis[0] = SwFloat(0.282095f);
+        basis[1] = d.y * 0.488603f;
+        basis[2] = d.z * 0.488603f;
+        basis[3] = d.x * 0.488603f;
+        basis[4] = d.x * d.y * 1.092548f;
+        basis[5] = d.y * d.z * 1.092548f;
+        basis[6] = (d.z * d.z * 3.0f - 1.0f) * 0.315392f;
+        basis[7] = d.x * d.z * 1.092548f;
+        basis[8] = (d.x * d.x - d.y * d.y) * 0.546274f;
+    }
+
+    float RadicalInverse(uint32_t bits)
+    {
+        bits = (bits << 16) | (bits >> 16);
+        bits = ((bits & 0x55555555u) << 1) | ((bits & 0xAAAAAAAAu) >> 1);
+        bits = ((bits & 0x33333333u) << 2) | ((bits & 0xCCCCCCCCu) >> 2);
+        bits = ((bits & 0x0F0F0F0Fu) << 4) | ((bits & 0xF0F0F0F0u) >> 4);
+        bits = ((bits & 0x00FF00FFu) << 8) | ((bits & 0xFF00FF00u) >> 8);
+        return bits * 2.3283064365386963e-10f;
+    }
+
+    uint32_t ClampCoord(int coord, uint32_t size)
+    {
+        if (coord < 0)
+            return 0;
+        return static_cast<uint32_t>(coord) < size ? static_cast<uint32_t>(coord) : size - 1;
+    }
+
+    __m128 SampleFace(const std::vector<float>& face, uint32_t size, float u, float v)
+    {
+        float x = u * size - 0.5f;
+        float y = v * size - 0.5f;
+        float fx0 = floorf(x);
+        float fy0 = floorf(y);
+        __m128 wx = _mm_set1_ps(x - fx0);
+        __m128 wy = _mm_set1_ps(y - fy0);
+        uint32_t xa = ClampCoord(static_cast<int>(fx0), size);
+        uint32_t xb = ClampCoord(static_cast<int>(fx0) + 1, size);
+        const float* rowA = face.data() + static_cast<size_t>(ClampCoord(static_cast<int>(fy0), size)) * size * 4;
+        const float* rowB = face.data() + static_cast<size_t>(ClampCoord(static_cast<int>(fy0) + 1, size)) * size * 4;
+
+        __m128 t00 = _mm_loadu_ps(rowA + xa * 4);
+        __m128 t10 = _mm_loadu_ps(rowA + xb * 4);
+        __m128 t01 = _mm_loadu_ps(rowB + xa * 4);
+        __m128 t11 = _mm_loadu_ps(rowB + xb * 4);
+        __m128 top = _mm_add_ps(t00, _mm_mul_ps(_mm_sub_ps(t10, t00), wx));
+        __m128 bottom = _mm_add_ps(t01, _mm_mul_ps(_mm_sub_ps(t11, t01), wx));
+        return _mm_add_ps(top, _mm_mul_ps(_mm_sub_ps(bottom, top), wy));
+    }
+
+    uint32_t MipCount(uint32_t size)
+    {
+        uint32_t count = 1;
+        while (size > 1)
+        {
+            size /= 2;
+            count++;
+        }
+        return count;
+    }
+}
+
+bool EnvironmentLighting::SetSource(const SoftwareTexture& cube)
+{
+    if (!cube.IsCube() || cube.GetSliceCount() < 6 || cube.GetWidth() != cube.GetHeight() || cube.GetWidth() < MinPrefilteredSize)
+        return false;
+
+    m_sourceSize = cube.GetWidth();
+    for (uint32_t face = 0; face < 6; face++)
+    {
+        const std::vector<uint32_t>& texels = cube.GetTexels(face, 0);
+        m_source[face].assign(1, std::vector<float>(texels.size() * 4));
+        float* pDest = m_source[face][0].data();
+        for (size_t i = 0; i < texels.size(); i++)
+        {
+            for (int c = 0; c < 4; c++)
+                pDest[i * 4 + c] = ((texels[i] >> (c * 8)) & 0xFF) * (1.0f / 255.0f);
+        }
+    }
+    return true;
+}
+
+bool EnvironmentLighting::SetSource(uint32_t faceSize, const std::vector<float> faces[6])
+{
+    if (faceSize < MinPrefilteredSize)
+        return false;
+    for (uint32_t face = 0; face < 6; face++)
+    {
+        if (faces[face].size() != static_cast<size_t>(faceSize) * faceSize * 4)
+            return false;
+    }
+
+    m_sourceSize = faceSize;
+    for (uint32_t face = 0; face < 6; face++)
+        m_source[face].assign(1, faces[face]);
+    return true;
+}
+
+void EnvironmentLighting::Compute()
+{
+    if (m_sourceSize == 0)
+        return;
+
+    PROFILE_SCOPE("Environment Lighting");
+    ProjectSH();
+    BuildSourceMips();
+    Prefilter();
+}
+
+void EnvironmentLighting::ProjectSH()
+{
+    PROFILE_SCOPE("Project SH");
+
+    // Every face row sums its own 9 x rgb coefficients and solid angle, rows are then added
+    // up in a fixed order so the result does not depend on the thread count
+    const uint32_t size = m_sourceSize;
+    std::vector<double> rowSums(static_cast<size_t>(6) * size * 28, 0.0);
+    RunParallel(m_pPool, 6 * size, [this, size, &rowSums](uint32_t task)
+    {
+        uint32_t face = task / size;
+        uint32_t row = task % size;
+        const float* pRow = m_source[face][0].data() + static_cast<size_t>(row) * size * 4;
+        float texelScale = 2.0f / size;
+
+        SwFloat sums[27];
+        SwFloat weightSum(0.0f);
+        SwFloat tc((row + 0.5f) * texelScale - 1.0f);
+        for (uint32_t x = 0; x < size; x += 4)
+        {
+            SwFloat sc = _mm_add_ps(_mm_set1_ps((x + 0.5f) * texelScale - 1.0f),
+                _mm_mul_ps(_mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f), _mm_set1_ps(texelScale)));
+
+            // Solid angle of a texel: (2 / size)^2 / (1 + sc^2 + tc^2)^(3/2)
+            SwFloat lengthSq = sc * sc + tc * tc + 1.0f;
+            SwFloat invLength = SwFloat(1.0f) / Sqrt(lengthSq);
+            SwFloat weight = invLength * invLength * invLength * (texelScale * texelScale);
+            SwFloat3 direction = FaceDirection(face, sc, tc) * invLength;
+            SwFloat basis[9];
+            EvaluateBasis(direction, basis);
+
+            // Four RGBA texels become r, g, b and a registers
+            __m128 t0 = _mm_loadu_ps(pRow + x * 4);
+            __m128 t1 = _mm_loadu_ps(pRow + x * 4 + 4);
+            __m128 t2 = _mm_loadu_ps(pRow + x * 4 + 8);
+            __m128 t3 = _mm_loadu_ps(pRow + x * 4 + 12);
+            _MM_TRANSPOSE4_PS(t0, t1, t2, t3);
+            SwFloat color[3] = { SwFloat(t0) * weight, SwFloat(t1) * weight, SwFloat(t2) * weight };
+
+            for (int i = 0; i < 9; i++)
+            {
+                for (int c = 0; c < 3; c++)
+                    sums[i * 3 + c] += color[c] * basis[i];
+            }
+            weightSum += weight;
+        }
+
+        double* pSums = &rowSums[static_cast<size_t>(task) * 28];
+        for (int i = 0; i < 27; i++)
+            pSums[i] = static_cast<double>(sums[i][0]) + sums[i][1] + sums[i][2] + sums[i][3];
+        pSums[27] = static_cast<double>(weightSum[0]) + weightSum[1] + weightSum[2] + weightSum[3];
+    });
+
+    double total[28] = {};
+    for (size_t task = 0; task < static_cast<size_t>(6) * size; task++)
+    {
+        for (int i = 0; i < 28; i++)
+            total[i] += rowSums[task * 28 + i];
+    }
+
+    // The texel solid angles are approximate, rescale so they cover the sphere exactly.
+    // Irradiance convolution: band l is scaled by A_l / pi with A = (pi, 2pi/3, pi/4).
+    const double pi = 3.14159265358979323846;
+    double normalize = total[27] > 0.0 ? 4.0 * pi / total[27] : 0.0;
+    const double band[9] = { 1.0, 2.0 / 3.0, 2.0 / 3.0, 2.0 / 3.0, 0.25, 0.25, 0.25, 0.25, 0.25 };
+    for (int i = 0; i < 9; i++)
+    {
+        float scale = static_cast<float>(normalize * band[i]);
+        m_sh[i] = XMFLOAT4(static_cast<float>(total[i * 3]) * scale, static_cast<float>(total[i * 3 + 1]) * scale,
+            static_cast<float>(total[i * 3 + 2]) * scale, 0.0f);
+    }
+}
+
+void EnvironmentLighting::BuildSourceMips()
+{
+    PROFILE_SCOPE("Source Mips");
+
+    uint32_t mipCount = MipCount(m_sourceSize);
+    for (uint32_t face = 0; face < 6; face++)
+        m_source[face].resize(1);
+
+    for (uint32_t mip = 1; mip < mipCount; mip++)
+    {
+        uint32_t size = m_sourceSize >> mip;
+        for (uint32_t face = 0; face < 6; face++)
+            m_source[face].emplace_back(static_cast<size_t>(size) * size * 4);
+
+        // 2x2 box filter, one RGBA texel per register
+        RunParallel(m_pPool, 6 * size, [this, mip, size](uint32_t task)
+        {
+            uint32_t face = task / size;
+            uint32_t row = task % size;
+            const float* pRowA = m_source[face][mip - 1].data() + static_cast<size_t>(row * 2) * size * 2 * 4;
+            const float* pRowB = pRowA + size * 2 * 4;
+            float* pDest = m_source[face][mip].data() + static_cast<size_t>(row) * size * 4;
+            __m128 quarter = _mm_set1_ps(0.25f);
+            for (uint32_t x = 0; x < size; x++)
+            {
+                __m128 sum = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(pRowA + x * 8), _mm_loadu_ps(pRowA + x * 8 + 4)),
+                    _mm_add_ps(_mm_loadu_ps(pRowB + x * 8), _mm_loadu_ps(pRowB + x * 8 + 4)));
+                _mm_storeu_ps(pDest + x * 4, _mm_mul_ps(sum, quarter));
+            }
+        });
+    }
+}
+
+void EnvironmentLighting::Prefilter()
+{
+    PROFILE_SCOPE("Prefilter GGX");
+
+    m_prefilteredSize = m_sourceSize < MaxPrefilteredSize ? m_sourceSize : MaxPrefilteredSize;
+    uint32_t mipCount = MipCount(m_prefilteredSize / MinPrefilteredSize);
+    for (uint32_t face = 0; face < 6; face++)
+    {
+        m_prefiltered[face].resize(mipCount);
+        for (uint32_t mip = 0; mip < mipCount; mip++)
+        {
+            uint32_t size = m_prefilteredSize >> mip;
+            m_prefiltered[face][mip].assign(static_cast<size_t>(size) * size * 4, 0.0f);
+        }
+    }
+
+    const float pi = XM_PI;
+    float sourceTexelAngle = 4.0f * pi / (6.0f * m_sourceSize * m_sourceSize);
+    m_samples.assign(mipCount, std::vector<XMFLOAT4>());
+    m_sampleWeights.assign(mipCount, 0.0f);
+    for (uint32_t mip = 0; mip < mipCount; mip++)
+    {
+        std::vector<XMFLOAT4>& samples = m_samples[mip];
+        if (mip == 0)
+        {
+            // Roughness 0 is a mirror: a plain resample of the source
+            float lod = log2f(static_cast<float>(m_sourceSize) / m_prefilteredSize);
+            samples.push_back(XMFLOAT4(0.0f, 0.0f, 1.0f, lod));
+            m_sampleWeights[mip] = 1.0f;
+        }
+        else
+        {
+            // Split-sum prefilter with N = V = R; importance sampled GGX, each sample read
+            // from the source mip whose texels match its solid angle
+            float roughness = static_cast<float>(mip) / (mipCount - 1);
+            float alpha = roughness * roughness;
+            float alphaSq = alpha * alpha;
+            for (uint32_t i = 0; i < PrefilterSamples; i++)
+            {
+                float u1 = (i + 0.5f) / PrefilterSamples;
+                float u2 = RadicalInverse(i);
+                float phi = 2.0f * pi * u1;
+                float cosTheta = sqrtf((1.0f - u2) / (1.0f + (alphaSq - 1.0f) * u2));
+                float sinTheta = sqrtf(1.0f - cosTheta * cosTheta);
+                float h[3] = { sinTheta * cosf(phi), sinTheta * sinf(phi), cosTheta };
+                float l[3] = { 2.0f * cosTheta * h[0], 2.0f * cosTheta * h[1], 2.0f * cosTheta * h[2] - 1.0f };
+                if (l[2] <= 0.0f)
+                    continue;
+
+                float denominator = cosTheta * cosTheta * (alphaSq - 1.0f) + 1.0f;
+                float distribution = alphaSq / (pi * denominator * denominator);
+                float pdf = distribution * 0.25f;
+                float sampleAngle = 1.0f / (PrefilterSamples * pdf + 1.0e-6f);
+                float lod = 0.5f * log2f(sampleAngle / sourceTexelAngle) + 1.0f;
+                samples.push_back(XMFLOAT4(l[0], l[1], l[2], lod > 0.0f ? lod : 0.0f));
+                m_sampleWeights[mip] += l[2];
+            }
+        }
+    }
+
+    // Mips only read the source, so the rows of every face and mip go out as one batch
+    // instead of waiting for each small mip to finish on its own
+    std::vector<uint32_t> firstRows(mipCount + 1, 0);
+    for (uint32_t mip = 0; mip < mipCount; mip++)
+        firstRows[mip + 1] = firstRows[mip] + 6 * (m_prefilteredSize >> mip);
+    RunParallel(m_pPool, firstRows[mipCount], [this, &firstRows](uint32_t task)
+    {
+        uint32_t mip = 0;
+        while (task >= firstRows[mip + 1])
+            mip++;
+        uint32_t size = m_prefilteredSize >> mip;
+        uint32_t row = task - firstRows[mip];
+        PrefilterRow(mip, row / size, row % size);
+    });
+}
+
+void EnvironmentLighting::PrefilterRow(uint32_t mip, uint32_t face, uint32_t row)
+{
+    uint32_t size = m_prefilteredSize >> mip;
+    float texelScale = 2.0f / size;
+    float* pDest = m_prefiltered[face][mip].data() + static_cast<size_t>(row) * size * 4;
+    SwFloat tc((row + 0.5f) * texelScale - 1.0f);
+    float invWeight = 1.0f / m_sampleWeights[mip];
+
+    for (uint32_t x = 0; x < size; x += 4)
+    {
+        SwFloat sc = _mm_add_ps(_mm_set1_ps((x + 0.5f) * texelScale - 1.0f),
+            _mm_mul_ps(_mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f), _mm_set1_ps(texelScale)));
+        SwFloat3 n = Normalize(FaceDirection(face, sc, tc));
+
+        // Tangent frame of four normals at once, basis after Duff et al. 2017
+        SwFloat sign = Select(_mm_cmpge_ps(n.z.v, _mm_setzero_ps()), 1.0f, -1.0f);
+        SwFloat a = SwFloat(-1.0f) / (sign + n.z);
+        SwFloat b = n.x * n.y * a;
+        SwFloat3 tangent(SwFloat(1.0f) + sign * n.x * n.x * a, sign * b, SwFloat(0.0f) - sign * n.x);
+        SwFloat3 bitangent(b, sign + n.y * n.y * a, SwFloat(0.0f) - n.y);
+
+        __m128 sums[4] = { _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps() };
+        for (const XMFLOAT4& sample : m_samples[mip])
+        {
+            SwFloat3 l = tangent * SwFloat(sample.x) + bitangent * SwFloat(sample.y) + n * SwFloat(sample.z);
+            alignas(16) float lx[4];
+            alignas(16) float ly[4];
+            alignas(16) float lz[4];
+            _mm_store_ps(lx, l.x.v);
+            _mm_store_ps(ly, l.y.v);
+            _mm_store_ps(lz, l.z.v);
+
+            // The tangent space sample is shared, so its weight and lod are the same in every lane
+            __m128 weight = _mm_set1_ps(sample.z);
+            for (int lane = 0; lane < 4; lane++)
+            {
+                float direction[3] = { lx[lane], ly[lane], lz[lane] };
+                alignas(16) float color[4];
+                SampleSource(direction, sample.w, color);
+                sums[lane] = _mm_add_ps(sums[lane], _mm_mul_ps(_mm_load_ps(color), weight));
+            }
+        }
+
+        for (int lane = 0; lane < 4; lane++)
+            _mm_storeu_ps(pDest + (x + lane) * 4, _mm_mul_ps(sums[lane], _mm_set1_ps(invWeight)));
+    }
+}
+
+void EnvironmentLighting::SampleSource(const float direction[3], float lod, float out[4]) const
+{
+    // Face selection as in SoftwareTexture::SampleCube
+    float x = direction[0], y = direction[1], z = direction[2];
+    float ax = fabsf(x), ay = fabsf(y), az = fabsf(z);
+    uint32_t face;
+    float sc, tc, ma;
+    if (ax >= ay && ax >= az)
+    {
+        face = x >= 0.0f ? 0 : 1;
+        sc = x >= 0.0f ? -z : z;
+        tc = -y;
+        ma = ax;
+    }
+    else if (ay >= az)
+    {
+        face = y >= 0.0f ? 2 : 3;
+        sc = x;
+        tc = y >= 0.0f ? z : -z;
+        ma = ay;
+    }
+    else
+    {
+        face = z >= 0.0f ? 4 : 5;
+        sc = z >= 0.0f ? x : -x;
+        tc = -y;
+        ma = az;
+    }
+
+    float u = 0.5f * (sc / ma + 1.0f);
+    float v = 0.5f * (tc / ma + 1.0f);
+    const std::vector<std::vector<float>>& mips = m_source[face];
+    float maxLod = static_cast<float>(mips.size() - 1);
+    lod = lod < maxLod ? lod : maxLod;
+    uint32_t level = static_cast<uint32_t>(lod);
+    float blend = lod - static_cast<float>(level);
+
+    __m128 result = SampleFace(mips[level], m_sourceSize >> level, u, v);
+    if (blend > 0.0f && level + 1 < mips.size())
+    {
+        __m128 next = SampleFace(mips[level + 1], m_sourceSize >> (level + 1), u, v);
+        result = _mm_add_ps(result, _mm_mul_ps(_mm_sub_ps(next, result), _mm_set1_ps(blend)));
+    }
+    _mm_storeu_ps(out, result);
+}
+
+bool EnvironmentLighting::SavePrefilteredDDS(const char* path) const
+{
+    uint32_t mipCount = GetPrefilteredMipCount();
+    if (m_prefilteredSize == 0 || mipCount == 0)
+        return false;
+
+    FILE* file = nullptr;
+#ifdef _MSC_VER
+    if (fopen_s(&file, path, "wb") != 0)
+        file = nullptr;
+#else
+    file = fopen(path, "wb");
+#endif
+    if (!file)
+        return false;
+
+    // DDS_HEADER with a DX10 extension: RGBA16F cube map with a mip chain
+    uint32_t header[37] = {};
+    header[0] = 0x20534444;                 // "DDS "
+    header[1] = 124;
+    header[2] = 0x1 | 0x2 | 0x4 | 0x8 | 0x1000 | 0x20000;  // caps, height, width, pitch, pixel format, mip count
+    header[3] = m_prefilteredSize;
+    header[4] = m_prefilteredSize;
+    header[5] = m_prefilteredSize * 8;
+    header[7] = mipCount;
+    header[19] = 32;
+    header[20] = 0x4;                       // DDPF_FOURCC
+    header[21] = 0x30315844;                // "DX10"
+    header[27] = 0x1000 | 0x8 | 0x400000;   // texture, complex, mip map
+    header[28] = 0x200 | 0xFC00;            // cube map with all six faces
+    header[32] = DxgiFormatR16G16B16A16Float;
+    header[33] = 3;                         // D3D10_RESOURCE_DIMENSION_TEXTURE2D
+    header[34] = 0x4;                       // D3D11_RESOURCE_MISC_TEXTURECUBE
+    header[35] = 1;
+    bool ok = fwrite(header, sizeof(header), 1, file) == 1;
+
+    std::vector<PackedVector::HALF> halves;
+    for (uint32_t face = 0; face < 6 && ok; face++)
+    {
+        for (uint32_t mip = 0; mip < mipCount && ok; mip++)
+        {
+            const std::vector<float>& texels = m_prefiltered[face][mip];
+            halves.resize(texels.size());
+            for (size_t i = 0; i < texels.size(); i++)
+                halves[i] = PackedVector::XMConvertFloatToHalf(texels[i]);
+            ok = fwrite(halves.data(), sizeof(PackedVector::HALF), halves.size(), file) == halves.size();
+        }
+    }
+    fclose(file);
+    return ok;
+}
+
+EnvironmentBenchmarkResult EnvironmentLighting::Benchmark(ThreadPool* pPool, const SoftwareTexture& cube, uint32_t faceSize)
+{
+    EnvironmentBenchmarkResult result = {};
+    result.faceSize = faceSize;
+    result.threads = pPool ? pPool->GetThreadCount() : 1;
+    if (!cube.IsCube() || faceSize < MinPrefilteredSize || (faceSize & (faceSize - 1)) != 0)
+        return result;
+
+    // Source of the requested size resampled from the cube map, not part of the timings
+    EnvironmentLighting environment;
+    environment.SetThreadPool(pPool);
+    environment.m_sourceSize = faceSize;
+    for (uint32_t face = 0; face < 6; face++)
+        environment.m_source[face].assign(1, std::vector<float>(static_cast<size_t>(faceSize) * faceSize * 4));
+    RunParallel(pPool, 6 * faceSize, [&environment, &cube, faceSize](uint32_t task)
+    {
+        uint32_t face = task / faceSize;
+        uint32_t row = task % faceSize;
+        float* pDest = environment.m_source[face][0].data() + static_cast<size_t>(row) * faceSize * 4;
+        float texelScale = 2.0f / faceSize;
+        SwFloat tc((row + 0.5f) * texelScale - 1.0f);
+        for (uint32_t x = 0; x < faceSize; x++)
+        {
+            SwFloat3 direction = FaceDirection(face, SwFloat((x + 0.5f) * texelScale - 1.0f), tc);
+            _mm_storeu_ps(pDest + x * 4, cube.SampleCube(direction.x[0], direction.y[0], direction.z[0]));
+        }
+    });
+
+    uint64_t start = Profiler::NowNs();
+    environment.ProjectSH();
+    uint64_t projected = Profiler::NowNs();
+    environment.BuildSourceMips();
+    uint64_t mipsBuilt = Profiler::NowNs();
+    environment.Prefilter();
+    uint64_t end = Profiler::NowNs();
+
+    result.projectMs = (projected - start) * 1.0e-6;
+    result.mipMs = (mipsBuilt - projected) * 1.0e-6;
+    result.prefilterMs = (end - mipsBuilt) * 1.0e-6;
+    return result;
+}
@@ -0,0 +1,92 @@
+#ifndef ENVIRONMENT_LIGHTING_H
+#define ENVIRONMENT_LIGHTING_H
+
+#include <DirectXMath.h>
+#include <cstdint>
+#include <vector>
+
+using namespace DirectX;
+
+class SoftwareTexture;
+class ThreadPool;
+
+// Layout of the AmbientBuffer constant buffer in EnvironmentLighting.hlsli
+struct AmbientConstants
+{
+    // L2 irradiance, already convolved with the cosine lobe and divided by pi:
+    // sum(sh[i] * Y_i(n)) is the light colour ColorPixel.ps multiplies the albedo with
+    XMFLOAT4 sh[9];
+    float diffuseIntensity;
+    float specularIntensity;
+    float prefilteredMipCount;
+    float roughness;
+};
+
+struct EnvironmentBenchmarkResult
+{
+    uint32_t faceSize;
+    uint32_t threads;
+    double projectMs;       // spherical harmonics projection
+    double mipMs;           // box-filtered source mips used by the prefilter
+    double prefilterMs;     // GGX convolution of every output mip
+};
+
+// Image based lighting from the skybox cube map. The source faces are projected onto L2
+// spherical harmonics for diffuse ambient light, and a GGX-prefiltered cube map is built
+// for glossy reflections: mip m holds roughness m / (mipCount - 1). Both convolutions run
+// on the thread pool one face row per task, four texels per SSE register; the prefilter
+// hands out the rows of all faces and mips in one batch.
+class EnvironmentLighting
+{
+public:
+    static const uint32_t MaxPrefilteredSize = 128;
+    static const uint32_t MinPrefilteredSize = 4;
+    static const uint32_t PrefilterSamples = 64;
+
+    EnvironmentLighting() : m_pPool(nullptr), m_sourceSize(0), m_sh(), m_prefilteredSize(0) {}
+
+    void SetThreadPool(ThreadPool* pPool) { m_pPool = pPool; }
+
+    // Top mip of an RGBA8 cube map; the faces must be square
+    bool SetSource(const SoftwareTexture& cube);
+    // Linear RGBA float faces of faceSize x faceSize in D3D order, e.g. a rendered reflection probe
+    bool SetSource(uint32_t faceSize, const std::vector<float> faces[6]);
+    // Projection, source mips and prefiltering of the current source
+    void Compute();
+
+    // rgb in xyz, w unused
+    const XMFLOAT4* GetIrradianceSH() const { return m_sh; }
+    uint32_t GetPrefilteredSize() const { return m_prefilteredSize; }
+    uint32_t GetPrefilteredMipCount() const { return static_cast<uint32_t>(m_prefiltered[0].size()); }
+    // RGBA float texels of one face of one prefiltered mip, rows tightly packed
+    const std::vector<float>& GetPrefilteredFace(uint32_t face, uint32_t mip) const { return m_prefiltered[face][mip]; }
+
+    // Uncompressed RGBA16F cube map with the prefiltered mips
+    bool SavePrefilteredDDS(const char* path) const;
+
+    // Resamples the cube map to faceSize, then times each step of Compute
+    static EnvironmentBenchmarkResult Benchmark(ThreadPool* pPool, const SoftwareTexture& cube, uint32_t faceSize);
+
+private:
+    void ProjectSH();
+    void BuildSourceMips();
+    void Prefilter();
+    void PrefilterRow(uint32_t mip, uint32_t face, uint32_t row);
+    void SampleSource(const float direction[3], float lod, float out[4]) const;
+
+    ThreadPool* m_pPool;
+
+    // Source faces in D3D order (+X, -X, +Y, -Y, +Z, -Z), each with a box-filtered mip chain
+    uint32_t m_sourceSize;
+    std::vector<std::vector<float>> m_source[6];
+
+    XMFLOAT4 m_sh[9];
+    uint32_t m_prefilteredSize;
+    std::vector<std::vector<float>> m_prefiltered[6];
+
+    // Tangent space light directions of the GGX samples of each mip, lod in w
+    std::vector<std::vector<XMFLOAT4>> m_samples;
+    std::vector<float> m_sampleWeights;
+};
+
+#endif
@@ -0,0 +1,57 @@
+// Image based ambient light computed from the skybox by EnvironmentLighting on the CPU
+
+cbuffer AmbientBuffer : register(b3)
+{
+    float4 ambientSH[9];
+    float ambientDiffuseIntensity;
+    float ambientSpecularIntensity;
+    float prefilteredMipCount;
+    float ambientRoughness;
+};
+
+// Mip m is prefiltered for GGX roughness m / (prefilteredMipCount - 1)
+TextureCube prefilteredEnvironment : register(t6);
+
+// Irradiance / pi around the normal, the same units as the point light colour
+float3 EvaluateSH(float4 sh[9], float3 n)
+{
+    float3 result = sh[0].rgb * 0.282095f;
+    result += sh[1].rgb * (0.488603f * n.y);
+    result += sh[2].rgb * (0.488603f * n.z);
+    result += sh[3].rgb * (0.488603f * n.x);
+    result += sh[4].rgb * (1.092548f * n.x * n.y);
+    result += sh[5].rgb * (1.092548f * n.y * n.z);
+    result += sh[6].rgb * (0.315392f * (3.0f * n.z * n.z - 1.0f));
+    result += sh[7].rgb * (1.092548f * n.x * n.z);
+    result += sh[8].rgb * (0.546274f * (n.x * n.x - n.y * n.y));
+    return max(result, 0.0f);
+}
+
+float3 EvaluateAmbientSH(float3 n)
+{
+    return EvaluateSH(ambientSH, n);
+}
+
+// Skybox radiance around direction, prefiltered for ambientRoughness
+float3 SampleEnvironment(float3 direction, SamplerState linearSampler)
+{
+    float lod = ambientRoughness * max(prefilteredMipCount - 1.0f, 0.0f);
+    return prefilteredEnvironment.SampleLevel(linearSampler, direction, lod).rgb;
+}
+
+// irradiance comes from EvaluateAmbientSH or from a light probe,
+// prefiltered from SampleEnvironment or from a reflection probe
+float3 CombineAmbientLight(float3 irradiance, float3 prefiltered)
+{
+    return irradiance * ambientDiffuseIntensity + prefiltered * ambientSpecularIntensity;
+}
+
+float3 CalculateAmbientLight(float3 irradiance, float3 normal, float3 viewDir, SamplerState linearSampler)
+{
+    return CombineAmbientLight(irradiance, SampleEnvironment(reflect(-viewDir, normal), linearSampler));
+}
+
+float3 CalculateAmbientLight(float3 normal, float3 viewDir, SamplerState linearSampler)
+{
+    return CalculateAmbientLight(EvaluateAmbientSH(normal), normal, viewDir, linearSampler);
+}
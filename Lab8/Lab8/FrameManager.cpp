@@ -0,0 +1,128 @@
+#include "FrameManager.h"
+#include <algorithm>
+#include <thread>
+
+FrameManager::FrameManager()
+    : m_pFence(nullptr),
+    m_framesInFlight(2),
+    m_currentSlot(0),
+    m_frameNumber(0),
+    m_completedFrame(0),
+    m_waitCount(0),
+    m_inFrame(false)
+{
+    for (uint32_t i = 0; i < MaxFramesInFlight; i++)
+    {
+        m_slotFrame[i] = 0;
+        m_slotPending[i] = false;
+    }
+}
+
+void FrameManager::SetFramesInFlight(uint32_t count)
+{
+    if (count < 1) count = 1;
+    if (count > MaxFramesInFlight) count = MaxFramesInFlight;
+    if (count == m_framesInFlight)
+        return;
+
+    // Slot assignment changes with the count, so nothing may be in flight while switching
+    WaitIdle();
+    m_framesInFlight = count;
+}
+
+uint32_t FrameManager::BeginFrame()
+{
+    m_frameNumber++;
+    m_currentSlot = static_cast<uint32_t>(m_frameNumber % m_framesInFlight);
+
+    // Retire whatever already finished without blocking, then block only on our slot
+    for (uint32_t slot = 0; slot < MaxFramesInFlight; slot++)
+    {
+        if (m_slotPending[slot] && m_pFence && m_pFence->IsComplete(slot))
+            RetireSlot(slot);
+    }
+    WaitForSlot(m_currentSlot);
+
+    m_slotFrame[m_currentSlot] = m_frameNumber;
+    m_inFrame = true;
+    return m_currentSlot;
+}
+
+void FrameManager::EndFrame()
+{
+    if (!m_inFrame)
+        return;
+
+    m_inFrame = false;
+    if (m_pFence)
+    {
+        m_pFence->Signal(m_currentSlot);
+        m_slotPending[m_currentSlot] = true;
+    }
+    else
+    {
+        RetireSlot(m_currentSlot);
+    }
+}
+
+void FrameManager::WaitIdle()
+{
+    for (uint32_t slot = 0; slot < MaxFramesInFlight; slot++)
+        WaitForSlot(slot);
+
+    if (!m_inFrame)
+    {
+        for (auto& pending : m_pendingReleases)
+            pending.release();
+        m_pendingReleases.clear();
+    }
+}
+
+void FrameManager::DeferRelease(std::function<void()> release)
+{
+    bool anyPending = m_inFrame;
+    for (uint32_t slot = 0; slot < MaxFramesInFlight; slot++)
+        anyPending = anyPending || m_slotPending[slot];
+
+    if (!anyPending)
+    {
+        release();
+        return;
+    }
+
+    PendingRelease pending;
+    pending.frame = m_frameNumber;
+    pending.release = release;
+    m_pendingReleases.push_back(pending);
+}
+
+void FrameManager::WaitForSlot(uint32_t slot)
+{
+    if (!m_slotPending[slot])
+        return;
+
+    if (m_pFence && !m_pFence->IsComplete(slot))
+    {
+        m_waitCount++;
+        while (!m_pFence->IsComplete(slot))
+            std::this_thread::yield();
+    }
+    RetireSlot(slot);
+}
+
+void FrameManager::RetireSlot(uint32_t slot)
+{
+    m_slotPending[slot] = false;
+    m_completedFrame = std::max(m_completedFrame, m_slotFrame[slot]);
+
+    // Frames finish in submission order, so every release up to the completed frame is safe
+    size_t kept = 0;
+    for (size_t i = 0; i < m_pendingReleases.size(); i++)
+    {
+        if (m_pendingReleases[i].frame <= m_completedFrame)
+            m_pendingReleases[i].release();
+        else
+            m_pendingReleases[kept++] = m_pendingReleases[i];
+    }
+    m_pendingReleases.resize(kept);
+}
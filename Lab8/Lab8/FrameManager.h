@@ -0,0 +1,99 @@
+#ifndef FRAME_MANAGER_H
+#define FRAME_MANAGER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// GPU completion signal for one frame slot. D3D11 uses an event query per slot,
+// a simulated timeline can implement it without any device.
+class FrameFence
+{
+public:
+    virtual ~FrameFence() {}
+
+    // Marks the end of the commands submitted for the frame that uses this slot
+    virtual void Signal(uint32_t slot) = 0;
+    // True once the GPU has finished everything submitted before the last Signal(slot)
+    virtual bool IsComplete(uint32_t slot) = 0;
+};
+
+// Keeps up to N frames in flight: the CPU records frame N+1 while the GPU still
+// works on frame N, and only blocks when it is about to reuse a slot whose frame
+// has not finished yet. Resources released while in flight are kept alive until
+// the GPU is done with the frame that last used them.
+class FrameManager
+{
+public:
+    static const uint32_t MaxFramesInFlight = 3;
+
+    FrameManager();
+
+    void SetFence(FrameFence* pFence) { m_pFence = pFence; }
+
+    // Clamped to [1, MaxFramesInFlight]; waits for the GPU before switching
+    void SetFramesInFlight(uint32_t count);
+    uint32_t GetFramesInFlight() const { return m_framesInFlight; }
+
+    // Returns the slot for the new frame, waiting for the frame that used it before
+    uint32_t BeginFrame();
+    // Signals the fence for the current slot once all commands are submitted
+    void EndFrame();
+    // Waits for every frame in flight and runs all pending releases
+    void WaitIdle();
+
+    // Runs release once the current frame (and all earlier ones) has finished on the GPU
+    void DeferRelease(std::function<void()> release);
+
+    uint32_t GetCurrentSlot() const { return m_currentSlot; }
+    uint64_t GetFrameNumber() const { return m_frameNumber; }
+    // Frame number that last used the slot, 0 if the slot was never used
+    uint64_t GetSlotFrame(uint32_t slot) const { return m_slotFrame[slot]; }
+    // True if the slot holds a frame that was submitted and has already completed
+    bool IsSlotRetired(uint32_t slot) const { return m_slotFrame[slot] != 0 && !m_slotPending[slot]; }
+
+    uint64_t GetWaitCount() const { return m_waitCount; }
+    size_t GetPendingReleaseCount() const { return m_pendingReleases.size(); }
+
+private:
+    struct PendingRelease
+    {
+        uint64_t frame;
+        std::function<void()> release;
+    };
+
+    void WaitForSlot(uint32_t slot);
+    void RetireSlot(uint32_t slot);
+
+    FrameFence* m_pFence;
+    uint32_t m_framesInFlight;
+    uint32_t m_currentSlot;
+    uint64_t m_frameNumber;
+    uint64_t m_completedFrame;
+    uint64_t m_waitCount;
+    bool m_inFrame;
+
+    uint64_t m_slotFrame[MaxFramesInFlight];
+    bool m_slotPending[MaxFramesInFlight];
+    std::vector<PendingRelease> m_pendingReleases;
+};
+
+// One copy of a resource per frame slot, e.g. staging buffers for readbacks
+template <typename T>
+class PerFrame
+{
+public:
+    T& operator[](uint32_t slot) { return m_items[slot]; }
+    const T& operator[](uint32_t slot) const { return m_items[slot]; }
+
+    T& Current(const FrameManager& frames) { return m_items[frames.GetCurrentSlot()]; }
+
+    T* begin() { return m_items; }
+    T* end() { return m_items + FrameManager::MaxFramesInFlight; }
+
+private:
+    T m_items[FrameManager::MaxFramesInFlight] = {};
+};
+
+#endif
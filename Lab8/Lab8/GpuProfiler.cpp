@@ -0,0 +1,214 @@
+#include "GpuProfiler.h"
+#include "Profiler.h"
+
+namespace
+{
+    void ReleaseQuery(ID3D11Query*& pQuery)
+    {
+        if (pQuery) pQuery->Release();
+        pQuery = nullptr;
+    }
+}
+
+GpuProfiler::GpuProfiler()
+    : m_pContext(nullptr),
+    m_current(0),
+    m_inFrame(false),
+    m_depth(0),
+    m_lastFrameMs(0.0)
+{
+    for (UINT i = 0; i < FrameLatency; i++)
+    {
+        Frame& frame = m_frames[i];
+        frame.pDisjoint = nullptr;
+        frame.pFrameBegin = nullptr;
+        frame.pFrameEnd = nullptr;
+        frame.scopeCount = 0;
+        frame.cpuBeginNs = 0;
+        frame.pending = false;
+        for (UINT j = 0; j < MaxScopes; j++)
+        {
+            frame.scopes[j].name = nullptr;
+            frame.scopes[j].pBegin = nullptr;
+            frame.scopes[j].pEnd = nullptr;
+            frame.scopes[j].depth = 0;
+        }
+    }
+}
+
+HRESULT GpuProfiler::Init(ID3D11Device* pDevice, ID3D11DeviceContext* pContext)
+{
+    m_pContext = pContext;
+
+    D3D11_QUERY_DESC disjointDesc = { D3D11_QUERY_TIMESTAMP_DISJOINT, 0 };
+    D3D11_QUERY_DESC timestampDesc = { D3D11_QUERY_TIMESTAMP, 0 };
+
+    for (UINT i = 0; i < FrameLatency; i++)
+    {
+        Frame& frame = m_frames[i];
+        HRESULT hr = pDevice->CreateQuery(&disjointDesc, &frame.pDisjoint);
+        if (FAILED(hr))
+            return hr;
+        hr = pDevice->CreateQuery(&timestampDesc, &frame.pFrameBegin);
+        if (FAILED(hr))
+            return hr;
+        hr = pDevice->CreateQuery(&timestampDesc, &frame.pFrameEnd);
+        if (FAILED(hr))
+            return hr;
+
+        for (UINT j = 0; j < MaxScopes; j++)
+        {
+            hr = pDevice->CreateQuery(&timestampDesc, &frame.scopes[j].pBegin);
+            if (FAILED(hr))
+                return hr;
+            hr = pDevice->CreateQuery(&timestampDesc, &frame.scopes[j].pEnd);
+            if (FAILED(hr))
+                return hr;
+        }
+    }
+
+    return S_OK;
+}
+
+void GpuProfiler::Terminate()
+{
+    for (UINT i = 0; i < FrameLatency; i++)
+    {
+        Frame& frame = m_frames[i];
+        ReleaseQuery(frame.pDisjoint);
+        ReleaseQuery(frame.pFrameBegin);
+        ReleaseQuery(frame.pFrameEnd);
+        for (UINT j = 0; j < MaxScopes; j++)
+        {
+            ReleaseQuery(frame.scopes[j].pBegin);
+            ReleaseQuery(frame.scopes[j].pEnd);
+        }
+        frame.pending = false;
+    }
+    m_pContext = nullptr;
+}
+
+void GpuProfiler::BeginFrame()
+{
+    if (!m_pContext || !m_frames[0].pDisjoint || !Profiler::Get().IsEnabled())
+        return;
+
+    m_current = (m_current + 1) % FrameLatency;
+    Frame& frame = m_frames[m_current];
+
+    // The slot is reused FrameLatency frames later; by then its results are normally
+    // ready. If they are not, the old frame is dropped instead of stalling the CPU.
+    if (frame.pending)
+        Resolve(frame);
+    frame.pending = false;
+
+    frame.scopeCount = 0;
+    frame.cpuBeginNs = Profiler::NowNs();
+    m_depth = 0;
+
+    m_pContext->Begin(frame.pDisjoint);
+    m_pContext->End(frame.pFrameBegin);
+    m_inFrame = true;
+}
+
+void GpuProfiler::EndFrame()
+{
+    if (!m_inFrame)
+        return;
+
+    Frame& frame = m_frames[m_current];
+    m_pContext->End(frame.pFrameEnd);
+    m_pContext->End(frame.pDisjoint);
+    frame.pending = true;
+    m_inFrame = false;
+
+    // Try the other slots too, so timings show up as soon as the GPU has finished them
+    for (UINT i = 1; i < FrameLatency; i++)
+    {
+        Frame& older = m_frames[(m_current + i) % FrameLatency];
+        if (older.pending && m_pContext->GetData(older.pDisjoint, nullptr, 0, D3D11_ASYNC_GETDATA_DONOTFLUSH) == S_OK)
+        {
+            Resolve(older);
+            older.pending = false;
+        }
+    }
+}
+
+void GpuProfiler::BeginScope(const char* name)
+{
+    if (!m_inFrame)
+        return;
+
+    Frame& frame = m_frames[m_current];
+    if (frame.scopeCount >= MaxScopes || m_depth >= MaxScopes)
+    {
+        // Still track nesting so the matching EndScope is ignored as well
+        m_openScopes[m_depth < MaxScopes ? m_depth : MaxScopes - 1] = MaxScopes;
+        m_depth++;
+        return;
+    }
+
+    UINT index = frame.scopeCount++;
+    Scope& scope = frame.scopes[index];
+    scope.name = name;
+    scope.depth = m_depth;
+    m_pContext->End(scope.pBegin);
+
+    m_openScopes[m_depth++] = index;
+}
+
+void GpuProfiler::EndScope()
+{
+    if (!m_inFrame || m_depth == 0)
+        return;
+
+    m_depth--;
+    UINT index = m_depth < MaxScopes ? m_openScopes[m_depth] : MaxScopes;
+    if (index >= MaxScopes)
+        return;
+
+    m_pContext->End(m_frames[m_current].scopes[index].pEnd);
+}
+
+void GpuProfiler::Resolve(Frame& frame)
+{
+    D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint;
+    if (m_pContext->GetData(frame.pDisjoint, &disjoint, sizeof(disjoint), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+        return;
+    if (disjoint.Disjoint || disjoint.Frequency == 0)
+        return;
+
+    UINT64 frameBegin = 0;
+    UINT64 frameEnd = 0;
+    if (m_pContext->GetData(frame.pFrameBegin, &frameBegin, sizeof(frameBegin), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+        return;
+    if (m_pContext->GetData(frame.pFrameEnd, &frameEnd, sizeof(frameEnd), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+        return;
+
+    const double toNs = 1.0e9 / static_cast<double>(disjoint.Frequency);
+    m_lastFrameMs = (frameEnd - frameBegin) * toNs * 1.0e-6;
+    m_lastTimings.clear();
+
+    for (UINT i = 0; i < frame.scopeCount; i++)
+    {
+        const Scope& scope = frame.scopes[i];
+        UINT64 begin = 0;
+        UINT64 end = 0;
+        if (m_pContext->GetData(scope.pBegin, &begin, sizeof(begin), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK ||
+            m_pContext->GetData(scope.pEnd, &end, sizeof(end), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK ||
+            end < begin || begin < frameBegin)
+            continue;
+
+        Timing timing;
+        timing.name = scope.name;
+        timing.ms = (end - begin) * toNs * 1.0e-6;
+        timing.depth = scope.depth;
+        m_lastTimings.push_back(timing);
+
+        // GPU clock has no relation to the CPU clock; anchor the frame start to the
+        // CPU time at which it was recorded so both tracks line up in the trace
+        uint64_t startNs = frame.cpuBeginNs + static_cast<uint64_t>((begin - frameBegin) * toNs);
+        uint64_t endNs = frame.cpuBeginNs + static_cast<uint64_t>((end - frameBegin) * toNs);
+        Profiler::Get().AddGpuEvent(scope.name, startNs, endNs, scope.depth);
+    }
+}
@@ -0,0 +1,87 @@
+#ifndef GPU_PROFILER_H
+#define GPU_PROFILER_H
+
+#include <d3d11.h>
+#include <cstdint>
+#include <vector>
+
+// Timestamp-query scopes per render pass. Results are read back a few frames later
+// without stalling and forwarded to Profiler as events of the GPU track.
+class GpuProfiler
+{
+public:
+    static const UINT FrameLatency = 4;
+    static const UINT MaxScopes = 16;
+
+    struct Timing
+    {
+        const char* name;
+        double ms;
+        uint32_t depth;
+    };
+
+    GpuProfiler();
+
+    HRESULT Init(ID3D11Device* pDevice, ID3D11DeviceContext* pContext);
+    void Terminate();
+
+    void BeginFrame();
+    void EndFrame();
+
+    void BeginScope(const char* name);
+    void EndScope();
+
+    const std::vector<Timing>& GetLastTimings() const { return m_lastTimings; }
+    double GetLastFrameMs() const { return m_lastFrameMs; }
+
+private:
+    struct Scope
+    {
+        const char* name;
+        ID3D11Query* pBegin;
+        ID3D11Query* pEnd;
+        uint32_t depth;
+    };
+
+    struct Frame
+    {
+        ID3D11Query* pDisjoint;
+        ID3D11Query* pFrameBegin;
+        ID3D11Query* pFrameEnd;
+        Scope scopes[MaxScopes];
+        UINT scopeCount;
+        uint64_t cpuBeginNs;
+        bool pending;
+    };
+
+    void Resolve(Frame& frame);
+
+    ID3D11DeviceContext* m_pContext;
+    Frame m_frames[FrameLatency];
+    UINT m_current;
+    bool m_inFrame;
+    UINT m_openScopes[MaxScopes];
+    uint32_t m_depth;
+
+    std::vector<Timing> m_lastTimings;
+    double m_lastFrameMs;
+};
+
+class GpuProfileScope
+{
+public:
+    GpuProfileScope(GpuProfiler& profiler, const char* name) : m_profiler(profiler)
+    {
+        m_profiler.BeginScope(name);
+    }
+
+    ~GpuProfileScope()
+    {
+        m_profiler.EndScope();
+    }
+
+private:
+    GpuProfiler& m_profiler;
+};
+
+#endif
@@ -0,0 +1,165 @@
+#include "ImGuiRenderer.h"
+#include <cstring>
+
+namespace
+{
+    // Same headroom as imgui_impl_dx11, so a typical UI never reallocates
+    const uint32_t InitialVertexCapacity = 5000;
+    const uint32_t InitialIndexCapacity = 10000;
+    const uint32_t GrowStep = 5000;
+}
+
+ImGuiRenderer::ImGuiRenderer()
+    : m_pipeline(InvalidBackendHandle),
+    m_vertexBuffer(InvalidBackendHandle),
+    m_indexBuffer(InvalidBackendHandle),
+    m_constantBuffer(InvalidBackendHandle),
+    m_vertexCapacity(0),
+    m_indexCapacity(0),
+    m_growCount(0)
+{
+}
+
+bool ImGuiRenderer::Init(RenderBackend& backend, BackendHandle pipeline)
+{
+    m_pipeline = pipeline;
+    BufferDesc constantDesc = { BufferKind::Constant, sizeof(float) * 16, true, 0 };
+    m_constantBuffer = backend.CreateBuffer(constantDesc, nullptr);
+    if (m_constantBuffer == InvalidBackendHandle)
+        return false;
+
+    m_growCount = 0;
+    return Reserve(backend, InitialVertexCapacity, InitialIndexCapacity);
+}
+
+void ImGuiRenderer::Terminate(RenderBackend& backend)
+{
+    BackendHandle* handles[] = { &m_vertexBuffer, &m_indexBuffer, &m_constantBuffer };
+    for (BackendHandle* pHandle : handles)
+    {
+        if (*pHandle != InvalidBackendHandle)
+            backend.ReleaseBuffer(*pHandle);
+        *pHandle = InvalidBackendHandle;
+    }
+    m_vertexCapacity = 0;
+    m_indexCapacity = 0;
+}
+
+bool ImGuiRenderer::Reserve(RenderBackend& backend, uint32_t vertexCount, uint32_t indexCount)
+{
+    if (vertexCount > m_vertexCapacity)
+    {
+        if (m_vertexBuffer != InvalidBackendHandle)
+        {
+            backend.ReleaseBuffer(m_vertexBuffer);
+            m_growCount++;
+        }
+        m_vertexCapacity = vertexCount + GrowStep;
+        BufferDesc desc = { BufferKind::Vertex, static_cast<uint32_t>(sizeof(ImDrawVert)) * m_vertexCapacity, true, 0 };
+        m_vertexBuffer = backend.CreateBuffer(desc, nullptr);
+    }
+
+    if (indexCount > m_indexCapacity)
+    {
+        if (m_indexBuffer != InvalidBackendHandle)
+        {
+            backend.ReleaseBuffer(m_indexBuffer);
+            m_growCount++;
+        }
+        m_indexCapacity = indexCount + 2 * GrowStep;
+        BufferDesc desc = { BufferKind::Index, static_cast<uint32_t>(sizeof(ImDrawIdx)) * m_indexCapacity, true, 0 };
+        m_indexBuffer = backend.CreateBuffer(desc, nullptr);
+    }
+
+    return m_vertexBuffer != InvalidBackendHandle && m_indexBuffer != InvalidBackendHandle;
+}
+
+void ImGuiRenderer::SetupRenderState(RenderBackend& backend, const ImDrawData* pDrawData)
+{
+    backend.SetViewport(0.0f, 0.0f, pDrawData->DisplaySize.x, pDrawData->DisplaySize.y);
+
+    // Visible ImGui space runs from DisplayPos (top left) to DisplayPos + DisplaySize
+    float L = pDrawData->DisplayPos.x;
+    float R = pDrawData->DisplayPos.x + pDrawData->DisplaySize.x;
+    float T = pDrawData->DisplayPos.y;
+    float B = pDrawData->DisplayPos.y + pDrawData->DisplaySize.y;
+    float mvp[4][4] =
+    {
+        { 2.0f / (R - L),    0.0f,              0.0f, 0.0f },
+        { 0.0f,              2.0f / (T - B),    0.0f, 0.0f },
+        { 0.0f,              0.0f,              0.5f, 0.0f },
+        { (R + L) / (L - R), (T + B) / (B - T), 0.5f, 1.0f },
+    };
+    backend.UpdateBuffer(m_constantBuffer, mvp, sizeof(mvp));
+
+    backend.BindPipeline(m_pipeline);
+    backend.BindVertexBuffer(m_vertexBuffer, sizeof(ImDrawVert));
+    backend.BindIndexBuffer(m_indexBuffer);
+    backend.BindConstantBuffer(ShaderStage::Vertex, 0, m_constantBuffer);
+}
+
+void ImGuiRenderer::Render(RenderBackend& backend, ImDrawData* pDrawData)
+{
+    // Minimized window
+    if (pDrawData->DisplaySize.x <= 0.0f || pDrawData->DisplaySize.y <= 0.0f || pDrawData->TotalVtxCount == 0)
+        return;
+
+    uint32_t vertexCount = static_cast<uint32_t>(pDrawData->TotalVtxCount);
+    uint32_t indexCount = static_cast<uint32_t>(pDrawData->TotalIdxCount);
+    if (!Reserve(backend, vertexCount, indexCount))
+        return;
+
+    // All lists go into one vertex and one index buffer, draws keep their own offsets
+    m_vertices.resize(vertexCount);
+    m_indices.resize(indexCount);
+    ImDrawVert* pVertex = m_vertices.data();
+    ImDrawIdx* pIndex = m_indices.data();
+    for (int n = 0; n < pDrawData->CmdListsCount; n++)
+    {
+        const ImDrawList* pList = pDrawData->CmdLists[n];
+        memcpy(pVertex, pList->VtxBuffer.Data, pList->VtxBuffer.Size * sizeof(ImDrawVert));
+        memcpy(pIndex, pList->IdxBuffer.Data, pList->IdxBuffer.Size * sizeof(ImDrawIdx));
+        pVertex += pList->VtxBuffer.Size;
+        pIndex += pList->IdxBuffer.Size;
+    }
+    backend.UpdateBuffer(m_vertexBuffer, m_vertices.data(), static_cast<uint32_t>(sizeof(ImDrawVert)) * vertexCount);
+    backend.UpdateBuffer(m_indexBuffer, m_indices.data(), static_cast<uint32_t>(sizeof(ImDrawIdx)) * indexCount);
+
+    SetupRenderState(backend, pDrawData);
+
+    uint32_t globalIndexOffset = 0;
+    int32_t globalVertexOffset = 0;
+    ImVec2 clipOffset = pDrawData->DisplayPos;
+    for (int n = 0; n < pDrawData->CmdListsCount; n++)
+    {
+        const ImDrawList* pList = pDrawData->CmdLists[n];
+        for (int i = 0; i < pList->CmdBuffer.Size; i++)
+        {
+            const ImDrawCmd* pCommand = &pList->CmdBuffer[i];
+            if (pCommand->UserCallback != nullptr)
+            {
+                if (pCommand->UserCallback == ImDrawCallback_ResetRenderState)
+                    SetupRenderState(backend, pDrawData);
+                else
+                    pCommand->UserCallback(pList, pCommand);
+                continue;
+            }
+
+            // Clip rectangle in framebuffer space
+            ImVec2 clipMin(pCommand->ClipRect.x - clipOffset.x, pCommand->ClipRect.y - clipOffset.y);
+            ImVec2 clipMax(pCommand->ClipRect.z - clipOffset.x, pCommand->ClipRect.w - clipOffset.y);
+            if (clipMax.x <= clipMin.x || clipMax.y <= clipMin.y)
+                continue;
+
+            backend.SetScissor(static_cast<int32_t>(clipMin.x), static_cast<int32_t>(clipMin.y),
+                static_cast<int32_t>(clipMax.x), static_cast<int32_t>(clipMax.y));
+            backend.BindTexture(ShaderStage::Pixel, 0, static_cast<BackendHandle>(pCommand->GetTexID()));
+            backend.DrawIndexed(pCommand->ElemCount, pCommand->IdxOffset + globalIndexOffset,
+                static_cast<int32_t>(pCommand->VtxOffset) + globalVertexOffset);
+        }
+        globalIndexOffset += static_cast<uint32_t>(pList->IdxBuffer.Size);
+        globalVertexOffset += pList->VtxBuffer.Size;
+    }
+
+    backend.BindTexture(ShaderStage::Pixel, 0, InvalidBackendHandle);
+}
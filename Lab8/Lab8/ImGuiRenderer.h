@@ -0,0 +1,41 @@
+#ifndef IMGUI_RENDERER_H
+#define IMGUI_RENDERER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "imgui.h"
+#include "RenderBackend.h"
+
+// Draws ImGui draw data through a RenderBackend. Texture ids are backend texture handles:
+// the font atlas is registered with the backend and its handle passed to SetTexID.
+// Vertex and index buffers grow with the UI and are reused across frames.
+class ImGuiRenderer
+{
+public:
+    ImGuiRenderer();
+
+    // pipeline: ImGuiVertex.vs/ImGuiPixel.ps, alpha blending, scissor test, no depth
+    bool Init(RenderBackend& backend, BackendHandle pipeline);
+    void Terminate(RenderBackend& backend);
+
+    void Render(RenderBackend& backend, ImDrawData* pDrawData);
+
+    uint32_t GetBufferGrowCount() const { return m_growCount; }
+
+private:
+    bool Reserve(RenderBackend& backend, uint32_t vertexCount, uint32_t indexCount);
+    void SetupRenderState(RenderBackend& backend, const ImDrawData* pDrawData);
+
+    BackendHandle m_pipeline;
+    BackendHandle m_vertexBuffer;
+    BackendHandle m_indexBuffer;
+    BackendHandle m_constantBuffer;
+    uint32_t m_vertexCapacity;
+    uint32_t m_indexCapacity;
+    uint32_t m_growCount;
+    std::vector<ImDrawVert> m_vertices;
+    std::vector<ImDrawIdx> m_indices;
+};
+
+#endif
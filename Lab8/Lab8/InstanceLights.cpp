@@ -0,0 +1,218 @@
+#include "InstanceLights.h"
+#include "Profiler.h"
+#include "SoftwareRasterizer.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    const uint32_t InstancesPerTask = 256;
+}
+
+// std::min binds the constant by reference, it needs storage
+const uint32_t InstanceLightLists::MaxLightsPerInstance;
+
+void InstanceLightLists::LoadLights(const void* pLights, uint32_t stride, uint32_t lightCount)
+{
+    // Padding lanes get a negative squared radius, no distance is below it
+    m_lightCount = lightCount;
+    uint32_t padded = (lightCount + 3) & ~3u;
+    m_x.assign(padded, 0.0f);
+    m_y.assign(padded, 0.0f);
+    m_z.assign(padded, 0.0f);
+    m_radius.assign(padded, 1.0f);
+    m_radiusSquared.assign(padded, -1.0f);
+    const unsigned char* pSource = static_cast<const unsigned char*>(pLights);
+    for (uint32_t i = 0; i < lightCount; i++)
+    {
+        const float* pLight = reinterpret_cast<const float*>(pSource + static_cast<size_t>(i) * stride);
+        m_x[i] = pLight[0];
+        m_y[i] = pLight[1];
+        m_z[i] = pLight[2];
+        m_radius[i] = pLight[3];
+        m_radiusSquared[i] = pLight[3] * pLight[3];
+    }
+}
+
+void InstanceLightLists::Build(const void* pLights, uint32_t stride, uint32_t lightCount, const InstanceBounds* pBounds, uint32_t instanceCount)
+{
+    PROFILE_SCOPE("Instance Lights");
+
+    uint64_t start = Profiler::NowNs();
+    LoadLights(pLights, stride, lightCount);
+    m_lists.resize(static_cast<size_t>(instanceCount) * ListStride);
+    uint32_t threads = m_pPool ? m_pPool->GetThreadCount() : 1;
+    if (m_scratch.size() < threads)
+        m_scratch.resize(threads);
+    for (Scratch& scratch : m_scratch)
+        scratch.overflowed = 0;
+
+    uint32_t tasks = (instanceCount + InstancesPerTask - 1) / InstancesPerTask;
+    if (m_pPool && tasks > 1)
+    {
+        m_pPool->ParallelFor(tasks, [this, pBounds, instanceCount](uint32_t task, uint32_t threadIndex)
+        {
+            uint32_t first = task * InstancesPerTask;
+            BuildRange(pBounds, first, std::min(InstancesPerTask, instanceCount - first), threadIndex, true);
+        });
+    }
+    else
+        BuildRange(pBounds, 0, instanceCount, 0, true);
+
+    m_stats = {};
+    m_stats.instanceCount = instanceCount;
+    m_stats.lightCount = lightCount;
+    for (uint32_t i = 0; i < instanceCount; i++)
+    {
+        uint32_t count = m_lists[static_cast<size_t>(i) * ListStride];
+        m_stats.references += count;
+        m_stats.maxLightsPerInstance = std::max(m_stats.maxLightsPerInstance, count);
+    }
+    for (const Scratch& scratch : m_scratch)
+        m_stats.overflowedInstances += scratch.overflowed;
+    m_stats.buildMs = (Profiler::NowNs() - start) * 1.0e-6;
+}
+
+void InstanceLightLists::BuildRange(const InstanceBounds* pBounds, uint32_t first, uint32_t count, uint32_t threadIndex, bool simd)
+{
+    Scratch& scratch = m_scratch[threadIndex];
+    scratch.lights.resize(m_x.size());
+    scratch.scores.resize(m_x.size());
+    for (uint32_t i = first; i < first + count; i++)
+    {
+        uint32_t found = simd ? GatherSimd(pBounds[i], scratch) : GatherScalar(pBounds[i], scratch);
+        WriteList(i, found, scratch);
+    }
+}
+
+uint32_t InstanceLightLists::GatherSimd(const InstanceBounds& bounds, Scratch& scratch) const
+{
+    const SwFloat centerX(bounds.center.x);
+    const SwFloat centerY(bounds.center.y);
+    const SwFloat centerZ(bounds.center.z);
+    const SwFloat extentX(bounds.extents.x);
+    const SwFloat extentY(bounds.extents.y);
+    const SwFloat extentZ(bounds.extents.z);
+    const SwFloat zero(0.0f);
+
+    uint32_t found = 0;
+    for (uint32_t i = 0; i < m_x.size(); i += 4)
+    {
+        // Squared distance from the light to the nearest point of the box
+        SwFloat dx = Max(Abs(SwFloat(_mm_load_ps(&m_x[i])) - centerX) - extentX, zero);
+        SwFloat dy = Max(Abs(SwFloat(_mm_load_ps(&m_y[i])) - centerY) - extentY, zero);
+        SwFloat dz = Max(Abs(SwFloat(_mm_load_ps(&m_z[i])) - centerZ) - extentZ, zero);
+        SwFloat distanceSquared = dx * dx + dy * dy + dz * dz;
+        int mask = _mm_movemask_ps(_mm_cmple_ps(distanceSquared.v, _mm_load_ps(&m_radiusSquared[i])));
+        if (mask == 0)
+            continue;
+
+        // Attenuation of ColorPixel.ps at that point ranks the lights when a list overflows
+        alignas(16) float score[4];
+        _mm_store_ps(score, (SwFloat(1.0f) - Sqrt(distanceSquared) / SwFloat(_mm_load_ps(&m_radius[i]))).v);
+        while (mask)
+        {
+            int lane = 0;
+            while (!(mask & (1 << lane)))
+                lane++;
+            mask &= mask - 1;
+            scratch.lights[found] = i + lane;
+            scratch.scores[found] = score[lane];
+            found++;
+        }
+    }
+    return found;
+}
+
+uint32_t InstanceLightLists::GatherScalar(const InstanceBounds& bounds, Scratch& scratch) const
+{
+    uint32_t found = 0;
+    for (uint32_t i = 0; i < m_lightCount; i++)
+    {
+        float dx = std::max(fabsf(m_x[i] - bounds.center.x) - bounds.extents.x, 0.0f);
+        float dy = std::max(fabsf(m_y[i] - bounds.center.y) - bounds.extents.y, 0.0f);
+        float dz = std::max(fabsf(m_z[i] - bounds.center.z) - bounds.extents.z, 0.0f);
+        float distanceSquared = dx * dx + dy * dy + dz * dz;
+        if (distanceSquared > m_radiusSquared[i])
+            continue;
+        scratch.lights[found] = i;
+        scratch.scores[found] = 1.0f - sqrtf(distanceSquared) / m_radius[i];
+        found++;
+    }
+    return found;
+}
+
+void InstanceLightLists::WriteList(uint32_t instance, uint32_t found, Scratch& scratch)
+{
+    uint32_t* pList = &m_lists[static_cast<size_t>(instance) * ListStride];
+    uint32_t count = std::min(found, MaxLightsPerInstance);
+    if (found > MaxLightsPerInstance)
+    {
+        // Heap of the strongest lights so far with the weakest on top
+        uint32_t order[MaxLightsPerInstance];
+        for (uint32_t i = 0; i < MaxLightsPerInstance; i++)
+            order[i] = i;
+        auto weaker = [&scratch](uint32_t a, uint32_t b) { return scratch.scores[a] > scratch.scores[b]; };
+        std::make_heap(order, order + MaxLightsPerInstance, weaker);
+        for (uint32_t i = MaxLightsPerInstance; i < found; i++)
+        {
+            if (scratch.scores[i] <= scratch.scores[order[0]])
+                continue;
+            std::pop_heap(order, order + MaxLightsPerInstance, weaker);
+            order[MaxLightsPerInstance - 1] = i;
+            std::push_heap(order, order + MaxLightsPerInstance, weaker);
+        }
+        for (uint32_t i = 0; i < MaxLightsPerInstance; i++)
+            pList[1 + i] = scratch.lights[order[i]];
+        scratch.overflowed++;
+    }
+    else
+        memcpy(pList + 1, scratch.lights.data(), sizeof(uint32_t) * count);
+    pList[0] = count;
+}
+
+InstanceLightBenchmarkResult InstanceLightLists::Benchmark(ThreadPool* pPool, uint32_t lightCount, uint32_t instanceCount)
+{
+    // position, range
+    std::vector<XMFLOAT4> lights(lightCount);
+    std::vector<InstanceBounds> bounds(instanceCount);
+    uint32_t seed = 12345;
+    auto next = [&seed]()
+    {
+        seed = seed * 1664525u + 1013904223u;
+        return (seed >> 8) * (1.0f / 16777216.0f);
+    };
+    for (auto& light : lights)
+        light = XMFLOAT4(next() * 60.0f - 30.0f, next() * 20.0f - 10.0f, next() * 60.0f - 30.0f, 0.5f + next() * 2.5f);
+    for (auto& instance : bounds)
+    {
+        instance.center = XMFLOAT3(next() * 60.0f - 30.0f, next() * 20.0f - 10.0f, next() * 60.0f - 30.0f);
+        float extent = 0.25f + next() * 0.75f;
+        instance.extents = XMFLOAT3(extent, extent, extent);
+    }
+
+    InstanceLightLists lists;
+    lists.SetThreadPool(pPool);
+    lists.LoadLights(lights.data(), sizeof(XMFLOAT4), lightCount);
+    lists.m_lists.resize(static_cast<size_t>(instanceCount) * ListStride);
+    lists.m_scratch.resize(pPool ? pPool->GetThreadCount() : 1, Scratch{ {}, {}, 0 });
+
+    uint64_t start = Profiler::NowNs();
+    lists.BuildRange(bounds.data(), 0, instanceCount, 0, false);
+    uint64_t scalarDone = Profiler::NowNs();
+    lists.BuildRange(bounds.data(), 0, instanceCount, 0, true);
+    uint64_t simdDone = Profiler::NowNs();
+    lists.Build(lights.data(), sizeof(XMFLOAT4), lightCount, bounds.data(), instanceCount);
+
+    InstanceLightBenchmarkResult result = {};
+    result.lightCount = lightCount;
+    result.instanceCount = instanceCount;
+    result.threads = pPool ? pPool->GetThreadCount() : 1;
+    result.scalarMs = (scalarDone - start) * 1.0e-6;
+    result.simdMs = (simdDone - scalarDone) * 1.0e-6;
+    result.parallelMs = lists.GetStats().buildMs;
+    result.lightsPerInstance = instanceCount > 0 ? static_cast<double>(lists.GetStats().references) / instanceCount : 0.0;
+    return result;
+}
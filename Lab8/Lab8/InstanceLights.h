@@ -0,0 +1,104 @@
+#ifndef INSTANCE_LIGHTS_H
+#define INSTANCE_LIGHTS_H
+
+#include <DirectXMath.h>
+#include <cstdint>
+#include <vector>
+
+using namespace DirectX;
+
+class ThreadPool;
+
+// World space axis-aligned box of one instance
+struct InstanceBounds
+{
+    XMFLOAT3 center;
+    XMFLOAT3 extents;
+};
+
+// Layout of the InstanceLightBuffer constant buffer in InstanceLights.hlsli
+struct InstanceLightConstants
+{
+    uint32_t enabled;
+    uint32_t stride;
+    uint32_t padding[2];
+};
+
+struct InstanceLightStats
+{
+    uint32_t instanceCount;
+    uint32_t lightCount;
+    uint32_t references;        // indices written over all lists
+    uint32_t maxLightsPerInstance;
+    uint32_t overflowedInstances;   // touched by more than MaxLightsPerInstance lights
+    double buildMs;
+};
+
+struct InstanceLightBenchmarkResult
+{
+    uint32_t lightCount;
+    uint32_t instanceCount;
+    uint32_t threads;
+    double scalarMs;        // one light at a time
+    double simdMs;          // four lights per SSE register
+    double parallelMs;      // SIMD with instance chunks on the thread pool
+    double lightsPerInstance;
+};
+
+// Forward shading light lists per instance, a coarser alternative to LightClusterGrid:
+// every instance of the visible list gets the lights whose range sphere touches its box.
+// The sphere/box test runs on four lights at once in SoA form. When more than
+// MaxLightsPerInstance lights touch a box, the ones with the highest attenuation at its
+// nearest point are kept. Lists have a fixed stride, the count first and the light
+// indices after it, so instances fill their own slots in parallel and the shader finds
+// a list at instance * ListStride.
+class InstanceLightLists
+{
+public:
+    static const uint32_t MaxLightsPerInstance = 16;
+    static const uint32_t ListStride = MaxLightsPerInstance + 1;
+
+    InstanceLightLists() : m_pPool(nullptr), m_lightCount(0), m_stats() {}
+
+    void SetThreadPool(ThreadPool* pPool) { m_pPool = pPool; }
+
+    // Lights as for LightClusterGrid::Build: position (float3) and range (float), stride bytes apart
+    void Build(const void* pLights, uint32_t stride, uint32_t lightCount, const InstanceBounds* pBounds, uint32_t instanceCount);
+
+    // ListStride values per instance of the last Build
+    const std::vector<uint32_t>& GetLists() const { return m_lists; }
+    const InstanceLightStats& GetStats() const { return m_stats; }
+
+    // Random lights and instances in a 60 x 20 x 60 box
+    static InstanceLightBenchmarkResult Benchmark(ThreadPool* pPool, uint32_t lightCount, uint32_t instanceCount);
+
+private:
+    struct Scratch
+    {
+        std::vector<uint32_t> lights;
+        std::vector<float> scores;
+        uint32_t overflowed;
+    };
+
+    void LoadLights(const void* pLights, uint32_t stride, uint32_t lightCount);
+    void BuildRange(const InstanceBounds* pBounds, uint32_t first, uint32_t count, uint32_t threadIndex, bool simd);
+    uint32_t GatherSimd(const InstanceBounds& bounds, Scratch& scratch) const;
+    uint32_t GatherScalar(const InstanceBounds& bounds, Scratch& scratch) const;
+    void WriteList(uint32_t instance, uint32_t found, Scratch& scratch);
+
+    ThreadPool* m_pPool;
+
+    // SoA copy of the lights, padded to four with lanes that touch nothing
+    std::vector<float> m_x;
+    std::vector<float> m_y;
+    std::vector<float> m_z;
+    std::vector<float> m_radius;
+    std::vector<float> m_radiusSquared;
+    uint32_t m_lightCount;
+
+    std::vector<Scratch> m_scratch;     // one per pool thread
+    std::vector<uint32_t> m_lists;
+    InstanceLightStats m_stats;
+};
+
+#endif
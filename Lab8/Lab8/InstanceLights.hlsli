@@ -0,0 +1,23 @@
+// Light lists of every cube in ModelBufferInst, built by InstanceLightLists on the CPU.
+// They replace the clusters of ClusteredLights.hlsli, which must be included first.
+
+cbuffer InstanceLightBuffer : register(b5)
+{
+    uint instanceLightsEnabled;
+    uint instanceLightStride;       // light count, then the indices into pointLights
+    uint2 instanceLightPadding;
+};
+
+StructuredBuffer<uint> instanceLightLists : register(t9);
+
+bool InstanceLightsEnabled()
+{
+    return instanceLightsEnabled != 0;
+}
+
+// (offset, count) into instanceLightLists for the instance
+uint2 GetInstanceLightRange(uint instance)
+{
+    uint offset = instance * instanceLightStride;
+    return uint2(offset + 1, instanceLightLists[offset]);
+}
@@ -0,0 +1,39 @@
+static const uint MAX_BATCH_INSTANCES = 256;
+
+struct InstanceData
+{
+    float4x4 model;
+    float4 color;
+};
+
+cbuffer InstanceBuffer : register(b0)
+{
+    InstanceData instances[MAX_BATCH_INSTANCES];
+};
+
+cbuffer CameraBuffer : register(b1)
+{
+    matrix vp;
+};
+
+struct VSInput
+{
+    float3 pos : POSITION;
+};
+
+struct VSOutput
+{
+    float4 pos : SV_Position;
+    float3 WorldPos : TEXCOORD0;
+    float4 Color : COLOR0;
+};
+
+VSOutput main(VSInput vertex, uint instanceID : SV_InstanceID)
+{
+    VSOutput output;
+    float4 worldPos = mul(float4(vertex.pos, 1.0f), instances[instanceID].model);
+    output.WorldPos = worldPos.xyz;
+    output.pos = mul(worldPos, vp);
+    output.Color = instances[instanceID].color;
+    return output;
+}
@@ -4,7 +4,6 @@
 
 #include "imgui.h"
 #include "imgui_impl_win32.h"
-#include "imgui_impl_dx11.h"
 
 #define MAX_LOADSTRING 100
 
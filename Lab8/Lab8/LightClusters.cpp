@@ -0,0 +1,354 @@
+#include "LightClusters.h"
+#include "Profiler.h"
+#include "ThreadPool.h"
+#include <emmintrin.h>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    const uint32_t BoundsChunk = 256;
+
+    // Adds one to the lanes where mask is set (all-ones reads as -1)
+    __m128i CountLanes(__m128i counter, __m128 mask)
+    {
+        return _mm_sub_epi32(counter, _mm_castps_si128(mask));
+    }
+
+    __m128i SelectInt(__m128 mask, __m128i a, __m128i b)
+    {
+        __m128i m = _mm_castps_si128(mask);
+        return _mm_or_si128(_mm_and_si128(m, a), _mm_andnot_si128(m, b));
+    }
+}
+
+void LightClusterGrid::Build(const XMFLOAT4X4& view, const XMFLOAT4X4& proj, uint32_t screenWidth, uint32_t screenHeight,
+    const void* pLights, uint32_t stride, uint32_t lightCount)
+{
+    PROFILE_SCOPE("Light Clusters");
+
+    memcpy(m_view, view.m, sizeof(m_view));
+    m_projX = proj.m[0][0];
+    m_projY = proj.m[1][1];
+    // XMMatrixPerspectiveFovLH: m22 = f / (f - n), m32 = -n * f / (f - n)
+    m_near = -proj.m[3][2] / proj.m[2][2];
+    m_far = proj.m[3][2] / (1.0f - proj.m[2][2]);
+    for (uint32_t k = 0; k <= GridZ; k++)
+        m_sliceDepths[k] = m_near * powf(m_far / m_near, static_cast<float>(k) / GridZ);
+
+    // Column boundary at ndc x = a is the plane x * projX - a * z = 0, rows go top down
+    for (uint32_t i = 0; i <= GridX; i++)
+    {
+        float a = -1.0f + 2.0f * i / GridX;
+        float invLength = 1.0f / sqrtf(m_projX * m_projX + a * a);
+        m_columnPlanes[i][0] = m_projX * invLength;
+        m_columnPlanes[i][1] = -a * invLength;
+    }
+    for (uint32_t j = 0; j <= GridY; j++)
+    {
+        float b = 1.0f - 2.0f * j / GridY;
+        float invLength = 1.0f / sqrtf(m_projY * m_projY + b * b);
+        m_rowPlanes[j][0] = -m_projY * invLength;
+        m_rowPlanes[j][1] = b * invLength;
+    }
+
+    // SoA copy; the padding lanes get a negative radius and never touch a cluster
+    m_lightCount = lightCount;
+    uint32_t padded = (lightCount + 3) & ~3u;
+    m_x.assign(padded, 0.0f);
+    m_y.assign(padded, 0.0f);
+    m_z.assign(padded, 0.0f);
+    m_radius.assign(padded, -1.0f);
+    const unsigned char* pSource = static_cast<const unsigned char*>(pLights);
+    for (uint32_t i = 0; i < lightCount; i++)
+    {
+        const float* pLight = reinterpret_cast<const float*>(pSource + static_cast<size_t>(i) * stride);
+        m_x[i] = pLight[0];
+        m_y[i] = pLight[1];
+        m_z[i] = pLight[2];
+        m_radius[i] = pLight[3];
+    }
+    m_bounds.resize(static_cast<size_t>(padded) * 6);
+
+    uint32_t chunkCount = (padded + BoundsChunk - 1) / BoundsChunk;
+    auto boundsTask = [this, padded](uint32_t chunk, uint32_t)
+    {
+        uint32_t first = chunk * BoundsChunk;
+        ComputeBounds(first, padded - first < BoundsChunk ? padded - first : BoundsChunk);
+    };
+    auto sliceTask = [this](uint32_t z, uint32_t) { FillSlice(z); };
+    if (m_pPool)
+        m_pPool->ParallelFor(chunkCount, boundsTask);
+    else
+    {
+        for (uint32_t chunk = 0; chunk < chunkCount; chunk++)
+            boundsTask(chunk, 0);
+    }
+
+    // Bucket the visible lights by depth slice, so a slice only walks the lights that reach it
+    uint32_t sliceCounts[GridZ] = {};
+    uint32_t visibleLights = 0;
+    for (uint32_t i = 0; i < lightCount; i++)
+    {
+        for (uint32_t z = m_bounds[i * 6 + 4]; z <= m_bounds[i * 6 + 5]; z++)
+            sliceCounts[z]++;
+        if (m_bounds[i * 6 + 4] <= m_bounds[i * 6 + 5])
+            visibleLights++;
+    }
+    m_sliceLightOffsets[0] = 0;
+    for (uint32_t z = 0; z < GridZ; z++)
+    {
+        m_sliceLightOffsets[z + 1] = m_sliceLightOffsets[z] + sliceCounts[z];
+        sliceCounts[z] = m_sliceLightOffsets[z];
+    }
+    m_sliceLights.resize(m_sliceLightOffsets[GridZ]);
+    for (uint32_t i = 0; i < lightCount; i++)
+    {
+        for (uint32_t z = m_bounds[i * 6 + 4]; z <= m_bounds[i * 6 + 5]; z++)
+            m_sliceLights[sliceCounts[z]++] = i;
+    }
+
+    if (m_pPool)
+        m_pPool->ParallelFor(GridZ, sliceTask);
+    else
+    {
+        for (uint32_t z = 0; z < GridZ; z++)
+            sliceTask(z, 0);
+    }
+
+    // Slices are concatenated in order; whatever does not fit in MaxLightIndices is dropped
+    m_stats = LightClusterStats();
+    m_stats.lightCount = lightCount;
+    m_stats.visibleLights = visibleLights;
+    uint32_t total = 0;
+    for (uint32_t z = 0; z < GridZ; z++)
+    {
+        m_slices[z].base = total;
+        total += static_cast<uint32_t>(m_slices[z].indices.size());
+    }
+    m_stats.overflow = total > MaxLightIndices;
+    m_stats.references = m_stats.overflow ? MaxLightIndices : total;
+    m_indices.resize(m_stats.references);
+    m_ranges.resize(ClusterCount * 2);
+
+    for (uint32_t z = 0; z < GridZ; z++)
+    {
+        const Slice& slice = m_slices[z];
+        for (uint32_t c = 0; c < GridX * GridY; c++)
+        {
+            uint32_t offset = slice.base + slice.offsets[c];
+            uint32_t count = slice.counts[c];
+            if (offset >= MaxLightIndices)
+                offset = count = 0;
+            else if (offset + count > MaxLightIndices)
+                count = MaxLightIndices - offset;
+
+            uint32_t cluster = z * GridX * GridY + c;
+            m_ranges[cluster * 2] = offset;
+            m_ranges[cluster * 2 + 1] = count;
+            if (count > m_stats.maxLightsPerCluster)
+                m_stats.maxLightsPerCluster = count;
+        }
+
+        if (slice.base < MaxLightIndices && !slice.indices.empty())
+        {
+            size_t copyCount = slice.indices.size();
+            if (slice.base + copyCount > MaxLightIndices)
+                copyCount = MaxLightIndices - slice.base;
+            memcpy(&m_indices[slice.base], slice.indices.data(), copyCount * sizeof(uint32_t));
+        }
+    }
+
+    m_constants.gridX = GridX;
+    m_constants.gridY = GridY;
+    m_constants.gridZ = GridZ;
+    m_constants.depthScale = GridZ / logf(m_far / m_near);
+    m_constants.depthBias = -logf(m_near) * m_constants.depthScale;
+    m_constants.screenScaleX = screenWidth > 0 ? static_cast<float>(GridX) / screenWidth : 0.0f;
+    m_constants.screenScaleY = screenHeight > 0 ? static_cast<float>(GridY) / screenHeight : 0.0f;
+    m_constants.lightCount = lightCount;
+}
+
+void LightClusterGrid::ComputeBounds(uint32_t firstLight, uint32_t count)
+{
+    const __m128 nearPlane = _mm_set1_ps(m_near);
+    const __m128 farPlane = _mm_set1_ps(m_far);
+    const __m128 zero = _mm_setzero_ps();
+
+    for (uint32_t i = firstLight; i < firstLight + count; i += 4)
+    {
+        __m128 x = _mm_loadu_ps(&m_x[i]);
+        __m128 y = _mm_loadu_ps(&m_y[i]);
+        __m128 z = _mm_loadu_ps(&m_z[i]);
+        __m128 radius = _mm_loadu_ps(&m_radius[i]);
+        __m128 negRadius = _mm_sub_ps(zero, radius);
+
+        // Row vectors, as mul(position, view) in the shaders
+        __m128 vx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(m_view[0][0])), _mm_mul_ps(y, _mm_set1_ps(m_view[1][0]))),
+            _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(m_view[2][0])), _mm_set1_ps(m_view[3][0])));
+        __m128 vy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(m_view[0][1])), _mm_mul_ps(y, _mm_set1_ps(m_view[1][1]))),
+            _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(m_view[2][1])), _mm_set1_ps(m_view[3][1])));
+        __m128 vz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(m_view[0][2])), _mm_mul_ps(y, _mm_set1_ps(m_view[1][2]))),
+            _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(m_view[2][2])), _mm_set1_ps(m_view[3][2])));
+
+        __m128 zMin = _mm_sub_ps(vz, radius);
+        __m128 zMax = _mm_add_ps(vz, radius);
+        __m128 visible = _mm_and_ps(_mm_cmpgt_ps(radius, zero),
+            _mm_and_ps(_mm_cmpgt_ps(zMax, nearPlane), _mm_cmplt_ps(zMin, farPlane)));
+
+        // Slice index = number of inner slice boundaries at or in front of the depth
+        __m128i minZ = _mm_setzero_si128();
+        __m128i maxZ = _mm_setzero_si128();
+        for (uint32_t k = 1; k < GridZ; k++)
+        {
+            __m128 depth = _mm_set1_ps(m_sliceDepths[k]);
+            minZ = CountLanes(minZ, _mm_cmpge_ps(zMin, depth));
+            maxZ = CountLanes(maxZ, _mm_cmpge_ps(zMax, depth));
+        }
+
+        // A sphere in front of the near plane spans a contiguous range of tiles: count the
+        // boundaries it lies entirely behind. The frustum edges reject spheres beside it.
+        __m128i minX = _mm_setzero_si128();
+        __m128i maxX = _mm_setzero_si128();
+        for (uint32_t c = 0; c <= GridX; c++)
+        {
+            __m128 distance = _mm_add_ps(_mm_mul_ps(vx, _mm_set1_ps(m_columnPlanes[c][0])), _mm_mul_ps(vz, _mm_set1_ps(m_columnPlanes[c][1])));
+            if (c == 0)
+                visible = _mm_and_ps(visible, _mm_cmpge_ps(distance, negRadius));
+            else if (c == GridX)
+                visible = _mm_and_ps(visible, _mm_cmple_ps(distance, radius));
+            else
+            {
+                minX = CountLanes(minX, _mm_cmpgt_ps(distance, radius));
+                maxX = CountLanes(maxX, _mm_cmpge_ps(distance, negRadius));
+            }
+        }
+
+        __m128i minY = _mm_setzero_si128();
+        __m128i maxY = _mm_setzero_si128();
+        for (uint32_t r = 0; r <= GridY; r++)
+        {
+            __m128 distance = _mm_add_ps(_mm_mul_ps(vy, _mm_set1_ps(m_rowPlanes[r][0])), _mm_mul_ps(vz, _mm_set1_ps(m_rowPlanes[r][1])));
+            if (r == 0)
+                visible = _mm_and_ps(visible, _mm_cmpge_ps(distance, negRadius));
+            else if (r == GridY)
+                visible = _mm_and_ps(visible, _mm_cmple_ps(distance, radius));
+            else
+            {
+                minY = CountLanes(minY, _mm_cmpgt_ps(distance, radius));
+                maxY = CountLanes(maxY, _mm_cmpge_ps(distance, negRadius));
+            }
+        }
+
+        // Spheres around the eye break the plane ordering; they get every tile of their slices
+        __m128 aroundEye = _mm_cmplt_ps(zMin, nearPlane);
+        minX = SelectInt(aroundEye, _mm_setzero_si128(), minX);
+        maxX = SelectInt(aroundEye, _mm_set1_epi32(GridX - 1), maxX);
+        minY = SelectInt(aroundEye, _mm_setzero_si128(), minY);
+        maxY = SelectInt(aroundEye, _mm_set1_epi32(GridY - 1), maxY);
+        minZ = SelectInt(visible, minZ, _mm_set1_epi32(GridZ));
+        maxZ = SelectInt(visible, maxZ, _mm_setzero_si128());
+
+        alignas(16) int32_t lanes[6][4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(lanes[0]), minX);
+        _mm_store_si128(reinterpret_cast<__m128i*>(lanes[1]), maxX);
+        _mm_store_si128(reinterpret_cast<__m128i*>(lanes[2]), minY);
+        _mm_store_si128(reinterpret_cast<__m128i*>(lanes[3]), maxY);
+        _mm_store_si128(reinterpret_cast<__m128i*>(lanes[4]), minZ);
+        _mm_store_si128(reinterpret_cast<__m128i*>(lanes[5]), maxZ);
+        for (int lane = 0; lane < 4; lane++)
+        {
+            uint8_t* pBounds = &m_bounds[(i + lane) * 6];
+            for (int b = 0; b < 6; b++)
+                pBounds[b] = static_cast<uint8_t>(lanes[b][lane]);
+        }
+    }
+}
+
+void LightClusterGrid::FillSlice(uint32_t z)
+{
+    Slice& slice = m_slices[z];
+    slice.counts.assign(GridX * GridY, 0);
+    slice.offsets.resize(GridX * GridY);
+
+    const uint32_t* pFirst = m_sliceLights.data() + m_sliceLightOffsets[z];
+    const uint32_t* pLast = m_sliceLights.data() + m_sliceLightOffsets[z + 1];
+    for (const uint32_t* pLight = pFirst; pLight != pLast; pLight++)
+    {
+        const uint8_t* pBounds = &m_bounds[*pLight * 6];
+        for (uint32_t y = pBounds[2]; y <= pBounds[3]; y++)
+        {
+            for (uint32_t x = pBounds[0]; x <= pBounds[1]; x++)
+                slice.counts[y * GridX + x]++;
+        }
+    }
+
+    uint32_t total = 0;
+    for (uint32_t c = 0; c < GridX * GridY; c++)
+    {
+        slice.offsets[c] = total;
+        total += slice.counts[c];
+        slice.counts[c] = 0;
+    }
+    slice.indices.resize(total);
+
+    // Second pass writes in light order, so every cluster list comes out sorted
+    for (const uint32_t* pLight = pFirst; pLight != pLast; pLight++)
+    {
+        const uint8_t* pBounds = &m_bounds[*pLight * 6];
+        for (uint32_t y = pBounds[2]; y <= pBounds[3]; y++)
+        {
+            for (uint32_t x = pBounds[0]; x <= pBounds[1]; x++)
+            {
+                uint32_t c = y * GridX + x;
+                slice.indices[slice.offsets[c] + slice.counts[c]++] = *pLight;
+            }
+        }
+    }
+}
+
+LightClusterBenchmarkResult LightClusterGrid::Benchmark(ThreadPool* pPool, uint32_t lightCount, uint32_t iterations)
+{
+    // Same camera setup as the scene: 45 degree vertical field of view, 0.1 to 100
+    const float nearZ = 0.1f;
+    const float farZ = 100.0f;
+    const float aspect = 16.0f / 9.0f;
+    float yScale = 1.0f / tanf(XM_PIDIV4 * 0.5f);
+    XMFLOAT4X4 proj = {};
+    proj.m[0][0] = yScale / aspect;
+    proj.m[1][1] = yScale;
+    proj.m[2][2] = farZ / (farZ - nearZ);
+    proj.m[2][3] = 1.0f;
+    proj.m[3][2] = -nearZ * farZ / (farZ - nearZ);
+    XMFLOAT4X4 view = {};
+    for (int i = 0; i < 4; i++)
+        view.m[i][i] = 1.0f;
+
+    // position, range
+    std::vector<XMFLOAT4> lights(lightCount);
+    uint32_t seed = 12345;
+    auto next = [&seed]()
+    {
+        seed = seed * 1664525u + 1013904223u;
+        return (seed >> 8) * (1.0f / 16777216.0f);
+    };
+    for (auto& light : lights)
+        light = XMFLOAT4(next() * 60.0f - 30.0f, next() * 20.0f - 10.0f, next() * 60.0f, 0.5f + next() * 2.5f);
+
+    LightClusterGrid grid;
+    grid.SetThreadPool(pPool);
+    grid.Build(view, proj, 1920, 1080, lights.data(), sizeof(XMFLOAT4), lightCount);
+
+    uint64_t start = Profiler::NowNs();
+    for (uint32_t i = 0; i < iterations; i++)
+        grid.Build(view, proj, 1920, 1080, lights.data(), sizeof(XMFLOAT4), lightCount);
+    uint64_t elapsed = Profiler::NowNs() - start;
+
+    LightClusterBenchmarkResult result = {};
+    result.lightCount = lightCount;
+    result.iterations = iterations;
+    result.threads = pPool ? pPool->GetThreadCount() : 1;
+    result.msPerBuild = iterations > 0 ? elapsed * 1.0e-6 / iterations : 0.0;
+    result.referencesPerCluster = static_cast<double>(grid.GetStats().references) / ClusterCount;
+    return result;
+}
@@ -0,0 +1,117 @@
+#ifndef LIGHT_CLUSTERS_H
+#define LIGHT_CLUSTERS_H
+
+#include <DirectXMath.h>
+#include <cstdint>
+#include <vector>
+
+using namespace DirectX;
+
+class ThreadPool;
+
+// Layout of the ClusterBuffer constant buffer in ClusteredLights.hlsli
+struct ClusterConstants
+{
+    uint32_t gridX;
+    uint32_t gridY;
+    uint32_t gridZ;
+    float depthScale;       // slice = log(viewZ) * depthScale + depthBias
+    float depthBias;
+    float screenScaleX;     // cluster column = pixel x * screenScaleX
+    float screenScaleY;
+    uint32_t lightCount;
+};
+
+struct LightClusterStats
+{
+    uint32_t lightCount;
+    uint32_t visibleLights;     // touching at least one cluster
+    uint32_t references;        // entries in the index list
+    uint32_t maxLightsPerCluster;
+    bool overflow;              // references beyond MaxLightIndices were dropped
+};
+
+struct LightClusterBenchmarkResult
+{
+    uint32_t lightCount;
+    uint32_t iterations;
+    uint32_t threads;
+    double msPerBuild;
+    double referencesPerCluster;
+};
+
+// Clustered forward light assignment. The view frustum is cut into GridX x GridY screen
+// tiles and GridZ exponential depth slices; every cluster gets an (offset, count) range
+// into one shared list of light indices that the pixel shaders walk instead of every light.
+// Bounds of four lights at a time are found with SSE plane tests against the tile
+// boundaries, then the depth slices fill their clusters in parallel on the thread pool.
+class LightClusterGrid
+{
+public:
+    static const uint32_t GridX = 16;
+    static const uint32_t GridY = 9;
+    static const uint32_t GridZ = 24;
+    static const uint32_t ClusterCount = GridX * GridY * GridZ;
+    static const uint32_t MaxLightIndices = 256 * 1024;
+
+    LightClusterGrid() : m_pPool(nullptr), m_constants(), m_stats() {}
+
+    void SetThreadPool(ThreadPool* pPool) { m_pPool = pPool; }
+
+    // Each light starts with its world position (float3) and range (float), stride bytes apart,
+    // like PointLight in the shaders. proj is a D3D left-handed perspective projection.
+    void Build(const XMFLOAT4X4& view, const XMFLOAT4X4& proj, uint32_t screenWidth, uint32_t screenHeight,
+        const void* pLights, uint32_t stride, uint32_t lightCount);
+
+    // (offset, count) pairs, cluster index = (z * GridY + y) * GridX + x
+    const std::vector<uint32_t>& GetClusterRanges() const { return m_ranges; }
+    const std::vector<uint32_t>& GetLightIndices() const { return m_indices; }
+    const ClusterConstants& GetConstants() const { return m_constants; }
+    const LightClusterStats& GetStats() const { return m_stats; }
+
+    // Random lights in front of a fixed camera, timing Build alone
+    static LightClusterBenchmarkResult Benchmark(ThreadPool* pPool, uint32_t lightCount, uint32_t iterations);
+
+private:
+    struct Slice
+    {
+        std::vector<uint32_t> counts;   // GridX * GridY
+        std::vector<uint32_t> offsets;
+        std::vector<uint32_t> indices;
+        uint32_t base;
+    };
+
+    void ComputeBounds(uint32_t firstLight, uint32_t count);
+    void FillSlice(uint32_t z);
+
+    ThreadPool* m_pPool;
+
+    // Inputs of the build in progress in SoA form, four lights per SSE register
+    std::vector<float> m_x;
+    std::vector<float> m_y;
+    std::vector<float> m_z;
+    std::vector<float> m_radius;
+    float m_view[4][4];
+    float m_projX;
+    float m_projY;
+    float m_near;
+    float m_far;
+    float m_sliceDepths[GridZ + 1];
+    // Unit normals (x or y, z) of the planes through the eye along the tile boundaries, edges included
+    float m_columnPlanes[GridX + 1][2];
+    float m_rowPlanes[GridY + 1][2];
+    uint32_t m_lightCount;
+
+    // Inclusive cluster bounds of every light; minZ > maxZ for lights outside the frustum
+    std::vector<uint8_t> m_bounds;  // minX, maxX, minY, maxY, minZ, maxZ
+    uint32_t m_sliceLightOffsets[GridZ + 1];
+    std::vector<uint32_t> m_sliceLights;
+
+    Slice m_slices[GridZ];
+    std::vector<uint32_t> m_ranges;
+    std::vector<uint32_t> m_indices;
+    ClusterConstants m_constants;
+    LightClusterStats m_stats;
+};
+
+#endif
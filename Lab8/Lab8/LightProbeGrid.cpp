@@ -0,0 +1,498 @@
+#include "LightProbeGrid.h"
+#include "Profiler.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+
+namespace
+{
+    const float RayBias = 1.0e-3f;
+    const uint32_t ParallelChunk = 4096;
+
+    // Probes whose rays mostly see the back of a face sit inside a cube
+    const float MaxBackfaceFraction = 0.25f;
+
+    // Same basis and order as EnvironmentLighting: Y00, Y1-1, Y10, Y11, Y2-2, Y2-1, Y20, Y21, Y22
+    void EvaluateBasis(const SwFloat3& d, SwFloat basis[9])
+    {
+        basis[0] = SwFloat(0.282095f);
+        basis[1] = d.y * 0.488603f;
+        basis[2] = d.z * 0.488603f;
+        basis[3] = d.x * 0.488603f;
+        basis[4] = d.x * d.y * 1.092548f;
+        basis[5] = d.y * d.z * 1.092548f;
+        basis[6] = (d.z * d.z * 3.0f - 1.0f) * 0.315392f;
+        basis[7] = d.x * d.z * 1.092548f;
+        basis[8] = (d.x * d.x - d.y * d.y) * 0.546274f;
+    }
+
+    // Cosine lobe convolution divided by pi for each band: the irradiance SH stored by
+    // EnvironmentLighting is radiance SH times these
+    const float BandScale[9] = { 1.0f, 2.0f / 3.0f, 2.0f / 3.0f, 2.0f / 3.0f, 0.25f, 0.25f, 0.25f, 0.25f, 0.25f };
+
+    SwFloat3 EvaluateSH(const XMFLOAT4 sh[9], const SwFloat basis[9])
+    {
+        SwFloat3 result(0.0f, 0.0f, 0.0f);
+        for (int i = 0; i < 9; i++)
+            result = result + SwFloat3(sh[i].x, sh[i].y, sh[i].z) * basis[i];
+        return SwFloat3(Max(result.x, 0.0f), Max(result.y, 0.0f), Max(result.z, 0.0f));
+    }
+
+    // Evenly spread directions on the sphere; every probe uses the same set, so neighbouring
+    // probes differ by what they see rather than by sampling noise
+    void FibonacciDirection(uint32_t index, uint32_t count, float out[3])
+    {
+        const float goldenAngle = 2.39996323f;
+        float z = 1.0f - (2.0f * index + 1.0f) / count;
+        float radius = sqrtf(std::max(1.0f - z * z, 0.0f));
+        float phi = goldenAngle * index;
+        out[0] = radius * cosf(phi);
+        out[1] = radius * sinf(phi);
+        out[2] = z;
+    }
+
+    uint32_t LaneCount(const SwFloat& mask)
+    {
+        int bits = _mm_movemask_ps(mask.v);
+        return (bits & 1) + ((bits >> 1) & 1) + ((bits >> 2) & 1) + ((bits >> 3) & 1);
+    }
+
+    // Diffuse term of ColorPixel.ps with shadow rays, as LightmapBaker bakes it
+    SwFloat3 DirectLight(const RayTracer& tracer, const SwPointLight lights[3], const SwFloat3& position, const SwFloat3& normal,
+        const SwFloat& mask, uint64_t& rays)
+    {
+        SwFloat3 result(0.0f, 0.0f, 0.0f);
+        SwFloat3 shadowOrigin = position + normal * SwFloat(RayBias);
+
+        for (int i = 0; i < 3; i++)
+        {
+            const SwPointLight& light = lights[i];
+            SwFloat3 toLight = SwFloat3(light.position.x, light.position.y, light.position.z) - position;
+            SwFloat distance = Length(toLight);
+            SwFloat3 lightDir = toLight * (SwFloat(1.0f) / distance);
+            SwFloat attenuation = SwFloat(1.0f) - Saturate(distance * (1.0f / light.range));
+            SwFloat scale = Max(Dot(normal, lightDir), 0.0f) * attenuation * light.intensity;
+
+            SwFloat lit = _mm_and_ps(mask.v, _mm_cmpgt_ps(scale.v, _mm_setzero_ps()));
+            if (_mm_movemask_ps(lit.v) == 0)
+                continue;
+
+            RtRayPacket shadow;
+            shadow.origin = shadowOrigin;
+            shadow.direction = lightDir;
+            shadow.tMax = Select(lit, distance - RayBias, 0.0f);
+            SwFloat visible = _mm_andnot_ps(tracer.Occluded(shadow).v, lit.v);
+            rays += LaneCount(lit);
+
+            scale = _mm_and_ps(visible.v, scale.v);
+            result = result + SwFloat3(light.color.x, light.color.y, light.color.z) * scale;
+        }
+        return result;
+    }
+
+    uint32_t NextRandom(uint32_t& seed)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        return seed;
+    }
+}
+
+// std::min binds the constants by reference, they need storage
+const uint32_t LightProbeGrid::CoefficientCount;
+const uint32_t LightProbeGrid::BatchSize;
+
+bool LightProbeGrid::Init(ThreadPool* pPool)
+{
+    m_pPool = pPool;
+    return m_tracer.Init(pPool);
+}
+
+void LightProbeGrid::SetMesh(const SwMeshData& data)
+{
+    m_tracer.SetMesh(data);
+}
+
+bool LightProbeGrid::Bake(const std::vector<SwCubeInstance>& cubes, const SwPointLight lights[3], const XMFLOAT4 skySH[CoefficientCount],
+    const ProbeGridSettings& settings)
+{
+    if (cubes.empty() || settings.spacing <= 0.0f)
+        return false;
+
+    uint64_t start = Profiler::NowNs();
+    m_settings = settings;
+    m_settings.raysPerProbe = (settings.raysPerProbe + 3) & ~3u;
+    if (m_settings.raysPerProbe == 0)
+        m_settings.raysPerProbe = 4;
+    m_invSpacing = 1.0f / settings.spacing;
+
+    // At least two probes per axis, so every point has a cell to interpolate in
+    const float extent[3] = { settings.boundsMax.x - settings.boundsMin.x, settings.boundsMax.y - settings.boundsMin.y,
+        settings.boundsMax.z - settings.boundsMin.z };
+    for (int k = 0; k < 3; k++)
+        m_size[k] = std::max(static_cast<uint32_t>(ceilf(std::max(extent[k], 0.0f) * m_invSpacing - 1.0e-3f)) + 1, 2u);
+
+    m_tracer.BuildScene(cubes);
+    const uint32_t probeCount = GetProbeCount();
+    m_probes.assign(static_cast<size_t>(probeCount) * CoefficientCount, XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f));
+    std::vector<uint8_t> valid(probeCount, 0);
+    std::atomic<uint64_t> totalRays(0);
+
+    auto task = [this, lights, skySH, &valid, &totalRays](uint32_t probe, uint32_t)
+    {
+        uint64_t rays = 0;
+        bool probeValid = false;
+        BakeProbe(probe, lights, skySH, rays, probeValid);
+        valid[probe] = probeValid ? 1 : 0;
+        totalRays += rays;
+    };
+    if (m_pPool)
+        m_pPool->ParallelFor(probeCount, task);
+    else
+    {
+        for (uint32_t probe = 0; probe < probeCount; probe++)
+            task(probe, 0);
+    }
+
+    m_stats = {};
+    m_stats.probes = probeCount;
+    for (uint8_t v : valid)
+        m_stats.invalidProbes += v ? 0 : 1;
+    FillInvalidProbes(valid, skySH);
+
+    m_stats.rays = totalRays.load();
+    m_stats.threads = m_pPool ? m_pPool->GetThreadCount() : 1;
+    m_stats.seconds = (Profiler::NowNs() - start) * 1.0e-9;
+    m_baked = true;
+    return true;
+}
+
+void LightProbeGrid::BakeProbe(uint32_t probe, const SwPointLight lights[3], const XMFLOAT4 skySH[CoefficientCount], uint64_t& rays, bool& valid)
+{
+    uint32_t x = probe % m_size[0];
+    uint32_t y = (probe / m_size[0]) % m_size[1];
+    uint32_t z = probe / (m_size[0] * m_size[1]);
+    SwFloat3 origin(m_settings.boundsMin.x + x * m_settings.spacing, m_settings.boundsMin.y + y * m_settings.spacing,
+        m_settings.boundsMin.z + z * m_settings.spacing);
+
+    // Sky radiance is recovered from its irradiance by undoing the cosine convolution
+    XMFLOAT4 skyRadiance[CoefficientCount];
+    for (uint32_t i = 0; i < CoefficientCount; i++)
+    {
+        float scale = 1.0f / BandScale[i];
+        skyRadiance[i] = XMFLOAT4(skySH[i].x * scale, skySH[i].y * scale, skySH[i].z * scale, 0.0f);
+    }
+
+    const uint32_t rayCount = m_settings.raysPerProbe;
+    SwFloat3 sum[CoefficientCount];
+    for (uint32_t i = 0; i < CoefficientCount; i++)
+        sum[i] = SwFloat3(0.0f, 0.0f, 0.0f);
+    uint32_t backfaces = 0;
+
+    for (uint32_t r = 0; r < rayCount; r += 4)
+    {
+        alignas(16) float direction[3][4];
+        for (int lane = 0; lane < 4; lane++)
+        {
+            float laneDirection[3];
+            FibonacciDirection(r + lane, rayCount, laneDirection);
+            for (int k = 0; k < 3; k++)
+                direction[k][lane] = laneDirection[k];
+        }
+
+        RtRayPacket packet;
+        packet.origin = origin;
+        packet.direction = SwFloat3(_mm_load_ps(direction[0]), _mm_load_ps(direction[1]), _mm_load_ps(direction[2]));
+        packet.tMax = SwFloat(FLT_MAX);
+        RtHitPacket hit;
+        m_tracer.Intersect(packet, hit);
+        rays += 4;
+
+        SwFloat basis[CoefficientCount];
+        EvaluateBasis(packet.direction, basis);
+        SwFloat3 sky = EvaluateSH(skyRadiance, basis);
+
+        RtSurface surfaces[4];
+        m_tracer.GetSurfaces(hit, surfaces);
+        alignas(16) float position[3][4] = {};
+        alignas(16) float normal[3][4] = {};
+        alignas(16) float albedo[3][4] = {};
+        alignas(16) uint32_t hitMask[4] = {};
+        alignas(16) uint32_t frontMask[4] = {};
+        for (int lane = 0; lane < 4; lane++)
+        {
+            if (hit.triangle[lane] == RtNoHit)
+                continue;
+
+            hitMask[lane] = 0xFFFFFFFFu;
+            const RtSurface& surface = surfaces[lane];
+            float facing = surface.normal[0] * direction[0][lane] + surface.normal[1] * direction[1][lane] +
+                surface.normal[2] * direction[2][lane];
+            if (facing > 0.0f)
+            {
+                backfaces++;
+                continue;
+            }
+            frontMask[lane] = 0xFFFFFFFFu;
+            for (int k = 0; k < 3; k++)
+            {
+                position[k][lane] = surface.position[k];
+                normal[k][lane] = surface.normal[k];
+                albedo[k][lane] = surface.albedo[k];
+            }
+        }
+
+        SwFloat hitLanes = _mm_castsi128_ps(_mm_load_si128(reinterpret_cast<const __m128i*>(hitMask)));
+        SwFloat frontLanes = _mm_castsi128_ps(_mm_load_si128(reinterpret_cast<const __m128i*>(frontMask)));
+        SwFloat3 radiance(Select(hitLanes, 0.0f, sky.x), Select(hitLanes, 0.0f, sky.y), Select(hitLanes, 0.0f, sky.z));
+        if (_mm_movemask_ps(frontLanes.v) != 0)
+        {
+            // One bounce: the hit surface lit by the point lights and the unoccluded sky
+            SwFloat3 hitPosition(_mm_load_ps(position[0]), _mm_load_ps(position[1]), _mm_load_ps(position[2]));
+            SwFloat3 hitNormal(_mm_load_ps(normal[0]), _mm_load_ps(normal[1]), _mm_load_ps(normal[2]));
+            SwFloat3 hitAlbedo(_mm_load_ps(albedo[0]), _mm_load_ps(albedo[1]), _mm_load_ps(albedo[2]));
+            SwFloat normalBasis[CoefficientCount];
+            EvaluateBasis(hitNormal, normalBasis);
+            SwFloat3 incoming = DirectLight(m_tracer, lights, hitPosition, hitNormal, frontLanes, rays) + EvaluateSH(skySH, normalBasis);
+            SwFloat3 bounce = hitAlbedo * incoming;
+            radiance = SwFloat3(Select(frontLanes, bounce.x, radiance.x), Select(frontLanes, bounce.y, radiance.y),
+                Select(frontLanes, bounce.z, radiance.z));
+        }
+
+        for (uint32_t i = 0; i < CoefficientCount; i++)
+            sum[i] = sum[i] + radiance * basis[i];
+    }
+
+    // Monte Carlo weight of a uniform sphere sample, then the cosine convolution
+    float weight = 4.0f * XM_PI / rayCount;
+    XMFLOAT4* pProbe = &m_probes[static_cast<size_t>(probe) * CoefficientCount];
+    for (uint32_t i = 0; i < CoefficientCount; i++)
+    {
+        float scale = weight * BandScale[i];
+        pProbe[i].x = (sum[i].x[0] + sum[i].x[1] + sum[i].x[2] + sum[i].x[3]) * scale;
+        pProbe[i].y = (sum[i].y[0] + sum[i].y[1] + sum[i].y[2] + sum[i].y[3]) * scale;
+        pProbe[i].z = (sum[i].z[0] + sum[i].z[1] + sum[i].z[2] + sum[i].z[3]) * scale;
+        pProbe[i].w = 0.0f;
+    }
+    valid = backfaces <= rayCount * MaxBackfaceFraction;
+}
+
+void LightProbeGrid::FillInvalidProbes(std::vector<uint8_t>& valid, const XMFLOAT4 skySH[CoefficientCount])
+{
+    // Probes inside cubes would make neighbouring instances black: each pass gives every
+    // invalid probe the average of its valid face neighbours, until nothing changes
+    const int offsets[6][3] = { { -1, 0, 0 }, { 1, 0, 0 }, { 0, -1, 0 }, { 0, 1, 0 }, { 0, 0, -1 }, { 0, 0, 1 } };
+    std::vector<uint8_t> next = valid;
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (uint32_t probe = 0; probe < valid.size(); probe++)
+        {
+            if (valid[probe])
+                continue;
+
+            int x = static_cast<int>(probe % m_size[0]);
+            int y = static_cast<int>((probe / m_size[0]) % m_size[1]);
+            int z = static_cast<int>(probe / (m_size[0] * m_size[1]));
+            XMFLOAT4 average[CoefficientCount] = {};
+            uint32_t count = 0;
+            for (const auto& offset : offsets)
+            {
+                int nx = x + offset[0];
+                int ny = y + offset[1];
+                int nz = z + offset[2];
+                if (nx < 0 || ny < 0 || nz < 0 || nx >= static_cast<int>(m_size[0]) || ny >= static_cast<int>(m_size[1]) ||
+                    nz >= static_cast<int>(m_size[2]))
+                    continue;
+                uint32_t neighbour = (static_cast<uint32_t>(nz) * m_size[1] + ny) * m_size[0] + nx;
+                if (!valid[neighbour])
+                    continue;
+
+                const XMFLOAT4* pNeighbour = &m_probes[static_cast<size_t>(neighbour) * CoefficientCount];
+                for (uint32_t i = 0; i < CoefficientCount; i++)
+                {
+                    average[i].x += pNeighbour[i].x;
+                    average[i].y += pNeighbour[i].y;
+                    average[i].z += pNeighbour[i].z;
+                }
+                count++;
+            }
+            if (count == 0)
+                continue;
+
+            XMFLOAT4* pProbe = &m_probes[static_cast<size_t>(probe) * CoefficientCount];
+            for (uint32_t i = 0; i < CoefficientCount; i++)
+                pProbe[i] = XMFLOAT4(average[i].x / count, average[i].y / count, average[i].z / count, 0.0f);
+            next[probe] = 1;
+            changed = true;
+        }
+        valid = next;
+    }
+
+    // Only possible when no probe at all saw outside geometry
+    for (uint32_t probe = 0; probe < valid.size(); probe++)
+    {
+        if (!valid[probe])
+            std::copy(skySH, skySH + CoefficientCount, &m_probes[static_cast<size_t>(probe) * CoefficientCount]);
+    }
+}
+
+void LightProbeGrid::Interpolate(const XMFLOAT3* pPositions, uint32_t count, XMFLOAT4* pSH) const
+{
+    if (!m_baked)
+        return;
+    InterpolateBatch(pPositions, count, pSH);
+}
+
+void LightProbeGrid::InterpolateParallel(const XMFLOAT3* pPositions, uint32_t count, XMFLOAT4* pSH) const
+{
+    if (!m_baked)
+        return;
+
+    uint32_t chunks = (count + ParallelChunk - 1) / ParallelChunk;
+    if (!m_pPool || chunks < 2)
+    {
+        InterpolateBatch(pPositions, count, pSH);
+        return;
+    }
+    m_pPool->ParallelFor(chunks, [this, pPositions, count, pSH](uint32_t chunk, uint32_t)
+    {
+        uint32_t first = chunk * ParallelChunk;
+        uint32_t chunkCount = std::min(ParallelChunk, count - first);
+        InterpolateBatch(pPositions + first, chunkCount, pSH + static_cast<size_t>(first) * CoefficientCount);
+    });
+}
+
+void LightProbeGrid::InterpolateBatch(const XMFLOAT3* pPositions, uint32_t count, XMFLOAT4* pSH) const
+{
+    const uint32_t strideY = m_size[0];
+    const uint32_t strideZ = m_size[0] * m_size[1];
+    const uint32_t corners[8] = { 0, 1, strideY, strideY + 1, strideZ, strideZ + 1, strideZ + strideY, strideZ + strideY + 1 };
+    const float minimum[3] = { m_settings.boundsMin.x, m_settings.boundsMin.y, m_settings.boundsMin.z };
+
+    for (uint32_t first = 0; first < count; first += BatchSize)
+    {
+        uint32_t batch = std::min(BatchSize, count - first);
+
+        // Cell and fractions of four instances at once, one axis per register
+        alignas(16) float coords[3][4];
+        for (uint32_t lane = 0; lane < BatchSize; lane++)
+        {
+            const XMFLOAT3& position = pPositions[first + (lane < batch ? lane : batch - 1)];
+            coords[0][lane] = position.x;
+            coords[1][lane] = position.y;
+            coords[2][lane] = position.z;
+        }
+
+        alignas(16) int32_t cell[3][4];
+        SwFloat fraction[3];
+        for (int k = 0; k < 3; k++)
+        {
+            SwFloat grid = (SwFloat(_mm_load_ps(coords[k])) - minimum[k]) * m_invSpacing;
+            grid = Min(Max(grid, 0.0f), static_cast<float>(m_size[k] - 1));
+            __m128i index = _mm_cvttps_epi32(Min(grid, static_cast<float>(m_size[k] - 2)).v);
+            _mm_store_si128(reinterpret_cast<__m128i*>(cell[k]), index);
+            fraction[k] = grid - SwFloat(_mm_cvtepi32_ps(index));
+        }
+
+        SwFloat one(1.0f);
+        SwFloat wx[2] = { one - fraction[0], fraction[0] };
+        SwFloat wy[2] = { one - fraction[1], fraction[1] };
+        SwFloat wz[2] = { one - fraction[2], fraction[2] };
+        alignas(16) float weights[8][4];
+        for (int c = 0; c < 8; c++)
+            _mm_store_ps(weights[c], (wx[c & 1] * wy[(c >> 1) & 1] * wz[c >> 2]).v);
+
+        // Blend of the eight probes, one rgb coefficient per register
+        for (uint32_t lane = 0; lane < batch; lane++)
+        {
+            const XMFLOAT4* pBase = &m_probes[(static_cast<size_t>(cell[2][lane]) * strideZ + cell[1][lane] * strideY + cell[0][lane]) * CoefficientCount];
+            __m128 sum[CoefficientCount];
+            for (uint32_t i = 0; i < CoefficientCount; i++)
+                sum[i] = _mm_setzero_ps();
+            for (int c = 0; c < 8; c++)
+            {
+                __m128 weight = _mm_set1_ps(weights[c][lane]);
+                const float* pProbe = &pBase[corners[c] * CoefficientCount].x;
+                for (uint32_t i = 0; i < CoefficientCount; i++)
+                    sum[i] = _mm_add_ps(sum[i], _mm_mul_ps(weight, _mm_loadu_ps(pProbe + i * 4)));
+            }
+            float* pOut = &pSH[static_cast<size_t>(first + lane) * CoefficientCount].x;
+            for (uint32_t i = 0; i < CoefficientCount; i++)
+                _mm_storeu_ps(pOut + i * 4, sum[i]);
+        }
+    }
+}
+
+void LightProbeGrid::InterpolateScalar(const XMFLOAT3& position, XMFLOAT4* pSH) const
+{
+    const float coords[3] = { position.x, position.y, position.z };
+    const float minimum[3] = { m_settings.boundsMin.x, m_settings.boundsMin.y, m_settings.boundsMin.z };
+    uint32_t cell[3];
+    float fraction[3];
+    for (int k = 0; k < 3; k++)
+    {
+        float grid = std::min(std::max((coords[k] - minimum[k]) * m_invSpacing, 0.0f), static_cast<float>(m_size[k] - 1));
+        cell[k] = std::min(static_cast<uint32_t>(grid), m_size[k] - 2);
+        fraction[k] = grid - cell[k];
+    }
+
+    for (uint32_t i = 0; i < CoefficientCount; i++)
+        pSH[i] = XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
+    for (int c = 0; c < 8; c++)
+    {
+        uint32_t x = cell[0] + (c & 1);
+        uint32_t y = cell[1] + ((c >> 1) & 1);
+        uint32_t z = cell[2] + (c >> 2);
+        float weight = ((c & 1) ? fraction[0] : 1.0f - fraction[0]) * ((c & 2) ? fraction[1] : 1.0f - fraction[1]) *
+            ((c & 4) ? fraction[2] : 1.0f - fraction[2]);
+        const XMFLOAT4* pProbe = &m_probes[((static_cast<size_t>(z) * m_size[1] + y) * m_size[0] + x) * CoefficientCount];
+        for (uint32_t i = 0; i < CoefficientCount; i++)
+        {
+            pSH[i].x += pProbe[i].x * weight;
+            pSH[i].y += pProbe[i].y * weight;
+            pSH[i].z += pProbe[i].z * weight;
+        }
+    }
+}
+
+ProbeInterpolationBenchmark LightProbeGrid::Benchmark(uint32_t instanceCount) const
+{
+    ProbeInterpolationBenchmark result = {};
+    result.instances = instanceCount;
+    result.threads = m_pPool ? m_pPool->GetThreadCount() : 1;
+    if (!m_baked || instanceCount == 0)
+        return result;
+
+    // Instances scattered over the grid and a little past its border
+    std::vector<XMFLOAT3> positions(instanceCount);
+    uint32_t seed = 2025;
+    const float minimum[3] = { m_settings.boundsMin.x - 1.0f, m_settings.boundsMin.y - 1.0f, m_settings.boundsMin.z - 1.0f };
+    float extent[3];
+    for (int k = 0; k < 3; k++)
+        extent[k] = (m_size[k] - 1) * m_settings.spacing + 2.0f;
+    for (XMFLOAT3& position : positions)
+    {
+        position.x = minimum[0] + (NextRandom(seed) >> 8) * (1.0f / 16777216.0f) * extent[0];
+        position.y = minimum[1] + (NextRandom(seed) >> 8) * (1.0f / 16777216.0f) * extent[1];
+        position.z = minimum[2] + (NextRandom(seed) >> 8) * (1.0f / 16777216.0f) * extent[2];
+    }
+    std::vector<XMFLOAT4> sh(static_cast<size_t>(instanceCount) * CoefficientCount);
+
+    // The scalar pass also faults in the output pages, so the later passes time only the work
+    uint64_t start = Profiler::NowNs();
+    for (uint32_t i = 0; i < instanceCount; i++)
+        InterpolateScalar(positions[i], &sh[static_cast<size_t>(i) * CoefficientCount]);
+    uint64_t scalarDone = Profiler::NowNs();
+    InterpolateBatch(positions.data(), instanceCount, sh.data());
+    uint64_t simdDone = Profiler::NowNs();
+    InterpolateParallel(positions.data(), instanceCount, sh.data());
+    uint64_t end = Profiler::NowNs();
+
+    result.scalarMs = (scalarDone - start) * 1.0e-6;
+    result.simdMs = (simdDone - scalarDone) * 1.0e-6;
+    result.parallelMs = (end - simdDone) * 1.0e-6;
+    return result;
+}
@@ -0,0 +1,92 @@
+#ifndef LIGHT_PROBE_GRID_H
+#define LIGHT_PROBE_GRID_H
+
+#include <DirectXMath.h>
+#include <cstdint>
+#include <vector>
+
+#include "RayTracer.h"
+
+using namespace DirectX;
+
+class ThreadPool;
+
+struct ProbeGridSettings
+{
+    XMFLOAT3 boundsMin;     // first probe
+    XMFLOAT3 boundsMax;     // the last probe of each axis is at or just past this corner
+    float spacing;
+    uint32_t raysPerProbe;  // rounded up to a multiple of four, one SSE packet per four rays
+};
+
+struct ProbeBakeStats
+{
+    uint32_t probes;
+    uint32_t invalidProbes;     // inside geometry, filled from their neighbours
+    uint64_t rays;
+    uint32_t threads;
+    double seconds;
+};
+
+struct ProbeInterpolationBenchmark
+{
+    uint32_t instances;
+    uint32_t threads;
+    double scalarMs;        // one instance at a time, one coefficient channel at a time
+    double simdMs;          // four instances per batch, one SH coefficient per SSE register
+    double parallelMs;      // SIMD batches spread over the thread pool
+};
+
+// Irradiance probes on a regular 3D grid for the moving cubes. Each probe is baked with
+// RayTracer packets: rays that escape see the sky (the skybox SH of EnvironmentLighting),
+// rays that hit a cube bring back one bounce of the point lights and the sky off its albedo.
+// The radiance is projected onto L2 SH and convolved with the cosine lobe, so the result is
+// irradiance / pi in the units of EnvironmentLighting::GetIrradianceSH and the shaders can
+// use either. At runtime each instance gets the trilinear blend of the eight probes around it.
+class LightProbeGrid
+{
+public:
+    static const uint32_t CoefficientCount = 9;
+    static const uint32_t BatchSize = 4;
+
+    LightProbeGrid() : m_pPool(nullptr), m_settings(), m_invSpacing(0.0f), m_baked(false), m_stats() { m_size[0] = m_size[1] = m_size[2] = 0; }
+
+    bool Init(ThreadPool* pPool);
+    void SetMesh(const SwMeshData& data);
+
+    // skySH: rgb in xyz, as returned by EnvironmentLighting::GetIrradianceSH
+    bool Bake(const std::vector<SwCubeInstance>& cubes, const SwPointLight lights[3], const XMFLOAT4 skySH[CoefficientCount],
+        const ProbeGridSettings& settings);
+    bool IsBaked() const { return m_baked; }
+
+    // Nine rgb coefficients per position, w unused: pSH receives count * CoefficientCount values.
+    // Positions outside the grid use the nearest probes on its border.
+    void Interpolate(const XMFLOAT3* pPositions, uint32_t count, XMFLOAT4* pSH) const;
+    // The same split into batches over the thread pool
+    void InterpolateParallel(const XMFLOAT3* pPositions, uint32_t count, XMFLOAT4* pSH) const;
+
+    ProbeInterpolationBenchmark Benchmark(uint32_t instanceCount) const;
+
+    const ProbeGridSettings& GetSettings() const { return m_settings; }
+    uint32_t GetProbeCount() const { return m_size[0] * m_size[1] * m_size[2]; }
+    const ProbeBakeStats& GetStats() const { return m_stats; }
+
+private:
+    void BakeProbe(uint32_t probe, const SwPointLight lights[3], const XMFLOAT4 skySH[CoefficientCount], uint64_t& rays, bool& valid);
+    void FillInvalidProbes(std::vector<uint8_t>& valid, const XMFLOAT4 skySH[CoefficientCount]);
+    void InterpolateBatch(const XMFLOAT3* pPositions, uint32_t count, XMFLOAT4* pSH) const;
+    void InterpolateScalar(const XMFLOAT3& position, XMFLOAT4* pSH) const;
+
+    ThreadPool* m_pPool;
+    RayTracer m_tracer;
+
+    ProbeGridSettings m_settings;
+    uint32_t m_size[3];
+    float m_invSpacing;
+    // CoefficientCount values per probe, x fastest, then y, then z
+    std::vector<XMFLOAT4> m_probes;
+    bool m_baked;
+    ProbeBakeStats m_stats;
+};
+
+#endif
@@ -0,0 +1,23 @@
+// Light probe irradiance of every cube in ModelBufferInst, blended by LightProbeGrid on the CPU
+
+static const uint MAX_PROBE_INSTANCES = 23;
+
+cbuffer ProbeBuffer : register(b4)
+{
+    float4 probeSettings;       // x: 1 when the coefficients below are filled
+    float4 instanceSH[MAX_PROBE_INSTANCES * 9];
+};
+
+bool LightProbesEnabled()
+{
+    return probeSettings.x > 0.0f;
+}
+
+// Same units as EvaluateAmbientSH
+float3 EvaluateProbeSH(uint instance, float3 n)
+{
+    float4 sh[9];
+    for (uint i = 0; i < 9; i++)
+        sh[i] = instanceSH[instance * 9 + i];
+    return EvaluateSH(sh, n);
+}
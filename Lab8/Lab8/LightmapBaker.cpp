@@ -0,0 +1,440 @@
+#include "LightmapBaker.h"
+#include "Profiler.h"
+#include "ThreadPool.h"
+#include <DirectXPackedVector.h>
+#include <cfloat>
+#include <cmath>
+
+namespace
+{
+    const float RayBias = 1.0e-3f;
+    const uint32_t DxgiFormatR16G16B16A16Float = 10;
+
+    uint32_t Hash(uint32_t x)
+    {
+        x ^= x >> 16;
+        x *= 0x7feb352dU;
+        x ^= x >> 15;
+        x *= 0x846ca68bU;
+        x ^= x >> 16;
+        return x;
+    }
+
+    float ToUnitFloat(uint32_t x)
+    {
+        return (x >> 8) * (1.0f / 16777216.0f);
+    }
+
+    void TransformPoint(const XMFLOAT4X4& m, const float in[3], float out[3])
+    {
+        for (int j = 0; j < 3; j++)
+            out[j] = in[0] * m.m[0][j] + in[1] * m.m[1][j] + in[2] * m.m[2][j] + m.m[3][j];
+    }
+
+    void TransformVector(const XMFLOAT4X4& m, const float in[3], float out[3])
+    {
+        for (int j = 0; j < 3; j++)
+            out[j] = in[0] * m.m[0][j] + in[1] * m.m[1][j] + in[2] * m.m[2][j];
+    }
+
+    void Normalize(float v[3])
+    {
+        float length = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+        if (length > 0.0f)
+        {
+            v[0] /= length;
+            v[1] /= length;
+            v[2] /= length;
+        }
+    }
+
+    // Cosine-weighted direction around n from two uniform numbers, basis after Duff et al. 2017
+    void CosineDirection(const float n[3], float r1, float r2, float out[3])
+    {
+        float sign = n[2] >= 0.0f ? 1.0f : -1.0f;
+        float a = -1.0f / (sign + n[2]);
+        float b = n[0] * n[1] * a;
+        float t[3] = { 1.0f + sign * n[0] * n[0] * a, sign * b, -sign * n[0] };
+        float s[3] = { b, sign + n[1] * n[1] * a, -n[1] };
+
+        float phi = XM_2PI * r1;
+        float radius = sqrtf(r2);
+        float x = radius * cosf(phi);
+        float y = radius * sinf(phi);
+        float z = sqrtf(1.0f - r2 > 0.0f ? 1.0f - r2 : 0.0f);
+        for (int k = 0; k < 3; k++)
+            out[k] = t[k] * x + s[k] * y + n[k] * z;
+    }
+
+    uint32_t LaneCount(const SwFloat& mask)
+    {
+        int bits = _mm_movemask_ps(mask.v);
+        return (bits & 1) + ((bits >> 1) & 1) + ((bits >> 2) & 1) + ((bits >> 3) & 1);
+    }
+}
+
+LightmapBaker::LightmapBaker()
+    : m_pPool(nullptr),
+    m_faces(),
+    m_hasMesh(false),
+    m_lights(),
+    m_settings(),
+    m_pFile(nullptr),
+    m_running(false),
+    m_cancel(false),
+    m_succeeded(false),
+    m_instancesDone(0),
+    m_texelsDone(0),
+    m_rays(0),
+    m_startNs(0),
+    m_endNs(0)
+{
+}
+
+LightmapBaker::~LightmapBaker()
+{
+    Cancel();
+}
+
+bool LightmapBaker::Init(ThreadPool* pPool)
+{
+    m_pPool = pPool;
+    return m_tracer.Init(pPool);
+}
+
+void LightmapBaker::SetMesh(const SwMeshData& data)
+{
+    m_tracer.SetMesh(data);
+
+    // Every face is a parallelogram whose corners carry the uv (0, 0), (1, 0) and (0, 1)
+    m_hasMesh = false;
+    if (data.floatsPerVertex < 8 || data.vertexCount != FaceCount * 4)
+        return;
+
+    for (uint32_t f = 0; f < FaceCount; f++)
+    {
+        const float* pCorners[3] = {};
+        for (uint32_t i = 0; i < 4; i++)
+        {
+            const float* pVertex = data.pVertices + (f * 4 + i) * data.floatsPerVertex;
+            int u = pVertex[6] > 0.5f ? 1 : 0;
+            int v = pVertex[7] > 0.5f ? 1 : 0;
+            if (u + v < 2)
+                pCorners[u + v * 2] = pVertex;
+        }
+        if (!pCorners[0] || !pCorners[1] || !pCorners[2])
+            return;
+
+        Face& face = m_faces[f];
+        for (int k = 0; k < 3; k++)
+        {
+            face.origin[k] = pCorners[0][k];
+            face.axisU[k] = pCorners[1][k] - pCorners[0][k];
+            face.axisV[k] = pCorners[2][k] - pCorners[0][k];
+            face.normal[k] = pCorners[0][3 + k];
+        }
+    }
+    m_hasMesh = true;
+}
+
+bool LightmapBaker::Start(const SwSceneFrame& frame, const LightmapBakeSettings& settings, const char* path)
+{
+    if (!m_hasMesh || m_running.load() || frame.sceneCubes.empty())
+        return false;
+    if (m_thread.joinable())
+        m_thread.join();
+
+#ifdef _MSC_VER
+    if (fopen_s(&m_pFile, path, "wb") != 0)
+        m_pFile = nullptr;
+#else
+    m_pFile = fopen(path, "wb");
+#endif
+    if (!m_pFile)
+        return false;
+
+    m_cubes = frame.sceneCubes;
+    for (int i = 0; i < 3; i++)
+        m_lights[i] = frame.lights[i];
+    m_settings = settings;
+    m_settings.samplesPerTexel = (settings.samplesPerTexel + 3) & ~3u;
+    if (m_settings.samplesPerTexel == 0)
+        m_settings.samplesPerTexel = 4;
+    m_tracer.BuildScene(m_cubes);
+
+    m_cancel = false;
+    m_succeeded = false;
+    m_instancesDone = 0;
+    m_texelsDone = 0;
+    m_rays = 0;
+    m_startNs = Profiler::NowNs();
+    m_endNs = 0;
+    m_running = true;
+    m_thread = std::thread(&LightmapBaker::BakeAll, this);
+    return true;
+}
+
+void LightmapBaker::Cancel()
+{
+    m_cancel = true;
+    if (m_thread.joinable())
+        m_thread.join();
+}
+
+bool LightmapBaker::PollFinished()
+{
+    if (m_running.load() || !m_thread.joinable())
+        return false;
+    m_thread.join();
+    return m_succeeded.load();
+}
+
+LightmapBakeStats LightmapBaker::GetStats() const
+{
+    LightmapBakeStats stats = {};
+    stats.instances = static_cast<uint32_t>(m_cubes.size());
+    stats.instancesDone = m_instancesDone.load();
+    stats.texels = static_cast<uint64_t>(stats.instances) * FaceCount * FaceSize * FaceSize;
+    stats.texelsDone = m_texelsDone.load();
+    stats.rays = m_rays.load();
+    stats.threads = m_pPool ? m_pPool->GetThreadCount() : 1;
+
+    uint64_t start = m_startNs.load();
+    uint64_t end = m_endNs.load();
+    if (start == 0)
+        return stats;
+    if (end == 0)
+        end = Profiler::NowNs();
+    stats.seconds = (end - start) * 1.0e-9;
+    if (stats.seconds > 0.0)
+    {
+        stats.raysPerSecond = stats.rays / stats.seconds;
+        stats.texelsPerSecond = stats.texelsDone / stats.seconds;
+    }
+    return stats;
+}
+
+void LightmapBaker::BakeAll()
+{
+    Profiler::Get().SetThreadName("Lightmap Baker");
+    // Workers finish the row they are on and move to the frame's own ParallelFor first
+    ThreadPool::SetThreadPriority(ThreadPool::Priority::Background);
+
+    bool ok = WriteHeader(static_cast<uint32_t>(m_cubes.size()));
+    m_slice.assign(static_cast<size_t>(AtlasWidth) * AtlasHeight * 4, 0.0f);
+    for (uint32_t instance = 0; instance < m_cubes.size() && ok && !m_cancel.load(); instance++)
+    {
+        PROFILE_SCOPE("Bake Cube");
+
+        // One face per ParallelFor keeps the progress and the cancel check fine grained
+        for (uint32_t face = 0; face < FaceCount && !m_cancel.load(); face++)
+        {
+            auto task = [this, instance, face](uint32_t row, uint32_t)
+            {
+                BakeRow(instance, face, row);
+            };
+            if (m_pPool)
+                m_pPool->ParallelFor(FaceSize, task);
+            else
+            {
+                for (uint32_t row = 0; row < FaceSize; row++)
+                    task(row, 0);
+            }
+        }
+
+        if (!m_cancel.load())
+        {
+            ok = WriteSlice();
+            m_instancesDone++;
+        }
+    }
+
+    fclose(m_pFile);
+    m_pFile = nullptr;
+    m_succeeded = ok && !m_cancel.load();
+    m_endNs = Profiler::NowNs();
+    m_running = false;
+}
+
+void LightmapBaker::BakeRow(uint32_t instance, uint32_t faceIndex, uint32_t row)
+{
+    const XMFLOAT4X4& model = m_cubes[instance].model;
+    const Face& face = m_faces[faceIndex];
+    float origin[3];
+    float axisU[3];
+    float axisV[3];
+    float normal[3];
+    TransformPoint(model, face.origin, origin);
+    TransformVector(model, face.axisU, axisU);
+    TransformVector(model, face.axisV, axisV);
+    TransformVector(model, face.normal, normal);
+    Normalize(normal);
+
+    const uint32_t samples = m_settings.samplesPerTexel;
+    const SwFloat allLanes = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    uint64_t rays = 0;
+
+    for (uint32_t x = 0; x < FaceSize; x++)
+    {
+        uint32_t texelSeed = Hash((instance * FaceCount + faceIndex) * FaceSize * FaceSize + row * FaceSize + x);
+        SwFloat3 sum(0.0f, 0.0f, 0.0f);
+
+        for (uint32_t s = 0; s < samples; s += 4)
+        {
+            // Four paths start from jittered points of the texel
+            alignas(16) float position[3][4];
+            alignas(16) float surfaceNormal[3][4];
+            for (int lane = 0; lane < 4; lane++)
+            {
+                uint32_t seed = Hash(texelSeed + s + lane);
+                float u = (x + ToUnitFloat(seed)) / FaceSize;
+                float v = (row + ToUnitFloat(Hash(seed))) / FaceSize;
+                for (int k = 0; k < 3; k++)
+                {
+                    position[k][lane] = origin[k] + axisU[k] * u + axisV[k] * v;
+                    surfaceNormal[k][lane] = normal[k];
+                }
+            }
+
+            SwFloat3 pos(_mm_load_ps(position[0]), _mm_load_ps(position[1]), _mm_load_ps(position[2]));
+            SwFloat3 n(_mm_load_ps(surfaceNormal[0]), _mm_load_ps(surfaceNormal[1]), _mm_load_ps(surfaceNormal[2]));
+            SwFloat3 radiance = DirectLight(pos, n, allLanes, rays);
+            SwFloat3 throughput(1.0f, 1.0f, 1.0f);
+            SwFloat active = allLanes;
+
+            for (uint32_t bounce = 0; bounce < m_settings.bounces; bounce++)
+            {
+                alignas(16) float direction[3][4];
+                for (int lane = 0; lane < 4; lane++)
+                {
+                    uint32_t seed = Hash(texelSeed ^ Hash((s + lane) * 16 + bounce + 1));
+                    float laneNormal[3] = { surfaceNormal[0][lane], surfaceNormal[1][lane], surfaceNormal[2][lane] };
+                    float laneDirection[3];
+                    CosineDirection(laneNormal, ToUnitFloat(seed), ToUnitFloat(Hash(seed)), laneDirection);
+                    for (int k = 0; k < 3; k++)
+                        direction[k][lane] = laneDirection[k];
+                }
+
+                RtRayPacket packet;
+                packet.direction = SwFloat3(_mm_load_ps(direction[0]), _mm_load_ps(direction[1]), _mm_load_ps(direction[2]));
+                packet.origin = pos + n * SwFloat(RayBias);
+                packet.tMax = Select(active, FLT_MAX, 0.0f);
+                RtHitPacket hit;
+                m_tracer.Intersect(packet, hit);
+                rays += LaneCount(active);
+
+                RtSurface surfaces[4];
+                alignas(16) float albedo[3][4] = {};
+                alignas(16) uint32_t hitMask[4] = {};
+                m_tracer.GetSurfaces(hit, surfaces);
+                for (int lane = 0; lane < 4; lane++)
+                {
+                    if (hit.triangle[lane] == RtNoHit)
+                        continue;
+
+                    // Cubes are closed, but keep the normal on the side the path arrived from
+                    const RtSurface& surface = surfaces[lane];
+                    float facing = surface.normal[0] * direction[0][lane] + surface.normal[1] * direction[1][lane] +
+                        surface.normal[2] * direction[2][lane];
+                    float side = facing > 0.0f ? -1.0f : 1.0f;
+                    for (int k = 0; k < 3; k++)
+                    {
+                        position[k][lane] = surface.position[k];
+                        surfaceNormal[k][lane] = surface.normal[k] * side;
+                        albedo[k][lane] = surface.albedo[k];
+                    }
+                    hitMask[lane] = 0xFFFFFFFFu;
+                }
+
+                active = _mm_castsi128_ps(_mm_load_si128(reinterpret_cast<const __m128i*>(hitMask)));
+                if (_mm_movemask_ps(active.v) == 0)
+                    break;
+
+                pos = SwFloat3(_mm_load_ps(position[0]), _mm_load_ps(position[1]), _mm_load_ps(position[2]));
+                n = SwFloat3(_mm_load_ps(surfaceNormal[0]), _mm_load_ps(surfaceNormal[1]), _mm_load_ps(surfaceNormal[2]));
+                SwFloat3 surfaceAlbedo(_mm_load_ps(albedo[0]), _mm_load_ps(albedo[1]), _mm_load_ps(albedo[2]));
+                throughput = throughput * surfaceAlbedo;
+                radiance = radiance + throughput * DirectLight(pos, n, active, rays);
+            }
+
+            sum = sum + radiance;
+        }
+
+        // Texel of the face in the cube's 3x2 atlas
+        uint32_t atlasX = (faceIndex % 3) * FaceSize + x;
+        uint32_t atlasY = (faceIndex / 3) * FaceSize + row;
+        float* pTexel = &m_slice[(static_cast<size_t>(atlasY) * AtlasWidth + atlasX) * 4];
+        float scale = 1.0f / samples;
+        pTexel[0] = (sum.x[0] + sum.x[1] + sum.x[2] + sum.x[3]) * scale;
+        pTexel[1] = (sum.y[0] + sum.y[1] + sum.y[2] + sum.y[3]) * scale;
+        pTexel[2] = (sum.z[0] + sum.z[1] + sum.z[2] + sum.z[3]) * scale;
+        pTexel[3] = 1.0f;
+    }
+
+    m_texelsDone += FaceSize;
+    m_rays += rays;
+}
+
+SwFloat3 LightmapBaker::DirectLight(const SwFloat3& position, const SwFloat3& normal, const SwFloat& mask, uint64_t& rays) const
+{
+    SwFloat3 result(0.0f, 0.0f, 0.0f);
+    SwFloat3 shadowOrigin = position + normal * SwFloat(RayBias);
+
+    for (int i = 0; i < 3; i++)
+    {
+        // Diffuse term of ColorPixel.ps, the specular part depends on the viewer and stays dynamic
+        const SwPointLight& light = m_lights[i];
+        SwFloat3 lightPos(light.position.x, light.position.y, light.position.z);
+        SwFloat3 toLight = lightPos - position;
+        SwFloat distance = Length(toLight);
+        SwFloat3 lightDir = toLight * (SwFloat(1.0f) / distance);
+        SwFloat attenuation = SwFloat(1.0f) - Saturate(distance * (1.0f / light.range));
+        SwFloat scale = Max(Dot(normal, lightDir), 0.0f) * attenuation * light.intensity;
+
+        SwFloat lit = _mm_and_ps(mask.v, _mm_cmpgt_ps(scale.v, _mm_setzero_ps()));
+        if (_mm_movemask_ps(lit.v) == 0)
+            continue;
+
+        RtRayPacket shadow;
+        shadow.origin = shadowOrigin;
+        shadow.direction = lightDir;
+        shadow.tMax = Select(lit, distance - RayBias, 0.0f);
+        SwFloat visible = _mm_andnot_ps(m_tracer.Occluded(shadow).v, lit.v);
+        rays += LaneCount(lit);
+
+        scale = _mm_and_ps(visible.v, scale.v);
+        result = result + SwFloat3(light.color.x, light.color.y, light.color.z) * scale;
+    }
+    return result;
+}
+
+bool LightmapBaker::WriteHeader(uint32_t sliceCount)
+{
+    // DDS_HEADER with a DX10 extension: one mip, RGBA16F, sliceCount array slices
+    uint32_t header[37] = {};
+    header[0] = 0x20534444;                 // "DDS "
+    header[1] = 124;
+    header[2] = 0x1 | 0x2 | 0x4 | 0x8 | 0x1000;  // caps, height, width, pitch, pixel format
+    header[3] = AtlasHeight;
+    header[4] = AtlasWidth;
+    header[5] = AtlasWidth * 8;
+    header[7] = 1;
+    header[19] = 32;
+    header[20] = 0x4;                       // DDPF_FOURCC
+    header[21] = 0x30315844;                // "DX10"
+    header[27] = 0x1000;                    // DDSCAPS_TEXTURE
+    header[32] = DxgiFormatR16G16B16A16Float;
+    header[33] = 3;                         // D3D10_RESOURCE_DIMENSION_TEXTURE2D
+    header[35] = sliceCount;
+    return fwrite(header, sizeof(header), 1, m_pFile) == 1;
+}
+
+bool LightmapBaker::WriteSlice()
+{
+    std::vector<PackedVector::HALF> halves(m_slice.size());
+    for (size_t i = 0; i < m_slice.size(); i++)
+        halves[i] = PackedVector::XMConvertFloatToHalf(m_slice[i]);
+    bool ok = fwrite(halves.data(), sizeof(PackedVector::HALF), halves.size(), m_pFile) == halves.size();
+    // Finished slices reach the disk right away instead of piling up until the end
+    return ok && fflush(m_pFile) == 0;
+}
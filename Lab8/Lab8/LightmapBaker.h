@@ -0,0 +1,101 @@
+#ifndef LIGHTMAP_BAKER_H
+#define LIGHTMAP_BAKER_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "RayTracer.h"
+
+struct LightmapBakeSettings
+{
+    uint32_t samplesPerTexel;   // rounded up to a multiple of four, one SSE packet per four paths
+    uint32_t bounces;           // indirect bounces after the first hit, 0 bakes direct light only
+};
+
+struct LightmapBakeStats
+{
+    uint32_t instances;
+    uint32_t instancesDone;
+    uint64_t texels;
+    uint64_t texelsDone;
+    uint64_t rays;              // path and shadow rays so far
+    uint32_t threads;
+    double seconds;
+    double raysPerSecond;
+    double texelsPerSecond;
+};
+
+// Offline baker for the static cubes. Every texel of a cube face is path traced against the
+// scene with RayTracer packets: direct light from the point lights with shadow rays plus
+// cosine-weighted indirect bounces. The result is diffuse lighting in ColorPixel.ps units,
+// so a surface shows albedo * lightmap. Each cube gets one slice of an RGBA16F DDS array
+// with its six faces in a 3x2 atlas, face f at column f % 3 and row f / 3.
+// Baking runs on a background thread that feeds the thread pool one face at a time, so
+// frames keep going while it works; slices are appended to the file as they finish.
+class LightmapBaker
+{
+public:
+    static const uint32_t FaceSize = 16;
+    static const uint32_t AtlasWidth = FaceSize * 3;
+    static const uint32_t AtlasHeight = FaceSize * 2;
+    static const uint32_t FaceCount = 6;
+
+    LightmapBaker();
+    ~LightmapBaker();
+
+    bool Init(ThreadPool* pPool);
+    // Cube mesh with four vertices per face, faces in vertex order as in the vertex buffer
+    void SetMesh(const SwMeshData& data);
+
+    // Bakes frame.sceneCubes lit by frame.lights into path; slice i belongs to cube i
+    bool Start(const SwSceneFrame& frame, const LightmapBakeSettings& settings, const char* path);
+    void Cancel();
+    bool IsRunning() const { return m_running.load(); }
+    // True once for every bake that wrote its whole file, after it finished
+    bool PollFinished();
+
+    // Safe to call while a bake runs
+    LightmapBakeStats GetStats() const;
+
+private:
+    struct Face
+    {
+        float origin[3];    // object space position of uv (0, 0)
+        float axisU[3];
+        float axisV[3];
+        float normal[3];
+    };
+
+    void BakeAll();
+    void BakeRow(uint32_t instance, uint32_t face, uint32_t row);
+    SwFloat3 DirectLight(const SwFloat3& position, const SwFloat3& normal, const SwFloat& mask, uint64_t& rays) const;
+    bool WriteHeader(uint32_t sliceCount);
+    bool WriteSlice();
+
+    ThreadPool* m_pPool;
+    RayTracer m_tracer;
+    Face m_faces[FaceCount];
+    bool m_hasMesh;
+
+    // Copy of the scene being baked, owned by the bake thread while it runs
+    std::vector<SwCubeInstance> m_cubes;
+    SwPointLight m_lights[3];
+    LightmapBakeSettings m_settings;
+    FILE* m_pFile;
+    std::vector<float> m_slice;     // RGBA of the cube in progress
+
+    std::thread m_thread;
+    std::atomic<bool> m_running;
+    std::atomic<bool> m_cancel;
+    std::atomic<bool> m_succeeded;
+    std::atomic<uint32_t> m_instancesDone;
+    std::atomic<uint64_t> m_texelsDone;
+    std::atomic<uint64_t> m_rays;
+    std::atomic<uint64_t> m_startNs;
+    std::atomic<uint64_t> m_endNs;
+};
+
+#endif
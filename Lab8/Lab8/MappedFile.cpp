@@ -0,0 +1,143 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <vector>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+    : m_pData(nullptr)
+    , m_size(0)
+    , m_error(0)
+{
+}
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const char* path)
+{
+    int length = MultiByteToWideChar(CP_UTF8, 0, path, -1, nullptr, 0);
+    if (length <= 0)
+    {
+        Close();
+        m_error = GetLastError();
+        return false;
+    }
+    std::vector<wchar_t> widePath(length);
+    MultiByteToWideChar(CP_UTF8, 0, path, -1, widePath.data(), length);
+    return Open(widePath.data());
+}
+
+bool MappedFile::Open(const wchar_t* path)
+{
+    Close();
+    HANDLE hFile = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (hFile == INVALID_HANDLE_VALUE)
+    {
+        m_error = GetLastError();
+        return false;
+    }
+
+    LARGE_INTEGER size = {};
+    if (!GetFileSizeEx(hFile, &size))
+    {
+        m_error = GetLastError();
+        CloseHandle(hFile);
+        return false;
+    }
+    // Empty files cannot be mapped, files past the address space neither
+    if (size.QuadPart <= 0 || static_cast<uint64_t>(size.QuadPart) > SIZE_MAX)
+    {
+        m_error = size.QuadPart <= 0 ? ERROR_FILE_INVALID : ERROR_FILE_TOO_LARGE;
+        CloseHandle(hFile);
+        return false;
+    }
+
+    // The view keeps the section and the file open by itself
+    HANDLE hMapping = CreateFileMappingW(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    m_error = hMapping ? 0 : GetLastError();
+    CloseHandle(hFile);
+    if (!hMapping)
+        return false;
+
+    void* pView = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+    m_error = pView ? 0 : GetLastError();
+    CloseHandle(hMapping);
+    if (!pView)
+        return false;
+
+    m_pData = static_cast<const uint8_t*>(pView);
+    m_size = static_cast<size_t>(size.QuadPart);
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (m_pData)
+        UnmapViewOfFile(m_pData);
+    m_pData = nullptr;
+    m_size = 0;
+}
+
+#else
+
+bool MappedFile::Open(const char* path)
+{
+    Close();
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        m_error = errno;
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0)
+    {
+        m_error = errno;
+        close(fd);
+        return false;
+    }
+    if (info.st_size <= 0 || static_cast<uint64_t>(info.st_size) > SIZE_MAX)
+    {
+        m_error = info.st_size <= 0 ? EINVAL : EFBIG;
+        close(fd);
+        return false;
+    }
+
+    // The mapping keeps the file referenced after the descriptor is closed
+    size_t size = static_cast<size_t>(info.st_size);
+    void* pView = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    m_error = pView != MAP_FAILED ? 0 : errno;
+    close(fd);
+    if (pView == MAP_FAILED)
+        return false;
+
+    // Loaders walk the mips front to back, let the kernel read ahead
+    madvise(pView, size, MADV_SEQUENTIAL);
+    m_pData = static_cast<const uint8_t*>(pView);
+    m_size = size;
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (m_pData)
+        munmap(const_cast<uint8_t*>(m_pData), m_size);
+    m_pData = nullptr;
+    m_size = 0;
+}
+
+#endif
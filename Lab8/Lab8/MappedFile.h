@@ -0,0 +1,38 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Read-only view of a whole file, CreateFileMapping/MapViewOfFile on Windows and mmap
+// elsewhere. The pages come from the file cache on first touch and are never copied into
+// private memory, so pointers into the view can go straight to whatever consumes the data.
+// The view stays valid until Close or destruction.
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // path is UTF-8
+    bool Open(const char* path);
+#ifdef _WIN32
+    bool Open(const wchar_t* path);
+#endif
+    void Close();
+
+    bool IsOpen() const { return m_pData != nullptr; }
+    const uint8_t* GetData() const { return m_pData; }
+    size_t GetSize() const { return m_size; }
+    // Why the last Open failed: GetLastError() on Windows, errno elsewhere
+    uint32_t GetError() const { return m_error; }
+
+private:
+    const uint8_t* m_pData;
+    size_t m_size;
+    uint32_t m_error;
+};
+
+#endif
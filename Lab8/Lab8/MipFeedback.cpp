@@ -0,0 +1,361 @@
+#include "MipFeedback.h"
+#include "Profiler.h"
+#include "SoftwareRasterizer.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace
+{
+    float Dot3(const XMFLOAT3& a, const XMFLOAT3& b)
+    {
+        return a.x * b.x + a.y * b.y + a.z * b.z;
+    }
+
+    XMFLOAT3 Cross3(const XMFLOAT3& a, const XMFLOAT3& b)
+    {
+        return XMFLOAT3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+    }
+
+    XMFLOAT3 Normalize3(const XMFLOAT3& a)
+    {
+        float invLength = 1.0f / sqrtf(Dot3(a, a));
+        return XMFLOAT3(a.x * invLength, a.y * invLength, a.z * invLength);
+    }
+
+    // a + b * s
+    XMFLOAT3 MulAdd3(const XMFLOAT3& a, const XMFLOAT3& b, float s)
+    {
+        return XMFLOAT3(a.x + b.x * s, a.y + b.y * s, a.z + b.z * s);
+    }
+
+    // Row vector times the rotation part of a rigid view matrix
+    XMFLOAT3 Rotate(const XMFLOAT3& v, const XMFLOAT4X4& m)
+    {
+        return XMFLOAT3(
+            v.x * m._11 + v.y * m._21 + v.z * m._31,
+            v.x * m._12 + v.y * m._22 + v.z * m._32,
+            v.x * m._13 + v.y * m._23 + v.z * m._33);
+    }
+}
+
+MipFeedback::MipFeedback()
+    : m_view(
+        1.0f, 0.0f, 0.0f, 0.0f,
+        0.0f, 1.0f, 0.0f, 0.0f,
+        0.0f, 0.0f, 1.0f, 0.0f,
+        0.0f, 0.0f, 0.0f, 1.0f),
+    m_pixelScale(1.0f),
+    m_tanX(1.0f),
+    m_tanY(1.0f),
+    m_nearZ(0.1f),
+    m_stats()
+{
+}
+
+void MipFeedback::SetCamera(const XMFLOAT4X4& view, const XMFLOAT4X4& proj, float viewportHeight)
+{
+    m_view = view;
+
+    // Planes and slopes of XMMatrixPerspectiveFovLH
+    m_pixelScale = proj._22 * viewportHeight * 0.5f;
+    m_tanX = 1.0f / proj._11;
+    m_tanY = 1.0f / proj._22;
+    m_nearZ = -proj._43 / proj._33;
+}
+
+void MipFeedback::Build(const MipFeedbackInstance* pInstances, uint32_t count, uint32_t keyCount)
+{
+    uint64_t start = Profiler::NowNs();
+
+    m_uvPerPixel.resize(count);
+    EstimateSimd(pInstances, count, m_uvPerPixel.data());
+
+    m_keys.assign(keyCount, FLT_MAX);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint32_t key = pInstances[i].key;
+        if (key < keyCount)
+            m_keys[key] = std::min(m_keys[key], m_uvPerPixel[i]);
+    }
+
+    m_stats.instanceCount = count;
+    m_stats.keyCount = keyCount;
+    m_stats.visibleKeys = static_cast<uint32_t>(std::count_if(m_keys.begin(), m_keys.end(), [](float uv) { return uv < FLT_MAX; }));
+    m_stats.buildMs = (Profiler::NowNs() - start) * 1.0e-6;
+}
+
+float MipFeedback::GetUvPerPixel(uint32_t key) const
+{
+    return key < m_keys.size() ? m_keys[key] : FLT_MAX;
+}
+
+uint32_t MipFeedback::RequiredMip(float uvPerPixel, uint32_t width, uint32_t height, uint32_t mipCount)
+{
+    if (uvPerPixel >= FLT_MAX || mipCount == 0)
+        return mipCount;
+
+    // Hardware picks floor(log2(texels per pixel)) as the finer mip of the trilinear pair
+    float texelsPerPixel = uvPerPixel * static_cast<float>(std::max(width, height));
+    if (!(texelsPerPixel >= 2.0f))
+        return 0;
+    int exponent = 0;
+    std::frexp(texelsPerPixel, &exponent);
+    return std::min(static_cast<uint32_t>(exponent - 1), mipCount - 1);
+}
+
+void MipFeedback::EstimateScalar(const MipFeedbackInstance* pInstances, uint32_t count, float* pUvPerPixel) const
+{
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const MipFeedbackInstance& instance = pInstances[i];
+        const XMFLOAT3& c = instance.center;
+        float x = c.x * m_view._11 + c.y * m_view._21 + c.z * m_view._31 + m_view._41;
+        float y = c.x * m_view._12 + c.y * m_view._22 + c.z * m_view._32 + m_view._42;
+        float z = c.x * m_view._13 + c.y * m_view._23 + c.z * m_view._33 + m_view._43;
+        if (z + instance.radius < m_nearZ)
+        {
+            pUvPerPixel[i] = FLT_MAX;
+            continue;
+        }
+
+        // Every point of the sphere is at least this deep and at most this far off the axis
+        float depth = std::max(z - instance.radius, m_nearZ);
+        float tanX = std::min((fabsf(x) + instance.radius) / depth, m_tanX);
+        float tanY = std::min((fabsf(y) + instance.radius) / depth, m_tanY);
+        float stretch = sqrtf(1.0f + tanX * tanX + tanY * tanY);
+        pUvPerPixel[i] = instance.uvDensity * depth / (m_pixelScale * stretch);
+    }
+}
+
+void MipFeedback::EstimateSimd(const MipFeedbackInstance* pInstances, uint32_t count, float* pUvPerPixel) const
+{
+    const SwFloat m11(m_view._11), m21(m_view._21), m31(m_view._31), m41(m_view._41);
+    const SwFloat m12(m_view._12), m22(m_view._22), m32(m_view._32), m42(m_view._42);
+    const SwFloat m13(m_view._13), m23(m_view._23), m33(m_view._33), m43(m_view._43);
+    const SwFloat nearZ(m_nearZ);
+    const SwFloat frustumX(m_tanX);
+    const SwFloat frustumY(m_tanY);
+    const SwFloat pixelScale(m_pixelScale);
+    const SwFloat one(1.0f);
+    const SwFloat hidden(FLT_MAX);
+
+    for (uint32_t i = 0; i < count; i += 4)
+    {
+        // AoS to SoA, the last lanes repeat the last instance
+        alignas(16) float cx[4], cy[4], cz[4], radii[4], densities[4];
+        for (uint32_t lane = 0; lane < 4; lane++)
+        {
+            const MipFeedbackInstance& instance = pInstances[std::min(i + lane, count - 1)];
+            cx[lane] = instance.center.x;
+            cy[lane] = instance.center.y;
+            cz[lane] = instance.center.z;
+            radii[lane] = instance.radius;
+            densities[lane] = instance.uvDensity;
+        }
+        SwFloat px = _mm_load_ps(cx);
+        SwFloat py = _mm_load_ps(cy);
+        SwFloat pz = _mm_load_ps(cz);
+        SwFloat radius = _mm_load_ps(radii);
+
+        SwFloat x = px * m11 + py * m21 + pz * m31 + m41;
+        SwFloat y = px * m12 + py * m22 + pz * m32 + m42;
+        SwFloat z = px * m13 + py * m23 + pz * m33 + m43;
+
+        SwFloat depth = Max(z - radius, nearZ);
+        SwFloat tanX = Min((Abs(x) + radius) / depth, frustumX);
+        SwFloat tanY = Min((Abs(y) + radius) / depth, frustumY);
+        SwFloat stretch = Sqrt(one + tanX * tanX + tanY * tanY);
+        SwFloat uvPerPixel = SwFloat(_mm_load_ps(densities)) * depth / (pixelScale * stretch);
+        SwFloat behind = _mm_cmplt_ps((z + radius).v, nearZ.v);
+
+        alignas(16) float lanes[4];
+        _mm_store_ps(lanes, Select(behind, hidden, uvPerPixel).v);
+        for (uint32_t lane = 0; lane < 4 && i + lane < count; lane++)
+            pUvPerPixel[i + lane] = lanes[lane];
+    }
+}
+
+MipFeedbackValidationResult MipFeedback::Validate(uint32_t scenes, uint32_t instancesPerScene, uint32_t textureSize,
+    uint32_t timingInstances)
+{
+    MipFeedbackValidationResult result = {};
+    result.scenes = scenes;
+
+    uint32_t seed = 4242;
+    auto next = [&seed]()
+    {
+        seed = seed * 1664525u + 1013904223u;
+        return (seed >> 8) * (1.0f / 16777216.0f);
+    };
+    auto randomDirection = [&next]()
+    {
+        XMFLOAT3 direction;
+        do
+        {
+            direction = XMFLOAT3(next() * 2.0f - 1.0f, next() * 2.0f - 1.0f, next() * 2.0f - 1.0f);
+        } while (Dot3(direction, direction) < 0.01f || Dot3(direction, direction) > 1.0f);
+        return Normalize3(direction);
+    };
+    auto randomBasis = [&randomDirection](XMFLOAT3* pAxes)
+    {
+        pAxes[2] = randomDirection();
+        XMFLOAT3 reference = fabsf(pAxes[2].y) < 0.99f ? XMFLOAT3(0.0f, 1.0f, 0.0f) : XMFLOAT3(1.0f, 0.0f, 0.0f);
+        pAxes[0] = Normalize3(Cross3(reference, pAxes[2]));
+        pAxes[1] = Cross3(pAxes[2], pAxes[0]);
+    };
+
+    uint32_t mipCount = 1;
+    while ((textureSize >> mipCount) > 0)
+        mipCount++;
+    const uint32_t grid = 9;
+    const float nearZ = 0.1f;
+    const float farZ = 100.0f;
+
+    uint64_t excessSum = 0;
+    for (uint32_t scene = 0; scene < scenes; scene++)
+    {
+        // Camera anywhere, looking anywhere, as XMMatrixLookToLH and XMMatrixPerspectiveFovLH build it
+        float yScale = 1.0f / tanf((XM_PIDIV4 + next() * XM_PIDIV4) * 0.5f);
+        float aspect = 1.0f + next();
+        float height = 480.0f + next() * 960.0f;
+        XMFLOAT3 eye(next() * 20.0f - 10.0f, next() * 10.0f - 5.0f, next() * 20.0f - 10.0f);
+        XMFLOAT3 camera[3];
+        randomBasis(camera);
+        XMFLOAT4X4 view(
+            camera[0].x, camera[1].x, camera[2].x, 0.0f,
+            camera[0].y, camera[1].y, camera[2].y, 0.0f,
+            camera[0].z, camera[1].z, camera[2].z, 0.0f,
+            -Dot3(camera[0], eye), -Dot3(camera[1], eye), -Dot3(camera[2], eye), 1.0f);
+        XMFLOAT4X4 proj(
+            yScale / aspect, 0.0f, 0.0f, 0.0f,
+            0.0f, yScale, 0.0f, 0.0f,
+            0.0f, 0.0f, farZ / (farZ - nearZ), 1.0f,
+            0.0f, 0.0f, -nearZ * farZ / (farZ - nearZ), 0.0f);
+
+        MipFeedback feedback;
+        feedback.SetCamera(view, proj, height);
+
+        for (uint32_t i = 0; i < instancesPerScene; i++)
+        {
+            // A cube of RenderClass, scaled and turned at random, somewhere in the frustum.
+            // Texture coordinates run 0..1 over an edge of 2 local units.
+            float depth = 0.3f + next() * next() * 40.0f;
+            XMFLOAT3 center = MulAdd3(MulAdd3(MulAdd3(eye,
+                camera[0], (next() * 2.0f - 1.0f) * depth * feedback.m_tanX),
+                camera[1], (next() * 2.0f - 1.0f) * depth * feedback.m_tanY),
+                camera[2], depth);
+            float scale = 0.1f + next() * 1.5f;
+            XMFLOAT3 axes[3];
+            randomBasis(axes);
+
+            MipFeedbackInstance instance;
+            instance.center = center;
+            instance.radius = scale * 1.7320508f;
+            instance.uvDensity = 0.5f / scale;
+            instance.key = 0;
+            float uvPerPixel = 0.0f;
+            feedback.EstimateScalar(&instance, 1, &uvPerPixel);
+            uint32_t estimate = RequiredMip(uvPerPixel, textureSize, textureSize, mipCount);
+
+            // The mip the exact derivatives pick at points of the visible faces
+            uint32_t truth = mipCount;
+            XMFLOAT3 viewCenter = Rotate(XMFLOAT3(center.x - eye.x, center.y - eye.y, center.z - eye.z), view);
+            for (uint32_t face = 0; face < 6; face++)
+            {
+                float side = (face & 1) ? -1.0f : 1.0f;
+                XMFLOAT3 normal = Rotate(axes[face / 2], view);
+                XMFLOAT3 du = Rotate(axes[(face / 2 + 1) % 3], view);
+                XMFLOAT3 dv = Rotate(axes[(face / 2 + 2) % 3], view);
+                normal = XMFLOAT3(normal.x * side, normal.y * side, normal.z * side);
+                for (uint32_t row = 0; row < grid; row++)
+                {
+                    for (uint32_t column = 0; column < grid; column++)
+                    {
+                        float s = column * 2.0f / (grid - 1) - 1.0f;
+                        float t = row * 2.0f / (grid - 1) - 1.0f;
+                        XMFLOAT3 p = MulAdd3(MulAdd3(MulAdd3(viewCenter, normal, scale), du, s * scale), dv, t * scale);
+
+                        // Front facing, in front of the near plane and on screen
+                        if (p.z < nearZ || Dot3(normal, p) >= 0.0f ||
+                            fabsf(p.x / p.z) > feedback.m_tanX || fabsf(p.y / p.z) > feedback.m_tanY)
+                        {
+                            continue;
+                        }
+
+                        // Pixels per texture coordinate unit, d(screen) / d(uv), inverted to d(uv) / d(screen)
+                        float k = feedback.m_pixelScale * 2.0f * scale / p.z;
+                        float a = k * (du.x - p.x * du.z / p.z);
+                        float b = k * (dv.x - p.x * dv.z / p.z);
+                        float c = k * (du.y - p.y * du.z / p.z);
+                        float d = k * (dv.y - p.y * dv.z / p.z);
+                        float determinant = a * d - b * c;
+                        if (fabsf(determinant) < 1.0e-12f)
+                            continue;
+                        float dudx = d / determinant, dvdx = -c / determinant;
+                        float dudy = -b / determinant, dvdy = a / determinant;
+                        float rho = std::max(sqrtf(dudx * dudx + dvdx * dvdx), sqrtf(dudy * dudy + dvdy * dvdy));
+                        truth = std::min(truth, RequiredMip(rho, textureSize, textureSize, mipCount));
+                        result.samples++;
+                    }
+                }
+            }
+            if (truth == mipCount)
+                continue;
+
+            result.instances++;
+            if (estimate > truth)
+                result.coarser++;
+            else if (estimate == truth)
+                result.exact++;
+            uint32_t excess = truth > estimate ? truth - estimate : 0;
+            excessSum += excess;
+            result.maxExcess = std::max(result.maxExcess, excess);
+        }
+    }
+    result.meanExcess = result.instances > 0 ? static_cast<double>(excessSum) / result.instances : 0.0;
+
+    // Timing: a crowd around a camera at the origin looking down +z, both paths over the same list
+    float yScale = 1.0f;
+    MipFeedback feedback;
+    feedback.SetCamera(
+        XMFLOAT4X4(
+            1.0f, 0.0f, 0.0f, 0.0f,
+            0.0f, 1.0f, 0.0f, 0.0f,
+            0.0f, 0.0f, 1.0f, 0.0f,
+            0.0f, 0.0f, 0.0f, 1.0f),
+        XMFLOAT4X4(
+            yScale * 9.0f / 16.0f, 0.0f, 0.0f, 0.0f,
+            0.0f, yScale, 0.0f, 0.0f,
+            0.0f, 0.0f, farZ / (farZ - nearZ), 1.0f,
+            0.0f, 0.0f, -nearZ * farZ / (farZ - nearZ), 0.0f),
+        1080.0f);
+    std::vector<MipFeedbackInstance> instances(timingInstances);
+    for (MipFeedbackInstance& instance : instances)
+    {
+        instance.center = XMFLOAT3(next() * 60.0f - 30.0f, next() * 20.0f - 10.0f, next() * 60.0f - 5.0f);
+        instance.radius = 0.2f + next();
+        instance.uvDensity = 0.5f / instance.radius;
+        instance.key = 0;
+    }
+    std::vector<float> scalar(timingInstances), simd(timingInstances);
+    const uint32_t passes = 20;
+    uint64_t start = Profiler::NowNs();
+    for (uint32_t pass = 0; pass < passes; pass++)
+        feedback.EstimateScalar(instances.data(), timingInstances, scalar.data());
+    uint64_t scalarDone = Profiler::NowNs();
+    for (uint32_t pass = 0; pass < passes; pass++)
+        feedback.EstimateSimd(instances.data(), timingInstances, simd.data());
+    uint64_t simdDone = Profiler::NowNs();
+
+    result.timingInstances = timingInstances;
+    result.scalarMs = (scalarDone - start) * 1.0e-6 / passes;
+    result.simdMs = (simdDone - scalarDone) * 1.0e-6 / passes;
+    for (uint32_t i = 0; i < timingInstances; i++)
+    {
+        // Same operations in the same order, only the last bit may differ
+        if (fabsf(scalar[i] - simd[i]) > 1.0e-5f * std::max(fabsf(scalar[i]), 1.0f))
+            result.mismatches++;
+    }
+    return result;
+}
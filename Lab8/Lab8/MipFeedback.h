@@ -0,0 +1,88 @@
+#ifndef MIP_FEEDBACK_H
+#define MIP_FEEDBACK_H
+
+#include <DirectXMath.h>
+#include <cstdint>
+#include <vector>
+
+using namespace DirectX;
+
+// One visible instance as the estimator sees it
+struct MipFeedbackInstance
+{
+    XMFLOAT3 center;        // world space bounding sphere
+    float radius;
+    float uvDensity;        // texture coordinate units per world unit on the surface
+    uint32_t key;           // texture and array slice, numbered by the caller
+};
+
+struct MipFeedbackStats
+{
+    uint32_t instanceCount;
+    uint32_t keyCount;
+    uint32_t visibleKeys;
+    double buildMs;
+};
+
+struct MipFeedbackValidationResult
+{
+    uint32_t scenes;
+    uint32_t instances;         // instances with at least one visible sample
+    uint32_t samples;           // visible surface points with exact derivatives
+    uint32_t coarser;           // estimate coarser than the derivatives ask for, must stay 0
+    uint32_t exact;
+    double meanExcess;          // mips finer than needed, averaged over instances
+    uint32_t maxExcess;
+    uint32_t timingInstances;
+    double scalarMs;
+    double simdMs;
+    uint32_t mismatches;        // SIMD and scalar disagree
+};
+
+// Finest mip each texture needs for what is visible, estimated on the CPU from the visible
+// list instead of read back from the GPU. For every instance the estimator bounds the screen
+// footprint of one texture coordinate unit from its bounding sphere: the nearest depth of the
+// sphere and its largest angle off the view axis give the highest pixel density any of its
+// points can have, so the estimate is never coarser than the mip hardware derivatives pick,
+// whatever the orientation of the surface. Four instances are estimated per SSE register; the
+// results are reduced to the smallest footprint per key, which RequiredMip turns into a mip
+// for the size of the texture bound under that key.
+class MipFeedback
+{
+public:
+    MipFeedback();
+
+    // proj is a D3D left-handed perspective projection, viewportHeight in pixels
+    void SetCamera(const XMFLOAT4X4& view, const XMFLOAT4X4& proj, float viewportHeight);
+
+    void Build(const MipFeedbackInstance* pInstances, uint32_t count, uint32_t keyCount);
+
+    // Smallest texture coordinate step per pixel over the instances of key, FLT_MAX if none was visible
+    float GetUvPerPixel(uint32_t key) const;
+    const MipFeedbackStats& GetStats() const { return m_stats; }
+
+    // Finest mip of a width x height texture sampled at uvPerPixel, mipCount when nothing is visible
+    static uint32_t RequiredMip(float uvPerPixel, uint32_t width, uint32_t height, uint32_t mipCount);
+
+    // Random boxes in front of random cameras: every estimate is compared with the mips the
+    // exact screen space derivatives of points on the visible faces ask for, then
+    // timingInstances instances are estimated by both paths
+    static MipFeedbackValidationResult Validate(uint32_t scenes, uint32_t instancesPerScene, uint32_t textureSize,
+        uint32_t timingInstances);
+
+private:
+    void EstimateScalar(const MipFeedbackInstance* pInstances, uint32_t count, float* pUvPerPixel) const;
+    void EstimateSimd(const MipFeedbackInstance* pInstances, uint32_t count, float* pUvPerPixel) const;
+
+    XMFLOAT4X4 m_view;
+    float m_pixelScale;     // pixels per unit of x / z and y / z
+    float m_tanX;           // half extents of the frustum at depth 1
+    float m_tanY;
+    float m_nearZ;
+
+    std::vector<float> m_uvPerPixel;    // per instance
+    std::vector<float> m_keys;
+    MipFeedbackStats m_stats;
+};
+
+#endif
@@ -0,0 +1,687 @@
+#include "MipGenerator.h"
+#include "Profiler.h"
+#include "SoftwareTexture.h"
+#include "ThreadPool.h"
+#include <emmintrin.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+
+namespace
+{
+    const uint32_t BandRows = 16;       // output rows per task
+
+    void RunParallel(ThreadPool* pPool, uint32_t count, const std::function<void(uint32_t)>& task)
+    {
+        if (pPool)
+            pPool->ParallelFor(count, [&task](uint32_t index, uint32_t) { task(index); });
+        else
+        {
+            for (uint32_t i = 0; i < count; i++)
+                task(i);
+        }
+    }
+
+    float FilterRadius(MipFilter filter)
+    {
+        return filter == MipFilter::Box ? 0.5f : 3.0f;
+    }
+
+    double Sinc(double x)
+    {
+        if (fabs(x) < 1.0e-6)
+            return 1.0;
+        double px = 3.14159265358979 * x;
+        return sin(px) / px;
+    }
+
+    // Modified Bessel function of the first kind, order 0
+    double BesselI0(double x)
+    {
+        double sum = 1.0;
+        double term = 1.0;
+        double halfX = 0.5 * x;
+        for (int k = 1; k < 32; k++)
+        {
+            term *= (halfX / k) * (halfX / k);
+            sum += term;
+            if (term < sum * 1.0e-12)
+                break;
+        }
+        return sum;
+    }
+
+    // Weight at t texels of the smaller mip from the centre of the output texel
+    double KernelWeight(MipFilter filter, double t)
+    {
+        double radius = FilterRadius(filter);
+        if (fabs(t) > radius)
+            return 0.0;
+        switch (filter)
+        {
+        case MipFilter::Box:
+            return 1.0;
+        case MipFilter::Kaiser:
+        {
+            const double alpha = 4.0;
+            double ratio = t / radius;
+            return Sinc(t) * BesselI0(alpha * sqrt(std::max(1.0 - ratio * ratio, 0.0))) / BesselI0(alpha);
+        }
+        default:
+            return Sinc(t) * Sinc(t / radius);
+        }
+    }
+
+    // Polyphase weights of one axis: output texel i reads taps source texels from first[i]
+    struct FilterAxis
+    {
+        uint32_t taps;
+        std::vector<int> first;
+        std::vector<float> weights;     // taps per output texel, zero padded, summing to 1
+        int padLow;                     // source texels read before 0 and after the last one
+        int padHigh;
+    };
+
+    FilterAxis BuildAxis(MipFilter filter, uint32_t sourceSize, uint32_t destSize)
+    {
+        FilterAxis axis = {};
+        double scale = static_cast<double>(sourceSize) / destSize;
+        double reach = FilterRadius(filter) * scale;
+        std::vector<int> last(destSize);
+        axis.first.resize(destSize);
+        for (uint32_t i = 0; i < destSize; i++)
+        {
+            double center = (i + 0.5) * scale;
+            axis.first[i] = static_cast<int>(ceil(center - reach - 0.5));
+            last[i] = static_cast<int>(floor(center + reach - 0.5));
+            axis.taps = std::max(axis.taps, static_cast<uint32_t>(last[i] - axis.first[i] + 1));
+        }
+
+        axis.weights.assign(static_cast<size_t>(destSize) * axis.taps, 0.0f);
+        for (uint32_t i = 0; i < destSize; i++)
+        {
+            double center = (i + 0.5) * scale;
+            double weights[64] = {};
+            double sum = 0.0;
+            for (int j = axis.first[i]; j <= last[i]; j++)
+            {
+                double weight = KernelWeight(filter, (j + 0.5 - center) / scale);
+                weights[j - axis.first[i]] = weight;
+                sum += weight;
+            }
+            for (int k = 0; k <= last[i] - axis.first[i]; k++)
+                axis.weights[static_cast<size_t>(i) * axis.taps + k] = static_cast<float>(weights[k] / sum);
+            axis.padLow = std::max(axis.padLow, -axis.first[i]);
+            axis.padHigh = std::max(axis.padHigh, axis.first[i] + static_cast<int>(axis.taps) - static_cast<int>(sourceSize));
+        }
+        return axis;
+    }
+
+    double SrgbToLinear(double value)
+    {
+        return value <= 0.04045 ? value / 12.92 : pow((value + 0.055) / 1.055, 2.4);
+    }
+
+    double LinearToSrgb(double value)
+    {
+        return value <= 0.0031308 ? value * 12.92 : 1.055 * pow(value, 1.0 / 2.4) - 0.055;
+    }
+
+    // sRGB codes of linear values, indexed by the top 19 bits of the float. Below 2^-13 every
+    // value encodes to 0; a bucket spans 1/1024 of an octave, well under one code.
+    const uint32_t SrgbTableShift = 13;
+    const uint32_t SrgbTableFirst = (127u - 13u) << (23 - SrgbTableShift);
+    const uint32_t SrgbTableSize = (13u << (23 - SrgbTableShift)) + 1;
+
+    const std::vector<uint8_t>& SrgbTable()
+    {
+        static const std::vector<uint8_t> table = []()
+        {
+            std::vector<uint8_t> codes(SrgbTableSize);
+            for (uint32_t i = 0; i < SrgbTableSize; i++)
+            {
+                uint32_t bits = ((SrgbTableFirst + i) << SrgbTableShift) | (1u << (SrgbTableShift - 1));
+                float value;
+                memcpy(&value, &bits, sizeof(value));
+                double code = LinearToSrgb(std::min(static_cast<double>(value), 1.0)) * 255.0 + 0.5;
+                codes[i] = static_cast<uint8_t>(std::min(code, 255.0));
+            }
+            return codes;
+        }();
+        return table;
+    }
+
+    // How texels turn into linear float RGBA and back
+    struct TexelCodec
+    {
+        float decode[4][256];
+        __m128 scale;           // code = value * scale + offset, truncated
+        __m128 offset;
+        __m128 low;             // value range kept between mips
+        __m128 high;
+        bool srgb;
+        bool normalMap;
+    };
+
+    void InitCodec(const MipGenerateSettings& settings, TexelCodec& codec)
+    {
+        codec.srgb = settings.srgb && !settings.normalMap;
+        codec.normalMap = settings.normalMap;
+        for (uint32_t i = 0; i < 256; i++)
+        {
+            float unorm = i / 255.0f;
+            for (uint32_t c = 0; c < 3; c++)
+            {
+                if (codec.normalMap)
+                    codec.decode[c][i] = i * (2.0f / 255.0f) - 1.0f;
+                else
+                    codec.decode[c][i] = codec.srgb ? static_cast<float>(SrgbToLinear(unorm)) : unorm;
+            }
+            codec.decode[3][i] = unorm;
+        }
+        if (codec.normalMap)
+        {
+            codec.scale = _mm_setr_ps(127.5f, 127.5f, 127.5f, 255.0f);
+            codec.offset = _mm_setr_ps(128.0f, 128.0f, 128.0f, 0.5f);
+            codec.low = _mm_setr_ps(-1.0f, -1.0f, 0.0f, 0.0f);
+        }
+        else
+        {
+            codec.scale = _mm_set1_ps(255.0f);
+            codec.offset = _mm_set1_ps(0.5f);
+            codec.low = _mm_setzero_ps();
+        }
+        codec.high = _mm_set1_ps(1.0f);
+    }
+
+    __m128 Decode(const TexelCodec& codec, uint32_t texel)
+    {
+        return _mm_setr_ps(codec.decode[0][texel & 0xFF], codec.decode[1][(texel >> 8) & 0xFF],
+            codec.decode[2][(texel >> 16) & 0xFF], codec.decode[3][texel >> 24]);
+    }
+
+    uint32_t Encode(const TexelCodec& codec, __m128 value)
+    {
+        __m128 scaled = _mm_add_ps(_mm_mul_ps(value, codec.scale), codec.offset);
+        scaled = _mm_min_ps(_mm_max_ps(scaled, _mm_setzero_ps()), _mm_set1_ps(255.0f));
+        __m128i codes = _mm_cvttps_epi32(scaled);
+        codes = _mm_packs_epi32(codes, codes);
+        uint32_t texel = static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_packus_epi16(codes, codes)));
+        if (codec.srgb)
+        {
+            const std::vector<uint8_t>& table = SrgbTable();
+            alignas(16) uint32_t bits[4];
+            _mm_store_si128(reinterpret_cast<__m128i*>(bits), _mm_castps_si128(value));
+            texel &= 0xFF000000u;
+            for (uint32_t c = 0; c < 3; c++)
+            {
+                uint32_t index = bits[c] >> SrgbTableShift;
+                uint32_t code = 255;
+                if ((bits[c] & 0x80000000u) || index < SrgbTableFirst)
+                    code = 0;
+                else if (index - SrgbTableFirst < SrgbTableSize)
+                    code = table[index - SrgbTableFirst];
+                texel |= code << (8 * c);
+            }
+        }
+        return texel;
+    }
+
+    // Direction through face coordinates sc, tc, D3D cube map convention as in EnvironmentLighting
+    void FaceDirection(uint32_t face, float sc, float tc, float direction[3])
+    {
+        switch (face)
+        {
+        case 0: direction[0] = 1.0f; direction[1] = -tc; direction[2] = -sc; break;
+        case 1: direction[0] = -1.0f; direction[1] = -tc; direction[2] = sc; break;
+        case 2: direction[0] = sc; direction[1] = 1.0f; direction[2] = tc; break;
+        case 3: direction[0] = sc; direction[1] = -1.0f; direction[2] = -tc; break;
+        case 4: direction[0] = sc; direction[1] = -tc; direction[2] = 1.0f; break;
+        default: direction[0] = -sc; direction[1] = -tc; direction[2] = -1.0f; break;
+        }
+    }
+
+    // Texel of the cube that the direction through (x, y) of face hits; x and y may lie
+    // outside the face, the face selection of SoftwareTexture::SampleCube picks the neighbour
+    void CubeTexel(uint32_t face, int x, int y, uint32_t size, uint32_t& outFace, uint32_t& outX, uint32_t& outY)
+    {
+        float direction[3];
+        FaceDirection(face, (x + 0.5f) * 2.0f / size - 1.0f, (y + 0.5f) * 2.0f / size - 1.0f, direction);
+        float dx = direction[0], dy = direction[1], dz = direction[2];
+        float ax = fabsf(dx), ay = fabsf(dy), az = fabsf(dz);
+        float sc, tc, ma;
+        if (ax >= ay && ax >= az)
+        {
+            outFace = dx >= 0.0f ? 0 : 1;
+            sc = dx >= 0.0f ? -dz : dz;
+            tc = -dy;
+            ma = ax;
+        }
+        else if (ay >= az)
+        {
+            outFace = dy >= 0.0f ? 2 : 3;
+            sc = dx;
+            tc = dy >= 0.0f ? dz : -dz;
+            ma = ay;
+        }
+        else
+        {
+            outFace = dz >= 0.0f ? 4 : 5;
+            sc = dz >= 0.0f ? dx : -dx;
+            tc = -dy;
+            ma = az;
+        }
+        int u = static_cast<int>(floorf(0.5f * (sc / ma + 1.0f) * size));
+        int v = static_cast<int>(floorf(0.5f * (tc / ma + 1.0f) * size));
+        outX = static_cast<uint32_t>(std::min(std::max(u, 0), static_cast<int>(size) - 1));
+        outY = static_cast<uint32_t>(std::min(std::max(v, 0), static_cast<int>(size) - 1));
+    }
+
+    int AddressCoord(int coord, uint32_t size, bool wrap)
+    {
+        if (wrap)
+        {
+            int wrapped = coord % static_cast<int>(size);
+            return wrapped < 0 ? wrapped + static_cast<int>(size) : wrapped;
+        }
+        return std::min(std::max(coord, 0), static_cast<int>(size) - 1);
+    }
+
+    // The mip a new one is filtered from: the RGBA8 top mip or the float mip made before
+    struct SourceLevel
+    {
+        uint32_t width;
+        uint32_t height;
+        const std::vector<CookImage>* pTops;
+        const std::vector<std::vector<float>>* pFloats;
+        const TexelCodec* pCodec;
+        bool isCube;
+        bool wrap;
+    };
+
+    __m128 LoadTexel(const SourceLevel& level, uint32_t slice, uint32_t x, uint32_t y)
+    {
+        size_t index = static_cast<size_t>(y) * level.width + x;
+        if (level.pTops)
+            return Decode(*level.pCodec, (*level.pTops)[slice].texels[index]);
+        return _mm_loadu_ps((*level.pFloats)[slice].data() + index * 4);
+    }
+
+    __m128 LoadAddressed(const SourceLevel& level, uint32_t slice, int x, int y)
+    {
+        if (x >= 0 && y >= 0 && x < static_cast<int>(level.width) && y < static_cast<int>(level.height))
+            return LoadTexel(level, slice, x, y);
+        if (level.isCube)
+        {
+            // Small mips with wide kernels reach past the neighbour, which then repeats its far texels
+            int size = static_cast<int>(level.width);
+            x = std::min(std::max(x, -size), 2 * size - 1);
+            y = std::min(std::max(y, -size), 2 * size - 1);
+            uint32_t face, faceX, faceY;
+            CubeTexel(slice % 6, x, y, level.width, face, faceX, faceY);
+            return LoadTexel(level, slice - slice % 6 + face, faceX, faceY);
+        }
+        return LoadTexel(level, slice, AddressCoord(x, level.width, level.wrap), AddressCoord(y, level.height, level.wrap));
+    }
+
+    // Row y of the slice from padLow texels before the face to padHigh after it
+    void LoadRow(const SourceLevel& level, uint32_t slice, int y, int padLow, int padHigh, float* pRow)
+    {
+        int width = static_cast<int>(level.width);
+        bool inside = y >= 0 && y < static_cast<int>(level.height);
+        for (int x = -padLow; x < width + padHigh; x++, pRow += 4)
+        {
+            __m128 texel = inside && x >= 0 && x < width ? LoadTexel(level, slice, x, y) : LoadAddressed(level, slice, x, y);
+            _mm_storeu_ps(pRow, texel);
+        }
+    }
+
+    __m128 FinishTexel(const TexelCodec& codec, __m128 value)
+    {
+        value = _mm_min_ps(_mm_max_ps(value, codec.low), codec.high);
+        if (codec.normalMap)
+        {
+            // Unit length again, alpha left alone
+            __m128 xyz = _mm_and_ps(value, _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0)));
+            __m128 squared = _mm_mul_ps(xyz, xyz);
+            alignas(16) float lanes[4];
+            _mm_store_ps(lanes, squared);
+            float lengthSq = lanes[0] + lanes[1] + lanes[2];
+            __m128 invLength = _mm_set1_ps(lengthSq > 1.0e-12f ? 1.0f / sqrtf(lengthSq) : 0.0f);
+            __m128 normal = lengthSq > 1.0e-12f ? _mm_mul_ps(xyz, invLength) : _mm_setr_ps(0.0f, 0.0f, 1.0f, 0.0f);
+            value = _mm_or_ps(normal, _mm_andnot_ps(_mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0)), value));
+        }
+        return value;
+    }
+
+    uint32_t MipCount(uint32_t width, uint32_t height)
+    {
+        uint32_t count = 1;
+        uint32_t size = std::max(width, height);
+        while (size > 1)
+        {
+            size /= 2;
+            count++;
+        }
+        return count;
+    }
+
+    // Bilinear upscale of a square face, clamped to the face so its edges keep their texels
+    CookImage ScaleFace(const std::vector<uint32_t>& texels, uint32_t size, uint32_t target)
+    {
+        CookImage image = { target, target, std::vector<uint32_t>(static_cast<size_t>(target) * target) };
+        float scale = static_cast<float>(size) / target;
+        for (uint32_t y = 0; y < target; y++)
+        {
+            float fy = std::max((y + 0.5f) * scale - 0.5f, 0.0f);
+            uint32_t y0 = std::min(static_cast<uint32_t>(fy), size - 1);
+            uint32_t y1 = std::min(y0 + 1, size - 1);
+            float wy = fy - y0;
+            for (uint32_t x = 0; x < target; x++)
+            {
+                float fx = std::max((x + 0.5f) * scale - 0.5f, 0.0f);
+                uint32_t x0 = std::min(static_cast<uint32_t>(fx), size - 1);
+                uint32_t x1 = std::min(x0 + 1, size - 1);
+                float wx = fx - x0;
+                uint32_t corners[4] = { texels[y0 * size + x0], texels[y0 * size + x1], texels[y1 * size + x0], texels[y1 * size + x1] };
+                uint32_t texel = 0;
+                for (uint32_t shift = 0; shift < 32; shift += 8)
+                {
+                    float top = ((corners[0] >> shift) & 0xFF) * (1.0f - wx) + ((corners[1] >> shift) & 0xFF) * wx;
+                    float bottom = ((corners[2] >> shift) & 0xFF) * (1.0f - wx) + ((corners[3] >> shift) & 0xFF) * wx;
+                    texel |= static_cast<uint32_t>(top * (1.0f - wy) + bottom * wy + 0.5f) << shift;
+                }
+                image.texels[static_cast<size_t>(y) * target + x] = texel;
+            }
+        }
+        return image;
+    }
+
+    std::vector<CookImage> TileTop(const SoftwareTexture& texture, uint32_t size)
+    {
+        CookImage image = { size, size, std::vector<uint32_t>(static_cast<size_t>(size) * size) };
+        const std::vector<uint32_t>& texels = texture.GetTexels(0, 0);
+        uint32_t width = texture.GetWidth();
+        uint32_t height = texture.GetHeight();
+        for (uint32_t y = 0; y < size; y++)
+        {
+            for (uint32_t x = 0; x < size; x++)
+                image.texels[static_cast<size_t>(y) * size + x] = texels[static_cast<size_t>(y % height) * width + x % width];
+        }
+        return std::vector<CookImage>(1, image);
+    }
+
+    // Mean RGB difference of the texel pairs that face each other across the cube edges, mips
+    // below the top; inner receives the difference of each edge texel to its neighbour in the face
+    double SeamDifference(const std::vector<std::vector<CookImage>>& chains, double& inner)
+    {
+        double sum = 0.0;
+        double innerSum = 0.0;
+        uint64_t pairs = 0;
+        for (size_t mip = 1; mip < chains[0].size(); mip++)
+        {
+            uint32_t size = chains[0][mip].width;
+            if (size < 2)
+                break;
+            for (uint32_t face = 0; face < 6; face++)
+            {
+                for (uint32_t i = 0; i < size; i++)
+                {
+                    const int inside[4][2] = { { 0, static_cast<int>(i) }, { static_cast<int>(size) - 1, static_cast<int>(i) },
+                        { static_cast<int>(i), 0 }, { static_cast<int>(i), static_cast<int>(size) - 1 } };
+                    const int outside[4][2] = { { -1, static_cast<int>(i) }, { static_cast<int>(size), static_cast<int>(i) },
+                        { static_cast<int>(i), -1 }, { static_cast<int>(i), static_cast<int>(size) } };
+                    const int step[4][2] = { { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 } };
+                    for (uint32_t edge = 0; edge < 4; edge++)
+                    {
+                        uint32_t other, x, y;
+                        CubeTexel(face, outside[edge][0], outside[edge][1], size, other, x, y);
+                        uint32_t a = chains[face][mip].texels[static_cast<size_t>(inside[edge][1]) * size + inside[edge][0]];
+                        uint32_t b = chains[other][mip].texels[static_cast<size_t>(y) * size + x];
+                        uint32_t c = chains[face][mip].texels[static_cast<size_t>(inside[edge][1] + step[edge][1]) * size +
+                            inside[edge][0] + step[edge][0]];
+                        for (uint32_t shift = 0; shift < 24; shift += 8)
+                        {
+                            int value = static_cast<int>((a >> shift) & 0xFF);
+                            sum += abs(value - static_cast<int>((b >> shift) & 0xFF));
+                            innerSum += abs(value - static_cast<int>((c >> shift) & 0xFF));
+                        }
+                        pairs += 3;
+                    }
+                }
+            }
+        }
+        inner = pairs ? innerSum / pairs : 0.0;
+        return pairs ? sum / pairs : 0.0;
+    }
+}
+
+MipGenerator::MipGenerator()
+    : m_pPool(nullptr),
+    m_stats()
+{
+}
+
+const char* MipGenerator::GetFilterName(MipFilter filter)
+{
+    static const char* names[MipFilterCount] = { "Box", "Kaiser", "Lanczos" };
+    return names[static_cast<uint32_t>(filter)];
+}
+
+bool MipGenerator::Generate(const std::vector<CookImage>& tops, bool isCube, const MipGenerateSettings& settings,
+    std::vector<std::vector<CookImage>>& chains)
+{
+    m_stats = {};
+    if (tops.empty() || tops[0].width == 0 || tops[0].height == 0)
+        return false;
+    uint32_t width = tops[0].width;
+    uint32_t height = tops[0].height;
+    for (const CookImage& top : tops)
+    {
+        if (top.width != width || top.height != height || top.texels.size() != static_cast<size_t>(width) * height)
+            return false;
+    }
+    if (isCube && (tops.size() % 6 != 0 || width != height))
+        return false;
+
+    PROFILE_SCOPE("Generate Mips");
+    uint64_t start = Profiler::NowNs();
+    TexelCodec codec;
+    InitCodec(settings, codec);
+
+    uint32_t sliceCount = static_cast<uint32_t>(tops.size());
+    uint32_t mipCount = MipCount(width, height);
+    chains.assign(sliceCount, std::vector<CookImage>());
+    for (uint32_t slice = 0; slice < sliceCount; slice++)
+    {
+        chains[slice].reserve(mipCount);
+        chains[slice].push_back(tops[slice]);
+    }
+
+    std::vector<std::vector<float>> previous(sliceCount);
+    std::vector<std::vector<float>> current(sliceCount);
+    SourceLevel source = { width, height, &tops, nullptr, &codec, isCube, settings.wrap };
+    for (uint32_t mip = 1; mip < mipCount; mip++)
+    {
+        uint32_t destWidth = std::max(source.width / 2, 1u);
+        uint32_t destHeight = std::max(source.height / 2, 1u);
+        FilterAxis axisX = BuildAxis(settings.filter, source.width, destWidth);
+        FilterAxis axisY = BuildAxis(settings.filter, source.height, destHeight);
+        for (uint32_t slice = 0; slice < sliceCount; slice++)
+        {
+            current[slice].assign(static_cast<size_t>(destWidth) * destHeight * 4, 0.0f);
+            CookImage image = { destWidth, destHeight, std::vector<uint32_t>(static_cast<size_t>(destWidth) * destHeight) };
+            chains[slice].push_back(std::move(image));
+        }
+
+        uint32_t bandCount = (destHeight + BandRows - 1) / BandRows;
+        RunParallel(m_pPool, sliceCount * bandCount, [&](uint32_t task)
+        {
+            uint32_t slice = task / bandCount;
+            uint32_t firstRow = (task % bandCount) * BandRows;
+            uint32_t endRow = std::min(firstRow + BandRows, destHeight);
+
+            // Horizontal pass over every source row the band reads
+            int sourceFirst = axisY.first[firstRow];
+            int sourceEnd = axisY.first[endRow - 1] + static_cast<int>(axisY.taps);
+            uint32_t paddedWidth = source.width + axisX.padLow + axisX.padHigh;
+            std::vector<float> row(static_cast<size_t>(paddedWidth) * 4);
+            std::vector<float> filtered(static_cast<size_t>(sourceEnd - sourceFirst) * destWidth * 4);
+            for (int y = sourceFirst; y < sourceEnd; y++)
+            {
+                LoadRow(source, slice, y, axisX.padLow, axisX.padHigh, row.data());
+                float* pOut = filtered.data() + static_cast<size_t>(y - sourceFirst) * destWidth * 4;
+                for (uint32_t x = 0; x < destWidth; x++)
+                {
+                    const float* pTaps = row.data() + static_cast<size_t>(axisX.first[x] + axisX.padLow) * 4;
+                    const float* pWeights = axisX.weights.data() + static_cast<size_t>(x) * axisX.taps;
+                    __m128 sum = _mm_setzero_ps();
+                    for (uint32_t k = 0; k < axisX.taps; k++)
+                        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(pTaps + k * 4), _mm_set1_ps(pWeights[k])));
+                    _mm_storeu_ps(pOut + x * 4, sum);
+                }
+            }
+
+            // Vertical pass, then the range of the format and the texels of the new mip
+            std::vector<float>& dest = current[slice];
+            std::vector<uint32_t>& texels = chains[slice][mip].texels;
+            for (uint32_t y = firstRow; y < endRow; y++)
+            {
+                const float* pRows = filtered.data() + static_cast<size_t>(axisY.first[y] - sourceFirst) * destWidth * 4;
+                const float* pWeights = axisY.weights.data() + static_cast<size_t>(y) * axisY.taps;
+                for (uint32_t x = 0; x < destWidth; x++)
+                {
+                    __m128 sum = _mm_setzero_ps();
+                    for (uint32_t k = 0; k < axisY.taps; k++)
+                        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(pRows + (static_cast<size_t>(k) * destWidth + x) * 4), _mm_set1_ps(pWeights[k])));
+                    sum = FinishTexel(codec, sum);
+                    size_t index = static_cast<size_t>(y) * destWidth + x;
+                    _mm_storeu_ps(dest.data() + index * 4, sum);
+                    texels[index] = Encode(codec, sum);
+                }
+            }
+        });
+
+        m_stats.texels += static_cast<uint64_t>(destWidth) * destHeight * sliceCount;
+        previous.swap(current);
+        source.width = destWidth;
+        source.height = destHeight;
+        source.pTops = nullptr;
+        source.pFloats = &previous;
+    }
+
+    m_stats.slices = sliceCount;
+    m_stats.mips = mipCount;
+    m_stats.threads = m_pPool ? m_pPool->GetThreadCount() : 1;
+    m_stats.seconds = (Profiler::NowNs() - start) * 1.0e-9;
+    return true;
+}
+
+MipBenchmarkResult MipGenerator::Benchmark(ThreadPool* pPool, const SoftwareTexture& color, const SoftwareTexture& normalMap,
+    const SoftwareTexture& cube, uint32_t textureSize, uint32_t cubeSize)
+{
+    MipBenchmarkResult result = {};
+    result.textureSize = textureSize;
+    result.cubeSize = cubeSize;
+    result.threads = pPool ? pPool->GetThreadCount() : 1;
+    if (color.GetSliceCount() == 0 || normalMap.GetSliceCount() == 0 || !cube.IsCube() || cube.GetSliceCount() < 6 ||
+        textureSize < 2 || cubeSize < 2)
+    {
+        return result;
+    }
+
+    std::vector<CookImage> colorTop = TileTop(color, textureSize);
+    std::vector<CookImage> normalTop = TileTop(normalMap, textureSize);
+    std::vector<CookImage> cubeTop;
+    for (uint32_t face = 0; face < 6; face++)
+        cubeTop.push_back(ScaleFace(cube.GetTexels(face, 0), cube.GetWidth(), cubeSize));
+
+    MipGenerator generator;
+    generator.SetThreadPool(pPool);
+    std::vector<std::vector<CookImage>> chains;
+    for (uint32_t f = 0; f < MipFilterCount; f++)
+    {
+        MipGenerateSettings textureSettings = { static_cast<MipFilter>(f), true, false, true };
+        generator.Generate(colorTop, false, textureSettings, chains);
+        result.textureMs[f] = generator.GetStats().seconds * 1000.0;
+        MipGenerateSettings cubeSettings = { static_cast<MipFilter>(f), true, false, false };
+        generator.Generate(cubeTop, true, cubeSettings, chains);
+        result.cubeMs[f] = generator.GetStats().seconds * 1000.0;
+    }
+
+    // Seams of the Kaiser chain against faces filtered one by one with clamped edges
+    MipGenerateSettings kaiserCube = { MipFilter::Kaiser, true, false, false };
+    generator.Generate(cubeTop, true, kaiserCube, chains);
+    result.seamDifference = SeamDifference(chains, result.faceDifference);
+    generator.Generate(cubeTop, false, kaiserCube, chains);
+    double clampedInner = 0.0;
+    result.clampedSeamDifference = SeamDifference(chains, clampedInner);
+
+    MipGenerateSettings normalSettings = { MipFilter::Kaiser, false, true, true };
+    generator.Generate(normalTop, false, normalSettings, chains);
+    result.normalMs = generator.GetStats().seconds * 1000.0;
+    for (size_t mip = 1; mip < chains[0].size(); mip++)
+    {
+        for (uint32_t texel : chains[0][mip].texels)
+        {
+            float x = (texel & 0xFF) * (2.0f / 255.0f) - 1.0f;
+            float y = ((texel >> 8) & 0xFF) * (2.0f / 255.0f) - 1.0f;
+            float z = ((texel >> 16) & 0xFF) * (2.0f / 255.0f) - 1.0f;
+            result.maxNormalError = std::max(result.maxNormalError, fabsf(sqrtf(x * x + y * y + z * z) - 1.0f));
+        }
+    }
+
+    MipGenerator single;
+    MipGenerateSettings kaiserTexture = { MipFilter::Kaiser, true, false, true };
+    single.Generate(colorTop, false, kaiserTexture, chains);
+    result.singleThreadMs = single.GetStats().seconds * 1000.0;
+
+    // Scalar reference of random first mip texels: the same weights in double, exact sRGB curves
+    const CookImage& top = colorTop[0];
+    const CookImage& first = chains[0][1];
+    FilterAxis axisX = BuildAxis(MipFilter::Kaiser, top.width, first.width);
+    FilterAxis axisY = BuildAxis(MipFilter::Kaiser, top.height, first.height);
+    uint32_t seed = 11;
+    auto next = [&seed]()
+    {
+        seed = seed * 1664525u + 1013904223u;
+        return (seed >> 8) * (1.0f / 16777216.0f);
+    };
+    result.referenceTexels = 4096;
+    for (uint32_t i = 0; i < result.referenceTexels; i++)
+    {
+        uint32_t x = std::min(static_cast<uint32_t>(next() * first.width), first.width - 1);
+        uint32_t y = std::min(static_cast<uint32_t>(next() * first.height), first.height - 1);
+        double sum[4] = {};
+        for (uint32_t ky = 0; ky < axisY.taps; ky++)
+        {
+            int sy = AddressCoord(axisY.first[y] + static_cast<int>(ky), top.height, true);
+            for (uint32_t kx = 0; kx < axisX.taps; kx++)
+            {
+                int sx = AddressCoord(axisX.first[x] + static_cast<int>(kx), top.width, true);
+                double weight = static_cast<double>(axisY.weights[static_cast<size_t>(y) * axisY.taps + ky]) *
+                    axisX.weights[static_cast<size_t>(x) * axisX.taps + kx];
+                uint32_t texel = top.texels[static_cast<size_t>(sy) * top.width + sx];
+                for (uint32_t c = 0; c < 4; c++)
+                {
+                    double value = ((texel >> (8 * c)) & 0xFF) / 255.0;
+                    sum[c] += weight * (c < 3 ? SrgbToLinear(value) : value);
+                }
+            }
+        }
+        uint32_t texel = first.texels[static_cast<size_t>(y) * first.width + x];
+        for (uint32_t c = 0; c < 4; c++)
+        {
+            double value = std::min(std::max(sum[c], 0.0), 1.0);
+            int code = static_cast<int>((c < 3 ? LinearToSrgb(value) : value) * 255.0 + 0.5);
+            if (abs(code - static_cast<int>((texel >> (8 * c)) & 0xFF)) > 1)
+            {
+                result.mismatches++;
+                break;
+            }
+        }
+    }
+    return result;
+}
@@ -0,0 +1,93 @@
+#ifndef MIP_GENERATOR_H
+#define MIP_GENERATOR_H
+
+#include <cstdint>
+#include <vector>
+
+class SoftwareTexture;
+class ThreadPool;
+
+// RGBA8 texels with R in the low byte, rows tightly packed, the layout of SoftwareTexture
+struct CookImage
+{
+    uint32_t width;
+    uint32_t height;
+    std::vector<uint32_t> texels;
+};
+
+enum class MipFilter : uint32_t
+{
+    Box,        // 2x2 average
+    Kaiser,     // windowed sinc, radius 3 texels of the smaller mip, alpha 4
+    Lanczos     // Lanczos 3
+};
+
+const uint32_t MipFilterCount = 3;
+
+struct MipGenerateSettings
+{
+    MipFilter filter;
+    bool srgb;          // colour is sRGB encoded: filtered in linear light, alpha stays linear
+    bool normalMap;     // RGB is a tangent space normal: renormalized after every filter step
+    bool wrap;          // 2D textures: wrap addressing, clamp otherwise; cube maps read across their edges
+};
+
+struct MipGenerateStats
+{
+    uint32_t slices;
+    uint32_t mips;          // including the top mip
+    uint64_t texels;        // texels written below the top mip
+    uint32_t threads;
+    double seconds;
+};
+
+struct MipBenchmarkResult
+{
+    uint32_t textureSize;
+    uint32_t cubeSize;
+    uint32_t threads;
+    double textureMs[MipFilterCount];   // textureSize^2 sRGB colour texture, full chain
+    double cubeMs[MipFilterCount];      // six cubeSize^2 faces, full chains
+    double normalMs;                    // textureSize^2 normal map, Kaiser
+    double singleThreadMs;              // the Kaiser colour texture on the calling thread
+    uint32_t referenceTexels;           // first mip texels recomputed by the scalar reference
+    uint32_t mismatches;                // ... that differ from the SIMD result by more than one step
+    double seamDifference;              // mean difference of the texel pairs across cube edges, 0..255
+    double clampedSeamDifference;       // the same with every face filtered on its own
+    double faceDifference;              // edge texels to their neighbours inside the face, the scale of the two
+    float maxNormalError;               // largest |length - 1| of a decoded normal below the top mip
+};
+
+// Mip chains for textures that arrive with one mip. The top mip is decoded to linear float
+// RGBA through per channel tables, then every mip is filtered from the one above it by a
+// separable polyphase filter: weights are precomputed per output row and column, one RGBA
+// texel per SSE register. Rows of all slices of a mip are split into bands that run on the
+// thread pool; a band filters the source rows it needs horizontally, then its output rows
+// vertically, so no full size intermediate is kept. Cube faces are padded with the texels of
+// their neighbours, found through the direction of each texel outside the face, so the filter
+// reaches across the edges and seams stay continuous.
+class MipGenerator
+{
+public:
+    MipGenerator();
+
+    void SetThreadPool(ThreadPool* pPool) { m_pPool = pPool; }
+
+    // chains[slice] receives the full chain of tops[slice], the top mip included. Cube maps
+    // have six square faces per cube in D3D order.
+    bool Generate(const std::vector<CookImage>& tops, bool isCube, const MipGenerateSettings& settings,
+        std::vector<std::vector<CookImage>>& chains);
+    const MipGenerateStats& GetStats() const { return m_stats; }
+
+    static const char* GetFilterName(MipFilter filter);
+
+    // color tiled to textureSize^2, the cube faces scaled up to cubeSize^2
+    static MipBenchmarkResult Benchmark(ThreadPool* pPool, const SoftwareTexture& color, const SoftwareTexture& normalMap,
+        const SoftwareTexture& cube, uint32_t textureSize, uint32_t cubeSize);
+
+private:
+    ThreadPool* m_pPool;
+    MipGenerateStats m_stats;
+};
+
+#endif
@@ -0,0 +1,330 @@
+#include "NullRenderBackend.h"
+#include <cstring>
+
+namespace
+{
+    uint32_t FloatBits(float value)
+    {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+}
+
+NullRenderBackend::NullRenderBackend()
+    : m_recording(false),
+    m_errorCount(0)
+{
+}
+
+BackendHandle NullRenderBackend::RegisterPipeline(const char* name)
+{
+    m_pipelines.push_back(name);
+    m_stats.pipelinesCreated++;
+    return static_cast<BackendHandle>(m_pipelines.size());
+}
+
+BackendHandle NullRenderBackend::RegisterSampler(const char* name)
+{
+    m_samplers.push_back(name);
+    return static_cast<BackendHandle>(m_samplers.size());
+}
+
+BackendHandle NullRenderBackend::RegisterTexture(const char* name)
+{
+    m_textures.push_back(name);
+    return static_cast<BackendHandle>(m_textures.size());
+}
+
+BackendHandle NullRenderBackend::RegisterTarget(const char* name)
+{
+    m_targets.push_back(name);
+    return static_cast<BackendHandle>(m_targets.size());
+}
+
+BackendHandle NullRenderBackend::CreateBuffer(const BufferDesc& desc, const void* pInitialData)
+{
+    BufferEntry entry = { desc, true, std::vector<uint8_t>(desc.size, 0) };
+    if (pInitialData)
+    {
+        memcpy(entry.data.data(), pInitialData, desc.size);
+        m_stats.uploads++;
+        m_stats.bytesUploaded += desc.size;
+    }
+    m_buffers.push_back(std::move(entry));
+    CountBufferCreated(desc.size);
+
+    BackendHandle handle = static_cast<BackendHandle>(m_buffers.size());
+    Record(CommandType::CreateBuffer, handle, desc.size, static_cast<uint32_t>(desc.kind));
+    return handle;
+}
+
+void NullRenderBackend::ReleaseBuffer(BackendHandle buffer)
+{
+    if (!IsBufferValid(buffer))
+    {
+        m_errorCount++;
+        return;
+    }
+
+    BufferEntry& entry = m_buffers[buffer - 1];
+    entry.alive = false;
+    std::vector<uint8_t>().swap(entry.data);
+    CountBufferReleased(entry.desc.size);
+    Record(CommandType::ReleaseBuffer, buffer);
+}
+
+void NullRenderBackend::UpdateBuffer(BackendHandle buffer, const void* pData, uint32_t size)
+{
+    if (!IsBufferValid(buffer) || !pData || size > m_buffers[buffer - 1].desc.size)
+    {
+        m_errorCount++;
+        return;
+    }
+
+    BufferEntry& entry = m_buffers[buffer - 1];
+    memcpy(entry.data.data(), pData, size);
+    if (entry.desc.kind == BufferKind::Constant)
+        memset(entry.data.data() + size, 0, entry.desc.size - size);
+
+    m_stats.uploads++;
+    m_stats.bytesUploaded += size;
+    Record(CommandType::UpdateBuffer, buffer, size);
+}
+
+void NullRenderBackend::CopyBuffer(BackendHandle destination, BackendHandle source)
+{
+    if (!IsBufferValid(destination) || !IsBufferValid(source) ||
+        m_buffers[destination - 1].desc.size < m_buffers[source - 1].desc.size)
+    {
+        m_errorCount++;
+        return;
+    }
+
+    const std::vector<uint8_t>& data = m_buffers[source - 1].data;
+    memcpy(m_buffers[destination - 1].data.data(), data.data(), data.size());
+    Record(CommandType::CopyBuffer, destination, source);
+}
+
+bool NullRenderBackend::ReadBuffer(BackendHandle buffer, void* pData, uint32_t size)
+{
+    if (!IsBufferKind(buffer, BufferKind::Readback) || size > m_buffers[buffer - 1].desc.size)
+    {
+        m_errorCount++;
+        return false;
+    }
+
+    memcpy(pData, m_buffers[buffer - 1].data.data(), size);
+    return true;
+}
+
+void NullRenderBackend::BindPipeline(BackendHandle pipeline)
+{
+    if (pipeline == InvalidBackendHandle || pipeline > m_pipelines.size())
+        m_errorCount++;
+
+    m_stats.pipelineBinds++;
+    Record(CommandType::BindPipeline, pipeline);
+}
+
+void NullRenderBackend::BindVertexBuffer(BackendHandle buffer, uint32_t stride)
+{
+    if (!IsBufferKind(buffer, BufferKind::Vertex))
+        m_errorCount++;
+
+    m_stats.bufferBinds++;
+    Record(CommandType::BindVertexBuffer, buffer, stride);
+}
+
+void NullRenderBackend::BindIndexBuffer(BackendHandle buffer)
+{
+    if (!IsBufferKind(buffer, BufferKind::Index))
+        m_errorCount++;
+
+    m_stats.bufferBinds++;
+    Record(CommandType::BindIndexBuffer, buffer);
+}
+
+void NullRenderBackend::BindConstantBuffer(ShaderStage stage, uint32_t slot, BackendHandle buffer)
+{
+    if (!IsBufferKind(buffer, BufferKind::Constant))
+        m_errorCount++;
+
+    m_stats.bufferBinds++;
+    Record(CommandType::BindConstantBuffer, buffer, static_cast<uint32_t>(stage), slot);
+}
+
+void NullRenderBackend::BindTexture(ShaderStage stage, uint32_t slot, BackendHandle texture)
+{
+    if (!IsSlotArgument(texture, m_textures.size()))
+        m_errorCount++;
+
+    m_stats.textureBinds++;
+    Record(CommandType::BindTexture, texture, static_cast<uint32_t>(stage), slot);
+}
+
+void NullRenderBackend::BindStructuredBuffer(ShaderStage stage, uint32_t slot, BackendHandle buffer)
+{
+    if (buffer != InvalidBackendHandle && !IsBufferKind(buffer, BufferKind::Structured))
+        m_errorCount++;
+
+    m_stats.bufferBinds++;
+    Record(CommandType::BindStructuredBuffer, buffer, static_cast<uint32_t>(stage), slot);
+}
+
+void NullRenderBackend::BindUnorderedAccess(uint32_t slot, BackendHandle buffer)
+{
+    // Dynamic structured buffers have no unordered access view
+    bool writable = (IsBufferKind(buffer, BufferKind::Structured) && !m_buffers[buffer - 1].desc.dynamic) ||
+        IsBufferKind(buffer, BufferKind::Arguments);
+    if (buffer != InvalidBackendHandle && !writable)
+        m_errorCount++;
+
+    m_stats.bufferBinds++;
+    Record(CommandType::BindUnorderedAccess, buffer, slot);
+}
+
+void NullRenderBackend::BindSampler(ShaderStage stage, uint32_t slot, BackendHandle sampler)
+{
+    if (!IsSlotArgument(sampler, m_samplers.size()))
+        m_errorCount++;
+
+    Record(CommandType::BindSampler, sampler, static_cast<uint32_t>(stage), slot);
+}
+
+void NullRenderBackend::BindTarget(BackendHandle target)
+{
+    if (!IsSlotArgument(target, m_targets.size()))
+        m_errorCount++;
+
+    Record(CommandType::BindTarget, target);
+}
+
+void NullRenderBackend::ClearColor(BackendHandle target, const float color[4])
+{
+    if (target == InvalidBackendHandle || target > m_targets.size())
+        m_errorCount++;
+
+    Record(CommandType::ClearColor, target, FloatBits(color[0]), FloatBits(color[1]), FloatBits(color[2]));
+}
+
+void NullRenderBackend::ClearDepth(BackendHandle target, float depth)
+{
+    if (target == InvalidBackendHandle || target > m_targets.size())
+        m_errorCount++;
+
+    Record(CommandType::ClearDepth, target, FloatBits(depth));
+}
+
+void NullRenderBackend::SetViewport(float x, float y, float width, float height)
+{
+    if (width <= 0.0f || height <= 0.0f)
+        m_errorCount++;
+
+    Record(CommandType::SetViewport, InvalidBackendHandle, FloatBits(width), FloatBits(height));
+    (void)x;
+    (void)y;
+}
+
+void NullRenderBackend::SetScissor(int32_t left, int32_t top, int32_t right, int32_t bottom)
+{
+    if (right < left || bottom < top)
+        m_errorCount++;
+
+    Record(CommandType::SetScissor, InvalidBackendHandle,
+        static_cast<uint32_t>(right - left), static_cast<uint32_t>(bottom - top));
+}
+
+void NullRenderBackend::Draw(uint32_t vertexCount)
+{
+    m_stats.draws++;
+    m_stats.instances++;
+    Record(CommandType::Draw, InvalidBackendHandle, vertexCount);
+}
+
+void NullRenderBackend::DrawIndexed(uint32_t indexCount, uint32_t firstIndex, int32_t baseVertex)
+{
+    m_stats.draws++;
+    m_stats.instances++;
+    Record(CommandType::DrawIndexed, InvalidBackendHandle, indexCount, firstIndex, static_cast<uint32_t>(baseVertex));
+}
+
+void NullRenderBackend::DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount)
+{
+    m_stats.draws++;
+    m_stats.instances += instanceCount;
+    Record(CommandType::DrawIndexedInstanced, InvalidBackendHandle, indexCount, instanceCount);
+}
+
+void NullRenderBackend::DrawIndexedInstancedIndirect(BackendHandle arguments)
+{
+    // IndexCountPerInstance, InstanceCount, StartIndexLocation, BaseVertexLocation, StartInstanceLocation
+    const uint32_t argumentsSize = 5 * sizeof(uint32_t);
+    if (!IsBufferKind(arguments, BufferKind::Arguments) || m_buffers[arguments - 1].desc.size < argumentsSize)
+    {
+        m_errorCount++;
+        return;
+    }
+
+    uint32_t args[5];
+    memcpy(args, m_buffers[arguments - 1].data.data(), argumentsSize);
+    m_stats.draws++;
+    m_stats.instances += args[1];
+    Record(CommandType::DrawIndexedInstancedIndirect, arguments, args[0], args[1]);
+}
+
+void NullRenderBackend::Dispatch(uint32_t x, uint32_t y, uint32_t z)
+{
+    m_stats.dispatches++;
+    Record(CommandType::Dispatch, InvalidBackendHandle, x, y, z);
+}
+
+void NullRenderBackend::WriteBuffer(BackendHandle buffer, uint32_t offset, const void* pData, uint32_t size)
+{
+    if (!IsBufferValid(buffer) || offset + size > m_buffers[buffer - 1].desc.size)
+    {
+        m_errorCount++;
+        return;
+    }
+    memcpy(m_buffers[buffer - 1].data.data() + offset, pData, size);
+}
+
+const uint8_t* NullRenderBackend::GetBufferData(BackendHandle buffer) const
+{
+    return IsBufferValid(buffer) ? m_buffers[buffer - 1].data.data() : nullptr;
+}
+
+size_t NullRenderBackend::GetLiveBufferCount() const
+{
+    size_t count = 0;
+    for (const auto& entry : m_buffers)
+    {
+        if (entry.alive)
+            count++;
+    }
+    return count;
+}
+
+void NullRenderBackend::Record(CommandType type, BackendHandle handle, uint32_t a, uint32_t b, uint32_t c)
+{
+    if (!m_recording)
+        return;
+
+    Command command = { type, handle, { a, b, c } };
+    m_commands.push_back(command);
+}
+
+bool NullRenderBackend::IsBufferValid(BackendHandle buffer) const
+{
+    return buffer != InvalidBackendHandle && buffer <= m_buffers.size() && m_buffers[buffer - 1].alive;
+}
+
+bool NullRenderBackend::IsBufferKind(BackendHandle buffer, BufferKind kind) const
+{
+    return IsBufferValid(buffer) && m_buffers[buffer - 1].desc.kind == kind;
+}
+
+bool NullRenderBackend::IsSlotArgument(BackendHandle handle, size_t count) const
+{
+    return handle <= count;
+}
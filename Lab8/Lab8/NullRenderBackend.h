@@ -0,0 +1,119 @@
+#ifndef NULL_RENDER_BACKEND_H
+#define NULL_RENDER_BACKEND_H
+
+#include "RenderBackend.h"
+#include <cstddef>
+#include <vector>
+
+// Backend without a device: accepts every call, validates handles and counts the work.
+// With recording enabled it also keeps the command stream so a frame can be compared
+// against a reference run (binds, uploads and draws, not pixels). Buffer contents are
+// kept, so copies, readbacks and indirect draws see what the frame code wrote.
+class NullRenderBackend : public RenderBackend
+{
+public:
+    enum class CommandType : uint32_t
+    {
+        CreateBuffer,
+        ReleaseBuffer,
+        UpdateBuffer,
+        CopyBuffer,
+        BindPipeline,
+        BindVertexBuffer,
+        BindIndexBuffer,
+        BindConstantBuffer,
+        BindTexture,
+        BindStructuredBuffer,
+        BindUnorderedAccess,
+        BindSampler,
+        BindTarget,
+        ClearColor,
+        ClearDepth,
+        SetViewport,
+        SetScissor,
+        Draw,
+        DrawIndexed,
+        DrawIndexedInstanced,
+        DrawIndexedInstancedIndirect,
+        Dispatch
+    };
+
+    struct Command
+    {
+        CommandType type;
+        BackendHandle handle;
+        uint32_t args[3];
+    };
+
+    NullRenderBackend();
+
+    BackendHandle RegisterPipeline(const char* name);
+    BackendHandle RegisterSampler(const char* name);
+    BackendHandle RegisterTexture(const char* name);
+    BackendHandle RegisterTarget(const char* name);
+
+    BackendHandle CreateBuffer(const BufferDesc& desc, const void* pInitialData) override;
+    void ReleaseBuffer(BackendHandle buffer) override;
+    void UpdateBuffer(BackendHandle buffer, const void* pData, uint32_t size) override;
+    void CopyBuffer(BackendHandle destination, BackendHandle source) override;
+    bool ReadBuffer(BackendHandle buffer, void* pData, uint32_t size) override;
+
+    void BindPipeline(BackendHandle pipeline) override;
+    void BindVertexBuffer(BackendHandle buffer, uint32_t stride) override;
+    void BindIndexBuffer(BackendHandle buffer) override;
+    void BindConstantBuffer(ShaderStage stage, uint32_t slot, BackendHandle buffer) override;
+    void BindTexture(ShaderStage stage, uint32_t slot, BackendHandle texture) override;
+    void BindStructuredBuffer(ShaderStage stage, uint32_t slot, BackendHandle buffer) override;
+    void BindUnorderedAccess(uint32_t slot, BackendHandle buffer) override;
+    void BindSampler(ShaderStage stage, uint32_t slot, BackendHandle sampler) override;
+
+    void BindTarget(BackendHandle target) override;
+    void ClearColor(BackendHandle target, const float color[4]) override;
+    void ClearDepth(BackendHandle target, float depth) override;
+    void SetViewport(float x, float y, float width, float height) override;
+    void SetScissor(int32_t left, int32_t top, int32_t right, int32_t bottom) override;
+
+    void Draw(uint32_t vertexCount) override;
+    void DrawIndexed(uint32_t indexCount, uint32_t firstIndex, int32_t baseVertex) override;
+    void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount) override;
+    void DrawIndexedInstancedIndirect(BackendHandle arguments) override;
+    void Dispatch(uint32_t x, uint32_t y, uint32_t z) override;
+
+    // Stands in for a compute shader: lets the caller write buffers the way the GPU would
+    void WriteBuffer(BackendHandle buffer, uint32_t offset, const void* pData, uint32_t size);
+    const uint8_t* GetBufferData(BackendHandle buffer) const;
+
+    void SetRecording(bool recording) { m_recording = recording; }
+    const std::vector<Command>& GetCommands() const { return m_commands; }
+    void ClearCommands() { m_commands.clear(); }
+
+    // Calls that referenced unknown or released handles, or overflowed a buffer
+    uint64_t GetErrorCount() const { return m_errorCount; }
+    size_t GetLiveBufferCount() const;
+
+private:
+    struct BufferEntry
+    {
+        BufferDesc desc;
+        bool alive;
+        std::vector<uint8_t> data;
+    };
+
+    void Record(CommandType type, BackendHandle handle, uint32_t a = 0, uint32_t b = 0, uint32_t c = 0);
+    bool IsBufferValid(BackendHandle buffer) const;
+    bool IsBufferKind(BackendHandle buffer, BufferKind kind) const;
+    // InvalidBackendHandle is a valid argument for binds that unbind
+    bool IsSlotArgument(BackendHandle handle, size_t count) const;
+
+    std::vector<BufferEntry> m_buffers;    // handle - 1
+    std::vector<const char*> m_pipelines;
+    std::vector<const char*> m_samplers;
+    std::vector<const char*> m_textures;
+    std::vector<const char*> m_targets;
+
+    bool m_recording;
+    std::vector<Command> m_commands;
+    uint64_t m_errorCount;
+};
+
+#endif
@@ -0,0 +1,271 @@
+#include "Profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+namespace
+{
+    thread_local uint32_t t_depth = 0;
+    thread_local void* t_ring = nullptr;
+
+    void WriteJsonString(FILE* file, const std::string& text)
+    {
+        fputc('"', file);
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+                fputc('\\', file);
+            fputc(c, file);
+        }
+        fputc('"', file);
+    }
+}
+
+Profiler& Profiler::Get()
+{
+    static Profiler profiler;
+    return profiler;
+}
+
+Profiler::Profiler()
+    : m_enabled(false),
+    m_gpuRing(nullptr),
+    m_lastFrameStart(0),
+    m_lastFrameEnd(0),
+    m_currentFrameStart(0)
+{
+    m_gpuRing = CreateRing("GPU");
+}
+
+Profiler::~Profiler()
+{
+    for (ThreadRing* ring : m_rings)
+        delete ring;
+}
+
+uint64_t Profiler::NowNs()
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+Profiler::ThreadRing* Profiler::CreateRing(const char* name)
+{
+    ThreadRing* ring = new ThreadRing();
+    ring->name = name;
+    ring->writeCount.store(0, std::memory_order_relaxed);
+    for (RingEntry& entry : ring->entries)
+        entry.sequence.store(0, std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(m_ringsMutex);
+    ring->index = static_cast<uint32_t>(m_rings.size());
+    m_rings.push_back(ring);
+    return ring;
+}
+
+Profiler::ThreadRing* Profiler::GetThreadRing()
+{
+    if (!t_ring)
+    {
+        ThreadRing* ring = CreateRing("");
+        std::lock_guard<std::mutex> lock(m_ringsMutex);
+        ring->name = "Thread " + std::to_string(ring->index);
+        t_ring = ring;
+    }
+    return static_cast<ThreadRing*>(t_ring);
+}
+
+void Profiler::SetThreadName(const char* name)
+{
+    ThreadRing* ring = GetThreadRing();
+    std::lock_guard<std::mutex> lock(m_ringsMutex);
+    ring->name = name;
+}
+
+uint32_t Profiler::PushScope()
+{
+    return t_depth++;
+}
+
+void Profiler::PopScope(const char* name, uint64_t startNs, uint32_t depth)
+{
+    t_depth = depth;
+
+    ProfileEvent event;
+    event.name = name;
+    event.startNs = startNs;
+    event.endNs = NowNs();
+    event.depth = depth;
+
+    ThreadRing* ring = GetThreadRing();
+    event.threadIndex = ring->index;
+    Write(ring, event);
+}
+
+void Profiler::Write(ThreadRing* ring, const ProfileEvent& event)
+{
+    // Single writer per ring: mark the entry busy, fill it, then publish it
+    uint64_t count = ring->writeCount.load(std::memory_order_relaxed);
+    RingEntry& entry = ring->entries[count % RingCapacity];
+    entry.sequence.store(2 * count + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    entry.name.store(event.name, std::memory_order_relaxed);
+    entry.startNs.store(event.startNs, std::memory_order_relaxed);
+    entry.endNs.store(event.endNs, std::memory_order_relaxed);
+    entry.depth.store(event.depth, std::memory_order_relaxed);
+    entry.sequence.store(2 * count + 2, std::memory_order_release);
+    ring->writeCount.store(count + 1, std::memory_order_release);
+}
+
+void Profiler::MarkFrame()
+{
+    uint64_t now = NowNs();
+    if (m_currentFrameStart != 0)
+    {
+        m_lastFrameStart = m_currentFrameStart;
+        m_lastFrameEnd = now;
+    }
+    m_currentFrameStart = now;
+}
+
+void Profiler::AddGpuEvent(const char* name, uint64_t startNs, uint64_t endNs, uint32_t depth)
+{
+    // GPU events are only produced by the render thread, so the ring still has one writer
+    ProfileEvent event;
+    event.name = name;
+    event.startNs = startNs;
+    event.endNs = endNs;
+    event.depth = depth;
+    event.threadIndex = m_gpuRing->index;
+    Write(m_gpuRing, event);
+}
+
+void Profiler::Collect(std::vector<ProfileEvent>& events, uint64_t fromNs, uint64_t toNs) const
+{
+    std::vector<ThreadRing*> rings;
+    {
+        std::lock_guard<std::mutex> lock(m_ringsMutex);
+        rings = m_rings;
+    }
+
+    for (ThreadRing* ring : rings)
+    {
+        uint64_t count = ring->writeCount.load(std::memory_order_acquire);
+        uint64_t first = count > RingCapacity ? count - RingCapacity : 0;
+
+        size_t begin = events.size();
+        for (uint64_t i = first; i < count; i++)
+        {
+            // The writer may reuse the entry at any time: copy it, then keep the copy only
+            // if the entry still holds write i, untouched since before the copy started
+            const RingEntry& entry = ring->entries[i % RingCapacity];
+            const uint64_t expected = 2 * i + 2;
+            if (entry.sequence.load(std::memory_order_acquire) != expected)
+                continue;
+
+            ProfileEvent event;
+            event.name = entry.name.load(std::memory_order_relaxed);
+            event.startNs = entry.startNs.load(std::memory_order_relaxed);
+            event.endNs = entry.endNs.load(std::memory_order_relaxed);
+            event.depth = entry.depth.load(std::memory_order_relaxed);
+            event.threadIndex = ring->index;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (entry.sequence.load(std::memory_order_relaxed) != expected)
+                continue;
+
+            if (event.endNs >= fromNs && event.endNs <= toNs)
+                events.push_back(event);
+        }
+
+        std::sort(events.begin() + begin, events.end(), [](const ProfileEvent& a, const ProfileEvent& b) {
+            return a.startNs < b.startNs;
+            });
+    }
+}
+
+ProfilerBenchmarkResult Profiler::Benchmark(uint32_t scopes)
+{
+    ProfilerBenchmarkResult result = {};
+    result.scopes = scopes;
+    if (scopes == 0)
+        return result;
+
+    Profiler& profiler = Get();
+    bool wasEnabled = profiler.IsEnabled();
+
+    profiler.SetEnabled(false);
+    uint64_t start = NowNs();
+    for (uint32_t i = 0; i < scopes; i++)
+    {
+        PROFILE_SCOPE("Profiler Benchmark");
+    }
+    result.disabledNs = static_cast<double>(NowNs() - start) / scopes;
+
+    profiler.SetEnabled(true);
+    start = NowNs();
+    for (uint32_t i = 0; i < scopes; i++)
+    {
+        PROFILE_SCOPE("Profiler Benchmark");
+    }
+    result.enabledNs = static_cast<double>(NowNs() - start) / scopes;
+
+    profiler.SetEnabled(wasEnabled);
+    return result;
+}
+
+std::vector<std::string> Profiler::GetThreadNames() const
+{
+    std::lock_guard<std::mutex> lock(m_ringsMutex);
+    std::vector<std::string> names;
+    for (const ThreadRing* ring : m_rings)
+        names.push_back(ring->name);
+    return names;
+}
+
+bool Profiler::WriteChromeTrace(const char* path) const
+{
+    FILE* file = nullptr;
+#ifdef _MSC_VER
+    if (fopen_s(&file, path, "w") != 0)
+        file = nullptr;
+#else
+    file = fopen(path, "w");
+#endif
+    if (!file)
+        return false;
+
+    std::vector<ProfileEvent> events;
+    Collect(events, 0, UINT64_MAX);
+    std::vector<std::string> names = GetThreadNames();
+
+    uint64_t origin = UINT64_MAX;
+    for (const auto& event : events)
+        origin = std::min(origin, event.startNs);
+
+    fprintf(file, "{\"traceEvents\":[\n");
+    bool first = true;
+    for (size_t i = 0; i < names.size(); i++)
+    {
+        fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":",
+            first ? "" : ",\n", static_cast<unsigned>(i));
+        WriteJsonString(file, names[i]);
+        fprintf(file, "}}");
+        first = false;
+    }
+
+    for (const auto& event : events)
+    {
+        fprintf(file, "%s{\"name\":", first ? "" : ",\n");
+        WriteJsonString(file, event.name);
+        fprintf(file, ",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}",
+            event.threadIndex == m_gpuRing->index ? "gpu" : "cpu",
+            (event.startNs - origin) / 1000.0,
+            (event.endNs - event.startNs) / 1000.0,
+            event.threadIndex);
+        first = false;
+    }
+
+    fprintf(file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+    fclose(file);
+    return true;
+}
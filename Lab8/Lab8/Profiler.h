@@ -0,0 +1,132 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct ProfileEvent
+{
+    const char* name;   // must outlive the profiler (string literals)
+    uint64_t startNs;
+    uint64_t endNs;
+    uint32_t depth;
+    uint32_t threadIndex;
+};
+
+struct ProfilerBenchmarkResult
+{
+    uint32_t scopes;
+    double disabledNs;  // per PROFILE_SCOPE while the profiler is off
+    double enabledNs;   // per PROFILE_SCOPE while it records
+};
+
+// Hierarchical CPU scope profiler. Every thread writes completed scopes into its own
+// ring buffer without locks; readers (UI, trace export) take snapshots of the rings.
+// GPU timings are fed in as events of a separate pseudo-thread.
+// Off by default: a disabled scope costs one relaxed load.
+class Profiler
+{
+public:
+    static const uint32_t RingCapacity = 16384;
+
+    static Profiler& Get();
+
+    void SetEnabled(bool enabled) { m_enabled.store(enabled, std::memory_order_relaxed); }
+    bool IsEnabled() const { return m_enabled.load(std::memory_order_relaxed); }
+
+    static uint64_t NowNs();
+
+    // Called by ProfileScope; depth is tracked per thread
+    uint32_t PushScope();
+    void PopScope(const char* name, uint64_t startNs, uint32_t depth);
+
+    void SetThreadName(const char* name);
+
+    // Frame boundaries of the main thread, used to pick the last frame for the UI
+    void MarkFrame();
+    uint64_t GetLastFrameStart() const { return m_lastFrameStart; }
+    uint64_t GetLastFrameEnd() const { return m_lastFrameEnd; }
+
+    void AddGpuEvent(const char* name, uint64_t startNs, uint64_t endNs, uint32_t depth);
+    uint32_t GetGpuThreadIndex() const { return m_gpuRing->index; }
+
+    // Events that finished inside [fromNs, toNs], ordered by thread then start time
+    void Collect(std::vector<ProfileEvent>& events, uint64_t fromNs, uint64_t toNs) const;
+    std::vector<std::string> GetThreadNames() const;
+
+    bool WriteChromeTrace(const char* path) const;
+
+    // Cost of a scope with the profiler off and on, measured on the calling thread
+    static ProfilerBenchmarkResult Benchmark(uint32_t scopes);
+
+private:
+    // Seqlock entry: sequence is odd while the owning thread writes the fields and
+    // 2 * (write index + 1) once they are complete, so a reader can tell when the
+    // writer lapped it during the copy
+    struct RingEntry
+    {
+        std::atomic<uint64_t> sequence;
+        std::atomic<const char*> name;
+        std::atomic<uint64_t> startNs;
+        std::atomic<uint64_t> endNs;
+        std::atomic<uint32_t> depth;
+    };
+
+    struct ThreadRing
+    {
+        std::string name;
+        uint32_t index;
+        std::atomic<uint64_t> writeCount;
+        RingEntry entries[RingCapacity];
+    };
+
+    Profiler();
+    ~Profiler();
+    ThreadRing* GetThreadRing();
+    ThreadRing* CreateRing(const char* name);
+    void Write(ThreadRing* ring, const ProfileEvent& event);
+
+    std::atomic<bool> m_enabled;
+    mutable std::mutex m_ringsMutex; // only taken when a thread registers or a reader snapshots
+    std::vector<ThreadRing*> m_rings;
+    ThreadRing* m_gpuRing;
+
+    uint64_t m_lastFrameStart;
+    uint64_t m_lastFrameEnd;
+    uint64_t m_currentFrameStart;
+};
+
+class ProfileScope
+{
+public:
+    explicit ProfileScope(const char* name)
+        : m_name(name), m_startNs(0), m_depth(0), m_active(Profiler::Get().IsEnabled())
+    {
+        if (m_active)
+        {
+            m_depth = Profiler::Get().PushScope();
+            m_startNs = Profiler::NowNs();
+        }
+    }
+
+    ~ProfileScope()
+    {
+        if (m_active)
+            Profiler::Get().PopScope(m_name, m_startNs, m_depth);
+    }
+
+private:
+    const char* m_name;
+    uint64_t m_startNs;
+    uint32_t m_depth;
+    bool m_active;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+
+#endif
@@ -0,0 +1,815 @@
+#include "RayTracer.h"
+#include "Profiler.h"
+#include "ThreadPool.h"
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+
+namespace
+{
+    const float HitEpsilon = 1.0e-4f;
+    const float ShadowBias = 1.0e-3f;
+    const uint32_t StackSize = 64;
+    const uint32_t BlasLeafSize = 4;
+
+    SwFloat3 TransformPoint(const float m[4][3], const SwFloat3& p)
+    {
+        return SwFloat3(
+            p.x * m[0][0] + p.y * m[1][0] + p.z * m[2][0] + m[3][0],
+            p.x * m[0][1] + p.y * m[1][1] + p.z * m[2][1] + m[3][1],
+            p.x * m[0][2] + p.y * m[1][2] + p.z * m[2][2] + m[3][2]);
+    }
+
+    SwFloat3 TransformVector(const float m[4][3], const SwFloat3& d)
+    {
+        return SwFloat3(
+            d.x * m[0][0] + d.y * m[1][0] + d.z * m[2][0],
+            d.x * m[0][1] + d.y * m[1][1] + d.z * m[2][1],
+            d.x * m[0][2] + d.y * m[1][2] + d.z * m[2][2]);
+    }
+
+    void TransformPoint(const float m[4][3], const float in[3], float out[3])
+    {
+        for (int j = 0; j < 3; j++)
+            out[j] = in[0] * m[0][j] + in[1] * m[1][j] + in[2] * m[2][j] + m[3][j];
+    }
+
+    void TransformVector(const float m[4][3], const float in[3], float out[3])
+    {
+        for (int j = 0; j < 3; j++)
+            out[j] = in[0] * m[0][j] + in[1] * m[1][j] + in[2] * m[2][j];
+    }
+
+    void Normalize(float v[3])
+    {
+        float length = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+        if (length > 0.0f)
+        {
+            v[0] /= length;
+            v[1] /= length;
+            v[2] /= length;
+        }
+    }
+
+    // Row-vector affine inverse: p' = p * A + t  =>  p = p' * inverse(A) - t * inverse(A)
+    void InvertAffine(const float m[4][3], float out[4][3])
+    {
+        float c00 = m[1][1] * m[2][2] - m[1][2] * m[2][1];
+        float c01 = m[1][2] * m[2][0] - m[1][0] * m[2][2];
+        float c02 = m[1][0] * m[2][1] - m[1][1] * m[2][0];
+        float det = m[0][0] * c00 + m[0][1] * c01 + m[0][2] * c02;
+        float invDet = det != 0.0f ? 1.0f / det : 0.0f;
+
+        out[0][0] = c00 * invDet;
+        out[1][0] = c01 * invDet;
+        out[2][0] = c02 * invDet;
+        out[0][1] = (m[0][2] * m[2][1] - m[0][1] * m[2][2]) * invDet;
+        out[1][1] = (m[0][0] * m[2][2] - m[0][2] * m[2][0]) * invDet;
+        out[2][1] = (m[0][1] * m[2][0] - m[0][0] * m[2][1]) * invDet;
+        out[0][2] = (m[0][1] * m[1][2] - m[0][2] * m[1][1]) * invDet;
+        out[1][2] = (m[0][2] * m[1][0] - m[0][0] * m[1][2]) * invDet;
+        out[2][2] = (m[0][0] * m[1][1] - m[0][1] * m[1][0]) * invDet;
+
+        for (int j = 0; j < 3; j++)
+            out[3][j] = -(m[3][0] * out[0][j] + m[3][1] * out[1][j] + m[3][2] * out[2][j]);
+    }
+
+    SwFloat3 Reciprocal(const SwFloat3& d)
+    {
+        return SwFloat3(SwFloat(1.0f) / d.x, SwFloat(1.0f) / d.y, SwFloat(1.0f) / d.z);
+    }
+
+    // Slab test of four rays against a node box. Returns the lanes that enter it before tMax.
+    SwFloat IntersectBox(const BvhNode& node, const SwFloat3& origin, const SwFloat3& invDir, const SwFloat& tMax, SwFloat& tEntry)
+    {
+        SwFloat tx0 = (SwFloat(node.boundsMin[0]) - origin.x) * invDir.x;
+        SwFloat tx1 = (SwFloat(node.boundsMax[0]) - origin.x) * invDir.x;
+        SwFloat ty0 = (SwFloat(node.boundsMin[1]) - origin.y) * invDir.y;
+        SwFloat ty1 = (SwFloat(node.boundsMax[1]) - origin.y) * invDir.y;
+        SwFloat tz0 = (SwFloat(node.boundsMin[2]) - origin.z) * invDir.z;
+        SwFloat tz1 = (SwFloat(node.boundsMax[2]) - origin.z) * invDir.z;
+
+        SwFloat tNear = Max(Max(Min(tx0, tx1), Min(ty0, ty1)), Max(Min(tz0, tz1), 0.0f));
+        SwFloat tFar = Min(Min(Max(tx0, tx1), Max(ty0, ty1)), Min(Max(tz0, tz1), tMax));
+        tEntry = tNear;
+        return _mm_and_ps(_mm_cmple_ps(tNear.v, tFar.v), _mm_cmpgt_ps(tFar.v, _mm_setzero_ps()));
+    }
+
+    float MaskedMin(const SwFloat& value, const SwFloat& mask)
+    {
+        alignas(16) float lanes[4];
+        _mm_store_ps(lanes, Select(mask, value, FLT_MAX).v);
+        float result = lanes[0];
+        for (int i = 1; i < 4; i++)
+            result = lanes[i] < result ? lanes[i] : result;
+        return result;
+    }
+
+    // Stack traversal shared by both levels: a node is entered when any active lane hits its box,
+    // the nearer child first. leaf(first, count) may shorten tMax and returns true to stop.
+    template<typename LeafFunc>
+    void TraversePacket(const Bvh& bvh, const SwFloat3& origin, const SwFloat3& invDir, const SwFloat& tMax, LeafFunc leaf)
+    {
+        const std::vector<BvhNode>& nodes = bvh.GetNodes();
+        if (nodes.empty())
+            return;
+
+        SwFloat entry;
+        if (_mm_movemask_ps(IntersectBox(nodes[0], origin, invDir, tMax, entry).v) == 0)
+            return;
+
+        uint32_t stack[StackSize];
+        uint32_t stackSize = 0;
+        stack[stackSize++] = 0;
+        while (stackSize > 0)
+        {
+            const BvhNode& node = nodes[stack[--stackSize]];
+            if (node.count > 0)
+            {
+                if (leaf(node.leftFirst, node.count))
+                    return;
+                continue;
+            }
+
+            SwFloat leftEntry;
+            SwFloat rightEntry;
+            SwFloat leftMask = IntersectBox(nodes[node.leftFirst], origin, invDir, tMax, leftEntry);
+            SwFloat rightMask = IntersectBox(nodes[node.leftFirst + 1], origin, invDir, tMax, rightEntry);
+            bool hitLeft = _mm_movemask_ps(leftMask.v) != 0;
+            bool hitRight = _mm_movemask_ps(rightMask.v) != 0;
+
+            if (hitLeft && hitRight)
+            {
+                bool leftFirst = MaskedMin(leftEntry, leftMask) <= MaskedMin(rightEntry, rightMask);
+                stack[stackSize++] = leftFirst ? node.leftFirst + 1 : node.leftFirst;
+                stack[stackSize++] = leftFirst ? node.leftFirst : node.leftFirst + 1;
+            }
+            else if (hitLeft)
+                stack[stackSize++] = node.leftFirst;
+            else if (hitRight)
+                stack[stackSize++] = node.leftFirst + 1;
+        }
+    }
+
+    // Moeller-Trumbore for four rays against one triangle, both sides. Returns the lanes
+    // that hit closer than tMax.
+    SwFloat IntersectTriangle(const float v0[3], const float edge1[3], const float edge2[3],
+        const SwFloat3& origin, const SwFloat3& direction, const SwFloat& tMax, SwFloat& t, SwFloat& u, SwFloat& v)
+    {
+        SwFloat3 e1(edge1[0], edge1[1], edge1[2]);
+        SwFloat3 e2(edge2[0], edge2[1], edge2[2]);
+
+        SwFloat3 p(direction.y * e2.z - direction.z * e2.y,
+            direction.z * e2.x - direction.x * e2.z,
+            direction.x * e2.y - direction.y * e2.x);
+        SwFloat det = Dot(e1, p);
+        SwFloat invDet = SwFloat(1.0f) / det;
+
+        SwFloat3 s = origin - SwFloat3(v0[0], v0[1], v0[2]);
+        u = Dot(s, p) * invDet;
+        SwFloat3 q(s.y * e1.z - s.z * e1.y,
+            s.z * e1.x - s.x * e1.z,
+            s.x * e1.y - s.y * e1.x);
+        v = Dot(direction, q) * invDet;
+        t = Dot(e2, q) * invDet;
+
+        __m128 mask = _mm_cmpgt_ps(Abs(det).v, _mm_set1_ps(1.0e-12f));
+        mask = _mm_and_ps(mask, _mm_cmpge_ps(u.v, _mm_setzero_ps()));
+        mask = _mm_and_ps(mask, _mm_cmpge_ps(v.v, _mm_setzero_ps()));
+        mask = _mm_and_ps(mask, _mm_cmple_ps((u + v).v, _mm_set1_ps(1.0f)));
+        mask = _mm_and_ps(mask, _mm_cmpgt_ps(t.v, _mm_set1_ps(HitEpsilon)));
+        mask = _mm_and_ps(mask, _mm_cmplt_ps(t.v, tMax.v));
+        return mask;
+    }
+
+    uint32_t Hash(uint32_t x)
+    {
+        x ^= x >> 16;
+        x *= 0x7feb352dU;
+        x ^= x >> 15;
+        x *= 0x846ca68bU;
+        x ^= x >> 16;
+        return x;
+    }
+
+    float ToUnitFloat(uint32_t x)
+    {
+        return (x >> 8) * (1.0f / 16777216.0f);
+    }
+
+    void PutU16(unsigned char* pDest, uint32_t value)
+    {
+        pDest[0] = static_cast<unsigned char>(value);
+        pDest[1] = static_cast<unsigned char>(value >> 8);
+    }
+
+    void PutU32(unsigned char* pDest, uint32_t value)
+    {
+        PutU16(pDest, value & 0xFFFF);
+        PutU16(pDest + 2, value >> 16);
+    }
+}
+
+bool RayTracer::Init(ThreadPool* pPool)
+{
+    m_pPool = pPool;
+
+    SoftwareTexture textile;
+    if (!m_diffuse.LoadDDS("cat.dds", pPool) || !textile.LoadDDS("textile.dds", pPool) || !m_diffuse.AppendSlices(textile))
+        return false;
+    if (!m_normalMap.LoadDDS("cube_normal_bc5.dds", pPool) && !m_normalMap.LoadDDS("cube_normal.dds", pPool))
+        return false;
+    return m_skybox.LoadDDS("skybox.dds", pPool) && m_skybox.IsCube();
+}
+
+void RayTracer::SetMesh(const SwMeshData& data)
+{
+    m_vertices.resize(data.vertexCount);
+    for (uint32_t i = 0; i < data.vertexCount; i++)
+    {
+        const float* pSource = data.pVertices + static_cast<size_t>(i) * data.floatsPerVertex;
+        MeshVertex vertex = {};
+        for (int c = 0; c < 3; c++)
+            vertex.position[c] = pSource[c];
+        if (data.floatsPerVertex >= 8)
+        {
+            for (int c = 0; c < 3; c++)
+                vertex.normal[c] = pSource[3 + c];
+            vertex.uv[0] = pSource[6];
+            vertex.uv[1] = pSource[7];
+        }
+        m_vertices[i] = vertex;
+    }
+    m_indices.assign(data.pIndices, data.pIndices + data.indexCount);
+
+    uint32_t triangleCount = data.indexCount / 3;
+    m_triangles.resize(triangleCount);
+    std::vector<BvhBounds> bounds(triangleCount);
+    for (uint32_t i = 0; i < triangleCount; i++)
+    {
+        const float* p0 = m_vertices[m_indices[i * 3]].position;
+        const float* p1 = m_vertices[m_indices[i * 3 + 1]].position;
+        const float* p2 = m_vertices[m_indices[i * 3 + 2]].position;
+
+        MeshTriangle& triangle = m_triangles[i];
+        for (int c = 0; c < 3; c++)
+        {
+            triangle.v0[c] = p0[c];
+            triangle.edge1[c] = p1[c] - p0[c];
+            triangle.edge2[c] = p2[c] - p0[c];
+            bounds[i].min[c] = fminf(p0[c], fminf(p1[c], p2[c]));
+            bounds[i].max[c] = fmaxf(p0[c], fmaxf(p1[c], p2[c]));
+        }
+    }
+    m_blas.Build(bounds.data(), triangleCount, BlasLeafSize);
+}
+
+void RayTracer::BuildScene(const std::vector<SwCubeInstance>& cubes)
+{
+    m_instances.resize(cubes.size());
+    std::vector<BvhBounds> bounds(cubes.size());
+    if (m_blas.IsEmpty())
+    {
+        m_tlas.Build(nullptr, 0, 1);
+        return;
+    }
+
+    const BvhNode& meshRoot = m_blas.GetNodes()[0];
+    for (size_t i = 0; i < cubes.size(); i++)
+    {
+        Instance& instance = m_instances[i];
+        for (int r = 0; r < 4; r++)
+        {
+            for (int c = 0; c < 3; c++)
+                instance.model[r][c] = cubes[i].model.m[r][c];
+        }
+        InvertAffine(instance.model, instance.inverse);
+        instance.textureIndex = cubes[i].textureIndex;
+
+        // World box around the eight transformed corners of the mesh box
+        for (int c = 0; c < 3; c++)
+        {
+            bounds[i].min[c] = FLT_MAX;
+            bounds[i].max[c] = -FLT_MAX;
+        }
+        for (int corner = 0; corner < 8; corner++)
+        {
+            float local[3] = {
+                (corner & 1) ? meshRoot.boundsMax[0] : meshRoot.boundsMin[0],
+                (corner & 2) ? meshRoot.boundsMax[1] : meshRoot.boundsMin[1],
+                (corner & 4) ? meshRoot.boundsMax[2] : meshRoot.boundsMin[2] };
+            float world[3];
+            TransformPoint(instance.model, local, world);
+            for (int c = 0; c < 3; c++)
+            {
+                bounds[i].min[c] = fminf(bounds[i].min[c], world[c]);
+                bounds[i].max[c] = fmaxf(bounds[i].max[c], world[c]);
+            }
+        }
+    }
+    m_tlas.Build(bounds.data(), static_cast<uint32_t>(bounds.size()), 1);
+}
+
+template<bool AnyHit>
+void RayTracer::TraceBlas(const RtRayPacket& objectPacket, uint32_t instance, RtHitPacket* pHit, SwFloat& tMax, SwFloat& occluded) const
+{
+    const std::vector<uint32_t>& primitives = m_blas.GetPrimitiveIndices();
+    SwFloat3 invDir = Reciprocal(objectPacket.direction);
+
+    TraversePacket(m_blas, objectPacket.origin, invDir, tMax, [&](uint32_t first, uint32_t count)
+    {
+        for (uint32_t i = first; i < first + count; i++)
+        {
+            uint32_t triangleIndex = primitives[i];
+            const MeshTriangle& triangle = m_triangles[triangleIndex];
+            SwFloat t;
+            SwFloat u;
+            SwFloat v;
+            SwFloat mask = IntersectTriangle(triangle.v0, triangle.edge1, triangle.edge2,
+                objectPacket.origin, objectPacket.direction, tMax, t, u, v);
+            int bits = _mm_movemask_ps(mask.v);
+            if (bits == 0)
+                continue;
+
+            if (AnyHit)
+            {
+                // Blocked lanes leave the traversal by dropping their interval
+                occluded = _mm_or_ps(occluded.v, mask.v);
+                tMax = Select(mask, -1.0f, tMax);
+                if (_mm_movemask_ps(_mm_cmpgt_ps(tMax.v, _mm_setzero_ps())) == 0)
+                    return true;
+                continue;
+            }
+
+            tMax = Select(mask, t, tMax);
+            pHit->t = Select(mask, t, pHit->t);
+            pHit->u = Select(mask, u, pHit->u);
+            pHit->v = Select(mask, v, pHit->v);
+            for (int lane = 0; lane < 4; lane++)
+            {
+                if (bits & (1 << lane))
+                {
+                    pHit->instance[lane] = instance;
+                    pHit->triangle[lane] = triangleIndex;
+                }
+            }
+        }
+        return false;
+    });
+}
+
+template<bool AnyHit>
+void RayTracer::TraceTlas(const RtRayPacket& packet, RtHitPacket* pHit, SwFloat& tMax, SwFloat& occluded) const
+{
+    const std::vector<uint32_t>& primitives = m_tlas.GetPrimitiveIndices();
+    SwFloat3 invDir = Reciprocal(packet.direction);
+
+    TraversePacket(m_tlas, packet.origin, invDir, tMax, [&](uint32_t first, uint32_t count)
+    {
+        for (uint32_t i = first; i < first + count; i++)
+        {
+            // The direction is not renormalized, so distances along the ray match in both spaces
+            const Instance& instance = m_instances[primitives[i]];
+            RtRayPacket objectPacket;
+            objectPacket.origin = TransformPoint(instance.inverse, packet.origin);
+            objectPacket.direction = TransformVector(instance.inverse, packet.direction);
+            objectPacket.tMax = tMax;
+            TraceBlas<AnyHit>(objectPacket, primitives[i], pHit, tMax, occluded);
+
+            if (AnyHit && _mm_movemask_ps(_mm_cmpgt_ps(tMax.v, _mm_setzero_ps())) == 0)
+                return true;
+        }
+        return false;
+    });
+}
+
+void RayTracer::Intersect(RtRayPacket& packet, RtHitPacket& hit) const
+{
+    hit.t = FLT_MAX;
+    hit.u = 0.0f;
+    hit.v = 0.0f;
+    for (int lane = 0; lane < 4; lane++)
+    {
+        hit.instance[lane] = RtNoHit;
+        hit.triangle[lane] = RtNoHit;
+    }
+
+    SwFloat occluded;
+    TraceTlas<false>(packet, &hit, packet.tMax, occluded);
+}
+
+SwFloat RayTracer::Occluded(const RtRayPacket& packet) const
+{
+    SwFloat tMax = packet.tMax;
+    SwFloat occluded;
+    TraceTlas<true>(packet, nullptr, tMax, occluded);
+    return occluded;
+}
+
+void RayTracer::GetSurfaces(const RtHitPacket& hit, RtSurface surfaces[4]) const
+{
+    alignas(16) float hitU[4];
+    alignas(16) float hitV[4];
+    _mm_store_ps(hitU, hit.u.v);
+    _mm_store_ps(hitV, hit.v.v);
+
+    for (int lane = 0; lane < 4; lane++)
+    {
+        if (hit.triangle[lane] == RtNoHit)
+            continue;
+
+        const Instance& instance = m_instances[hit.instance[lane]];
+        const MeshVertex& a = m_vertices[m_indices[hit.triangle[lane] * 3]];
+        const MeshVertex& b = m_vertices[m_indices[hit.triangle[lane] * 3 + 1]];
+        const MeshVertex& c = m_vertices[m_indices[hit.triangle[lane] * 3 + 2]];
+        float wb = hitU[lane];
+        float wc = hitV[lane];
+        float wa = 1.0f - wb - wc;
+
+        float localPosition[3];
+        float localNormal[3];
+        for (int k = 0; k < 3; k++)
+        {
+            localPosition[k] = a.position[k] * wa + b.position[k] * wb + c.position[k] * wc;
+            localNormal[k] = a.normal[k] * wa + b.normal[k] * wb + c.normal[k] * wc;
+        }
+        float u = a.uv[0] * wa + b.uv[0] * wb + c.uv[0] * wc;
+        float v = a.uv[1] * wa + b.uv[1] * wb + c.uv[1] * wc;
+
+        RtSurface& surface = surfaces[lane];
+        TransformPoint(instance.model, localPosition, surface.position);
+        TransformVector(instance.model, localNormal, surface.normal);
+        Normalize(surface.normal);
+
+        alignas(16) float diffuse[4];
+        _mm_store_ps(diffuse, m_diffuse.Sample(u, v, instance.textureIndex, 0.0f));
+        surface.albedo[0] = diffuse[0];
+        surface.albedo[1] = diffuse[1];
+        surface.albedo[2] = diffuse[2];
+    }
+}
+
+void RayTracer::ShadePacket(const RtRayPacket& packet, const RtHitPacket& hit, uint32_t threadIndex, float color[4][3])
+{
+    const SwSceneFrame& frame = *m_pFrame;
+    alignas(16) float dirX[4];
+    alignas(16) float dirY[4];
+    alignas(16) float dirZ[4];
+    alignas(16) float hitU[4];
+    alignas(16) float hitV[4];
+    _mm_store_ps(dirX, packet.direction.x.v);
+    _mm_store_ps(dirY, packet.direction.y.v);
+    _mm_store_ps(dirZ, packet.direction.z.v);
+    _mm_store_ps(hitU, hit.u.v);
+    _mm_store_ps(hitV, hit.v.v);
+
+    // Surface attributes are gathered per lane, lighting then runs four lanes at a time
+    alignas(16) float position[3][4] = {};
+    alignas(16) float geometryNormal[3][4] = {};
+    alignas(16) float normal[3][4] = {};
+    alignas(16) float albedo[3][4] = {};
+    alignas(16) uint32_t hitMask[4] = {};
+    for (int lane = 0; lane < 4; lane++)
+    {
+        if (hit.triangle[lane] == RtNoHit)
+        {
+            // SkyboxPixel.ps: the sky is infinitely far, only the direction matters
+            alignas(16) float sky[4];
+            _mm_store_ps(sky, m_skybox.SampleCube(dirX[lane], dirY[lane], dirZ[lane]));
+            color[lane][0] = sky[0];
+            color[lane][1] = sky[1];
+            color[lane][2] = sky[2];
+            continue;
+        }
+
+        const Instance& instance = m_instances[hit.instance[lane]];
+        const MeshVertex& a = m_vertices[m_indices[hit.triangle[lane] * 3]];
+        const MeshVertex& b = m_vertices[m_indices[hit.triangle[lane] * 3 + 1]];
+        const MeshVertex& c = m_vertices[m_indices[hit.triangle[lane] * 3 + 2]];
+        float wb = hitU[lane];
+        float wc = hitV[lane];
+        float wa = 1.0f - wb - wc;
+
+        float localPosition[3];
+        float localNormal[3];
+        for (int k = 0; k < 3; k++)
+        {
+            localPosition[k] = a.position[k] * wa + b.position[k] * wb + c.position[k] * wc;
+            localNormal[k] = a.normal[k] * wa + b.normal[k] * wb + c.normal[k] * wc;
+        }
+        float u = a.uv[0] * wa + b.uv[0] * wb + c.uv[0] * wc;
+        float v = a.uv[1] * wa + b.uv[1] * wb + c.uv[1] * wc;
+
+        // ColorVertex.vs tangent frame: tangent = normalize(cross(normal, (0, 0, 1)))
+        Normalize(localNormal);
+        float localTangent[3] = { 1.0f, 0.0f, 0.0f };
+        if (fabsf(localNormal[2]) <= 0.999f)
+        {
+            localTangent[0] = localNormal[1];
+            localTangent[1] = -localNormal[0];
+            localTangent[2] = 0.0f;
+            Normalize(localTangent);
+        }
+        float localBitangent[3] = {
+            localNormal[1] * localTangent[2] - localNormal[2] * localTangent[1],
+            localNormal[2] * localTangent[0] - localNormal[0] * localTangent[2],
+            localNormal[0] * localTangent[1] - localNormal[1] * localTangent[0] };
+
+        float worldPosition[3];
+        float worldNormal[3];
+        float tangent[3];
+        float bitangent[3];
+        TransformPoint(instance.model, localPosition, worldPosition);
+        TransformVector(instance.model, localNormal, worldNormal);
+        TransformVector(instance.model, localTangent, tangent);
+        TransformVector(instance.model, localBitangent, bitangent);
+        Normalize(worldNormal);
+        Normalize(tangent);
+        Normalize(bitangent);
+
+        // CalculateNormalFromMap, top mip: supersampling does the filtering
+        alignas(16) float mapped[4];
+        _mm_store_ps(mapped, m_normalMap.Sample(u, v, 0, 0.0f));
+        float mapX = mapped[0] * 2.0f - 1.0f;
+        float mapY = mapped[1] * 2.0f - 1.0f;
+        float tangentNormal[3] = { mapX, mapY, sqrtf(fmaxf(1.0f - mapX * mapX - mapY * mapY, 0.0f)) };
+        Normalize(tangentNormal);
+        float shadingNormal[3];
+        for (int k = 0; k < 3; k++)
+            shadingNormal[k] = tangent[k] * tangentNormal[0] + bitangent[k] * tangentNormal[1] + worldNormal[k] * tangentNormal[2];
+        Normalize(shadingNormal);
+
+        alignas(16) float diffuse[4];
+        _mm_store_ps(diffuse, m_diffuse.Sample(u, v, instance.textureIndex, 0.0f));
+
+        for (int k = 0; k < 3; k++)
+        {
+            position[k][lane] = worldPosition[k];
+            geometryNormal[k][lane] = worldNormal[k];
+            normal[k][lane] = shadingNormal[k];
+            albedo[k][lane] = diffuse[k];
+        }
+        hitMask[lane] = 0xFFFFFFFFu;
+    }
+
+    SwFloat surfaceMask = _mm_castsi128_ps(_mm_load_si128(reinterpret_cast<const __m128i*>(hitMask)));
+    if (_mm_movemask_ps(surfaceMask.v) == 0)
+        return;
+
+    SwFloat3 worldPos(_mm_load_ps(position[0]), _mm_load_ps(position[1]), _mm_load_ps(position[2]));
+    SwFloat3 faceNormal(_mm_load_ps(geometryNormal[0]), _mm_load_ps(geometryNormal[1]), _mm_load_ps(geometryNormal[2]));
+    SwFloat3 n(_mm_load_ps(normal[0]), _mm_load_ps(normal[1]), _mm_load_ps(normal[2]));
+    SwFloat3 camera(frame.cameraPos.x, frame.cameraPos.y, frame.cameraPos.z);
+    SwFloat3 viewDir = Normalize(camera - worldPos);
+    SwFloat3 lightColor(0.0f, 0.0f, 0.0f);
+
+    // Shadow rays leave from the side of the surface the camera sees
+    SwFloat side = Select(_mm_cmplt_ps(Dot(faceNormal, packet.direction).v, _mm_setzero_ps()), 1.0f, -1.0f);
+    SwFloat3 shadowOrigin = worldPos + faceNormal * (side * ShadowBias);
+
+    for (int i = 0; i < 3; i++)
+    {
+        // ColorPixel.ps
+        const SwPointLight& light = frame.lights[i];
+        SwFloat3 lightPos(light.position.x, light.position.y, light.position.z);
+        SwFloat3 toLight = lightPos - worldPos;
+        SwFloat distance = Length(toLight);
+        SwFloat3 lightDir = toLight * (SwFloat(1.0f) / distance);
+        SwFloat attenuation = SwFloat(1.0f) - Saturate(distance * (1.0f / light.range));
+        SwFloat diff = Max(Dot(n, lightDir), 0.0f);
+        SwFloat3 halfwayDir = Normalize(lightDir + viewDir);
+
+        SwFloat spec = Max(Dot(n, halfwayDir), 0.0f);
+        spec = spec * spec;
+        spec = spec * spec;
+        spec = spec * spec;
+        spec = spec * spec;
+        spec = spec * spec;
+
+        SwFloat scale = (diff + spec) * attenuation * light.intensity;
+        SwFloat lit = _mm_and_ps(surfaceMask.v, _mm_cmpgt_ps(scale.v, _mm_setzero_ps()));
+        int litBits = _mm_movemask_ps(lit.v);
+        if (litBits == 0)
+            continue;
+
+        if (m_settings.shadows)
+        {
+            RtRayPacket shadow;
+            shadow.origin = shadowOrigin;
+            shadow.direction = lightPos - shadowOrigin;
+            shadow.tMax = Select(lit, 1.0f - HitEpsilon, -1.0f);
+            lit = _mm_andnot_ps(Occluded(shadow).v, lit.v);
+
+            for (int lane = 0; lane < 4; lane++)
+                m_rayCounters[threadIndex].rays += (litBits >> lane) & 1;
+        }
+
+        scale = Select(lit, scale, 0.0f);
+        lightColor = lightColor + SwFloat3(light.color.x, light.color.y, light.color.z) * scale;
+    }
+
+    alignas(16) float litR[4];
+    alignas(16) float litG[4];
+    alignas(16) float litB[4];
+    _mm_store_ps(litR, (lightColor.x * _mm_load_ps(albedo[0])).v);
+    _mm_store_ps(litG, (lightColor.y * _mm_load_ps(albedo[1])).v);
+    _mm_store_ps(litB, (lightColor.z * _mm_load_ps(albedo[2])).v);
+    for (int lane = 0; lane < 4; lane++)
+    {
+        if (hit.triangle[lane] == RtNoHit)
+            continue;
+        color[lane][0] = litR[lane];
+        color[lane][1] = litG[lane];
+        color[lane][2] = litB[lane];
+    }
+}
+
+void RayTracer::RenderTile(uint32_t tile, uint32_t threadIndex)
+{
+    const SwSceneFrame& frame = *m_pFrame;
+    uint32_t tilesX = (m_width + TileSize - 1) / TileSize;
+    uint32_t x0 = (tile % tilesX) * TileSize;
+    uint32_t y0 = (tile / tilesX) * TileSize;
+
+    float accumulated[TileSize * TileSize][3] = {};
+    uint32_t samples = m_settings.samplesPerPixel > 0 ? m_settings.samplesPerPixel : 1;
+
+    const float (*invViewProj)[4] = frame.invViewProj.m;
+    for (uint32_t y = y0; y < y0 + TileSize && y < m_height; y += 2)
+    {
+        for (uint32_t x = x0; x < x0 + TileSize && x < m_width; x += 2)
+        {
+            alignas(16) float pixelX[4] = { x + 0.0f, x + 1.0f, x + 0.0f, x + 1.0f };
+            alignas(16) float pixelY[4] = { y + 0.0f, y + 0.0f, y + 1.0f, y + 1.0f };
+            alignas(16) float active[4];
+            for (int lane = 0; lane < 4; lane++)
+                active[lane] = pixelX[lane] < m_width && pixelY[lane] < m_height ? 1.0f : -1.0f;
+
+            for (uint32_t s = 0; s < samples; s++)
+            {
+                // One sample through the pixel centre, random positions inside the pixel beyond that
+                alignas(16) float ndcX[4];
+                alignas(16) float ndcY[4];
+                for (int lane = 0; lane < 4; lane++)
+                {
+                    uint32_t seed = Hash((static_cast<uint32_t>(pixelY[lane]) * m_width + static_cast<uint32_t>(pixelX[lane])) * 0x9E3779B9u + s);
+                    float jitterX = samples > 1 ? ToUnitFloat(seed) : 0.5f;
+                    float jitterY = samples > 1 ? ToUnitFloat(Hash(seed)) : 0.5f;
+                    ndcX[lane] = (pixelX[lane] + jitterX) / m_width * 2.0f - 1.0f;
+                    ndcY[lane] = 1.0f - (pixelY[lane] + jitterY) / m_height * 2.0f;
+                }
+
+                // Points on the near and far planes, back through the inverse view-projection
+                SwFloat sx = _mm_load_ps(ndcX);
+                SwFloat sy = _mm_load_ps(ndcY);
+                SwFloat3 nearPoint;
+                SwFloat3 farPoint;
+                {
+                    SwFloat w = sx * invViewProj[0][3] + sy * invViewProj[1][3] + invViewProj[3][3];
+                    SwFloat invW = SwFloat(1.0f) / w;
+                    nearPoint = SwFloat3(
+                        (sx * invViewProj[0][0] + sy * invViewProj[1][0] + invViewProj[3][0]) * invW,
+                        (sx * invViewProj[0][1] + sy * invViewProj[1][1] + invViewProj[3][1]) * invW,
+                        (sx * invViewProj[0][2] + sy * invViewProj[1][2] + invViewProj[3][2]) * invW);
+
+                    w = sx * invViewProj[0][3] + sy * invViewProj[1][3] + invViewProj[2][3] + invViewProj[3][3];
+                    invW = SwFloat(1.0f) / w;
+                    farPoint = SwFloat3(
+                        (sx * invViewProj[0][0] + sy * invViewProj[1][0] + invViewProj[2][0] + invViewProj[3][0]) * invW,
+                        (sx * invViewProj[0][1] + sy * invViewProj[1][1] + invViewProj[2][1] + invViewProj[3][1]) * invW,
+                        (sx * invViewProj[0][2] + sy * invViewProj[1][2] + invViewProj[2][2] + invViewProj[3][2]) * invW);
+                }
+
+                RtRayPacket packet;
+                packet.origin = nearPoint;
+                packet.direction = Normalize(farPoint - nearPoint);
+                packet.tMax = Select(_mm_cmpgt_ps(_mm_load_ps(active), _mm_setzero_ps()), FLT_MAX, -1.0f);
+
+                RtHitPacket hit;
+                Intersect(packet, hit);
+
+                float color[4][3];
+                ShadePacket(packet, hit, threadIndex, color);
+                for (int lane = 0; lane < 4; lane++)
+                {
+                    if (active[lane] < 0.0f)
+                        continue;
+                    m_rayCounters[threadIndex].rays++;
+                    uint32_t local = (static_cast<uint32_t>(pixelY[lane]) - y0) * TileSize + (static_cast<uint32_t>(pixelX[lane]) - x0);
+                    for (int c = 0; c < 3; c++)
+                        accumulated[local][c] += color[lane][c];
+                }
+            }
+        }
+    }
+
+    float invSamples = 1.0f / samples;
+    for (uint32_t y = y0; y < y0 + TileSize && y < m_height; y++)
+    {
+        for (uint32_t x = x0; x < x0 + TileSize && x < m_width; x++)
+        {
+            const float* pColor = accumulated[(y - y0) * TileSize + (x - x0)];
+            uint32_t texel = 0xFF000000u;
+            for (int c = 0; c < 3; c++)
+            {
+                float value = pColor[c] * invSamples;
+                value = value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+                texel |= static_cast<uint32_t>(value * 255.0f + 0.5f) << (c * 8);
+            }
+            m_image[y * m_width + x] = texel;
+        }
+    }
+}
+
+void RayTracer::Render(const SwSceneFrame& frame, uint32_t width, uint32_t height, const RtSettings& settings)
+{
+    PROFILE_SCOPE("Ray Trace");
+
+    BuildScene(frame.sceneCubes);
+    m_pFrame = &frame;
+    m_settings = settings;
+    m_width = width;
+    m_height = height;
+    m_image.assign(static_cast<size_t>(width) * height, 0xFF000000u);
+
+    uint32_t threadCount = m_pPool ? m_pPool->GetThreadCount() : 1;
+    m_rayCounters.assign(threadCount, RayCounter());
+
+    uint32_t tileCount = ((width + TileSize - 1) / TileSize) * ((height + TileSize - 1) / TileSize);
+    if (m_pPool)
+        m_pPool->ParallelFor(tileCount, [this](uint32_t tile, uint32_t threadIndex) { RenderTile(tile, threadIndex); });
+    else
+    {
+        for (uint32_t tile = 0; tile < tileCount; tile++)
+            RenderTile(tile, 0);
+    }
+    m_pFrame = nullptr;
+}
+
+RtBenchmarkResult RayTracer::Benchmark(const SwSceneFrame& frame, uint32_t width, uint32_t height, const RtSettings& settings)
+{
+    uint64_t start = Profiler::NowNs();
+    Render(frame, width, height, settings);
+    uint64_t elapsed = Profiler::NowNs() - start;
+
+    RtBenchmarkResult result = {};
+    result.width = width;
+    result.height = height;
+    result.samplesPerPixel = settings.samplesPerPixel;
+    result.threads = static_cast<uint32_t>(m_rayCounters.size());
+    for (const auto& counter : m_rayCounters)
+        result.rays += counter.rays;
+    result.seconds = elapsed * 1.0e-9;
+    result.raysPerSecond = result.seconds > 0.0 ? result.rays / result.seconds : 0.0;
+    result.raysPerSecondPerCore = result.threads > 0 ? result.raysPerSecond / result.threads : 0.0;
+    return result;
+}
+
+bool RayTracer::SaveImage(const char* path) const
+{
+    if (m_image.empty())
+        return false;
+
+    FILE* file = nullptr;
+#ifdef _MSC_VER
+    if (fopen_s(&file, path, "wb") != 0)
+        file = nullptr;
+#else
+    file = fopen(path, "wb");
+#endif
+    if (!file)
+        return false;
+
+    // Bottom-up BGR rows padded to four bytes
+    uint32_t rowSize = (m_width * 3 + 3) & ~3u;
+    uint32_t imageSize = rowSize * m_height;
+    unsigned char header[54] = {};
+    header[0] = 'B';
+    header[1] = 'M';
+    PutU32(header + 2, 54 + imageSize);
+    PutU32(header + 10, 54);
+    PutU32(header + 14, 40);
+    PutU32(header + 18, m_width);
+    PutU32(header + 22, m_height);
+    PutU16(header + 26, 1);
+    PutU16(header + 28, 24);
+    PutU32(header + 34, imageSize);
+    PutU32(header + 38, 2835);
+    PutU32(header + 42, 2835);
+
+    bool ok = fwrite(header, 1, sizeof(header), file) == sizeof(header);
+    std::vector<unsigned char> row(rowSize, 0);
+    for (uint32_t y = 0; y < m_height && ok; y++)
+    {
+        const uint32_t* pSource = &m_image[(m_height - 1 - y) * m_width];
+        for (uint32_t x = 0; x < m_width; x++)
+        {
+            row[x * 3] = static_cast<unsigned char>(pSource[x] >> 16);
+            row[x * 3 + 1] = static_cast<unsigned char>(pSource[x] >> 8);
+            row[x * 3 + 2] = static_cast<unsigned char>(pSource[x]);
+        }
+        ok = fwrite(row.data(), 1, rowSize, file) == rowSize;
+    }
+    fclose(file);
+    return ok;
+}
@@ -0,0 +1,148 @@
+#ifndef RAY_TRACER_H
+#define RAY_TRACER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "Bvh.h"
+#include "SoftwareRenderer.h"
+
+// Four rays traced together, one per SSE lane. Lanes with tMax <= 0 are inactive.
+struct RtRayPacket
+{
+    SwFloat3 origin;
+    SwFloat3 direction;
+    SwFloat tMax;
+};
+
+struct RtHitPacket
+{
+    SwFloat t;
+    SwFloat u;
+    SwFloat v;
+    uint32_t instance[4];
+    uint32_t triangle[4];   // RtNoHit when the lane missed
+};
+
+const uint32_t RtNoHit = 0xFFFFFFFFu;
+
+// World space attributes of a hit, without normal mapping
+struct RtSurface
+{
+    float position[3];
+    float normal[3];
+    float albedo[3];
+};
+
+struct RtSettings
+{
+    uint32_t samplesPerPixel;
+    bool shadows;
+};
+
+struct RtBenchmarkResult
+{
+    uint32_t width;
+    uint32_t height;
+    uint32_t samplesPerPixel;
+    uint32_t threads;
+    uint64_t rays;          // camera and shadow rays
+    double seconds;
+    double raysPerSecond;
+    double raysPerSecondPerCore;
+};
+
+// Reference renderer for the Lab8 scene: the cubes of SwSceneFrame::sceneCubes lit by the
+// point lights with ColorPixel.ps shading plus shadow rays, and the skybox behind them.
+// The scene is a two-level BVH (one bottom level for the cube mesh, a top level over the
+// instances); 2x2 pixel packets are traced with SSE and image tiles run on the thread pool.
+// Light markers and the transparent parallelograms are debug geometry and are not traced.
+class RayTracer
+{
+public:
+    static const uint32_t TileSize = 16;
+
+    RayTracer() : m_pPool(nullptr), m_pFrame(nullptr), m_settings(), m_width(0), m_height(0) {}
+
+    bool Init(ThreadPool* pPool);
+    void SetMesh(const SwMeshData& data);
+
+    void Render(const SwSceneFrame& frame, uint32_t width, uint32_t height, const RtSettings& settings);
+    RtBenchmarkResult Benchmark(const SwSceneFrame& frame, uint32_t width, uint32_t height, const RtSettings& settings);
+    // Uncompressed 24-bit BMP of the last render
+    bool SaveImage(const char* path) const;
+
+    // Render builds the scene from the frame; other users trace against it directly
+    void BuildScene(const std::vector<SwCubeInstance>& cubes);
+    // Closest hit, narrowing tMax of the packet to it
+    void Intersect(RtRayPacket& packet, RtHitPacket& hit) const;
+    // Lanes blocked before their tMax come back as all-ones masks
+    SwFloat Occluded(const RtRayPacket& packet) const;
+    // Fills the surfaces of the lanes that hit, others are left untouched
+    void GetSurfaces(const RtHitPacket& hit, RtSurface surfaces[4]) const;
+
+    // RGBA8 with R in the low byte, tightly packed rows
+    const std::vector<uint32_t>& GetImage() const { return m_image; }
+    uint32_t GetWidth() const { return m_width; }
+    uint32_t GetHeight() const { return m_height; }
+
+private:
+    struct Instance
+    {
+        float model[4][3];      // object to world, row vectors like the shaders
+        float inverse[4][3];    // world to object
+        uint32_t textureIndex;
+    };
+
+    struct MeshTriangle
+    {
+        float v0[3];
+        float edge1[3];
+        float edge2[3];
+    };
+
+    struct MeshVertex
+    {
+        float position[3];
+        float normal[3];
+        float uv[2];
+    };
+
+    // Per-thread counters on their own cache lines
+    struct alignas(64) RayCounter
+    {
+        uint64_t rays;
+    };
+
+    template<bool AnyHit>
+    void TraceTlas(const RtRayPacket& packet, RtHitPacket* pHit, SwFloat& tMax, SwFloat& occluded) const;
+    template<bool AnyHit>
+    void TraceBlas(const RtRayPacket& objectPacket, uint32_t instance, RtHitPacket* pHit, SwFloat& tMax, SwFloat& occluded) const;
+
+    void RenderTile(uint32_t tile, uint32_t threadIndex);
+    void ShadePacket(const RtRayPacket& packet, const RtHitPacket& hit, uint32_t threadIndex, float color[4][3]);
+
+    ThreadPool* m_pPool;
+
+    std::vector<MeshVertex> m_vertices;
+    std::vector<uint16_t> m_indices;
+    std::vector<MeshTriangle> m_triangles;
+    Bvh m_blas;
+
+    std::vector<Instance> m_instances;
+    Bvh m_tlas;
+
+    SoftwareTexture m_diffuse;
+    SoftwareTexture m_normalMap;
+    SoftwareTexture m_skybox;
+
+    // State of the render in progress, read by the tile tasks
+    const SwSceneFrame* m_pFrame;
+    RtSettings m_settings;
+    uint32_t m_width;
+    uint32_t m_height;
+    std::vector<uint32_t> m_image;
+    std::vector<RayCounter> m_rayCounters;
+};
+
+#endif
@@ -0,0 +1,338 @@
+#include "ReflectionProbeBaker.h"
+#include "Profiler.h"
+#include "ThreadPool.h"
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+
+namespace
+{
+    const float RayBias = 1.0e-3f;
+
+    // Direction through face coordinates sc, tc in [-1, 1], as in EnvironmentLighting
+    SwFloat3 FaceDirection(uint32_t face, const SwFloat& sc, const SwFloat& tc)
+    {
+        SwFloat one(1.0f);
+        SwFloat minusOne(-1.0f);
+        SwFloat zero(0.0f);
+        switch (face)
+        {
+        case 0: return SwFloat3(one, zero - tc, zero - sc);
+        case 1: return SwFloat3(minusOne, zero - tc, sc);
+        case 2: return SwFloat3(sc, one, tc);
+        case 3: return SwFloat3(sc, minusOne, zero - tc);
+        case 4: return SwFloat3(sc, zero - tc, one);
+        default: return SwFloat3(zero - sc, zero - tc, minusOne);
+        }
+    }
+
+    // EvaluateSH of EnvironmentLighting.hlsli
+    void EvaluateSH(const XMFLOAT4 sh[9], const float n[3], float out[3])
+    {
+        float basis[9] = {
+            0.282095f,
+            0.488603f * n[1],
+            0.488603f * n[2],
+            0.488603f * n[0],
+            1.092548f * n[0] * n[1],
+            1.092548f * n[1] * n[2],
+            0.315392f * (3.0f * n[2] * n[2] - 1.0f),
+            1.092548f * n[0] * n[2],
+            0.546274f * (n[0] * n[0] - n[1] * n[1]) };
+        out[0] = out[1] = out[2] = 0.0f;
+        for (int i = 0; i < 9; i++)
+        {
+            out[0] += sh[i].x * basis[i];
+            out[1] += sh[i].y * basis[i];
+            out[2] += sh[i].z * basis[i];
+        }
+        for (int k = 0; k < 3; k++)
+            out[k] = out[k] > 0.0f ? out[k] : 0.0f;
+    }
+
+    uint32_t LaneCount(const SwFloat& mask)
+    {
+        int bits = _mm_movemask_ps(mask.v);
+        return (bits & 1) + ((bits >> 1) & 1) + ((bits >> 2) & 1) + ((bits >> 3) & 1);
+    }
+}
+
+ReflectionProbeBaker::ReflectionProbeBaker()
+    : m_pPool(nullptr),
+    m_lights(),
+    m_skySH(),
+    m_running(false),
+    m_cancel(false),
+    m_succeeded(false),
+    m_probesDone(0),
+    m_rays(0),
+    m_renderNs(0),
+    m_prefilterNs(0),
+    m_startNs(0),
+    m_endNs(0)
+{
+}
+
+ReflectionProbeBaker::~ReflectionProbeBaker()
+{
+    Cancel();
+}
+
+bool ReflectionProbeBaker::Init(ThreadPool* pPool)
+{
+    m_pPool = pPool;
+    if (!m_tracer.Init(pPool))
+        return false;
+    return m_skybox.LoadDDS("skybox.dds", pPool) && m_skybox.IsCube();
+}
+
+void ReflectionProbeBaker::SetMesh(const SwMeshData& data)
+{
+    m_tracer.SetMesh(data);
+}
+
+std::string ReflectionProbeBaker::GetPath(const char* pathFormat, uint32_t probe)
+{
+    char path[260];
+    snprintf(path, sizeof(path), pathFormat, probe);
+    return path;
+}
+
+bool ReflectionProbeBaker::Start(const SwSceneFrame& frame, const XMFLOAT4 skySH[9], const std::vector<XMFLOAT3>& positions,
+    const char* pathFormat)
+{
+    if (m_running.load() || positions.empty() || positions.size() > MaxProbes)
+        return false;
+    if (m_thread.joinable())
+        m_thread.join();
+
+    m_cubes = frame.sceneCubes;
+    for (int i = 0; i < 3; i++)
+        m_lights[i] = frame.lights[i];
+    for (int i = 0; i < 9; i++)
+        m_skySH[i] = skySH[i];
+    m_positions = positions;
+    m_pathFormat = pathFormat;
+    m_tracer.BuildScene(m_cubes);
+
+    m_cancel = false;
+    m_succeeded = false;
+    m_probesDone = 0;
+    m_rays = 0;
+    m_renderNs = 0;
+    m_prefilterNs = 0;
+    m_startNs = Profiler::NowNs();
+    m_endNs = 0;
+    m_running = true;
+    m_thread = std::thread(&ReflectionProbeBaker::BakeAll, this);
+    return true;
+}
+
+void ReflectionProbeBaker::Cancel()
+{
+    m_cancel = true;
+    if (m_thread.joinable())
+        m_thread.join();
+}
+
+bool ReflectionProbeBaker::PollFinished()
+{
+    if (m_running.load() || !m_thread.joinable())
+        return false;
+    m_thread.join();
+    return m_succeeded.load();
+}
+
+ReflectionBakeStats ReflectionProbeBaker::GetStats() const
+{
+    ReflectionBakeStats stats = {};
+    stats.probes = static_cast<uint32_t>(m_positions.size());
+    stats.probesDone = m_probesDone.load();
+    stats.rays = m_rays.load();
+    stats.threads = m_pPool ? m_pPool->GetThreadCount() : 1;
+    stats.renderSeconds = m_renderNs.load() * 1.0e-9;
+    stats.prefilterSeconds = m_prefilterNs.load() * 1.0e-9;
+
+    uint64_t start = m_startNs.load();
+    uint64_t end = m_endNs.load();
+    if (start == 0)
+        return stats;
+    if (end == 0)
+        end = Profiler::NowNs();
+    stats.seconds = (end - start) * 1.0e-9;
+    return stats;
+}
+
+void ReflectionProbeBaker::BakeAll()
+{
+    Profiler::Get().SetThreadName("Reflection Baker");
+    // Also covers the prefilter, which submits to the same pool from this thread
+    ThreadPool::SetThreadPriority(ThreadPool::Priority::Background);
+
+    bool ok = true;
+    EnvironmentLighting prefilter;
+    prefilter.SetThreadPool(m_pPool);
+    for (std::vector<float>& face : m_faces)
+        face.assign(static_cast<size_t>(FaceSize) * FaceSize * 4, 0.0f);
+
+    for (uint32_t probe = 0; probe < m_positions.size() && ok && !m_cancel.load(); probe++)
+    {
+        PROFILE_SCOPE("Bake Reflection Probe");
+
+        // The rows of all six faces are independent, one batch keeps every thread busy
+        uint64_t renderStart = Profiler::NowNs();
+        auto task = [this, probe](uint32_t index, uint32_t)
+        {
+            RenderRow(probe, index / FaceSize, index % FaceSize);
+        };
+        if (m_pPool)
+            m_pPool->ParallelFor(6 * FaceSize, task);
+        else
+        {
+            for (uint32_t index = 0; index < 6 * FaceSize; index++)
+                task(index, 0);
+        }
+        uint64_t prefilterStart = Profiler::NowNs();
+        m_renderNs += prefilterStart - renderStart;
+        if (m_cancel.load())
+            break;
+
+        ok = prefilter.SetSource(FaceSize, m_faces);
+        if (ok)
+        {
+            prefilter.Compute();
+            ok = prefilter.SavePrefilteredDDS(GetPath(m_pathFormat.c_str(), probe).c_str());
+        }
+        m_prefilterNs += Profiler::NowNs() - prefilterStart;
+        if (ok)
+            m_probesDone++;
+    }
+
+    m_succeeded = ok && !m_cancel.load();
+    m_endNs = Profiler::NowNs();
+    m_running = false;
+}
+
+void ReflectionProbeBaker::RenderRow(uint32_t probe, uint32_t face, uint32_t row)
+{
+    const XMFLOAT3& position = m_positions[probe];
+    const float texelScale = 2.0f / FaceSize;
+    const SwFloat tc((row + 0.5f) * texelScale - 1.0f);
+    float* pDest = m_faces[face].data() + static_cast<size_t>(row) * FaceSize * 4;
+    uint64_t rays = 0;
+
+    for (uint32_t x = 0; x < FaceSize; x += 4)
+    {
+        // Four neighbouring texels of the row form one packet from the probe centre
+        SwFloat sc = _mm_add_ps(_mm_set1_ps((x + 0.5f) * texelScale - 1.0f),
+            _mm_mul_ps(_mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f), _mm_set1_ps(texelScale)));
+        RtRayPacket packet;
+        packet.origin = SwFloat3(position.x, position.y, position.z);
+        packet.direction = Normalize(FaceDirection(face, sc, tc));
+        packet.tMax = SwFloat(FLT_MAX);
+        RtHitPacket hit;
+        m_tracer.Intersect(packet, hit);
+        rays += 4;
+
+        RtSurface surfaces[4];
+        m_tracer.GetSurfaces(hit, surfaces);
+        alignas(16) float dirX[4];
+        alignas(16) float dirY[4];
+        alignas(16) float dirZ[4];
+        _mm_store_ps(dirX, packet.direction.x.v);
+        _mm_store_ps(dirY, packet.direction.y.v);
+        _mm_store_ps(dirZ, packet.direction.z.v);
+
+        alignas(16) float hitPosition[3][4] = {};
+        alignas(16) float hitNormal[3][4] = {};
+        alignas(16) uint32_t hitMask[4] = {};
+        float color[4][3] = {};
+        for (int lane = 0; lane < 4; lane++)
+        {
+            if (hit.triangle[lane] == RtNoHit)
+            {
+                // SkyboxPixel.ps: the sky is infinitely far, only the direction matters
+                alignas(16) float sky[4];
+                _mm_store_ps(sky, m_skybox.SampleCube(dirX[lane], dirY[lane], dirZ[lane]));
+                for (int k = 0; k < 3; k++)
+                    color[lane][k] = sky[k];
+                continue;
+            }
+
+            // Ambient part of ColorPixel.ps from the skybox SH, on the side facing the probe
+            const RtSurface& surface = surfaces[lane];
+            float facing = surface.normal[0] * dirX[lane] + surface.normal[1] * dirY[lane] + surface.normal[2] * dirZ[lane];
+            float side = facing > 0.0f ? -1.0f : 1.0f;
+            float normal[3] = { surface.normal[0] * side, surface.normal[1] * side, surface.normal[2] * side };
+            float ambient[3];
+            EvaluateSH(m_skySH, normal, ambient);
+            for (int k = 0; k < 3; k++)
+            {
+                hitPosition[k][lane] = surface.position[k];
+                hitNormal[k][lane] = normal[k];
+                color[lane][k] = ambient[k];
+            }
+            hitMask[lane] = 0xFFFFFFFFu;
+        }
+
+        SwFloat active = _mm_castsi128_ps(_mm_load_si128(reinterpret_cast<const __m128i*>(hitMask)));
+        if (_mm_movemask_ps(active.v) != 0)
+        {
+            SwFloat3 pos(_mm_load_ps(hitPosition[0]), _mm_load_ps(hitPosition[1]), _mm_load_ps(hitPosition[2]));
+            SwFloat3 n(_mm_load_ps(hitNormal[0]), _mm_load_ps(hitNormal[1]), _mm_load_ps(hitNormal[2]));
+            SwFloat3 direct = DirectLight(pos, n, active, rays);
+            for (int lane = 0; lane < 4; lane++)
+            {
+                if (!hitMask[lane])
+                    continue;
+                color[lane][0] = (color[lane][0] + direct.x[lane]) * surfaces[lane].albedo[0];
+                color[lane][1] = (color[lane][1] + direct.y[lane]) * surfaces[lane].albedo[1];
+                color[lane][2] = (color[lane][2] + direct.z[lane]) * surfaces[lane].albedo[2];
+            }
+        }
+
+        for (int lane = 0; lane < 4; lane++)
+        {
+            float* pTexel = pDest + (x + lane) * 4;
+            pTexel[0] = color[lane][0];
+            pTexel[1] = color[lane][1];
+            pTexel[2] = color[lane][2];
+            pTexel[3] = 1.0f;
+        }
+    }
+
+    m_rays += rays;
+}
+
+SwFloat3 ReflectionProbeBaker::DirectLight(const SwFloat3& position, const SwFloat3& normal, const SwFloat& mask, uint64_t& rays) const
+{
+    SwFloat3 result(0.0f, 0.0f, 0.0f);
+    SwFloat3 shadowOrigin = position + normal * SwFloat(RayBias);
+
+    for (int i = 0; i < 3; i++)
+    {
+        // Diffuse term of ColorPixel.ps, as LightmapBaker bakes it
+        const SwPointLight& light = m_lights[i];
+        SwFloat3 lightPos(light.position.x, light.position.y, light.position.z);
+        SwFloat3 toLight = lightPos - position;
+        SwFloat distance = Length(toLight);
+        SwFloat3 lightDir = toLight * (SwFloat(1.0f) / distance);
+        SwFloat attenuation = SwFloat(1.0f) - Saturate(distance * (1.0f / light.range));
+        SwFloat scale = Max(Dot(normal, lightDir), 0.0f) * attenuation * light.intensity;
+
+        SwFloat lit = _mm_and_ps(mask.v, _mm_cmpgt_ps(scale.v, _mm_setzero_ps()));
+        if (_mm_movemask_ps(lit.v) == 0)
+            continue;
+
+        RtRayPacket shadow;
+        shadow.origin = shadowOrigin;
+        shadow.direction = lightDir;
+        shadow.tMax = Select(lit, distance - RayBias, 0.0f);
+        SwFloat visible = _mm_andnot_ps(m_tracer.Occluded(shadow).v, lit.v);
+        rays += LaneCount(lit);
+
+        scale = _mm_and_ps(visible.v, scale.v);
+        result = result + SwFloat3(light.color.x, light.color.y, light.color.z) * scale;
+    }
+    return result;
+}
@@ -0,0 +1,87 @@
+#ifndef REFLECTION_PROBE_BAKER_H
+#define REFLECTION_PROBE_BAKER_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "EnvironmentLighting.h"
+#include "RayTracer.h"
+
+struct ReflectionBakeStats
+{
+    uint32_t probes;
+    uint32_t probesDone;
+    uint64_t rays;              // camera and shadow rays of the face renders so far
+    uint32_t threads;
+    double renderSeconds;       // ray traced faces
+    double prefilterSeconds;    // mips, GGX prefilter and the DDS write
+    double seconds;
+};
+
+// Offline baker for placeable reflection probes. Each probe renders the six faces of a cube
+// map around its position with RayTracer packets, one texel per ray: cubes get their albedo
+// lit by the point lights (with shadow rays) and by the skybox irradiance, rays that escape
+// see the skybox. The faces are then prefiltered for GGX by EnvironmentLighting and saved
+// as an RGBA16F cube map DDS with the same mips as the skybox's prefiltered cube, so the
+// runtime can put the probes in one cube array next to each other.
+// Baking runs on a background thread; the rows of all six faces are traced in one batch on
+// the thread pool and the prefilter spreads the rows of all faces and mips in the same way.
+class ReflectionProbeBaker
+{
+public:
+    static const uint32_t FaceSize = EnvironmentLighting::MaxPrefilteredSize;
+    static const uint32_t MaxProbes = 8;
+
+    ReflectionProbeBaker();
+    ~ReflectionProbeBaker();
+
+    bool Init(ThreadPool* pPool);
+    void SetMesh(const SwMeshData& data);
+
+    // Bakes frame.sceneCubes lit by frame.lights and the sky from every position into
+    // pathFormat with %u replaced by the probe index; skySH as EnvironmentLighting::GetIrradianceSH
+    bool Start(const SwSceneFrame& frame, const XMFLOAT4 skySH[9], const std::vector<XMFLOAT3>& positions, const char* pathFormat);
+    void Cancel();
+    bool IsRunning() const { return m_running.load(); }
+    // True once for every bake that wrote all of its files, after it finished
+    bool PollFinished();
+    // Positions of the last Start, in file order
+    const std::vector<XMFLOAT3>& GetPositions() const { return m_positions; }
+    static std::string GetPath(const char* pathFormat, uint32_t probe);
+
+    // Safe to call while a bake runs
+    ReflectionBakeStats GetStats() const;
+
+private:
+    void BakeAll();
+    void RenderRow(uint32_t probe, uint32_t face, uint32_t row);
+    SwFloat3 DirectLight(const SwFloat3& position, const SwFloat3& normal, const SwFloat& mask, uint64_t& rays) const;
+
+    ThreadPool* m_pPool;
+    RayTracer m_tracer;
+    SoftwareTexture m_skybox;
+
+    // Copy of the scene being baked, owned by the bake thread while it runs
+    std::vector<SwCubeInstance> m_cubes;
+    SwPointLight m_lights[3];
+    XMFLOAT4 m_skySH[9];
+    std::vector<XMFLOAT3> m_positions;
+    std::string m_pathFormat;
+    std::vector<float> m_faces[6];      // RGBA of the probe in progress
+
+    std::thread m_thread;
+    std::atomic<bool> m_running;
+    std::atomic<bool> m_cancel;
+    std::atomic<bool> m_succeeded;
+    std::atomic<uint32_t> m_probesDone;
+    std::atomic<uint64_t> m_rays;
+    std::atomic<uint64_t> m_renderNs;
+    std::atomic<uint64_t> m_prefilterNs;
+    std::atomic<uint64_t> m_startNs;
+    std::atomic<uint64_t> m_endNs;
+};
+
+#endif
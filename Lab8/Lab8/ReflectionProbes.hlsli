@@ -0,0 +1,24 @@
+// Reflection probes baked by ReflectionProbeBaker, blended per instance on the CPU
+
+cbuffer ReflectionProbeBuffer : register(b7)
+{
+    float4 reflectionSettings;          // probe count, mip count
+    float4 instanceReflection[23];      // nearest probe, second probe, weight of the nearest
+};
+
+// Every probe is prefiltered like prefilteredEnvironment: mip m holds roughness m / (mipCount - 1)
+TextureCubeArray reflectionProbes : register(t11);
+
+bool ReflectionProbesEnabled()
+{
+    return reflectionSettings.x > 0.0f;
+}
+
+float3 SampleReflectionProbes(uint instance, float3 direction, float roughness, SamplerState linearSampler)
+{
+    float4 probes = instanceReflection[instance];
+    float lod = roughness * max(reflectionSettings.y - 1.0f, 0.0f);
+    float3 nearest = reflectionProbes.SampleLevel(linearSampler, float4(direction, probes.x), lod).rgb;
+    float3 second = reflectionProbes.SampleLevel(linearSampler, float4(direction, probes.y), lod).rgb;
+    return lerp(second, nearest, probes.z);
+}
@@ -0,0 +1,156 @@
+#ifndef RENDER_BACKEND_H
+#define RENDER_BACKEND_H
+
+#include <cstdint>
+
+typedef uint32_t BackendHandle;
+static const BackendHandle InvalidBackendHandle = 0;
+
+// Structured buffers are readable by shaders and writable by compute, Arguments hold
+// indirect draw arguments written by compute, Readback buffers receive CopyBuffer for the CPU
+enum class BufferKind : uint32_t { Vertex, Index, Constant, Structured, Arguments, Readback };
+enum class ShaderStage : uint32_t { Vertex, Pixel, Compute };
+
+struct BufferDesc
+{
+    BufferKind kind;
+    uint32_t size;
+    bool dynamic;   // rewritten every frame with UpdateBuffer
+    uint32_t stride;    // element size, Structured only
+};
+
+struct BackendStats
+{
+    uint64_t buffersCreated;
+    uint64_t buffersReleased;
+    uint64_t bytesAllocated;    // currently alive
+    uint64_t peakBytesAllocated;
+    uint64_t pipelinesCreated;
+    uint64_t uploads;
+    uint64_t bytesUploaded;
+    uint64_t pipelineBinds;
+    uint64_t bufferBinds;
+    uint64_t textureBinds;
+    uint64_t draws;
+    uint64_t instances;
+    uint64_t dispatches;
+    uint64_t frames;
+};
+
+// Narrow command interface used by the frame code for draws: resources are referred to
+// by handles, so the same code can run against D3D11 or against a backend without a GPU.
+// Pipelines (shaders + fixed-function state), samplers, textures and targets are registered
+// through the concrete backend, since describing them is API specific. Binding
+// InvalidBackendHandle to a texture, sampler, structured buffer, unordered access or target
+// slot unbinds it.
+class RenderBackend
+{
+public:
+    RenderBackend() : m_stats(), m_frameStart(), m_lastFrame() {}
+    virtual ~RenderBackend() {}
+
+    virtual BackendHandle CreateBuffer(const BufferDesc& desc, const void* pInitialData) = 0;
+    virtual void ReleaseBuffer(BackendHandle buffer) = 0;
+    // Writes the first size bytes; a short write to a constant buffer zeroes the rest
+    virtual void UpdateBuffer(BackendHandle buffer, const void* pData, uint32_t size) = 0;
+    virtual void CopyBuffer(BackendHandle destination, BackendHandle source) = 0;
+    // Readback buffers only, blocks until the copy into it has finished on the GPU
+    virtual bool ReadBuffer(BackendHandle buffer, void* pData, uint32_t size) = 0;
+
+    // A compute pipeline only replaces the compute shader, the graphics state stays bound
+    virtual void BindPipeline(BackendHandle pipeline) = 0;
+    virtual void BindVertexBuffer(BackendHandle buffer, uint32_t stride) = 0;
+    virtual void BindIndexBuffer(BackendHandle buffer) = 0;  // 16-bit indices
+    virtual void BindConstantBuffer(ShaderStage stage, uint32_t slot, BackendHandle buffer) = 0;
+    virtual void BindTexture(ShaderStage stage, uint32_t slot, BackendHandle texture) = 0;
+    virtual void BindStructuredBuffer(ShaderStage stage, uint32_t slot, BackendHandle buffer) = 0;
+    virtual void BindUnorderedAccess(uint32_t slot, BackendHandle buffer) = 0;   // compute only
+    virtual void BindSampler(ShaderStage stage, uint32_t slot, BackendHandle sampler) = 0;
+
+    virtual void BindTarget(BackendHandle target) = 0;
+    virtual void ClearColor(BackendHandle target, const float color[4]) = 0;
+    virtual void ClearDepth(BackendHandle target, float depth) = 0;
+    virtual void SetViewport(float x, float y, float width, float height) = 0;
+    virtual void SetScissor(int32_t left, int32_t top, int32_t right, int32_t bottom) = 0;
+
+    virtual void Draw(uint32_t vertexCount) = 0;
+    virtual void DrawIndexed(uint32_t indexCount, uint32_t firstIndex, int32_t baseVertex) = 0;
+    virtual void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount) = 0;
+    // Arguments buffer laid out as D3D11_DRAW_INDEXED_INSTANCED_INDIRECT_ARGS
+    virtual void DrawIndexedInstancedIndirect(BackendHandle arguments) = 0;
+    virtual void Dispatch(uint32_t x, uint32_t y, uint32_t z) = 0;
+
+    // Named ranges of commands for GPU timings; backends without a profiler ignore them
+    virtual void BeginScope(const char* name) { (void)name; }
+    virtual void EndScope() {}
+
+    // Frame boundaries only delimit the per-frame statistics
+    void BeginFrame() { m_frameStart = m_stats; }
+    void EndFrame();
+
+    const BackendStats& GetStats() const { return m_stats; }
+    const BackendStats& GetLastFrameStats() const { return m_lastFrame; }
+
+protected:
+    void CountBufferCreated(uint32_t size);
+    void CountBufferReleased(uint32_t size);
+
+    BackendStats m_stats;
+
+private:
+    BackendStats m_frameStart;
+    BackendStats m_lastFrame;
+};
+
+class BackendScope
+{
+public:
+    BackendScope(RenderBackend& backend, const char* name) : m_backend(backend)
+    {
+        m_backend.BeginScope(name);
+    }
+
+    ~BackendScope()
+    {
+        m_backend.EndScope();
+    }
+
+private:
+    RenderBackend& m_backend;
+};
+
+inline void RenderBackend::CountBufferCreated(uint32_t size)
+{
+    m_stats.buffersCreated++;
+    m_stats.bytesAllocated += size;
+    if (m_stats.bytesAllocated > m_stats.peakBytesAllocated)
+        m_stats.peakBytesAllocated = m_stats.bytesAllocated;
+}
+
+inline void RenderBackend::CountBufferReleased(uint32_t size)
+{
+    m_stats.buffersReleased++;
+    m_stats.bytesAllocated -= size;
+}
+
+inline void RenderBackend::EndFrame()
+{
+    m_stats.frames++;
+
+    m_lastFrame.buffersCreated = m_stats.buffersCreated - m_frameStart.buffersCreated;
+    m_lastFrame.buffersReleased = m_stats.buffersReleased - m_frameStart.buffersReleased;
+    m_lastFrame.bytesAllocated = m_stats.bytesAllocated;
+    m_lastFrame.peakBytesAllocated = m_stats.peakBytesAllocated;
+    m_lastFrame.pipelinesCreated = m_stats.pipelinesCreated - m_frameStart.pipelinesCreated;
+    m_lastFrame.uploads = m_stats.uploads - m_frameStart.uploads;
+    m_lastFrame.bytesUploaded = m_stats.bytesUploaded - m_frameStart.bytesUploaded;
+    m_lastFrame.pipelineBinds = m_stats.pipelineBinds - m_frameStart.pipelineBinds;
+    m_lastFrame.bufferBinds = m_stats.bufferBinds - m_frameStart.bufferBinds;
+    m_lastFrame.textureBinds = m_stats.textureBinds - m_frameStart.textureBinds;
+    m_lastFrame.draws = m_stats.draws - m_frameStart.draws;
+    m_lastFrame.instances = m_stats.instances - m_frameStart.instances;
+    m_lastFrame.dispatches = m_stats.dispatches - m_frameStart.dispatches;
+    m_lastFrame.frames = 1;
+}
+
+#endif
@@ -1,28 +1,253 @@
 #include "framework.h"
 #include "RenderClass.h"
 #include "DDSTextureLoader11.h"
-#include <filesystem>
 #include <vector>
 #include <iostream>
 #include <algorithm>
+#include <cstdio>
 
 #include "imgui.h"
-#include "imgui_impl_dx11.h"
 #include "imgui_impl_win32.h"
 
 #include <dxgi.h>
 #include <d3d11.h>
 #include <d3dcompiler.h>
+#include <DirectXPackedVector.h>
+
+#include "Profiler.h"
+#include "ThreadPool.h"
 
 #pragma comment(lib, "d3dcompiler.lib")
 #pragma comment(lib, "d3d11.lib")
 #pragma comment(lib, "dxgi.lib")
 
+//     GPU  event query,    
+class D3D11FrameFence : public FrameFence
+{
+public:
+    D3D11FrameFence(ID3D11DeviceContext* pContext) : m_pContext(pContext)
+    {
+        for (auto& query : m_queries)
+            query = nullptr;
+    }
+
+    ~D3D11FrameFence()
+    {
+        for (auto& query : m_queries)
+        {
+            if (query) query->Release();
+        }
+    }
+
+    HRESULT Init(ID3D11Device* pDevice)
+    {
+        D3D11_QUERY_DESC queryDesc = {};
+        queryDesc.Query = D3D11_QUERY_EVENT;
+        for (auto& query : m_queries)
+        {
+            HRESULT hr = pDevice->CreateQuery(&queryDesc, &query);
+            if (FAILED(hr))
+                return hr;
+        }
+        return S_OK;
+    }
+
+    void Signal(uint32_t slot) override
+    {
+        m_pContext->End(m_queries[slot]);
+    }
+
+    bool IsComplete(uint32_t slot) override
+    {
+        BOOL done = FALSE;
+        return m_pContext->GetData(m_queries[slot], &done, sizeof(done), 0) == S_OK && done;
+    }
+
+private:
+    ID3D11DeviceContext* m_pContext;
+    ID3D11Query* m_queries[FrameManager::MaxFramesInFlight];
+};
+
+//   :      firstMip, MinLOD     .
+//      0 ,      firstMip
+class D3D11TextureStreamDevice : public TextureStreamDevice
+{
+public:
+    D3D11TextureStreamDevice(ID3D11Device* pDevice, ID3D11DeviceContext* pContext, FrameManager* pFrameManager)
+        : m_pDevice(pDevice), m_pContext(pContext), m_pFrameManager(pFrameManager)
+    {
+    }
+
+    ~D3D11TextureStreamDevice()
+    {
+        for (auto& texture : m_textures)
+        {
+            if (texture.pView) texture.pView->Release();
+            if (texture.pTexture) texture.pTexture->Release();
+        }
+    }
+
+    bool CreateTexture(StreamedTexture texture, const StreamTextureDesc& desc, uint32_t firstMip) override
+    {
+        Texture entry = { nullptr, nullptr, desc, firstMip, desc.mipCount };
+        if (!Allocate(entry))
+            return false;
+
+        //      Update,       
+        m_pContext->SetResourceMinLOD(entry.pTexture, static_cast<float>(desc.mipCount - 1 - firstMip));
+        if (m_textures.size() < texture)
+            m_textures.resize(texture);
+        m_textures[texture - 1] = entry;
+        return true;
+    }
+
+    bool ResizeTexture(StreamedTexture texture, uint32_t firstMip) override
+    {
+        Texture& entry = m_textures[texture - 1];
+        Texture resized = { nullptr, nullptr, entry.desc, firstMip, std::max(entry.mostDetailedMip, firstMip) };
+        if (!Allocate(resized))
+            return false;
+
+        //  ,  ,   GPU,    
+        UINT oldLevels = entry.desc.mipCount - entry.firstMip;
+        UINT newLevels = entry.desc.mipCount - firstMip;
+        for (UINT mip = resized.mostDetailedMip; mip < entry.desc.mipCount; mip++)
+        {
+            for (UINT slice = 0; slice < entry.desc.arraySize; slice++)
+            {
+                m_pContext->CopySubresourceRegion(resized.pTexture, D3D11CalcSubresource(mip - firstMip, slice, newLevels), 0, 0, 0,
+                    entry.pTexture, D3D11CalcSubresource(mip - entry.firstMip, slice, oldLevels), nullptr);
+            }
+        }
+        m_pContext->SetResourceMinLOD(resized.pTexture, static_cast<float>(std::min(resized.mostDetailedMip, entry.desc.mipCount - 1) - firstMip));
+
+        Texture old = entry;
+        entry = resized;
+        m_pFrameManager->DeferRelease([old]() {
+            old.pView->Release();
+            old.pTexture->Release();
+        });
+        return true;
+    }
+
+    void UploadRows(StreamedTexture texture, uint32_t mip, uint32_t slice, uint32_t firstRow, uint32_t rowCount,
+        const uint8_t* pData, uint32_t rowPitch) override
+    {
+        const Texture& entry = m_textures[texture - 1];
+        UINT rowHeight = entry.desc.rowHeight;
+        //           
+        UINT width = (std::max(entry.desc.width >> mip, 1u) + rowHeight - 1) / rowHeight * rowHeight;
+        UINT height = (std::max(entry.desc.height >> mip, 1u) + rowHeight - 1) / rowHeight * rowHeight;
+        D3D11_BOX box = { 0, firstRow * rowHeight, 0, width, std::min((firstRow + rowCount) * rowHeight, height), 1 };
+        bool whole = box.top == 0 && box.bottom == height;
+        m_pContext->UpdateSubresource(entry.pTexture, D3D11CalcSubresource(mip - entry.firstMip, slice, entry.desc.mipCount - entry.firstMip),
+            whole ? nullptr : &box, pData, rowPitch, 0);
+    }
+
+    void SetMostDetailedMip(StreamedTexture texture, uint32_t mip) override
+    {
+        Texture& entry = m_textures[texture - 1];
+        entry.mostDetailedMip = mip;
+        m_pContext->SetResourceMinLOD(entry.pTexture, static_cast<float>(mip - entry.firstMip));
+    }
+
+    void ReleaseTexture(StreamedTexture texture) override
+    {
+        //       
+        Texture entry = m_textures[texture - 1];
+        m_textures[texture - 1] = {};
+        m_pFrameManager->DeferRelease([entry]() {
+            entry.pView->Release();
+            entry.pTexture->Release();
+        });
+    }
+
+    //     ResizeTexture
+    ID3D11ShaderResourceView* GetView(StreamedTexture texture) const
+    {
+        if (texture == InvalidStreamedTexture || texture > m_textures.size())
+            return nullptr;
+        return m_textures[texture - 1].pView;
+    }
+
+private:
+    struct Texture
+    {
+        ID3D11Texture2D* pTexture;
+        ID3D11ShaderResourceView* pView;
+        StreamTextureDesc desc;
+        UINT firstMip;
+        UINT mostDetailedMip;   // desc.mipCount,    
+    };
+
+    bool Allocate(Texture& entry)
+    {
+        const StreamTextureDesc& desc = entry.desc;
+        UINT levels = desc.mipCount - entry.firstMip;
+
+        D3D11_TEXTURE2D_DESC textureDesc = {};
+        textureDesc.Width = std::max(desc.width >> entry.firstMip, 1u);
+        textureDesc.Height = std::max(desc.height >> entry.firstMip, 1u);
+        textureDesc.MipLevels = levels;
+        textureDesc.ArraySize = desc.arraySize;
+        textureDesc.Format = desc.format;
+        textureDesc.SampleDesc.Count = 1;
+        textureDesc.Usage = D3D11_USAGE_DEFAULT;
+        textureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+        textureDesc.MiscFlags = desc.isCubeMap ? D3D11_RESOURCE_MISC_TEXTURECUBE : 0;
+
+        ID3D11Texture2D* pTexture = nullptr;
+        if (FAILED(m_pDevice->CreateTexture2D(&textureDesc, nullptr, &pTexture)))
+            return false;
+
+        D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+        srvDesc.Format = desc.format;
+        if (desc.isCubeMap && desc.arraySize > 6)
+        {
+            srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURECUBEARRAY;
+            srvDesc.TextureCubeArray.MipLevels = levels;
+            srvDesc.TextureCubeArray.NumCubes = desc.arraySize / 6;
+        }
+        else if (desc.isCubeMap)
+        {
+            srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURECUBE;
+            srvDesc.TextureCube.MipLevels = levels;
+        }
+        else if (desc.arraySize > 1)
+        {
+            srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+            srvDesc.Texture2DArray.MipLevels = levels;
+            srvDesc.Texture2DArray.ArraySize = desc.arraySize;
+        }
+        else
+        {
+            srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+            srvDesc.Texture2D.MipLevels = levels;
+        }
+
+        ID3D11ShaderResourceView* pView = nullptr;
+        if (FAILED(m_pDevice->CreateShaderResourceView(pTexture, &srvDesc, &pView)))
+        {
+            pTexture->Release();
+            return false;
+        }
+        entry.pTexture = pTexture;
+        entry.pView = pView;
+        return true;
+    }
+
+    ID3D11Device* m_pDevice;
+    ID3D11DeviceContext* m_pContext;
+    FrameManager* m_pFrameManager;
+    std::vector<Texture> m_textures;    // handle - 1
+};
+
 
 HRESULT RenderClass::Init(HWND hWnd, WCHAR szTitle[], WCHAR szWindowClass[])
 {
     m_szTitle = szTitle;
     m_szWindowClass = szWindowClass;
+    Profiler::Get().SetThreadName("Main");
 
     HRESULT hr;
 
@@ -79,6 +304,11 @@ HRESULT RenderClass::Init(HWND hWnd, WCHAR szTitle[], WCHAR szWindowClass[])
         hr = pFactory->CreateSwapChain(m_pDevice, &swapChainDesc, &m_pSwapChain);
     }
 
+    if (SUCCEEDED(hr))
+    {
+        m_backend.Init(m_pDevice, m_pDeviceContext);
+    }
+
     if (SUCCEEDED(hr))
     {
         RECT rc;
@@ -88,6 +318,17 @@ HRESULT RenderClass::Init(HWND hWnd, WCHAR szTitle[], WCHAR szWindowClass[])
         hr = ConfigureBackBuffer(width, height);
     }
 
+    if (SUCCEEDED(hr))
+    {
+        hr = InitFrameManager();
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        PrepareNormalMap();
+        hr = InitTextureStreaming();
+    }
+
     if (SUCCEEDED(hr))
     {
         hr = InitBufferShader();
@@ -105,7 +346,17 @@ HRESULT RenderClass::Init(HWND hWnd, WCHAR szTitle[], WCHAR szWindowClass[])
 
     if (SUCCEEDED(hr))
     {
-        InitImGui(hWnd);
+        hr = InitEnvironmentLighting();
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hr = InitShadows();
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hr = InitImGui(hWnd);
     }
 
     if (SUCCEEDED(hr))
@@ -123,6 +374,27 @@ HRESULT RenderClass::Init(HWND hWnd, WCHAR szTitle[], WCHAR szWindowClass[])
         hr = InitComputeShader();
     }
 
+    if (SUCCEEDED(hr))
+    {
+        hr = m_gpuProfiler.Init(m_pDevice, m_pDeviceContext);
+        if (SUCCEEDED(hr))
+            m_backend.SetGpuProfiler(&m_gpuProfiler);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        //   :  CPU-    
+        m_softwareAvailable = m_softwareRenderer.Init(&ThreadPool::Get());
+        m_rayTracerAvailable = m_rayTracer.Init(&ThreadPool::Get());
+        m_lightmapBakerAvailable = m_lightmapBaker.Init(&ThreadPool::Get());
+        m_reflectionBakerAvailable = m_reflectionBaker.Init(&ThreadPool::Get());
+        m_lightProbesAvailable = m_lightProbes.Init(&ThreadPool::Get());
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hr = InitScene();
+    }
 
     if (pSelectedAdapter) pSelectedAdapter->Release();
     if (pFactory) pFactory->Release();
@@ -135,13 +407,144 @@ HRESULT RenderClass::Init(HWND hWnd, WCHAR szTitle[], WCHAR szWindowClass[])
     return hr;
 }
 
+HRESULT RenderClass::InitFrameManager()
+{
+    D3D11FrameFence* pFence = new D3D11FrameFence(m_pDeviceContext);
+    m_pFrameFence = pFence;
+    HRESULT hr = pFence->Init(m_pDevice);
+    if (FAILED(hr))
+        return hr;
+
+    m_frameManager.SetFence(m_pFrameFence);
+    ApplyFramesInFlight();
+    return S_OK;
+}
+
+void RenderClass::TerminateFrameManager()
+{
+    m_frameManager.WaitIdle();
+    m_frameManager.SetFence(nullptr);
+
+    delete m_pFrameFence;
+    m_pFrameFence = nullptr;
+}
+
+HRESULT RenderClass::InitTextureStreaming()
+{
+    //    Init*,        
+    m_pTextureDevice = new D3D11TextureStreamDevice(m_pDevice, m_pDeviceContext, &m_frameManager);
+    TextureStreamSettings settings = { 2, static_cast<uint64_t>(m_streamBudgetKB) * 1024, 64 * 1024,
+        static_cast<uint64_t>(m_textureBudgetMB) * 1024 * 1024, 30 };
+    m_textureStreamer.SetThreadPool(&ThreadPool::Get());
+    return m_textureStreamer.Init(m_pTextureDevice, settings) ? S_OK : E_FAIL;
+}
+
+//   :  DDS   .ddz
+static std::string PackedPath(const char* path)
+{
+    std::string packed(path);
+    size_t dot = packed.find_last_of('.');
+    size_t slash = packed.find_last_of("/\\");
+    if (dot != std::string::npos && (slash == std::string::npos || dot > slash))
+        packed.erase(dot);
+    return packed + ".ddz";
+}
+
+std::string RenderClass::GetStreamPath(const char* path) const
+{
+    //    DDS      ;  
+    //  ,   
+    std::string packed = PackedPath(path);
+    WIN32_FILE_ATTRIBUTE_DATA packedData;
+    WIN32_FILE_ATTRIBUTE_DATA sourceData;
+    if (!GetFileAttributesExA(packed.c_str(), GetFileExInfoStandard, &packedData) ||
+        !GetFileAttributesExA(path, GetFileExInfoStandard, &sourceData) ||
+        CompareFileTime(&packedData.ftLastWriteTime, &sourceData.ftLastWriteTime) < 0)
+    {
+        return path;
+    }
+    return packed;
+}
+
+void RenderClass::TerminateTextureStreaming()
+{
+    //        ,   TerminateFrameManager
+    m_textureStreamer.Shutdown();
+    delete m_pTextureDevice;
+    m_pTextureDevice = nullptr;
+}
+
+void RenderClass::UpdateTextureStreaming()
+{
+    m_textureStreamer.SetFrameBudget(static_cast<uint64_t>(m_streamBudgetKB) * 1024);
+    m_textureStreamer.SetMemoryBudget(static_cast<uint64_t>(m_textureBudgetMB) * 1024 * 1024);
+    FinishNormalMapCook(false);
+    m_textureStreamer.Update();
+
+    //    backend:           
+    UpdateStreamedView(m_diffuseTexture, m_pDiffuseView, m_sceneTextures.diffuse);
+    UpdateStreamedView(m_normalTexture, m_pNormalView, m_sceneTextures.normal);
+    UpdateStreamedView(m_skyboxStream, m_pSkyboxView, m_sceneTextures.skybox);
+}
+
+void RenderClass::UpdateStreamedView(StreamedTexture texture, ID3D11ShaderResourceView*& pRegisteredView, BackendHandle& handle)
+{
+    ID3D11ShaderResourceView* pView = m_pTextureDevice->GetView(texture);
+    if (pView == pRegisteredView)
+        return;
+    m_backend.UnregisterTexture(handle);
+    handle = pView ? m_backend.RegisterTexture(pView) : InvalidBackendHandle;
+    pRegisteredView = pView;
+}
+
+void RenderClass::RestreamTextures()
+{
+    // Backend        UpdateTextureStreaming
+    m_textureStreamer.Release(m_diffuseTexture);
+    m_textureStreamer.Release(m_normalTexture);
+    m_textureStreamer.Release(m_skyboxStream);
+
+    m_diffuseTexture = m_textureStreamer.Request({ GetStreamPath("cat.dds"), GetStreamPath("textile.dds") }, 1);
+    m_normalTexture = m_textureStreamer.Request(GetStreamPath(m_normalMapPath), 1);
+    m_skyboxStream = m_textureStreamer.Request(GetStreamPath("skybox.dds"));
+}
+
+void RenderClass::BenchmarkTextureStreaming()
+{
+    //  :     ,     
+    std::vector<std::string> paths = { "cat.dds", "cube_normal.dds", "skybox.dds", "textile.dds" };
+    m_streamBenchmark = TextureStreamer::Benchmark(paths, 16, static_cast<uint64_t>(m_streamBudgetKB) * 1024);
+    //      ,   ;     
+    m_residencyBenchmark = TextureStreamer::BenchmarkResidency(paths, 16, 8, 0.25f, 600);
+}
+
+void RenderClass::ApplyFramesInFlight()
+{
+    m_frameManager.SetFramesInFlight(static_cast<uint32_t>(m_requestedFramesInFlight));
+
+    // DXGI       ,  FrameManager
+    IDXGIDevice1* pDxgiDevice = nullptr;
+    if (SUCCEEDED(m_pDevice->QueryInterface(__uuidof(IDXGIDevice1), (void**)&pDxgiDevice)))
+    {
+        pDxgiDevice->SetMaximumFrameLatency(m_frameManager.GetFramesInFlight());
+        pDxgiDevice->Release();
+    }
+}
+
+//       
+static SwMeshData ToSwMesh(const SceneMesh& mesh)
+{
+    SwMeshData data = { mesh.pVertices, mesh.floatsPerVertex, mesh.vertexCount, mesh.pIndices, mesh.indexCount };
+    return data;
+}
+
 HRESULT RenderClass::InitBufferShader()
 {
     D3D11_INPUT_ELEMENT_DESC layout[] =
     {
-        { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, offsetof(Vertex, xyz),    D3D11_INPUT_PER_VERTEX_DATA, 0 },
-        { "NORMAL",   0, DXGI_FORMAT_R32G32B32_FLOAT, 0, offsetof(Vertex, normal), D3D11_INPUT_PER_VERTEX_DATA, 0 },
-        { "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT,    0, offsetof(Vertex, uv),     D3D11_INPUT_PER_VERTEX_DATA, 0 }
+        { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, offsetof(SceneVertex, xyz),    D3D11_INPUT_PER_VERTEX_DATA, 0 },
+        { "NORMAL",   0, DXGI_FORMAT_R32G32B32_FLOAT, 0, offsetof(SceneVertex, normal), D3D11_INPUT_PER_VERTEX_DATA, 0 },
+        { "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT,    0, offsetof(SceneVertex, uv),     D3D11_INPUT_PER_VERTEX_DATA, 0 }
     };
 
     HRESULT result = S_OK;
@@ -169,159 +572,24 @@ HRESULT RenderClass::InitBufferShader()
         result = CompileShader(L"LightPixel.ps", nullptr, &m_pLightPixelShader);
     }
 
-    static const Vertex vertices[] =
-    {
-        { {-1.0f, -1.0f,  1.0f}, { 0.0f,  -1.0f,  0.0f}, {0.0f, 1.0f} },
-        { { 1.0f, -1.0f,  1.0f}, { 0.0f,  -1.0f,  0.0f}, {1.0f, 1.0f} },
-        { { 1.0f, -1.0f, -1.0f}, { 0.0f,  -1.0f,  0.0f}, {1.0f, 0.0f} },
-        { {-1.0f, -1.0f, -1.0f}, { 0.0f,  -1.0f,  0.0f}, {0.0f, 0.0f} },
-
-        { {-1.0f,  1.0f, -1.0f}, { 0.0f,  1.0f, 0.0f}, {0.0f, 1.0f} },
-        { { 1.0f,  1.0f, -1.0f}, { 0.0f,  1.0f, 0.0f}, {1.0f, 1.0f} },
-        { { 1.0f,  1.0f,  1.0f}, { 0.0f,  1.0f, 0.0f}, {1.0f, 0.0f} },
-        { {-1.0f,  1.0f,  1.0f}, { 0.0f,  1.0f, 0.0f}, {0.0f, 0.0f} },
-
-        { { 1.0f, -1.0f, -1.0f}, { 1.0f,  0.0f,  0.0f}, {0.0f, 1.0f} },
-        { { 1.0f, -1.0f,  1.0f}, { 1.0f,  0.0f,  0.0f}, {1.0f, 1.0f} },
-        { { 1.0f,  1.0f,  1.0f}, { 1.0f,  0.0f,  0.0f}, {1.0f, 0.0f} },
-        { { 1.0f,  1.0f, -1.0f}, { 1.0f,  0.0f,  0.0f}, {0.0f, 0.0f} },
-
-        { {-1.0f, -1.0f,  1.0f}, {-1.0f,  0.0f,  0.0f}, {0.0f, 1.0f} },
-        { {-1.0f, -1.0f, -1.0f}, {-1.0f,  0.0f,  0.0f}, {1.0f, 1.0f} },
-        { {-1.0f,  1.0f, -1.0f}, {-1.0f,  0.0f,  0.0f}, {1.0f, 0.0f} },
-        { {-1.0f,  1.0f,  1.0f}, {-1.0f,  0.0f,  0.0f}, {0.0f, 0.0f} },
-
-        { { 1.0f, -1.0f,  1.0f}, { 0.0f,  0.0f,  1.0f}, {0.0f, 1.0f} },
-        { {-1.0f, -1.0f,  1.0f}, { 0.0f,  0.0f,  1.0f}, {1.0f, 1.0f} },
-        { {-1.0f,  1.0f,  1.0f}, { 0.0f,  0.0f,  1.0f}, {1.0f, 0.0f} },
-        { { 1.0f,  1.0f,  1.0f}, { 0.0f,  0.0f,  1.0f}, {0.0f, 0.0f} },
-
-        { {-1.0f, -1.0f, -1.0f}, { 0.0f,  0.0f,  -1.0f}, {0.0f, 1.0f} },
-        { { 1.0f, -1.0f, -1.0f}, { 0.0f,  0.0f,  -1.0f}, {1.0f, 1.0f} },
-        { { 1.0f,  1.0f, -1.0f}, { 0.0f,  0.0f,  -1.0f}, {1.0f, 0.0f} },
-        { {-1.0f,  1.0f, -1.0f}, { 0.0f,  0.0f,  -1.0f}, {0.0f, 0.0f} },
-    };
-
-    WORD indices[] =
-    {
-        0, 2, 1,
-        0, 3, 2,
-
-        4, 6, 5,
-        4, 7, 6,
-
-        8, 10, 9,
-        8, 11, 10,
-
-        12, 14, 13,
-        12, 15, 14,
-
-        16, 18, 17,
-        16, 19, 18,
-
-        20, 22, 21,
-        20, 23, 22
-    };
-
-    D3D11_BUFFER_DESC lightBufferDesc = {};
-    lightBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
-    lightBufferDesc.ByteWidth = sizeof(PointLight) * 3;
-    lightBufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-    lightBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-    result = m_pDevice->CreateBuffer(&lightBufferDesc, nullptr, &m_pLightBuffer);
-    if (FAILED(result))
-        return result;
-
-
-    D3D11_BUFFER_DESC bd = {};
-    bd.Usage = D3D11_USAGE_DEFAULT;
-    bd.ByteWidth = sizeof(Vertex) * ARRAYSIZE(vertices);
-    bd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-    bd.CPUAccessFlags = 0;
-
-    D3D11_SUBRESOURCE_DATA initData = {};
-    initData.pSysMem = vertices;
-    result = m_pDevice->CreateBuffer(&bd, &initData, &m_pVertexBuffer);
-    if (FAILED(result))
-        return result;
-
-    bd.Usage = D3D11_USAGE_DEFAULT;
-    bd.ByteWidth = sizeof(WORD) * ARRAYSIZE(indices);
-    bd.BindFlags = D3D11_BIND_INDEX_BUFFER;
-    bd.CPUAccessFlags = 0;
-    initData.pSysMem = indices;
-    result = m_pDevice->CreateBuffer(&bd, &initData, &m_pIndexBuffer);
-    if (FAILED(result))
-        return result;
-
-    bd.Usage = D3D11_USAGE_DEFAULT;
-    bd.ByteWidth = sizeof(XMMATRIX);
-    bd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-    bd.CPUAccessFlags = 0;
-    result = m_pDevice->CreateBuffer(&bd, nullptr, &m_pModelBuffer);
-    if (FAILED(result))
-        return result;
-
-    bd.Usage = D3D11_USAGE_DEFAULT;
-    bd.ByteWidth = sizeof(InstanceData) * MaxInst;
-    bd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-    bd.CPUAccessFlags = 0;
-    result = m_pDevice->CreateBuffer(&bd, nullptr, &m_pModelBufferInst);
-    if (FAILED(result))
-        return result;
-
-    // Init instances cubes
-    const int innerCount = 10;
-    const int outerCount = 12;
-    const float innerRadius = 4.0f;
-    const float outerRadius = 9.5f;
-
-    InstanceData modelBuf;
-    modelBuf.model = XMMatrixScaling(m_fixedScale, m_fixedScale, m_fixedScale);
-    modelBuf.texInd = 0;
-    modelBuf.countInstance = MaxInst;
-    m_modelInstances.push_back(modelBuf);
-
-    for (int i = 0; i < innerCount; i++)
-    {
-        float angle = XM_2PI * i / innerCount;
-        XMFLOAT3 position = { innerRadius * cosf(angle), 0.0f, innerRadius * sinf(angle) };
-
-        InstanceData modelBuf;
-        modelBuf.countInstance = MaxInst;
-        modelBuf.model = XMMatrixScaling(m_fixedScale, m_fixedScale, m_fixedScale) *
-            XMMatrixTranslation(position.x, position.y, position.z);
-        modelBuf.texInd = i % 2;
-        m_modelInstances.push_back(modelBuf);
-    }
-
-    for (int i = 0; i < outerCount; i++)
+    if (SUCCEEDED(result))
     {
-        float angle = XM_2PI * i / outerCount;
-        XMFLOAT3 position = { outerRadius * cosf(angle), 0.0f, outerRadius * sinf(angle) };
-
-        InstanceData modelBuf;
-        modelBuf.countInstance = MaxInst;
-        modelBuf.model = XMMatrixScaling(m_fixedScale, m_fixedScale, m_fixedScale) *
-            XMMatrixTranslation(position.x, position.y, position.z);
-        modelBuf.texInd = i % 2;
-        m_modelInstances.push_back(modelBuf);
+        result = CompileShader(L"LightmapPixel.ps", nullptr, &m_pLightmapPixelShader);
     }
-
-    m_pDeviceContext->UpdateSubresource(m_pModelBufferInst, 0, nullptr, m_modelInstances.data(), 0, 0);
-
-    D3D11_BUFFER_DESC vpBufferDesc = {};
-    vpBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
-    vpBufferDesc.ByteWidth = sizeof(CameraBuffer);
-    vpBufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-    vpBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-    result = m_pDevice->CreateBuffer(&vpBufferDesc, nullptr, &m_pVPBuffer);
     if (FAILED(result))
         return result;
 
-    result = DirectX::CreateDDSTextureFromFile(m_pDevice, L"cube_normal.dds", nullptr, &m_pNormalMapView);
-    if (FAILED(result))
-        return result;
+    //    SceneRenderer,        CPU
+    SwMeshData cubeMesh = ToSwMesh(SceneRenderer::GetCubeMesh());
+    m_softwareRenderer.SetMesh(SwMesh::Cube, cubeMesh);
+    m_rayTracer.SetMesh(cubeMesh);
+    m_lightmapBaker.SetMesh(cubeMesh);
+    m_reflectionBaker.SetMesh(cubeMesh);
+    m_lightProbes.SetMesh(cubeMesh);
+
+    m_normalTexture = m_textureStreamer.Request(GetStreamPath(m_normalMapPath), 1);
+    if (m_normalTexture == InvalidStreamedTexture)
+        return E_FAIL;
 
     D3D11_SAMPLER_DESC sampDesc = {};
     sampDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
@@ -332,7 +600,15 @@ HRESULT RenderClass::InitBufferShader()
     sampDesc.MinLOD = 0;
     sampDesc.MaxLOD = D3D11_FLOAT32_MAX;
     result = m_pDevice->CreateSamplerState(&sampDesc, &m_pSamplerState);
-    return result;
+    if (FAILED(result))
+        return result;
+
+    //      SceneRenderer::RenderCubes:     
+    D3D11PipelineDesc cubeDesc = { m_pVertexShader, m_pPixelShader, m_pLayout, nullptr, nullptr, nullptr, m_pSamplerState, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST };
+    m_scenePipelines.cube = m_backend.RegisterPipeline(cubeDesc);
+    cubeDesc.pPixelShader = m_pLightmapPixelShader;
+    m_scenePipelines.cubeLightmap = m_backend.RegisterPipeline(cubeDesc);
+    return S_OK;
 }
 
 HRESULT RenderClass::InitSkybox()
@@ -353,70 +629,31 @@ HRESULT RenderClass::InitSkybox()
         hr = m_pDevice->CreateInputLayout(skyboxLayout, 1, pVertexCode->GetBufferPointer(), pVertexCode->GetBufferSize(), &m_pSkyboxLayout);
     }
 
-    SkyboxVertex SkyboxVertices[] = {
-        { -1.0f, -1.0f, -1.0f },
-        { -1.0f,  1.0f, -1.0f },
-        {  1.0f,  1.0f, -1.0f },
-        { -1.0f, -1.0f, -1.0f },
-        {  1.0f,  1.0f, -1.0f },
-        {  1.0f, -1.0f, -1.0f },
-
-        {  1.0f, -1.0f,  1.0f },
-        {  1.0f,  1.0f,  1.0f },
-        { -1.0f,  1.0f,  1.0f },
-        {  1.0f, -1.0f,  1.0f },
-        { -1.0f,  1.0f,  1.0f },
-        { -1.0f, -1.0f,  1.0f },
-
-        { -1.0f, -1.0f,  1.0f },
-        { -1.0f,  1.0f,  1.0f },
-        { -1.0f,  1.0f, -1.0f },
-        { -1.0f, -1.0f,  1.0f },
-        { -1.0f,  1.0f, -1.0f },
-        { -1.0f, -1.0f, -1.0f },
-
-        {  1.0f, -1.0f, -1.0f },
-        {  1.0f,  1.0f, -1.0f },
-        {  1.0f,  1.0f,  1.0f },
-        {  1.0f, -1.0f, -1.0f },
-        {  1.0f,  1.0f,  1.0f },
-        {  1.0f, -1.0f,  1.0f },
-
-        { -1.0f,  1.0f, -1.0f },
-        { -1.0f,  1.0f,  1.0f },
-        {  1.0f,  1.0f,  1.0f },
-        { -1.0f,  1.0f, -1.0f },
-        {  1.0f,  1.0f,  1.0f },
-        {  1.0f,  1.0f, -1.0f },
-
-        { -1.0f, -1.0f,  1.0f },
-        { -1.0f, -1.0f, -1.0f },
-        {  1.0f, -1.0f, -1.0f },
-        { -1.0f, -1.0f,  1.0f },
-        {  1.0f, -1.0f, -1.0f },
-        {  1.0f, -1.0f,  1.0f }
-    };
+    if (FAILED(hr)) return hr;
+    m_softwareRenderer.SetMesh(SwMesh::Skybox, ToSwMesh(SceneRenderer::GetSkyboxMesh()));
 
-    D3D11_BUFFER_DESC bd = {};
-    bd.Usage = D3D11_USAGE_DEFAULT;
-    bd.ByteWidth = sizeof(SkyboxVertex) * ARRAYSIZE(SkyboxVertices);
-    bd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+    //    UpdateTextureStreaming,   
+    m_skyboxStream = m_textureStreamer.Request(GetStreamPath("skybox.dds"));
+    if (m_skyboxStream == InvalidStreamedTexture) return E_FAIL;
 
-    D3D11_SUBRESOURCE_DATA initData = {};
-    initData.pSysMem = SkyboxVertices;
-    hr = m_pDevice->CreateBuffer(&bd, &initData, &m_pSkyboxVB);
+    //     ,     
+    D3D11_DEPTH_STENCIL_DESC depthStencilDesc = {};
+    depthStencilDesc.DepthEnable = true;
+    depthStencilDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ZERO;
+    depthStencilDesc.DepthFunc = D3D11_COMPARISON_LESS_EQUAL;
+    hr = m_pDevice->CreateDepthStencilState(&depthStencilDesc, &m_pSkyboxDepthState);
     if (FAILED(hr)) return hr;
 
-    D3D11_BUFFER_DESC vpBufferDesc = {};
-    vpBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
-    vpBufferDesc.ByteWidth = sizeof(CameraBuffer);
-    vpBufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-    vpBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-    hr = m_pDevice->CreateBuffer(&vpBufferDesc, nullptr, &m_pSkyboxVPBuffer);
+    D3D11_RASTERIZER_DESC rasterizerDesc = {};
+    rasterizerDesc.FillMode = D3D11_FILL_SOLID;
+    rasterizerDesc.CullMode = D3D11_CULL_FRONT;
+    rasterizerDesc.FrontCounterClockwise = false;
+    hr = m_pDevice->CreateRasterizerState(&rasterizerDesc, &m_pSkyboxRaster);
     if (FAILED(hr)) return hr;
 
-    hr = CreateDDSTextureFromFile(m_pDevice, L"skybox.dds", nullptr, &m_pSkyboxSRV);
-    if (FAILED(hr)) return hr;
+    D3D11PipelineDesc pipeline = { m_pSkyboxVS, m_pSkyboxPS, m_pSkyboxLayout, nullptr,
+        m_pSkyboxDepthState, m_pSkyboxRaster, m_pSamplerState, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST };
+    m_scenePipelines.skybox = m_backend.RegisterPipeline(pipeline);
 
     return S_OK;
 }
@@ -427,118 +664,46 @@ HRESULT RenderClass::InitComputeShader()
     if (FAILED(hr))
         return hr;
 
-    D3D11_BUFFER_DESC frustumBufferDesc = {};
-    frustumBufferDesc.ByteWidth = sizeof(XMVECTOR) * 6;
-    frustumBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
-    frustumBufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-    frustumBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-    hr = m_pDevice->CreateBuffer(&frustumBufferDesc, nullptr, &m_pFrustumPlanesBuffer);
-    if (FAILED(hr))
-        return hr;
-
-    D3D11_BUFFER_DESC indirectBufferDesc = {};
-    indirectBufferDesc.ByteWidth = sizeof(UINT) * 5;
-    indirectBufferDesc.Usage = D3D11_USAGE_DEFAULT;
-    indirectBufferDesc.BindFlags = D3D11_BIND_UNORDERED_ACCESS;
-    indirectBufferDesc.CPUAccessFlags = 0;
-    indirectBufferDesc.MiscFlags = D3D11_RESOURCE_MISC_DRAWINDIRECT_ARGS | D3D11_RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS;
-    indirectBufferDesc.StructureByteStride = 0;
-    hr = m_pDevice->CreateBuffer(&indirectBufferDesc, nullptr, &m_pIndirectArgsBuffer);
-    if (FAILED(hr))
-        return hr;
-
-    D3D11_UNORDERED_ACCESS_VIEW_DESC indirectUAVDesc = {};
-    indirectUAVDesc.Format = DXGI_FORMAT_R32_TYPELESS;
-    indirectUAVDesc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
-    indirectUAVDesc.Buffer.FirstElement = 0;
-    indirectUAVDesc.Buffer.NumElements = indirectBufferDesc.ByteWidth / sizeof(UINT);
-    indirectUAVDesc.Buffer.Flags = D3D11_BUFFER_UAV_FLAG_RAW;
-    hr = m_pDevice->CreateUnorderedAccessView(m_pIndirectArgsBuffer, &indirectUAVDesc, &m_pIndirectArgsUAV);
-    if (FAILED(hr))
-        return hr;
-
-    D3D11_BUFFER_DESC idsBufferDesc = {};
-    idsBufferDesc.ByteWidth = sizeof(UINT) * MaxInst;
-    idsBufferDesc.Usage = D3D11_USAGE_DEFAULT;
-    idsBufferDesc.BindFlags = D3D11_BIND_UNORDERED_ACCESS | D3D11_BIND_SHADER_RESOURCE;
-    idsBufferDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
-    idsBufferDesc.StructureByteStride = sizeof(UINT);
-    hr = m_pDevice->CreateBuffer(&idsBufferDesc, nullptr, &m_pObjectsIdsBuffer);
-    if (FAILED(hr))
-        return hr;
-
-    D3D11_UNORDERED_ACCESS_VIEW_DESC idsUAVDesc = {};
-    idsUAVDesc.Format = DXGI_FORMAT_UNKNOWN;
-    idsUAVDesc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
-    idsUAVDesc.Buffer.FirstElement = 0;
-    idsUAVDesc.Buffer.NumElements = MaxInst;
-    hr = m_pDevice->CreateUnorderedAccessView(m_pObjectsIdsBuffer, &idsUAVDesc, &m_pObjectsIdsUAV);
-    if (FAILED(hr))
-        return hr;
-
-    D3D11_BUFFER_DESC instanceBufferDesc = {};
-    instanceBufferDesc.ByteWidth = sizeof(InstanceData) * MaxInst;
-    instanceBufferDesc.Usage = D3D11_USAGE_DEFAULT;
-    instanceBufferDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
-    instanceBufferDesc.CPUAccessFlags = 0;
-    instanceBufferDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
-    instanceBufferDesc.StructureByteStride = sizeof(InstanceData);
-
-    ID3D11Buffer* pInstanceBuffer = nullptr;
-    hr = m_pDevice->CreateBuffer(&instanceBufferDesc, nullptr, &pInstanceBuffer);
-    if (FAILED(hr))
-        return hr;
-
-    D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-    srvDesc.Format = DXGI_FORMAT_UNKNOWN;
-    srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
-    srvDesc.Buffer.FirstElement = 0;
-    srvDesc.Buffer.NumElements = MaxInst;
-    hr = m_pDevice->CreateShaderResourceView(pInstanceBuffer, &srvDesc, &m_pInstanceDataSRV);
-    if (FAILED(hr))
-    {
-        pInstanceBuffer->Release();
-        return hr;
-    }
-
-    m_pDeviceContext->UpdateSubresource(pInstanceBuffer, 0, nullptr, m_modelInstances.data(), 0, 0);
-    pInstanceBuffer->Release();
-
-    return S_OK;
+    //    SceneRenderer,   
+    D3D11PipelineDesc cullDesc = {};
+    cullDesc.pComputeShader = m_pComputeShader;
+    m_scenePipelines.cull = m_backend.RegisterPipeline(cullDesc);
+    return m_scenePipelines.cull != InvalidBackendHandle ? S_OK : E_FAIL;
 }
 
 void RenderClass::TerminateComputeShader()
 {
+    //    backend     
     if (m_pComputeShader)
         m_pComputeShader->Release();
-
-    if (m_pFrustumPlanesBuffer)
-        m_pFrustumPlanesBuffer->Release();
-
-    if (m_pIndirectArgsBuffer)
-        m_pIndirectArgsBuffer->Release();
-
-    if (m_pObjectsIdsBuffer)
-        m_pObjectsIdsBuffer->Release();
-
-    if (m_pIndirectArgsUAV)
-        m_pIndirectArgsUAV->Release();
-
-    if (m_pObjectsIdsUAV)
-        m_pObjectsIdsUAV->Release();
-
-    if (m_pInstanceDataSRV)
-        m_pInstanceDataSRV->Release();
-}
+    m_pComputeShader = nullptr;
+}
 
 
 void RenderClass::Terminate()
 {
+    //     ,    
+    m_lightmapBaker.Cancel();
+    m_reflectionBaker.Cancel();
+    if (m_normalCookThread.joinable())
+        m_normalCookThread.join();
+    TerminateTextureStreaming();
+    TerminateFrameManager();
+    m_gpuProfiler.Terminate();
+    TerminateImGui();
+    m_backend.Terminate();
     TerminateBufferShader();
     TerminateSkybox();
+    TerminateEnvironmentLighting();
+    TerminateShadows();
     TerminateParallelogram();
     TerminateComputeShader();
 
+    if (m_pSoftwareTarget)
+    {
+        m_pSoftwareTarget->Release();
+        m_pSoftwareTarget = nullptr;
+    }
 
     if (m_pRenderTargetView)
     {
@@ -558,12 +723,6 @@ void RenderClass::Terminate()
         m_pSwapChain = nullptr;
     }
 
-    if (m_pColorBuffer)
-    {
-        m_pColorBuffer->Release();
-        m_pColorBuffer = nullptr;
-    }
-
     if (m_pDeviceContext)
     {
         m_pDeviceContext->ClearState();
@@ -577,10 +736,6 @@ void RenderClass::Terminate()
         m_pDevice = nullptr;
     }
 
-    ImGui_ImplDX11_Shutdown();
-    ImGui_ImplWin32_Shutdown();
-    ImGui::DestroyContext();
-
 }
 
 void RenderClass::TerminateBufferShader()
@@ -588,33 +743,249 @@ void RenderClass::TerminateBufferShader()
     if (m_pLayout) m_pLayout->Release();
     if (m_pPixelShader) m_pPixelShader->Release();
     if (m_pVertexShader) m_pVertexShader->Release();
-    if (m_pIndexBuffer) m_pIndexBuffer->Release();
-    if (m_pVertexBuffer) m_pVertexBuffer->Release();
-    if (m_pModelBuffer) m_pModelBuffer->Release();
-    if (m_pVPBuffer) m_pVPBuffer->Release();
-    if (m_pTextureView) m_pTextureView->Release();
     if (m_pSamplerState) m_pSamplerState->Release();
-    if (m_pLightBuffer) m_pLightBuffer->Release();
     if (m_pLightPixelShader) m_pLightPixelShader->Release();
-    if (m_pNormalMapView) m_pNormalMapView->Release();
+    if (m_pLightmapPixelShader) m_pLightmapPixelShader->Release();
+    if (m_pLightmapSRV) m_pLightmapSRV->Release();
 
-    if (m_pModelBufferInst) m_pModelBufferInst->Release();
-    if (m_pPostProcessTexture) m_pPostProcessTexture->Release();
-    if (m_pPostProcessRTV) m_pPostProcessRTV->Release();
-    if (m_pPostProcessSRV) m_pPostProcessSRV->Release();
+    ReleaseGraphTargets(0);
     if (m_pPostProcessVS) m_pPostProcessVS->Release();
     if (m_pPostProcessPS) m_pPostProcessPS->Release();
-    if (m_pFullScreenVB) m_pFullScreenVB->Release();
     if (m_pFullScreenLayout) m_pFullScreenLayout->Release();
+}
+
+HRESULT RenderClass::InitEnvironmentLighting()
+{
+    //   :        
+    m_reflectionProbePositions = { XMFLOAT3(0.0f, 2.5f, 0.0f), XMFLOAT3(6.75f, 0.0f, 0.0f), XMFLOAT3(0.0f, 0.0f, 6.75f),
+        XMFLOAT3(-6.75f, 0.0f, 0.0f), XMFLOAT3(0.0f, 0.0f, -6.75f) };
+
+    //  CPU-     ,  
+    m_environmentLighting.SetThreadPool(&ThreadPool::Get());
+    if (!m_environmentSource.LoadDDS("skybox.dds", &ThreadPool::Get()) || !m_environmentLighting.SetSource(m_environmentSource))
+        return S_OK;
+    m_environmentLighting.Compute();
+
+    //    RGBA16F,    ,    
+    UINT size = m_environmentLighting.GetPrefilteredSize();
+    UINT mipCount = m_environmentLighting.GetPrefilteredMipCount();
+    std::vector<std::vector<PackedVector::HALF>> texels;
+    std::vector<D3D11_SUBRESOURCE_DATA> initData;
+    texels.reserve(6 * mipCount);
+    for (UINT face = 0; face < 6; face++)
+    {
+        for (UINT mip = 0; mip < mipCount; mip++)
+        {
+            const std::vector<float>& source = m_environmentLighting.GetPrefilteredFace(face, mip);
+            texels.emplace_back(source.size());
+            PackedVector::XMConvertFloatToHalfStream(texels.back().data(), sizeof(PackedVector::HALF),
+                source.data(), sizeof(float), source.size());
+
+            D3D11_SUBRESOURCE_DATA data = {};
+            data.pSysMem = texels.back().data();
+            data.SysMemPitch = (size >> mip) * 4 * sizeof(PackedVector::HALF);
+            initData.push_back(data);
+        }
+    }
+
+    D3D11_TEXTURE2D_DESC textureDesc = {};
+    textureDesc.Width = size;
+    textureDesc.Height = size;
+    textureDesc.MipLevels = mipCount;
+    textureDesc.ArraySize = 6;
+    textureDesc.Format = DXGI_FORMAT_R16G16B16A16_FLOAT;
+    textureDesc.SampleDesc.Count = 1;
+    textureDesc.Usage = D3D11_USAGE_IMMUTABLE;
+    textureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+    textureDesc.MiscFlags = D3D11_RESOURCE_MISC_TEXTURECUBE;
+    ID3D11Texture2D* pTexture = nullptr;
+    hr = m_pDevice->CreateTexture2D(&textureDesc, initData.data(), &pTexture);
+    if (FAILED(hr))
+        return hr;
+
+    D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+    srvDesc.Format = textureDesc.Format;
+    srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURECUBE;
+    srvDesc.TextureCube.MostDetailedMip = 0;
+    srvDesc.TextureCube.MipLevels = mipCount;
+    hr = m_pDevice->CreateShaderResourceView(pTexture, &srvDesc, &m_pPrefilteredSRV);
+    pTexture->Release();
+    if (FAILED(hr))
+        return hr;
+
+    m_sceneTextures.prefiltered = m_backend.RegisterTexture(m_pPrefilteredSRV);
+    return S_OK;
+}
+
+void RenderClass::TerminateEnvironmentLighting()
+{
+    if (m_pPrefilteredSRV) m_pPrefilteredSRV->Release();
+    if (m_pReflectionProbeSRV) m_pReflectionProbeSRV->Release();
+    m_pPrefilteredSRV = nullptr;
+    m_pReflectionProbeSRV = nullptr;
+}
+
+HRESULT RenderClass::InitShadows()
+{
+    ID3DBlob* pVertexCode = nullptr;
+    HRESULT hr = CompileShader(L"ShadowVertex.vs", &m_pShadowVS, nullptr, &pVertexCode);
+    if (FAILED(hr))
+        return hr;
+
+    D3D11_INPUT_ELEMENT_DESC layout[] =
+    {
+        { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, offsetof(SceneVertex, xyz), D3D11_INPUT_PER_VERTEX_DATA, 0 },
+    };
+    hr = m_pDevice->CreateInputLayout(layout, 1, pVertexCode->GetBufferPointer(), pVertexCode->GetBufferSize(), &m_pShadowLayout);
+    pVertexCode->Release();
+    if (FAILED(hr))
+        return hr;
+
+    hr = CompileShader(L"ShadowClearVertex.vs", &m_pShadowClearVS, nullptr);
+    if (FAILED(hr))
+        return hr;
+
+    //  :   DSV,     R32_FLOAT
+    D3D11_TEXTURE2D_DESC atlasDesc = {};
+    atlasDesc.Width = ShadowCache::AtlasSize;
+    atlasDesc.Height = ShadowCache::AtlasSize;
+    atlasDesc.MipLevels = 1;
+    atlasDesc.ArraySize = 1;
+    atlasDesc.Format = DXGI_FORMAT_R32_TYPELESS;
+    atlasDesc.SampleDesc.Count = 1;
+    atlasDesc.Usage = D3D11_USAGE_DEFAULT;
+    atlasDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL | D3D11_BIND_SHADER_RESOURCE;
+    hr = m_pDevice->CreateTexture2D(&atlasDesc, nullptr, &m_pShadowAtlas);
+    if (FAILED(hr))
+        return hr;
+
+    D3D11_DEPTH_STENCIL_VIEW_DESC dsvDesc = {};
+    dsvDesc.Format = DXGI_FORMAT_D32_FLOAT;
+    dsvDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
+    hr = m_pDevice->CreateDepthStencilView(m_pShadowAtlas, &dsvDesc, &m_pShadowDSV);
+    if (FAILED(hr))
+        return hr;
+
+    D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+    srvDesc.Format = DXGI_FORMAT_R32_FLOAT;
+    srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+    srvDesc.Texture2D.MipLevels = 1;
+    hr = m_pDevice->CreateShaderResourceView(m_pShadowAtlas, &srvDesc, &m_pShadowSRV);
+    if (FAILED(hr))
+        return hr;
+
+    //  :  ,     DSV
+    atlasDesc.Width = CascadeMapSize;
+    atlasDesc.Height = CascadeMapSize;
+    atlasDesc.ArraySize = CascadedShadows::MaxCascades;
+    hr = m_pDevice->CreateTexture2D(&atlasDesc, nullptr, &m_pCascadeMap);
+    if (FAILED(hr))
+        return hr;
+
+    dsvDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2DARRAY;
+    dsvDesc.Texture2DArray.ArraySize = 1;
+    for (UINT i = 0; i < CascadedShadows::MaxCascades; i++)
+    {
+        dsvDesc.Texture2DArray.FirstArraySlice = i;
+        hr = m_pDevice->CreateDepthStencilView(m_pCascadeMap, &dsvDesc, &m_pCascadeDSV[i]);
+        if (FAILED(hr))
+            return hr;
+    }
+
+    srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+    srvDesc.Texture2DArray.MostDetailedMip = 0;
+    srvDesc.Texture2DArray.MipLevels = 1;
+    srvDesc.Texture2DArray.FirstArraySlice = 0;
+    srvDesc.Texture2DArray.ArraySize = CascadedShadows::MaxCascades;
+    hr = m_pDevice->CreateShaderResourceView(m_pCascadeMap, &srvDesc, &m_pCascadeSRV);
+    if (FAILED(hr))
+        return hr;
+
+    //    " ",   
+    D3D11_RASTERIZER_DESC rasterizerDesc = {};
+    rasterizerDesc.FillMode = D3D11_FILL_SOLID;
+    rasterizerDesc.CullMode = D3D11_CULL_BACK;
+    rasterizerDesc.DepthBias = 1000;
+    rasterizerDesc.SlopeScaledDepthBias = 2.0f;
+    rasterizerDesc.DepthClipEnable = TRUE;
+    hr = m_pDevice->CreateRasterizerState(&rasterizerDesc, &m_pShadowRaster);
+    if (FAILED(hr))
+        return hr;
+
+    D3D11_DEPTH_STENCIL_DESC clearDesc = {};
+    clearDesc.DepthEnable = TRUE;
+    clearDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ALL;
+    clearDesc.DepthFunc = D3D11_COMPARISON_ALWAYS;
+    hr = m_pDevice->CreateDepthStencilState(&clearDesc, &m_pShadowClearState);
+    if (FAILED(hr))
+        return hr;
+
+    //      PCF 2x2   
+    D3D11_SAMPLER_DESC samplerDesc = {};
+    samplerDesc.Filter = D3D11_FILTER_COMPARISON_MIN_MAG_LINEAR_MIP_POINT;
+    samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_CLAMP;
+    samplerDesc.AddressV = D3D11_TEXTURE_ADDRESS_CLAMP;
+    samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
+    samplerDesc.ComparisonFunc = D3D11_COMPARISON_LESS_EQUAL;
+    samplerDesc.MaxLOD = D3D11_FLOAT32_MAX;
+    hr = m_pDevice->CreateSamplerState(&samplerDesc, &m_pShadowSampler);
+    if (FAILED(hr))
+        return hr;
+
+    //      SceneRenderer  backend;      
+    D3D11PipelineDesc pipelineDesc = { m_pShadowClearVS, nullptr, nullptr, nullptr, m_pShadowClearState, m_pShadowRaster, nullptr, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST };
+    m_scenePipelines.shadowClear = m_backend.RegisterPipeline(pipelineDesc);
+    pipelineDesc.pVertexShader = m_pShadowVS;
+    pipelineDesc.pInputLayout = m_pShadowLayout;
+    pipelineDesc.pDepthStencilState = nullptr;
+    m_scenePipelines.shadowCaster = m_backend.RegisterPipeline(pipelineDesc);
+    m_scenePipelines.shadowSampler = m_backend.RegisterSampler(m_pShadowSampler);
+
+    //       SceneRenderer::Init
+    m_sceneTargets.shadowAtlas = m_backend.RegisterTarget(nullptr, m_pShadowDSV);
+    for (UINT i = 0; i < CascadedShadows::MaxCascades; i++)
+        m_sceneTargets.cascades[i] = m_backend.RegisterTarget(nullptr, m_pCascadeDSV[i]);
+    m_sceneTargets.cascadeSize = CascadeMapSize;
+    m_sceneTextures.shadowAtlas = m_backend.RegisterTexture(m_pShadowSRV);
+    m_sceneTextures.cascades = m_backend.RegisterTexture(m_pCascadeSRV);
+    return S_OK;
+}
 
-    m_modelInstances.clear();
+void RenderClass::TerminateShadows()
+{
+    if (m_pShadowAtlas) m_pShadowAtlas->Release();
+    if (m_pShadowDSV) m_pShadowDSV->Release();
+    if (m_pShadowSRV) m_pShadowSRV->Release();
+    if (m_pShadowVS) m_pShadowVS->Release();
+    if (m_pShadowClearVS) m_pShadowClearVS->Release();
+    if (m_pShadowLayout) m_pShadowLayout->Release();
+    if (m_pShadowRaster) m_pShadowRaster->Release();
+    if (m_pShadowClearState) m_pShadowClearState->Release();
+    if (m_pShadowSampler) m_pShadowSampler->Release();
+    if (m_pCascadeMap) m_pCascadeMap->Release();
+    for (ID3D11DepthStencilView*& pView : m_pCascadeDSV)
+    {
+        if (pView) pView->Release();
+        pView = nullptr;
+    }
+    if (m_pCascadeSRV) m_pCascadeSRV->Release();
+    m_pShadowAtlas = nullptr;
+    m_pShadowDSV = nullptr;
+    m_pShadowSRV = nullptr;
+    m_pShadowVS = nullptr;
+    m_pShadowClearVS = nullptr;
+    m_pShadowLayout = nullptr;
+    m_pShadowRaster = nullptr;
+    m_pShadowClearState = nullptr;
+    m_pShadowSampler = nullptr;
+    m_pCascadeMap = nullptr;
+    m_pCascadeSRV = nullptr;
 }
 
 void RenderClass::TerminateSkybox()
 {
-    if (m_pSkyboxVB) m_pSkyboxVB->Release();
-    if (m_pSkyboxSRV) m_pSkyboxSRV->Release();
-    if (m_pSkyboxVPBuffer) m_pSkyboxVPBuffer->Release();
+    if (m_pSkyboxDepthState) m_pSkyboxDepthState->Release();
+    if (m_pSkyboxRaster) m_pSkyboxRaster->Release();
     if (m_pSkyboxLayout) m_pSkyboxLayout->Release();
     if (m_pSkyboxVS) m_pSkyboxVS->Release();
     if (m_pSkyboxPS) m_pSkyboxPS->Release();
@@ -782,103 +1153,661 @@ void RenderClass::RotateCamera(float lrAngle, float udAngle)
     if (m_UDAngle < -XM_PIDIV2) m_UDAngle = -XM_PIDIV2;
 }
 
-void RenderClass::Render() {
-    ID3D11ShaderResourceView* nullSRVs[1] = { nullptr };
-    m_pDeviceContext->PSSetShaderResources(0, 1, nullSRVs);
-    m_pDeviceContext->VSSetShaderResources(0, 1, nullSRVs);
-
-
-    const float backgroundColor[4] = { 0.48f, 0.57f, 0.48f, 1.0f };
-    m_pDeviceContext->ClearRenderTargetView(m_pPostProcessRTV, backgroundColor);
-    m_pDeviceContext->ClearRenderTargetView(m_pRenderTargetView, backgroundColor);
-    m_pDeviceContext->ClearDepthStencilView(m_pDepthView, D3D11_CLEAR_DEPTH, 1.0f, 0);
-
-    m_pDeviceContext->OMSetRenderTargets(1, &m_pPostProcessRTV, m_pDepthView);
-
-    XMMATRIX rotationY = XMMatrixRotationY(m_LRAngle);
-    XMMATRIX rotationX = XMMatrixRotationX(m_UDAngle);
-    XMMATRIX combinedRotation = (m_CameraPosition.z <= 0)
-        ? rotationY * rotationX
-        : rotationX * rotationY;
-
-    XMVECTOR cameraPosition = XMLoadFloat3(&m_CameraPosition);
-    XMVECTOR forwardVector = XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f);
-    XMVECTOR lookDirection = XMVector3TransformNormal(forwardVector, combinedRotation);
-    XMVECTOR lookAtPoint = XMVectorAdd(cameraPosition, XMVector3TransformNormal(XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f), combinedRotation));
-    XMMATRIX viewMatrix = XMMatrixLookAtLH(
-        cameraPosition,
-        lookAtPoint,
-        XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)
-    );
+HRESULT RenderClass::InitScene()
+{
+    //    , RenderClass    ,   
+    m_sceneTargets.colorFormat = DXGI_FORMAT_R8G8B8A8_UNORM;
+    m_scene.SetThreadPool(&ThreadPool::Get());
+    m_scene.SetViewport(m_backBufferWidth, m_backBufferHeight);
+    UpdateSceneEnvironment();
+    return m_scene.Init(m_backend, m_scenePipelines, m_sceneTargets) ? S_OK : E_FAIL;
+}
 
-    RECT clientRect;
-    GetClientRect(FindWindow(m_szWindowClass, m_szTitle), &clientRect);
-    float aspect = static_cast<float>(clientRect.right - clientRect.left) / (clientRect.bottom - clientRect.top);
+void RenderClass::UpdateSceneEnvironment()
+{
+    SceneEnvironment environment = {};
+    //       
+    environment.pIrradianceSH = m_pPrefilteredSRV ? m_environmentLighting.GetIrradianceSH() : nullptr;
+    environment.prefilteredMipCount = m_pPrefilteredSRV ? m_environmentLighting.GetPrefilteredMipCount() : 0;
+    environment.interpolateProbes = [this](const XMFLOAT3* pPositions, uint32_t count, XMFLOAT4* pCoefficients)
+    {
+        m_lightProbes.Interpolate(pPositions, count, pCoefficients);
+    };
+    environment.reflectionProbes = m_loadedReflectionProbes;
+    environment.reflectionProbeMips = m_reflectionProbeMips;
+    m_scene.SetEnvironment(environment);
+}
 
-    XMMATRIX projectionMatrix = XMMatrixPerspectiveFovLH(
-        XM_PIDIV4,
-        aspect,
-        0.1f,
-        100.0f
-    );
+void RenderClass::UpdateScene()
+{
+    //   SceneRenderer,      ,    
+    SceneSettings settings = {};
+    //       ,    ,
+    //         
+    settings.animate = !m_useBakedLighting && !m_lightmapBaker.IsRunning();
+    settings.useSoftware = m_useSoftware;
+    settings.useNegative = m_useNegative;
+    settings.useShadows = m_useShadows;
+    settings.shadowFacesPerFrame = static_cast<uint32_t>(m_shadowFacesPerFrame);
+    settings.useSun = m_useSun;
+    settings.sunAzimuth = m_sunAzimuth;
+    settings.sunElevation = m_sunElevation;
+    settings.cascadeCount = static_cast<uint32_t>(m_cascadeCount);
+    settings.cascadeSplitLambda = m_cascadeSplitLambda;
+    settings.extraLightCount = static_cast<uint32_t>(m_extraLightCount);
+    settings.useInstanceLights = m_useInstanceLights;
+    settings.useLightProbes = m_useLightProbes && m_lightProbes.IsBaked();
+    settings.useReflectionProbes = m_useReflectionProbes;
+    settings.useBakedLighting = m_useBakedLighting;
+    settings.ambientIntensity = m_ambientIntensity;
+    settings.reflectionIntensity = m_reflectionIntensity;
+    settings.reflectionRoughness = m_reflectionRoughness;
+    m_scene.SetSettings(settings);
+    m_scene.SetTextures(m_sceneTextures);
+    m_scene.SetCamera(m_CameraPosition, m_LRAngle, m_UDAngle);
+    m_scene.Update();
+
+    BuildSoftwareFrame();
+
+    //   :      
+    if (m_lightProbesAvailable && m_useLightProbes && !m_lightProbes.IsBaked())
+        BakeLightProbes();
+}
 
-    RenderSkybox(projectionMatrix);
-    RenderCubes(viewMatrix, projectionMatrix);
-    RenderParallelogram();
+void RenderClass::LoadLightmaps()
+{
+    ID3D11ShaderResourceView* pView = nullptr;
+    HRESULT hr = DirectX::CreateDDSTextureFromFile(m_pDevice, L"lightmaps.dds", nullptr, &pView);
+    if (FAILED(hr))
+        return;
 
-    m_pDeviceContext->PSSetShaderResources(0, 1, nullSRVs);
-    m_pDeviceContext->OMSetRenderTargets(1, &m_pRenderTargetView, nullptr);
+    //        
+    if (m_pLightmapSRV)
+    {
+        ID3D11ShaderResourceView* pOld = m_pLightmapSRV;
+        m_frameManager.DeferRelease([pOld]() { pOld->Release(); });
+    }
+    m_pLightmapSRV = pView;
+    m_backend.UnregisterTexture(m_sceneTextures.lightmaps);
+    m_sceneTextures.lightmaps = m_backend.RegisterTexture(m_pLightmapSRV);
+    m_useBakedLighting = true;
+}
 
-    if (m_useNegative)
+void RenderClass::LoadReflectionProbes()
+{
+    //      ,     
+    const std::vector<XMFLOAT3>& positions = m_reflectionBaker.GetPositions();
+    std::vector<ID3D11Texture2D*> probes;
+    D3D11_TEXTURE2D_DESC probeDesc = {};
+    HRESULT hr = S_OK;
+    for (UINT i = 0; i < positions.size() && SUCCEEDED(hr); i++)
     {
-        m_pDeviceContext->VSSetShader(m_pPostProcessVS, nullptr, 0);
-        m_pDeviceContext->PSSetShader(m_pPostProcessPS, nullptr, 0);
-        m_pDeviceContext->IASetInputLayout(m_pFullScreenLayout);
+        std::string path = ReflectionProbeBaker::GetPath("reflection_probe_%u.dds", i);
+        std::wstring widePath(path.begin(), path.end());
+        ID3D11Resource* pResource = nullptr;
+        //       ,        
+        hr = DirectX::CreateDDSTextureFromFileEx(m_pDevice, widePath.c_str(), 0, D3D11_USAGE_DEFAULT,
+            D3D11_BIND_SHADER_RESOURCE, 0, 0, DirectX::DDS_LOADER_MEMORY_MAP, &pResource, nullptr);
+        if (FAILED(hr))
+            break;
 
-        m_pDeviceContext->PSSetShaderResources(0, 1, &m_pPostProcessSRV);
-        m_pDeviceContext->PSSetSamplers(0, 1, &m_pSamplerState);
+        ID3D11Texture2D* pTexture = nullptr;
+        hr = pResource->QueryInterface(__uuidof(ID3D11Texture2D), reinterpret_cast<void**>(&pTexture));
+        pResource->Release();
+        if (FAILED(hr))
+            break;
+        probes.push_back(pTexture);
+
+        D3D11_TEXTURE2D_DESC desc;
+        pTexture->GetDesc(&desc);
+        if (i == 0)
+            probeDesc = desc;
+        else if (desc.Width != probeDesc.Width || desc.MipLevels != probeDesc.MipLevels || desc.Format != probeDesc.Format)
+            hr = E_FAIL;
+    }
 
-        UINT stride = sizeof(FullScreenVertex);
-        UINT offset = 0;
-        m_pDeviceContext->IASetVertexBuffers(0, 1, &m_pFullScreenVB, &stride, &offset);
-        m_pDeviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-        m_pDeviceContext->Draw(3, 0);
+    ID3D11Texture2D* pArray = nullptr;
+    if (SUCCEEDED(hr) && !probes.empty())
+    {
+        D3D11_TEXTURE2D_DESC arrayDesc = probeDesc;
+        arrayDesc.ArraySize = 6 * static_cast<UINT>(probes.size());
+        arrayDesc.Usage = D3D11_USAGE_DEFAULT;
+        arrayDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+        arrayDesc.CPUAccessFlags = 0;
+        arrayDesc.MiscFlags = D3D11_RESOURCE_MISC_TEXTURECUBE;
+        hr = m_pDevice->CreateTexture2D(&arrayDesc, nullptr, &pArray);
     }
-    else
+    if (SUCCEEDED(hr) && pArray)
+    {
+        for (UINT i = 0; i < probes.size(); i++)
+        {
+            for (UINT face = 0; face < 6; face++)
+            {
+                for (UINT mip = 0; mip < probeDesc.MipLevels; mip++)
+                {
+                    m_pDeviceContext->CopySubresourceRegion(pArray, D3D11CalcSubresource(mip, i * 6 + face, probeDesc.MipLevels),
+                        0, 0, 0, probes[i], D3D11CalcSubresource(mip, face, probeDesc.MipLevels), nullptr);
+                }
+            }
+        }
+    }
+    for (ID3D11Texture2D* pTexture : probes)
+        pTexture->Release();
+
+    ID3D11ShaderResourceView* pView = nullptr;
+    if (SUCCEEDED(hr) && pArray)
+    {
+        D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+        srvDesc.Format = probeDesc.Format;
+        srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURECUBEARRAY;
+        srvDesc.TextureCubeArray.MostDetailedMip = 0;
+        srvDesc.TextureCubeArray.MipLevels = probeDesc.MipLevels;
+        srvDesc.TextureCubeArray.First2DArrayFace = 0;
+        srvDesc.TextureCubeArray.NumCubes = static_cast<UINT>(probes.size());
+        hr = m_pDevice->CreateShaderResourceView(pArray, &srvDesc, &pView);
+    }
+    if (pArray) pArray->Release();
+    if (FAILED(hr) || !pView)
+        return;
+
+    //        
+    if (m_pReflectionProbeSRV)
+    {
+        ID3D11ShaderResourceView* pOld = m_pReflectionProbeSRV;
+        m_frameManager.DeferRelease([pOld]() { pOld->Release(); });
+    }
+    m_pReflectionProbeSRV = pView;
+    m_backend.UnregisterTexture(m_sceneTextures.reflectionProbes);
+    m_sceneTextures.reflectionProbes = m_backend.RegisterTexture(m_pReflectionProbeSRV);
+    m_reflectionProbeMips = probeDesc.MipLevels;
+    m_loadedReflectionProbes = positions;
+    UpdateSceneEnvironment();
+}
+
+void RenderClass::BenchmarkTextureLoading()
+{
+    //  DDS  :   ,      
+    std::vector<std::wstring> widePaths;
+    std::vector<std::string> paths;
+    WIN32_FIND_DATAW findData;
+    HANDLE hFind = FindFirstFileW(L"*.dds", &findData);
+    if (hFind != INVALID_HANDLE_VALUE)
+    {
+        do
+        {
+            if (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+                continue;
+            char path[MAX_PATH];
+            if (WideCharToMultiByte(CP_UTF8, 0, findData.cFileName, -1, path, MAX_PATH, nullptr, nullptr) <= 0)
+                continue;
+            widePaths.push_back(findData.cFileName);
+            paths.push_back(path);
+        } while (FindNextFileW(hFind, &findData));
+        FindClose(hFind);
+    }
+
+    const UINT passes = 10;
+    m_ddsBenchmark = DirectX::DDSLayout::BenchmarkLoading(paths, passes);
+
+    const DirectX::DDS_LOADER_FLAGS modes[2] = { DirectX::DDS_LOADER_DEFAULT, DirectX::DDS_LOADER_MEMORY_MAP };
+    for (int mode = 0; mode < 2; mode++)
+    {
+        uint64_t start = Profiler::NowNs();
+        for (UINT pass = 0; pass < passes; pass++)
+        {
+            for (const std::wstring& path : widePaths)
+            {
+                ID3D11Resource* pResource = nullptr;
+                HRESULT hr = DirectX::CreateDDSTextureFromFileEx(m_pDevice, path.c_str(), 0, D3D11_USAGE_DEFAULT,
+                    D3D11_BIND_SHADER_RESOURCE, 0, 0, modes[mode], &pResource, nullptr);
+                if (SUCCEEDED(hr))
+                    pResource->Release();
+            }
+        }
+        m_ddsDeviceMs[mode] = (Profiler::NowNs() - start) * 1.0e-6;
+    }
+
+    //      :     ,       GPU
+    const UINT arraySlices = 256;
+    const std::vector<std::string> arrayPaths = { "cat.dds", "textile.dds", "cube_normal.dds", "skybox.dds" };
+    m_ddsArrayBenchmark = DirectX::DDSLayout::BenchmarkArrayLayout(arrayPaths, arraySlices);
+    std::vector<const wchar_t*> arrayFiles(arraySlices);
+    for (UINT i = 0; i < arraySlices; i++)
+        arrayFiles[i] = (i & 1) ? L"textile.dds" : L"cat.dds";
+    uint64_t start = Profiler::NowNs();
+    ID3D11Resource* pArray = nullptr;
+    m_ddsArrayResult = DirectX::CreateDDSTextureArrayFromFiles(m_pDevice, arrayFiles.data(), arrayFiles.size(), &pArray, nullptr);
+    m_ddsArrayMs = (Profiler::NowNs() - start) * 1.0e-6;
+    if (pArray)
+        pArray->Release();
+}
+
+void RenderClass::PrepareNormalMap()
+{
+    // BC5  X  Y     , Z  ColorPixel.ps.
+    //      ,        BC1;   ,
+    //    
+    if (GetFileAttributesA("cube_normal_bc5.dds") != INVALID_FILE_ATTRIBUTES)
+    {
+        m_normalMapPath = "cube_normal_bc5.dds";
+        return;
+    }
+    m_normalMapPath = "cube_normal.dds";
+    m_normalCookRunning = true;
+    m_normalCookThread = std::thread([this]()
+    {
+        Profiler::Get().SetThreadName("Normal Map Cook");
+        ThreadPool::SetThreadPriority(ThreadPool::Priority::Background);
+
+        //       ,      
+        TextureCooker cooker;
+        cooker.SetThreadPool(&ThreadPool::Get());
+        TextureCookSettings settings = { BlockFormat::BC5, 2, false, true, MipFilter::Box, false };
+        m_normalCookSucceeded = cooker.CookFile("cube_normal.dds", "cube_normal_bc5.tmp", settings) &&
+            MoveFileExA("cube_normal_bc5.tmp", "cube_normal_bc5.dds", MOVEFILE_REPLACE_EXISTING);
+        m_normalCookRunning = false;
+    });
+}
+
+void RenderClass::FinishNormalMapCook(bool wait)
+{
+    if (!m_normalCookThread.joinable() || (!wait && m_normalCookRunning.load()))
+        return;
+    m_normalCookThread.join();
+    if (!m_normalCookSucceeded)
+        return;
+
+    //       ,      
+    m_normalMapPath = "cube_normal_bc5.dds";
+    m_textureStreamer.Release(m_normalTexture);
+    m_normalTexture = m_textureStreamer.Request(GetStreamPath(m_normalMapPath), 1);
+}
+
+void RenderClass::CookTextures()
+{
+    //       
+    FinishNormalMapCook(true);
+
+    //    ,   :     ,    ,   
+    struct CookJob
+    {
+        const char* source;
+        const char* dest;
+        const wchar_t* wideDest;
+        BlockFormat format;
+        bool generateMips;
+        bool normalMap;
+        MipFilter mipFilter;
+        bool srgb;
+    };
+    //    :       ,   
+    static const CookJob jobs[CookedTextureCount] =
+    {
+        { "cat.dds", "cat_bc7.dds", L"cat_bc7.dds", BlockFormat::BC7, false, false, MipFilter::Box, false },
+        { "textile.dds", "textile_bc3.dds", L"textile_bc3.dds", BlockFormat::BC3, false, false, MipFilter::Box, false },
+        { "cube_normal.dds", "cube_normal_bc5.dds", L"cube_normal_bc5.dds", BlockFormat::BC5, false, true, MipFilter::Box, false },
+        { "skybox.dds", "skybox_bc1.dds", L"skybox_bc1.dds", BlockFormat::BC1, true, false, MipFilter::Kaiser, true },
+    };
+
+    TextureCooker cooker;
+    cooker.SetThreadPool(&ThreadPool::Get());
+    for (UINT i = 0; i < CookedTextureCount; i++)
+    {
+        CookedTexture& result = m_cookedTextures[i];
+        TextureCookSettings settings = { jobs[i].format, 2, jobs[i].generateMips, jobs[i].normalMap, jobs[i].mipFilter, jobs[i].srgb };
+        result.path = jobs[i].dest;
+        result.cooked = cooker.CookFile(jobs[i].source, jobs[i].dest, settings);
+        result.stats = cooker.GetStats();
+        result.loaded = false;
+        if (!result.cooked)
+            continue;
+
+        ID3D11Resource* pResource = nullptr;
+        if (SUCCEEDED(DirectX::CreateDDSTextureFromFile(m_pDevice, jobs[i].wideDest, &pResource, nullptr)))
+        {
+            result.loaded = true;
+            pResource->Release();
+        }
+    }
+}
+
+void RenderClass::PackTextures()
+{
+    // ,   ;      .  
+    //  ,    
+    const char* sources[PackedTextureCount] = { "cat.dds", "textile.dds", m_normalMapPath, "skybox.dds" };
+    TexturePacker packer;
+    packer.SetThreadPool(&ThreadPool::Get());
+    for (UINT i = 0; i < PackedTextureCount; i++)
+    {
+        PackedTexture& result = m_packedTextures[i];
+        result.path = PackedPath(sources[i]);
+        result.packed = packer.PackFile(sources[i], result.path.c_str(), TexturePacker::GetDefaultSettings());
+        result.stats = packer.GetStats();
+    }
+    RestreamTextures();
+}
+
+void RenderClass::BakeLightProbes()
+{
+    PROFILE_SCOPE("Bake Light Probes");
+
+    const std::vector<SwCubeInstance>& cubes = m_softwareFrame.sceneCubes;
+    if (cubes.empty())
+        return;
+
+    //    1         
+    XMVECTOR boundsMin = XMVectorReplicate(FLT_MAX);
+    XMVECTOR boundsMax = XMVectorReplicate(-FLT_MAX);
+    for (const SwCubeInstance& cube : cubes)
+    {
+        XMVECTOR position = XMVectorSet(cube.model._41, cube.model._42, cube.model._43, 0.0f);
+        boundsMin = XMVectorMin(boundsMin, position);
+        boundsMax = XMVectorMax(boundsMax, position);
+    }
+    XMVECTOR margin = XMVectorReplicate(SceneRenderer::GetCubeScale() * 3.0f);
+    ProbeGridSettings settings = {};
+    XMStoreFloat3(&settings.boundsMin, XMVectorSubtract(boundsMin, margin));
+    XMStoreFloat3(&settings.boundsMax, XMVectorAdd(boundsMax, margin));
+    settings.spacing = 1.0f;
+    settings.raysPerProbe = static_cast<uint32_t>(m_probeRays);
+    m_lightProbes.Bake(cubes, m_softwareFrame.lights, m_environmentLighting.GetIrradianceSH(), settings);
+}
+
+void RenderClass::UpdateMipFeedback(const UINT* pIds, UINT count)
+{
+    StreamTextureInfo diffuse = m_textureStreamer.GetInfo(m_diffuseTexture);
+    StreamTextureInfo normal = m_textureStreamer.GetInfo(m_normalTexture);
+    UINT diffuseMip = 0;
+    UINT normalMip = 0;
+    if (m_useMipFeedback)
+    {
+        //   ;     0  1   2 * GetCubeScale()
+        const std::vector<CubeInstanceData>& instances = m_scene.GetInstances();
+        float scale = SceneRenderer::GetCubeScale();
+        m_mipInstances.resize(count);
+        for (UINT i = 0; i < count; i++)
+        {
+            const CubeInstanceData& instance = instances[pIds[i]];
+            MipFeedbackInstance& feedback = m_mipInstances[i];
+            feedback.center = XMFLOAT3(instance.model._41, instance.model._42, instance.model._43);
+            feedback.radius = scale * 1.7320508f;
+            feedback.uvDensity = 0.5f / scale;
+            feedback.key = instance.texInd;
+        }
+        m_mipFeedback.SetCamera(m_scene.GetView(), m_scene.GetProj(), static_cast<float>(m_backBufferHeight));
+        m_mipFeedback.Build(m_mipInstances.data(), count, 2);
+
+        //     ,       ,
+        //      
+        for (UINT key = 0; key < 2; key++)
+            m_wantedMips[key] = MipFeedback::RequiredMip(m_mipFeedback.GetUvPerPixel(key), diffuse.width, diffuse.height, diffuse.mipCount);
+        float uvPerPixel = std::min(m_mipFeedback.GetUvPerPixel(0), m_mipFeedback.GetUvPerPixel(1));
+        m_wantedMips[2] = MipFeedback::RequiredMip(uvPerPixel, normal.width, normal.height, normal.mipCount);
+        diffuseMip = std::min(m_wantedMips[0], m_wantedMips[1]);
+        normalMip = m_wantedMips[2];
+    }
+    m_textureStreamer.Touch(m_diffuseTexture, diffuseMip);
+    m_textureStreamer.Touch(m_normalTexture, normalMip);
+}
+
+void RenderClass::BuildSoftwareFrame()
+{
+    SwSceneFrame& frame = m_softwareFrame;
+    XMMATRIX proj = XMLoadFloat4x4(&m_scene.GetProj());
+    XMMATRIX viewProj = XMLoadFloat4x4(&m_scene.GetView()) * proj;
+    XMStoreFloat4x4(&frame.viewProj, viewProj);
+    XMStoreFloat4x4(&frame.invViewProj, XMMatrixInverse(nullptr, viewProj));
+    XMStoreFloat4x4(&frame.skyboxViewProj, XMLoadFloat4x4(&m_scene.GetSkyboxView()) * proj);
+    frame.cameraPos = m_scene.GetCameraPosition();
+    const SceneRenderer::PointLight* pLights = m_scene.GetSceneLights();
+    for (int i = 0; i < 3; i++)
+        frame.lights[i] = { pLights[i].Position, pLights[i].Range, pLights[i].Color, pLights[i].Intensity };
+
+    //      CPU,     compute shader
+    frame.cubes.clear();
+    frame.sceneCubes.clear();
+    for (const CubeInstanceData& instance : m_scene.GetInstances())
+    {
+        SwCubeInstance cube;
+        cube.model = instance.model;
+        cube.textureIndex = instance.texInd;
+        frame.sceneCubes.push_back(cube);
+
+        XMFLOAT3 cubePos(instance.model._41, instance.model._42, instance.model._43);
+        if (m_scene.IsInFrustum(cubePos, SceneRenderer::GetCubeScale() * 0.95f))
+            frame.cubes.push_back(cube);
+    }
+
+    //   :      
+    frame.markers.clear();
+    frame.parallelograms.clear();
+    const DrawBatcher& batcher = m_scene.GetBatcher();
+    const std::vector<InstanceColorData>& instances = batcher.GetInstances();
+    for (const auto& batch : batcher.GetBatches())
+    {
+        bool marker = batch.key.shader == SceneRenderer::ShaderLightMarker;
+        std::vector<SwColoredInstance>& target = marker ? frame.markers : frame.parallelograms;
+        for (uint32_t i = 0; i < batch.instanceCount; i++)
+        {
+            const InstanceColorData& data = instances[batch.firstInstance + i];
+            SwColoredInstance instance;
+            XMStoreFloat4x4(&instance.model, XMMatrixTranspose(XMLoadFloat4x4(&data.model)));
+            instance.color = data.color;
+            target.push_back(instance);
+        }
+    }
+
+    frame.negative = m_useNegative;
+}
+
+void RenderClass::RenderSoftware()
+{
+    m_softwareRenderer.Render(m_softwareFrame, m_backBufferWidth, m_backBufferHeight);
+    m_visibleCubes = static_cast<int>(m_softwareFrame.cubes.size());
+
+    const SoftwareRasterizer& rasterizer = m_softwareRenderer.GetRasterizer();
+    if (m_pSoftwareTarget)
     {
-        ID3D11Resource* srcResource = nullptr;
-        m_pPostProcessSRV->GetResource(&srcResource);
+        D3D11_TEXTURE2D_DESC desc;
+        m_pSoftwareTarget->GetDesc(&desc);
+        if (desc.Width != rasterizer.GetWidth() || desc.Height != rasterizer.GetHeight())
+        {
+            ID3D11Texture2D* pOld = m_pSoftwareTarget;
+            m_frameManager.DeferRelease([pOld]() { pOld->Release(); });
+            m_pSoftwareTarget = nullptr;
+        }
+    }
+
+    if (!m_pSoftwareTarget)
+    {
+        //    back buffer,     CopyResource
+        D3D11_TEXTURE2D_DESC texDesc = {};
+        texDesc.Width = rasterizer.GetWidth();
+        texDesc.Height = rasterizer.GetHeight();
+        texDesc.MipLevels = 1;
+        texDesc.ArraySize = 1;
+        texDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+        texDesc.SampleDesc.Count = 1;
+        texDesc.Usage = D3D11_USAGE_DEFAULT;
+        if (FAILED(m_pDevice->CreateTexture2D(&texDesc, nullptr, &m_pSoftwareTarget)))
+            return;
+    }
 
-        ID3D11Resource* dstResource = nullptr;
-        m_pRenderTargetView->GetResource(&dstResource);
+    {
+        PROFILE_SCOPE("Software Upload");
+        m_pDeviceContext->UpdateSubresource(m_pSoftwareTarget, 0, nullptr, rasterizer.GetColor(),
+            rasterizer.GetPitch() * sizeof(uint32_t), 0);
 
-        if (srcResource && dstResource)
+        ID3D11Texture2D* pBackBuffer = nullptr;
+        if (SUCCEEDED(m_pSwapChain->GetBuffer(0, __uuidof(ID3D11Texture2D), (LPVOID*)&pBackBuffer)))
         {
-            m_pDeviceContext->CopyResource(dstResource, srcResource);
+            m_pDeviceContext->CopyResource(pBackBuffer, m_pSoftwareTarget);
+            pBackBuffer->Release();
         }
+    }
+}
+
+HRESULT RenderClass::AcquireGraphTargets()
+{
+    const RenderGraph& graph = m_scene.GetGraph();
+    size_t count = graph.GetPhysicalCount();
 
-        if (srcResource) srcResource->Release();
-        if (dstResource) dstResource->Release();
+    //    ,      
+    ReleaseGraphTargets(count);
+    m_graphTargets.resize(count, GraphTarget{ {}, nullptr, nullptr, nullptr, InvalidBackendHandle, InvalidBackendHandle, InvalidBackendHandle });
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const RenderGraph::TextureDesc& desc = graph.GetPhysicalDesc(static_cast<uint32_t>(i));
+        GraphTarget& target = m_graphTargets[i];
+        if (target.texture && target.desc == desc)
+            continue;
+
+        ReleaseGraphTarget(target);
+        target = GraphTarget{ desc, nullptr, nullptr, nullptr, InvalidBackendHandle, InvalidBackendHandle, InvalidBackendHandle };
+
+        D3D11_TEXTURE2D_DESC texDesc = {};
+        texDesc.Width = desc.width;
+        texDesc.Height = desc.height;
+        texDesc.MipLevels = 1;
+        texDesc.ArraySize = 1;
+        texDesc.Format = static_cast<DXGI_FORMAT>(desc.format);
+        texDesc.SampleDesc.Count = 1;
+        texDesc.Usage = D3D11_USAGE_DEFAULT;
+        texDesc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+
+        HRESULT hr = m_pDevice->CreateTexture2D(&texDesc, nullptr, &target.texture);
+        if (FAILED(hr)) return hr;
+
+        hr = m_pDevice->CreateRenderTargetView(target.texture, nullptr, &target.rtv);
+        if (FAILED(hr)) return hr;
+
+        hr = m_pDevice->CreateShaderResourceView(target.texture, nullptr, &target.srv);
+        if (FAILED(hr)) return hr;
+        target.textureHandle = m_backend.RegisterTexture(target.srv);
+        target.target = m_backend.RegisterTarget(target.rtv, nullptr);
+        target.depthTarget = m_backend.RegisterTarget(target.rtv, m_pDepthView);
     }
 
+    return S_OK;
+}
+
+void RenderClass::ReleaseGraphTarget(const GraphTarget& target)
+{
+    //    ,  GPU   
+    m_backend.UnregisterTexture(target.textureHandle);
+    m_backend.UnregisterTarget(target.target);
+    m_backend.UnregisterTarget(target.depthTarget);
+    m_frameManager.DeferRelease([target]() {
+        if (target.srv) target.srv->Release();
+        if (target.rtv) target.rtv->Release();
+        if (target.texture) target.texture->Release();
+        });
+}
+
+void RenderClass::ReleaseGraphTargets(size_t keepCount)
+{
+    for (size_t i = keepCount; i < m_graphTargets.size(); i++)
+        ReleaseGraphTarget(m_graphTargets[i]);
+    if (keepCount < m_graphTargets.size())
+        m_graphTargets.resize(keepCount);
+}
+
+void RenderClass::ReleaseBackBufferTargets()
+{
+    m_backend.UnregisterTarget(m_backBufferTarget);
+    m_backend.UnregisterTarget(m_backBufferDepthTarget);
+    m_backBufferTarget = InvalidBackendHandle;
+    m_backBufferDepthTarget = InvalidBackendHandle;
+}
+
+BackendHandle RenderClass::GetTarget(RenderGraph::ResourceHandle resource, bool depth)
+{
+    const RenderGraph& graph = m_scene.GetGraph();
+    if (graph.IsImported(resource))
+        return depth ? m_backBufferDepthTarget : m_backBufferTarget;
+    const GraphTarget& target = m_graphTargets[graph.GetPhysicalIndex(resource)];
+    return depth ? target.depthTarget : target.target;
+}
+
+BackendHandle RenderClass::GetTexture(RenderGraph::ResourceHandle resource)
+{
+    const RenderGraph& graph = m_scene.GetGraph();
+    if (graph.IsImported(resource))
+        return InvalidBackendHandle;
+    return m_graphTargets[graph.GetPhysicalIndex(resource)].textureHandle;
+}
+
+void RenderClass::RenderUi()
+{
     RenderImGui();
+}
+
+void RenderClass::Render() {
+    Profiler::Get().MarkFrame();
+    PROFILE_SCOPE("Frame");
+
+    if (m_requestedFramesInFlight != static_cast<int>(m_frameManager.GetFramesInFlight()))
+        ApplyFramesInFlight();
+    m_frameManager.BeginFrame();
+    UpdateTextureStreaming();
+
+    m_backend.BindTexture(ShaderStage::Pixel, 0, InvalidBackendHandle);
+    m_backend.BindTexture(ShaderStage::Vertex, 0, InvalidBackendHandle);
+
+    if (m_lightmapBaker.PollFinished())
+        LoadLightmaps();
+    if (m_reflectionBaker.PollFinished())
+        LoadReflectionProbes();
+
+    UpdateScene();
+
+    //    SceneRenderer,     
+    if (!m_scene.BuildGraph(m_backend, m_frameManager, *this))
+    {
+        OutputDebugStringA(m_scene.GetGraph().GetError().c_str());
+        m_frameManager.EndFrame();
+        return;
+    }
+    if (FAILED(AcquireGraphTargets()))
+    {
+        m_frameManager.EndFrame();
+        return;
+    }
+
+    m_gpuProfiler.BeginFrame();
+    m_backend.BeginFrame();
+    m_scene.GetGraph().Execute();
+    m_backend.EndFrame();
+    m_gpuProfiler.EndFrame();
+
+    //      ,  RenderSoftware
+    if (!m_useSoftware)
+    {
+        const std::vector<uint32_t>& visibleIds = m_scene.GetVisibleIds();
+        m_visibleCubes = static_cast<int>(visibleIds.size());
+        UpdateMipFeedback(visibleIds.data(), static_cast<UINT>(visibleIds.size()));
+        m_textureStreamer.Touch(m_skyboxStream);
+    }
+
+    {
+        PROFILE_SCOPE("Present");
+        m_pSwapChain->Present(1, 0);
+    }
+    m_backend.BindTarget(InvalidBackendHandle);
+    m_backend.BindTexture(ShaderStage::Pixel, 0, InvalidBackendHandle);
 
-    m_pSwapChain->Present(1, 0);
-    m_pDeviceContext->OMSetRenderTargets(0, nullptr, nullptr);
-    m_pDeviceContext->PSSetShaderResources(0, 1, nullSRVs);
+    m_frameManager.EndFrame();
 }
 
 HRESULT RenderClass::ConfigureBackBuffer(UINT width, UINT height)
 {
-    if (m_pPostProcessTexture) m_pPostProcessTexture->Release();
-    if (m_pPostProcessRTV) m_pPostProcessRTV->Release();
-    if (m_pPostProcessSRV) m_pPostProcessSRV->Release();
+    ReleaseGraphTargets(0);
+    ReleaseBackBufferTargets();
     if (m_pRenderTargetView) m_pRenderTargetView->Release();
     if (m_pDepthView) m_pDepthView->Release();
 
-    m_pPostProcessTexture = nullptr;
-    m_pPostProcessRTV = nullptr;
-    m_pPostProcessSRV = nullptr;
     m_pRenderTargetView = nullptr;
     m_pDepthView = nullptr;
 
@@ -907,24 +1836,13 @@ HRESULT RenderClass::ConfigureBackBuffer(UINT width, UINT height)
     pDepthStencil->Release();
     if (FAILED(hr)) return hr;
 
-    D3D11_TEXTURE2D_DESC texDesc = {};
-    texDesc.Width = width;
-    texDesc.Height = height;
-    texDesc.MipLevels = 1;
-    texDesc.ArraySize = 1;
-    texDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-    texDesc.SampleDesc.Count = 1;
-    texDesc.Usage = D3D11_USAGE_DEFAULT;
-    texDesc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
-
-    hr = m_pDevice->CreateTexture2D(&texDesc, nullptr, &m_pPostProcessTexture);
-    if (FAILED(hr)) return hr;
-
-    hr = m_pDevice->CreateRenderTargetView(m_pPostProcessTexture, nullptr, &m_pPostProcessRTV);
-    if (FAILED(hr)) return hr;
+    //      :      
+    m_backBufferTarget = m_backend.RegisterTarget(m_pRenderTargetView, nullptr);
+    m_backBufferDepthTarget = m_backend.RegisterTarget(m_pRenderTargetView, m_pDepthView);
 
-    hr = m_pDevice->CreateShaderResourceView(m_pPostProcessTexture, nullptr, &m_pPostProcessSRV);
-    if (FAILED(hr)) return hr;
+    m_backBufferWidth = width;
+    m_backBufferHeight = height;
+    m_scene.SetViewport(width, height);
 
     D3D11_VIEWPORT vp;
     vp.Width = (FLOAT)width;
@@ -940,6 +1858,12 @@ HRESULT RenderClass::ConfigureBackBuffer(UINT width, UINT height)
 
 void RenderClass::Resize(HWND hWnd)
 {
+    m_frameManager.WaitIdle();
+
+    //       ,   ResizeBuffers  
+    ReleaseGraphTargets(0);
+    ReleaseBackBufferTargets();
+
     if (m_pRenderTargetView)
     {
         m_pRenderTargetView->Release();
@@ -991,7 +1915,7 @@ void RenderClass::Resize(HWND hWnd)
 HRESULT RenderClass::InitParallelogram() {
     ID3DBlob* pVertexCode = nullptr;
 
-    HRESULT result = CompileShader(L"ParallelogramVertex.vs", &m_pParallelogramVS, nullptr, &pVertexCode);
+    HRESULT result = CompileShader(L"InstancedVertex.vs", &m_pInstancedVS, nullptr, &pVertexCode);
     if (FAILED(result))
         return result;
 
@@ -1006,37 +1930,7 @@ HRESULT RenderClass::InitParallelogram() {
     if (FAILED(result))
         return result;
 
-    ParallelogramVertex ParallelogramVertices[] = {
-        {-0.75f, -0.75f, 0.0f},
-        {-0.75f, 0.75f, 0.0f},
-        {0.75f, 0.75f, 0.0f},
-        {0.75f, -0.75f, 0.0f}
-    };
-
-    D3D11_BUFFER_DESC bd = {};
-    bd.Usage = D3D11_USAGE_DEFAULT;
-    bd.ByteWidth = sizeof(ParallelogramVertex) * ARRAYSIZE(ParallelogramVertices);
-    bd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-    bd.CPUAccessFlags = 0;
-
-    D3D11_SUBRESOURCE_DATA initData = {};
-    initData.pSysMem = ParallelogramVertices;
-    result = m_pDevice->CreateBuffer(&bd, &initData, &m_ParallelogramVertexBuffer);
-    if (FAILED(result))
-        return result;
-
-    WORD indices[] = { 0, 1, 2, 0, 2, 3 };
-    bd.ByteWidth = sizeof(indices);
-    bd.BindFlags = D3D11_BIND_INDEX_BUFFER;
-    initData.pSysMem = indices;
-    result = m_pDevice->CreateBuffer(&bd, &initData, &m_pParallelogramIndexBuffer);
-
-    D3D11_BUFFER_DESC cbDesc = {};
-    cbDesc.ByteWidth = sizeof(ColorBuffer);
-    cbDesc.Usage = D3D11_USAGE_DEFAULT;
-    cbDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-    cbDesc.CPUAccessFlags = 0;
-    result = m_pDevice->CreateBuffer(&cbDesc, nullptr, &m_pColorBuffer);
+    m_softwareRenderer.SetMesh(SwMesh::Quad, ToSwMesh(SceneRenderer::GetQuadMesh()));
 
     D3D11_BLEND_DESC blendDesc = {};
     blendDesc.RenderTarget[0].BlendEnable = true;
@@ -1055,586 +1949,724 @@ HRESULT RenderClass::InitParallelogram() {
     dsDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ZERO;
     dsDesc.DepthFunc = D3D11_COMPARISON_LESS;
     result = m_pDevice->CreateDepthStencilState(&dsDesc, &m_pStateParallelogram);
+    if (FAILED(result))
+        return result;
+
+    D3D11_RASTERIZER_DESC rasterDesc = {};
+    rasterDesc.FillMode = D3D11_FILL_SOLID;
+    rasterDesc.CullMode = D3D11_CULL_NONE;
+    rasterDesc.FrontCounterClockwise = FALSE;
+    result = m_pDevice->CreateRasterizerState(&rasterDesc, &m_pRasterNoCull);
+    if (FAILED(result))
+        return result;
 
-    return result;
+    //        ,  
+    D3D11PipelineDesc markerPipeline = { m_pInstancedVS, m_pLightPixelShader, m_pLayout, nullptr,
+        nullptr, nullptr, nullptr, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST };
+    m_scenePipelines.marker = m_backend.RegisterPipeline(markerPipeline);
+
+    D3D11PipelineDesc parallelogramPipeline = { m_pInstancedVS, m_pParallelogramPS, m_pParallelogramLayout, m_pBlendState,
+        m_pStateParallelogram, m_pRasterNoCull, nullptr, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST };
+    m_scenePipelines.parallelogram = m_backend.RegisterPipeline(parallelogramPipeline);
+
+    return S_OK;
 }
 
 void RenderClass::TerminateParallelogram() {
-    if (m_ParallelogramVertexBuffer) m_ParallelogramVertexBuffer->Release();
-    if (m_pParallelogramIndexBuffer) m_pParallelogramIndexBuffer->Release();
     if (m_pParallelogramPS) m_pParallelogramPS->Release();
-    if (m_pParallelogramVS) m_pParallelogramVS->Release();
+    if (m_pInstancedVS) m_pInstancedVS->Release();
     if (m_pParallelogramLayout) m_pParallelogramLayout->Release();
     if (m_pBlendState) m_pBlendState->Release();
     if (m_pStateParallelogram) m_pStateParallelogram->Release();
+    if (m_pRasterNoCull) m_pRasterNoCull->Release();
 }
 
-void RenderClass::RenderSkybox(XMMATRIX projectionMatrix) {
-    XMMATRIX rotationY = XMMatrixRotationY(-m_LRAngle);
-    XMMATRIX rotationX = XMMatrixRotationX(-m_UDAngle);
-    XMMATRIX skyboxView = rotationY * rotationX;
-    XMMATRIX skyboxViewProjection = XMMatrixTranspose(skyboxView * projectionMatrix);
+HRESULT RenderClass::Init2DArray()
+{
+    //      ,        
+    // GetArrayLayout,    CreateDDSTextureArrayFromFiles
+    m_diffuseTexture = m_textureStreamer.Request({ GetStreamPath("cat.dds"), GetStreamPath("textile.dds") }, 1);
+    return m_diffuseTexture != InvalidStreamedTexture ? S_OK : E_FAIL;
+}
 
-    D3D11_MAPPED_SUBRESOURCE mappedResource;
-    if (SUCCEEDED(m_pDeviceContext->Map(m_pSkyboxVPBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource))) {
-        memcpy(mappedResource.pData, &skyboxViewProjection, sizeof(XMMATRIX));
-        m_pDeviceContext->Unmap(m_pSkyboxVPBuffer, 0);
-    }
+HRESULT RenderClass::InitFullScreenTriangle()
+{
+    //   
+    D3D11_INPUT_ELEMENT_DESC inputLayoutDesc[] = {
+        { "POSITION", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+        { "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 16, D3D11_INPUT_PER_VERTEX_DATA, 0 }
+    };
 
-    D3D11_DEPTH_STENCIL_DESC depthStencilDesc = {};
-    depthStencilDesc.DepthEnable = true;
-    depthStencilDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ZERO;
-    depthStencilDesc.DepthFunc = D3D11_COMPARISON_LESS_EQUAL;
+    ID3DBlob* vertexShaderBlob = nullptr;
+    HRESULT hr = CompileShader(L"NegativeVertex.vs", &m_pPostProcessVS, nullptr, &vertexShaderBlob);
+    if (FAILED(hr)) return hr;
 
-    ID3D11DepthStencilState* depthStencilState = nullptr;
-    m_pDevice->CreateDepthStencilState(&depthStencilDesc, &depthStencilState);
-    m_pDeviceContext->OMSetDepthStencilState(depthStencilState, 0);
+    hr = m_pDevice->CreateInputLayout(
+        inputLayoutDesc, 2, vertexShaderBlob->GetBufferPointer(),
+        vertexShaderBlob->GetBufferSize(), &m_pFullScreenLayout
+    );
+    vertexShaderBlob->Release();
+    if (FAILED(hr)) return hr;
 
-    if (depthStencilState) depthStencilState->Release();
+    hr = CompileShader(L"NegativePixel.ps", nullptr, &m_pPostProcessPS);
+    if (FAILED(hr)) return hr;
 
-    D3D11_RASTERIZER_DESC rasterizerDesc = {};
-    rasterizerDesc.FillMode = D3D11_FILL_SOLID;
-    rasterizerDesc.CullMode = D3D11_CULL_FRONT;
-    rasterizerDesc.FrontCounterClockwise = false;
+    D3D11PipelineDesc pipeline = { m_pPostProcessVS, m_pPostProcessPS, m_pFullScreenLayout, nullptr,
+        nullptr, nullptr, m_pSamplerState, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST };
+    m_scenePipelines.postProcess = m_backend.RegisterPipeline(pipeline);
+    return S_OK;
+}
 
-    ID3D11RasterizerState* rasterizerState = nullptr;
-    if (SUCCEEDED(m_pDevice->CreateRasterizerState(&rasterizerDesc, &rasterizerState))) {
-        m_pDeviceContext->RSSetState(rasterizerState);
-    }
+HRESULT RenderClass::InitImGui(HWND hWnd)
+{
+    IMGUI_CHECKVERSION();
+    ImGui::CreateContext();
+    ImGuiIO& io = ImGui::GetIO();
 
-    UINT vertexStride = sizeof(SkyboxVertex);
-    UINT vertexOffset = 0;
-    m_pDeviceContext->IASetVertexBuffers(0, 1, &m_pSkyboxVB, &vertexStride, &vertexOffset);
-    m_pDeviceContext->IASetInputLayout(m_pSkyboxLayout);
-    m_pDeviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    ImGui::StyleColorsDark();
+    ImGui_ImplWin32_Init(hWnd);
 
-    m_pDeviceContext->VSSetShader(m_pSkyboxVS, nullptr, 0);
-    m_pDeviceContext->VSSetConstantBuffers(0, 1, &m_pSkyboxVPBuffer);
+    //    backend: id  ImGui -    backend
+    io.BackendRendererName = "RenderBackend";
+    io.BackendFlags |= ImGuiBackendFlags_RendererHasVtxOffset;
 
-    m_pDeviceContext->PSSetShader(m_pSkyboxPS, nullptr, 0);
-    m_pDeviceContext->PSSetShaderResources(0, 1, &m_pSkyboxSRV);
-    m_pDeviceContext->PSSetSamplers(0, 1, &m_pSamplerState);
+    ID3DBlob* pVertexCode = nullptr;
+    HRESULT hr = CompileShader(L"ImGuiVertex.vs", &m_pImGuiVS, nullptr, &pVertexCode);
+    if (FAILED(hr))
+        return hr;
 
-    m_pDeviceContext->Draw(36, 0);
+    D3D11_INPUT_ELEMENT_DESC layout[] =
+    {
+        { "POSITION", 0, DXGI_FORMAT_R32G32_FLOAT,   0, offsetof(ImDrawVert, pos), D3D11_INPUT_PER_VERTEX_DATA, 0 },
+        { "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT,   0, offsetof(ImDrawVert, uv),  D3D11_INPUT_PER_VERTEX_DATA, 0 },
+        { "COLOR",    0, DXGI_FORMAT_R8G8B8A8_UNORM, 0, offsetof(ImDrawVert, col), D3D11_INPUT_PER_VERTEX_DATA, 0 },
+    };
+    hr = m_pDevice->CreateInputLayout(layout, 3, pVertexCode->GetBufferPointer(), pVertexCode->GetBufferSize(), &m_pImGuiLayout);
+    pVertexCode->Release();
+    if (FAILED(hr))
+        return hr;
 
+    hr = CompileShader(L"ImGuiPixel.ps", nullptr, &m_pImGuiPS);
+    if (FAILED(hr))
+        return hr;
 
-    if (rasterizerState) {
-        rasterizerState->Release();
-        m_pDeviceContext->RSSetState(nullptr);
-    }
+    D3D11_BLEND_DESC blendDesc = {};
+    blendDesc.RenderTarget[0].BlendEnable = TRUE;
+    blendDesc.RenderTarget[0].SrcBlend = D3D11_BLEND_SRC_ALPHA;
+    blendDesc.RenderTarget[0].DestBlend = D3D11_BLEND_INV_SRC_ALPHA;
+    blendDesc.RenderTarget[0].BlendOp = D3D11_BLEND_OP_ADD;
+    blendDesc.RenderTarget[0].SrcBlendAlpha = D3D11_BLEND_ONE;
+    blendDesc.RenderTarget[0].DestBlendAlpha = D3D11_BLEND_INV_SRC_ALPHA;
+    blendDesc.RenderTarget[0].BlendOpAlpha = D3D11_BLEND_OP_ADD;
+    blendDesc.RenderTarget[0].RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
+    hr = m_pDevice->CreateBlendState(&blendDesc, &m_pImGuiBlend);
+    if (FAILED(hr))
+        return hr;
+
+    D3D11_RASTERIZER_DESC rasterizerDesc = {};
+    rasterizerDesc.FillMode = D3D11_FILL_SOLID;
+    rasterizerDesc.CullMode = D3D11_CULL_NONE;
+    rasterizerDesc.ScissorEnable = TRUE;
+    rasterizerDesc.DepthClipEnable = TRUE;
+    hr = m_pDevice->CreateRasterizerState(&rasterizerDesc, &m_pImGuiRaster);
+    if (FAILED(hr))
+        return hr;
+
+    D3D11_DEPTH_STENCIL_DESC depthDesc = {};
+    depthDesc.DepthEnable = FALSE;
+    depthDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ALL;
+    depthDesc.DepthFunc = D3D11_COMPARISON_ALWAYS;
+    depthDesc.FrontFace.StencilFailOp = depthDesc.FrontFace.StencilDepthFailOp = depthDesc.FrontFace.StencilPassOp = D3D11_STENCIL_OP_KEEP;
+    depthDesc.FrontFace.StencilFunc = D3D11_COMPARISON_ALWAYS;
+    depthDesc.BackFace = depthDesc.FrontFace;
+    hr = m_pDevice->CreateDepthStencilState(&depthDesc, &m_pImGuiDepthState);
+    if (FAILED(hr))
+        return hr;
+
+    D3D11_SAMPLER_DESC samplerDesc = {};
+    samplerDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
+    samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_WRAP;
+    samplerDesc.AddressV = D3D11_TEXTURE_ADDRESS_WRAP;
+    samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_WRAP;
+    samplerDesc.ComparisonFunc = D3D11_COMPARISON_ALWAYS;
+    hr = m_pDevice->CreateSamplerState(&samplerDesc, &m_pImGuiSampler);
+    if (FAILED(hr))
+        return hr;
+
+    //  : RGBA8  
+    unsigned char* pPixels = nullptr;
+    int width = 0;
+    int height = 0;
+    io.Fonts->GetTexDataAsRGBA32(&pPixels, &width, &height);
+
+    D3D11_TEXTURE2D_DESC textureDesc = {};
+    textureDesc.Width = width;
+    textureDesc.Height = height;
+    textureDesc.MipLevels = 1;
+    textureDesc.ArraySize = 1;
+    textureDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    textureDesc.SampleDesc.Count = 1;
+    textureDesc.Usage = D3D11_USAGE_DEFAULT;
+    textureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+    D3D11_SUBRESOURCE_DATA fontData = { pPixels, static_cast<UINT>(width * 4), 0 };
+    ID3D11Texture2D* pFontTexture = nullptr;
+    hr = m_pDevice->CreateTexture2D(&textureDesc, &fontData, &pFontTexture);
+    if (FAILED(hr))
+        return hr;
+
+    ID3D11ShaderResourceView* pFontView = nullptr;
+    hr = m_pDevice->CreateShaderResourceView(pFontTexture, nullptr, &pFontView);
+    pFontTexture->Release();
+    if (FAILED(hr))
+        return hr;
+    m_imguiFontTexture = m_backend.RegisterTexture(pFontView);
+    pFontView->Release();
+    io.Fonts->SetTexID(static_cast<ImTextureID>(m_imguiFontTexture));
+
+    D3D11PipelineDesc pipelineDesc = { m_pImGuiVS, m_pImGuiPS, m_pImGuiLayout, m_pImGuiBlend, m_pImGuiDepthState, m_pImGuiRaster, m_pImGuiSampler, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST };
+    m_imguiPipeline = m_backend.RegisterPipeline(pipelineDesc);
+    return m_imguiRenderer.Init(m_backend, m_imguiPipeline) ? S_OK : E_FAIL;
 }
 
-void RenderClass::RenderCubes(XMMATRIX view, XMMATRIX proj)
+void RenderClass::TerminateImGui()
 {
-    //   -   
-    m_pDeviceContext->OMSetRenderTargets(1, &m_pPostProcessRTV, m_pDepthView);
-    m_pDeviceContext->OMSetDepthStencilState(nullptr, 0);
-
-    //   
-    CameraBuffer camBuffer;
-    XMMATRIX vpMatrix = XMMatrixTranspose(view * proj);
-    camBuffer.vp = vpMatrix;
-    camBuffer.cameraPos = m_CameraPosition;
-
-    D3D11_MAPPED_SUBRESOURCE vpMapped;
-    HRESULT hr = m_pDeviceContext->Map(m_pVPBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &vpMapped);
-    if (SUCCEEDED(hr))
+    m_imguiRenderer.Terminate(m_backend);
+
+    if (m_pImGuiVS) m_pImGuiVS->Release();
+    if (m_pImGuiPS) m_pImGuiPS->Release();
+    if (m_pImGuiLayout) m_pImGuiLayout->Release();
+    if (m_pImGuiBlend) m_pImGuiBlend->Release();
+    if (m_pImGuiRaster) m_pImGuiRaster->Release();
+    if (m_pImGuiDepthState) m_pImGuiDepthState->Release();
+    if (m_pImGuiSampler) m_pImGuiSampler->Release();
+    m_pImGuiVS = nullptr;
+    m_pImGuiPS = nullptr;
+    m_pImGuiLayout = nullptr;
+    m_pImGuiBlend = nullptr;
+    m_pImGuiRaster = nullptr;
+    m_pImGuiDepthState = nullptr;
+    m_pImGuiSampler = nullptr;
+
+    if (ImGui::GetCurrentContext())
     {
-        memcpy(vpMapped.pData, &camBuffer, sizeof(CameraBuffer));
-        m_pDeviceContext->Unmap(m_pVPBuffer, 0);
+        ImGui_ImplWin32_Shutdown();
+        ImGui::DestroyContext();
     }
+}
 
-    //     
-    UINT vertexStride = sizeof(Vertex);
-    UINT vertexOffset = 0;
-    m_pDeviceContext->IASetVertexBuffers(0, 1, &m_pVertexBuffer, &vertexStride, &vertexOffset);
-    m_pDeviceContext->IASetIndexBuffer(m_pIndexBuffer, DXGI_FORMAT_R16_UINT, 0);
-    m_pDeviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-    m_pDeviceContext->IASetInputLayout(m_pLayout);
-
-    //      
-    m_pDeviceContext->VSSetShader(m_pVertexShader, nullptr, 0);
-    m_pDeviceContext->PSSetShader(m_pPixelShader, nullptr, 0);
-    m_pDeviceContext->VSSetConstantBuffers(1, 1, &m_pVPBuffer);
-    m_pDeviceContext->PSSetShaderResources(0, 1, &m_pTextureView);
-    m_pDeviceContext->PSSetShaderResources(1, 1, &m_pNormalMapView);
-    m_pDeviceContext->PSSetSamplers(0, 1, &m_pSamplerState);
-
-    //  
-    UpdateFrustum(view * proj);
+void RenderClass::RenderImGui()
+{
+    PROFILE_SCOPE("ImGui");
+    GpuProfileScope gpuScope(m_gpuProfiler, "ImGui");
 
-    //    
-    m_CubeAngle += 0.01f;
-    if (m_CubeAngle > XM_2PI)
-        m_CubeAngle -= XM_2PI;
+    ImGui_ImplWin32_NewFrame();
+    ImGui::NewFrame();
 
-    if (m_pComputeShader)
+    ImGui::Begin("Options");
+    ImGui::Checkbox("Negative Effect", &m_useNegative);
+    if (m_softwareAvailable)
     {
-        //     
-        for (size_t i = 0; i < m_modelInstances.size(); i++)
+        ImGui::Checkbox("Software Rasterizer", &m_useSoftware);
+        ImGui::SameLine();
+        if (ImGui::Button("Benchmark 1080p"))
+            m_softwareBenchmark = m_softwareRenderer.Benchmark(m_softwareFrame, 1920, 1080, 30);
+        if (m_softwareBenchmark.frames > 0)
         {
-            XMFLOAT3 instPosition;
-            XMStoreFloat3(&instPosition, m_modelInstances[i].model.r[3]);
-
-            m_modelInstances[i].model =
-                XMMatrixScaling(m_fixedScale, m_fixedScale, m_fixedScale) *
-                XMMatrixRotationY(m_CubeAngle) *
-                XMMatrixTranslation(instPosition.x, instPosition.y, instPosition.z);
+            ImGui::Text("Software %ux%u: %.1f FPS (%.2f ms, %u threads)", m_softwareBenchmark.width, m_softwareBenchmark.height,
+                m_softwareBenchmark.fps, m_softwareBenchmark.msPerFrame, m_softwareBenchmark.threads);
         }
-
-        //   -
-        D3D11_MAPPED_SUBRESOURCE mappedFrustum;
-        hr = m_pDeviceContext->Map(m_pFrustumPlanesBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedFrustum);
-        if (SUCCEEDED(hr))
+    }
+    if (m_rayTracerAvailable)
+    {
+        ImGui::SliderInt("Ray Samples", &m_rayTraceSamples, 1, 256);
+        ImGui::SameLine();
+        if (ImGui::Button("Ray Trace"))
         {
-            memcpy(mappedFrustum.pData, m_frustumPlanes, sizeof(XMVECTOR) * 6);
-            m_pDeviceContext->Unmap(m_pFrustumPlanesBuffer, 0);
+            //        exe     
+            RtSettings settings = { static_cast<uint32_t>(m_rayTraceSamples), true };
+            m_rayTraceBenchmark = m_rayTracer.Benchmark(m_softwareFrame, m_backBufferWidth, m_backBufferHeight, settings);
+            m_referenceSaved = m_rayTracer.SaveImage("reference.bmp");
         }
-
-        //   
-        UINT initArgs[5] = { 36, 0, 0, 0, 0 };
-        m_pDeviceContext->UpdateSubresource(m_pIndirectArgsBuffer, 0, nullptr, initArgs, 0, 0);
-
-        //   
-        m_pDeviceContext->CSSetShader(m_pComputeShader, nullptr, 0);
-        m_pDeviceContext->CSSetConstantBuffers(0, 1, &m_pFrustumPlanesBuffer);
-        m_pDeviceContext->CSSetUnorderedAccessViews(0, 1, &m_pIndirectArgsUAV, nullptr);
-        m_pDeviceContext->CSSetUnorderedAccessViews(1, 1, &m_pObjectsIdsUAV, nullptr);
-        m_pDeviceContext->CSSetShaderResources(0, 1, &m_pInstanceDataSRV);
-
-        m_pDeviceContext->Dispatch((MaxInst + 63) / 64, 1, 1);
-
-        //    
-        auto args = ReadUintBufferData(m_pDeviceContext, m_pIndirectArgsBuffer, 2);
-        m_visibleCubes = args[1];
-
-        if (m_visibleCubes > 0)
+        if (m_rayTraceBenchmark.rays > 0)
         {
-            auto visibleIds = ReadUintBufferData(m_pDeviceContext, m_pObjectsIdsBuffer, m_visibleCubes);
-            std::vector<InstanceData> instVisible(m_visibleCubes);
-            for (UINT i = 0; i < m_visibleCubes; i++)
-            {
-                UINT id = visibleIds[i];
-                instVisible[i].model = XMMatrixTranspose(m_modelInstances[id].model);
-                instVisible[i].texInd = m_modelInstances[id].texInd;
-            }
-            m_pDeviceContext->UpdateSubresource(
-                m_pModelBufferInst,
-                0,
-                nullptr,
-                instVisible.data(),
-                0,
-                sizeof(InstanceData) * m_visibleCubes
-            );
+            ImGui::Text("Ray Tracer: %.2f Mrays/s per core (%.2f Mrays/s, %u threads, %.2f s)%s",
+                m_rayTraceBenchmark.raysPerSecondPerCore * 1.0e-6, m_rayTraceBenchmark.raysPerSecond * 1.0e-6,
+                m_rayTraceBenchmark.threads, m_rayTraceBenchmark.seconds, m_referenceSaved ? ", saved reference.bmp" : "");
+        }
+    }
+    if (m_lightmapBakerAvailable)
+    {
+        bool baking = m_lightmapBaker.IsRunning();
+        ImGui::BeginDisabled(baking);
+        ImGui::SliderInt("Bake Samples", &m_bakeSamples, 4, 1024);
+        ImGui::SliderInt("Bake Bounces", &m_bakeBounces, 0, 4);
+        if (ImGui::Button("Bake Lightmaps"))
+        {
+            //      ,   Render
+            LightmapBakeSettings settings = { static_cast<uint32_t>(m_bakeSamples), static_cast<uint32_t>(m_bakeBounces) };
+            m_lightmapBaker.Start(m_softwareFrame, settings, "lightmaps.dds");
+        }
+        ImGui::EndDisabled();
+        if (m_pLightmapSRV)
+        {
+            ImGui::SameLine();
+            ImGui::Checkbox("Baked Lighting", &m_useBakedLighting);
         }
 
-        m_pDeviceContext->VSSetConstantBuffers(0, 1, &m_pModelBufferInst);
-        m_pDeviceContext->DrawIndexedInstancedIndirect(m_pIndirectArgsBuffer, 0);
-
-        //    
-        ID3D11UnorderedAccessView* nullUAVs[2] = { nullptr, nullptr };
-        m_pDeviceContext->CSSetUnorderedAccessViews(0, 2, nullUAVs, nullptr);
-        ID3D11ShaderResourceView* nullSRVs[1] = { nullptr };
-        m_pDeviceContext->CSSetShaderResources(0, 1, nullSRVs);
-        m_pDeviceContext->CSSetShader(nullptr, nullptr, 0);
+        LightmapBakeStats bakeStats = m_lightmapBaker.GetStats();
+        if (bakeStats.texels > 0)
+        {
+            char overlay[64];
+            snprintf(overlay, sizeof(overlay), "%u / %u cubes", bakeStats.instancesDone, bakeStats.instances);
+            ImGui::ProgressBar(static_cast<float>(bakeStats.texelsDone) / bakeStats.texels, ImVec2(-FLT_MIN, 0), overlay);
+            ImGui::Text("Bake: %.2f Mrays/s, %.0f texels/s (%u threads, %.1f s)", bakeStats.raysPerSecond * 1.0e-6,
+                bakeStats.texelsPerSecond, bakeStats.threads, bakeStats.seconds);
+        }
     }
-    else
+    if (m_pPrefilteredSRV)
     {
-        //    CPU
-        std::vector<InstanceData> cpuVisibleInstances;
-        cpuVisibleInstances.reserve(m_modelInstances.size());
-        m_visibleCubes = 0;
-        for (size_t i = 0; i < m_modelInstances.size(); i++)
+        ImGui::SliderFloat("Ambient", &m_ambientIntensity, 0.0f, 2.0f);
+        ImGui::SliderFloat("Reflections", &m_reflectionIntensity, 0.0f, 2.0f);
+        ImGui::SliderFloat("Reflection Roughness", &m_reflectionRoughness, 0.0f, 1.0f);
+        if (ImGui::Button("Benchmark IBL"))
         {
-            XMFLOAT3 cubePos;
-            XMStoreFloat3(&cubePos, m_modelInstances[i].model.r[3]);
+            //    ,   256  2048  
+            m_environmentBenchmarks[0] = EnvironmentLighting::Benchmark(&ThreadPool::Get(), m_environmentSource, 256);
+            m_environmentBenchmarks[1] = EnvironmentLighting::Benchmark(&ThreadPool::Get(), m_environmentSource, 2048);
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Save Prefiltered"))
+            m_prefilteredSaved = m_environmentLighting.SavePrefilteredDDS("skybox_prefiltered.dds");
+        if (m_prefilteredSaved)
+        {
+            ImGui::SameLine();
+            ImGui::Text("skybox_prefiltered.dds");
+        }
+        for (const EnvironmentBenchmarkResult& benchmark : m_environmentBenchmarks)
+        {
+            if (benchmark.threads == 0)
+                continue;
+            ImGui::Text("IBL %u^2: SH %.1f ms, mips %.1f ms, prefilter %.1f ms (%u threads)", benchmark.faceSize,
+                benchmark.projectMs, benchmark.mipMs, benchmark.prefilterMs, benchmark.threads);
+        }
+    }
+    if (m_reflectionBakerAvailable && m_pPrefilteredSRV)
+    {
+        bool baking = m_reflectionBaker.IsRunning();
+        ImGui::BeginDisabled(baking || m_reflectionProbePositions.size() >= ReflectionProbeBaker::MaxProbes);
+        if (ImGui::Button("Add Reflection Probe at Camera"))
+            m_reflectionProbePositions.push_back(m_CameraPosition);
+        ImGui::EndDisabled();
+        ImGui::SameLine();
+        ImGui::BeginDisabled(baking);
+        if (ImGui::Button("Clear Reflection Probes"))
+            m_reflectionProbePositions.clear();
+        ImGui::SameLine();
+        //         ,   Render
+        if (ImGui::Button("Bake Reflection Probes"))
+        {
+            m_reflectionBaker.Start(m_softwareFrame, m_environmentLighting.GetIrradianceSH(), m_reflectionProbePositions,
+                "reflection_probe_%u.dds");
+        }
+        ImGui::EndDisabled();
+        if (m_pReflectionProbeSRV)
+        {
+            ImGui::SameLine();
+            ImGui::Checkbox("Reflection Probes", &m_useReflectionProbes);
+        }
 
-            m_modelInstances[i].model =
-                XMMatrixScaling(m_fixedScale, m_fixedScale, m_fixedScale) *
-                XMMatrixRotationY(m_CubeAngle) *
-                XMMatrixTranslation(cubePos.x, cubePos.y, cubePos.z);
+        ReflectionBakeStats reflectionStats = m_reflectionBaker.GetStats();
+        ImGui::Text("Reflection Probes: %u placed, %u loaded", static_cast<UINT>(m_reflectionProbePositions.size()),
+            static_cast<UINT>(m_loadedReflectionProbes.size()));
+        if (reflectionStats.probes > 0)
+        {
+            ImGui::Text("Reflection Bake: %u / %u probes, trace %.2f s, prefilter %.2f s (%u threads, %.1f s)", reflectionStats.probesDone,
+                reflectionStats.probes, reflectionStats.renderSeconds, reflectionStats.prefilterSeconds, reflectionStats.threads,
+                reflectionStats.seconds);
+        }
+    }
+    if (ImGui::Button("Benchmark DDS Loading"))
+        BenchmarkTextureLoading();
+    if (m_ddsBenchmark.passes > 0)
+    {
+        ImGui::Text("DDS %u files (%.1f MB, %u failed) x %u: read %.1f ms, mapped %.1f ms", m_ddsBenchmark.files,
+            m_ddsBenchmark.fileBytes / (1024.0 * 1024.0), m_ddsBenchmark.failedFiles, m_ddsBenchmark.passes,
+            m_ddsBenchmark.readMs, m_ddsBenchmark.mappedMs);
+        ImGui::Text("DDS Peak: read %.1f MB, mapped %.1f MB; device textures: read %.1f ms, mapped %.1f ms",
+            m_ddsBenchmark.readPeakBytes / (1024.0 * 1024.0), m_ddsBenchmark.mappedPeakBytes / (1024.0 * 1024.0),
+            m_ddsDeviceMs[0], m_ddsDeviceMs[1]);
+        const DirectX::DDSLayout::DDSArrayBenchmarkResult& array = m_ddsArrayBenchmark;
+        ImGui::Text("DDS Array %u slices (%u subresources, %.1f MB): layout %.3f ms, device %.1f ms (0x%08X)", array.slices,
+            array.subresources, array.arrayBytes / (1024.0 * 1024.0), array.layoutMs, m_ddsArrayMs, static_cast<unsigned>(m_ddsArrayResult));
+        ImGui::Text("DDS Array Checks: %u pairs, %u errors; %u layout errors; %u cases, %u errors", array.pairs, array.pairErrors,
+            array.layoutErrors, array.checks, array.checkErrors);
+    }
 
-            float cubeSize = m_fixedScale * 0.95f;
-            if (IsAABBInFrustum(cubePos, cubeSize))
+    TextureStreamStats streamStats = m_textureStreamer.GetStats();
+    ImGui::Text("Streaming: %u resident, %u streaming, %u queued, %u failed; %.1f MB pending, frame %.0f KB (max %.0f KB)",
+        streamStats.resident, streamStats.streaming, streamStats.queued, streamStats.failed,
+        streamStats.pendingBytes / (1024.0 * 1024.0), streamStats.lastFrameBytes / 1024.0, streamStats.maxFrameBytes / 1024.0);
+    ImGui::Text("Texture Memory: GPU %.1f MB, CPU %.1f MB; %u downgraded, %llu mips evicted, %u reloads",
+        streamStats.gpuBytes / (1024.0 * 1024.0), streamStats.cpuBytes / (1024.0 * 1024.0), streamStats.downgraded,
+        static_cast<unsigned long long>(streamStats.evictedMips), streamStats.reloads);
+    ImGui::SliderInt("Stream Budget KB", &m_streamBudgetKB, 16, 4096);
+    ImGui::SliderInt("Texture Budget MB (0 = no limit)", &m_textureBudgetMB, 0, 256);
+    if (ImGui::Button("Restream Textures"))
+        RestreamTextures();
+    ImGui::SameLine();
+    if (ImGui::Button("Benchmark Streaming"))
+        BenchmarkTextureStreaming();
+    if (m_streamBenchmark.textures > 0)
+    {
+        ImGui::Text("Stream %u textures (%u failed, %.1f MB): sampled after %u frames, resident after %u, max %.0f KB/frame, %llu errors, %.2f s",
+            m_streamBenchmark.textures, m_streamBenchmark.failed, m_streamBenchmark.bytes / (1024.0 * 1024.0),
+            m_streamBenchmark.placeholderFrames, m_streamBenchmark.frames, m_streamBenchmark.maxFrameBytes / 1024.0,
+            static_cast<unsigned long long>(m_streamBenchmark.deviceErrors), m_streamBenchmark.seconds);
+        const TextureResidencyBenchmarkResult& residency = m_residencyBenchmark;
+        ImGui::Text("Residency %u textures, %u hot, budget %.1f MB (floor %.1f of %.1f MB): max %.1f MB, %u frames over",
+            residency.textures, residency.hotTextures, residency.budgetBytes / (1024.0 * 1024.0), residency.floorBytes / (1024.0 * 1024.0),
+            residency.totalBytes / (1024.0 * 1024.0), residency.maxGpuBytes / (1024.0 * 1024.0), residency.overBudgetFrames);
+        ImGui::Text("Residency: %llu mips evicted, %u reloads, hot resident %u / %u frames, %u hot downgrades, %llu accounting / %llu device errors",
+            static_cast<unsigned long long>(residency.evictedMips), residency.reloads, residency.hotResidentFrames, residency.frames,
+            residency.hotDowngrades, static_cast<unsigned long long>(residency.accountingErrors),
+            static_cast<unsigned long long>(residency.deviceErrors));
+    }
+    if (ImGui::Button("Cook Textures"))
+        CookTextures();
+    ImGui::SameLine();
+    if (ImGui::Button("Benchmark Compressor"))
+    {
+        SoftwareTexture color;
+        SoftwareTexture normalMap;
+        if (color.LoadDDS("cat.dds") && normalMap.LoadDDS("cube_normal.dds"))
+            m_compressorBenchmark = TextureCooker::Benchmark(&ThreadPool::Get(), color, normalMap, 1024);
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Benchmark Normal Maps"))
+    {
+        SoftwareTexture normalMap;
+        if (normalMap.LoadDDS("cube_normal.dds"))
+            m_normalMapBenchmark = TextureCooker::BenchmarkNormalMap(&ThreadPool::Get(), normalMap, 1024);
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Pack Textures"))
+        PackTextures();
+    ImGui::SameLine();
+    if (ImGui::Button("Benchmark Packing"))
+    {
+        std::vector<std::string> paths = { "cat.dds", "textile.dds", m_normalMapPath, "skybox.dds" };
+        m_packBenchmark = TexturePacker::Benchmark(&ThreadPool::Get(), paths, 20);
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Benchmark Mips"))
+    {
+        SoftwareTexture color;
+        SoftwareTexture normalMap;
+        SoftwareTexture cube;
+        if (color.LoadDDS("cat.dds") && normalMap.LoadDDS("cube_normal.dds") && cube.LoadDDS("skybox.dds"))
+            m_mipBenchmark = MipGenerator::Benchmark(&ThreadPool::Get(), color, normalMap, cube, 4096, 1024);
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Benchmark Decoding"))
+    {
+        std::vector<std::string> paths = { "cat.dds", "textile.dds", m_normalMapPath, "skybox.dds" };
+        m_decodeBenchmark = BlockDecoder::Benchmark(&ThreadPool::Get(), paths, 1024, 5);
+    }
+    for (const CookedTexture& cooked : m_cookedTextures)
+    {
+        if (!cooked.path)
+            continue;
+        ImGui::Text("Cooked %s: %s, %u slices x %u mips, %.2f MB, %.1f ms (%u threads)", cooked.path,
+            cooked.cooked ? (cooked.loaded ? "loaded" : "load failed") : "failed", cooked.stats.slices, cooked.stats.mips,
+            cooked.stats.bytes / (1024.0 * 1024.0), cooked.stats.seconds * 1000.0, cooked.stats.threads);
+    }
+    if (m_compressorBenchmark.size > 0)
+    {
+        for (UINT f = 0; f < BlockFormatCount; f++)
+        {
+            const CompressorFormatResult& format = m_compressorBenchmark.formats[f];
+            ImGui::Text("%s %u^2: %.1f MP/s one core, %.1f MP/s per core x %u; RMSE %.2f (%.1f dB), %u mismatches",
+                TextureCooker::GetFormatName(static_cast<BlockFormat>(f)), m_compressorBenchmark.size, format.singleRate,
+                format.parallelRate, m_compressorBenchmark.threads, format.rmse, format.psnr, format.mismatches);
+        }
+    }
+    if (m_normalMapBenchmark.size > 0)
+    {
+        //      BC1,   BC5    
+        const char* sources[2] = { "scene", "synthetic" };
+        const NormalSourceResult* results[2] = { &m_normalMapBenchmark.scene, &m_normalMapBenchmark.synthetic };
+        const char* names[3] = { "BC1 XYZ", "BC1 XY", "BC5 XY" };
+        for (UINT s = 0; s < 2; s++)
+        {
+            const NormalDecodeResult* formats[3] = { &results[s]->storedZ, &results[s]->bc1, &results[s]->bc5 };
+            for (UINT i = 0; i < 3; i++)
             {
-                InstanceData instance;
-                instance.model = XMMatrixTranspose(m_modelInstances[i].model);
-                instance.texInd = m_modelInstances[i].texInd;
-                cpuVisibleInstances.push_back(instance);
-                m_visibleCubes++;
+                ImGui::Text("Normals %s %s %u^2 (%u bpp): mean %.2f, max %.2f deg; decode %.1f MP/s, reference error %g", sources[s],
+                    names[i], m_normalMapBenchmark.size, formats[i]->bitsPerTexel, formats[i]->meanAngle, formats[i]->maxAngle,
+                    formats[i]->decodeRate, formats[i]->maxReferenceError);
             }
         }
-
-        if (!cpuVisibleInstances.empty())
+    }
+    for (const PackedTexture& packed : m_packedTextures)
+    {
+        if (packed.path.empty())
+            continue;
+        ImGui::Text("Packed %s: %s, %.2f -> %.2f MB, %u chunks (%u shuffled, %u stored), %.1f ms", packed.path.c_str(),
+            packed.packed ? "ok" : "failed", packed.stats.rawBytes / (1024.0 * 1024.0), packed.stats.packedBytes / (1024.0 * 1024.0),
+            packed.stats.chunks, packed.stats.shuffledChunks, packed.stats.storedChunks, packed.stats.seconds * 1000.0);
+    }
+    if (m_packBenchmark.passes > 0)
+    {
+        for (const TexturePackFileResult& file : m_packBenchmark.files)
         {
-            m_pDeviceContext->UpdateSubresource(
-                m_pModelBufferInst,
-                0,
-                nullptr,
-                cpuVisibleInstances.data(),
-                0,
-                sizeof(InstanceData) * m_visibleCubes
-            );
-            m_pDeviceContext->VSSetConstantBuffers(0, 1, &m_pModelBufferInst);
-            m_pDeviceContext->DrawIndexedInstanced(36, static_cast<UINT>(cpuVisibleInstances.size()), 0, 0, 0);
+            ImGui::Text("Pack %s: %.0f KB -> %.0f KB (%.1f%%), without byte planes %.0f KB", file.path.c_str(), file.rawBytes / 1024.0,
+                file.packedBytes / 1024.0, 100.0 * file.packedBytes / file.rawBytes, file.plainBytes / 1024.0);
+        }
+        ImGui::Text("Pack %u files (%u failed): %.1f%%, pack %.1f MB/s, unpack %.0f MB/s one thread, %.0f MB/s x %u; %u mismatches",
+            static_cast<unsigned>(m_packBenchmark.files.size()), m_packBenchmark.failed,
+            m_packBenchmark.rawBytes ? 100.0 * m_packBenchmark.packedBytes / m_packBenchmark.rawBytes : 0.0, m_packBenchmark.packRate,
+            m_packBenchmark.unpackRate, m_packBenchmark.parallelUnpackRate, m_packBenchmark.threads, m_packBenchmark.mismatches);
+        //      :       
+        for (UINT i = 0; i < 2; i++)
+        {
+            ImGui::Text("Load at %.0f MB/s: raw %.1f ms, packed + unpack %.1f ms", m_packBenchmark.storageRates[i],
+                m_packBenchmark.rawLoadMs[i], m_packBenchmark.packedLoadMs[i]);
         }
     }
-
-    //    
-    static float orbitAngle1 = XM_PI / 2;
-    orbitAngle1 += 0.01f;
-    if (orbitAngle1 > XM_2PI)
-        orbitAngle1 -= XM_2PI;
-
-    static float orbitAngle2 = 0.0f;
-    orbitAngle2 += 0.01f;
-    if (orbitAngle2 > XM_2PI)
-        orbitAngle2 -= XM_2PI;
-
-    PointLight sceneLights[3];
-    float lightRadius = 2.0f;
-
-    sceneLights[0].Position = XMFLOAT3(0.0f, lightRadius * cosf(orbitAngle1), lightRadius * sinf(-orbitAngle1));
-    sceneLights[0].Range = 3.0f;
-    sceneLights[0].Color = XMFLOAT3(1.0f, 1.0f, 1.0f);
-    sceneLights[0].Intensity = 1.0f;
-
-    sceneLights[1].Position = XMFLOAT3(lightRadius * cosf(orbitAngle2), 0.0f, lightRadius * sinf(orbitAngle2));
-    sceneLights[1].Range = 3.0f;
-    sceneLights[1].Color = XMFLOAT3(1.0f, 1.0f, 0.13f);
-    sceneLights[1].Intensity = 1.0f;
-
-    lightRadius = 8.0f;
-    sceneLights[2].Position = XMFLOAT3(lightRadius * cosf(orbitAngle1), 0.0f, lightRadius * sinf(-orbitAngle1));
-    sceneLights[2].Range = 5.0f;
-    sceneLights[2].Color = XMFLOAT3(1.0f, 1.0f, 1.0f);
-    sceneLights[2].Intensity = 1.0f;
-
-    D3D11_MAPPED_SUBRESOURCE lightMapped;
-    hr = m_pDeviceContext->Map(m_pLightBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &lightMapped);
-    if (SUCCEEDED(hr))
+    if (m_mipBenchmark.textureSize > 0)
     {
-        memcpy(lightMapped.pData, sceneLights, sizeof(PointLight) * 3);
-        m_pDeviceContext->Unmap(m_pLightBuffer, 0);
+        for (UINT f = 0; f < MipFilterCount; f++)
+        {
+            ImGui::Text("Mips %s: %u^2 sRGB %.1f ms, cube 6 x %u^2 %.1f ms (%u threads)", MipGenerator::GetFilterName(static_cast<MipFilter>(f)),
+                m_mipBenchmark.textureSize, m_mipBenchmark.textureMs[f], m_mipBenchmark.cubeSize, m_mipBenchmark.cubeMs[f],
+                m_mipBenchmark.threads);
+        }
+        //            
+        ImGui::Text("Mips normal map %.1f ms (max |n| error %.4f), one thread %.1f ms; reference %u texels, %u mismatches",
+            m_mipBenchmark.normalMs, m_mipBenchmark.maxNormalError, m_mipBenchmark.singleThreadMs, m_mipBenchmark.referenceTexels,
+            m_mipBenchmark.mismatches);
+        ImGui::Text("Mips cube seams: %.2f across edges, %.2f with faces clamped, %.2f inside faces", m_mipBenchmark.seamDifference,
+            m_mipBenchmark.clampedSeamDifference, m_mipBenchmark.faceDifference);
     }
-    m_pDeviceContext->PSSetConstantBuffers(2, 1, &m_pLightBuffer);
-
-    //   
-    m_pDeviceContext->PSSetShader(m_pLightPixelShader, nullptr, 0);
-    for (int i = 0; i < 3; i++)
+    if (m_decodeBenchmark.passes > 0)
     {
-        XMMATRIX lightScale = XMMatrixScaling(0.1f, 0.1f, 0.1f);
-        XMMATRIX lightTrans = XMMatrixTranslation(sceneLights[i].Position.x, sceneLights[i].Position.y, sceneLights[i].Position.z);
-        XMMATRIX lightModel = lightScale * lightTrans;
-        XMMATRIX lightModelT = XMMatrixTranspose(lightModel);
-        XMFLOAT4X4 lightMatrix;
-        XMStoreFloat4x4(&lightMatrix, lightModelT);
-
-        m_pDeviceContext->UpdateSubresource(m_pModelBufferInst, 0, nullptr, &lightMatrix, 0, 0);
-        m_pDeviceContext->VSSetConstantBuffers(0, 1, &m_pModelBufferInst);
-
-        XMFLOAT4 lightColor = XMFLOAT4(sceneLights[i].Color.x, sceneLights[i].Color.y, sceneLights[i].Color.z, 1.0f);
-        m_pDeviceContext->UpdateSubresource(m_pColorBuffer, 0, nullptr, &lightColor, 0, 0);
-
-        m_pDeviceContext->DrawIndexed(36, 0, 0);
+        for (const BlockDecodeFormatResult& format : m_decodeBenchmark.formats)
+        {
+            ImGui::Text("Decode %s %u^2 + mips: RGBA8 %.1f MP/s, float %.1f MP/s one core, %.1f MP/s x %u; %u mismatches",
+                BlockDecoder::GetFormatName(format.format), m_decodeBenchmark.size, format.rgba8Rate, format.floatRate,
+                format.parallelRate, m_decodeBenchmark.threads, format.mismatches);
+        }
+        for (const BlockDecodeFileResult& file : m_decodeBenchmark.files)
+        {
+            ImGui::Text("Decode %s: %s, %ux%u, %u mips x %u slices, %.2f ms", file.path.c_str(),
+                file.decoded ? BlockDecoder::GetFormatName(file.format) : "failed", file.width, file.height, file.mipCount,
+                file.arraySize, file.ms);
+        }
+        //  - DecompressBlock , HDR-       
+        ImGui::Text("Decode checks: %u of %u texels off the reference, %u of %u BC6H blocks wrong", m_decodeBenchmark.referenceErrors,
+            m_decodeBenchmark.referenceTexels, m_decodeBenchmark.hdrErrors, m_decodeBenchmark.hdrChecks);
     }
-}
-
-
-struct RenderObject {
-    XMMATRIX transform;
-    XMFLOAT4 color;
-    float minDepth; //    
-};
-
-float ComputeMinDepth(const RenderObject& obj, XMVECTOR cameraPosition) {
-    XMFLOAT3 vertices[4];
-
-    XMMATRIX modelMatrix = obj.transform;
-
-    XMVECTOR localVertices[4] = {
-        XMVectorSet(-0.75f, -0.75f, 0.0f, 1.0f),
-        XMVectorSet(-0.75f,  0.75f, 0.0f, 1.0f),
-        XMVectorSet(0.75f,  0.75f, 0.0f, 1.0f),
-        XMVectorSet(0.75f, -0.75f, 0.0f, 1.0f),
-    };
-
-    float minDepth = FLT_MAX;
-
-    for (int i = 0; i < 4; ++i) {
-        XMVECTOR worldPos = XMVector3Transform(localVertices[i], modelMatrix);
-        XMVECTOR diff = worldPos - cameraPosition;
-        float distance = XMVectorGetX(XMVector3Length(diff));
-        if (distance < minDepth) {
-            minDepth = distance;
+    ImGui::Checkbox("Mip Feedback", &m_useMipFeedback);
+    const MipFeedbackStats& mipStats = m_mipFeedback.GetStats();
+    ImGui::Text("Wanted Mips: cat %u, textile %u, normal %u; %u instances, %.3f ms, %llu mips skipped",
+        m_wantedMips[0], m_wantedMips[1], m_wantedMips[2], mipStats.instanceCount, mipStats.buildMs,
+        static_cast<unsigned long long>(streamStats.skippedMips));
+    if (m_lightProbesAvailable)
+    {
+        ImGui::Checkbox("Light Probes", &m_useLightProbes);
+        ImGui::SameLine();
+        ImGui::SliderInt("Probe Rays", &m_probeRays, 16, 1024);
+        //       ,    
+        if (ImGui::Button("Bake Probes"))
+            BakeLightProbes();
+        ImGui::SameLine();
+        if (ImGui::Button("Benchmark Probes (1M)"))
+            m_probeBenchmark = m_lightProbes.Benchmark(1000000);
+        const ProbeBakeStats& probeStats = m_lightProbes.GetStats();
+        if (m_lightProbes.IsBaked())
+        {
+            ImGui::Text("Probes: %u (%u inside cubes), %.1f ms, %.2f Mrays (%u threads)", probeStats.probes,
+                probeStats.invalidProbes, probeStats.seconds * 1000.0, probeStats.rays * 1.0e-6, probeStats.threads);
+        }
+        if (m_probeBenchmark.instances > 0)
+        {
+            ImGui::Text("Probe SH %u instances: scalar %.1f ms, SIMD %.1f ms, %u threads %.1f ms", m_probeBenchmark.instances,
+                m_probeBenchmark.scalarMs, m_probeBenchmark.simdMs, m_probeBenchmark.threads, m_probeBenchmark.parallelMs);
         }
     }
-
-    return minDepth;
-}
-
-void RenderClass::RenderParallelogram() {
-    D3D11_RASTERIZER_DESC rasterDesc = {};
-    rasterDesc.FillMode = D3D11_FILL_SOLID;
-    rasterDesc.CullMode = D3D11_CULL_NONE;
-    rasterDesc.FrontCounterClockwise = FALSE;
-
-    ID3D11RasterizerState* rasterState = nullptr;
-    m_pDevice->CreateRasterizerState(&rasterDesc, &rasterState);
-    m_pDeviceContext->RSSetState(rasterState);
-
-    if (rasterState) rasterState->Release();
-
-    m_pDeviceContext->OMSetDepthStencilState(m_pStateParallelogram, 0);
-    m_pDeviceContext->OMSetBlendState(m_pBlendState, nullptr, 0xFFFFFFFF);
-
-    UINT vertexStride = sizeof(ParallelogramVertex);
-    UINT vertexOffset = 0;
-    m_pDeviceContext->IASetVertexBuffers(0, 1, &m_ParallelogramVertexBuffer, &vertexStride, &vertexOffset);
-    m_pDeviceContext->IASetIndexBuffer(m_pParallelogramIndexBuffer, DXGI_FORMAT_R16_UINT, 0);
-    m_pDeviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-    m_pDeviceContext->IASetInputLayout(m_pParallelogramLayout);
-
-    m_pDeviceContext->VSSetShader(m_pParallelogramVS, nullptr, 0);
-    m_pDeviceContext->VSSetConstantBuffers(0, 1, &m_pModelBuffer);
-    m_pDeviceContext->VSSetConstantBuffers(1, 1, &m_pVPBuffer);
-
-    m_pDeviceContext->PSSetShader(m_pParallelogramPS, nullptr, 0);
-    m_pDeviceContext->PSSetConstantBuffers(0, 1, &m_pColorBuffer);
-
-    static float rotationAngle = 0.0f;
-    rotationAngle += 0.015f;
-
-    std::vector<RenderObject> parallelograms = {
-        { XMMatrixTranslation(sinf(rotationAngle) * 2.0f, 1.0f, -2.0f), { 0.2f, 0.0f, 0.7f, 0.5f } },
-        { XMMatrixTranslation(-sinf(rotationAngle) * 2.0f, 1.0f, -3.0f), { 0.7f, 0.0f, 0.5f, 0.5f } }
-    };
-
-    XMVECTOR cameraPosition = XMLoadFloat3(&m_CameraPosition);
-
-    for (auto& obj : parallelograms) {
-        obj.minDepth = ComputeMinDepth(obj, cameraPosition);
+    ImGui::Checkbox("Shadows", &m_useShadows);
+    if (m_useShadows)
+    {
+        ImGui::SameLine();
+        ImGui::SliderInt("Shadow Faces Per Frame", &m_shadowFacesPerFrame, 6, 192);
+        const ShadowCacheStats& shadowStats = m_scene.GetShadowCache().GetStats();
+        ImGui::Text("Shadows: %u / %u lights, faces %u drawn, %u cached, %u deferred", shadowStats.shadowedLights,
+            shadowStats.requestedLights, shadowStats.facesRendered, shadowStats.facesCached, shadowStats.facesDeferred);
+        ImGui::Text("Shadow Atlas: %u tiles, %.0f%% used, %u evicted, %u failed", shadowStats.atlasTiles,
+            shadowStats.atlasUsage * 100.0f, shadowStats.evictedLights, shadowStats.failedAllocations);
     }
-
-    std::sort(parallelograms.begin(), parallelograms.end(), [](const RenderObject& a, const RenderObject& b) {
-        return a.minDepth > b.minDepth;
-        });
-
-    for (const auto& obj : parallelograms) {
-        DrawParallelogram(XMMatrixTranspose(obj.transform), obj.color);
+    ImGui::Checkbox("Sun Cascades", &m_useSun);
+    ImGui::SameLine();
+    if (ImGui::Button("Benchmark Cascades (1M casters)"))
+        m_cascadeBenchmark = CascadedShadows::Benchmark(1000000, CascadedShadows::MaxCascades);
+    if (m_useSun)
+    {
+        ImGui::SliderFloat("Sun Azimuth", &m_sunAzimuth, 0.0f, XM_2PI);
+        ImGui::SliderFloat("Sun Elevation", &m_sunElevation, 0.1f, XM_PIDIV2);
+        ImGui::SliderInt("Cascades", &m_cascadeCount, 1, CascadedShadows::MaxCascades);
+        ImGui::SliderFloat("Split Lambda", &m_cascadeSplitLambda, 0.0f, 1.0f);
+        for (uint32_t i = 0; i < m_scene.GetCascades().GetCascadeCount(); i++)
+        {
+            const ShadowCascade& cascade = m_scene.GetCascades().GetCascade(i);
+            ImGui::Text("Cascade %u: %.1f - %.1f, radius %.1f, %u casters", i, cascade.splitNear, cascade.splitFar,
+                cascade.radius, cascade.casterCount);
+        }
+        ImGui::Text("Cascade Update: %.3f ms", m_scene.GetCascades().GetStats().updateMs);
     }
-
-}
-
-void RenderClass::DrawParallelogram(const XMMATRIX& modelMatrix, const XMFLOAT4& color) {
-    m_pDeviceContext->UpdateSubresource(m_pModelBuffer, 0, nullptr, &modelMatrix, 0, 0);
-    m_pDeviceContext->UpdateSubresource(m_pColorBuffer, 0, nullptr, &color, 0, 0);
-    m_pDeviceContext->DrawIndexed(6, 0, 0);
-}
-
-HRESULT RenderClass::Init2DArray()
-{
-    ID3D11Resource* textureResources[2] = { nullptr, nullptr };
-
-    HRESULT hr = DirectX::CreateDDSTextureFromFile(m_pDevice, L"cat.dds", &textureResources[0], nullptr);
-    if (FAILED(hr)) return hr;
-
-    hr = DirectX::CreateDDSTextureFromFile(m_pDevice, L"textile.dds", &textureResources[1], nullptr);
-    if (FAILED(hr)) {
-        textureResources[0]->Release();
-        return hr;
+    if (m_cascadeBenchmark.casterCount > 0)
+    {
+        ImGui::Text("Cascades %u x %u casters: fit %.2f us, scalar %.2f ms, SIMD %.2f ms, %u mismatches",
+            m_cascadeBenchmark.cascadeCount, m_cascadeBenchmark.casterCount, m_cascadeBenchmark.fitUs,
+            m_cascadeBenchmark.scalarMs, m_cascadeBenchmark.simdMs, m_cascadeBenchmark.mismatches);
     }
-
-    ID3D11Texture2D* tempTexture = nullptr;
-    textureResources[0]->QueryInterface(__uuidof(ID3D11Texture2D), reinterpret_cast<void**>(&tempTexture));
-
-    D3D11_TEXTURE2D_DESC textureDesc;
-    tempTexture->GetDesc(&textureDesc);
-    tempTexture->Release();
-
-    D3D11_TEXTURE2D_DESC arrayTextureDesc = textureDesc;
-    arrayTextureDesc.ArraySize = 2;
-
-    ID3D11Texture2D* textureArray = nullptr;
-    hr = m_pDevice->CreateTexture2D(&arrayTextureDesc, nullptr, &textureArray);
-    if (FAILED(hr)) {
-        textureResources[0]->Release();
-        textureResources[1]->Release();
-        return hr;
+    ImGui::SliderInt("Extra Lights", &m_extraLightCount, 0, static_cast<int>(SceneRenderer::MaxExtraLights));
+    ImGui::SameLine();
+    if (ImGui::Button("Benchmark 4k Lights"))
+        m_clusterBenchmark = LightClusterGrid::Benchmark(&ThreadPool::Get(), 4096, 100);
+    const LightClusterStats& clusterStats = m_scene.GetLightClusters().GetStats();
+    ImGui::Text("Clustered Lights: %u visible, %u references, up to %u per cluster%s", clusterStats.visibleLights,
+        clusterStats.references, clusterStats.maxLightsPerCluster, clusterStats.overflow ? " (overflow)" : "");
+    if (m_clusterBenchmark.iterations > 0)
+    {
+        ImGui::Text("Cluster Build %u lights: %.3f ms (%u threads, %.1f lights per cluster)", m_clusterBenchmark.lightCount,
+            m_clusterBenchmark.msPerBuild, m_clusterBenchmark.threads, m_clusterBenchmark.referencesPerCluster);
     }
-
-    for (UINT i = 0; i < 2; ++i) {
-        for (UINT mip = 0; mip < textureDesc.MipLevels; ++mip) {
-            if (textureResources[i]) {
-                m_pDeviceContext->CopySubresourceRegion(
-                    textureArray,
-                    D3D11CalcSubresource(mip, i, textureDesc.MipLevels),
-                    0, 0, 0,
-                    textureResources[i],
-                    mip,
-                    nullptr
-                );
-            }
-            else {
-                OutputDebugString(L"Error: Null texture resource encountered\n");
-            }
-        }
+    //   :     ,    
+    ImGui::Checkbox("Per-Instance Light Lists", &m_useInstanceLights);
+    ImGui::SameLine();
+    if (ImGui::Button("Benchmark 1k x 100k"))
+        m_instanceLightBenchmark = InstanceLightLists::Benchmark(&ThreadPool::Get(), 1000, 100000);
+    if (m_useInstanceLights)
+    {
+        const InstanceLightStats& instanceStats = m_scene.GetInstanceLights().GetStats();
+        ImGui::Text("Instance Lights: %.3f ms, %.1f per cube (up to %u, %u overflowed) of %u lights",
+            instanceStats.buildMs, instanceStats.instanceCount > 0 ? static_cast<float>(instanceStats.references) / instanceStats.instanceCount : 0.0f,
+            instanceStats.maxLightsPerInstance, instanceStats.overflowedInstances, instanceStats.lightCount);
     }
-    textureResources[0]->Release();
-    textureResources[1]->Release();
-
-    D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-    srvDesc.Format = textureDesc.Format;
-    srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
-    srvDesc.Texture2DArray.ArraySize = 2;
-    srvDesc.Texture2DArray.FirstArraySlice = 0;
-    srvDesc.Texture2DArray.MipLevels = textureDesc.MipLevels;
-    srvDesc.Texture2DArray.MostDetailedMip = 0;
-
-    hr = m_pDevice->CreateShaderResourceView(textureArray, &srvDesc, &m_pTextureView);
-    textureArray->Release();
-    return hr;
-}
-
-HRESULT RenderClass::InitFullScreenTriangle()
-{
-    FullScreenVertex vertices[3] = {
-        { -1.0f, -1.0f, 0, 1,   0.0f, 1.0f },
-        { -1.0f,  3.0f, 0, 1,   0.0f,-1.0f },
-        {  3.0f, -1.0f, 0, 1,   2.0f, 1.0f }
-    };
-
-    D3D11_BUFFER_DESC vertexBufferDesc = {};
-    vertexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
-    vertexBufferDesc.ByteWidth = sizeof(vertices);
-    vertexBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-
-    D3D11_SUBRESOURCE_DATA vertexData = {};
-    vertexData.pSysMem = vertices;
-
-    HRESULT hr = m_pDevice->CreateBuffer(&vertexBufferDesc, &vertexData, &m_pFullScreenVB);
-    if (FAILED(hr)) return hr;
+    if (m_instanceLightBenchmark.instanceCount > 0)
+    {
+        ImGui::Text("Instance Lists %u x %u: scalar %.1f ms, SIMD %.1f ms, %u threads %.1f ms (%.2f per instance)",
+            m_instanceLightBenchmark.lightCount, m_instanceLightBenchmark.instanceCount, m_instanceLightBenchmark.scalarMs,
+            m_instanceLightBenchmark.simdMs, m_instanceLightBenchmark.threads, m_instanceLightBenchmark.parallelMs,
+            m_instanceLightBenchmark.lightsPerInstance);
+    }
+    ImGui::Text("Render Passes: %d / %d", static_cast<int>(m_scene.GetGraph().GetExecutedPassCount()), static_cast<int>(m_scene.GetGraph().GetPassCount()));
+    ImGui::Text("Transient Targets: %d", static_cast<int>(m_graphTargets.size()));
+    ImGui::SliderInt("Frames In Flight", &m_requestedFramesInFlight, 1, FrameManager::MaxFramesInFlight);
+    ImGui::Text("CPU Waits On GPU: %llu", static_cast<unsigned long long>(m_frameManager.GetWaitCount()));
+
+    const BackendStats& backendStats = m_backend.GetLastFrameStats();
+    ImGui::Text("Backend Draws: %llu (%llu instances)", static_cast<unsigned long long>(backendStats.draws),
+        static_cast<unsigned long long>(backendStats.instances));
+    ImGui::Text("Backend Binds: %llu", static_cast<unsigned long long>(
+        backendStats.pipelineBinds + backendStats.bufferBinds + backendStats.textureBinds));
+    ImGui::Text("Backend Uploads: %llu (%.1f KB)", static_cast<unsigned long long>(backendStats.uploads),
+        backendStats.bytesUploaded / 1024.0);
+    ImGui::End();
 
-    //   
-    D3D11_INPUT_ELEMENT_DESC inputLayoutDesc[] = {
-        { "POSITION", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-        { "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 16, D3D11_INPUT_PER_VERTEX_DATA, 0 }
-    };
+    ImGui::Begin("Frustum Culling Info");
+    ImGui::Text("Total Cubes: %d", static_cast<int>(SceneRenderer::MaxInstances));
+    ImGui::Text("Visible Cubes: %d", m_visibleCubes);
+    ImGui::Text("Culled Cubes: %d", static_cast<int>(SceneRenderer::MaxInstances) - m_visibleCubes);
+    ImGui::Text("Batched Objects: %d", static_cast<int>(m_scene.GetBatcher().GetItemCount()));
+    ImGui::Text("Batched Draw Calls: %d", static_cast<int>(m_scene.GetBatchDrawCalls()));
 
-    ID3DBlob* vertexShaderBlob = nullptr;
-    hr = CompileShader(L"NegativeVertex.vs", &m_pPostProcessVS, nullptr, &vertexShaderBlob);
-    if (FAILED(hr)) return hr;
+    ImGui::End();
 
-    hr = m_pDevice->CreateInputLayout(
-        inputLayoutDesc, 2, vertexShaderBlob->GetBufferPointer(),
-        vertexShaderBlob->GetBufferSize(), &m_pFullScreenLayout
-    );
-    vertexShaderBlob->Release();
-    if (FAILED(hr)) return hr;
+    RenderProfilerWindow();
 
-    return CompileShader(L"NegativePixel.ps", nullptr, &m_pPostProcessPS);
+    ImGui::Render();
+    m_imguiRenderer.Render(m_backend, ImGui::GetDrawData());
 }
 
-void RenderClass::UpdateFrustum(const XMMATRIX& viewProjMatrix)
+void RenderClass::RenderProfilerWindow()
 {
-    XMFLOAT4X4 matViewProj;
-    XMStoreFloat4x4(&matViewProj, viewProjMatrix);
-
-    m_frustumPlanes[0] = XMVectorSet(
-        matViewProj._14 + matViewProj._11,
-        matViewProj._24 + matViewProj._21,
-        matViewProj._34 + matViewProj._31,
-        matViewProj._44 + matViewProj._41
-    );
-
-    m_frustumPlanes[1] = XMVectorSet(
-        matViewProj._14 - matViewProj._11,
-        matViewProj._24 - matViewProj._21,
-        matViewProj._34 - matViewProj._31,
-        matViewProj._44 - matViewProj._41
-    );
-
-    m_frustumPlanes[2] = XMVectorSet(
-        matViewProj._14 + matViewProj._12,
-        matViewProj._24 + matViewProj._22,
-        matViewProj._34 + matViewProj._32,
-        matViewProj._44 + matViewProj._42
-    );
-
-    m_frustumPlanes[3] = XMVectorSet(
-        matViewProj._14 - matViewProj._12,
-        matViewProj._24 - matViewProj._22,
-        matViewProj._34 - matViewProj._32,
-        matViewProj._44 - matViewProj._42
-    );
-
-    m_frustumPlanes[4] = XMVectorSet(
-        matViewProj._13,
-        matViewProj._23,
-        matViewProj._33,
-        matViewProj._43
-    );
-
-    m_frustumPlanes[5] = XMVectorSet(
-        matViewProj._14 - matViewProj._13,
-        matViewProj._24 - matViewProj._23,
-        matViewProj._34 - matViewProj._33,
-        matViewProj._44 - matViewProj._43
-    );
-
-    for (auto& plane : m_frustumPlanes)
+    ImGui::Begin("Profiler");
+
+    bool enabled = Profiler::Get().IsEnabled();
+    if (ImGui::Checkbox("Enabled", &enabled))
+        Profiler::Get().SetEnabled(enabled);
+    ImGui::SameLine();
+    if (ImGui::Button("Export Chrome Trace"))
+        m_traceExported = Profiler::Get().WriteChromeTrace("profile_trace.json") ? 1 : -1;
+    if (m_traceExported != 0)
     {
-        plane = XMPlaneNormalize(plane);
+        ImGui::SameLine();
+        ImGui::TextUnformatted(m_traceExported > 0 ? "profile_trace.json" : "Export failed");
+    }
+    if (ImGui::Button("Measure Overhead"))
+        m_profilerBenchmark = Profiler::Benchmark(1000000);
+    if (m_profilerBenchmark.scopes > 0)
+    {
+        ImGui::SameLine();
+        ImGui::Text("Scope: %.1f ns off, %.1f ns on", m_profilerBenchmark.disabledNs, m_profilerBenchmark.enabledNs);
     }
-}
 
-bool RenderClass::IsAABBInFrustum(const XMFLOAT3& center, float boundingRadius) const
-{
-    for (const auto& plane : m_frustumPlanes)
+    uint64_t frameStart = Profiler::Get().GetLastFrameStart();
+    uint64_t frameEnd = Profiler::Get().GetLastFrameEnd();
+    if (frameEnd > frameStart)
     {
-        float distance = XMVectorGetX(XMPlaneDotCoord(plane, XMLoadFloat3(&center)));
-        float radiusOffset = boundingRadius * (
-            fabs(XMVectorGetX(plane)) +
-            fabs(XMVectorGetY(plane)) +
-            fabs(XMVectorGetZ(plane))
-            );
+        ImGui::Text("CPU Frame: %.3f ms", (frameEnd - frameStart) * 1.0e-6);
+        ImGui::Text("GPU Frame: %.3f ms", m_gpuProfiler.GetLastFrameMs());
+
+        // -  :   ,  = 
+        std::vector<ProfileEvent> events;
+        Profiler::Get().Collect(events, frameStart, frameEnd);
+        uint32_t gpuThread = Profiler::Get().GetGpuThreadIndex();
 
-        if (distance + radiusOffset < 0)
+        uint32_t maxDepth = 0;
+        for (const auto& event : events)
         {
-            return false;
+            if (event.threadIndex != gpuThread && event.depth > maxDepth)
+                maxDepth = event.depth;
         }
-    }
-    return true;
-}
 
-void RenderClass::InitImGui(HWND hWnd)
-{
-    IMGUI_CHECKVERSION();
-    ImGui::CreateContext();
-    ImGuiIO& io = ImGui::GetIO(); (void)io;
+        const float rowHeight = ImGui::GetTextLineHeight() + 4.0f;
+        ImVec2 origin = ImGui::GetCursorScreenPos();
+        float width = ImGui::GetContentRegionAvail().x;
+        if (width < 100.0f)
+            width = 100.0f;
+        float scale = width / static_cast<float>(frameEnd - frameStart);
 
-    ImGui::StyleColorsDark();
-    ImGui_ImplWin32_Init(hWnd);
-    ImGui_ImplDX11_Init(m_pDevice, m_pDeviceContext);
-}
+        ImDrawList* pDrawList = ImGui::GetWindowDrawList();
+        for (const auto& event : events)
+        {
+            if (event.threadIndex == gpuThread || event.startNs < frameStart)
+                continue;
 
-void RenderClass::RenderImGui()
-{
-    ImGui_ImplDX11_NewFrame();
-    ImGui_ImplWin32_NewFrame();
-    ImGui::NewFrame();
+            float x0 = origin.x + (event.startNs - frameStart) * scale;
+            float x1 = origin.x + (event.endNs - frameStart) * scale;
+            float y0 = origin.y + event.depth * rowHeight;
+            if (x1 - x0 < 1.0f)
+                x1 = x0 + 1.0f;
 
-    ImGui::Begin("Options");
-    ImGui::Checkbox("Negative Effect", &m_useNegative);
-    ImGui::End();
+            size_t hash = std::hash<std::string>()(event.name);
+            ImU32 color = IM_COL32(80 + hash % 120, 80 + (hash >> 8) % 120, 80 + (hash >> 16) % 120, 255);
+            pDrawList->AddRectFilled(ImVec2(x0, y0), ImVec2(x1, y0 + rowHeight - 1.0f), color);
 
-    ImGui::Begin("Frustum Culling Info");
-    ImGui::Text("Total Cubes: %d", MaxInst);
-    ImGui::Text("Visible Cubes: %d", m_visibleCubes);
-    ImGui::Text("Culled Cubes: %d", MaxInst - m_visibleCubes);
+            if (ImGui::CalcTextSize(event.name).x < x1 - x0 - 4.0f)
+                pDrawList->AddText(ImVec2(x0 + 2.0f, y0 + 2.0f), IM_COL32_WHITE, event.name);
 
-    ImGui::End();
+            if (ImGui::IsMouseHoveringRect(ImVec2(x0, y0), ImVec2(x1, y0 + rowHeight)))
+                ImGui::SetTooltip("%s: %.3f ms", event.name, (event.endNs - event.startNs) * 1.0e-6);
+        }
+        ImGui::Dummy(ImVec2(width, (maxDepth + 1) * rowHeight));
+    }
 
-    ImGui::Render();
-    ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
+    ImGui::Separator();
+    ImGui::Text("GPU Timings");
+    for (const auto& timing : m_gpuProfiler.GetLastTimings())
+        ImGui::Text("%*s%s: %.3f ms", static_cast<int>(timing.depth * 2), "", timing.name, timing.ms);
+
+    ImGui::End();
 }
\ No newline at end of file
@@ -4,11 +4,35 @@
 #include <dxgi.h>
 #include <d3d11.h>
 #include <DirectXMath.h>
+#include <atomic>
+#include <thread>
 #include <vector>
 
+#include "D3D11RenderBackend.h"
+#include "DDSLayout.h"
+#include "EnvironmentLighting.h"
+#include "FrameManager.h"
+#include "GpuProfiler.h"
+#include "ImGuiRenderer.h"
+#include "LightProbeGrid.h"
+#include "LightmapBaker.h"
+#include "MipFeedback.h"
+#include "ReflectionProbeBaker.h"
+#include "RayTracer.h"
+#include "RenderGraph.h"
+#include "SceneRenderer.h"
+#include "CascadedShadows.h"
+#include "BlockDecoder.h"
+#include "SoftwareRenderer.h"
+#include "TextureCooker.h"
+#include "TexturePacker.h"
+#include "TextureStreamer.h"
+
 using namespace DirectX;
 
-class RenderClass
+class D3D11TextureStreamDevice;
+
+class RenderClass : private SceneHost
 {
 public:
     RenderClass()
@@ -16,55 +40,59 @@ public:
         m_pDeviceContext(nullptr),
         m_pSwapChain(nullptr),
         m_pRenderTargetView(nullptr),
-        m_pVertexBuffer(nullptr),
-        m_pIndexBuffer(nullptr),
         m_pPixelShader(nullptr),
         m_pVertexShader(nullptr),
         m_pLayout(nullptr),
-        m_pModelBuffer(nullptr),
-        m_pVPBuffer(nullptr),
         m_szTitle(nullptr),
         m_szWindowClass(nullptr),
-        m_pTextureView(nullptr),
         m_pSamplerState(nullptr),
-        m_pSkyboxSRV(nullptr),
-        m_pSkyboxVB(nullptr),
-        m_pSkyboxVPBuffer(nullptr),
         m_pSkyboxVS(nullptr),
         m_pSkyboxPS(nullptr),
         m_pSkyboxLayout(nullptr),
+        m_pSkyboxDepthState(nullptr),
+        m_pSkyboxRaster(nullptr),
         m_pDepthView(nullptr),
-        m_pColorBuffer(nullptr),
-        m_ParallelogramVertexBuffer(nullptr),
-        m_pParallelogramIndexBuffer(nullptr),
         m_pParallelogramPS(nullptr),
-        m_pParallelogramVS(nullptr),
+        m_pInstancedVS(nullptr),
         m_pParallelogramLayout(nullptr),
         m_pBlendState(nullptr),
         m_pStateParallelogram(nullptr),
-        m_pLightBuffer(nullptr),
+        m_pRasterNoCull(nullptr),
         m_pLightPixelShader(nullptr),
-        m_pNormalMapView(nullptr),
-        m_pPostProcessTexture(nullptr),
-        m_pPostProcessRTV(nullptr),
-        m_pPostProcessSRV(nullptr),
         m_pPostProcessVS(nullptr),
         m_pPostProcessPS(nullptr),
-        m_pFullScreenVB(nullptr),
         m_pFullScreenLayout(nullptr),
-        m_pModelBufferInst(nullptr),
         m_pComputeShader(nullptr),
-        m_pFrustumPlanesBuffer(nullptr),
-        m_pIndirectArgsBuffer(nullptr),
-        m_pObjectsIdsBuffer(nullptr),
-        m_pIndirectArgsUAV(nullptr),
-        m_pObjectsIdsUAV(nullptr),
-        m_pInstanceDataSRV(nullptr),
+        m_pFrameFence(nullptr),
+        m_pImGuiVS(nullptr),
+        m_pImGuiPS(nullptr),
+        m_pImGuiLayout(nullptr),
+        m_pImGuiBlend(nullptr),
+        m_pImGuiRaster(nullptr),
+        m_pImGuiDepthState(nullptr),
+        m_pImGuiSampler(nullptr),
+        m_pTextureDevice(nullptr),
+        m_pSoftwareTarget(nullptr),
+        m_pLightmapSRV(nullptr),
+        m_pLightmapPixelShader(nullptr),
+        m_pPrefilteredSRV(nullptr),
+        m_pShadowAtlas(nullptr),
+        m_pShadowDSV(nullptr),
+        m_pShadowSRV(nullptr),
+        m_pShadowVS(nullptr),
+        m_pShadowClearVS(nullptr),
+        m_pShadowLayout(nullptr),
+        m_pShadowRaster(nullptr),
+        m_pShadowClearState(nullptr),
+        m_pShadowSampler(nullptr),
+        m_pCascadeMap(nullptr),
+        m_pCascadeDSV(),
+        m_pCascadeSRV(nullptr),
+        m_pReflectionProbeSRV(nullptr),
         m_CameraPosition(0.0f, 0.0f, -10.0f),
         m_CameraSpeed(0.1f),
         m_LRAngle(0.0f),
-        m_UDAngle(0.0f),
-        m_CubeAngle(0.0f)
+        m_UDAngle(0.0f)
     {
     }
 
@@ -80,6 +108,12 @@ public:
     HRESULT InitSkybox();
     void TerminateSkybox();
 
+    HRESULT InitEnvironmentLighting();
+    void TerminateEnvironmentLighting();
+
+    HRESULT InitShadows();
+    void TerminateShadows();
+
     HRESULT CompileComputeShader(const std::wstring& path, ID3D11ComputeShader** ppComputeShader);
     HRESULT CompileShader(const std::wstring& path, ID3D11VertexShader** ppVertexShader, ID3D11PixelShader** ppPixelShader, ID3DBlob** pCodeShader = nullptr);
 
@@ -91,143 +125,278 @@ public:
 
     HRESULT InitParallelogram();
     void TerminateParallelogram();
-    void RenderSkybox(XMMATRIX proj);
-    void RenderCubes(XMMATRIX view, XMMATRIX proj);
-    void RenderParallelogram();
-    void DrawParallelogram(const XMMATRIX& modelMatrix, const XMFLOAT4& color);
+    void UpdateScene();
 
-    void InitImGui(HWND hWnd);
+    HRESULT InitImGui(HWND hWnd);
+    void TerminateImGui();
     void RenderImGui();
+    void RenderProfilerWindow();
     HRESULT Init2DArray();
     HRESULT InitFullScreenTriangle();
 
 private:
-    struct InstanceData
-    {
-        XMMATRIX model;
-        UINT texInd;
-        UINT countInstance;
-        XMFLOAT2 padding;
-    };
-
-    struct FullScreenVertex
-    {
-        float x, y, z, w;
-        float u, v;
-    };
-
-    struct Vertex
+    struct GraphTarget
     {
-        XMFLOAT3 xyz;
-        XMFLOAT3 normal;
-        XMFLOAT2 uv;
+        RenderGraph::TextureDesc desc;
+        ID3D11Texture2D* texture;
+        ID3D11RenderTargetView* rtv;
+        ID3D11ShaderResourceView* srv;
+        BackendHandle textureHandle;
+        BackendHandle target;
+        BackendHandle depthTarget;     //   
     };
 
-    struct SkyboxVertex
-    {
-        float x, y, z;
-    };
-
-    struct MatrixBuffer
-    {
-        XMMATRIX m;
-    };
-
-    struct CameraBuffer
-    {
-        XMMATRIX vp;
-        XMFLOAT3 cameraPos;
-    };
-
-
-    struct ParallelogramVertex
-    {
-        float x, y, z;
-    };
-
-    struct ColorBuffer
-    {
-        XMFLOAT4 color;
-    };
-
-    struct PointLight {
-        XMFLOAT3 Position;
-        float Range;
-        XMFLOAT3 Color;
-        float Intensity;
-    };
+    HRESULT AcquireGraphTargets();
+    void ReleaseGraphTarget(const GraphTarget& target);
+    void ReleaseGraphTargets(size_t keepCount);
+    void ReleaseBackBufferTargets();
+
+    // SceneHost
+    BackendHandle GetTarget(RenderGraph::ResourceHandle resource, bool depth) override;
+    BackendHandle GetTexture(RenderGraph::ResourceHandle resource) override;
+    void RenderSoftware() override;
+    void RenderUi() override;
+
+    HRESULT InitScene();
+    void UpdateSceneEnvironment();
+
+    HRESULT InitFrameManager();
+    void TerminateFrameManager();
+    HRESULT InitTextureStreaming();
+    void TerminateTextureStreaming();
+    void UpdateTextureStreaming();
+    void UpdateStreamedView(StreamedTexture texture, ID3D11ShaderResourceView*& pRegisteredView, BackendHandle& handle);
+    void RestreamTextures();
+    //  TexturePacker    DDS,      DDS
+    std::string GetStreamPath(const char* path) const;
+    void BenchmarkTextureStreaming();
+    void ApplyFramesInFlight();
+
+    void BuildSoftwareFrame();
+    void LoadLightmaps();
+    void BakeLightProbes();
+    void LoadReflectionProbes();
+    void UpdateMipFeedback(const UINT* pIds, UINT count);
+    void BenchmarkTextureLoading();
+    void PrepareNormalMap();
+    //    BC5,    ; wait  
+    void FinishNormalMapCook(bool wait);
+    void CookTextures();
+    void PackTextures();
 
     HRESULT ConfigureBackBuffer(UINT width, UINT height);
-    bool IsAABBInFrustum(const XMFLOAT3& center, float size) const;
-    void UpdateFrustum(const XMMATRIX& viewProjMatrix);
 
     ID3D11Device* m_pDevice;
     ID3D11DeviceContext* m_pDeviceContext;
+    D3D11RenderBackend m_backend;
 
     IDXGISwapChain* m_pSwapChain;
     ID3D11RenderTargetView* m_pRenderTargetView;
+    BackendHandle m_backBufferTarget = InvalidBackendHandle;
+    BackendHandle m_backBufferDepthTarget = InvalidBackendHandle;
 
-    ID3D11Buffer* m_pModelBuffer;
-    ID3D11Buffer* m_pVPBuffer;
-
-    ID3D11Buffer* m_pVertexBuffer;
-    ID3D11Buffer* m_pIndexBuffer;
+    //    SceneRenderer,    ,     backend
+    SceneRenderer m_scene;
+    ScenePipelines m_scenePipelines = {};
+    SceneTargets m_sceneTargets = {};
+    SceneTextures m_sceneTextures = {};
 
     ID3D11PixelShader* m_pPixelShader;
     ID3D11VertexShader* m_pVertexShader;
     ID3D11InputLayout* m_pLayout;
 
-    ID3D11ShaderResourceView* m_pTextureView;
     ID3D11SamplerState* m_pSamplerState;
 
-    ID3D11ShaderResourceView* m_pSkyboxSRV;
-    ID3D11Buffer* m_pSkyboxVB;
-    ID3D11Buffer* m_pSkyboxVPBuffer;
     ID3D11VertexShader* m_pSkyboxVS;
     ID3D11PixelShader* m_pSkyboxPS;
     ID3D11InputLayout* m_pSkyboxLayout;
+    ID3D11DepthStencilState* m_pSkyboxDepthState;
+    ID3D11RasterizerState* m_pSkyboxRaster;
     ID3D11DepthStencilView* m_pDepthView;
 
-    ID3D11Buffer* m_pColorBuffer;
-    ID3D11Buffer* m_ParallelogramVertexBuffer;
-    ID3D11Buffer* m_pParallelogramIndexBuffer;
     ID3D11PixelShader* m_pParallelogramPS;
-    ID3D11VertexShader* m_pParallelogramVS;
+    ID3D11VertexShader* m_pInstancedVS;
     ID3D11InputLayout* m_pParallelogramLayout;
     ID3D11BlendState* m_pBlendState;
     ID3D11DepthStencilState* m_pStateParallelogram;
+    ID3D11RasterizerState* m_pRasterNoCull;
+
+    int m_extraLightCount = 0;
+    LightClusterBenchmarkResult m_clusterBenchmark = {};
 
-    ID3D11Buffer* m_pLightBuffer;
+    //    :    ,    
+    InstanceLightBenchmarkResult m_instanceLightBenchmark = {};
+    bool m_useInstanceLights = false;
     ID3D11PixelShader* m_pLightPixelShader;
-    ID3D11ShaderResourceView* m_pNormalMapView;
 
-    ID3D11Texture2D* m_pPostProcessTexture;
-    ID3D11RenderTargetView* m_pPostProcessRTV;
-    ID3D11ShaderResourceView* m_pPostProcessSRV;
     ID3D11VertexShader* m_pPostProcessVS;
     ID3D11PixelShader* m_pPostProcessPS;
-    ID3D11Buffer* m_pFullScreenVB;
     ID3D11InputLayout* m_pFullScreenLayout;
 
+    //   ,    CubePass 
     ID3D11ComputeShader* m_pComputeShader;
-    ID3D11Buffer* m_pFrustumPlanesBuffer;
-    ID3D11Buffer* m_pIndirectArgsBuffer;
-    ID3D11Buffer* m_pObjectsIdsBuffer;
-    ID3D11UnorderedAccessView* m_pIndirectArgsUAV;
-    ID3D11UnorderedAccessView* m_pObjectsIdsUAV;
-    ID3D11ShaderResourceView* m_pInstanceDataSRV;
+
+    FrameManager m_frameManager;
+    FrameFence* m_pFrameFence;
+    int m_requestedFramesInFlight = 2;
+
+    ID3D11VertexShader* m_pImGuiVS;
+    ID3D11PixelShader* m_pImGuiPS;
+    ID3D11InputLayout* m_pImGuiLayout;
+    ID3D11BlendState* m_pImGuiBlend;
+    ID3D11RasterizerState* m_pImGuiRaster;
+    ID3D11DepthStencilState* m_pImGuiDepthState;
+    ID3D11SamplerState* m_pImGuiSampler;
+    BackendHandle m_imguiPipeline = InvalidBackendHandle;
+    BackendHandle m_imguiFontTexture = InvalidBackendHandle;
+    ImGuiRenderer m_imguiRenderer;
+
+    GpuProfiler m_gpuProfiler;
+    int m_traceExported = 0;
+    ProfilerBenchmarkResult m_profilerBenchmark = {};
 
     bool m_useNegative = false;
 
-    const float m_fixedScale = 0.5f;
-    ID3D11Buffer* m_pModelBufferInst;
-    static const int MaxInst = 23;
-    std::vector<InstanceData> m_modelInstances = {};
+    SoftwareRenderer m_softwareRenderer;
+    SwSceneFrame m_softwareFrame;
+    SwBenchmarkResult m_softwareBenchmark = {};
+    ID3D11Texture2D* m_pSoftwareTarget;
+    bool m_softwareAvailable = false;
+    bool m_useSoftware = false;
+
+    RayTracer m_rayTracer;
+    RtBenchmarkResult m_rayTraceBenchmark = {};
+    int m_rayTraceSamples = 16;
+    bool m_rayTracerAvailable = false;
+    bool m_referenceSaved = false;
+
+    //    ,     
+    LightmapBaker m_lightmapBaker;
+    ID3D11ShaderResourceView* m_pLightmapSRV;
+    ID3D11PixelShader* m_pLightmapPixelShader;
+    bool m_lightmapBakerAvailable = false;
+    bool m_useBakedLighting = false;
+    int m_bakeSamples = 64;
+    int m_bakeBounces = 2;
+
+    //    : SH        
+    EnvironmentLighting m_environmentLighting;
+    SoftwareTexture m_environmentSource;
+    ID3D11ShaderResourceView* m_pPrefilteredSRV;
+    float m_ambientIntensity = 0.3f;
+    float m_reflectionIntensity = 0.3f;
+    float m_reflectionRoughness = 0.5f;
+    EnvironmentBenchmarkResult m_environmentBenchmarks[2] = {};
+    bool m_prefilteredSaved = false;
+
+    //   :    ,   
+    ID3D11Texture2D* m_pShadowAtlas;
+    ID3D11DepthStencilView* m_pShadowDSV;
+    ID3D11ShaderResourceView* m_pShadowSRV;
+    ID3D11VertexShader* m_pShadowVS;
+    ID3D11VertexShader* m_pShadowClearVS;
+    ID3D11InputLayout* m_pShadowLayout;
+    ID3D11RasterizerState* m_pShadowRaster;
+    ID3D11DepthStencilState* m_pShadowClearState;
+    ID3D11SamplerState* m_pShadowSampler;
+    bool m_useShadows = true;
+    int m_shadowFacesPerFrame = 36;
+
+    //    :      CPU,     
+    static const UINT CascadeMapSize = 2048;
+    ID3D11Texture2D* m_pCascadeMap;
+    ID3D11DepthStencilView* m_pCascadeDSV[CascadedShadows::MaxCascades];
+    ID3D11ShaderResourceView* m_pCascadeSRV;
+    CascadeBenchmarkResult m_cascadeBenchmark = {};
+    bool m_useSun = false;
+    float m_sunAzimuth = 0.6f;
+    float m_sunElevation = 0.9f;
+    int m_cascadeCount = 4;
+    float m_cascadeSplitLambda = 0.75f;
+
+    //  SH-   :       
+    LightProbeGrid m_lightProbes;
+    ProbeInterpolationBenchmark m_probeBenchmark = {};
+    bool m_lightProbesAvailable = false;
+    bool m_useLightProbes = true;
+    int m_probeRays = 128;
+
+    //   :  ,        
+    ReflectionProbeBaker m_reflectionBaker;
+    std::vector<XMFLOAT3> m_reflectionProbePositions;
+    std::vector<XMFLOAT3> m_loadedReflectionProbes;
+    ID3D11ShaderResourceView* m_pReflectionProbeSRV;
+    UINT m_reflectionProbeMips = 0;
+    bool m_reflectionBakerAvailable = false;
+    bool m_useReflectionProbes = true;
+
+    //  DDS   :         
+    DirectX::DDSLayout::DDSLoadBenchmarkResult m_ddsBenchmark = {};
+    double m_ddsDeviceMs[2] = {};
+    // Texture2DArray      CreateDDSTextureArrayFromFiles
+    DirectX::DDSLayout::DDSArrayBenchmarkResult m_ddsArrayBenchmark = {};
+    double m_ddsArrayMs = 0.0;
+    HRESULT m_ddsArrayResult = S_OK;
+
+    //   :    ,   ,     .
+    //          
+    TextureStreamer m_textureStreamer;
+    D3D11TextureStreamDevice* m_pTextureDevice;
+    StreamedTexture m_diffuseTexture = InvalidStreamedTexture;
+    StreamedTexture m_normalTexture = InvalidStreamedTexture;
+    StreamedTexture m_skyboxStream = InvalidStreamedTexture;
+    int m_streamBudgetKB = 512;
+    int m_textureBudgetMB = 0;
+    // ,   m_sceneTextures,   
+    ID3D11ShaderResourceView* m_pDiffuseView = nullptr;
+    ID3D11ShaderResourceView* m_pNormalView = nullptr;
+    ID3D11ShaderResourceView* m_pSkyboxView = nullptr;
+    TextureStreamBenchmarkResult m_streamBenchmark = {};
+    TextureResidencyBenchmarkResult m_residencyBenchmark = {};
+
+    //     :   CPU     ,  -   (texInd)
+    MipFeedback m_mipFeedback;
+    std::vector<MipFeedbackInstance> m_mipInstances;
+    bool m_useMipFeedback = true;
+    UINT m_wantedMips[3] = {};      // , ,  
+
+    //    BC1/BC3/BC5/BC7  CPU;      DDSTextureLoader11
+    struct CookedTexture
+    {
+        const char* path;
+        TextureCookStats stats;
+        bool cooked;
+        bool loaded;
+    };
+    static const UINT CookedTextureCount = 4;
+    CookedTexture m_cookedTextures[CookedTextureCount] = {};
+    CompressorBenchmarkResult m_compressorBenchmark = {};
+    NormalMapBenchmarkResult m_normalMapBenchmark = {};
+    MipBenchmarkResult m_mipBenchmark = {};
+
+    //  ,    64 ;      
+    static const UINT PackedTextureCount = 4;
+    struct PackedTexture
+    {
+        std::string path;
+        TexturePackStats stats;
+        bool packed;
+    };
+    PackedTexture m_packedTextures[PackedTextureCount] = {};
+    TexturePackBenchmarkResult m_packBenchmark = {};
+    //  BC  CPU,       
+    BlockDecodeBenchmarkResult m_decodeBenchmark = {};
+    const char* m_normalMapPath = "cube_normal.dds";
+    std::thread m_normalCookThread;
+    std::atomic<bool> m_normalCookRunning{ false };
+    bool m_normalCookSucceeded = false;     //     m_normalCookRunning
+
+    std::vector<GraphTarget> m_graphTargets;
+    UINT m_backBufferWidth = 0;
+    UINT m_backBufferHeight = 0;
 
     int m_visibleCubes = 0;
 
-    XMVECTOR m_frustumPlanes[6];
-
     WCHAR* m_szTitle;
     WCHAR* m_szWindowClass;
 
@@ -235,7 +404,6 @@ private:
     float m_CameraSpeed;
     float m_LRAngle;    //   /
     float m_UDAngle;    //   /
-    float m_CubeAngle;  //   
 
 };
 
@@ -0,0 +1,180 @@
+#include "RenderGraph.h"
+#include <algorithm>
+
+void RenderGraph::Reset()
+{
+    m_resources.clear();
+    m_passes.clear();
+    m_physical.clear();
+    m_error.clear();
+}
+
+RenderGraph::ResourceHandle RenderGraph::ImportTexture(const char* name)
+{
+    Resource resource = {};
+    resource.name = name;
+    resource.imported = true;
+    resource.firstUse = Invalid;
+    resource.lastUse = Invalid;
+    resource.physical = Invalid;
+    m_resources.push_back(resource);
+    return static_cast<ResourceHandle>(m_resources.size() - 1);
+}
+
+RenderGraph::ResourceHandle RenderGraph::CreateTexture(const char* name, const TextureDesc& desc)
+{
+    Resource resource = {};
+    resource.name = name;
+    resource.desc = desc;
+    resource.imported = false;
+    resource.firstUse = Invalid;
+    resource.lastUse = Invalid;
+    resource.physical = Invalid;
+    m_resources.push_back(resource);
+    return static_cast<ResourceHandle>(m_resources.size() - 1);
+}
+
+RenderGraph::PassHandle RenderGraph::AddPass(const char* name, ExecuteFunc execute)
+{
+    Pass pass;
+    pass.name = name;
+    pass.execute = execute;
+    pass.alive = false;
+    m_passes.push_back(pass);
+    return static_cast<PassHandle>(m_passes.size() - 1);
+}
+
+void RenderGraph::Read(PassHandle pass, ResourceHandle resource)
+{
+    m_passes[pass].reads.push_back(resource);
+}
+
+void RenderGraph::Write(PassHandle pass, ResourceHandle resource)
+{
+    m_passes[pass].writes.push_back(resource);
+}
+
+bool RenderGraph::Compile()
+{
+    m_physical.clear();
+    m_error.clear();
+
+    // Culling: walk passes backwards, a pass survives if it writes something that is
+    // needed later (an imported texture or a texture read by a surviving pass)
+    std::vector<bool> needed(m_resources.size(), false);
+    for (size_t i = 0; i < m_resources.size(); i++)
+    {
+        needed[i] = m_resources[i].imported;
+    }
+
+    for (size_t p = m_passes.size(); p-- > 0;)
+    {
+        Pass& pass = m_passes[p];
+        pass.alive = false;
+        for (ResourceHandle w : pass.writes)
+        {
+            if (needed[w])
+            {
+                pass.alive = true;
+                break;
+            }
+        }
+
+        if (pass.alive)
+        {
+            for (ResourceHandle r : pass.reads)
+                needed[r] = true;
+        }
+    }
+
+    // Lifetimes in terms of surviving pass indices
+    for (auto& resource : m_resources)
+    {
+        resource.firstUse = Invalid;
+        resource.lastUse = Invalid;
+        resource.physical = Invalid;
+    }
+
+    for (uint32_t p = 0; p < m_passes.size(); p++)
+    {
+        const Pass& pass = m_passes[p];
+        if (!pass.alive)
+            continue;
+
+        for (ResourceHandle r : pass.reads)
+        {
+            Resource& resource = m_resources[r];
+            if (!resource.imported && resource.firstUse == Invalid)
+            {
+                m_error = "Pass '" + pass.name + "' reads '" + resource.name + "' before it is written";
+                return false;
+            }
+            resource.lastUse = p;
+        }
+
+        for (ResourceHandle w : pass.writes)
+        {
+            Resource& resource = m_resources[w];
+            if (resource.firstUse == Invalid)
+                resource.firstUse = p;
+            resource.lastUse = p;
+        }
+    }
+
+    // Aliasing: transients ordered by first use take the first slot with the same
+    // description whose previous owner is already dead
+    std::vector<ResourceHandle> transients;
+    for (ResourceHandle r = 0; r < m_resources.size(); r++)
+    {
+        if (!m_resources[r].imported && m_resources[r].firstUse != Invalid)
+            transients.push_back(r);
+    }
+
+    std::stable_sort(transients.begin(), transients.end(), [this](ResourceHandle a, ResourceHandle b) {
+        return m_resources[a].firstUse < m_resources[b].firstUse;
+        });
+
+    std::vector<uint32_t> slotFreeAfter;
+    for (ResourceHandle r : transients)
+    {
+        Resource& resource = m_resources[r];
+        for (uint32_t slot = 0; slot < m_physical.size(); slot++)
+        {
+            if (m_physical[slot] == resource.desc && slotFreeAfter[slot] < resource.firstUse)
+            {
+                resource.physical = slot;
+                break;
+            }
+        }
+
+        if (resource.physical == Invalid)
+        {
+            resource.physical = static_cast<uint32_t>(m_physical.size());
+            m_physical.push_back(resource.desc);
+            slotFreeAfter.push_back(0);
+        }
+        slotFreeAfter[resource.physical] = resource.lastUse;
+    }
+
+    return true;
+}
+
+void RenderGraph::Execute() const
+{
+    for (const auto& pass : m_passes)
+    {
+        if (pass.alive && pass.execute)
+            pass.execute();
+    }
+}
+
+size_t RenderGraph::GetExecutedPassCount() const
+{
+    size_t count = 0;
+    for (const auto& pass : m_passes)
+    {
+        if (pass.alive)
+            count++;
+    }
+    return count;
+}
@@ -0,0 +1,87 @@
+#ifndef RENDER_GRAPH_H
+#define RENDER_GRAPH_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Frame description made of passes that declare which textures they read and write.
+// Compile() culls passes whose results never reach an imported texture, computes the
+// lifetime of every transient texture and packs transients that never overlap in time
+// into shared physical slots. The graph itself does not touch the device: the owner
+// creates one texture per physical slot and looks slots up while passes execute.
+class RenderGraph
+{
+public:
+    typedef uint32_t ResourceHandle;
+    typedef uint32_t PassHandle;
+    typedef std::function<void()> ExecuteFunc;
+
+    static const uint32_t Invalid = 0xFFFFFFFF;
+
+    struct TextureDesc
+    {
+        uint32_t width;
+        uint32_t height;
+        uint32_t format; // DXGI_FORMAT value
+
+        bool operator==(const TextureDesc& other) const
+        {
+            return width == other.width && height == other.height && format == other.format;
+        }
+    };
+
+    void Reset();
+
+    // External texture (e.g. the back buffer). Writes to it are the outputs of the graph.
+    ResourceHandle ImportTexture(const char* name);
+    // Texture that lives only inside the frame and may share memory with other transients.
+    ResourceHandle CreateTexture(const char* name, const TextureDesc& desc);
+
+    PassHandle AddPass(const char* name, ExecuteFunc execute);
+    void Read(PassHandle pass, ResourceHandle resource);
+    void Write(PassHandle pass, ResourceHandle resource);
+
+    bool Compile();
+    void Execute() const;
+
+    bool IsPassCulled(PassHandle pass) const { return !m_passes[pass].alive; }
+    size_t GetPassCount() const { return m_passes.size(); }
+    size_t GetExecutedPassCount() const;
+
+    bool IsImported(ResourceHandle resource) const { return m_resources[resource].imported; }
+    // Physical slot of a transient texture, Invalid for imported or unused ones
+    uint32_t GetPhysicalIndex(ResourceHandle resource) const { return m_resources[resource].physical; }
+    size_t GetPhysicalCount() const { return m_physical.size(); }
+    const TextureDesc& GetPhysicalDesc(uint32_t physical) const { return m_physical[physical]; }
+
+    const std::string& GetError() const { return m_error; }
+
+private:
+    struct Resource
+    {
+        std::string name;
+        TextureDesc desc;
+        bool imported;
+        uint32_t firstUse;
+        uint32_t lastUse;
+        uint32_t physical;
+    };
+
+    struct Pass
+    {
+        std::string name;
+        ExecuteFunc execute;
+        std::vector<ResourceHandle> reads;
+        std::vector<ResourceHandle> writes;
+        bool alive;
+    };
+
+    std::vector<Resource> m_resources;
+    std::vector<Pass> m_passes;
+    std::vector<TextureDesc> m_physical;
+    std::string m_error;
+};
+
+#endif
@@ -0,0 +1,259 @@
+#include "ScenePasses.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // Indirect arguments: IndexCountPerInstance, InstanceCount, StartIndexLocation, BaseVertexLocation, StartInstanceLocation
+    const uint32_t ArgumentCount = 5;
+    const uint32_t CullGroupSize = 64;     // numthreads of ComputeShader.cs
+
+    void Transpose(const XMFLOAT4X4& source, XMFLOAT4X4& destination)
+    {
+        for (int row = 0; row < 4; row++)
+        {
+            for (int column = 0; column < 4; column++)
+                destination.m[column][row] = source.m[row][column];
+        }
+    }
+}
+
+CubePass::CubePass()
+    : m_resources(),
+    m_count(0)
+{
+    for (uint32_t i = 0; i < FrameManager::MaxFramesInFlight; i++)
+        m_readbackFrame[i] = 0;
+}
+
+void CubePass::Upload(RenderBackend& backend, const CubeInstanceData* pInstances, uint32_t count, uint32_t maxInstances)
+{
+    m_count = std::min(count, maxInstances);
+    m_shaderInstances.resize(maxInstances);
+    for (uint32_t i = 0; i < m_count; i++)
+    {
+        m_shaderInstances[i] = pInstances[i];
+        m_shaderInstances[i].countInstance = m_count;
+        Transpose(pInstances[i].model, m_shaderInstances[i].model);
+    }
+
+    uint32_t size = static_cast<uint32_t>(sizeof(CubeInstanceData) * m_count);
+    if (m_count > 0)
+        backend.UpdateBuffer(m_resources.instanceBuffer, m_shaderInstances.data(), size);
+
+    // The compute shader reads the translation from the untransposed rows and the count from element 0
+    if (IsCulledOnGpu() && m_count > 0)
+    {
+        for (uint32_t i = 0; i < m_count; i++)
+            m_shaderInstances[i].model = pInstances[i].model;
+        backend.UpdateBuffer(m_resources.cullInstanceBuffer, m_shaderInstances.data(), size);
+    }
+}
+
+void CubePass::Cull(RenderBackend& backend, const XMFLOAT4 planes[6], float extent)
+{
+    if (IsCulledOnGpu())
+    {
+        backend.UpdateBuffer(m_resources.frustumBuffer, planes, sizeof(XMFLOAT4) * 6);
+        uint32_t initialArguments[ArgumentCount] = { m_resources.indexCount, 0, 0, 0, 0 };
+        backend.UpdateBuffer(m_resources.argumentsBuffer, initialArguments, sizeof(initialArguments));
+
+        backend.BindPipeline(m_resources.cullPipeline);
+        backend.BindConstantBuffer(ShaderStage::Compute, 0, m_resources.frustumBuffer);
+        backend.BindStructuredBuffer(ShaderStage::Compute, 0, m_resources.cullInstanceBuffer);
+        backend.BindUnorderedAccess(0, m_resources.argumentsBuffer);
+        backend.BindUnorderedAccess(1, m_resources.visibleIdsBuffer);
+        backend.Dispatch((m_count + CullGroupSize - 1) / CullGroupSize, 1, 1);
+
+        // The id list is read by the vertex shader next, it cannot stay bound for writing
+        backend.BindUnorderedAccess(0, InvalidBackendHandle);
+        backend.BindUnorderedAccess(1, InvalidBackendHandle);
+        backend.BindStructuredBuffer(ShaderStage::Compute, 0, InvalidBackendHandle);
+        return;
+    }
+
+    PROFILE_SCOPE("CPU Culling");
+    m_visibleIds.clear();
+    for (uint32_t i = 0; i < m_count; i++)
+    {
+        const XMFLOAT4X4& model = m_shaderInstances[i].model;
+        // Transposed for the vertex shader: the translation is the last column
+        float x = model._14;
+        float y = model._24;
+        float z = model._34;
+
+        bool inside = true;
+        for (int p = 0; p < 6 && inside; p++)
+        {
+            float distance = planes[p].x * x + planes[p].y * y + planes[p].z * z + planes[p].w;
+            float offset = extent * (std::fabs(planes[p].x) + std::fabs(planes[p].y) + std::fabs(planes[p].z));
+            inside = distance + offset >= 0.0f;
+        }
+        if (inside)
+            m_visibleIds.push_back(i);
+    }
+
+    // The same id list the compute shader would have written
+    if (!m_visibleIds.empty())
+        backend.UpdateBuffer(m_resources.visibleIdsBuffer, m_visibleIds.data(), static_cast<uint32_t>(sizeof(uint32_t) * m_visibleIds.size()));
+}
+
+void CubePass::Readback(RenderBackend& backend, const FrameManager& frames)
+{
+    if (!IsCulledOnGpu())
+        return;
+
+    uint32_t slot = frames.GetCurrentSlot();
+    bool hasReadback = false;
+    if (m_readbackFrame[slot] != 0)
+    {
+        uint32_t arguments[ArgumentCount] = {};
+        if (backend.ReadBuffer(m_resources.argumentsReadback[slot], arguments, sizeof(arguments)))
+        {
+            uint32_t count = std::min(arguments[1], m_count);
+            m_visibleIds.resize(count);
+            hasReadback = count == 0 ||
+                backend.ReadBuffer(m_resources.idsReadback[slot], m_visibleIds.data(), static_cast<uint32_t>(sizeof(uint32_t) * count));
+        }
+    }
+
+    if (!hasReadback)
+    {
+        m_visibleIds.resize(m_count);
+        for (uint32_t i = 0; i < m_count; i++)
+            m_visibleIds[i] = i;
+    }
+
+    backend.CopyBuffer(m_resources.argumentsReadback[slot], m_resources.argumentsBuffer);
+    backend.CopyBuffer(m_resources.idsReadback[slot], m_resources.visibleIdsBuffer);
+    m_readbackFrame[slot] = frames.GetFrameNumber();
+}
+
+void CubePass::Draw(RenderBackend& backend, BackendHandle pipeline)
+{
+    if (!IsCulledOnGpu() && m_visibleIds.empty())
+        return;
+
+    backend.BindPipeline(pipeline);
+    backend.BindVertexBuffer(m_resources.vertexBuffer, m_resources.vertexStride);
+    backend.BindIndexBuffer(m_resources.indexBuffer);
+    backend.BindConstantBuffer(ShaderStage::Vertex, 0, m_resources.instanceBuffer);
+    backend.BindConstantBuffer(ShaderStage::Vertex, 1, m_resources.cameraBuffer);
+    backend.BindStructuredBuffer(ShaderStage::Vertex, 0, m_resources.visibleIdsBuffer);
+
+    if (IsCulledOnGpu())
+        backend.DrawIndexedInstancedIndirect(m_resources.argumentsBuffer);
+    else
+        backend.DrawIndexedInstanced(m_resources.indexCount, static_cast<uint32_t>(m_visibleIds.size()));
+
+    // Next frame binds the id list as an unordered access view again
+    backend.BindStructuredBuffer(ShaderStage::Vertex, 0, InvalidBackendHandle);
+}
+
+ShadowPass::ShadowPass()
+    : m_resources(),
+    m_viewportWidth(1),
+    m_viewportHeight(1)
+{
+}
+
+void ShadowPass::SetViewportSize(uint32_t width, uint32_t height)
+{
+    m_viewportWidth = std::max(width, 1u);
+    m_viewportHeight = std::max(height, 1u);
+}
+
+void ShadowPass::SetMaxInstances(uint32_t maxInstances)
+{
+    CubeInstanceData empty = {};
+    m_instances.assign(maxInstances, empty);
+}
+
+void ShadowPass::RenderJobs(RenderBackend& backend, const std::vector<ShadowRenderJob>& jobs,
+    const std::vector<uint32_t>& jobCasters, const ShadowCaster* pCasters)
+{
+    if (jobs.empty())
+        return;
+
+    backend.BindTarget(m_resources.atlasTarget);
+    backend.BindVertexBuffer(m_resources.vertexBuffer, m_resources.vertexStride);
+    backend.BindIndexBuffer(m_resources.indexBuffer);
+    backend.BindConstantBuffer(ShaderStage::Vertex, 0, m_resources.instanceBuffer);
+    backend.BindConstantBuffer(ShaderStage::Vertex, 1, m_resources.faceBuffer);
+
+    for (const ShadowRenderJob& job : jobs)
+    {
+        backend.SetViewport(static_cast<float>(job.tile.x), static_cast<float>(job.tile.y),
+            static_cast<float>(job.tile.size), static_cast<float>(job.tile.size));
+
+        // Clears only this tile: a triangle on the far plane without the depth test
+        backend.BindPipeline(m_resources.clearPipeline);
+        backend.Draw(3);
+
+        if (job.casterCount == 0)
+            continue;
+
+        UploadViewProj(backend, job.viewProj);
+        backend.BindPipeline(m_resources.casterPipeline);
+        DrawCasters(backend, jobCasters.data() + job.firstCaster, job.casterCount, pCasters);
+    }
+
+    RestoreViewport(backend);
+}
+
+void ShadowPass::RenderCascades(RenderBackend& backend, const CascadedShadows& cascades, const ShadowCaster* pCasters)
+{
+    uint32_t cascadeCount = cascades.GetCascadeCount();
+    if (cascadeCount == 0)
+        return;
+
+    float size = static_cast<float>(m_resources.cascadeSize);
+    backend.SetViewport(0.0f, 0.0f, size, size);
+    backend.BindPipeline(m_resources.casterPipeline);
+    backend.BindVertexBuffer(m_resources.vertexBuffer, m_resources.vertexStride);
+    backend.BindIndexBuffer(m_resources.indexBuffer);
+    backend.BindConstantBuffer(ShaderStage::Vertex, 0, m_resources.instanceBuffer);
+    backend.BindConstantBuffer(ShaderStage::Vertex, 1, m_resources.faceBuffer);
+
+    // Each cascade only sees its own casters, the list was culled on the CPU
+    const std::vector<uint32_t>& casterIds = cascades.GetCasters();
+    for (uint32_t i = 0; i < cascadeCount; i++)
+    {
+        const ShadowCascade& cascade = cascades.GetCascade(i);
+        backend.ClearDepth(m_resources.cascadeTargets[i], 1.0f);
+        backend.BindTarget(m_resources.cascadeTargets[i]);
+        UploadViewProj(backend, cascade.viewProj);
+        if (cascade.casterCount > 0)
+            DrawCasters(backend, casterIds.data() + cascade.firstCaster, cascade.casterCount, pCasters);
+    }
+
+    RestoreViewport(backend);
+}
+
+void ShadowPass::DrawCasters(RenderBackend& backend, const uint32_t* pCasterIds, uint32_t count, const ShadowCaster* pCasters)
+{
+    uint32_t maxInstances = static_cast<uint32_t>(m_instances.size());
+    for (uint32_t first = 0; first < count && maxInstances > 0; first += maxInstances)
+    {
+        uint32_t chunk = std::min(maxInstances, count - first);
+        for (uint32_t i = 0; i < chunk; i++)
+            Transpose(pCasters[pCasterIds[first + i]].transform, m_instances[i].model);
+        backend.UpdateBuffer(m_resources.instanceBuffer, m_instances.data(), static_cast<uint32_t>(sizeof(CubeInstanceData) * chunk));
+        backend.DrawIndexedInstanced(m_resources.indexCount, chunk);
+    }
+}
+
+void ShadowPass::UploadViewProj(RenderBackend& backend, const XMFLOAT4X4& viewProj)
+{
+    XMFLOAT4X4 transposed;
+    Transpose(viewProj, transposed);
+    backend.UpdateBuffer(m_resources.faceBuffer, &transposed, sizeof(transposed));
+}
+
+void ShadowPass::RestoreViewport(RenderBackend& backend)
+{
+    // The scene pass expects the back buffer viewport and no depth target left bound
+    backend.SetViewport(0.0f, 0.0f, static_cast<float>(m_viewportWidth), static_cast<float>(m_viewportHeight));
+    backend.BindTarget(InvalidBackendHandle);
+}
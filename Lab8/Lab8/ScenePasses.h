@@ -0,0 +1,119 @@
+#ifndef SCENE_PASSES_H
+#define SCENE_PASSES_H
+
+#include <DirectXMath.h>
+#include <cstdint>
+#include <vector>
+
+#include "CascadedShadows.h"
+#include "FrameManager.h"
+#include "RenderBackend.h"
+#include "ShadowAtlas.h"
+
+using namespace DirectX;
+
+// Layout of InstanceData in ColorVertex.vs, ShadowVertex.vs and ComputeShader.cs
+struct CubeInstanceData
+{
+    XMFLOAT4X4 model;
+    uint32_t texInd;
+    uint32_t countInstance;
+    uint32_t lightmapSlice;
+    uint32_t padding;
+};
+
+struct CubePassResources
+{
+    BackendHandle vertexBuffer;
+    BackendHandle indexBuffer;
+    uint32_t vertexStride;
+    uint32_t indexCount;
+    BackendHandle instanceBuffer;       // constant, VS b0: transposed models in id order
+    BackendHandle cameraBuffer;         // constant, VS b1
+
+    // Culling on the GPU; with cullPipeline == InvalidBackendHandle the cubes are culled on the CPU
+    BackendHandle cullPipeline;
+    BackendHandle frustumBuffer;        // constant, CS b0
+    BackendHandle cullInstanceBuffer;   // dynamic structured, CS t0: models as stored on the CPU
+    BackendHandle argumentsBuffer;      // CS u0, drawn indirectly
+    BackendHandle visibleIdsBuffer;     // structured uint, CS u1 and VS t0
+    BackendHandle argumentsReadback[FrameManager::MaxFramesInFlight];
+    BackendHandle idsReadback[FrameManager::MaxFramesInFlight];
+};
+
+// The cube pass of the scene: uploads the instances, culls them against the frustum and
+// draws the survivors with one instanced draw. The GPU result is drawn in the same frame;
+// the CPU only sees a copy of it once the frame that wrote it has retired.
+class CubePass
+{
+public:
+    CubePass();
+
+    void SetResources(const CubePassResources& resources) { m_resources = resources; }
+    const CubePassResources& GetResources() const { return m_resources; }
+    bool IsCulledOnGpu() const { return m_resources.cullPipeline != InvalidBackendHandle; }
+
+    // World matrices as stored on the CPU (row-vector); count must not exceed maxInstances
+    void Upload(RenderBackend& backend, const CubeInstanceData* pInstances, uint32_t count, uint32_t maxInstances);
+    // Spheres of radius extent around each cube's translation against planes (dot(xyz, p) + w >= -r)
+    void Cull(RenderBackend& backend, const XMFLOAT4 planes[6], float extent);
+    // GPU culling only: reads the copy left by the frame that used this slot before, then
+    // queues a copy of this frame's result into the slot
+    void Readback(RenderBackend& backend, const FrameManager& frames);
+    void Draw(RenderBackend& backend, BackendHandle pipeline);
+
+    // Ids of the visible cubes: this frame's on the CPU path, the retired frame's readback
+    // on the GPU path, or every id when no readback has completed yet
+    const std::vector<uint32_t>& GetVisibleIds() const { return m_visibleIds; }
+
+private:
+    CubePassResources m_resources;
+    uint32_t m_count;
+    std::vector<CubeInstanceData> m_shaderInstances;
+    std::vector<uint32_t> m_visibleIds;
+    uint64_t m_readbackFrame[FrameManager::MaxFramesInFlight];
+};
+
+struct ShadowPassResources
+{
+    BackendHandle clearPipeline;        // far plane triangle, depth test always
+    BackendHandle casterPipeline;
+    BackendHandle vertexBuffer;
+    BackendHandle indexBuffer;
+    uint32_t vertexStride;
+    uint32_t indexCount;
+    BackendHandle instanceBuffer;       // constant, VS b0
+    BackendHandle faceBuffer;           // constant, VS b1: transposed view-projection
+    BackendHandle atlasTarget;
+    BackendHandle cascadeTargets[CascadedShadows::MaxCascades];
+    uint32_t cascadeSize;
+};
+
+// Depth-only passes for the shadow atlas tiles the cache marked stale and for the sun
+// cascades. Both leave the viewport at the back buffer size and no target bound.
+class ShadowPass
+{
+public:
+    ShadowPass();
+
+    void SetResources(const ShadowPassResources& resources) { m_resources = resources; }
+    void SetViewportSize(uint32_t width, uint32_t height);
+    void SetMaxInstances(uint32_t maxInstances);
+
+    void RenderJobs(RenderBackend& backend, const std::vector<ShadowRenderJob>& jobs,
+        const std::vector<uint32_t>& jobCasters, const ShadowCaster* pCasters);
+    void RenderCascades(RenderBackend& backend, const CascadedShadows& cascades, const ShadowCaster* pCasters);
+
+private:
+    // Uploads up to maxInstances casters of the range and draws them
+    void DrawCasters(RenderBackend& backend, const uint32_t* pCasterIds, uint32_t count, const ShadowCaster* pCasters);
+    void UploadViewProj(RenderBackend& backend, const XMFLOAT4X4& viewProj);
+    void RestoreViewport(RenderBackend& backend);
+
+    ShadowPassResources m_resources;
+    uint32_t m_viewportWidth;
+    uint32_t m_viewportHeight;
+    std::vector<CubeInstanceData> m_instances;
+};
+
+#endif
@@ -0,0 +1,1099 @@
+#include "SceneRenderer.h"
+#include "EnvironmentLighting.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <numeric>
+
+namespace
+{
+    const float Pi = 3.14159265f;
+    const float TwoPi = 6.28318531f;
+    const uint32_t ProbeCoefficients = 9;     // L2 SH, LightProbeGrid::CoefficientCount
+    const uint32_t CascadeMapSize = 2048;
+
+    // Layout of the camera buffer in ColorVertex.vs and InstancedVertex.vs
+    struct CameraConstants
+    {
+        XMFLOAT4X4 viewProj;
+        XMFLOAT3 position;
+        float padding;
+    };
+
+    struct FullScreenVertex
+    {
+        float x, y, z, w;
+        float u, v;
+    };
+
+    const SceneVertex CubeVertices[] =
+    {
+        { {-1.0f, -1.0f,  1.0f}, { 0.0f, -1.0f,  0.0f}, {0.0f, 1.0f} },
+        { { 1.0f, -1.0f,  1.0f}, { 0.0f, -1.0f,  0.0f}, {1.0f, 1.0f} },
+        { { 1.0f, -1.0f, -1.0f}, { 0.0f, -1.0f,  0.0f}, {1.0f, 0.0f} },
+        { {-1.0f, -1.0f, -1.0f}, { 0.0f, -1.0f,  0.0f}, {0.0f, 0.0f} },
+
+        { {-1.0f,  1.0f, -1.0f}, { 0.0f,  1.0f,  0.0f}, {0.0f, 1.0f} },
+        { { 1.0f,  1.0f, -1.0f}, { 0.0f,  1.0f,  0.0f}, {1.0f, 1.0f} },
+        { { 1.0f,  1.0f,  1.0f}, { 0.0f,  1.0f,  0.0f}, {1.0f, 0.0f} },
+        { {-1.0f,  1.0f,  1.0f}, { 0.0f,  1.0f,  0.0f}, {0.0f, 0.0f} },
+
+        { { 1.0f, -1.0f, -1.0f}, { 1.0f,  0.0f,  0.0f}, {0.0f, 1.0f} },
+        { { 1.0f, -1.0f,  1.0f}, { 1.0f,  0.0f,  0.0f}, {1.0f, 1.0f} },
+        { { 1.0f,  1.0f,  1.0f}, { 1.0f,  0.0f,  0.0f}, {1.0f, 0.0f} },
+        { { 1.0f,  1.0f, -1.0f}, { 1.0f,  0.0f,  0.0f}, {0.0f, 0.0f} },
+
+        { {-1.0f, -1.0f,  1.0f}, {-1.0f,  0.0f,  0.0f}, {0.0f, 1.0f} },
+        { {-1.0f, -1.0f, -1.0f}, {-1.0f,  0.0f,  0.0f}, {1.0f, 1.0f} },
+        { {-1.0f,  1.0f, -1.0f}, {-1.0f,  0.0f,  0.0f}, {1.0f, 0.0f} },
+        { {-1.0f,  1.0f,  1.0f}, {-1.0f,  0.0f,  0.0f}, {0.0f, 0.0f} },
+
+        { { 1.0f, -1.0f,  1.0f}, { 0.0f,  0.0f,  1.0f}, {0.0f, 1.0f} },
+        { {-1.0f, -1.0f,  1.0f}, { 0.0f,  0.0f,  1.0f}, {1.0f, 1.0f} },
+        { {-1.0f,  1.0f,  1.0f}, { 0.0f,  0.0f,  1.0f}, {1.0f, 0.0f} },
+        { { 1.0f,  1.0f,  1.0f}, { 0.0f,  0.0f,  1.0f}, {0.0f, 0.0f} },
+
+        { {-1.0f, -1.0f, -1.0f}, { 0.0f,  0.0f, -1.0f}, {0.0f, 1.0f} },
+        { { 1.0f, -1.0f, -1.0f}, { 0.0f,  0.0f, -1.0f}, {1.0f, 1.0f} },
+        { { 1.0f,  1.0f, -1.0f}, { 0.0f,  0.0f, -1.0f}, {1.0f, 0.0f} },
+        { {-1.0f,  1.0f, -1.0f}, { 0.0f,  0.0f, -1.0f}, {0.0f, 0.0f} },
+    };
+
+    const uint16_t CubeIndices[] =
+    {
+        0, 2, 1,    0, 3, 2,
+        4, 6, 5,    4, 7, 6,
+        8, 10, 9,   8, 11, 10,
+        12, 14, 13, 12, 15, 14,
+        16, 18, 17, 16, 19, 18,
+        20, 22, 21, 20, 23, 22
+    };
+
+    // Inside faces of a cube around the camera, drawn without an index buffer
+    const float SkyboxVertices[] =
+    {
+        -1.0f, -1.0f, -1.0f,   -1.0f,  1.0f, -1.0f,    1.0f,  1.0f, -1.0f,
+        -1.0f, -1.0f, -1.0f,    1.0f,  1.0f, -1.0f,    1.0f, -1.0f, -1.0f,
+
+         1.0f, -1.0f,  1.0f,    1.0f,  1.0f,  1.0f,   -1.0f,  1.0f,  1.0f,
+         1.0f, -1.0f,  1.0f,   -1.0f,  1.0f,  1.0f,   -1.0f, -1.0f,  1.0f,
+
+        -1.0f, -1.0f,  1.0f,   -1.0f,  1.0f,  1.0f,   -1.0f,  1.0f, -1.0f,
+        -1.0f, -1.0f,  1.0f,   -1.0f,  1.0f, -1.0f,   -1.0f, -1.0f, -1.0f,
+
+         1.0f, -1.0f, -1.0f,    1.0f,  1.0f, -1.0f,    1.0f,  1.0f,  1.0f,
+         1.0f, -1.0f, -1.0f,    1.0f,  1.0f,  1.0f,    1.0f, -1.0f,  1.0f,
+
+        -1.0f,  1.0f, -1.0f,   -1.0f,  1.0f,  1.0f,    1.0f,  1.0f,  1.0f,
+        -1.0f,  1.0f, -1.0f,    1.0f,  1.0f,  1.0f,    1.0f,  1.0f, -1.0f,
+
+        -1.0f, -1.0f,  1.0f,   -1.0f, -1.0f, -1.0f,    1.0f, -1.0f, -1.0f,
+        -1.0f, -1.0f,  1.0f,    1.0f, -1.0f, -1.0f,    1.0f, -1.0f,  1.0f
+    };
+
+    // Parallelogram quad in the xy plane
+    const float QuadVertices[] =
+    {
+        -0.75f, -0.75f, 0.0f,
+        -0.75f,  0.75f, 0.0f,
+         0.75f,  0.75f, 0.0f,
+         0.75f, -0.75f, 0.0f
+    };
+
+    const uint16_t QuadIndices[] = { 0, 1, 2, 0, 2, 3 };
+
+    const FullScreenVertex FullScreenVertices[3] =
+    {
+        { -1.0f, -1.0f, 0.0f, 1.0f,   0.0f,  1.0f },
+        { -1.0f,  3.0f, 0.0f, 1.0f,   0.0f, -1.0f },
+        {  3.0f, -1.0f, 0.0f, 1.0f,   2.0f,  1.0f }
+    };
+
+    // Row-vector matrices, the layout XMMatrix* produces
+    XMFLOAT4X4 Identity()
+    {
+        XMFLOAT4X4 m = {};
+        m._11 = m._22 = m._33 = m._44 = 1.0f;
+        return m;
+    }
+
+    XMFLOAT4X4 Multiply(const XMFLOAT4X4& a, const XMFLOAT4X4& b)
+    {
+        XMFLOAT4X4 result;
+        for (int row = 0; row < 4; row++)
+        {
+            for (int column = 0; column < 4; column++)
+            {
+                float sum = 0.0f;
+                for (int k = 0; k < 4; k++)
+                    sum += a.m[row][k] * b.m[k][column];
+                result.m[row][column] = sum;
+            }
+        }
+        return result;
+    }
+
+    XMFLOAT4X4 Transposed(const XMFLOAT4X4& m)
+    {
+        XMFLOAT4X4 result;
+        for (int row = 0; row < 4; row++)
+        {
+            for (int column = 0; column < 4; column++)
+                result.m[column][row] = m.m[row][column];
+        }
+        return result;
+    }
+
+    XMFLOAT4X4 Scaling(float scale)
+    {
+        XMFLOAT4X4 m = Identity();
+        m._11 = m._22 = m._33 = scale;
+        return m;
+    }
+
+    XMFLOAT4X4 Translation(float x, float y, float z)
+    {
+        XMFLOAT4X4 m = Identity();
+        m._41 = x;
+        m._42 = y;
+        m._43 = z;
+        return m;
+    }
+
+    XMFLOAT4X4 RotationX(float angle)
+    {
+        XMFLOAT4X4 m = Identity();
+        m._22 = std::cos(angle);
+        m._23 = std::sin(angle);
+        m._32 = -m._23;
+        m._33 = m._22;
+        return m;
+    }
+
+    XMFLOAT4X4 RotationY(float angle)
+    {
+        XMFLOAT4X4 m = Identity();
+        m._11 = std::cos(angle);
+        m._13 = -std::sin(angle);
+        m._31 = -m._13;
+        m._33 = m._11;
+        return m;
+    }
+
+    XMFLOAT3 Normalize3(const XMFLOAT3& v)
+    {
+        float length = std::sqrt(v.x * v.x + v.y * v.y + v.z * v.z);
+        return XMFLOAT3(v.x / length, v.y / length, v.z / length);
+    }
+
+    XMFLOAT3 Cross3(const XMFLOAT3& a, const XMFLOAT3& b)
+    {
+        return XMFLOAT3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+    }
+
+    float Dot3(const XMFLOAT3& a, const XMFLOAT3& b)
+    {
+        return a.x * b.x + a.y * b.y + a.z * b.z;
+    }
+
+    // XMMatrixLookToLH with +y up
+    XMFLOAT4X4 LookToLH(const XMFLOAT3& eye, const XMFLOAT3& direction)
+    {
+        XMFLOAT3 z = Normalize3(direction);
+        XMFLOAT3 x = Normalize3(Cross3(XMFLOAT3(0.0f, 1.0f, 0.0f), z));
+        XMFLOAT3 y = Cross3(z, x);
+
+        XMFLOAT4X4 m = Identity();
+        m._11 = x.x; m._21 = x.y; m._31 = x.z;
+        m._12 = y.x; m._22 = y.y; m._32 = y.z;
+        m._13 = z.x; m._23 = z.y; m._33 = z.z;
+        m._41 = -Dot3(x, eye);
+        m._42 = -Dot3(y, eye);
+        m._43 = -Dot3(z, eye);
+        return m;
+    }
+
+    XMFLOAT4X4 PerspectiveFovLH(float fovY, float aspect, float nearZ, float farZ)
+    {
+        float yScale = 1.0f / std::tan(fovY * 0.5f);
+        XMFLOAT4X4 m = {};
+        m._11 = yScale / aspect;
+        m._22 = yScale;
+        m._33 = farZ / (farZ - nearZ);
+        m._34 = 1.0f;
+        m._43 = -nearZ * farZ / (farZ - nearZ);
+        return m;
+    }
+
+    XMFLOAT3 GetTranslation(const XMFLOAT4X4& m)
+    {
+        return XMFLOAT3(m._41, m._42, m._43);
+    }
+
+    float Distance(const XMFLOAT3& a, const XMFLOAT3& b)
+    {
+        XMFLOAT3 d(a.x - b.x, a.y - b.y, a.z - b.z);
+        return std::sqrt(Dot3(d, d));
+    }
+}
+
+const uint32_t SceneRenderer::MaxInstances;
+const uint32_t SceneRenderer::MaxExtraLights;
+const uint32_t SceneRenderer::MaxPointLights;
+const uint32_t SceneRenderer::MaxShadowedLights;
+const uint32_t SceneRenderer::MaxBatchInstances;
+
+SceneRenderer::SceneRenderer()
+    : m_pipelines(),
+    m_settings(),
+    m_textures(),
+    m_environment(),
+    m_cubeVB(InvalidBackendHandle),
+    m_cubeIB(InvalidBackendHandle),
+    m_skyboxVB(InvalidBackendHandle),
+    m_quadVB(InvalidBackendHandle),
+    m_quadIB(InvalidBackendHandle),
+    m_fullScreenVB(InvalidBackendHandle),
+    m_cameraBuffer(InvalidBackendHandle),
+    m_skyboxBuffer(InvalidBackendHandle),
+    m_batchInstanceBuffer(InvalidBackendHandle),
+    m_clusterBuffer(InvalidBackendHandle),
+    m_pointLightBuffer(InvalidBackendHandle),
+    m_clusterRangeBuffer(InvalidBackendHandle),
+    m_lightIndexBuffer(InvalidBackendHandle),
+    m_instanceLightBuffer(InvalidBackendHandle),
+    m_instanceListBuffer(InvalidBackendHandle),
+    m_ambientBuffer(InvalidBackendHandle),
+    m_probeBuffer(InvalidBackendHandle),
+    m_reflectionProbeBuffer(InvalidBackendHandle),
+    m_cascadeBuffer(InvalidBackendHandle),
+    m_shadowLightBuffer(InvalidBackendHandle),
+    m_width(1),
+    m_height(1),
+    m_cameraPosition(0.0f, 0.0f, -10.0f),
+    m_lrAngle(0.0f),
+    m_udAngle(0.0f),
+    m_view(Identity()),
+    m_proj(Identity()),
+    m_viewProj(Identity()),
+    m_skyboxView(Identity()),
+    m_cubeAngle(0.0f),
+    m_parallelogramAngle(0.0f),
+    m_sceneLights(),
+    m_shadowCacheStale(false),
+    m_batchDrawCalls(0),
+    m_colorFormat(0)
+{
+    m_orbitAngles[0] = Pi / 2.0f;
+    m_orbitAngles[1] = 0.0f;
+    for (XMFLOAT4& plane : m_frustumPlanes)
+        plane = XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
+
+    m_settings.animate = true;
+    m_settings.useShadows = true;
+    m_settings.shadowFacesPerFrame = 36;
+    m_settings.sunAzimuth = 0.6f;
+    m_settings.sunElevation = 0.9f;
+    m_settings.cascadeCount = 4;
+    m_settings.cascadeSplitLambda = 0.75f;
+    m_settings.useLightProbes = true;
+    m_settings.useReflectionProbes = true;
+    m_settings.ambientIntensity = 0.3f;
+    m_settings.reflectionIntensity = 0.3f;
+    m_settings.reflectionRoughness = 0.5f;
+}
+
+SceneMesh SceneRenderer::GetCubeMesh()
+{
+    SceneMesh mesh = { &CubeVertices[0].xyz.x, sizeof(SceneVertex) / sizeof(float),
+        static_cast<uint32_t>(sizeof(CubeVertices) / sizeof(SceneVertex)), CubeIndices,
+        static_cast<uint32_t>(sizeof(CubeIndices) / sizeof(uint16_t)) };
+    return mesh;
+}
+
+SceneMesh SceneRenderer::GetSkyboxMesh()
+{
+    SceneMesh mesh = { SkyboxVertices, 3, static_cast<uint32_t>(sizeof(SkyboxVertices) / (sizeof(float) * 3)), nullptr, 0 };
+    return mesh;
+}
+
+SceneMesh SceneRenderer::GetQuadMesh()
+{
+    SceneMesh mesh = { QuadVertices, 3, static_cast<uint32_t>(sizeof(QuadVertices) / (sizeof(float) * 3)), QuadIndices,
+        static_cast<uint32_t>(sizeof(QuadIndices) / sizeof(uint16_t)) };
+    return mesh;
+}
+
+bool SceneRenderer::Init(RenderBackend& backend, const ScenePipelines& pipelines, const SceneTargets& targets)
+{
+    m_pipelines = pipelines;
+    m_colorFormat = targets.colorFormat;
+
+    std::vector<BackendHandle> created;
+    auto create = [&backend, &created](BufferKind kind, uint32_t size, bool dynamic, uint32_t stride, const void* pData)
+    {
+        BufferDesc desc = { kind, size, dynamic, stride };
+        BackendHandle buffer = backend.CreateBuffer(desc, pData);
+        created.push_back(buffer);
+        return buffer;
+    };
+
+    m_cubeVB = create(BufferKind::Vertex, sizeof(CubeVertices), false, 0, CubeVertices);
+    m_cubeIB = create(BufferKind::Index, sizeof(CubeIndices), false, 0, CubeIndices);
+    m_skyboxVB = create(BufferKind::Vertex, sizeof(SkyboxVertices), false, 0, SkyboxVertices);
+    m_quadVB = create(BufferKind::Vertex, sizeof(QuadVertices), false, 0, QuadVertices);
+    m_quadIB = create(BufferKind::Index, sizeof(QuadIndices), false, 0, QuadIndices);
+    m_fullScreenVB = create(BufferKind::Vertex, sizeof(FullScreenVertices), false, 0, FullScreenVertices);
+    m_cameraBuffer = create(BufferKind::Constant, sizeof(CameraConstants), true, 0, nullptr);
+    m_skyboxBuffer = create(BufferKind::Constant, sizeof(CameraConstants), true, 0, nullptr);
+    m_batchInstanceBuffer = create(BufferKind::Constant, sizeof(InstanceColorData) * MaxBatchInstances, true, 0, nullptr);
+
+    // Lights, cluster ranges and the shared index list are structured buffers for the pixel shaders
+    m_clusterBuffer = create(BufferKind::Constant, sizeof(ClusterConstants), true, 0, nullptr);
+    m_pointLightBuffer = create(BufferKind::Structured, sizeof(PointLight) * MaxPointLights, true, sizeof(PointLight), nullptr);
+    m_clusterRangeBuffer = create(BufferKind::Structured, sizeof(uint32_t) * 2 * LightClusterGrid::ClusterCount, true,
+        sizeof(uint32_t) * 2, nullptr);
+    m_lightIndexBuffer = create(BufferKind::Structured, sizeof(uint32_t) * LightClusterGrid::MaxLightIndices, true,
+        sizeof(uint32_t), nullptr);
+    m_instanceLightBuffer = create(BufferKind::Constant, sizeof(InstanceLightConstants), true, 0, nullptr);
+    m_instanceListBuffer = create(BufferKind::Structured, sizeof(uint32_t) * MaxInstances * InstanceLightLists::ListStride, true,
+        sizeof(uint32_t), nullptr);
+
+    // The probe flag and nine coefficients per cube; probe and mip count, then a probe pair and weight per cube
+    m_ambientBuffer = create(BufferKind::Constant, sizeof(AmbientConstants), true, 0, nullptr);
+    m_probeBuffer = create(BufferKind::Constant, sizeof(XMFLOAT4) * (1 + MaxInstances * ProbeCoefficients), true, 0, nullptr);
+    m_reflectionProbeBuffer = create(BufferKind::Constant, sizeof(XMFLOAT4) * (1 + MaxInstances), true, 0, nullptr);
+    m_cascadeBuffer = create(BufferKind::Constant, sizeof(CascadeConstants), true, 0, nullptr);
+    m_shadowLightBuffer = create(BufferKind::Structured, sizeof(ShadowLightData) * MaxShadowedLights, true,
+        sizeof(ShadowLightData), nullptr);
+
+    CubePassResources cube = {};
+    cube.vertexBuffer = m_cubeVB;
+    cube.indexBuffer = m_cubeIB;
+    cube.vertexStride = sizeof(SceneVertex);
+    cube.indexCount = sizeof(CubeIndices) / sizeof(uint16_t);
+    cube.instanceBuffer = create(BufferKind::Constant, sizeof(CubeInstanceData) * MaxInstances, false, 0, nullptr);
+    cube.cameraBuffer = m_cameraBuffer;
+    // The vertex shader reads the culled ids straight from this buffer on both paths
+    cube.visibleIdsBuffer = create(BufferKind::Structured, sizeof(uint32_t) * MaxInstances, false, sizeof(uint32_t), nullptr);
+    cube.cullPipeline = pipelines.cull;
+    if (cube.cullPipeline != InvalidBackendHandle)
+    {
+        // The cubes rotate, so the world matrices for the compute shader are rewritten every frame
+        cube.frustumBuffer = create(BufferKind::Constant, sizeof(XMFLOAT4) * 6, true, 0, nullptr);
+        cube.cullInstanceBuffer = create(BufferKind::Structured, sizeof(CubeInstanceData) * MaxInstances, true,
+            sizeof(CubeInstanceData), nullptr);
+        cube.argumentsBuffer = create(BufferKind::Arguments, sizeof(uint32_t) * 5, false, 0, nullptr);
+        for (uint32_t i = 0; i < FrameManager::MaxFramesInFlight; i++)
+        {
+            cube.argumentsReadback[i] = create(BufferKind::Readback, sizeof(uint32_t) * 5, false, 0, nullptr);
+            cube.idsReadback[i] = create(BufferKind::Readback, sizeof(uint32_t) * MaxInstances, false, 0, nullptr);
+        }
+    }
+    m_cubePass.SetResources(cube);
+
+    // Atlas tiles and cascades draw the same cubes with a depth only pipeline
+    ShadowPassResources shadow = {};
+    shadow.clearPipeline = pipelines.shadowClear;
+    shadow.casterPipeline = pipelines.shadowCaster;
+    shadow.vertexBuffer = cube.vertexBuffer;
+    shadow.indexBuffer = cube.indexBuffer;
+    shadow.vertexStride = cube.vertexStride;
+    shadow.indexCount = cube.indexCount;
+    shadow.instanceBuffer = cube.instanceBuffer;
+    shadow.faceBuffer = create(BufferKind::Constant, sizeof(XMFLOAT4X4), true, 0, nullptr);
+    shadow.atlasTarget = targets.shadowAtlas;
+    for (uint32_t i = 0; i < CascadedShadows::MaxCascades; i++)
+        shadow.cascadeTargets[i] = targets.cascades[i];
+    shadow.cascadeSize = targets.cascadeSize;
+    m_shadowPass.SetResources(shadow);
+    m_shadowPass.SetMaxInstances(MaxInstances);
+    m_shadowPass.SetViewportSize(m_width, m_height);
+    // Cached tiles are only redrawn when stale, so the maps start out at the far plane
+    backend.ClearDepth(targets.shadowAtlas, 1.0f);
+    for (uint32_t i = 0; i < CascadedShadows::MaxCascades; i++)
+        backend.ClearDepth(targets.cascades[i], 1.0f);
+
+    CascadeSettings cascadeSettings = m_cascades.GetSettings();
+    cascadeSettings.mapSize = targets.cascadeSize > 0 ? targets.cascadeSize : CascadeMapSize;
+    m_cascades.SetSettings(cascadeSettings);
+    m_batcher.SetMaxInstancesPerBatch(MaxBatchInstances);
+
+    // The centre cube, then an inner ring of 10 and an outer ring of 12
+    m_instances.clear();
+    const uint32_t ringCounts[2] = { 10, 12 };
+    const float ringRadii[2] = { 4.0f, 9.5f };
+    CubeInstanceData center = {};
+    center.model = Scaling(GetCubeScale());
+    m_instances.push_back(center);
+    for (uint32_t ring = 0; ring < 2; ring++)
+    {
+        for (uint32_t i = 0; i < ringCounts[ring]; i++)
+        {
+            float angle = TwoPi * i / ringCounts[ring];
+            CubeInstanceData instance = {};
+            instance.model = Multiply(Scaling(GetCubeScale()),
+                Translation(ringRadii[ring] * std::cos(angle), 0.0f, ringRadii[ring] * std::sin(angle)));
+            instance.texInd = i % 2;
+            instance.lightmapSlice = static_cast<uint32_t>(m_instances.size());
+            m_instances.push_back(instance);
+        }
+    }
+    for (CubeInstanceData& instance : m_instances)
+        instance.countInstance = MaxInstances;
+    m_instanceIds.resize(m_instances.size());
+    std::iota(m_instanceIds.begin(), m_instanceIds.end(), 0u);
+
+    // The extra lights are spread the same way every run, so measurements repeat
+    m_extraLights.resize(MaxExtraLights);
+    uint32_t seed = 2025;
+    auto next = [&seed]()
+    {
+        seed = seed * 1664525u + 1013904223u;
+        return (seed >> 8) * (1.0f / 16777216.0f);
+    };
+    for (PointLight& light : m_extraLights)
+    {
+        light = {};
+        light.Position = XMFLOAT3(next() * 24.0f - 12.0f, next() * 6.0f - 3.0f, next() * 24.0f - 12.0f);
+        light.Range = 0.5f + next();
+        light.Color = XMFLOAT3(0.2f + next() * 0.8f, 0.2f + next() * 0.8f, 0.2f + next() * 0.8f);
+        light.Intensity = 0.5f;
+    }
+    m_pointLights.reserve(MaxPointLights);
+    m_probeConstants.resize(1 + MaxInstances * ProbeCoefficients);
+
+    return std::find(created.begin(), created.end(), InvalidBackendHandle) == created.end();
+}
+
+void SceneRenderer::SetThreadPool(ThreadPool* pPool)
+{
+    m_lightClusters.SetThreadPool(pPool);
+    m_instanceLights.SetThreadPool(pPool);
+}
+
+void SceneRenderer::SetViewport(uint32_t width, uint32_t height)
+{
+    m_width = width;
+    m_height = height;
+    m_shadowPass.SetViewportSize(width, height);
+}
+
+void SceneRenderer::SetCamera(const XMFLOAT3& position, float lrAngle, float udAngle)
+{
+    m_cameraPosition = position;
+    m_lrAngle = lrAngle;
+    m_udAngle = udAngle;
+}
+
+void SceneRenderer::Update()
+{
+    PROFILE_SCOPE("Update");
+
+    UpdateCamera();
+    UpdateFrustum();
+
+    if (m_settings.animate)
+        m_cubeAngle += 0.01f;
+    if (m_cubeAngle > TwoPi)
+        m_cubeAngle -= TwoPi;
+
+    XMFLOAT4X4 scaleRotation = Multiply(Scaling(GetCubeScale()), RotationY(m_cubeAngle));
+    for (CubeInstanceData& instance : m_instances)
+    {
+        XMFLOAT3 position = GetTranslation(instance.model);
+        instance.model = Multiply(scaleRotation, Translation(position.x, position.y, position.z));
+    }
+
+    UpdateLights();
+    UpdateShadows();
+    UpdateCascades();
+
+    m_batcher.Clear();
+    QueueMarkers();
+    QueueParallelograms();
+    m_batcher.Build();
+}
+
+void SceneRenderer::UpdateCamera()
+{
+    // The look direction turns with the camera; behind the origin the rotations apply the other way round
+    XMFLOAT4X4 rotation = m_cameraPosition.z <= 0.0f
+        ? Multiply(RotationY(m_lrAngle), RotationX(m_udAngle))
+        : Multiply(RotationX(m_udAngle), RotationY(m_lrAngle));
+    m_view = LookToLH(m_cameraPosition, XMFLOAT3(rotation._31, rotation._32, rotation._33));
+
+    float aspect = m_height > 0 ? static_cast<float>(m_width) / static_cast<float>(m_height) : 1.0f;
+    m_proj = PerspectiveFovLH(Pi / 4.0f, aspect, 0.1f, 100.0f);
+    m_viewProj = Multiply(m_view, m_proj);
+    m_skyboxView = Multiply(RotationY(-m_lrAngle), RotationX(-m_udAngle));
+}
+
+void SceneRenderer::UpdateFrustum()
+{
+    // Left, right, bottom, top from w + x, w - x, w + y and w - y, then near z >= 0 and far w - z >= 0
+    const XMFLOAT4X4& m = m_viewProj;
+    for (int axis = 0; axis < 2; axis++)
+    {
+        m_frustumPlanes[axis * 2] = XMFLOAT4(m.m[0][3] + m.m[0][axis], m.m[1][3] + m.m[1][axis],
+            m.m[2][3] + m.m[2][axis], m.m[3][3] + m.m[3][axis]);
+        m_frustumPlanes[axis * 2 + 1] = XMFLOAT4(m.m[0][3] - m.m[0][axis], m.m[1][3] - m.m[1][axis],
+            m.m[2][3] - m.m[2][axis], m.m[3][3] - m.m[3][axis]);
+    }
+    m_frustumPlanes[4] = XMFLOAT4(m._13, m._23, m._33, m._43);
+    m_frustumPlanes[5] = XMFLOAT4(m._14 - m._13, m._24 - m._23, m._34 - m._33, m._44 - m._43);
+
+    for (XMFLOAT4& plane : m_frustumPlanes)
+    {
+        float length = std::sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+        plane = XMFLOAT4(plane.x / length, plane.y / length, plane.z / length, plane.w / length);
+    }
+}
+
+bool SceneRenderer::IsInFrustum(const XMFLOAT3& center, float extent) const
+{
+    for (const XMFLOAT4& plane : m_frustumPlanes)
+    {
+        float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+        if (distance + extent * (std::fabs(plane.x) + std::fabs(plane.y) + std::fabs(plane.z)) < 0.0f)
+            return false;
+    }
+    return true;
+}
+
+void SceneRenderer::UpdateLights()
+{
+    PROFILE_SCOPE("Light Clusters");
+
+    for (int i = 0; i < 2; i++)
+    {
+        if (m_settings.animate)
+            m_orbitAngles[i] += 0.01f;
+        if (m_orbitAngles[i] > TwoPi)
+            m_orbitAngles[i] -= TwoPi;
+    }
+
+    const float a1 = m_orbitAngles[0];
+    const float a2 = m_orbitAngles[1];
+    m_sceneLights[0].Position = XMFLOAT3(0.0f, 2.0f * std::cos(a1), 2.0f * std::sin(-a1));
+    m_sceneLights[0].Range = 3.0f;
+    m_sceneLights[0].Color = XMFLOAT3(1.0f, 1.0f, 1.0f);
+    m_sceneLights[1].Position = XMFLOAT3(2.0f * std::cos(a2), 0.0f, 2.0f * std::sin(a2));
+    m_sceneLights[1].Range = 3.0f;
+    m_sceneLights[1].Color = XMFLOAT3(1.0f, 1.0f, 0.13f);
+    m_sceneLights[2].Position = XMFLOAT3(8.0f * std::cos(a1), 0.0f, 8.0f * std::sin(-a1));
+    m_sceneLights[2].Range = 5.0f;
+    m_sceneLights[2].Color = XMFLOAT3(1.0f, 1.0f, 1.0f);
+    for (PointLight& light : m_sceneLights)
+        light.Intensity = 1.0f;
+
+    uint32_t extraCount = std::min(m_settings.extraLightCount, MaxExtraLights);
+    m_pointLights.assign(m_sceneLights, m_sceneLights + 3);
+    m_pointLights.insert(m_pointLights.end(), m_extraLights.begin(), m_extraLights.begin() + extraCount);
+    m_lightClusters.Build(m_view, m_proj, m_width, m_height, m_pointLights.data(), sizeof(PointLight),
+        static_cast<uint32_t>(m_pointLights.size()));
+}
+
+void SceneRenderer::UpdateShadows()
+{
+    PROFILE_SCOPE("Shadow Cache");
+
+    for (PointLight& light : m_pointLights)
+        light.ShadowIndex = -1;
+
+    // Only the cubes cast shadows: the bounding sphere of a cube with side 2 * scale.
+    // The sun cascades need the list too, so it is built even without point light shadows
+    m_shadowCasters.resize(m_instances.size());
+    for (size_t i = 0; i < m_instances.size(); i++)
+    {
+        ShadowCaster& caster = m_shadowCasters[i];
+        caster.transform = m_instances[i].model;
+        caster.center = GetTranslation(caster.transform);
+        caster.radius = GetCubeScale() * 1.7320508f;
+    }
+
+    // While the pass does not run the cache misses the scene moving, so everything is redrawn later
+    if (!m_settings.useShadows || m_settings.useSoftware)
+    {
+        m_shadowCacheStale = true;
+        return;
+    }
+    if (m_shadowCacheStale)
+    {
+        m_shadowCache.Invalidate();
+        m_shadowCacheStale = false;
+    }
+
+    // A light keeps its index from frame to frame, which keys the cache
+    m_shadowLights.resize(m_pointLights.size());
+    for (size_t i = 0; i < m_pointLights.size(); i++)
+    {
+        ShadowLightDesc& desc = m_shadowLights[i];
+        desc = {};
+        desc.id = static_cast<uint32_t>(i);
+        desc.type = ShadowLightType::Omni;
+        desc.position = m_pointLights[i].Position;
+        desc.range = m_pointLights[i].Range;
+    }
+
+    ShadowCacheSettings settings = m_shadowCache.GetSettings();
+    settings.maxShadowedLights = MaxShadowedLights;
+    settings.maxFacesPerFrame = m_settings.shadowFacesPerFrame;
+    m_shadowCache.SetSettings(settings);
+    m_shadowCache.Update(m_view, m_proj, m_height, m_shadowLights.data(), static_cast<uint32_t>(m_shadowLights.size()),
+        m_shadowCasters.data(), static_cast<uint32_t>(m_shadowCasters.size()));
+
+    const std::vector<int32_t>& shadowIndices = m_shadowCache.GetShadowIndices();
+    for (size_t i = 0; i < m_pointLights.size(); i++)
+        m_pointLights[i].ShadowIndex = shadowIndices[i];
+}
+
+void SceneRenderer::UpdateCascades()
+{
+    if (!m_settings.useSun || m_settings.useSoftware)
+        return;
+
+    CascadeSettings settings = m_cascades.GetSettings();
+    settings.cascadeCount = m_settings.cascadeCount;
+    settings.splitLambda = m_settings.cascadeSplitLambda;
+    m_cascades.SetSettings(settings);
+
+    // Light travels away from the sun
+    float elevation = m_settings.sunElevation;
+    float azimuth = m_settings.sunAzimuth;
+    XMFLOAT3 lightDirection(-std::cos(elevation) * std::sin(azimuth), -std::sin(elevation), -std::cos(elevation) * std::cos(azimuth));
+    m_cascades.Update(m_view, m_proj, lightDirection, m_shadowCasters.data(), static_cast<uint32_t>(m_shadowCasters.size()));
+}
+
+void SceneRenderer::QueueMarkers()
+{
+    // The lights are drawn as small cubes with one instanced call in RenderBatches
+    for (const PointLight& light : m_sceneLights)
+    {
+        DrawItem marker = {};
+        marker.key = { MeshCube, ShaderLightMarker, StateOpaque };
+        marker.instance.model = Transposed(Multiply(Scaling(0.1f), Translation(light.Position.x, light.Position.y, light.Position.z)));
+        marker.instance.color = XMFLOAT4(light.Color.x, light.Color.y, light.Color.z, 1.0f);
+        marker.transparent = false;
+        m_batcher.Add(marker);
+    }
+}
+
+void SceneRenderer::QueueParallelograms()
+{
+    m_parallelogramAngle += 0.015f;
+
+    struct Parallelogram
+    {
+        XMFLOAT3 position;
+        XMFLOAT4 color;
+    };
+    const Parallelogram parallelograms[2] =
+    {
+        { XMFLOAT3(std::sin(m_parallelogramAngle) * 2.0f, 1.0f, -2.0f), XMFLOAT4(0.2f, 0.0f, 0.7f, 0.5f) },
+        { XMFLOAT3(-std::sin(m_parallelogramAngle) * 2.0f, 1.0f, -3.0f), XMFLOAT4(0.7f, 0.0f, 0.5f, 0.5f) }
+    };
+
+    // DrawBatcher::Build sorts them back to front by the nearest corner
+    for (const Parallelogram& parallelogram : parallelograms)
+    {
+        const XMFLOAT3& p = parallelogram.position;
+        float minDepth = FLT_MAX;
+        for (uint32_t corner = 0; corner < 4; corner++)
+        {
+            XMFLOAT3 world(QuadVertices[corner * 3] + p.x, QuadVertices[corner * 3 + 1] + p.y, QuadVertices[corner * 3 + 2] + p.z);
+            minDepth = std::min(minDepth, Distance(world, m_cameraPosition));
+        }
+
+        DrawItem item = {};
+        item.key = { MeshQuad, ShaderParallelogram, StateTransparent };
+        item.instance.model = Transposed(Translation(p.x, p.y, p.z));
+        item.instance.color = parallelogram.color;
+        item.transparent = true;
+        item.sortDepth = minDepth;
+        m_batcher.Add(item);
+    }
+}
+
+bool SceneRenderer::BuildGraph(RenderBackend& backend, const FrameManager& frames, SceneHost& host)
+{
+    RenderBackend* pBackend = &backend;
+    const FrameManager* pFrames = &frames;
+    SceneHost* pHost = &host;
+
+    // Without the post effect the scene goes straight into the back buffer
+    m_graph.Reset();
+    RenderGraph::ResourceHandle backBuffer = m_graph.ImportTexture("BackBuffer");
+    RenderGraph::ResourceHandle sceneColor = backBuffer;
+    bool gpuNegative = m_settings.useNegative && !m_settings.useSoftware;
+    if (gpuNegative)
+    {
+        RenderGraph::TextureDesc sceneDesc = { m_width, m_height, m_colorFormat };
+        sceneColor = m_graph.CreateTexture("SceneColor", sceneDesc);
+    }
+
+    if (m_settings.useSoftware)
+    {
+        // The software rasterizer applies the negative itself and copies the frame into the back buffer
+        RenderGraph::PassHandle softwarePass = m_graph.AddPass("Software Scene", [pHost]() {
+            pHost->RenderSoftware();
+            });
+        m_graph.Write(softwarePass, backBuffer);
+    }
+    else
+    {
+        // The atlas and the cascades live across frames, so they are imported rather than created.
+        // The graph never culls imported resources, so disabled passes are simply not added
+        RenderGraph::ResourceHandle shadowAtlas = RenderGraph::Invalid;
+        if (m_settings.useShadows)
+        {
+            shadowAtlas = m_graph.ImportTexture("ShadowAtlas");
+            RenderGraph::PassHandle shadowPass = m_graph.AddPass("Shadows", [this, pBackend]() {
+                RenderShadows(*pBackend);
+                });
+            m_graph.Write(shadowPass, shadowAtlas);
+        }
+
+        RenderGraph::ResourceHandle sunCascades = RenderGraph::Invalid;
+        if (m_settings.useSun && m_cascades.GetCascadeCount() > 0)
+        {
+            sunCascades = m_graph.ImportTexture("SunCascades");
+            RenderGraph::PassHandle cascadePass = m_graph.AddPass("Sun Cascades", [this, pBackend]() {
+                RenderCascades(*pBackend);
+                });
+            m_graph.Write(cascadePass, sunCascades);
+        }
+
+        RenderGraph::PassHandle scenePass = m_graph.AddPass("Scene", [this, pBackend, pFrames, pHost, sceneColor]() {
+            RenderScene(*pBackend, *pFrames, pHost->GetTarget(sceneColor, true));
+            });
+        if (shadowAtlas != RenderGraph::Invalid)
+            m_graph.Read(scenePass, shadowAtlas);
+        if (sunCascades != RenderGraph::Invalid)
+            m_graph.Read(scenePass, sunCascades);
+        m_graph.Write(scenePass, sceneColor);
+    }
+
+    if (gpuNegative)
+    {
+        RenderGraph::PassHandle negativePass = m_graph.AddPass("Negative", [this, pBackend, pHost, sceneColor, backBuffer]() {
+            pBackend->BindTarget(pHost->GetTarget(backBuffer, false));
+            RenderPostProcess(*pBackend, pHost->GetTexture(sceneColor));
+            });
+        m_graph.Read(negativePass, sceneColor);
+        m_graph.Write(negativePass, backBuffer);
+    }
+
+    RenderGraph::PassHandle uiPass = m_graph.AddPass("ImGui", [pBackend, pHost, backBuffer]() {
+        pBackend->BindTarget(pHost->GetTarget(backBuffer, false));
+        pHost->RenderUi();
+        });
+    m_graph.Write(uiPass, backBuffer);
+
+    return m_graph.Compile();
+}
+
+void SceneRenderer::RenderShadows(RenderBackend& backend)
+{
+    PROFILE_SCOPE("Shadows");
+    BackendScope gpuScope(backend, "Shadows");
+
+    // The atlas is written as a depth buffer and must not stay bound to the pixel shader
+    backend.BindTexture(ShaderStage::Pixel, 7, InvalidBackendHandle);
+
+    const std::vector<ShadowLightData>& shadowData = m_shadowCache.GetShadowData();
+    if (!shadowData.empty())
+        backend.UpdateBuffer(m_shadowLightBuffer, shadowData.data(), static_cast<uint32_t>(sizeof(ShadowLightData) * shadowData.size()));
+
+    // Only the faces the cache marked stale are drawn
+    m_shadowPass.RenderJobs(backend, m_shadowCache.GetJobs(), m_shadowCache.GetJobCasters(), m_shadowCasters.data());
+}
+
+void SceneRenderer::RenderCascades(RenderBackend& backend)
+{
+    PROFILE_SCOPE("Sun Cascades");
+    BackendScope gpuScope(backend, "Sun Cascades");
+
+    backend.BindTexture(ShaderStage::Pixel, 10, InvalidBackendHandle);
+    m_shadowPass.RenderCascades(backend, m_cascades, m_shadowCasters.data());
+}
+
+void SceneRenderer::RenderScene(RenderBackend& backend, const FrameManager& frames, BackendHandle target)
+{
+    PROFILE_SCOPE("Scene");
+
+    const float backgroundColor[4] = { 0.48f, 0.57f, 0.48f, 1.0f };
+    backend.ClearColor(target, backgroundColor);
+    backend.ClearDepth(target, 1.0f);
+    backend.BindTarget(target);
+
+    RenderSkybox(backend);
+    RenderCubes(backend, frames);
+    RenderBatches(backend);
+
+    backend.BindTexture(ShaderStage::Pixel, 0, InvalidBackendHandle);
+}
+
+void SceneRenderer::RenderSkybox(RenderBackend& backend)
+{
+    PROFILE_SCOPE("Skybox");
+    BackendScope gpuScope(backend, "Skybox");
+
+    XMFLOAT4X4 viewProj = Transposed(Multiply(m_skyboxView, m_proj));
+    backend.UpdateBuffer(m_skyboxBuffer, &viewProj, sizeof(viewProj));
+
+    backend.BindPipeline(m_pipelines.skybox);
+    backend.BindVertexBuffer(m_skyboxVB, sizeof(float) * 3);
+    backend.BindConstantBuffer(ShaderStage::Vertex, 0, m_skyboxBuffer);
+    backend.BindTexture(ShaderStage::Pixel, 0, m_textures.skybox);
+    backend.Draw(GetSkyboxMesh().vertexCount);
+}
+
+void SceneRenderer::RenderCubes(RenderBackend& backend, const FrameManager& frames)
+{
+    PROFILE_SCOPE("Cubes");
+    BackendScope gpuScope(backend, "Cubes");
+
+    CameraConstants camera = {};
+    camera.viewProj = Transposed(m_viewProj);
+    camera.position = m_cameraPosition;
+    backend.UpdateBuffer(m_cameraBuffer, &camera, sizeof(camera));
+
+    // Materials and lighting of the pixel shader; the cube pipeline sets the shaders and states
+    backend.BindTexture(ShaderStage::Pixel, 0, m_textures.diffuse);
+    backend.BindTexture(ShaderStage::Pixel, 1, m_textures.normal);
+    backend.BindTexture(ShaderStage::Pixel, 5, m_textures.lightmaps);
+    // The light lists stay bound for the parallelograms in RenderBatches too
+    UploadLightClusters(backend);
+    UploadAmbientLighting(backend);
+    UploadCascades(backend);
+    backend.BindTexture(ShaderStage::Pixel, 7, m_textures.shadowAtlas);
+    backend.BindStructuredBuffer(ShaderStage::Pixel, 8, m_shadowLightBuffer);
+    backend.BindSampler(ShaderStage::Pixel, 1, m_pipelines.shadowSampler);
+    backend.BindTexture(ShaderStage::Pixel, 10, m_textures.cascades);
+    backend.BindConstantBuffer(ShaderStage::Pixel, 6, m_cascadeBuffer);
+
+    // Every cube's data is stored in id order and the vertex shader takes the id from the
+    // visible list, so the pixel shader tables are indexed by id as well. Last frame's visible
+    // ids would leave a cube that just came into view without its row, so all cubes get one
+    uint32_t count = static_cast<uint32_t>(m_instances.size());
+    m_cubePass.Upload(backend, m_instances.data(), count, MaxInstances);
+    UploadInstanceProbes(backend, m_instanceIds.data(), count);
+    UploadInstanceLights(backend, m_instanceIds.data(), count);
+    UploadReflectionProbes(backend, m_instanceIds.data(), count);
+
+    {
+        PROFILE_SCOPE("Culling Dispatch");
+        BackendScope cullingScope(backend, "Culling Dispatch");
+        m_cubePass.Cull(backend, m_frustumPlanes, GetCubeScale() * 0.95f);
+    }
+
+    // The culling result stays on the GPU and is drawn in this frame. The CPU reads the copy of
+    // the frame that used this slot before, which the FrameManager already waited for
+    {
+        PROFILE_SCOPE("Culling Readback");
+        m_cubePass.Readback(backend, frames);
+    }
+
+    bool baked = m_settings.useBakedLighting && m_textures.lightmaps != InvalidBackendHandle;
+    m_cubePass.Draw(backend, baked ? m_pipelines.cubeLightmap : m_pipelines.cube);
+}
+
+void SceneRenderer::RenderBatches(RenderBackend& backend)
+{
+    PROFILE_SCOPE("Batches");
+    BackendScope gpuScope(backend, "Batches");
+
+    backend.BindConstantBuffer(ShaderStage::Vertex, 1, m_cameraBuffer);
+    m_batchDrawCalls = m_batcher.Submit(backend, m_batchInstanceBuffer,
+        [this](const DrawKey& key) { return ResolveBatchKey(key); });
+}
+
+void SceneRenderer::RenderPostProcess(RenderBackend& backend, BackendHandle source)
+{
+    PROFILE_SCOPE("PostProcess");
+    BackendScope gpuScope(backend, "PostProcess");
+
+    backend.BindPipeline(m_pipelines.postProcess);
+    backend.BindVertexBuffer(m_fullScreenVB, sizeof(FullScreenVertex));
+    backend.BindTexture(ShaderStage::Pixel, 0, source);
+    backend.Draw(3);
+
+    backend.BindTexture(ShaderStage::Pixel, 0, InvalidBackendHandle);
+}
+
+BatchBinding SceneRenderer::ResolveBatchKey(const DrawKey& key) const
+{
+    BatchBinding binding = {};
+    if (key.mesh == MeshCube)
+    {
+        binding.vertexBuffer = m_cubeVB;
+        binding.vertexStride = sizeof(SceneVertex);
+        binding.indexBuffer = m_cubeIB;
+        binding.indexCount = GetCubeMesh().indexCount;
+    }
+    else
+    {
+        binding.vertexBuffer = m_quadVB;
+        binding.vertexStride = sizeof(float) * 3;
+        binding.indexBuffer = m_quadIB;
+        binding.indexCount = GetQuadMesh().indexCount;
+    }
+
+    // Blending and depth are part of the pipeline, so the shader of the key decides the state
+    binding.pipeline = key.shader == ShaderLightMarker ? m_pipelines.marker : m_pipelines.parallelogram;
+    return binding;
+}
+
+void SceneRenderer::UploadLightClusters(RenderBackend& backend)
+{
+    backend.UpdateBuffer(m_clusterBuffer, &m_lightClusters.GetConstants(), sizeof(ClusterConstants));
+    backend.UpdateBuffer(m_pointLightBuffer, m_pointLights.data(), static_cast<uint32_t>(sizeof(PointLight) * m_pointLights.size()));
+    const std::vector<uint32_t>& ranges = m_lightClusters.GetClusterRanges();
+    backend.UpdateBuffer(m_clusterRangeBuffer, ranges.data(), static_cast<uint32_t>(sizeof(uint32_t) * ranges.size()));
+
+    // Only the filled part of the index list is copied
+    const std::vector<uint32_t>& indices = m_lightClusters.GetLightIndices();
+    if (!indices.empty())
+        backend.UpdateBuffer(m_lightIndexBuffer, indices.data(), static_cast<uint32_t>(sizeof(uint32_t) * indices.size()));
+
+    backend.BindConstantBuffer(ShaderStage::Pixel, 2, m_clusterBuffer);
+    backend.BindStructuredBuffer(ShaderStage::Pixel, 2, m_pointLightBuffer);
+    backend.BindStructuredBuffer(ShaderStage::Pixel, 3, m_clusterRangeBuffer);
+    backend.BindStructuredBuffer(ShaderStage::Pixel, 4, m_lightIndexBuffer);
+}
+
+void SceneRenderer::UploadAmbientLighting(RenderBackend& backend)
+{
+    AmbientConstants constants = {};
+    if (m_textures.prefiltered != InvalidBackendHandle && m_environment.pIrradianceSH)
+    {
+        std::copy(m_environment.pIrradianceSH, m_environment.pIrradianceSH + ProbeCoefficients, constants.sh);
+        constants.diffuseIntensity = m_settings.ambientIntensity;
+        constants.specularIntensity = m_settings.reflectionIntensity;
+        constants.prefilteredMipCount = static_cast<float>(m_environment.prefilteredMipCount);
+        constants.roughness = m_settings.reflectionRoughness;
+    }
+
+    backend.UpdateBuffer(m_ambientBuffer, &constants, sizeof(constants));
+    backend.BindConstantBuffer(ShaderStage::Pixel, 3, m_ambientBuffer);
+    backend.BindTexture(ShaderStage::Pixel, 6, m_textures.prefiltered);
+}
+
+void SceneRenderer::UploadCascades(RenderBackend& backend)
+{
+    // Without the sun the buffer holds zero cascades and the shader skips them
+    CascadeConstants constants = {};
+    float splits[CascadedShadows::MaxCascades] = {};
+    uint32_t cascadeCount = m_settings.useSun ? m_cascades.GetCascadeCount() : 0;
+    for (uint32_t i = 0; i < cascadeCount; i++)
+    {
+        const ShadowCascade& cascade = m_cascades.GetCascade(i);
+        constants.viewProj[i] = Transposed(cascade.viewProj);
+        splits[i] = cascade.splitFar;
+    }
+    constants.splits = XMFLOAT4(splits[0], splits[1], splits[2], splits[3]);
+    float elevation = m_settings.sunElevation;
+    float azimuth = m_settings.sunAzimuth;
+    constants.sunDirection = XMFLOAT4(std::cos(elevation) * std::sin(azimuth), std::sin(elevation),
+        std::cos(elevation) * std::cos(azimuth), static_cast<float>(cascadeCount));
+    constants.sunColor = XMFLOAT4(1.0f, 0.95f, 0.85f, 0.0f);
+    backend.UpdateBuffer(m_cascadeBuffer, &constants, sizeof(constants));
+}
+
+void SceneRenderer::UploadInstanceProbes(RenderBackend& backend, const uint32_t* pIds, uint32_t count)
+{
+    PROFILE_SCOPE("Light Probes");
+
+    // The probes are blended in the order the instances went into the instance buffer
+    count = std::min(count, MaxInstances);
+    bool useProbes = m_settings.useLightProbes && m_environment.interpolateProbes && count > 0;
+    m_probeConstants[0] = XMFLOAT4(useProbes ? 1.0f : 0.0f, 0.0f, 0.0f, 0.0f);
+    if (useProbes)
+    {
+        m_probePositions.resize(count);
+        for (uint32_t i = 0; i < count; i++)
+            m_probePositions[i] = GetTranslation(m_instances[pIds[i]].model);
+        m_environment.interpolateProbes(m_probePositions.data(), count, &m_probeConstants[1]);
+    }
+
+    uint32_t size = static_cast<uint32_t>(sizeof(XMFLOAT4) * (1 + (useProbes ? count * ProbeCoefficients : 0)));
+    backend.UpdateBuffer(m_probeBuffer, m_probeConstants.data(), size);
+    backend.BindConstantBuffer(ShaderStage::Pixel, 4, m_probeBuffer);
+}
+
+void SceneRenderer::UploadInstanceLights(RenderBackend& backend, const uint32_t* pIds, uint32_t count)
+{
+    InstanceLightConstants constants = {};
+    constants.stride = InstanceLightLists::ListStride;
+    count = std::min(count, MaxInstances);
+    if (m_settings.useInstanceLights && count > 0)
+    {
+        // Box of the rotated cube: column sums of the matrix, the local cube goes from -1 to 1
+        m_instanceBounds.resize(count);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            const XMFLOAT4X4& model = m_instances[pIds[i]].model;
+            InstanceBounds& bounds = m_instanceBounds[i];
+            bounds.center = GetTranslation(model);
+            bounds.extents = XMFLOAT3(std::fabs(model._11) + std::fabs(model._21) + std::fabs(model._31),
+                std::fabs(model._12) + std::fabs(model._22) + std::fabs(model._32),
+                std::fabs(model._13) + std::fabs(model._23) + std::fabs(model._33));
+        }
+        m_instanceLights.Build(m_pointLights.data(), sizeof(PointLight), static_cast<uint32_t>(m_pointLights.size()),
+            m_instanceBounds.data(), count);
+
+        const std::vector<uint32_t>& lists = m_instanceLights.GetLists();
+        backend.UpdateBuffer(m_instanceListBuffer, lists.data(), static_cast<uint32_t>(sizeof(uint32_t) * lists.size()));
+        constants.enabled = 1;
+    }
+
+    backend.UpdateBuffer(m_instanceLightBuffer, &constants, sizeof(constants));
+    backend.BindConstantBuffer(ShaderStage::Pixel, 5, m_instanceLightBuffer);
+    backend.BindStructuredBuffer(ShaderStage::Pixel, 9, m_instanceListBuffer);
+}
+
+void SceneRenderer::UploadReflectionProbes(RenderBackend& backend, const uint32_t* pIds, uint32_t count)
+{
+    XMFLOAT4 constants[1 + MaxInstances] = {};
+    count = std::min(count, MaxInstances);
+    const std::vector<XMFLOAT3>& probes = m_environment.reflectionProbes;
+    bool useProbes = m_settings.useReflectionProbes && m_textures.reflectionProbes != InvalidBackendHandle && !probes.empty();
+    if (useProbes)
+    {
+        constants[0] = XMFLOAT4(static_cast<float>(probes.size()), static_cast<float>(m_environment.reflectionProbeMips), 0.0f, 0.0f);
+
+        // There are few probes, so the two nearest are found by brute force; the weight falls off with distance
+        for (uint32_t i = 0; i < count; i++)
+        {
+            XMFLOAT3 position = GetTranslation(m_instances[pIds[i]].model);
+            uint32_t nearest = 0;
+            uint32_t second = 0;
+            float nearestDistance = FLT_MAX;
+            float secondDistance = FLT_MAX;
+            for (uint32_t probe = 0; probe < probes.size(); probe++)
+            {
+                float distance = Distance(position, probes[probe]);
+                if (distance < nearestDistance)
+                {
+                    second = nearest;
+                    secondDistance = nearestDistance;
+                    nearest = probe;
+                    nearestDistance = distance;
+                }
+                else if (distance < secondDistance)
+                {
+                    second = probe;
+                    secondDistance = distance;
+                }
+            }
+            float weight = secondDistance < FLT_MAX ? secondDistance / (nearestDistance + secondDistance + 1.0e-6f) : 1.0f;
+            constants[1 + i] = XMFLOAT4(static_cast<float>(nearest), static_cast<float>(second), weight, 0.0f);
+        }
+    }
+
+    backend.UpdateBuffer(m_reflectionProbeBuffer, constants, static_cast<uint32_t>(sizeof(XMFLOAT4) * (1 + (useProbes ? count : 0))));
+    backend.BindConstantBuffer(ShaderStage::Pixel, 7, m_reflectionProbeBuffer);
+    backend.BindTexture(ShaderStage::Pixel, 11, m_textures.reflectionProbes);
+}
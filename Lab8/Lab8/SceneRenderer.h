@@ -0,0 +1,291 @@
+#ifndef SCENE_RENDERER_H
+#define SCENE_RENDERER_H
+
+#include <DirectXMath.h>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "CascadedShadows.h"
+#include "DrawBatcher.h"
+#include "FrameManager.h"
+#include "InstanceLights.h"
+#include "LightClusters.h"
+#include "RenderBackend.h"
+#include "RenderGraph.h"
+#include "ScenePasses.h"
+#include "ShadowAtlas.h"
+
+using namespace DirectX;
+
+class ThreadPool;
+
+// Vertex of the cube mesh, the layout of ColorVertex.vs and of SwMeshData with 8 floats
+struct SceneVertex
+{
+    XMFLOAT3 xyz;
+    XMFLOAT3 normal;
+    XMFLOAT2 uv;
+};
+
+// CPU geometry of a scene mesh: position first, floatsPerVertex floats per vertex,
+// no index buffer when pIndices is nullptr
+struct SceneMesh
+{
+    const float* pVertices;
+    uint32_t floatsPerVertex;
+    uint32_t vertexCount;
+    const uint16_t* pIndices;
+    uint32_t indexCount;
+};
+
+// Pipelines the host registers with its backend; the scene only binds them
+struct ScenePipelines
+{
+    BackendHandle cube;
+    BackendHandle cubeLightmap;
+    BackendHandle cull;             // InvalidBackendHandle culls the cubes on the CPU
+    BackendHandle skybox;
+    BackendHandle marker;
+    BackendHandle parallelogram;
+    BackendHandle postProcess;
+    BackendHandle shadowClear;
+    BackendHandle shadowCaster;
+    BackendHandle shadowSampler;    // comparison sampler, PS s1
+};
+
+struct SceneTargets
+{
+    BackendHandle shadowAtlas;      // depth only, ShadowCache::AtlasSize
+    BackendHandle cascades[CascadedShadows::MaxCascades];
+    uint32_t cascadeSize;
+    uint32_t colorFormat;           // DXGI_FORMAT of the back buffer, for the graph textures
+};
+
+// Textures as registered right now: streamed and baked ones change while the scene runs,
+// InvalidBackendHandle leaves a slot empty
+struct SceneTextures
+{
+    BackendHandle diffuse;          // PS t0, Texture2DArray indexed by texInd
+    BackendHandle normal;           // PS t1
+    BackendHandle skybox;
+    BackendHandle lightmaps;        // PS t5, one slice per cube
+    BackendHandle prefiltered;      // PS t6
+    BackendHandle shadowAtlas;      // PS t7
+    BackendHandle cascades;         // PS t10
+    BackendHandle reflectionProbes; // PS t11, cube array
+};
+
+struct SceneEnvironment
+{
+    const XMFLOAT4* pIrradianceSH;  // 9 coefficients, nullptr without an environment
+    uint32_t prefilteredMipCount;
+    // Writes 9 coefficients per position; empty without baked light probes
+    std::function<void(const XMFLOAT3* pPositions, uint32_t count, XMFLOAT4* pCoefficients)> interpolateProbes;
+    std::vector<XMFLOAT3> reflectionProbes;     // positions of the slices in reflectionProbes
+    uint32_t reflectionProbeMips;
+};
+
+struct SceneSettings
+{
+    bool animate;
+    bool useSoftware;               // the host draws the frame, the scene only updates
+    bool useNegative;
+
+    bool useShadows;
+    uint32_t shadowFacesPerFrame;
+    bool useSun;
+    float sunAzimuth;
+    float sunElevation;
+    uint32_t cascadeCount;
+    float cascadeSplitLambda;
+
+    uint32_t extraLightCount;
+    bool useInstanceLights;
+    bool useLightProbes;
+    bool useReflectionProbes;
+
+    bool useBakedLighting;
+    float ambientIntensity;
+    float reflectionIntensity;
+    float reflectionRoughness;
+};
+
+// What the graph needs from the owner of the device: targets of the graph resources,
+// the software frame and the UI
+class SceneHost
+{
+public:
+    virtual ~SceneHost() {}
+
+    // depth adds the scene depth buffer to the target
+    virtual BackendHandle GetTarget(RenderGraph::ResourceHandle resource, bool depth) = 0;
+    virtual BackendHandle GetTexture(RenderGraph::ResourceHandle resource) = 0;
+    virtual void RenderSoftware() = 0;
+    virtual void RenderUi() = 0;
+};
+
+// The scene and its frame: cube and light animation, light clusters and lists, the shadow
+// cache and sun cascades, the batched markers and parallelograms, and the render graph
+// whose passes draw them. Everything goes through RenderBackend, so the application and
+// the headless test run the same frame; the host only owns the device objects.
+class SceneRenderer
+{
+public:
+    struct PointLight
+    {
+        XMFLOAT3 Position;
+        float Range;
+        XMFLOAT3 Color;
+        float Intensity;
+        int ShadowIndex;
+        XMFLOAT3 Padding;
+    };
+
+    // Parts of the draw keys in GetBatcher()
+    enum BatchMesh : uint32_t { MeshCube, MeshQuad };
+    enum BatchShader : uint32_t { ShaderLightMarker, ShaderParallelogram };
+    enum BatchState : uint32_t { StateOpaque, StateTransparent };
+
+    static const uint32_t MaxInstances = 23;
+    static const uint32_t MaxExtraLights = 4096;
+    static const uint32_t MaxPointLights = MaxExtraLights + 3;
+    static const uint32_t MaxShadowedLights = 256;
+    static const uint32_t MaxBatchInstances = 256;
+
+    SceneRenderer();
+
+    static SceneMesh GetCubeMesh();
+    static SceneMesh GetSkyboxMesh();
+    static SceneMesh GetQuadMesh();
+    static float GetCubeScale() { return 0.5f; }
+
+    // Creates the buffers; they belong to the backend and go away with it
+    bool Init(RenderBackend& backend, const ScenePipelines& pipelines, const SceneTargets& targets);
+    void SetThreadPool(ThreadPool* pPool);
+
+    void SetViewport(uint32_t width, uint32_t height);
+    void SetCamera(const XMFLOAT3& position, float lrAngle, float udAngle);
+    void SetSettings(const SceneSettings& settings) { m_settings = settings; }
+    const SceneSettings& GetSettings() const { return m_settings; }
+    void SetTextures(const SceneTextures& textures) { m_textures = textures; }
+    void SetEnvironment(const SceneEnvironment& environment) { m_environment = environment; }
+
+    // Animation, lights, shadows and batches of this frame
+    void Update();
+    // Passes of this frame; false with the graph error when it does not compile
+    bool BuildGraph(RenderBackend& backend, const FrameManager& frames, SceneHost& host);
+    const RenderGraph& GetGraph() const { return m_graph; }
+
+    const XMFLOAT4X4& GetView() const { return m_view; }
+    const XMFLOAT4X4& GetProj() const { return m_proj; }
+    const XMFLOAT4X4& GetSkyboxView() const { return m_skyboxView; }
+    const XMFLOAT3& GetCameraPosition() const { return m_cameraPosition; }
+    const std::vector<CubeInstanceData>& GetInstances() const { return m_instances; }
+    const PointLight* GetSceneLights() const { return m_sceneLights; }
+    const DrawBatcher& GetBatcher() const { return m_batcher; }
+    bool IsInFrustum(const XMFLOAT3& center, float extent) const;
+
+    // Visible ids of the cube pass, see CubePass::GetVisibleIds
+    const std::vector<uint32_t>& GetVisibleIds() const { return m_cubePass.GetVisibleIds(); }
+    uint32_t GetBatchDrawCalls() const { return m_batchDrawCalls; }
+    const LightClusterGrid& GetLightClusters() const { return m_lightClusters; }
+    const InstanceLightLists& GetInstanceLights() const { return m_instanceLights; }
+    const ShadowCache& GetShadowCache() const { return m_shadowCache; }
+    const CascadedShadows& GetCascades() const { return m_cascades; }
+
+private:
+    void UpdateCamera();
+    void UpdateFrustum();
+    void UpdateLights();
+    void UpdateShadows();
+    void UpdateCascades();
+    void QueueMarkers();
+    void QueueParallelograms();
+
+    void RenderShadows(RenderBackend& backend);
+    void RenderCascades(RenderBackend& backend);
+    void RenderScene(RenderBackend& backend, const FrameManager& frames, BackendHandle target);
+    void RenderSkybox(RenderBackend& backend);
+    void RenderCubes(RenderBackend& backend, const FrameManager& frames);
+    void RenderBatches(RenderBackend& backend);
+    void RenderPostProcess(RenderBackend& backend, BackendHandle source);
+
+    void UploadLightClusters(RenderBackend& backend);
+    void UploadAmbientLighting(RenderBackend& backend);
+    void UploadCascades(RenderBackend& backend);
+    void UploadInstanceProbes(RenderBackend& backend, const uint32_t* pIds, uint32_t count);
+    void UploadInstanceLights(RenderBackend& backend, const uint32_t* pIds, uint32_t count);
+    void UploadReflectionProbes(RenderBackend& backend, const uint32_t* pIds, uint32_t count);
+    BatchBinding ResolveBatchKey(const DrawKey& key) const;
+
+    ScenePipelines m_pipelines;
+    SceneSettings m_settings;
+    SceneTextures m_textures;
+    SceneEnvironment m_environment;
+
+    BackendHandle m_cubeVB;
+    BackendHandle m_cubeIB;
+    BackendHandle m_skyboxVB;
+    BackendHandle m_quadVB;
+    BackendHandle m_quadIB;
+    BackendHandle m_fullScreenVB;
+    BackendHandle m_cameraBuffer;
+    BackendHandle m_skyboxBuffer;
+    BackendHandle m_batchInstanceBuffer;
+    BackendHandle m_clusterBuffer;
+    BackendHandle m_pointLightBuffer;
+    BackendHandle m_clusterRangeBuffer;
+    BackendHandle m_lightIndexBuffer;
+    BackendHandle m_instanceLightBuffer;
+    BackendHandle m_instanceListBuffer;
+    BackendHandle m_ambientBuffer;
+    BackendHandle m_probeBuffer;
+    BackendHandle m_reflectionProbeBuffer;
+    BackendHandle m_cascadeBuffer;
+    BackendHandle m_shadowLightBuffer;
+
+    uint32_t m_width;
+    uint32_t m_height;
+    XMFLOAT3 m_cameraPosition;
+    float m_lrAngle;
+    float m_udAngle;
+    XMFLOAT4X4 m_view;
+    XMFLOAT4X4 m_proj;
+    XMFLOAT4X4 m_viewProj;
+    XMFLOAT4X4 m_skyboxView;
+    XMFLOAT4 m_frustumPlanes[6];
+
+    float m_cubeAngle;
+    float m_orbitAngles[2];
+    float m_parallelogramAngle;
+    std::vector<CubeInstanceData> m_instances;
+    // Probe, light and reflection tables are built for every id in order: the visible list
+    // reaches the CPU a frame late, while the cubes are drawn from this frame's list
+    std::vector<uint32_t> m_instanceIds;
+
+    // The three scene lights first, then the extra ones
+    PointLight m_sceneLights[3];
+    std::vector<PointLight> m_extraLights;
+    std::vector<PointLight> m_pointLights;
+    LightClusterGrid m_lightClusters;
+    InstanceLightLists m_instanceLights;
+    std::vector<InstanceBounds> m_instanceBounds;
+    std::vector<XMFLOAT3> m_probePositions;
+    std::vector<XMFLOAT4> m_probeConstants;
+
+    ShadowCache m_shadowCache;
+    bool m_shadowCacheStale;
+    std::vector<ShadowLightDesc> m_shadowLights;
+    std::vector<ShadowCaster> m_shadowCasters;
+    CascadedShadows m_cascades;
+
+    CubePass m_cubePass;
+    ShadowPass m_shadowPass;
+    DrawBatcher m_batcher;
+    uint32_t m_batchDrawCalls;
+    RenderGraph m_graph;
+    uint32_t m_colorFormat;
+};
+
+#endif
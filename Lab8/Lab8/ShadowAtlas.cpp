@@ -0,0 +1,607 @@
+#include "ShadowAtlas.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    const float ShadowNearPlane = 0.05f;
+
+    uint32_t Log2(uint32_t value)
+    {
+        uint32_t result = 0;
+        while (value > 1)
+        {
+            value >>= 1;
+            result++;
+        }
+        return result;
+    }
+
+    uint32_t NextPowerOfTwo(uint32_t value)
+    {
+        uint32_t result = 1;
+        while (result < value)
+            result <<= 1;
+        return result;
+    }
+
+    // Inward facing planes of a row-vector view * projection, D3D depth range
+    void ExtractPlanes(const XMFLOAT4X4& m, XMFLOAT4 planes[6])
+    {
+        for (int side = 0; side < 6; side++)
+        {
+            int axis = side / 2;
+            float sign = (side & 1) ? -1.0f : 1.0f;
+            float plane[4];
+            for (int i = 0; i < 4; i++)
+            {
+                if (side == 4)
+                    plane[i] = m.m[i][2];
+                else if (side == 5)
+                    plane[i] = m.m[i][3] - m.m[i][2];
+                else
+                    plane[i] = m.m[i][3] + sign * m.m[i][axis];
+            }
+            float length = sqrtf(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+            float scale = length > 0.0f ? 1.0f / length : 0.0f;
+            planes[side] = XMFLOAT4(plane[0] * scale, plane[1] * scale, plane[2] * scale, plane[3] * scale);
+        }
+    }
+
+    bool SphereInPlanes(const XMFLOAT4 planes[6], const XMFLOAT3& center, float radius)
+    {
+        for (int i = 0; i < 6; i++)
+        {
+            const XMFLOAT4& p = planes[i];
+            if (p.x * center.x + p.y * center.y + p.z * center.z + p.w < -radius)
+                return false;
+        }
+        return true;
+    }
+
+    bool SpheresOverlap(const XMFLOAT3& a, float radiusA, const XMFLOAT3& b, float radiusB)
+    {
+        float dx = a.x - b.x, dy = a.y - b.y, dz = a.z - b.z;
+        float radius = radiusA + radiusB;
+        return dx * dx + dy * dy + dz * dz < radius * radius;
+    }
+
+    XMFLOAT4X4 Multiply(const XMFLOAT4X4& a, const XMFLOAT4X4& b)
+    {
+        XMFLOAT4X4 result;
+        for (int i = 0; i < 4; i++)
+        {
+            for (int j = 0; j < 4; j++)
+                result.m[i][j] = a.m[i][0] * b.m[0][j] + a.m[i][1] * b.m[1][j] + a.m[i][2] * b.m[2][j] + a.m[i][3] * b.m[3][j];
+        }
+        return result;
+    }
+
+    XMFLOAT4X4 Transposed(const XMFLOAT4X4& m)
+    {
+        XMFLOAT4X4 result;
+        for (int i = 0; i < 4; i++)
+        {
+            for (int j = 0; j < 4; j++)
+                result.m[i][j] = m.m[j][i];
+        }
+        return result;
+    }
+
+    void Normalize3(float v[3])
+    {
+        float length = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+        float scale = length > 0.0f ? 1.0f / length : 0.0f;
+        v[0] *= scale;
+        v[1] *= scale;
+        v[2] *= scale;
+    }
+
+    void Cross3(const float a[3], const float b[3], float out[3])
+    {
+        out[0] = a[1] * b[2] - a[2] * b[1];
+        out[1] = a[2] * b[0] - a[0] * b[2];
+        out[2] = a[0] * b[1] - a[1] * b[0];
+    }
+}
+
+void ShadowAtlasAllocator::Init(uint32_t atlasSize, uint32_t minTileSize)
+{
+    m_atlasSize = atlasSize;
+    m_minTileSize = minTileSize;
+    m_levels = Log2(atlasSize / minTileSize) + 1;
+    Reset();
+}
+
+void ShadowAtlasAllocator::Reset()
+{
+    m_nodes.assign(LevelStart(m_levels), NodeFree);
+    m_freeLevels.resize(m_nodes.size());
+    for (uint32_t level = 0; level < m_levels; level++)
+        std::fill(m_freeLevels.begin() + LevelStart(level), m_freeLevels.begin() + LevelStart(level + 1), static_cast<uint8_t>(level));
+    m_usedTexels = 0;
+    m_tileCount = 0;
+}
+
+void ShadowAtlasAllocator::UpdateFreeLevel(uint32_t level, uint32_t column, uint32_t row)
+{
+    uint32_t index = NodeIndex(level, column, row);
+    if (m_nodes[index] != NodeSplit)
+    {
+        m_freeLevels[index] = m_nodes[index] == NodeFree ? static_cast<uint8_t>(level) : NoFreeLevel;
+        return;
+    }
+
+    uint8_t best = NoFreeLevel;
+    for (uint32_t child = 0; child < 4; child++)
+    {
+        uint8_t childLevel = m_freeLevels[NodeIndex(level + 1, column * 2 + (child & 1), row * 2 + (child >> 1))];
+        best = childLevel < best ? childLevel : best;
+    }
+    m_freeLevels[index] = best;
+}
+
+bool ShadowAtlasAllocator::Allocate(uint32_t size, ShadowTile& tile)
+{
+    size = NextPowerOfTwo(size < m_minTileSize ? m_minTileSize : size);
+    if (m_nodes.empty() || size > m_atlasSize)
+        return false;
+
+    uint32_t targetLevel = Log2(m_atlasSize / size);
+    if (m_freeLevels[0] > targetLevel)
+        return false;
+
+    // Walk down through the child whose largest free block is the smallest one that fits
+    uint32_t column = 0;
+    uint32_t row = 0;
+    for (uint32_t level = 0; level < targetLevel; level++)
+    {
+        uint8_t& state = m_nodes[NodeIndex(level, column, row)];
+        if (state == NodeFree)
+        {
+            // Children of a free node are all free already
+            state = NodeSplit;
+            column *= 2;
+            row *= 2;
+            continue;
+        }
+
+        uint32_t bestChild = 0;
+        uint8_t bestLevel = 0;
+        for (uint32_t child = 0; child < 4; child++)
+        {
+            uint8_t childLevel = m_freeLevels[NodeIndex(level + 1, column * 2 + (child & 1), row * 2 + (child >> 1))];
+            if (childLevel <= targetLevel && childLevel >= bestLevel)
+            {
+                bestChild = child;
+                bestLevel = childLevel;
+                if (childLevel == targetLevel)
+                    break;
+            }
+        }
+        column = column * 2 + (bestChild & 1);
+        row = row * 2 + (bestChild >> 1);
+    }
+
+    m_nodes[NodeIndex(targetLevel, column, row)] = NodeUsed;
+    tile.size = size;
+    tile.x = column * size;
+    tile.y = row * size;
+    m_usedTexels += static_cast<uint64_t>(size) * size;
+    m_tileCount++;
+
+    for (uint32_t level = targetLevel + 1; level-- > 0;)
+    {
+        UpdateFreeLevel(level, column, row);
+        column /= 2;
+        row /= 2;
+    }
+    return true;
+}
+
+void ShadowAtlasAllocator::Free(const ShadowTile& tile)
+{
+    if (tile.size == 0 || m_nodes.empty())
+        return;
+
+    uint32_t level = Log2(m_atlasSize / tile.size);
+    uint32_t column = tile.x / tile.size;
+    uint32_t row = tile.y / tile.size;
+    m_nodes[NodeIndex(level, column, row)] = NodeFree;
+    m_usedTexels -= static_cast<uint64_t>(tile.size) * tile.size;
+    m_tileCount--;
+
+    // Four free siblings become one free parent, then the free levels are refreshed up to the root
+    bool merging = true;
+    for (;;)
+    {
+        UpdateFreeLevel(level, column, row);
+        if (level == 0)
+            break;
+
+        uint32_t parentColumn = column / 2;
+        uint32_t parentRow = row / 2;
+        for (uint32_t child = 0; child < 4 && merging; child++)
+            merging = m_nodes[NodeIndex(level, parentColumn * 2 + (child & 1), parentRow * 2 + (child >> 1))] == NodeFree;
+        level--;
+        column = parentColumn;
+        row = parentRow;
+        if (merging)
+            m_nodes[NodeIndex(level, column, row)] = NodeFree;
+    }
+}
+
+// std::max binds the constant by reference, it needs storage
+const uint32_t ShadowCache::MinTileSize;
+
+ShadowCache::ShadowCache() : m_frame(0), m_stats()
+{
+    m_settings.maxTileSize = 512;
+    m_settings.maxShadowedLights = 256;
+    m_settings.maxFacesPerFrame = 36;
+    m_settings.texelsPerPixel = 0.5f;
+    m_allocator.Init(AtlasSize, MinTileSize);
+}
+
+XMFLOAT4X4 ShadowCache::FaceViewProj(const ShadowLightDesc& light, uint32_t face)
+{
+    // Same face order and orientation as a D3D cube map
+    static const float directions[6][3] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+    static const float ups[6][3] = { { 0, 1, 0 }, { 0, 1, 0 }, { 0, 0, -1 }, { 0, 0, 1 }, { 0, 1, 0 }, { 0, 1, 0 } };
+
+    float forward[3];
+    float up[3];
+    float fov;
+    if (light.type == ShadowLightType::Omni)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            forward[i] = directions[face][i];
+            up[i] = ups[face][i];
+        }
+        fov = XM_PIDIV2;
+    }
+    else
+    {
+        forward[0] = light.direction.x;
+        forward[1] = light.direction.y;
+        forward[2] = light.direction.z;
+        Normalize3(forward);
+        bool vertical = fabsf(forward[1]) > 0.99f;
+        up[0] = vertical ? 1.0f : 0.0f;
+        up[1] = vertical ? 0.0f : 1.0f;
+        up[2] = 0.0f;
+        fov = light.coneAngle;
+    }
+
+    // XMMatrixLookToLH * XMMatrixPerspectiveFovLH with a square aspect
+    float right[3];
+    float trueUp[3];
+    Cross3(up, forward, right);
+    Normalize3(right);
+    Cross3(forward, right, trueUp);
+    const float* axes[3] = { right, trueUp, forward };
+    const float position[3] = { light.position.x, light.position.y, light.position.z };
+    XMFLOAT4X4 view = {};
+    for (int axis = 0; axis < 3; axis++)
+    {
+        for (int i = 0; i < 3; i++)
+            view.m[i][axis] = axes[axis][i];
+        view.m[3][axis] = -(axes[axis][0] * position[0] + axes[axis][1] * position[1] + axes[axis][2] * position[2]);
+    }
+    view.m[3][3] = 1.0f;
+
+    float farPlane = light.range > ShadowNearPlane * 2.0f ? light.range : ShadowNearPlane * 2.0f;
+    float scale = 1.0f / tanf(fov * 0.5f);
+    XMFLOAT4X4 proj = {};
+    proj.m[0][0] = scale;
+    proj.m[1][1] = scale;
+    proj.m[2][2] = farPlane / (farPlane - ShadowNearPlane);
+    proj.m[2][3] = 1.0f;
+    proj.m[3][2] = -ShadowNearPlane * farPlane / (farPlane - ShadowNearPlane);
+    return Multiply(view, proj);
+}
+
+bool ShadowCache::SameLight(const ShadowLightDesc& a, const ShadowLightDesc& b) const
+{
+    if (a.type != b.type || a.range != b.range || a.position.x != b.position.x || a.position.y != b.position.y || a.position.z != b.position.z)
+        return false;
+    if (a.type == ShadowLightType::Omni)
+        return true;
+    return a.coneAngle == b.coneAngle && a.direction.x == b.direction.x && a.direction.y == b.direction.y && a.direction.z == b.direction.z;
+}
+
+bool ShadowCache::SphereInFace(const Entry& entry, uint32_t face, const XMFLOAT3& center, float radius) const
+{
+    XMFLOAT4 planes[6];
+    ExtractPlanes(entry.viewProj[face], planes);
+    return SphereInPlanes(planes, center, radius);
+}
+
+void ShadowCache::ReleaseTiles(Entry& entry)
+{
+    for (uint32_t face = 0; face < MaxFaces; face++)
+    {
+        m_allocator.Free(entry.tiles[face]);
+        entry.tiles[face] = {};
+        entry.valid[face] = false;
+        entry.drawn[face] = false;
+    }
+    entry.tileSize = 0;
+}
+
+bool ShadowCache::AllocateTiles(Entry& entry, uint32_t tileSize)
+{
+    uint32_t faceCount = FaceCount(entry.desc.type);
+    ShadowTile tiles[MaxFaces] = {};
+    for (uint32_t face = 0; face < faceCount; face++)
+    {
+        if (!m_allocator.Allocate(tileSize, tiles[face]))
+        {
+            for (uint32_t i = 0; i < face; i++)
+                m_allocator.Free(tiles[i]);
+            return false;
+        }
+    }
+
+    ReleaseTiles(entry);
+    for (uint32_t face = 0; face < faceCount; face++)
+        entry.tiles[face] = tiles[face];
+    entry.tileSize = tileSize;
+    return true;
+}
+
+bool ShadowCache::EvictLeastRecent(uint64_t protectedFrame)
+{
+    auto oldest = m_entries.end();
+    for (auto it = m_entries.begin(); it != m_entries.end(); ++it)
+    {
+        if (it->second.tileSize == 0 || it->second.lastUsedFrame >= protectedFrame)
+            continue;
+        if (oldest == m_entries.end() || it->second.lastUsedFrame < oldest->second.lastUsedFrame ||
+            (it->second.lastUsedFrame == oldest->second.lastUsedFrame && it->first < oldest->first))
+            oldest = it;
+    }
+    if (oldest == m_entries.end())
+        return false;
+
+    ReleaseTiles(oldest->second);
+    m_entries.erase(oldest);
+    m_stats.evictedLights++;
+    return true;
+}
+
+void ShadowCache::AddJob(Entry& entry, uint32_t light, uint32_t face, const ShadowCaster* pCasters, uint32_t casterCount)
+{
+    ShadowRenderJob job = {};
+    job.light = light;
+    job.face = face;
+    job.tile = entry.tiles[face];
+    job.viewProj = entry.viewProj[face];
+
+    // Only casters inside the face frustum are drawn into it
+    XMFLOAT4 planes[6];
+    ExtractPlanes(entry.viewProj[face], planes);
+    job.firstCaster = static_cast<uint32_t>(m_jobCasters.size());
+    for (uint32_t c = 0; c < casterCount; c++)
+    {
+        if (SphereInPlanes(planes, pCasters[c].center, pCasters[c].radius))
+            m_jobCasters.push_back(c);
+    }
+    job.casterCount = static_cast<uint32_t>(m_jobCasters.size()) - job.firstCaster;
+    m_jobs.push_back(job);
+
+    entry.valid[face] = true;
+    entry.drawn[face] = true;
+    m_stats.facesRendered++;
+}
+
+void ShadowCache::Invalidate()
+{
+    for (auto& pair : m_entries)
+    {
+        for (uint32_t face = 0; face < MaxFaces; face++)
+            pair.second.valid[face] = false;
+    }
+}
+
+void ShadowCache::Update(const XMFLOAT4X4& view, const XMFLOAT4X4& proj, uint32_t viewportHeight,
+    const ShadowLightDesc* pLights, uint32_t lightCount, const ShadowCaster* pCasters, uint32_t casterCount)
+{
+    m_frame++;
+    m_stats = {};
+    m_jobs.clear();
+    m_jobCasters.clear();
+    m_requests.clear();
+    m_shadowData.clear();
+    m_shadowIndices.assign(lightCount, -1);
+
+    // A caster that moved invalidates every face that saw it before or sees it now
+    if (m_previousCasters.size() != casterCount)
+        Invalidate();
+    else
+    {
+        for (uint32_t i = 0; i < casterCount; i++)
+        {
+            const ShadowCaster& current = pCasters[i];
+            const ShadowCaster& previous = m_previousCasters[i];
+            if (memcmp(&current, &previous, sizeof(ShadowCaster)) == 0)
+                continue;
+
+            for (auto& pair : m_entries)
+            {
+                Entry& entry = pair.second;
+                for (uint32_t face = 0; face < FaceCount(entry.desc.type); face++)
+                {
+                    if (entry.valid[face] && (SphereInFace(entry, face, current.center, current.radius) ||
+                        SphereInFace(entry, face, previous.center, previous.radius)))
+                        entry.valid[face] = false;
+                }
+            }
+        }
+    }
+    m_previousCasters.assign(pCasters, pCasters + casterCount);
+
+    // Visible lights with something to shadow, sized by their on-screen diameter
+    XMFLOAT4 cameraPlanes[6];
+    ExtractPlanes(Multiply(view, proj), cameraPlanes);
+    for (uint32_t i = 0; i < lightCount; i++)
+    {
+        const ShadowLightDesc& light = pLights[i];
+        if (light.range <= 0.0f || !SphereInPlanes(cameraPlanes, light.position, light.range))
+            continue;
+
+        bool hasCaster = false;
+        for (uint32_t c = 0; c < casterCount && !hasCaster; c++)
+            hasCaster = SpheresOverlap(light.position, light.range, pCasters[c].center, pCasters[c].radius);
+        if (!hasCaster)
+            continue;
+
+        XMFLOAT3 viewPosition;
+        const XMFLOAT3& p = light.position;
+        viewPosition.x = p.x * view._11 + p.y * view._21 + p.z * view._31 + view._41;
+        viewPosition.y = p.x * view._12 + p.y * view._22 + p.z * view._32 + view._42;
+        viewPosition.z = p.x * view._13 + p.y * view._23 + p.z * view._33 + view._43;
+        float distance = sqrtf(viewPosition.x * viewPosition.x + viewPosition.y * viewPosition.y + viewPosition.z * viewPosition.z);
+        float coverage = static_cast<float>(viewportHeight);
+        if (distance > light.range && viewPosition.z > ShadowNearPlane)
+            coverage = (std::min)(coverage, light.range * proj._22 * viewportHeight / viewPosition.z);
+
+        uint32_t tileSize = NextPowerOfTwo(static_cast<uint32_t>(coverage * m_settings.texelsPerPixel));
+        tileSize = (std::max)(MinTileSize, (std::min)(tileSize, m_settings.maxTileSize));
+        m_requests.push_back({ i, tileSize, coverage });
+    }
+    m_stats.requestedLights = static_cast<uint32_t>(m_requests.size());
+
+    // Largest lights first: they allocate before the atlas fills up and win the render budget
+    std::sort(m_requests.begin(), m_requests.end(), [](const Request& a, const Request& b)
+    {
+        return a.coverage != b.coverage ? a.coverage > b.coverage : a.light < b.light;
+    });
+    if (m_requests.size() > m_settings.maxShadowedLights)
+        m_requests.resize(m_settings.maxShadowedLights);
+
+    // Everything shrinks together until the requests fit, with slack left for fragmentation
+    const uint64_t texelBudget = static_cast<uint64_t>(AtlasSize) * AtlasSize * 3 / 4;
+    for (;;)
+    {
+        uint64_t texels = 0;
+        for (const Request& request : m_requests)
+            texels += static_cast<uint64_t>(FaceCount(pLights[request.light].type)) * request.tileSize * request.tileSize;
+        if (texels <= texelBudget)
+            break;
+
+        bool shrunk = false;
+        for (Request& request : m_requests)
+        {
+            if (request.tileSize > MinTileSize)
+            {
+                request.tileSize /= 2;
+                shrunk = true;
+            }
+        }
+        if (!shrunk)
+            break;
+    }
+    for (const Request& request : m_requests)
+    {
+        auto it = m_entries.find(pLights[request.light].id);
+        if (it != m_entries.end())
+            it->second.lastUsedFrame = m_frame;
+    }
+
+    // Tiles that should shrink go back to the atlas before anything new is placed
+    for (const Request& request : m_requests)
+    {
+        auto it = m_entries.find(pLights[request.light].id);
+        if (it != m_entries.end() && it->second.tileSize > request.tileSize * 2)
+            ReleaseTiles(it->second);
+    }
+
+    uint32_t budget = m_settings.maxFacesPerFrame;
+    for (const Request& request : m_requests)
+    {
+        const ShadowLightDesc& light = pLights[request.light];
+        Entry& entry = m_entries[light.id];
+        if (entry.tileSize > 0 && entry.desc.type != light.type)
+            ReleaseTiles(entry);
+        if (entry.tileSize == 0 || !SameLight(entry.desc, light))
+        {
+            entry.desc = light;
+            for (uint32_t face = 0; face < FaceCount(light.type); face++)
+            {
+                entry.viewProj[face] = FaceViewProj(light, face);
+                entry.valid[face] = false;
+                entry.drawn[face] = false;
+            }
+        }
+        entry.lastUsedFrame = m_frame;
+
+        // Grow as soon as there is room; a tile up to twice the wanted size is kept as it is
+        if (entry.tileSize < request.tileSize)
+        {
+            bool allocated = AllocateTiles(entry, request.tileSize);
+            while (!allocated && EvictLeastRecent(m_frame))
+                allocated = AllocateTiles(entry, request.tileSize);
+            for (uint32_t size = request.tileSize / 2; !allocated && entry.tileSize == 0 && size >= MinTileSize; size /= 2)
+                allocated = AllocateTiles(entry, size);
+            if (entry.tileSize == 0)
+            {
+                m_entries.erase(light.id);
+                m_stats.failedAllocations++;
+                continue;
+            }
+        }
+
+        // Faces without depth of this light must be drawn before it can use them; faces that
+        // only missed a caster moving can show the older depth for a frame when over budget
+        uint32_t faceCount = FaceCount(light.type);
+        uint32_t undrawn = 0;
+        uint32_t dirty = 0;
+        for (uint32_t face = 0; face < faceCount; face++)
+        {
+            undrawn += entry.drawn[face] ? 0 : 1;
+            dirty += entry.valid[face] ? 0 : 1;
+        }
+        if (undrawn > budget)
+        {
+            m_stats.facesDeferred += dirty;
+            continue;
+        }
+
+        for (uint32_t pass = 0; pass < 2; pass++)
+        {
+            for (uint32_t face = 0; face < faceCount; face++)
+            {
+                if (entry.valid[face] || entry.drawn[face] != (pass == 1))
+                    continue;
+                if (budget == 0)
+                {
+                    m_stats.facesDeferred++;
+                    continue;
+                }
+                AddJob(entry, request.light, face, pCasters, casterCount);
+                budget--;
+            }
+        }
+
+        m_stats.facesCached += faceCount - dirty;
+
+        ShadowLightData data = {};
+        float invAtlas = 1.0f / AtlasSize;
+        for (uint32_t face = 0; face < faceCount; face++)
+        {
+            const ShadowTile& tile = entry.tiles[face];
+            data.viewProj[face] = Transposed(entry.viewProj[face]);
+            data.tileRect[face] = XMFLOAT4(tile.x * invAtlas, tile.y * invAtlas, (tile.x + tile.size) * invAtlas, (tile.y + tile.size) * invAtlas);
+        }
+        data.faceCount = faceCount;
+        m_shadowIndices[request.light] = static_cast<int32_t>(m_shadowData.size());
+        m_shadowData.push_back(data);
+        m_stats.shadowedLights++;
+    }
+
+    m_stats.atlasTiles = m_allocator.GetTileCount();
+    m_stats.atlasUsage = static_cast<float>(static_cast<double>(m_allocator.GetUsedTexels()) / (static_cast<double>(AtlasSize) * AtlasSize));
+}
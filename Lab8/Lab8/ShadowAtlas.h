@@ -0,0 +1,202 @@
+#ifndef SHADOW_ATLAS_H
+#define SHADOW_ATLAS_H
+
+#include <DirectXMath.h>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+using namespace DirectX;
+
+struct ShadowTile
+{
+    uint32_t x;
+    uint32_t y;
+    uint32_t size;          // 0 when nothing is allocated
+};
+
+// Quadtree over a square atlas. Every node is free, split into four children or in use;
+// tiles are power of two squares between the minimum tile size and the whole atlas.
+// Each node also knows the largest free block below it, so an allocation walks straight
+// down to the smallest block that fits. Freeing a tile merges four free siblings back
+// into their parent.
+class ShadowAtlasAllocator
+{
+public:
+    ShadowAtlasAllocator() : m_atlasSize(0), m_minTileSize(0), m_levels(0), m_usedTexels(0), m_tileCount(0) {}
+
+    // atlasSize / minTileSize must be a power of two
+    void Init(uint32_t atlasSize, uint32_t minTileSize);
+    void Reset();
+
+    // size is rounded up to a power of two no smaller than the minimum tile
+    bool Allocate(uint32_t size, ShadowTile& tile);
+    void Free(const ShadowTile& tile);
+
+    uint32_t GetAtlasSize() const { return m_atlasSize; }
+    uint32_t GetMinTileSize() const { return m_minTileSize; }
+    uint64_t GetUsedTexels() const { return m_usedTexels; }
+    uint32_t GetTileCount() const { return m_tileCount; }
+
+private:
+    enum NodeState : uint8_t { NodeFree, NodeSplit, NodeUsed };
+
+    // Nodes of a level are stored row by row after all coarser levels
+    static uint32_t LevelStart(uint32_t level) { return ((1u << (2 * level)) - 1) / 3; }
+    uint32_t NodeIndex(uint32_t level, uint32_t column, uint32_t row) const { return LevelStart(level) + (row << level) + column; }
+    void UpdateFreeLevel(uint32_t level, uint32_t column, uint32_t row);
+
+    static const uint8_t NoFreeLevel = 0xFF;
+
+    uint32_t m_atlasSize;
+    uint32_t m_minTileSize;
+    uint32_t m_levels;
+    uint64_t m_usedTexels;
+    uint32_t m_tileCount;
+    std::vector<uint8_t> m_nodes;
+    std::vector<uint8_t> m_freeLevels;  // level of the largest free block in the subtree
+};
+
+enum class ShadowLightType : uint32_t
+{
+    Omni,                   // six cube faces, one tile each
+    Spot,                   // one perspective tile along direction
+};
+
+struct ShadowLightDesc
+{
+    uint32_t id;            // stable from frame to frame, keys the cache
+    ShadowLightType type;
+    XMFLOAT3 position;
+    float range;
+    XMFLOAT3 direction;     // spot only
+    float coneAngle;        // full spot cone in radians
+};
+
+// Shadow casting instance: bounding sphere plus the transform that moved it there
+struct ShadowCaster
+{
+    XMFLOAT3 center;
+    float radius;
+    XMFLOAT4X4 transform;
+};
+
+// Layout of ShadowLight in ShadowAtlas.hlsli, matrices transposed for HLSL
+struct ShadowLightData
+{
+    XMFLOAT4X4 viewProj[6];
+    XMFLOAT4 tileRect[6];   // atlas uv of the tile: min in xy, max in zw
+    uint32_t faceCount;     // 6 omni, 1 spot
+    float padding[3];
+};
+
+// One face to draw into the atlas this frame
+struct ShadowRenderJob
+{
+    uint32_t light;         // index into the lights passed to Update
+    uint32_t face;
+    ShadowTile tile;
+    XMFLOAT4X4 viewProj;    // row-vector, not transposed
+    uint32_t firstCaster;   // range in GetJobCasters
+    uint32_t casterCount;
+};
+
+struct ShadowCacheSettings
+{
+    uint32_t maxTileSize;
+    uint32_t maxShadowedLights;
+    uint32_t maxFacesPerFrame;  // re-render budget, the largest lights go first
+    float texelsPerPixel;       // tile size relative to the light's on-screen diameter
+};
+
+struct ShadowCacheStats
+{
+    uint32_t requestedLights;   // visible lights with at least one caster in range
+    uint32_t shadowedLights;    // of those, with an allocated and rendered shadow
+    uint32_t facesRendered;
+    uint32_t facesCached;       // shadowed faces reused from an earlier frame
+    uint32_t facesDeferred;     // dirty faces past the budget
+    uint32_t evictedLights;
+    uint32_t failedAllocations;
+    uint32_t atlasTiles;
+    float atlasUsage;           // fraction of the atlas texels in use
+};
+
+// Decides which lights get shadows, where they live in the atlas and which faces must be
+// drawn again. Tiles are sized by the light's screen coverage. A cached face stays valid
+// until the light changes or a caster moves inside that face's frustum, so static lights
+// over static geometry cost nothing after their first frame. Lights that drop out of view
+// keep their tiles until the space is needed, least recently used first.
+// Pure CPU code: the renderer draws the jobs and uploads GetShadowData.
+class ShadowCache
+{
+public:
+    static const uint32_t AtlasSize = 4096;
+    static const uint32_t MinTileSize = 32;
+    static const uint32_t MaxFaces = 6;
+
+    ShadowCache();
+
+    void SetSettings(const ShadowCacheSettings& settings) { m_settings = settings; }
+    const ShadowCacheSettings& GetSettings() const { return m_settings; }
+
+    // proj is a D3D left-handed perspective projection, viewportHeight in pixels
+    void Update(const XMFLOAT4X4& view, const XMFLOAT4X4& proj, uint32_t viewportHeight,
+        const ShadowLightDesc* pLights, uint32_t lightCount, const ShadowCaster* pCasters, uint32_t casterCount);
+    // Forgets every cached face, the next Update redraws everything it keeps
+    void Invalidate();
+
+    const std::vector<ShadowRenderJob>& GetJobs() const { return m_jobs; }
+    // Indices into the casters passed to Update
+    const std::vector<uint32_t>& GetJobCasters() const { return m_jobCasters; }
+    // Entry in GetShadowData for each light of the last Update, -1 without a shadow
+    const std::vector<int32_t>& GetShadowIndices() const { return m_shadowIndices; }
+    const std::vector<ShadowLightData>& GetShadowData() const { return m_shadowData; }
+    const ShadowCacheStats& GetStats() const { return m_stats; }
+    const ShadowAtlasAllocator& GetAllocator() const { return m_allocator; }
+
+    // Row-vector view * projection of one face, 90 degree cube faces in D3D order for omni lights
+    static XMFLOAT4X4 FaceViewProj(const ShadowLightDesc& light, uint32_t face);
+
+private:
+    struct Entry
+    {
+        ShadowLightDesc desc;
+        uint32_t tileSize;
+        ShadowTile tiles[MaxFaces];
+        XMFLOAT4X4 viewProj[MaxFaces];
+        bool drawn[MaxFaces];       // holds depth of the current light position
+        bool valid[MaxFaces];       // and no caster moved through it since
+        uint64_t lastUsedFrame;
+    };
+
+    struct Request
+    {
+        uint32_t light;
+        uint32_t tileSize;
+        float coverage;
+    };
+
+    static uint32_t FaceCount(ShadowLightType type) { return type == ShadowLightType::Omni ? 6 : 1; }
+    bool SameLight(const ShadowLightDesc& a, const ShadowLightDesc& b) const;
+    bool SphereInFace(const Entry& entry, uint32_t face, const XMFLOAT3& center, float radius) const;
+    void ReleaseTiles(Entry& entry);
+    bool AllocateTiles(Entry& entry, uint32_t tileSize);
+    bool EvictLeastRecent(uint64_t protectedFrame);
+    void AddJob(Entry& entry, uint32_t light, uint32_t face, const ShadowCaster* pCasters, uint32_t casterCount);
+
+    ShadowCacheSettings m_settings;
+    ShadowAtlasAllocator m_allocator;
+    std::unordered_map<uint32_t, Entry> m_entries;
+    uint64_t m_frame;
+
+    std::vector<ShadowCaster> m_previousCasters;
+    std::vector<Request> m_requests;
+    std::vector<ShadowRenderJob> m_jobs;
+    std::vector<uint32_t> m_jobCasters;
+    std::vector<int32_t> m_shadowIndices;
+    std::vector<ShadowLightData> m_shadowData;
+    ShadowCacheStats m_stats;
+};
+
+#endif
@@ -0,0 +1,47 @@
+// Point and spot light shadows from tiles of one depth atlas, placed by ShadowCache on the CPU
+
+struct ShadowLight
+{
+    float4x4 viewProj[6];
+    float4 tileRect[6];     // atlas uv of the tile: min in xy, max in zw
+    uint faceCount;         // 6 for point lights, 1 for spot lights
+    float3 padding;
+};
+
+Texture2D<float> shadowAtlas : register(t7);
+StructuredBuffer<ShadowLight> shadowLights : register(t8);
+SamplerComparisonState shadowSampler : register(s1);
+
+// 1 lit, 0 shadowed; shadowIndex < 0 means the light has no shadow this frame
+float CalculateShadow(int shadowIndex, float3 lightPosition, float3 worldPos)
+{
+    if (shadowIndex < 0)
+        return 1.0f;
+
+    // Cube face by the major axis of the light-to-pixel vector, in D3D cube map order
+    uint face = 0;
+    if (shadowLights[shadowIndex].faceCount == 6)
+    {
+        float3 toPixel = worldPos - lightPosition;
+        float3 a = abs(toPixel);
+        if (a.x >= a.y && a.x >= a.z)
+            face = toPixel.x >= 0.0f ? 0 : 1;
+        else if (a.y >= a.z)
+            face = toPixel.y >= 0.0f ? 2 : 3;
+        else
+            face = toPixel.z >= 0.0f ? 4 : 5;
+    }
+
+    float4 clipPos = mul(float4(worldPos, 1.0f), shadowLights[shadowIndex].viewProj[face]);
+    float3 ndc = clipPos.xyz / clipPos.w;
+    if (clipPos.w <= 0.0f || any(abs(ndc.xy) > 1.0f))
+        return 1.0f;
+
+    // One texel inside the tile, so filtering never reads the neighbouring tile
+    float2 atlasSize;
+    shadowAtlas.GetDimensions(atlasSize.x, atlasSize.y);
+    float4 rect = shadowLights[shadowIndex].tileRect[face];
+    float2 uv = lerp(rect.xy, rect.zw, ndc.xy * float2(0.5f, -0.5f) + 0.5f);
+    uv = clamp(uv, rect.xy + 1.0f / atlasSize, rect.zw - 1.0f / atlasSize);
+    return shadowAtlas.SampleCmpLevelZero(shadowSampler, uv, ndc.z);
+}
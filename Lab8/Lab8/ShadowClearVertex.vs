@@ -0,0 +1,7 @@
+// Full viewport triangle at the far plane: clears the depth of one shadow atlas tile,
+// which ClearDepthStencilView cannot do for part of a view
+float4 main(uint vertexID : SV_VertexID) : SV_POSITION
+{
+    float2 uv = float2((vertexID << 1) & 2, vertexID & 2);
+    return float4(uv * float2(2.0f, -2.0f) + float2(-1.0f, 1.0f), 1.0f, 1.0f);
+}
@@ -0,0 +1,26 @@
+static const uint MAX_INSTANCES = 23;
+
+struct InstanceData
+{
+    float4x4 model;
+    uint texInd;
+    uint countInstance;
+    uint lightmapSlice;
+};
+
+cbuffer ModelBufferInst : register(b0)
+{
+    InstanceData modelBuffer[MAX_INSTANCES];
+};
+
+cbuffer ShadowFaceBuffer : register(b1)
+{
+    matrix shadowViewProj;
+};
+
+// Depth only: the casters of one shadow atlas tile
+float4 main(float3 pos : POSITION, uint instanceID : SV_InstanceID) : SV_POSITION
+{
+    float4 worldPos = mul(float4(pos, 1.0f), modelBuffer[instanceID].model);
+    return mul(worldPos, shadowViewProj);
+}
@@ -0,0 +1,520 @@
+#include "SoftwareRasterizer.h"
+#include "Profiler.h"
+#include "ThreadPool.h"
+#include <cmath>
+
+namespace
+{
+    const float MinClipW = 1.0e-5f;
+    const uint32_t PostProcessRows = 16;
+
+    float LaneOf(const SwFloat& value, int lane)
+    {
+        switch (lane)
+        {
+        case 1: return _mm_cvtss_f32(_mm_shuffle_ps(value.v, value.v, _MM_SHUFFLE(1, 1, 1, 1)));
+        case 2: return _mm_cvtss_f32(_mm_shuffle_ps(value.v, value.v, _MM_SHUFFLE(2, 2, 2, 2)));
+        case 3: return _mm_cvtss_f32(_mm_shuffle_ps(value.v, value.v, _MM_SHUFFLE(3, 3, 3, 3)));
+        default: return _mm_cvtss_f32(value.v);
+        }
+    }
+
+    // Sutherland-Hodgman against one clip-space plane, distance = dot(plane, position) - bias
+    uint32_t ClipPolygon(const SwVertex* pIn, uint32_t count, SwVertex* pOut, const float plane[4], float bias, uint32_t attributeCount)
+    {
+        uint32_t outCount = 0;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            const SwVertex& a = pIn[i];
+            const SwVertex& b = pIn[(i + 1) % count];
+            float da = a.position[0] * plane[0] + a.position[1] * plane[1] + a.position[2] * plane[2] + a.position[3] * plane[3] - bias;
+            float db = b.position[0] * plane[0] + b.position[1] * plane[1] + b.position[2] * plane[2] + b.position[3] * plane[3] - bias;
+
+            if (da >= 0.0f)
+                pOut[outCount++] = a;
+
+            if ((da >= 0.0f) != (db >= 0.0f))
+            {
+                float t = da / (da - db);
+                SwVertex& v = pOut[outCount++];
+                for (int c = 0; c < 4; c++)
+                    v.position[c] = a.position[c] + (b.position[c] - a.position[c]) * t;
+                for (uint32_t c = 0; c < attributeCount; c++)
+                    v.attributes[c] = a.attributes[c] + (b.attributes[c] - a.attributes[c]) * t;
+            }
+        }
+        return outCount;
+    }
+
+    bool OutsideSamePlane(const SwVertex& a, const SwVertex& b, const SwVertex& c)
+    {
+        for (int axis = 0; axis < 2; axis++)
+        {
+            if (a.position[axis] > a.position[3] && b.position[axis] > b.position[3] && c.position[axis] > c.position[3])
+                return true;
+            if (a.position[axis] < -a.position[3] && b.position[axis] < -b.position[3] && c.position[axis] < -c.position[3])
+                return true;
+        }
+        return a.position[2] > a.position[3] && b.position[2] > b.position[3] && c.position[2] > c.position[3];
+    }
+
+    __m128i PackColor(const SwColor& color)
+    {
+        __m128 scale = _mm_set1_ps(255.0f);
+        __m128i r = _mm_cvtps_epi32(_mm_mul_ps(Saturate(color.r).v, scale));
+        __m128i g = _mm_cvtps_epi32(_mm_mul_ps(Saturate(color.g).v, scale));
+        __m128i b = _mm_cvtps_epi32(_mm_mul_ps(Saturate(color.b).v, scale));
+        __m128i a = _mm_cvtps_epi32(_mm_mul_ps(Saturate(color.a).v, scale));
+        return _mm_or_si128(_mm_or_si128(r, _mm_slli_epi32(g, 8)), _mm_or_si128(_mm_slli_epi32(b, 16), _mm_slli_epi32(a, 24)));
+    }
+
+    SwColor UnpackColor(__m128i packed)
+    {
+        __m128i byteMask = _mm_set1_epi32(0xFF);
+        __m128 scale = _mm_set1_ps(1.0f / 255.0f);
+        SwColor color;
+        color.r = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(packed, byteMask)), scale);
+        color.g = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(packed, 8), byteMask)), scale);
+        color.b = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(packed, 16), byteMask)), scale);
+        color.a = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(packed, 24)), scale);
+        return color;
+    }
+
+    SwFloat EvaluatePlane(float origin, float dx, float dy, const SwFloat& rx, const SwFloat& ry)
+    {
+        return _mm_add_ps(_mm_set1_ps(origin), _mm_add_ps(_mm_mul_ps(_mm_set1_ps(dx), rx.v), _mm_mul_ps(_mm_set1_ps(dy), ry.v)));
+    }
+}
+
+float SwComputeLod(const SwFloat& u, const SwFloat& v, float width, float height)
+{
+    float u0 = LaneOf(u, 0), v0 = LaneOf(v, 0);
+    float dudx = (LaneOf(u, 1) - u0) * width;
+    float dvdx = (LaneOf(v, 1) - v0) * height;
+    float dudy = (LaneOf(u, 2) - u0) * width;
+    float dvdy = (LaneOf(v, 2) - v0) * height;
+    float lengthX = dudx * dudx + dvdx * dvdx;
+    float lengthY = dudy * dudy + dvdy * dvdy;
+    float rho2 = lengthX > lengthY ? lengthX : lengthY;
+    if (!(rho2 > 1.0e-20f))
+        return 0.0f;
+    return 0.5f * std::log2(rho2);
+}
+
+SoftwareRasterizer::SoftwareRasterizer()
+    : m_pPool(nullptr),
+    m_width(0),
+    m_height(0),
+    m_pitch(0),
+    m_tilesX(0),
+    m_tilesY(0),
+    m_clearColor(0),
+    m_clearDepth(1.0f),
+    m_culledCount(0)
+{
+}
+
+void SoftwareRasterizer::Resize(uint32_t width, uint32_t height)
+{
+    if (width == m_width && height == m_height)
+        return;
+
+    // Quads are 2x2 and the post-process works on four texels, so rows and
+    // columns are padded; the padding is never covered and never shown
+    m_width = width;
+    m_height = height;
+    m_pitch = (width + 3) & ~3u;
+    uint32_t rows = (height + 1) & ~1u;
+    m_color.assign(static_cast<size_t>(m_pitch) * rows, 0);
+    m_depth.assign(static_cast<size_t>(m_pitch) * rows, 1.0f);
+
+    m_tilesX = (width + TileSize - 1) / TileSize;
+    m_tilesY = (height + TileSize - 1) / TileSize;
+    m_bins.assign(static_cast<size_t>(m_tilesX) * m_tilesY, std::vector<uint32_t>());
+}
+
+void SoftwareRasterizer::BeginFrame(const float clearColor[4], float clearDepth)
+{
+    SwColor color;
+    color.r = clearColor[0];
+    color.g = clearColor[1];
+    color.b = clearColor[2];
+    color.a = clearColor[3];
+    m_clearColor = static_cast<uint32_t>(_mm_cvtsi128_si32(PackColor(color)));
+    m_clearDepth = clearDepth;
+
+    m_draws.clear();
+    m_triangles.clear();
+    for (auto& bin : m_bins)
+        bin.clear();
+    m_culledCount = 0;
+}
+
+void SoftwareRasterizer::DrawIndexed(const SwPipelineState& state, const void* pConstants,
+    const SwVertex* pVertices, const uint16_t* pIndices, uint32_t indexCount)
+{
+    Draw draw = { state, pConstants };
+    m_draws.push_back(draw);
+    uint32_t drawIndex = static_cast<uint32_t>(m_draws.size() - 1);
+
+    static const float nearPlane[4] = { 0.0f, 0.0f, 1.0f, 0.0f };
+    static const float wPlane[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+
+    for (uint32_t i = 0; i + 2 < indexCount; i += 3)
+    {
+        const SwVertex& a = pVertices[pIndices[i]];
+        const SwVertex& b = pVertices[pIndices[i + 1]];
+        const SwVertex& c = pVertices[pIndices[i + 2]];
+
+        if (OutsideSamePlane(a, b, c))
+        {
+            m_culledCount++;
+            continue;
+        }
+
+        bool needsClip = a.position[2] < 0.0f || b.position[2] < 0.0f || c.position[2] < 0.0f ||
+            a.position[3] < MinClipW || b.position[3] < MinClipW || c.position[3] < MinClipW;
+        if (!needsClip)
+        {
+            SetupTriangle(drawIndex, a, b, c);
+            continue;
+        }
+
+        // Near plane (z >= 0) and w > 0: at most two extra vertices per plane
+        SwVertex polygon[3] = { a, b, c };
+        SwVertex clippedNear[4];
+        SwVertex clipped[5];
+        uint32_t count = ClipPolygon(polygon, 3, clippedNear, nearPlane, 0.0f, state.attributeCount);
+        count = ClipPolygon(clippedNear, count, clipped, wPlane, MinClipW, state.attributeCount);
+        if (count < 3)
+        {
+            m_culledCount++;
+            continue;
+        }
+        for (uint32_t v = 1; v + 1 < count; v++)
+            SetupTriangle(drawIndex, clipped[0], clipped[v], clipped[v + 1]);
+    }
+}
+
+void SoftwareRasterizer::SetupTriangle(uint32_t draw, const SwVertex& a, const SwVertex& b, const SwVertex& c)
+{
+    const SwPipelineState& state = m_draws[draw].state;
+    const SwVertex* vertices[3] = { &a, &b, &c };
+
+    float sx[3], sy[3], sz[3], iw[3];
+    for (int i = 0; i < 3; i++)
+    {
+        iw[i] = 1.0f / vertices[i]->position[3];
+        sx[i] = (vertices[i]->position[0] * iw[i] * 0.5f + 0.5f) * m_width;
+        sy[i] = (0.5f - vertices[i]->position[1] * iw[i] * 0.5f) * m_height;
+        sz[i] = vertices[i]->position[2] * iw[i];
+    }
+
+    // Positive area is clockwise on screen, which D3D11 treats as the front face
+    float area = (sx[1] - sx[0]) * (sy[2] - sy[0]) - (sx[2] - sx[0]) * (sy[1] - sy[0]);
+    if (area == 0.0f ||
+        (state.cullMode == SwCullMode::Back && area < 0.0f) ||
+        (state.cullMode == SwCullMode::Front && area > 0.0f))
+    {
+        m_culledCount++;
+        return;
+    }
+
+    int order[3] = { 0, 1, 2 };
+    if (area < 0.0f)
+    {
+        order[1] = 2;
+        order[2] = 1;
+        area = -area;
+    }
+
+    float minX = sx[0], maxX = sx[0], minY = sy[0], maxY = sy[0];
+    for (int i = 1; i < 3; i++)
+    {
+        minX = sx[i] < minX ? sx[i] : minX;
+        maxX = sx[i] > maxX ? sx[i] : maxX;
+        minY = sy[i] < minY ? sy[i] : minY;
+        maxY = sy[i] > maxY ? sy[i] : maxY;
+    }
+
+    Triangle triangle;
+    triangle.draw = draw;
+    triangle.minX = minX > 0.0f ? static_cast<int>(minX) : 0;
+    triangle.minY = minY > 0.0f ? static_cast<int>(minY) : 0;
+    triangle.maxX = maxX < static_cast<float>(m_width - 1) ? static_cast<int>(ceilf(maxX)) : static_cast<int>(m_width) - 1;
+    triangle.maxY = maxY < static_cast<float>(m_height - 1) ? static_cast<int>(ceilf(maxY)) : static_cast<int>(m_height) - 1;
+    if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+    {
+        m_culledCount++;
+        return;
+    }
+
+    float x[3], y[3];
+    for (int i = 0; i < 3; i++)
+    {
+        x[i] = sx[order[i]];
+        y[i] = sy[order[i]];
+    }
+
+    for (int i = 0; i < 3; i++)
+    {
+        int next = (i + 1) % 3;
+        triangle.edgeA[i] = y[i] - y[next];
+        triangle.edgeB[i] = x[next] - x[i];
+        triangle.topLeft[i] = triangle.edgeA[i] > 0.0f || (triangle.edgeA[i] == 0.0f && triangle.edgeB[i] > 0.0f);
+
+        // Either end works as the anchor; taking the same one for both triangles sharing
+        // the edge makes their edge values exact negatives, so no pixel is lost or drawn twice
+        bool swapAnchor = x[next] < x[i] || (x[next] == x[i] && y[next] < y[i]);
+        triangle.edgeX[i] = swapAnchor ? x[next] : x[i];
+        triangle.edgeY[i] = swapAnchor ? y[next] : y[i];
+    }
+
+    // Barycentric gradients; every interpolated value becomes a plane around vertex 0
+    float invArea = 1.0f / area;
+    float db1dx = (y[2] - y[0]) * invArea;
+    float db1dy = -(x[2] - x[0]) * invArea;
+    float db2dx = -(y[1] - y[0]) * invArea;
+    float db2dy = (x[1] - x[0]) * invArea;
+    triangle.originX = x[0];
+    triangle.originY = y[0];
+
+    auto makePlane = [&](float q0, float q1, float q2) {
+        Plane plane;
+        plane.origin = q0;
+        plane.dx = (q1 - q0) * db1dx + (q2 - q0) * db2dx;
+        plane.dy = (q1 - q0) * db1dy + (q2 - q0) * db2dy;
+        return plane;
+    };
+
+    triangle.depth = makePlane(sz[order[0]], sz[order[1]], sz[order[2]]);
+    triangle.invW = makePlane(iw[order[0]], iw[order[1]], iw[order[2]]);
+    for (uint32_t i = 0; i < state.attributeCount; i++)
+    {
+        triangle.attributes[i] = makePlane(
+            vertices[order[0]]->attributes[i] * iw[order[0]],
+            vertices[order[1]]->attributes[i] * iw[order[1]],
+            vertices[order[2]]->attributes[i] * iw[order[2]]);
+    }
+
+    m_triangles.push_back(triangle);
+    BinTriangle(static_cast<uint32_t>(m_triangles.size() - 1));
+}
+
+void SoftwareRasterizer::BinTriangle(uint32_t index)
+{
+    const Triangle& triangle = m_triangles[index];
+    uint32_t tileMinX = triangle.minX / TileSize;
+    uint32_t tileMinY = triangle.minY / TileSize;
+    uint32_t tileMaxX = triangle.maxX / TileSize;
+    uint32_t tileMaxY = triangle.maxY / TileSize;
+
+    for (uint32_t ty = tileMinY; ty <= tileMaxY; ty++)
+    {
+        for (uint32_t tx = tileMinX; tx <= tileMaxX; tx++)
+        {
+            // The bounding box overestimates thin diagonal triangles: skip tiles
+            // that lie fully outside one of the edges (test the most inside corner)
+            float left = tx * TileSize + 0.5f;
+            float top = ty * TileSize + 0.5f;
+            float right = left + TileSize - 1.0f;
+            float bottom = top + TileSize - 1.0f;
+
+            bool outside = false;
+            for (int e = 0; e < 3 && !outside; e++)
+            {
+                float cx = triangle.edgeA[e] > 0.0f ? right : left;
+                float cy = triangle.edgeB[e] > 0.0f ? bottom : top;
+                float value = triangle.edgeA[e] * (cx - triangle.edgeX[e]) + triangle.edgeB[e] * (cy - triangle.edgeY[e]);
+                outside = value < 0.0f;
+            }
+
+            if (!outside)
+                m_bins[ty * m_tilesX + tx].push_back(index);
+        }
+    }
+}
+
+void SoftwareRasterizer::Flush()
+{
+    PROFILE_SCOPE("Software Raster");
+
+    uint32_t tileCount = m_tilesX * m_tilesY;
+    if (m_pPool)
+        m_pPool->ParallelFor(tileCount, [this](uint32_t tile, uint32_t) { RasterizeTile(tile); });
+    else
+    {
+        for (uint32_t tile = 0; tile < tileCount; tile++)
+            RasterizeTile(tile);
+    }
+}
+
+void SoftwareRasterizer::RasterizeTile(uint32_t tile)
+{
+    int tileX = static_cast<int>(tile % m_tilesX) * TileSize;
+    int tileY = static_cast<int>(tile / m_tilesX) * TileSize;
+    int tileMaxX = tileX + TileSize - 1;
+    int tileMaxY = tileY + TileSize - 1;
+    if (tileMaxX >= static_cast<int>(m_width)) tileMaxX = static_cast<int>(m_width) - 1;
+    if (tileMaxY >= static_cast<int>(m_height)) tileMaxY = static_cast<int>(m_height) - 1;
+
+    // Clear covers the padding too, so quads crossing the edge read defined values
+    int clearMaxX = tileMaxX | 1;
+    int clearMaxY = tileMaxY | 1;
+    for (int y = tileY; y <= clearMaxY; y++)
+    {
+        uint32_t* pColor = m_color.data() + static_cast<size_t>(y) * m_pitch;
+        float* pDepth = m_depth.data() + static_cast<size_t>(y) * m_pitch;
+        for (int x = tileX; x <= clearMaxX; x++)
+        {
+            pColor[x] = m_clearColor;
+            pDepth[x] = m_clearDepth;
+        }
+    }
+
+    for (uint32_t index : m_bins[tile])
+        RasterizeTriangle(m_triangles[index], tileX, tileY, tileMaxX, tileMaxY);
+}
+
+void SoftwareRasterizer::RasterizeTriangle(const Triangle& triangle, int tileMinX, int tileMinY, int tileMaxX, int tileMaxY)
+{
+    const Draw& draw = m_draws[triangle.draw];
+    const SwPipelineState& state = draw.state;
+
+    int startX = (triangle.minX > tileMinX ? triangle.minX : tileMinX) & ~1;
+    int startY = (triangle.minY > tileMinY ? triangle.minY : tileMinY) & ~1;
+    int endX = triangle.maxX < tileMaxX ? triangle.maxX : tileMaxX;
+    int endY = triangle.maxY < tileMaxY ? triangle.maxY : tileMaxY;
+
+    const __m128 laneX = _mm_setr_ps(0.5f, 1.5f, 0.5f, 1.5f);
+    const __m128 laneY = _mm_setr_ps(0.5f, 0.5f, 1.5f, 1.5f);
+    const __m128 zero = _mm_setzero_ps();
+
+    __m128 edgeA[3], edgeX[3];
+    for (int e = 0; e < 3; e++)
+    {
+        edgeA[e] = _mm_set1_ps(triangle.edgeA[e]);
+        edgeX[e] = _mm_set1_ps(triangle.edgeX[e]);
+    }
+
+    SwPixelQuad quad;
+    for (int qy = startY; qy <= endY; qy += 2)
+    {
+        __m128 py = _mm_add_ps(_mm_set1_ps(static_cast<float>(qy)), laneY);
+        __m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(startX)), laneX);
+
+        // Edges are evaluated from scratch at every quad rather than stepped: the result
+        // must not depend on where this triangle's bounding box happens to start
+        __m128 edgeRow[3];
+        for (int e = 0; e < 3; e++)
+            edgeRow[e] = _mm_mul_ps(_mm_set1_ps(triangle.edgeB[e]), _mm_sub_ps(py, _mm_set1_ps(triangle.edgeY[e])));
+
+        // Rows past the bottom of an odd-height target are padding
+        __m128 rowMask = qy + 1 < static_cast<int>(m_height)
+            ? _mm_castsi128_ps(_mm_set1_epi32(-1))
+            : _mm_castsi128_ps(_mm_setr_epi32(-1, -1, 0, 0));
+
+        for (int qx = startX; qx <= endX; qx += 2)
+        {
+            __m128 mask = rowMask;
+            for (int e = 0; e < 3; e++)
+            {
+                __m128 edge = _mm_add_ps(_mm_mul_ps(edgeA[e], _mm_sub_ps(px, edgeX[e])), edgeRow[e]);
+                __m128 inside = triangle.topLeft[e] ? _mm_cmpge_ps(edge, zero) : _mm_cmpgt_ps(edge, zero);
+                mask = _mm_and_ps(mask, inside);
+            }
+            if (qx + 1 >= static_cast<int>(m_width))
+                mask = _mm_and_ps(mask, _mm_castsi128_ps(_mm_setr_epi32(-1, 0, -1, 0)));
+
+            __m128 quadX = px;
+            px = _mm_add_ps(px, _mm_set1_ps(2.0f));
+            if (_mm_movemask_ps(mask) == 0)
+                continue;
+
+            SwFloat rx = _mm_sub_ps(quadX, _mm_set1_ps(triangle.originX));
+            SwFloat ry = _mm_sub_ps(py, _mm_set1_ps(triangle.originY));
+
+            size_t offset = static_cast<size_t>(qy) * m_pitch + qx;
+            if (state.depthTest)
+            {
+                float* pDepth = m_depth.data() + offset;
+                __m128 stored = _mm_loadl_pi(zero, reinterpret_cast<const __m64*>(pDepth));
+                stored = _mm_loadh_pi(stored, reinterpret_cast<const __m64*>(pDepth + m_pitch));
+
+                __m128 depth = EvaluatePlane(triangle.depth.origin, triangle.depth.dx, triangle.depth.dy, rx, ry).v;
+                __m128 pass = state.depthFunc == SwDepthFunc::Less ? _mm_cmplt_ps(depth, stored) : _mm_cmple_ps(depth, stored);
+                mask = _mm_and_ps(mask, pass);
+                if (_mm_movemask_ps(mask) == 0)
+                    continue;
+
+                // Kernels never discard, so the test can run before shading
+                if (state.depthWrite)
+                {
+                    __m128 written = Select(mask, depth, stored).v;
+                    _mm_storel_pi(reinterpret_cast<__m64*>(pDepth), written);
+                    _mm_storeh_pi(reinterpret_cast<__m64*>(pDepth + m_pitch), written);
+                }
+            }
+
+            SwFloat w = _mm_div_ps(_mm_set1_ps(1.0f), EvaluatePlane(triangle.invW.origin, triangle.invW.dx, triangle.invW.dy, rx, ry).v);
+            for (uint32_t i = 0; i < state.attributeCount; i++)
+            {
+                const Plane& plane = triangle.attributes[i];
+                quad.attributes[i] = EvaluatePlane(plane.origin, plane.dx, plane.dy, rx, ry) * w;
+            }
+            quad.x = quadX;
+            quad.y = py;
+
+            SwColor color = state.pixelShader(quad, draw.pConstants);
+
+            uint32_t* pColor = m_color.data() + offset;
+            __m128i stored = _mm_unpacklo_epi64(
+                _mm_loadl_epi64(reinterpret_cast<const __m128i*>(pColor)),
+                _mm_loadl_epi64(reinterpret_cast<const __m128i*>(pColor + m_pitch)));
+
+            if (state.blendMode == SwBlendMode::AlphaBlend)
+            {
+                // SRC_ALPHA / INV_SRC_ALPHA for colour, ONE / ZERO for alpha
+                SwColor target = UnpackColor(stored);
+                SwFloat inverse = SwFloat(1.0f) - color.a;
+                color.r = color.r * color.a + target.r * inverse;
+                color.g = color.g * color.a + target.g * inverse;
+                color.b = color.b * color.a + target.b * inverse;
+            }
+
+            __m128i maskBits = _mm_castps_si128(mask);
+            __m128i result = _mm_or_si128(_mm_and_si128(maskBits, PackColor(color)), _mm_andnot_si128(maskBits, stored));
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(pColor), result);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(pColor + m_pitch), _mm_srli_si128(result, 8));
+        }
+    }
+}
+
+void SoftwareRasterizer::PostProcess(SwColorShader shader)
+{
+    PROFILE_SCOPE("Software PostProcess");
+
+    uint32_t rowGroups = (m_height + PostProcessRows - 1) / PostProcessRows;
+    auto processRows = [this, shader](uint32_t group, uint32_t) {
+        uint32_t firstRow = group * PostProcessRows;
+        uint32_t lastRow = firstRow + PostProcessRows < m_height ? firstRow + PostProcessRows : m_height;
+        for (uint32_t y = firstRow; y < lastRow; y++)
+        {
+            uint32_t* pRow = m_color.data() + static_cast<size_t>(y) * m_pitch;
+            for (uint32_t x = 0; x < m_pitch; x += 4)
+            {
+                __m128i* pTexels = reinterpret_cast<__m128i*>(pRow + x);
+                SwColor color = shader(UnpackColor(_mm_loadu_si128(pTexels)));
+                _mm_storeu_si128(pTexels, PackColor(color));
+            }
+        }
+    };
+
+    if (m_pPool)
+        m_pPool->ParallelFor(rowGroups, processRows);
+    else
+    {
+        for (uint32_t group = 0; group < rowGroups; group++)
+            processRows(group, 0);
+    }
+}
@@ -0,0 +1,188 @@
+#ifndef SOFTWARE_RASTERIZER_H
+#define SOFTWARE_RASTERIZER_H
+
+#include <emmintrin.h>
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+// Four lanes of a 2x2 pixel quad: lane 0 (x, y), 1 (x + 1, y), 2 (x, y + 1), 3 (x + 1, y + 1).
+// Kernels written with it read like the HLSL they replace.
+struct SwFloat
+{
+    __m128 v;
+
+    SwFloat() : v(_mm_setzero_ps()) {}
+    SwFloat(__m128 value) : v(value) {}
+    SwFloat(float value) : v(_mm_set1_ps(value)) {}
+
+    float operator[](int lane) const
+    {
+        alignas(16) float lanes[4];
+        _mm_store_ps(lanes, v);
+        return lanes[lane];
+    }
+};
+
+inline SwFloat operator+(const SwFloat& a, const SwFloat& b) { return _mm_add_ps(a.v, b.v); }
+inline SwFloat operator-(const SwFloat& a, const SwFloat& b) { return _mm_sub_ps(a.v, b.v); }
+inline SwFloat operator*(const SwFloat& a, const SwFloat& b) { return _mm_mul_ps(a.v, b.v); }
+inline SwFloat operator/(const SwFloat& a, const SwFloat& b) { return _mm_div_ps(a.v, b.v); }
+inline SwFloat& operator+=(SwFloat& a, const SwFloat& b) { a.v = _mm_add_ps(a.v, b.v); return a; }
+inline SwFloat Min(const SwFloat& a, const SwFloat& b) { return _mm_min_ps(a.v, b.v); }
+inline SwFloat Max(const SwFloat& a, const SwFloat& b) { return _mm_max_ps(a.v, b.v); }
+inline SwFloat Sqrt(const SwFloat& a) { return _mm_sqrt_ps(a.v); }
+inline SwFloat Saturate(const SwFloat& a) { return _mm_min_ps(_mm_max_ps(a.v, _mm_setzero_ps()), _mm_set1_ps(1.0f)); }
+inline SwFloat Abs(const SwFloat& a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v); }
+// mask lanes are all ones or all zeros
+inline SwFloat Select(const SwFloat& mask, const SwFloat& a, const SwFloat& b)
+{
+    return _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v));
+}
+
+struct SwFloat3
+{
+    SwFloat x, y, z;
+
+    SwFloat3() {}
+    SwFloat3(const SwFloat& xValue, const SwFloat& yValue, const SwFloat& zValue) : x(xValue), y(yValue), z(zValue) {}
+};
+
+inline SwFloat3 operator+(const SwFloat3& a, const SwFloat3& b) { return SwFloat3(a.x + b.x, a.y + b.y, a.z + b.z); }
+inline SwFloat3 operator-(const SwFloat3& a, const SwFloat3& b) { return SwFloat3(a.x - b.x, a.y - b.y, a.z - b.z); }
+inline SwFloat3 operator*(const SwFloat3& a, const SwFloat& s) { return SwFloat3(a.x * s, a.y * s, a.z * s); }
+inline SwFloat3 operator*(const SwFloat3& a, const SwFloat3& b) { return SwFloat3(a.x * b.x, a.y * b.y, a.z * b.z); }
+inline SwFloat Dot(const SwFloat3& a, const SwFloat3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+inline SwFloat Length(const SwFloat3& a) { return Sqrt(Dot(a, a)); }
+inline SwFloat3 Normalize(const SwFloat3& a)
+{
+    SwFloat invLength = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(Dot(a, a).v));
+    return a * invLength;
+}
+
+struct SwColor
+{
+    SwFloat r, g, b, a;
+};
+
+const uint32_t SwMaxAttributes = 16;
+
+// Output of a C++ vertex kernel: clip-space position and the interpolated attributes
+struct SwVertex
+{
+    float position[4];
+    float attributes[SwMaxAttributes];
+};
+
+// Input of a pixel kernel: perspective-correct attributes of the four quad pixels
+struct SwPixelQuad
+{
+    SwFloat attributes[SwMaxAttributes];
+    SwFloat x;
+    SwFloat y;
+};
+
+typedef SwColor(*SwPixelShader)(const SwPixelQuad& quad, const void* pConstants);
+// Whole-screen pass over the finished colour buffer, four pixels at a time
+typedef SwColor(*SwColorShader)(const SwColor& color);
+
+// Mip level for a quad, as the GPU derives it from the screen-space derivatives of the coordinates
+float SwComputeLod(const SwFloat& u, const SwFloat& v, float width, float height);
+
+enum class SwCullMode { None, Back, Front };
+enum class SwDepthFunc { Less, LessEqual };
+enum class SwBlendMode { Opaque, AlphaBlend };
+
+// Fixed-function part of a draw, mirroring the D3D11 states of the hardware passes
+struct SwPipelineState
+{
+    SwPixelShader pixelShader;
+    uint32_t attributeCount;
+    SwCullMode cullMode;
+    bool depthTest;
+    bool depthWrite;
+    SwDepthFunc depthFunc;
+    SwBlendMode blendMode;
+};
+
+// Tile-based rasterizer with D3D11 rules: clockwise front faces, top-left fill convention,
+// depth in [0, 1] after the perspective divide. Draws are set up and binned into screen tiles
+// on the calling thread; Flush shades the tiles in parallel, each tile processing its
+// triangles in submission order so blending matches the GPU.
+class SoftwareRasterizer
+{
+public:
+    static const uint32_t TileSize = 64;
+
+    SoftwareRasterizer();
+
+    void SetThreadPool(ThreadPool* pPool) { m_pPool = pPool; }
+    void Resize(uint32_t width, uint32_t height);
+
+    void BeginFrame(const float clearColor[4], float clearDepth);
+    // pConstants is read during Flush and must stay valid until then
+    void DrawIndexed(const SwPipelineState& state, const void* pConstants,
+        const SwVertex* pVertices, const uint16_t* pIndices, uint32_t indexCount);
+    void Flush();
+    void PostProcess(SwColorShader shader);
+
+    // RGBA8 with R in the low byte, GetPitch() texels per row
+    const uint32_t* GetColor() const { return m_color.data(); }
+    uint32_t GetWidth() const { return m_width; }
+    uint32_t GetHeight() const { return m_height; }
+    uint32_t GetPitch() const { return m_pitch; }
+
+    uint32_t GetTriangleCount() const { return static_cast<uint32_t>(m_triangles.size()); }
+    uint32_t GetCulledCount() const { return m_culledCount; }
+
+private:
+    struct Plane
+    {
+        float origin;
+        float dx;
+        float dy;
+    };
+
+    struct Triangle
+    {
+        uint32_t draw;
+        float originX, originY;
+        float edgeA[3], edgeB[3], edgeX[3], edgeY[3];
+        bool topLeft[3];
+        int minX, minY, maxX, maxY;
+        Plane depth;
+        Plane invW;
+        Plane attributes[SwMaxAttributes];
+    };
+
+    struct Draw
+    {
+        SwPipelineState state;
+        const void* pConstants;
+    };
+
+    void SetupTriangle(uint32_t draw, const SwVertex& a, const SwVertex& b, const SwVertex& c);
+    void BinTriangle(uint32_t triangle);
+    void RasterizeTile(uint32_t tile);
+    void RasterizeTriangle(const Triangle& triangle, int tileMinX, int tileMinY, int tileMaxX, int tileMaxY);
+
+    ThreadPool* m_pPool;
+    uint32_t m_width;
+    uint32_t m_height;
+    uint32_t m_pitch;
+    uint32_t m_tilesX;
+    uint32_t m_tilesY;
+
+    std::vector<uint32_t> m_color;
+    std::vector<float> m_depth;
+    uint32_t m_clearColor;
+    float m_clearDepth;
+
+    std::vector<Draw> m_draws;
+    std::vector<Triangle> m_triangles;
+    std::vector<std::vector<uint32_t>> m_bins;
+    uint32_t m_culledCount;
+};
+
+#endif
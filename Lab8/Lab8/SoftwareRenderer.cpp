@@ -0,0 +1,387 @@
+#include "SoftwareRenderer.h"
+#include "Profiler.h"
+#include "ThreadPool.h"
+#include <cmath>
+#include <xmmintrin.h>
+
+namespace
+{
+    // Attribute slots of the lit cube, in the order of ColorVertex.vs outputs
+    const uint32_t AttrWorldPos = 0;
+    const uint32_t AttrNormal = 3;
+    const uint32_t AttrTexCoord = 6;
+    const uint32_t AttrTangent = 8;
+    const uint32_t AttrBitangent = 11;
+    const uint32_t CubeAttributeCount = 14;
+
+    const float BackgroundColor[4] = { 0.48f, 0.57f, 0.48f, 1.0f };
+
+    void TransformPoint(const XMFLOAT4X4& m, float x, float y, float z, float w, float out[4])
+    {
+        for (int j = 0; j < 4; j++)
+            out[j] = x * m.m[0][j] + y * m.m[1][j] + z * m.m[2][j] + w * m.m[3][j];
+    }
+
+    void TransformNormal(const XMFLOAT4X4& m, const float in[3], float* pOut)
+    {
+        for (int j = 0; j < 3; j++)
+            pOut[j] = in[0] * m.m[0][j] + in[1] * m.m[1][j] + in[2] * m.m[2][j];
+    }
+
+    SwFloat3 LoadAttribute3(const SwPixelQuad& quad, uint32_t first)
+    {
+        return SwFloat3(quad.attributes[first], quad.attributes[first + 1], quad.attributes[first + 2]);
+    }
+
+    SwFloat3 Broadcast(const XMFLOAT3& value)
+    {
+        return SwFloat3(value.x, value.y, value.z);
+    }
+
+    // Four scalar lookups turned back into channel vectors
+    SwColor SampleQuad(const SoftwareTexture& texture, const SwFloat& u, const SwFloat& v, uint32_t slice)
+    {
+        float lod = SwComputeLod(u, v, static_cast<float>(texture.GetWidth()), static_cast<float>(texture.GetHeight()));
+        alignas(16) float us[4];
+        alignas(16) float vs[4];
+        _mm_store_ps(us, u.v);
+        _mm_store_ps(vs, v.v);
+
+        __m128 s0 = texture.Sample(us[0], vs[0], slice, lod);
+        __m128 s1 = texture.Sample(us[1], vs[1], slice, lod);
+        __m128 s2 = texture.Sample(us[2], vs[2], slice, lod);
+        __m128 s3 = texture.Sample(us[3], vs[3], slice, lod);
+        _MM_TRANSPOSE4_PS(s0, s1, s2, s3);
+
+        SwColor color;
+        color.r = s0;
+        color.g = s1;
+        color.b = s2;
+        color.a = s3;
+        return color;
+    }
+
+    SwColor SampleCubeQuad(const SoftwareTexture& texture, const SwFloat3& direction)
+    {
+        alignas(16) float xs[4];
+        alignas(16) float ys[4];
+        alignas(16) float zs[4];
+        _mm_store_ps(xs, direction.x.v);
+        _mm_store_ps(ys, direction.y.v);
+        _mm_store_ps(zs, direction.z.v);
+
+        __m128 s0 = texture.SampleCube(xs[0], ys[0], zs[0]);
+        __m128 s1 = texture.SampleCube(xs[1], ys[1], zs[1]);
+        __m128 s2 = texture.SampleCube(xs[2], ys[2], zs[2]);
+        __m128 s3 = texture.SampleCube(xs[3], ys[3], zs[3]);
+        _MM_TRANSPOSE4_PS(s0, s1, s2, s3);
+
+        SwColor color;
+        color.r = s0;
+        color.g = s1;
+        color.b = s2;
+        color.a = s3;
+        return color;
+    }
+
+    // SkyboxPixel.ps
+    SwColor SkyboxKernel(const SwPixelQuad& quad, const void* pConstants)
+    {
+        const SoftwareTexture* pSkybox = static_cast<const SoftwareTexture*>(pConstants);
+        return SampleCubeQuad(*pSkybox, LoadAttribute3(quad, 0));
+    }
+
+    // NegativePixel.ps: the full-screen triangle samples texel centres, so this is a per-texel map
+    SwColor NegativeKernel(const SwColor& color)
+    {
+        SwColor result;
+        result.r = SwFloat(1.0f) - color.r;
+        result.g = SwFloat(1.0f) - color.g;
+        result.b = SwFloat(1.0f) - color.b;
+        result.a = color.a;
+        return result;
+    }
+}
+
+// ColorPixel.ps
+SwColor SoftwareRenderer::LitCubeKernel(const SwPixelQuad& quad, const void* pConstants)
+{
+    const CubeConstants& constants = *static_cast<const CubeConstants*>(pConstants);
+    const SwFloat& u = quad.attributes[AttrTexCoord];
+    const SwFloat& v = quad.attributes[AttrTexCoord + 1];
+    SwFloat3 worldPos = LoadAttribute3(quad, AttrWorldPos);
+
+    // CalculateNormalFromMap
+    SwFloat3 tangent = Normalize(LoadAttribute3(quad, AttrTangent));
+    SwFloat3 bitangent = Normalize(LoadAttribute3(quad, AttrBitangent));
+    SwColor normalSample = SampleQuad(*constants.pNormalMap, u, v, 0);
+    SwFloat mapX = normalSample.r * 2.0f - 1.0f;
+    SwFloat mapY = normalSample.g * 2.0f - 1.0f;
+    SwFloat3 normalFromMap = Normalize(SwFloat3(mapX, mapY, Sqrt(Saturate(SwFloat(1.0f) - mapX * mapX - mapY * mapY))));
+    SwFloat3 normal = Normalize(tangent * normalFromMap.x + bitangent * normalFromMap.y +
+        LoadAttribute3(quad, AttrNormal) * normalFromMap.z);
+
+    SwFloat3 viewDir = Normalize(Broadcast(constants.cameraPos) - worldPos);
+    SwFloat3 lightColor(0.0f, 0.0f, 0.0f);
+
+    for (int i = 0; i < 3; i++)
+    {
+        const SwPointLight& light = constants.pLights[i];
+        SwFloat3 toLight = Broadcast(light.position) - worldPos;
+        SwFloat distance = Length(toLight);
+        SwFloat3 lightDir = toLight * (SwFloat(1.0f) / distance);
+        SwFloat attenuation = SwFloat(1.0f) - Saturate(distance * (1.0f / light.range));
+        SwFloat diff = Max(Dot(normal, lightDir), 0.0f);
+        SwFloat3 halfwayDir = Normalize(lightDir + viewDir);
+
+        // pow(x, 32) by repeated squaring
+        SwFloat spec = Max(Dot(normal, halfwayDir), 0.0f);
+        spec = spec * spec;
+        spec = spec * spec;
+        spec = spec * spec;
+        spec = spec * spec;
+        spec = spec * spec;
+
+        SwFloat scale = (diff + spec) * attenuation * light.intensity;
+        lightColor = lightColor + Broadcast(light.color) * scale;
+    }
+
+    SwColor diffuseColor = SampleQuad(*constants.pDiffuse, u, v, constants.textureIndex);
+    SwColor result;
+    result.r = diffuseColor.r * lightColor.x;
+    result.g = diffuseColor.g * lightColor.y;
+    result.b = diffuseColor.b * lightColor.z;
+    result.a = 1.0f;
+    return result;
+}
+
+// ParallelogramPixel.ps
+SwColor SoftwareRenderer::ParallelogramKernel(const SwPixelQuad& quad, const void* pConstants)
+{
+    const ColorConstants& constants = *static_cast<const ColorConstants*>(pConstants);
+    SwFloat3 worldPos = LoadAttribute3(quad, 0);
+    SwFloat3 finalColor(0.0f, 0.0f, 0.0f);
+
+    for (int i = 0; i < 3; i++)
+    {
+        const SwPointLight& light = constants.pLights[i];
+        SwFloat distance = Length(Broadcast(light.position) - worldPos);
+        SwFloat attenuation = SwFloat(1.0f) - Saturate(distance * (1.0f / light.range));
+        finalColor = finalColor + Broadcast(light.color) * (attenuation * light.intensity);
+    }
+
+    SwColor result;
+    result.r = finalColor.x * constants.color.x;
+    result.g = finalColor.y * constants.color.y;
+    result.b = finalColor.z * constants.color.z;
+    result.a = constants.color.w;
+    return result;
+}
+
+// LightPixel.ps
+SwColor SoftwareRenderer::MarkerKernel(const SwPixelQuad&, const void* pConstants)
+{
+    const ColorConstants& constants = *static_cast<const ColorConstants*>(pConstants);
+    SwColor result;
+    result.r = constants.color.x;
+    result.g = constants.color.y;
+    result.b = constants.color.z;
+    result.a = constants.color.w;
+    return result;
+}
+
+bool SoftwareRenderer::Init(ThreadPool* pPool)
+{
+    m_pPool = pPool;
+    m_rasterizer.SetThreadPool(pPool);
+
+    SoftwareTexture textile;
+    if (!m_diffuse.LoadDDS("cat.dds", pPool) || !textile.LoadDDS("textile.dds", pPool) || !m_diffuse.AppendSlices(textile))
+        return false;
+    if (!m_normalMap.LoadDDS("cube_normal_bc5.dds", pPool) && !m_normalMap.LoadDDS("cube_normal.dds", pPool))
+        return false;
+    return m_skybox.LoadDDS("skybox.dds", pPool) && m_skybox.IsCube();
+}
+
+void SoftwareRenderer::SetMesh(SwMesh mesh, const SwMeshData& data)
+{
+    Mesh& target = m_meshes[static_cast<int>(mesh)];
+    target.vertices.resize(data.vertexCount);
+    for (uint32_t i = 0; i < data.vertexCount; i++)
+    {
+        const float* pSource = data.pVertices + static_cast<size_t>(i) * data.floatsPerVertex;
+        MeshVertex vertex = {};
+        for (int c = 0; c < 3; c++)
+            vertex.position[c] = pSource[c];
+        if (data.floatsPerVertex >= 8)
+        {
+            for (int c = 0; c < 3; c++)
+                vertex.normal[c] = pSource[3 + c];
+            vertex.uv[0] = pSource[6];
+            vertex.uv[1] = pSource[7];
+        }
+        target.vertices[i] = vertex;
+    }
+
+    if (data.pIndices)
+        target.indices.assign(data.pIndices, data.pIndices + data.indexCount);
+    else
+    {
+        target.indices.resize(data.vertexCount);
+        for (uint32_t i = 0; i < data.vertexCount; i++)
+            target.indices[i] = static_cast<uint16_t>(i);
+    }
+}
+
+void SoftwareRenderer::Render(const SwSceneFrame& frame, uint32_t width, uint32_t height)
+{
+    PROFILE_SCOPE("Software Render");
+
+    m_rasterizer.Resize(width, height);
+    m_rasterizer.BeginFrame(BackgroundColor, 1.0f);
+
+    // Constants are referenced by pointer until Flush: reserve so they never move
+    m_cubeConstants.clear();
+    m_cubeConstants.reserve(frame.cubes.size());
+    m_colorConstants.clear();
+    m_colorConstants.reserve(frame.markers.size() + frame.parallelograms.size());
+
+    {
+        PROFILE_SCOPE("Software Setup");
+        DrawSkybox(frame);
+        DrawCubes(frame);
+
+        // Same states as the marker and parallelogram pipelines of the batcher
+        SwPipelineState markerState = { MarkerKernel, 0, SwCullMode::Back, true, true, SwDepthFunc::Less, SwBlendMode::Opaque };
+        DrawColored(frame.markers, m_meshes[static_cast<int>(SwMesh::Cube)], markerState, frame);
+
+        SwPipelineState parallelogramState = { ParallelogramKernel, 3, SwCullMode::None, true, false, SwDepthFunc::Less, SwBlendMode::AlphaBlend };
+        DrawColored(frame.parallelograms, m_meshes[static_cast<int>(SwMesh::Quad)], parallelogramState, frame);
+    }
+
+    m_rasterizer.Flush();
+    if (frame.negative)
+        m_rasterizer.PostProcess(NegativeKernel);
+}
+
+void SoftwareRenderer::DrawSkybox(const SwSceneFrame& frame)
+{
+    const Mesh& mesh = m_meshes[static_cast<int>(SwMesh::Skybox)];
+    if (mesh.vertices.empty() || m_skybox.GetSliceCount() < 6)
+        return;
+
+    // SkyboxVertex.vs: xyww puts the sky on the far plane
+    m_vertices.resize(mesh.vertices.size());
+    for (size_t i = 0; i < mesh.vertices.size(); i++)
+    {
+        const MeshVertex& source = mesh.vertices[i];
+        SwVertex& vertex = m_vertices[i];
+        TransformPoint(frame.skyboxViewProj, source.position[0], source.position[1], source.position[2], 1.0f, vertex.position);
+        vertex.position[2] = vertex.position[3];
+        for (int c = 0; c < 3; c++)
+            vertex.attributes[c] = source.position[c];
+    }
+
+    SwPipelineState state = { SkyboxKernel, 3, SwCullMode::Front, true, false, SwDepthFunc::LessEqual, SwBlendMode::Opaque };
+    m_rasterizer.DrawIndexed(state, &m_skybox, m_vertices.data(), mesh.indices.data(), static_cast<uint32_t>(mesh.indices.size()));
+}
+
+void SoftwareRenderer::DrawCubes(const SwSceneFrame& frame)
+{
+    const Mesh& mesh = m_meshes[static_cast<int>(SwMesh::Cube)];
+    if (mesh.vertices.empty() || m_diffuse.GetSliceCount() == 0 || m_normalMap.GetSliceCount() == 0)
+        return;
+
+    SwPipelineState state = { LitCubeKernel, CubeAttributeCount, SwCullMode::Back, true, true, SwDepthFunc::Less, SwBlendMode::Opaque };
+    m_vertices.resize(mesh.vertices.size());
+
+    for (const auto& instance : frame.cubes)
+    {
+        // ColorVertex.vs
+        for (size_t i = 0; i < mesh.vertices.size(); i++)
+        {
+            const MeshVertex& source = mesh.vertices[i];
+            SwVertex& vertex = m_vertices[i];
+
+            float world[4];
+            TransformPoint(instance.model, source.position[0], source.position[1], source.position[2], 1.0f, world);
+            TransformPoint(frame.viewProj, world[0], world[1], world[2], world[3], vertex.position);
+            for (int c = 0; c < 3; c++)
+                vertex.attributes[AttrWorldPos + c] = world[c];
+            TransformNormal(instance.model, source.normal, vertex.attributes + AttrNormal);
+            vertex.attributes[AttrTexCoord] = source.uv[0];
+            vertex.attributes[AttrTexCoord + 1] = source.uv[1];
+
+            // tangent = normalize(cross(normal, (0, 0, 1))), bitangent = cross(normal, tangent)
+            const float* n = source.normal;
+            float tangentValue[3] = { 1.0f, 0.0f, 0.0f };
+            if (fabsf(n[2]) <= 0.999f)
+            {
+                float length = sqrtf(n[1] * n[1] + n[0] * n[0]);
+                tangentValue[0] = n[1] / length;
+                tangentValue[1] = -n[0] / length;
+                tangentValue[2] = 0.0f;
+            }
+            float bitangentValue[3] = {
+                n[1] * tangentValue[2] - n[2] * tangentValue[1],
+                n[2] * tangentValue[0] - n[0] * tangentValue[2],
+                n[0] * tangentValue[1] - n[1] * tangentValue[0] };
+            TransformNormal(instance.model, tangentValue, vertex.attributes + AttrTangent);
+            TransformNormal(instance.model, bitangentValue, vertex.attributes + AttrBitangent);
+        }
+
+        CubeConstants constants = { &m_diffuse, &m_normalMap, frame.lights, frame.cameraPos, instance.textureIndex };
+        m_cubeConstants.push_back(constants);
+        m_rasterizer.DrawIndexed(state, &m_cubeConstants.back(), m_vertices.data(), mesh.indices.data(),
+            static_cast<uint32_t>(mesh.indices.size()));
+    }
+}
+
+void SoftwareRenderer::DrawColored(const std::vector<SwColoredInstance>& instances, const Mesh& mesh,
+    const SwPipelineState& state, const SwSceneFrame& frame)
+{
+    if (mesh.vertices.empty())
+        return;
+
+    m_vertices.resize(mesh.vertices.size());
+    for (const auto& instance : instances)
+    {
+        // InstancedVertex.vs
+        for (size_t i = 0; i < mesh.vertices.size(); i++)
+        {
+            const MeshVertex& source = mesh.vertices[i];
+            SwVertex& vertex = m_vertices[i];
+
+            float world[4];
+            TransformPoint(instance.model, source.position[0], source.position[1], source.position[2], 1.0f, world);
+            TransformPoint(frame.viewProj, world[0], world[1], world[2], world[3], vertex.position);
+            for (int c = 0; c < 3; c++)
+                vertex.attributes[c] = world[c];
+        }
+
+        ColorConstants constants = { frame.lights, instance.color };
+        m_colorConstants.push_back(constants);
+        m_rasterizer.DrawIndexed(state, &m_colorConstants.back(), m_vertices.data(), mesh.indices.data(),
+            static_cast<uint32_t>(mesh.indices.size()));
+    }
+}
+
+SwBenchmarkResult SoftwareRenderer::Benchmark(const SwSceneFrame& frame, uint32_t width, uint32_t height, uint32_t frameCount)
+{
+    // One untimed frame sizes the buffers and warms the caches
+    Render(frame, width, height);
+
+    uint64_t start = Profiler::NowNs();
+    for (uint32_t i = 0; i < frameCount; i++)
+        Render(frame, width, height);
+    uint64_t elapsed = Profiler::NowNs() - start;
+
+    SwBenchmarkResult result = {};
+    result.width = width;
+    result.height = height;
+    result.frames = frameCount;
+    result.threads = m_pPool ? m_pPool->GetThreadCount() : 1;
+    result.msPerFrame = frameCount > 0 ? elapsed * 1.0e-6 / frameCount : 0.0;
+    result.fps = result.msPerFrame > 0.0 ? 1000.0 / result.msPerFrame : 0.0;
+    return result;
+}
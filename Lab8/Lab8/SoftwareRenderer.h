@@ -0,0 +1,141 @@
+#ifndef SOFTWARE_RENDERER_H
+#define SOFTWARE_RENDERER_H
+
+#include <DirectXMath.h>
+#include <cstdint>
+#include <vector>
+
+#include "SoftwareRasterizer.h"
+#include "SoftwareTexture.h"
+
+using namespace DirectX;
+
+struct SwPointLight
+{
+    XMFLOAT3 position;
+    float range;
+    XMFLOAT3 color;
+    float intensity;
+};
+
+// Matrices are not transposed: points are transformed as row vectors, like mul(v, M) in the shaders
+struct SwCubeInstance
+{
+    XMFLOAT4X4 model;
+    uint32_t textureIndex;
+};
+
+struct SwColoredInstance
+{
+    XMFLOAT4X4 model;
+    XMFLOAT4 color;
+};
+
+// Everything the hardware passes would read from their constant buffers for one frame
+struct SwSceneFrame
+{
+    XMFLOAT4X4 viewProj;
+    XMFLOAT4X4 invViewProj;
+    XMFLOAT4X4 skyboxViewProj;
+    XMFLOAT3 cameraPos;
+    SwPointLight lights[3];
+    std::vector<SwCubeInstance> cubes;              // visible cubes only
+    std::vector<SwCubeInstance> sceneCubes;         // every cube, for rays that leave the frustum
+    std::vector<SwColoredInstance> markers;
+    std::vector<SwColoredInstance> parallelograms;  // sorted back to front
+    bool negative;
+};
+
+enum class SwMesh { Cube, Skybox, Quad };
+
+// Vertex data as it is uploaded to the GPU: position, then normal and uv when floatsPerVertex is 8.
+// Without indices the vertices form a plain triangle list.
+struct SwMeshData
+{
+    const float* pVertices;
+    uint32_t floatsPerVertex;
+    uint32_t vertexCount;
+    const uint16_t* pIndices;
+    uint32_t indexCount;
+};
+
+struct SwBenchmarkResult
+{
+    uint32_t width;
+    uint32_t height;
+    uint32_t frames;
+    uint32_t threads;
+    double msPerFrame;
+    double fps;
+};
+
+// Draws the Lab8 scene on the CPU: C++ versions of the vertex and pixel shaders
+// (ColorVertex/ColorPixel, SkyboxVertex/SkyboxPixel, InstancedVertex with LightPixel and
+// ParallelogramPixel, NegativePixel) running on SoftwareRasterizer with the same states.
+class SoftwareRenderer
+{
+public:
+    SoftwareRenderer() : m_pPool(nullptr) {}
+
+    // Loads CPU copies of the scene textures; the meshes are handed over by SetMesh
+    bool Init(ThreadPool* pPool);
+    void SetMesh(SwMesh mesh, const SwMeshData& data);
+
+    void Render(const SwSceneFrame& frame, uint32_t width, uint32_t height);
+    SwBenchmarkResult Benchmark(const SwSceneFrame& frame, uint32_t width, uint32_t height, uint32_t frameCount);
+
+    const SoftwareRasterizer& GetRasterizer() const { return m_rasterizer; }
+
+private:
+    struct MeshVertex
+    {
+        float position[3];
+        float normal[3];
+        float uv[2];
+    };
+
+    struct Mesh
+    {
+        std::vector<MeshVertex> vertices;
+        std::vector<uint16_t> indices;
+    };
+
+    struct CubeConstants
+    {
+        const SoftwareTexture* pDiffuse;
+        const SoftwareTexture* pNormalMap;
+        const SwPointLight* pLights;
+        XMFLOAT3 cameraPos;
+        uint32_t textureIndex;
+    };
+
+    struct ColorConstants
+    {
+        const SwPointLight* pLights;
+        XMFLOAT4 color;
+    };
+
+    static SwColor LitCubeKernel(const SwPixelQuad& quad, const void* pConstants);
+    static SwColor MarkerKernel(const SwPixelQuad& quad, const void* pConstants);
+    static SwColor ParallelogramKernel(const SwPixelQuad& quad, const void* pConstants);
+
+    void DrawSkybox(const SwSceneFrame& frame);
+    void DrawCubes(const SwSceneFrame& frame);
+    void DrawColored(const std::vector<SwColoredInstance>& instances, const Mesh& mesh,
+        const SwPipelineState& state, const SwSceneFrame& frame);
+
+    ThreadPool* m_pPool;
+    SoftwareRasterizer m_rasterizer;
+
+    Mesh m_meshes[3];
+    SoftwareTexture m_diffuse;
+    SoftwareTexture m_normalMap;
+    SoftwareTexture m_skybox;
+
+    // Per-draw constants must outlive Flush, so they live here instead of on the stack
+    std::vector<SwVertex> m_vertices;
+    std::vector<CubeConstants> m_cubeConstants;
+    std::vector<ColorConstants> m_colorConstants;
+};
+
+#endif
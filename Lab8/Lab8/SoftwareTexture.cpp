@@ -0,0 +1,173 @@
+#include "SoftwareTexture.h"
+#include "BlockDecoder.h"
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    __m128 UnpackTexel(uint32_t texel)
+    {
+        __m128i zero = _mm_setzero_si128();
+        __m128i value = _mm_cvtsi32_si128(static_cast<int>(texel));
+        value = _mm_unpacklo_epi8(value, zero);
+        value = _mm_unpacklo_epi16(value, zero);
+        return _mm_cvtepi32_ps(value);
+    }
+
+    uint32_t WrapCoord(int coord, uint32_t size)
+    {
+        int wrapped = coord % static_cast<int>(size);
+        return static_cast<uint32_t>(wrapped < 0 ? wrapped + static_cast<int>(size) : wrapped);
+    }
+
+    uint32_t ClampCoord(int coord, uint32_t size)
+    {
+        if (coord < 0) return 0;
+        if (coord >= static_cast<int>(size)) return size - 1;
+        return static_cast<uint32_t>(coord);
+    }
+}
+
+bool SoftwareTexture::LoadDDS(const char* path, ThreadPool* pPool)
+{
+    BlockDecoder decoder;
+    decoder.SetThreadPool(pPool);
+    DecodedTexture texture;
+    if (!decoder.DecodeFile(path, DecodeTarget::RGBA8, texture) || texture.depth > 1)
+        return false;
+
+    std::vector<std::vector<Image>> slices(texture.arraySize);
+    for (uint32_t slice = 0; slice < texture.arraySize; slice++)
+    {
+        for (uint32_t mip = 0; mip < texture.mipCount; mip++)
+        {
+            const DecodedSubresource& subresource = texture.subresources[slice * texture.mipCount + mip];
+            Image image;
+            image.width = subresource.width;
+            image.height = subresource.height;
+            image.texels.resize(static_cast<size_t>(subresource.width) * subresource.height);
+            memcpy(image.texels.data(), texture.data.data() + subresource.offset, image.texels.size() * sizeof(uint32_t));
+            slices[slice].push_back(std::move(image));
+        }
+    }
+
+    m_slices = std::move(slices);
+    m_isCube = texture.isCubeMap;
+    return true;
+}
+
+bool SoftwareTexture::AppendSlices(const SoftwareTexture& other)
+{
+    if (!m_slices.empty() &&
+        (other.GetWidth() != GetWidth() || other.GetHeight() != GetHeight() || other.GetMipCount() != GetMipCount()))
+        return false;
+
+    m_slices.insert(m_slices.end(), other.m_slices.begin(), other.m_slices.end());
+    m_isCube = false;
+    return true;
+}
+
+__m128 SoftwareTexture::SampleBilinear(const Image& image, float u, float v, bool wrap) const
+{
+    float x = u * image.width - 0.5f;
+    float y = v * image.height - 0.5f;
+    float fx0 = floorf(x);
+    float fy0 = floorf(y);
+    float fx = x - fx0;
+    float fy = y - fy0;
+    int x0 = static_cast<int>(fx0);
+    int y0 = static_cast<int>(fy0);
+
+    uint32_t xa, xb, ya, yb;
+    if (wrap)
+    {
+        xa = WrapCoord(x0, image.width);
+        xb = WrapCoord(x0 + 1, image.width);
+        ya = WrapCoord(y0, image.height);
+        yb = WrapCoord(y0 + 1, image.height);
+    }
+    else
+    {
+        xa = ClampCoord(x0, image.width);
+        xb = ClampCoord(x0 + 1, image.width);
+        ya = ClampCoord(y0, image.height);
+        yb = ClampCoord(y0 + 1, image.height);
+    }
+
+    const uint32_t* rowA = image.texels.data() + static_cast<size_t>(ya) * image.width;
+    const uint32_t* rowB = image.texels.data() + static_cast<size_t>(yb) * image.width;
+
+    __m128 wx = _mm_set1_ps(fx);
+    __m128 wy = _mm_set1_ps(fy);
+    __m128 t00 = UnpackTexel(rowA[xa]);
+    __m128 t10 = UnpackTexel(rowA[xb]);
+    __m128 t01 = UnpackTexel(rowB[xa]);
+    __m128 t11 = UnpackTexel(rowB[xb]);
+
+    __m128 top = _mm_add_ps(t00, _mm_mul_ps(_mm_sub_ps(t10, t00), wx));
+    __m128 bottom = _mm_add_ps(t01, _mm_mul_ps(_mm_sub_ps(t11, t01), wx));
+    __m128 result = _mm_add_ps(top, _mm_mul_ps(_mm_sub_ps(bottom, top), wy));
+    return _mm_mul_ps(result, _mm_set1_ps(1.0f / 255.0f));
+}
+
+__m128 SoftwareTexture::Sample(float u, float v, uint32_t slice, float lod) const
+{
+    if (m_slices.empty())
+        return _mm_setzero_ps();
+    if (slice >= m_slices.size())
+        slice = static_cast<uint32_t>(m_slices.size()) - 1;
+    if (!(u == u) || !(v == v))
+        u = v = 0.0f;
+
+    const std::vector<Image>& mips = m_slices[slice];
+    float maxLod = static_cast<float>(mips.size() - 1);
+    if (!(lod > 0.0f))
+        return SampleBilinear(mips[0], u, v, true);
+    if (lod >= maxLod)
+        return SampleBilinear(mips.back(), u, v, true);
+
+    uint32_t level = static_cast<uint32_t>(lod);
+    float blend = lod - static_cast<float>(level);
+    __m128 a = SampleBilinear(mips[level], u, v, true);
+    __m128 b = SampleBilinear(mips[level + 1], u, v, true);
+    return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), _mm_set1_ps(blend)));
+}
+
+__m128 SoftwareTexture::SampleCube(float x, float y, float z) const
+{
+    if (m_slices.size() < 6)
+        return _mm_setzero_ps();
+
+    // Face selection and face coordinates follow the D3D cube map convention
+    float ax = fabsf(x), ay = fabsf(y), az = fabsf(z);
+    uint32_t face;
+    float sc, tc, ma;
+    if (ax >= ay && ax >= az)
+    {
+        face = x >= 0.0f ? 0 : 1;
+        sc = x >= 0.0f ? -z : z;
+        tc = -y;
+        ma = ax;
+    }
+    else if (ay >= az)
+    {
+        face = y >= 0.0f ? 2 : 3;
+        sc = x;
+        tc = y >= 0.0f ? z : -z;
+        ma = ay;
+    }
+    else
+    {
+        face = z >= 0.0f ? 4 : 5;
+        sc = z >= 0.0f ? x : -x;
+        tc = -y;
+        ma = az;
+    }
+
+    if (ma <= 0.0f)
+        return _mm_setzero_ps();
+
+    float u = 0.5f * (sc / ma + 1.0f);
+    float v = 0.5f * (tc / ma + 1.0f);
+    return SampleBilinear(m_slices[face][0], u, v, false);
+}
@@ -0,0 +1,52 @@
+#ifndef SOFTWARE_TEXTURE_H
+#define SOFTWARE_TEXTURE_H
+
+#include <emmintrin.h>
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+// CPU copy of a texture for the software rasterizer: RGBA8 texels (R in the low byte),
+// full mip chain per slice. Slices are array layers, or the six faces of a cube map.
+class SoftwareTexture
+{
+public:
+    SoftwareTexture() : m_isCube(false) {}
+
+    // Reads every format BlockDecoder does, 2D textures, arrays or cube maps; the blocks are
+    // decoded on the pool when one is given
+    bool LoadDDS(const char* path, ThreadPool* pPool = nullptr);
+    // Appends the slices of another texture with the same size, like Init2DArray does on the GPU
+    bool AppendSlices(const SoftwareTexture& other);
+
+    uint32_t GetWidth() const { return m_slices.empty() ? 0 : m_slices[0][0].width; }
+    uint32_t GetHeight() const { return m_slices.empty() ? 0 : m_slices[0][0].height; }
+    uint32_t GetMipCount() const { return m_slices.empty() ? 0 : static_cast<uint32_t>(m_slices[0].size()); }
+    uint32_t GetSliceCount() const { return static_cast<uint32_t>(m_slices.size()); }
+    bool IsCube() const { return m_isCube; }
+    uint32_t GetMipWidth(uint32_t mip) const { return m_slices[0][mip].width; }
+    uint32_t GetMipHeight(uint32_t mip) const { return m_slices[0][mip].height; }
+    // RGBA8 texels of one mip, rows tightly packed
+    const std::vector<uint32_t>& GetTexels(uint32_t slice, uint32_t mip) const { return m_slices[slice][mip].texels; }
+
+    // Trilinear, wrap addressing (the sampler used by every pass). Result is r, g, b, a in [0, 1].
+    __m128 Sample(float u, float v, uint32_t slice, float lod) const;
+    // Bilinear lookup of the top mip of a cube map by direction
+    __m128 SampleCube(float x, float y, float z) const;
+
+private:
+    struct Image
+    {
+        uint32_t width;
+        uint32_t height;
+        std::vector<uint32_t> texels;
+    };
+
+    __m128 SampleBilinear(const Image& image, float u, float v, bool wrap) const;
+
+    std::vector<std::vector<Image>> m_slices;
+    bool m_isCube;
+};
+
+#endif
@@ -0,0 +1,1287 @@
+#include "TextureCooker.h"
+#include "DDSLayout.h"
+#include "Profiler.h"
+#include "SoftwareRasterizer.h"
+#include "SoftwareTexture.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+
+using namespace DirectX::DDSLayout;
+
+namespace
+{
+    const uint32_t BandRows = 8;        // block rows per task
+
+    // Interpolation weights of 4 bit BC7 indices, out of 64
+    const uint32_t Bc7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    void RunParallel(ThreadPool* pPool, uint32_t count, const std::function<void(uint32_t)>& task)
+    {
+        if (pPool)
+            pPool->ParallelFor(count, [&task](uint32_t index, uint32_t) { task(index); });
+        else
+        {
+            for (uint32_t i = 0; i < count; i++)
+                task(i);
+        }
+    }
+
+    // The sixteen texels of a block, one register per channel and block row
+    struct BlockTexels
+    {
+        SwFloat channels[4][4];     // [channel][row]
+    };
+
+    void LoadBlock(const uint32_t texels[16], BlockTexels& block)
+    {
+        const __m128i byteMask = _mm_set1_epi32(0xFF);
+        for (uint32_t row = 0; row < 4; row++)
+        {
+            __m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(texels + row * 4));
+            for (uint32_t channel = 0; channel < 4; channel++)
+            {
+                __m128i value = _mm_and_si128(_mm_srl_epi32(packed, _mm_cvtsi32_si128(static_cast<int>(8 * channel))), byteMask);
+                block.channels[channel][row] = _mm_cvtepi32_ps(value);
+            }
+        }
+    }
+
+    float Sum(const SwFloat& value)
+    {
+        alignas(16) float lanes[4];
+        _mm_store_ps(lanes, value.v);
+        return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    }
+
+    float Smallest(const SwFloat& value)
+    {
+        alignas(16) float lanes[4];
+        _mm_store_ps(lanes, value.v);
+        return std::min(std::min(lanes[0], lanes[1]), std::min(lanes[2], lanes[3]));
+    }
+
+    float Largest(const SwFloat& value)
+    {
+        alignas(16) float lanes[4];
+        _mm_store_ps(lanes, value.v);
+        return std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+    }
+
+    // Nearest palette entry of every texel by weighted squared distance. Texels of weight 0
+    // still get an index but add nothing to the returned error.
+    float FindIndices(const BlockTexels& block, const float (*pPalette)[4], uint32_t count, const float weights[4],
+        const SwFloat texelWeights[4], uint8_t indices[16])
+    {
+        SwFloat total(0.0f);
+        for (uint32_t row = 0; row < 4; row++)
+        {
+            SwFloat best(FLT_MAX);
+            SwFloat bestIndex(0.0f);
+            for (uint32_t entry = 0; entry < count; entry++)
+            {
+                SwFloat distance(0.0f);
+                for (uint32_t channel = 0; channel < 4; channel++)
+                {
+                    if (weights[channel] == 0.0f)
+                        continue;
+                    SwFloat difference = block.channels[channel][row] - SwFloat(pPalette[entry][channel]);
+                    distance += difference * difference * SwFloat(weights[channel]);
+                }
+                SwFloat closer = _mm_cmplt_ps(distance.v, best.v);
+                best = Min(best, distance);
+                bestIndex = Select(closer, SwFloat(static_cast<float>(entry)), bestIndex);
+            }
+            total += best * texelWeights[row];
+
+            alignas(16) int32_t lanes[4];
+            _mm_store_si128(reinterpret_cast<__m128i*>(lanes), _mm_cvttps_epi32(bestIndex.v));
+            for (uint32_t lane = 0; lane < 4; lane++)
+                indices[row * 4 + lane] = static_cast<uint8_t>(lanes[lane]);
+        }
+        return Sum(total);
+    }
+
+    // Weighted mean and principal axis of the first channelCount channels; the axis is zero
+    // when every weighted texel has the same value
+    void FitAxis(const BlockTexels& block, const SwFloat texelWeights[4], uint32_t channelCount, float mean[4], float axis[4])
+    {
+        SwFloat weightSum(0.0f);
+        SwFloat sums[4];
+        SwFloat products[4][4];
+        for (uint32_t row = 0; row < 4; row++)
+        {
+            weightSum += texelWeights[row];
+            for (uint32_t c = 0; c < channelCount; c++)
+            {
+                SwFloat weighted = block.channels[c][row] * texelWeights[row];
+                sums[c] += weighted;
+                for (uint32_t d = c; d < channelCount; d++)
+                    products[c][d] += weighted * block.channels[d][row];
+            }
+        }
+
+        float covariance[4][4] = {};
+        float total = Sum(weightSum);
+        for (uint32_t c = 0; c < 4; c++)
+        {
+            mean[c] = c < channelCount && total > 0.0f ? Sum(sums[c]) / total : 0.0f;
+            axis[c] = 0.0f;
+        }
+        if (total <= 0.0f)
+            return;
+        for (uint32_t c = 0; c < channelCount; c++)
+        {
+            for (uint32_t d = c; d < channelCount; d++)
+            {
+                covariance[c][d] = Sum(products[c][d]) / total - mean[c] * mean[d];
+                covariance[d][c] = covariance[c][d];
+            }
+        }
+
+        // Power iteration from the row of the widest channel
+        uint32_t widest = 0;
+        for (uint32_t c = 1; c < channelCount; c++)
+        {
+            if (covariance[c][c] > covariance[widest][widest])
+                widest = c;
+        }
+        if (covariance[widest][widest] < 1.0e-4f)
+            return;
+        for (uint32_t c = 0; c < channelCount; c++)
+            axis[c] = covariance[widest][c];
+        for (uint32_t iteration = 0; iteration < 8; iteration++)
+        {
+            float next[4] = {};
+            float length = 0.0f;
+            for (uint32_t c = 0; c < channelCount; c++)
+            {
+                for (uint32_t d = 0; d < channelCount; d++)
+                    next[c] += covariance[c][d] * axis[d];
+                length += next[c] * next[c];
+            }
+            if (length < 1.0e-12f)
+                break;
+            float invLength = 1.0f / sqrtf(length);
+            for (uint32_t c = 0; c < channelCount; c++)
+                axis[c] = next[c] * invLength;
+        }
+    }
+
+    // Extremes of the weighted texels along the axis, mean + axis * low and mean + axis * high
+    void AxisEndpoints(const BlockTexels& block, const SwFloat texelWeights[4], uint32_t channelCount,
+        const float mean[4], const float axis[4], float low[4], float high[4])
+    {
+        SwFloat lowest(FLT_MAX);
+        SwFloat highest(-FLT_MAX);
+        for (uint32_t row = 0; row < 4; row++)
+        {
+            SwFloat t(0.0f);
+            for (uint32_t c = 0; c < channelCount; c++)
+                t += (block.channels[c][row] - SwFloat(mean[c])) * SwFloat(axis[c]);
+            SwFloat used = _mm_cmpgt_ps(texelWeights[row].v, _mm_setzero_ps());
+            lowest = Min(lowest, Select(used, t, SwFloat(FLT_MAX)));
+            highest = Max(highest, Select(used, t, SwFloat(-FLT_MAX)));
+        }
+        float tLow = Smallest(lowest);
+        float tHigh = Largest(highest);
+        for (uint32_t c = 0; c < 4; c++)
+        {
+            low[c] = std::min(std::max(mean[c] + axis[c] * tLow, 0.0f), 255.0f);
+            high[c] = std::min(std::max(mean[c] + axis[c] * tHigh, 0.0f), 255.0f);
+        }
+    }
+
+    // Least squares endpoints for fixed indices, shares[index] is the weight of endpoint 0
+    bool RefitEndpoints(const BlockTexels& block, const SwFloat texelWeights[4], uint32_t channelCount,
+        const float* shares, const uint8_t indices[16], float e0[4], float e1[4])
+    {
+        SwFloat aa, ab, bb;
+        SwFloat ax[4], bx[4];
+        for (uint32_t row = 0; row < 4; row++)
+        {
+            alignas(16) float lanes[4];
+            for (uint32_t lane = 0; lane < 4; lane++)
+                lanes[lane] = shares[indices[row * 4 + lane]];
+            SwFloat a = _mm_load_ps(lanes);
+            SwFloat b = SwFloat(1.0f) - a;
+            SwFloat wa = a * texelWeights[row];
+            SwFloat wb = b * texelWeights[row];
+            aa += wa * a;
+            ab += wa * b;
+            bb += wb * b;
+            for (uint32_t c = 0; c < channelCount; c++)
+            {
+                ax[c] += wa * block.channels[c][row];
+                bx[c] += wb * block.channels[c][row];
+            }
+        }
+
+        float sumAA = Sum(aa);
+        float sumAB = Sum(ab);
+        float sumBB = Sum(bb);
+        float determinant = sumAA * sumBB - sumAB * sumAB;
+        if (fabsf(determinant) < 1.0e-6f)
+            return false;
+        float invDeterminant = 1.0f / determinant;
+        for (uint32_t c = 0; c < channelCount; c++)
+        {
+            float sumAX = Sum(ax[c]);
+            float sumBX = Sum(bx[c]);
+            e0[c] = std::min(std::max((sumBB * sumAX - sumAB * sumBX) * invDeterminant, 0.0f), 255.0f);
+            e1[c] = std::min(std::max((sumAA * sumBX - sumAB * sumAX) * invDeterminant, 0.0f), 255.0f);
+        }
+        return true;
+    }
+
+    uint16_t To565(const float color[4])
+    {
+        uint32_t r = static_cast<uint32_t>(color[0] * (31.0f / 255.0f) + 0.5f);
+        uint32_t g = static_cast<uint32_t>(color[1] * (63.0f / 255.0f) + 0.5f);
+        uint32_t b = static_cast<uint32_t>(color[2] * (31.0f / 255.0f) + 0.5f);
+        return static_cast<uint16_t>((std::min(r, 31u) << 11) | (std::min(g, 63u) << 5) | std::min(b, 31u));
+    }
+
+    void Expand565(uint16_t color, uint32_t rgb[3])
+    {
+        uint32_t r = (color >> 11) & 0x1F;
+        uint32_t g = (color >> 5) & 0x3F;
+        uint32_t b = color & 0x1F;
+        rgb[0] = (r << 3) | (r >> 2);
+        rgb[1] = (g << 2) | (g >> 4);
+        rgb[2] = (b << 3) | (b >> 2);
+    }
+
+    // Integer palette of a BC1 colour block, the arithmetic of SoftwareTexture
+    void ColorPalette(uint16_t c0, uint16_t c1, bool threeColor, uint32_t palette[4][3])
+    {
+        Expand565(c0, palette[0]);
+        Expand565(c1, palette[1]);
+        for (uint32_t c = 0; c < 3; c++)
+        {
+            if (threeColor)
+            {
+                palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+                palette[3][c] = 0;
+            }
+            else
+            {
+                palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+            }
+        }
+    }
+
+    void ColorPaletteFloat(uint16_t c0, uint16_t c1, bool threeColor, float palette[4][4])
+    {
+        uint32_t integer[4][3];
+        ColorPalette(c0, c1, threeColor, integer);
+        for (uint32_t entry = 0; entry < 4; entry++)
+        {
+            for (uint32_t c = 0; c < 3; c++)
+                palette[entry][c] = static_cast<float>(integer[entry][c]);
+            palette[entry][3] = 0.0f;
+        }
+    }
+
+    void WriteU16(uint8_t* p, uint16_t value)
+    {
+        p[0] = static_cast<uint8_t>(value);
+        p[1] = static_cast<uint8_t>(value >> 8);
+    }
+
+    // BC1 colour block. With punchThrough texels below half alpha take the transparent index
+    // of the three colour mode; BC3 decodes its colour block in four colour mode only.
+    void CompressColorBlock(const BlockTexels& block, bool punchThrough, uint32_t refinePasses, uint8_t* pBlock)
+    {
+        SwFloat texelWeights[4];
+        int transparentMask = 0;
+        for (uint32_t row = 0; row < 4; row++)
+        {
+            SwFloat transparent = punchThrough ? SwFloat(_mm_cmplt_ps(block.channels[3][row].v, _mm_set1_ps(127.5f))) : SwFloat(0.0f);
+            texelWeights[row] = _mm_andnot_ps(transparent.v, _mm_set1_ps(1.0f));
+            transparentMask |= _mm_movemask_ps(transparent.v) << (row * 4);
+        }
+        if (transparentMask == 0xFFFF)
+        {
+            // Equal endpoints select the three colour mode, index 3 everywhere
+            memset(pBlock, 0, 4);
+            memset(pBlock + 4, 0xFF, 4);
+            return;
+        }
+
+        bool threeColor = transparentMask != 0;
+        static const float fourShares[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+        static const float threeShares[3] = { 1.0f, 0.0f, 0.5f };
+        const float* shares = threeColor ? threeShares : fourShares;
+        uint32_t paletteCount = threeColor ? 3 : 4;
+        const float weights[4] = { 1.0f, 1.0f, 1.0f, 0.0f };
+
+        float mean[4], axis[4], e0[4], e1[4];
+        FitAxis(block, texelWeights, 3, mean, axis);
+        AxisEndpoints(block, texelWeights, 3, mean, axis, e1, e0);
+
+        uint16_t best0 = To565(e0);
+        uint16_t best1 = To565(e1);
+        float palette[4][4];
+        ColorPaletteFloat(best0, best1, threeColor, palette);
+        uint8_t bestIndices[16];
+        float bestError = FindIndices(block, palette, paletteCount, weights, texelWeights, bestIndices);
+
+        uint8_t indices[16];
+        memcpy(indices, bestIndices, sizeof(indices));
+        for (uint32_t pass = 0; pass < refinePasses && bestError > 0.0f; pass++)
+        {
+            if (!RefitEndpoints(block, texelWeights, 3, shares, indices, e0, e1))
+                break;
+            uint16_t c0 = To565(e0);
+            uint16_t c1 = To565(e1);
+            if (c0 == best0 && c1 == best1)
+                break;
+            ColorPaletteFloat(c0, c1, threeColor, palette);
+            float error = FindIndices(block, palette, paletteCount, weights, texelWeights, indices);
+            if (error >= bestError)
+                break;
+            bestError = error;
+            best0 = c0;
+            best1 = c1;
+            memcpy(bestIndices, indices, sizeof(indices));
+        }
+
+        // The decoder tells the modes apart by the order of the endpoints
+        if (threeColor)
+        {
+            bool swap = best0 > best1;
+            if (swap)
+                std::swap(best0, best1);
+            for (uint32_t i = 0; i < 16; i++)
+            {
+                if (transparentMask & (1 << i))
+                    bestIndices[i] = 3;
+                else if (swap && bestIndices[i] < 2)
+                    bestIndices[i] ^= 1;
+            }
+        }
+        else if (best0 == best1)
+        {
+            // Both modes decode index 0 to the one colour
+            memset(bestIndices, 0, sizeof(bestIndices));
+        }
+        else if (best0 < best1)
+        {
+            std::swap(best0, best1);
+            for (uint32_t i = 0; i < 16; i++)
+                bestIndices[i] ^= 1;
+        }
+
+        uint32_t packed = 0;
+        for (uint32_t i = 0; i < 16; i++)
+            packed |= static_cast<uint32_t>(bestIndices[i]) << (2 * i);
+        WriteU16(pBlock, best0);
+        WriteU16(pBlock + 2, best1);
+        memcpy(pBlock + 4, &packed, 4);
+    }
+
+    void ChannelPalette(uint32_t a0, uint32_t a1, uint32_t palette[8])
+    {
+        palette[0] = a0;
+        palette[1] = a1;
+        if (a0 > a1)
+        {
+            for (uint32_t i = 1; i < 7; i++)
+                palette[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+        }
+        else
+        {
+            for (uint32_t i = 1; i < 5; i++)
+                palette[i + 1] = ((5 - i) * a0 + i * a1) / 5;
+            palette[6] = 0;
+            palette[7] = 255;
+        }
+    }
+
+    // BC4 block of one channel: the range of the block in the eight value mode, exact nearest indices
+    void CompressChannelBlock(const BlockTexels& block, uint32_t channel, uint8_t* pBlock)
+    {
+        SwFloat lowest(FLT_MAX);
+        SwFloat highest(-FLT_MAX);
+        for (uint32_t row = 0; row < 4; row++)
+        {
+            lowest = Min(lowest, block.channels[channel][row]);
+            highest = Max(highest, block.channels[channel][row]);
+        }
+        uint32_t a0 = static_cast<uint32_t>(Largest(highest));
+        uint32_t a1 = static_cast<uint32_t>(Smallest(lowest));
+
+        uint8_t indices[16] = {};
+        if (a0 > a1)
+        {
+            uint32_t integer[8];
+            ChannelPalette(a0, a1, integer);
+            float palette[8][4] = {};
+            for (uint32_t entry = 0; entry < 8; entry++)
+                palette[entry][channel] = static_cast<float>(integer[entry]);
+            float weights[4] = {};
+            weights[channel] = 1.0f;
+            const SwFloat texelWeights[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+            FindIndices(block, palette, 8, weights, texelWeights, indices);
+        }
+
+        uint64_t packed = 0;
+        for (uint32_t i = 0; i < 16; i++)
+            packed |= static_cast<uint64_t>(indices[i]) << (3 * i);
+        pBlock[0] = static_cast<uint8_t>(a0);
+        pBlock[1] = static_cast<uint8_t>(a1);
+        for (uint32_t i = 0; i < 6; i++)
+            pBlock[2 + i] = static_cast<uint8_t>(packed >> (8 * i));
+    }
+
+    // BC7 endpoint as 7 bit channels and the p-bit shared by them, whichever p-bit is closer
+    void QuantizeEndpoint(const float color[4], uint32_t quantized[4], uint32_t& pBit)
+    {
+        float bestError = FLT_MAX;
+        for (uint32_t p = 0; p < 2; p++)
+        {
+            uint32_t candidate[4];
+            float error = 0.0f;
+            for (uint32_t c = 0; c < 4; c++)
+            {
+                float q = floorf((color[c] - p) * 0.5f + 0.5f);
+                candidate[c] = static_cast<uint32_t>(std::min(std::max(q, 0.0f), 127.0f));
+                float difference = color[c] - static_cast<float>(candidate[c] * 2 + p);
+                error += difference * difference;
+            }
+            if (error < bestError)
+            {
+                bestError = error;
+                pBit = p;
+                memcpy(quantized, candidate, sizeof(candidate));
+            }
+        }
+    }
+
+    void Mode6Palette(const uint32_t q0[4], uint32_t p0, const uint32_t q1[4], uint32_t p1, uint32_t palette[16][4])
+    {
+        for (uint32_t c = 0; c < 4; c++)
+        {
+            uint32_t e0 = q0[c] * 2 + p0;
+            uint32_t e1 = q1[c] * 2 + p1;
+            for (uint32_t i = 0; i < 16; i++)
+                palette[i][c] = ((64 - Bc7Weights[i]) * e0 + Bc7Weights[i] * e1 + 32) >> 6;
+        }
+    }
+
+    float Mode6Error(const BlockTexels& block, const float e0[4], const float e1[4], uint32_t q0[4], uint32_t& p0,
+        uint32_t q1[4], uint32_t& p1, uint8_t indices[16])
+    {
+        QuantizeEndpoint(e0, q0, p0);
+        QuantizeEndpoint(e1, q1, p1);
+        uint32_t integer[16][4];
+        Mode6Palette(q0, p0, q1, p1, integer);
+        float palette[16][4];
+        for (uint32_t i = 0; i < 16; i++)
+        {
+            for (uint32_t c = 0; c < 4; c++)
+                palette[i][c] = static_cast<float>(integer[i][c]);
+        }
+        const float weights[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+        const SwFloat texelWeights[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+        return FindIndices(block, palette, 16, weights, texelWeights, indices);
+    }
+
+    struct BitWriter
+    {
+        uint8_t* pBlock;
+        uint32_t position;
+
+        void Write(uint32_t value, uint32_t bits)
+        {
+            for (uint32_t i = 0; i < bits; i++, position++)
+            {
+                if (value & (1u << i))
+                    pBlock[position >> 3] |= static_cast<uint8_t>(1u << (position & 7));
+            }
+        }
+    };
+
+    struct BitReader
+    {
+        const uint8_t* pBlock;
+        uint32_t position;
+
+        uint32_t Read(uint32_t bits)
+        {
+            uint32_t value = 0;
+            for (uint32_t i = 0; i < bits; i++, position++)
+                value |= static_cast<uint32_t>((pBlock[position >> 3] >> (position & 7)) & 1) << i;
+            return value;
+        }
+    };
+
+    // BC7 mode 6: RGBA endpoints along the principal axis of all four channels
+    void CompressMode6Block(const BlockTexels& block, uint32_t refinePasses, uint8_t* pBlock)
+    {
+        const SwFloat texelWeights[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+        float mean[4], axis[4], e0[4], e1[4];
+        FitAxis(block, texelWeights, 4, mean, axis);
+        AxisEndpoints(block, texelWeights, 4, mean, axis, e0, e1);
+
+        uint32_t best0[4], best1[4], bestP0 = 0, bestP1 = 0;
+        uint8_t bestIndices[16];
+        float bestError = Mode6Error(block, e0, e1, best0, bestP0, best1, bestP1, bestIndices);
+
+        float shares[16];
+        for (uint32_t i = 0; i < 16; i++)
+            shares[i] = 1.0f - Bc7Weights[i] / 64.0f;
+        uint8_t indices[16];
+        memcpy(indices, bestIndices, sizeof(indices));
+        for (uint32_t pass = 0; pass < refinePasses && bestError > 0.0f; pass++)
+        {
+            if (!RefitEndpoints(block, texelWeights, 4, shares, indices, e0, e1))
+                break;
+            uint32_t q0[4], q1[4], p0 = 0, p1 = 0;
+            float error = Mode6Error(block, e0, e1, q0, p0, q1, p1, indices);
+            if (error >= bestError)
+                break;
+            bestError = error;
+            memcpy(best0, q0, sizeof(q0));
+            memcpy(best1, q1, sizeof(q1));
+            bestP0 = p0;
+            bestP1 = p1;
+            memcpy(bestIndices, indices, sizeof(indices));
+        }
+
+        // The index of texel 0 is stored without its top bit, which has to be clear
+        if (bestIndices[0] >= 8)
+        {
+            std::swap(best0, best1);
+            std::swap(bestP0, bestP1);
+            for (uint32_t i = 0; i < 16; i++)
+                bestIndices[i] = static_cast<uint8_t>(15 - bestIndices[i]);
+        }
+
+        memset(pBlock, 0, 16);
+        BitWriter writer = { pBlock, 0 };
+        writer.Write(1u << 6, 7);
+        for (uint32_t c = 0; c < 4; c++)
+        {
+            writer.Write(best0[c], 7);
+            writer.Write(best1[c], 7);
+        }
+        writer.Write(bestP0, 1);
+        writer.Write(bestP1, 1);
+        writer.Write(bestIndices[0], 3);
+        for (uint32_t i = 1; i < 16; i++)
+            writer.Write(bestIndices[i], 4);
+    }
+
+    void DecodeColorBlock(const uint8_t* pBlock, bool punchThrough, uint32_t texels[16])
+    {
+        uint16_t c0 = static_cast<uint16_t>(pBlock[0] | (pBlock[1] << 8));
+        uint16_t c1 = static_cast<uint16_t>(pBlock[2] | (pBlock[3] << 8));
+        bool threeColor = punchThrough && c0 <= c1;
+        uint32_t palette[4][3];
+        ColorPalette(c0, c1, threeColor, palette);
+        uint32_t packed;
+        memcpy(&packed, pBlock + 4, 4);
+        for (uint32_t i = 0; i < 16; i++)
+        {
+            uint32_t index = (packed >> (2 * i)) & 3;
+            const uint32_t* color = palette[index];
+            uint32_t alpha = threeColor && index == 3 ? 0u : 255u;
+            texels[i] = color[0] | (color[1] << 8) | (color[2] << 16) | (alpha << 24);
+        }
+    }
+
+    void DecodeChannelBlock(const uint8_t* pBlock, uint32_t values[16])
+    {
+        uint32_t palette[8];
+        ChannelPalette(pBlock[0], pBlock[1], palette);
+        uint64_t packed = 0;
+        for (uint32_t i = 0; i < 6; i++)
+            packed |= static_cast<uint64_t>(pBlock[2 + i]) << (8 * i);
+        for (uint32_t i = 0; i < 16; i++)
+            values[i] = palette[(packed >> (3 * i)) & 7];
+    }
+
+    bool DecodeMode6Block(const uint8_t* pBlock, uint32_t texels[16])
+    {
+        BitReader reader = { pBlock, 0 };
+        if (reader.Read(7) != (1u << 6))
+            return false;
+        uint32_t q0[4], q1[4];
+        for (uint32_t c = 0; c < 4; c++)
+        {
+            q0[c] = reader.Read(7);
+            q1[c] = reader.Read(7);
+        }
+        uint32_t p0 = reader.Read(1);
+        uint32_t p1 = reader.Read(1);
+        uint32_t palette[16][4];
+        Mode6Palette(q0, p0, q1, p1, palette);
+        for (uint32_t i = 0; i < 16; i++)
+        {
+            const uint32_t* color = palette[reader.Read(i == 0 ? 3 : 4)];
+            texels[i] = color[0] | (color[1] << 8) | (color[2] << 16) | (color[3] << 24);
+        }
+        return true;
+    }
+
+    uint32_t EncodeNormal(const float normal[3])
+    {
+        uint32_t texel = 0xFF000000u;
+        for (uint32_t c = 0; c < 3; c++)
+        {
+            float value = std::min(std::max(normal[c] * 127.5f + 128.0f, 0.0f), 255.0f);
+            texel |= static_cast<uint32_t>(value) << (8 * c);
+        }
+        return texel;
+    }
+
+    // Unit length again after block decoding or filtering, Z of a tangent space normal kept positive
+    void RenormalizeNormals(CookImage& image)
+    {
+        for (uint32_t& texel : image.texels)
+        {
+            float normal[3];
+            for (uint32_t c = 0; c < 3; c++)
+                normal[c] = ((texel >> (8 * c)) & 0xFF) * (2.0f / 255.0f) - 1.0f;
+            normal[2] = std::max(normal[2], 0.0f);
+            float lengthSq = normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2];
+            if (lengthSq < 1.0e-8f)
+            {
+                normal[0] = normal[1] = 0.0f;
+                normal[2] = lengthSq = 1.0f;
+            }
+            float invLength = 1.0f / sqrtf(lengthSq);
+            for (uint32_t c = 0; c < 3; c++)
+                normal[c] *= invLength;
+            texel = EncodeNormal(normal);
+        }
+    }
+
+    // The top mip repeated over size x size, one slice, no mips
+    std::vector<std::vector<CookImage>> TileTopMip(const SoftwareTexture& texture, uint32_t size)
+    {
+        std::vector<std::vector<CookImage>> slices(1);
+        CookImage image = { size, size, std::vector<uint32_t>(static_cast<size_t>(size) * size) };
+        const std::vector<uint32_t>& texels = texture.GetTexels(0, 0);
+        uint32_t width = texture.GetWidth();
+        uint32_t height = texture.GetHeight();
+        for (uint32_t y = 0; y < size; y++)
+        {
+            for (uint32_t x = 0; x < size; x++)
+                image.texels[static_cast<size_t>(y) * size + x] = texels[static_cast<size_t>(y % height) * width + x % width];
+        }
+        slices[0].push_back(std::move(image));
+        return slices;
+    }
+
+    bool WriteBytes(const char* path, const std::vector<uint8_t>& bytes)
+    {
+        FILE* file = nullptr;
+#ifdef _MSC_VER
+        if (fopen_s(&file, path, "wb") != 0)
+            file = nullptr;
+#else
+        file = fopen(path, "wb");
+#endif
+        if (!file)
+            return false;
+        bool ok = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+        return fclose(file) == 0 && ok;
+    }
+}
+
+namespace
+{
+    // Decoded normals of one size x size source against its reference normals: BC1 with the Z it
+    // stores, then BC1 and BC5 with Z rebuilt on the SIMD path and checked against the scalar one
+    void MeasureNormalFormats(ThreadPool* pPool, const std::vector<std::vector<CookImage>>& source,
+        const std::vector<float>& reference, NormalSourceResult& result)
+    {
+        TextureCooker cooker;
+        cooker.SetThreadPool(pPool);
+        std::vector<uint8_t> bc1Data;
+        std::vector<uint8_t> bc5Data;
+        TextureCookSettings bc1Settings = { BlockFormat::BC1, 2, false, true, MipFilter::Box, false };
+        TextureCookSettings bc5Settings = { BlockFormat::BC5, 2, false, true, MipFilter::Box, false };
+        if (!cooker.Compress(source, false, bc1Settings, bc1Data) || !cooker.Compress(source, false, bc5Settings, bc5Data))
+            return;
+
+        uint32_t size = source[0][0].width;
+        uint32_t blocksX = size / 4;
+        uint32_t blockCount = blocksX * blocksX;
+        std::vector<float> decoded(static_cast<size_t>(blockCount) * 48);     // normals[component][texel] per block
+
+        auto measure = [&](NormalDecodeResult& format)
+        {
+            double angleSum = 0.0;
+            for (uint32_t block = 0; block < blockCount; block++)
+            {
+                const float* pNormals = decoded.data() + static_cast<size_t>(block) * 48;
+                for (uint32_t i = 0; i < 16; i++)
+                {
+                    size_t texel = static_cast<size_t>((block / blocksX) * 4 + i / 4) * size + (block % blocksX) * 4 + i % 4;
+                    const float* pReference = reference.data() + texel * 3;
+                    float cosine = pNormals[i] * pReference[0] + pNormals[16 + i] * pReference[1] + pNormals[32 + i] * pReference[2];
+                    double angle = acos(std::min(std::max(static_cast<double>(cosine), -1.0), 1.0)) * (180.0 / 3.14159265358979);
+                    angleSum += angle;
+                    format.maxAngle = std::max(format.maxAngle, angle);
+                }
+            }
+            format.meanAngle = angleSum / (static_cast<double>(blockCount) * 16);
+            format.decodeRate = format.decodeSeconds > 0.0 ? blockCount * 16 * 1.0e-6 / format.decodeSeconds : 0.0;
+        };
+
+        result.storedZ.bitsPerTexel = 4;
+        uint64_t start = Profiler::NowNs();
+        for (uint32_t block = 0; block < blockCount; block++)
+        {
+            uint32_t texels[16];
+            TextureCooker::DecompressBlock(BlockFormat::BC1, bc1Data.data() + static_cast<size_t>(block) * 8, texels);
+            float* pNormals = decoded.data() + static_cast<size_t>(block) * 48;
+            for (uint32_t i = 0; i < 16; i++)
+            {
+                float normal[3];
+                for (uint32_t c = 0; c < 3; c++)
+                    normal[c] = ((texels[i] >> (8 * c)) & 0xFF) * (2.0f / 255.0f) - 1.0f;
+                float invLength = 1.0f / sqrtf(std::max(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2], 1.0e-8f));
+                for (uint32_t c = 0; c < 3; c++)
+                    pNormals[c * 16 + i] = normal[c] * invLength;
+            }
+        }
+        result.storedZ.decodeSeconds = (Profiler::NowNs() - start) * 1.0e-9;
+        measure(result.storedZ);
+
+        struct RebuiltFormat
+        {
+            BlockFormat format;
+            const std::vector<uint8_t>* pData;
+            NormalDecodeResult* pResult;
+        };
+        const RebuiltFormat rebuilt[2] = { { BlockFormat::BC1, &bc1Data, &result.bc1 }, { BlockFormat::BC5, &bc5Data, &result.bc5 } };
+        for (const RebuiltFormat& entry : rebuilt)
+        {
+            uint32_t blockBytes = TextureCooker::GetBlockBytes(entry.format);
+            NormalDecodeResult& format = *entry.pResult;
+            format.bitsPerTexel = blockBytes / 2;
+            start = Profiler::NowNs();
+            for (uint32_t block = 0; block < blockCount; block++)
+            {
+                TextureCooker::DecodeNormalBlock(entry.format, entry.pData->data() + static_cast<size_t>(block) * blockBytes,
+                    reinterpret_cast<float(*)[16]>(decoded.data() + static_cast<size_t>(block) * 48));
+            }
+            format.decodeSeconds = (Profiler::NowNs() - start) * 1.0e-9;
+            measure(format);
+
+            for (uint32_t block = 0; block < blockCount; block++)
+            {
+                uint32_t texels[16];
+                TextureCooker::DecompressBlock(entry.format, entry.pData->data() + static_cast<size_t>(block) * blockBytes, texels);
+                const float* pNormals = decoded.data() + static_cast<size_t>(block) * 48;
+                for (uint32_t i = 0; i < 16; i++)
+                {
+                    float normal[3];
+                    TextureCooker::RebuildNormal(texels[i], normal);
+                    for (uint32_t c = 0; c < 3; c++)
+                        format.maxReferenceError = std::max(format.maxReferenceError, fabsf(normal[c] - pNormals[c * 16 + i]));
+                }
+            }
+        }
+    }
+}
+
+TextureCooker::TextureCooker()
+    : m_pPool(nullptr),
+    m_stats()
+{
+}
+
+uint32_t TextureCooker::GetBlockBytes(BlockFormat format)
+{
+    return format == BlockFormat::BC1 ? 8 : 16;
+}
+
+uint32_t TextureCooker::GetDxgiFormat(BlockFormat format)
+{
+    switch (format)
+    {
+    case BlockFormat::BC1: return DXGI_FORMAT_BC1_UNORM;
+    case BlockFormat::BC3: return DXGI_FORMAT_BC3_UNORM;
+    case BlockFormat::BC5: return DXGI_FORMAT_BC5_UNORM;
+    default:               return DXGI_FORMAT_BC7_UNORM;
+    }
+}
+
+const char* TextureCooker::GetFormatName(BlockFormat format)
+{
+    static const char* names[BlockFormatCount] = { "BC1", "BC3", "BC5", "BC7" };
+    return names[static_cast<uint32_t>(format)];
+}
+
+void TextureCooker::CompressBlock(BlockFormat format, const uint32_t texels[16], uint32_t refinePasses, uint8_t* pBlock)
+{
+    BlockTexels block;
+    LoadBlock(texels, block);
+    switch (format)
+    {
+    case BlockFormat::BC1:
+        CompressColorBlock(block, true, refinePasses, pBlock);
+        break;
+    case BlockFormat::BC3:
+        CompressChannelBlock(block, 3, pBlock);
+        CompressColorBlock(block, false, refinePasses, pBlock + 8);
+        break;
+    case BlockFormat::BC5:
+        CompressChannelBlock(block, 0, pBlock);
+        CompressChannelBlock(block, 1, pBlock + 8);
+        break;
+    case BlockFormat::BC7:
+        CompressMode6Block(block, refinePasses, pBlock);
+        break;
+    }
+}
+
+bool TextureCooker::DecompressBlock(BlockFormat format, const uint8_t* pBlock, uint32_t texels[16])
+{
+    switch (format)
+    {
+    case BlockFormat::BC1:
+        DecodeColorBlock(pBlock, true, texels);
+        return true;
+    case BlockFormat::BC3:
+    {
+        uint32_t alpha[16];
+        DecodeChannelBlock(pBlock, alpha);
+        DecodeColorBlock(pBlock + 8, false, texels);
+        for (uint32_t i = 0; i < 16; i++)
+            texels[i] = (texels[i] & 0x00FFFFFFu) | (alpha[i] << 24);
+        return true;
+    }
+    case BlockFormat::BC5:
+    {
+        uint32_t red[16], green[16];
+        DecodeChannelBlock(pBlock, red);
+        DecodeChannelBlock(pBlock + 8, green);
+        for (uint32_t i = 0; i < 16; i++)
+            texels[i] = red[i] | (green[i] << 8) | 0xFF000000u;
+        return true;
+    }
+    default:
+        return DecodeMode6Block(pBlock, texels);
+    }
+}
+
+bool TextureCooker::Compress(const std::vector<std::vector<CookImage>>& slices, bool isCube, const TextureCookSettings& settings,
+    std::vector<uint8_t>& data)
+{
+    m_stats = {};
+    if (slices.empty() || slices[0].empty())
+        return false;
+
+    std::vector<std::vector<CookImage>> normalized;
+    if (settings.normalMap)
+    {
+        normalized = slices;
+        for (std::vector<CookImage>& mips : normalized)
+        {
+            for (CookImage& image : mips)
+                RenormalizeNormals(image);
+        }
+    }
+    const std::vector<std::vector<CookImage>>& sources = settings.normalMap ? normalized : slices;
+
+    // Sources that bring a single mip get their chain from the MipGenerator, all slices at once
+    bool generate = settings.generateMips;
+    for (const std::vector<CookImage>& mips : sources)
+    {
+        if (mips.empty())
+            return false;
+        generate = generate && mips.size() == 1;
+    }
+    std::vector<std::vector<CookImage>> generated;
+    if (generate)
+    {
+        std::vector<CookImage> tops;
+        tops.reserve(sources.size());
+        for (const std::vector<CookImage>& mips : sources)
+            tops.push_back(mips[0]);
+        MipGenerator generator;
+        generator.SetThreadPool(m_pPool);
+        MipGenerateSettings mipSettings = { settings.mipFilter, settings.srgb, settings.normalMap, !isCube };
+        if (!generator.Generate(tops, isCube, mipSettings, generated))
+            return false;
+    }
+    const std::vector<std::vector<CookImage>>& chainSources = generate ? generated : sources;
+    std::vector<std::vector<const CookImage*>> chains(chainSources.size());
+    for (size_t slice = 0; slice < chainSources.size(); slice++)
+    {
+        for (const CookImage& image : chainSources[slice])
+            chains[slice].push_back(&image);
+    }
+
+    // Every slice has the chain of slice 0, every mip half the size of the one above
+    const std::vector<const CookImage*>& first = chains[0];
+    for (const std::vector<const CookImage*>& chain : chains)
+    {
+        if (chain.size() != first.size())
+            return false;
+        for (size_t mip = 0; mip < chain.size(); mip++)
+        {
+            uint32_t width = std::max(first[0]->width >> mip, 1u);
+            uint32_t height = std::max(first[0]->height >> mip, 1u);
+            if (chain[mip]->width != width || chain[mip]->height != height ||
+                chain[mip]->texels.size() != static_cast<size_t>(width) * height)
+            {
+                return false;
+            }
+        }
+    }
+
+    struct Band
+    {
+        const CookImage* pImage;
+        uint32_t firstRow;
+        uint32_t rowCount;
+        size_t offset;
+    };
+    uint32_t blockBytes = GetBlockBytes(settings.format);
+    std::vector<Band> bands;
+    size_t size = 0;
+    for (const std::vector<const CookImage*>& chain : chains)
+    {
+        for (const CookImage* pImage : chain)
+        {
+            uint32_t blocksX = (pImage->width + 3) / 4;
+            uint32_t blocksY = (pImage->height + 3) / 4;
+            for (uint32_t row = 0; row < blocksY; row += BandRows)
+            {
+                Band band = { pImage, row, std::min(BandRows, blocksY - row), size + static_cast<size_t>(row) * blocksX * blockBytes };
+                bands.push_back(band);
+            }
+            size += static_cast<size_t>(blocksX) * blocksY * blockBytes;
+            m_stats.blocks += static_cast<uint64_t>(blocksX) * blocksY;
+            m_stats.texels += static_cast<uint64_t>(pImage->width) * pImage->height;
+        }
+    }
+
+    uint64_t start = Profiler::NowNs();
+    data.assign(size, 0);
+    uint8_t* pData = data.data();
+    RunParallel(m_pPool, static_cast<uint32_t>(bands.size()), [&bands, &settings, blockBytes, pData](uint32_t index)
+    {
+        const Band& band = bands[index];
+        const CookImage& image = *band.pImage;
+        uint32_t blocksX = (image.width + 3) / 4;
+        uint8_t* pBlock = pData + band.offset;
+        for (uint32_t by = band.firstRow; by < band.firstRow + band.rowCount; by++)
+        {
+            for (uint32_t bx = 0; bx < blocksX; bx++, pBlock += blockBytes)
+            {
+                // Edge blocks of small mips repeat the last row and column
+                alignas(16) uint32_t texels[16];
+                for (uint32_t y = 0; y < 4; y++)
+                {
+                    uint32_t sy = std::min(by * 4 + y, image.height - 1);
+                    for (uint32_t x = 0; x < 4; x++)
+                    {
+                        uint32_t sx = std::min(bx * 4 + x, image.width - 1);
+                        texels[y * 4 + x] = image.texels[static_cast<size_t>(sy) * image.width + sx];
+                    }
+                }
+                CompressBlock(settings.format, texels, settings.refinePasses, pBlock);
+            }
+        }
+    });
+
+    m_stats.slices = static_cast<uint32_t>(chains.size());
+    m_stats.mips = static_cast<uint32_t>(first.size());
+    m_stats.bytes = size;
+    m_stats.threads = m_pPool ? m_pPool->GetThreadCount() : 1;
+    m_stats.seconds = (Profiler::NowNs() - start) * 1.0e-9;
+    return true;
+}
+
+void TextureCooker::DecodeNormalBlock(BlockFormat format, const uint8_t* pBlock, float normals[3][16])
+{
+    alignas(16) uint32_t texels[16];
+    if (!DecompressBlock(format, pBlock, texels))
+    {
+        for (uint32_t i = 0; i < 16; i++)
+            texels[i] = 0xFF80FFFFu;   // pass the mode the decoder does not know as the flat normal
+    }
+
+    BlockTexels block;
+    LoadBlock(texels, block);
+    for (uint32_t row = 0; row < 4; row++)
+    {
+        SwFloat x = block.channels[0][row] * SwFloat(2.0f / 255.0f) - SwFloat(1.0f);
+        SwFloat y = block.channels[1][row] * SwFloat(2.0f / 255.0f) - SwFloat(1.0f);
+        SwFloat z = Sqrt(Saturate(SwFloat(1.0f) - x * x - y * y));
+        SwFloat invLength = SwFloat(1.0f) / Sqrt(x * x + y * y + z * z);
+        _mm_storeu_ps(normals[0] + row * 4, (x * invLength).v);
+        _mm_storeu_ps(normals[1] + row * 4, (y * invLength).v);
+        _mm_storeu_ps(normals[2] + row * 4, (z * invLength).v);
+    }
+}
+
+void TextureCooker::RebuildNormal(uint32_t texel, float normal[3])
+{
+    float x = (texel & 0xFF) * (2.0f / 255.0f) - 1.0f;
+    float y = ((texel >> 8) & 0xFF) * (2.0f / 255.0f) - 1.0f;
+    float z = sqrtf(std::min(std::max(1.0f - x * x - y * y, 0.0f), 1.0f));
+    float invLength = 1.0f / sqrtf(x * x + y * y + z * z);
+    normal[0] = x * invLength;
+    normal[1] = y * invLength;
+    normal[2] = z * invLength;
+}
+
+bool TextureCooker::BuildFile(BlockFormat format, uint32_t width, uint32_t height, uint32_t mipCount, uint32_t sliceCount,
+    bool isCube, const std::vector<uint8_t>& data, std::vector<uint8_t>& file)
+{
+    if (width == 0 || height == 0 || mipCount == 0 || sliceCount == 0 || (isCube && sliceCount % 6 != 0))
+        return false;
+
+    DDS_HEADER header = {};
+    header.size = sizeof(DDS_HEADER);
+    header.flags = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000;   // caps, height, width, pixel format, mip count, linear size
+    header.height = height;
+    header.width = width;
+    header.pitchOrLinearSize = ((width + 3) / 4) * ((height + 3) / 4) * GetBlockBytes(format);
+    header.mipMapCount = mipCount;
+    header.ddspf.size = sizeof(DDS_PIXELFORMAT);
+    header.ddspf.flags = DDS_FOURCC;
+    header.ddspf.fourCC = MAKEFOURCC('D', 'X', '1', '0');
+    header.caps = 0x1000;                       // DDSCAPS_TEXTURE
+    if (mipCount > 1 || isCube)
+        header.caps |= 0x8;                     // DDSCAPS_COMPLEX
+    if (mipCount > 1)
+        header.caps |= 0x400000;                // DDSCAPS_MIPMAP
+    if (isCube)
+        header.caps2 = DDS_CUBEMAP | DDS_CUBEMAP_ALLFACES;
+
+    DDS_HEADER_DXT10 extension = {};
+    extension.dxgiFormat = static_cast<DXGI_FORMAT>(GetDxgiFormat(format));
+    extension.resourceDimension = DDS_DIMENSION_TEXTURE2D;
+    extension.miscFlag = isCube ? DDS_RESOURCE_MISC_TEXTURECUBE : 0;
+    extension.arraySize = isCube ? sliceCount / 6 : sliceCount;
+
+    file.resize(DDS_DX10_HEADER_SIZE + data.size());
+    memcpy(file.data(), &DDS_MAGIC, sizeof(uint32_t));
+    memcpy(file.data() + sizeof(uint32_t), &header, sizeof(header));
+    memcpy(file.data() + sizeof(uint32_t) + sizeof(header), &extension, sizeof(extension));
+    if (!data.empty())
+        memcpy(file.data() + DDS_DX10_HEADER_SIZE, data.data(), data.size());
+    return true;
+}
+
+bool TextureCooker::CookFile(const char* sourcePath, const char* destPath, const TextureCookSettings& settings)
+{
+    SoftwareTexture source;
+    if (!source.LoadDDS(sourcePath, m_pPool))
+        return false;
+
+    std::vector<std::vector<CookImage>> slices(source.GetSliceCount());
+    for (uint32_t slice = 0; slice < source.GetSliceCount(); slice++)
+    {
+        for (uint32_t mip = 0; mip < source.GetMipCount(); mip++)
+        {
+            CookImage image = { source.GetMipWidth(mip), source.GetMipHeight(mip), source.GetTexels(slice, mip) };
+            slices[slice].push_back(std::move(image));
+        }
+    }
+
+    std::vector<uint8_t> data;
+    std::vector<uint8_t> file;
+    if (!Compress(slices, source.IsCube(), settings, data) ||
+        !BuildFile(settings.format, source.GetWidth(), source.GetHeight(), m_stats.mips, m_stats.slices, source.IsCube(), data, file))
+    {
+        return false;
+    }
+
+    // The checks DDSTextureLoader11 makes before it creates the texture
+    const DDS_HEADER* pHeader = nullptr;
+    const uint8_t* pBits = nullptr;
+    size_t bitSize = 0;
+    DDSTextureLayout layout;
+    if (FAILED(LoadTextureDataFromMemory(file.data(), file.size(), &pHeader, &pBits, &bitSize)) ||
+        FAILED(GetTextureLayout(pHeader, layout)) ||
+        layout.format != static_cast<DXGI_FORMAT>(GetDxgiFormat(settings.format)) || layout.width != source.GetWidth() ||
+        layout.height != source.GetHeight() || layout.mipCount != m_stats.mips || layout.arraySize != m_stats.slices ||
+        layout.isCubeMap != source.IsCube())
+    {
+        return false;
+    }
+    std::vector<DDSSubresourceData> initData(static_cast<size_t>(layout.mipCount) * layout.arraySize);
+    size_t twidth = 0;
+    size_t theight = 0;
+    size_t tdepth = 0;
+    size_t skipMip = 0;
+    if (FAILED(FillInitData(layout.width, layout.height, layout.depth, layout.mipCount, layout.arraySize, layout.format, 0,
+        bitSize, pBits, twidth, theight, tdepth, skipMip, initData.data())))
+    {
+        return false;
+    }
+
+    return WriteBytes(destPath, file);
+}
+
+CompressorBenchmarkResult TextureCooker::Benchmark(ThreadPool* pPool, const SoftwareTexture& color,
+    const SoftwareTexture& normalMap, uint32_t size)
+{
+    CompressorBenchmarkResult result = {};
+    result.size = size;
+    result.threads = pPool ? pPool->GetThreadCount() : 1;
+    if (color.GetSliceCount() == 0 || normalMap.GetSliceCount() == 0 || size < 4)
+        return result;
+
+    std::vector<std::vector<CookImage>> colorSource = TileTopMip(color, size);
+    std::vector<std::vector<CookImage>> normalSource = TileTopMip(normalMap, size);
+
+    for (uint32_t f = 0; f < BlockFormatCount; f++)
+    {
+        BlockFormat format = static_cast<BlockFormat>(f);
+        const std::vector<std::vector<CookImage>>& source = format == BlockFormat::BC5 ? normalSource : colorSource;
+        TextureCookSettings settings = { format, 2, false, false, MipFilter::Box, false };
+        CompressorFormatResult& formatResult = result.formats[f];
+
+        TextureCooker single;
+        std::vector<uint8_t> singleData;
+        if (!single.Compress(source, false, settings, singleData))
+            continue;
+        TextureCooker parallel;
+        parallel.SetThreadPool(pPool);
+        std::vector<uint8_t> parallelData;
+        if (!parallel.Compress(source, false, settings, parallelData))
+            continue;
+
+        formatResult.texels = single.GetStats().texels;
+        formatResult.singleSeconds = single.GetStats().seconds;
+        formatResult.parallelSeconds = parallel.GetStats().seconds;
+        double megapixels = formatResult.texels * 1.0e-6;
+        formatResult.singleRate = formatResult.singleSeconds > 0.0 ? megapixels / formatResult.singleSeconds : 0.0;
+        formatResult.parallelRate = formatResult.parallelSeconds > 0.0 ? megapixels / formatResult.parallelSeconds / result.threads : 0.0;
+
+        // Error over what the format keeps: no alpha in BC1 of an opaque source, red and green in BC5
+        uint32_t channelMask = format == BlockFormat::BC1 ? 0x7 : format == BlockFormat::BC5 ? 0x3 : 0xF;
+        uint32_t channels = 0;
+        for (uint32_t c = 0; c < 4; c++)
+            channels += (channelMask >> c) & 1;
+        uint32_t blockBytes = GetBlockBytes(format);
+        const CookImage& image = source[0][0];
+        uint32_t blocksX = (size + 3) / 4;
+        uint32_t blocksY = (size + 3) / 4;
+        double squaredError = 0.0;
+        for (uint32_t by = 0; by < blocksY; by++)
+        {
+            for (uint32_t bx = 0; bx < blocksX; bx++)
+            {
+                size_t block = static_cast<size_t>(by) * blocksX + bx;
+                if (memcmp(singleData.data() + block * blockBytes, parallelData.data() + block * blockBytes, blockBytes) != 0)
+                    formatResult.mismatches++;
+
+                uint32_t decoded[16];
+                if (!DecompressBlock(format, singleData.data() + block * blockBytes, decoded))
+                {
+                    formatResult.mismatches++;
+                    continue;
+                }
+                for (uint32_t i = 0; i < 16; i++)
+                {
+                    uint32_t x = bx * 4 + i % 4;
+                    uint32_t y = by * 4 + i / 4;
+                    if (x >= size || y >= size)
+                        continue;
+                    uint32_t original = image.texels[static_cast<size_t>(y) * size + x];
+                    for (uint32_t c = 0; c < 4; c++)
+                    {
+                        if (!(channelMask & (1u << c)))
+                            continue;
+                        double difference = static_cast<double>((original >> (8 * c)) & 0xFF) - static_cast<double>((decoded[i] >> (8 * c)) & 0xFF);
+                        squaredError += difference * difference;
+                    }
+                }
+            }
+        }
+        formatResult.rmse = sqrt(squaredError / (static_cast<double>(size) * size * channels));
+        formatResult.psnr = formatResult.rmse > 0.0 ? 20.0 * log10(255.0 / formatResult.rmse) : 99.0;
+    }
+    return result;
+}
+
+NormalMapBenchmarkResult TextureCooker::BenchmarkNormalMap(ThreadPool* pPool, const SoftwareTexture& normalMap, uint32_t size)
+{
+    NormalMapBenchmarkResult result = {};
+    result.size = size;
+    if (normalMap.GetSliceCount() == 0 || size < 4 || size % 4 != 0)
+        return result;
+
+    // Scene: reference normals straight from the 8 bit texels, before any quantization of the cooker
+    std::vector<std::vector<CookImage>> scene = TileTopMip(normalMap, size);
+    const std::vector<uint32_t>& texels = scene[0][0].texels;
+    std::vector<float> reference(texels.size() * 3);
+    for (size_t i = 0; i < texels.size(); i++)
+    {
+        float normal[3];
+        for (uint32_t c = 0; c < 3; c++)
+            normal[c] = ((texels[i] >> (8 * c)) & 0xFF) * (2.0f / 255.0f) - 1.0f;
+        normal[2] = std::max(normal[2], 0.0f);
+        float lengthSq = normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2];
+        float invLength = lengthSq > 1.0e-8f ? 1.0f / sqrtf(lengthSq) : 0.0f;
+        for (uint32_t c = 0; c < 3; c++)
+            reference[i * 3 + c] = normal[c] * invLength;
+    }
+    MeasureNormalFormats(pPool, scene, reference, result.scene);
+
+    // Synthetic: a height field of random bumps, exact normals from its derivatives
+    uint32_t seed = 7;
+    auto next = [&seed]()
+    {
+        seed = seed * 1664525u + 1013904223u;
+        return (seed >> 8) * (1.0f / 16777216.0f);
+    };
+    const uint32_t BumpCount = 64;
+    float bumps[BumpCount][4];      // x, y, radius, height
+    for (uint32_t i = 0; i < BumpCount; i++)
+    {
+        bumps[i][0] = next() * size;
+        bumps[i][1] = next() * size;
+        bumps[i][2] = (0.02f + next() * 0.1f) * size;
+        bumps[i][3] = (next() * 2.0f - 1.0f) * bumps[i][2] * 0.5f;
+    }
+    std::vector<std::vector<CookImage>> synthetic(1);
+    synthetic[0].push_back({ size, size, std::vector<uint32_t>(static_cast<size_t>(size) * size) });
+    CookImage& image = synthetic[0][0];
+    for (uint32_t y = 0; y < size; y++)
+    {
+        for (uint32_t x = 0; x < size; x++)
+        {
+            float dx = 0.0f;
+            float dy = 0.0f;
+            for (const float* bump : bumps)
+            {
+                float ox = (x + 0.5f - bump[0]) / bump[2];
+                float oy = (y + 0.5f - bump[1]) / bump[2];
+                float falloff = bump[3] * expf(-(ox * ox + oy * oy)) * -2.0f / bump[2];
+                dx += falloff * ox;
+                dy += falloff * oy;
+            }
+            float normal[3] = { -dx, -dy, 1.0f };
+            float invLength = 1.0f / sqrtf(dx * dx + dy * dy + 1.0f);
+            size_t texel = static_cast<size_t>(y) * size + x;
+            for (uint32_t c = 0; c < 3; c++)
+            {
+                normal[c] *= invLength;
+                reference[texel * 3 + c] = normal[c];
+            }
+            image.texels[texel] = EncodeNormal(normal);
+        }
+    }
+    MeasureNormalFormats(pPool, synthetic, reference, result.synthetic);
+    return result;
+}
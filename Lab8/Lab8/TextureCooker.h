@@ -0,0 +1,143 @@
+#ifndef TEXTURE_COOKER_H
+#define TEXTURE_COOKER_H
+
+#include "MipGenerator.h"
+#include <cstdint>
+#include <vector>
+
+class SoftwareTexture;
+class ThreadPool;
+
+enum class BlockFormat : uint32_t
+{
+    BC1,        // RGB, texels with alpha below 128 become transparent
+    BC3,        // BC1 colour and a BC4 alpha block
+    BC5,        // red and green in two BC4 blocks, for normal maps
+    BC7         // RGBA, mode 6: one subset, 4 bit indices
+};
+
+const uint32_t BlockFormatCount = 4;
+
+struct TextureCookSettings
+{
+    BlockFormat format;
+    uint32_t refinePasses;      // least squares endpoint refits after the principal axis fit
+    bool generateMips;          // MipGenerator chain below a source with a single mip
+    bool normalMap;             // tangent space normals: renormalized before compression and after filtering
+    MipFilter mipFilter;        // filter of the generated chain
+    bool srgb;                  // the generated chain is filtered in linear light
+};
+
+struct TextureCookStats
+{
+    uint32_t slices;
+    uint32_t mips;
+    uint64_t blocks;
+    uint64_t texels;
+    uint64_t bytes;             // compressed data without the header
+    uint32_t threads;
+    double seconds;
+};
+
+struct CompressorFormatResult
+{
+    uint64_t texels;
+    double singleSeconds;       // calling thread only
+    double parallelSeconds;     // every thread of the pool
+    double singleRate;          // megapixels per second on one core
+    double parallelRate;        // megapixels per second per core with the whole pool busy
+    uint32_t mismatches;        // blocks the two runs encoded differently, 0 expected
+    double rmse;                // over the channels the format keeps, 0..255
+    double psnr;
+};
+
+struct CompressorBenchmarkResult
+{
+    uint32_t size;
+    uint32_t threads;
+    CompressorFormatResult formats[BlockFormatCount];
+};
+
+struct NormalDecodeResult
+{
+    uint32_t bitsPerTexel;
+    double decodeSeconds;
+    double decodeRate;          // megapixels per second on one core, blocks to unit normals
+    double meanAngle;           // degrees from the renormalized source
+    double maxAngle;
+    float maxReferenceError;    // SIMD decode against the scalar reference, largest component difference
+};
+
+struct NormalSourceResult
+{
+    NormalDecodeResult storedZ;     // BC1 read as X, Y and Z, what ColorPixel.ps did before BC5
+    NormalDecodeResult bc1;         // BC1 with Z rebuilt from X and Y
+    NormalDecodeResult bc5;
+};
+
+struct NormalMapBenchmarkResult
+{
+    uint32_t size;
+    NormalSourceResult scene;       // the normal map of the scene, itself decoded from BC1
+    NormalSourceResult synthetic;   // analytic bumps against their exact normals
+};
+
+// Offline texture cooker: compresses RGBA8 mip chains into BC1, BC3, BC5 or BC7 and writes
+// DDS files with a DX10 header. Every block starts from the principal axis of its texels
+// (BC4 channels from their range), then picks indices and refits the endpoints by least
+// squares; each pass tests the four texels of a block row against every palette entry in
+// one SSE register, so the exact nearest entry costs no more than a guess would. BC7 uses
+// mode 6 only, the single subset mode with per endpoint p-bits. Normal maps are cooked from
+// unit vectors, so the Z a shader rebuilds from X and Y is the Z the source stored; BC5 keeps
+// X and Y in two BC4 blocks, each with its own endpoints and eight levels.
+// Blocks are independent: Compress splits all mips of all slices into bands of block rows
+// and runs them on the thread pool, the output does not depend on the thread count.
+class TextureCooker
+{
+public:
+    TextureCooker();
+
+    void SetThreadPool(ThreadPool* pPool) { m_pPool = pPool; }
+
+    // slices[slice][mip]; data receives the DDS pixel data, every mip of a slice in turn.
+    // Cube maps generate their chains across the face edges.
+    bool Compress(const std::vector<std::vector<CookImage>>& slices, bool isCube, const TextureCookSettings& settings,
+        std::vector<uint8_t>& data);
+    // The source is read by SoftwareTexture (BC1, BC3 or 32 bit). The file is checked with
+    // the header parser of DDSTextureLoader11 before it is written.
+    bool CookFile(const char* sourcePath, const char* destPath, const TextureCookSettings& settings);
+    const TextureCookStats& GetStats() const { return m_stats; }
+
+    static uint32_t GetBlockBytes(BlockFormat format);
+    static uint32_t GetDxgiFormat(BlockFormat format);
+    static const char* GetFormatName(BlockFormat format);
+
+    // One 4x4 block, texels row by row
+    static void CompressBlock(BlockFormat format, const uint32_t texels[16], uint32_t refinePasses, uint8_t* pBlock);
+    // Reference decoder for the blocks CompressBlock writes; false for other BC7 modes
+    static bool DecompressBlock(BlockFormat format, const uint8_t* pBlock, uint32_t texels[16]);
+
+    // Unit normals of one block as ColorPixel.ps rebuilds them: X and Y from red and green,
+    // Z from their length, four texels per register; normals[component][texel]
+    static void DecodeNormalBlock(BlockFormat format, const uint8_t* pBlock, float normals[3][16]);
+    // Scalar form of the same for one decoded texel, the reference the SIMD path is checked against
+    static void RebuildNormal(uint32_t texel, float normal[3]);
+
+    // Whole DDS file: magic, DX10 header and data
+    static bool BuildFile(BlockFormat format, uint32_t width, uint32_t height, uint32_t mipCount, uint32_t sliceCount,
+        bool isCube, const std::vector<uint8_t>& data, std::vector<uint8_t>& file);
+
+    // size x size tiles of the top mips, colour for BC1, BC3 and BC7, the normal map for BC5,
+    // compressed on the calling thread and then on the pool
+    static CompressorBenchmarkResult Benchmark(ThreadPool* pPool, const SoftwareTexture& color,
+        const SoftwareTexture& normalMap, uint32_t size);
+    // size x size tile of the top mip of a normal map and a synthetic one in BC1 and BC5,
+    // decoded back to normals
+    static NormalMapBenchmarkResult BenchmarkNormalMap(ThreadPool* pPool, const SoftwareTexture& normalMap, uint32_t size);
+
+private:
+    ThreadPool* m_pPool;
+    TextureCookStats m_stats;
+};
+
+#endif
@@ -0,0 +1,664 @@
+#include "TexturePacker.h"
+#include "DDSLayout.h"
+#include "MappedFile.h"
+#include "Profiler.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <emmintrin.h>
+#include <functional>
+
+using namespace DirectX::DDSLayout;
+
+namespace
+{
+    const uint32_t MinMatch = 4;
+    const uint32_t LastLiterals = 5;    // the last bytes of a chunk are always literals
+    const uint32_t MatchLimit = 12;     // no match starts closer to the end of a chunk
+    const uint32_t MaxOffset = 65535;
+    const uint32_t MaxChunkBytes = 65536;
+    const uint32_t HashBits = 15;
+
+    enum ChunkMode : uint32_t
+    {
+        ChunkStored = 0,
+        ChunkPlain = 1,
+        ChunkShuffled = 2
+    };
+
+    const uint32_t ChunkModeShift = 30;
+    const uint32_t ChunkSizeMask = (1u << ChunkModeShift) - 1;
+
+    // index and the thread it runs on, below GetThreadCount
+    void RunParallel(ThreadPool* pPool, uint32_t count, const std::function<void(uint32_t, uint32_t)>& task)
+    {
+        if (pPool)
+            pPool->ParallelFor(count, task);
+        else
+        {
+            for (uint32_t i = 0; i < count; i++)
+                task(i, 0);
+        }
+    }
+
+    uint32_t Read32(const uint8_t* p)
+    {
+        uint32_t value;
+        memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    uint32_t Hash(uint32_t value)
+    {
+        return (value * 2654435761u) >> (32 - HashBits);
+    }
+
+    // Hash chains over the positions of one chunk
+    struct Matcher
+    {
+        std::vector<int32_t> head;
+        std::vector<int32_t> chain;     // previous position with the same hash
+        uint32_t nextInsert;
+
+        void Reset(uint32_t size)
+        {
+            head.assign(static_cast<size_t>(1) << HashBits, -1);
+            chain.resize(size);
+            nextInsert = 0;
+        }
+
+        void InsertUpTo(const uint8_t* src, uint32_t pos)
+        {
+            for (; nextInsert < pos; nextInsert++)
+            {
+                uint32_t hash = Hash(Read32(src + nextInsert));
+                chain[nextInsert] = head[hash];
+                head[hash] = static_cast<int32_t>(nextInsert);
+            }
+        }
+
+        // Longest match at pos among depth earlier positions with the same hash, ending before end
+        uint32_t Find(const uint8_t* src, uint32_t pos, uint32_t end, uint32_t depth, uint32_t& offset) const
+        {
+            uint32_t best = 0;
+            uint32_t start = Read32(src + pos);
+            int32_t candidate = head[Hash(start)];
+            for (uint32_t i = 0; i < depth && candidate >= 0 && pos - candidate <= MaxOffset; i++)
+            {
+                const uint8_t* pMatch = src + candidate;
+                if (Read32(pMatch) == start && (best == 0 || (pos + best < end && pMatch[best] == src[pos + best])))
+                {
+                    uint32_t length = MinMatch;
+                    while (pos + length < end && pMatch[length] == src[pos + length])
+                        length++;
+                    if (length > best)
+                    {
+                        best = length;
+                        offset = pos - candidate;
+                    }
+                }
+                candidate = chain[candidate];
+            }
+            return best;
+        }
+    };
+
+    void WriteLength(std::vector<uint8_t>& out, uint32_t length)
+    {
+        for (; length >= 255; length -= 255)
+            out.push_back(255);
+        out.push_back(static_cast<uint8_t>(length));
+    }
+
+    // matchLength 0 ends the chunk with literals only
+    void WriteSequence(std::vector<uint8_t>& out, const uint8_t* pLiterals, uint32_t literalCount, uint32_t offset, uint32_t matchLength)
+    {
+        uint32_t matchCode = matchLength ? matchLength - MinMatch : 0;
+        out.push_back(static_cast<uint8_t>((std::min(literalCount, 15u) << 4) | std::min(matchCode, 15u)));
+        if (literalCount >= 15)
+            WriteLength(out, literalCount - 15);
+        out.insert(out.end(), pLiterals, pLiterals + literalCount);
+        if (!matchLength)
+            return;
+        out.push_back(static_cast<uint8_t>(offset & 0xFF));
+        out.push_back(static_cast<uint8_t>(offset >> 8));
+        if (matchCode >= 15)
+            WriteLength(out, matchCode - 15);
+    }
+
+    // Greedy matches from the hash chains, taking a longer match one byte later instead
+    void CompressChunk(const uint8_t* src, uint32_t size, uint32_t depth, Matcher& matcher, std::vector<uint8_t>& out)
+    {
+        out.clear();
+        matcher.Reset(size);
+        uint32_t anchor = 0;
+        uint32_t pos = 0;
+        if (size > MatchLimit)
+        {
+            uint32_t startLimit = size - MatchLimit;
+            uint32_t endLimit = size - LastLiterals;
+            while (pos < startLimit)
+            {
+                matcher.InsertUpTo(src, pos);
+                uint32_t offset = 0;
+                uint32_t length = matcher.Find(src, pos, endLimit, depth, offset);
+                if (length == 0)
+                {
+                    pos++;
+                    continue;
+                }
+                if (pos + 1 < startLimit)
+                {
+                    matcher.InsertUpTo(src, pos + 1);
+                    uint32_t nextOffset = 0;
+                    uint32_t next = matcher.Find(src, pos + 1, endLimit, depth, nextOffset);
+                    if (next > length + 1)
+                    {
+                        pos++;
+                        length = next;
+                        offset = nextOffset;
+                    }
+                }
+                WriteSequence(out, src + anchor, pos - anchor, offset, length);
+                pos += length;
+                anchor = pos;
+                matcher.InsertUpTo(src, std::min(pos, startLimit));
+            }
+        }
+        WriteSequence(out, src + anchor, size - anchor, 0, 0);
+    }
+
+    bool ReadLength(const uint8_t*& ip, const uint8_t* ipEnd, size_t& length)
+    {
+        for (;;)
+        {
+            if (ip >= ipEnd)
+                return false;
+            uint8_t value = *ip++;
+            length += value;
+            if (value != 255)
+                return true;
+        }
+    }
+
+    // Checks every length and offset, so a damaged file fails instead of writing outside dst.
+    // Copies may run up to 16 bytes ahead only while that stays inside dst, the chunk of this
+    // thread; the bytes they overrun are written again by the next sequence.
+    bool DecompressChunk(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize)
+    {
+        const uint8_t* ip = src;
+        const uint8_t* ipEnd = src + srcSize;
+        uint8_t* op = dst;
+        uint8_t* opEnd = dst + dstSize;
+        for (;;)
+        {
+            if (ip >= ipEnd)
+                return false;
+            uint32_t token = *ip++;
+
+            size_t literals = token >> 4;
+            if (literals == 15 && !ReadLength(ip, ipEnd, literals))
+                return false;
+            if (literals > static_cast<size_t>(ipEnd - ip) || literals > static_cast<size_t>(opEnd - op))
+                return false;
+            if (literals <= 16 && ipEnd - ip >= 16 && opEnd - op >= 16)
+                memcpy(op, ip, 16);
+            else
+                memcpy(op, ip, literals);
+            op += literals;
+            ip += literals;
+            if (ip == ipEnd)
+                return op == opEnd;
+
+            if (ipEnd - ip < 2)
+                return false;
+            size_t offset = ip[0] | (static_cast<size_t>(ip[1]) << 8);
+            ip += 2;
+            size_t length = token & 15;
+            if (length == 15 && !ReadLength(ip, ipEnd, length))
+                return false;
+            length += MinMatch;
+            if (offset == 0 || offset > static_cast<size_t>(op - dst) || length > static_cast<size_t>(opEnd - op))
+                return false;
+
+            const uint8_t* pMatch = op - offset;
+            if (offset >= 8 && static_cast<size_t>(opEnd - op) >= length + 8)
+            {
+                for (size_t i = 0; i < length; i += 8)
+                    memcpy(op + i, pMatch + i, 8);
+            }
+            else if (static_cast<size_t>(opEnd - op) >= length + 8)
+            {
+                // Short offsets repeat a pattern: 8 bytes of it, stepped by a whole number of periods
+                uint8_t pattern[8];
+                for (size_t i = 0; i < 8; i++)
+                    pattern[i] = pMatch[i % offset];
+                size_t step = 8 - 8 % offset;
+                for (size_t i = 0; i < length; i += step)
+                    memcpy(op + i, pattern, 8);
+            }
+            else
+            {
+                for (size_t i = 0; i < length; i++)
+                    op[i] = pMatch[i];
+            }
+            op += length;
+        }
+    }
+
+    // Byte b of every element goes to plane b; a tail shorter than an element stays in place
+    void Shuffle(const uint8_t* src, uint32_t size, uint32_t stride, uint8_t* dst)
+    {
+        uint32_t elements = size / stride;
+        for (uint32_t e = 0; e < elements; e++)
+        {
+            for (uint32_t b = 0; b < stride; b++)
+                dst[static_cast<size_t>(b) * elements + e] = src[static_cast<size_t>(e) * stride + b];
+        }
+        memcpy(dst + elements * stride, src + elements * stride, size - elements * stride);
+    }
+
+    // 16 elements at a time: the planes are the rows of a Stride x 16 byte matrix. Pairing row i
+    // with row i + Stride / 2 in one byte unpack rotates the bits of a byte's address by one, so
+    // log2(Stride) rounds move the plane bits below the element bits and the rows come out in
+    // element order.
+    template<uint32_t Stride>
+    uint32_t UnshuffleSimd(const uint8_t* src, uint32_t elements, uint8_t* dst)
+    {
+        uint32_t e = 0;
+        for (; e + 16 <= elements; e += 16)
+        {
+            __m128i rows[Stride];
+            __m128i next[Stride];
+            for (uint32_t b = 0; b < Stride; b++)
+                rows[b] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + static_cast<size_t>(b) * elements + e));
+            for (uint32_t round = 1; round < Stride; round *= 2)
+            {
+                for (uint32_t i = 0; i < Stride / 2; i++)
+                {
+                    next[2 * i] = _mm_unpacklo_epi8(rows[i], rows[i + Stride / 2]);
+                    next[2 * i + 1] = _mm_unpackhi_epi8(rows[i], rows[i + Stride / 2]);
+                }
+                for (uint32_t i = 0; i < Stride; i++)
+                    rows[i] = next[i];
+            }
+            for (uint32_t i = 0; i < Stride; i++)
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + static_cast<size_t>(e) * Stride + 16 * i), rows[i]);
+        }
+        return e;
+    }
+
+    void Unshuffle(const uint8_t* src, uint32_t size, uint32_t stride, uint8_t* dst)
+    {
+        uint32_t elements = size / stride;
+        uint32_t e = 0;
+        if (stride == 4)
+            e = UnshuffleSimd<4>(src, elements, dst);
+        else if (stride == 8)
+            e = UnshuffleSimd<8>(src, elements, dst);
+        else if (stride == 16)
+            e = UnshuffleSimd<16>(src, elements, dst);
+        for (; e < elements; e++)
+        {
+            uint8_t* pElement = dst + static_cast<size_t>(e) * stride;
+            for (uint32_t b = 0; b < stride; b++)
+                pElement[b] = src[static_cast<size_t>(b) * elements + e];
+        }
+        memcpy(dst + elements * stride, src + elements * stride, size - elements * stride);
+    }
+
+    // The parsed header and where every chunk starts in the packed file
+    struct PackedLayout
+    {
+        TexturePackHeader header;
+        const uint32_t* pChunks;
+        const uint8_t* pDdsHeader;
+        std::vector<size_t> offsets;    // chunkCount + 1
+    };
+
+    bool ParseHeader(const uint8_t* packed, size_t packedSize, TexturePackHeader& header)
+    {
+        if (!packed || packedSize < sizeof(TexturePackHeader))
+            return false;
+        memcpy(&header, packed, sizeof(header));
+        if (header.magic != TexturePackMagic || header.version != TexturePackVersion || header.chunkBytes == 0 ||
+            header.chunkBytes > MaxChunkBytes || header.stride == 0 || header.headerBytes < DDS_MIN_HEADER_SIZE)
+        {
+            return false;
+        }
+        uint64_t chunkCount = (header.payloadBytes + header.chunkBytes - 1) / header.chunkBytes;
+        uint64_t tableEnd = sizeof(header) + static_cast<uint64_t>(header.chunkCount) * sizeof(uint32_t) + header.headerBytes;
+        return chunkCount == header.chunkCount && tableEnd <= packedSize;
+    }
+
+    bool ParseLayout(const uint8_t* packed, size_t packedSize, PackedLayout& layout)
+    {
+        if (!ParseHeader(packed, packedSize, layout.header))
+            return false;
+        const TexturePackHeader& header = layout.header;
+        layout.pChunks = reinterpret_cast<const uint32_t*>(packed + sizeof(header));
+        layout.pDdsHeader = packed + sizeof(header) + static_cast<size_t>(header.chunkCount) * sizeof(uint32_t);
+        layout.offsets.resize(static_cast<size_t>(header.chunkCount) + 1);
+        size_t offset = static_cast<size_t>(layout.pDdsHeader - packed) + header.headerBytes;
+        for (uint32_t i = 0; i < header.chunkCount; i++)
+        {
+            layout.offsets[i] = offset;
+            uint32_t entry = layout.pChunks[i];
+            uint32_t size = entry & ChunkSizeMask;
+            uint32_t mode = entry >> ChunkModeShift;
+            uint64_t rawSize = std::min<uint64_t>(header.chunkBytes, header.payloadBytes - static_cast<uint64_t>(i) * header.chunkBytes);
+            if (mode > ChunkShuffled || (mode == ChunkStored && size != rawSize) || size > packedSize - offset)
+                return false;
+            offset += size;
+        }
+        layout.offsets[header.chunkCount] = offset;
+        return offset == packedSize;
+    }
+
+    // Bytes of one block for the block compressed formats, of one texel otherwise
+    uint32_t GetStride(DXGI_FORMAT format)
+    {
+        size_t numBytes = 0;
+        size_t numRows = 0;
+        if (FAILED(GetSurfaceInfo(4, 4, format, &numBytes, nullptr, &numRows)))
+            return 1;
+        if (numRows == 1)
+            return static_cast<uint32_t>(numBytes);
+        return static_cast<uint32_t>(std::max<size_t>(BitsPerPixel(format) / 8, 1));
+    }
+
+    bool ReadWholeFile(const char* path, std::vector<uint8_t>& data)
+    {
+        MappedFile file;
+        if (!file.Open(path))
+            return false;
+        data.assign(file.GetData(), file.GetData() + file.GetSize());
+        return true;
+    }
+
+    bool WriteWholeFile(const char* path, const std::vector<uint8_t>& data)
+    {
+        FILE* file = nullptr;
+    #ifdef _MSC_VER
+        if (fopen_s(&file, path, "wb") != 0)
+            file = nullptr;
+    #else
+        file = fopen(path, "wb");
+    #endif
+        if (!file)
+            return false;
+        bool written = fwrite(data.data(), 1, data.size(), file) == data.size();
+        return fclose(file) == 0 && written;
+    }
+}
+
+TexturePacker::TexturePacker()
+    : m_pPool(nullptr),
+    m_stats()
+{
+}
+
+TexturePackSettings TexturePacker::GetDefaultSettings()
+{
+    TexturePackSettings settings = { MaxChunkBytes, 32, true };
+    return settings;
+}
+
+bool TexturePacker::IsPacked(const uint8_t* data, size_t size)
+{
+    TexturePackHeader header;
+    return ParseHeader(data, size, header);
+}
+
+uint64_t TexturePacker::GetUnpackedSize(const uint8_t* packed, size_t packedSize)
+{
+    TexturePackHeader header;
+    if (!ParseHeader(packed, packedSize, header))
+        return 0;
+    return header.headerBytes + header.payloadBytes;
+}
+
+bool TexturePacker::Pack(const uint8_t* dds, size_t ddsSize, const TexturePackSettings& settings, std::vector<uint8_t>& packed)
+{
+    m_stats = {};
+    uint64_t start = Profiler::NowNs();
+    if (settings.chunkBytes == 0 || settings.chunkBytes > MaxChunkBytes)
+        return false;
+
+    // Only files the loaders accept, the header bytes are everything before the pixel data
+    const DDS_HEADER* pHeader = nullptr;
+    const uint8_t* bitData = nullptr;
+    size_t bitSize = 0;
+    DDSTextureLayout layout;
+    if (FAILED(LoadTextureDataFromMemory(dds, ddsSize, &pHeader, &bitData, &bitSize)) || FAILED(GetTextureLayout(pHeader, layout)))
+        return false;
+
+    TexturePackHeader header = {};
+    header.magic = TexturePackMagic;
+    header.version = TexturePackVersion;
+    header.headerBytes = static_cast<uint32_t>(bitData - dds);
+    header.chunkBytes = settings.chunkBytes;
+    header.payloadBytes = bitSize;
+    header.chunkCount = static_cast<uint32_t>((bitSize + settings.chunkBytes - 1) / settings.chunkBytes);
+    header.stride = GetStride(layout.format);
+
+    uint32_t threads = m_pPool ? m_pPool->GetThreadCount() : 1;
+    std::vector<Matcher> matchers(threads);
+    std::vector<std::vector<uint8_t>> shuffled(threads);
+    std::vector<std::vector<uint8_t>> candidates(threads);
+    std::vector<std::vector<uint8_t>> chunks(header.chunkCount);
+    std::vector<uint32_t> entries(header.chunkCount);
+    RunParallel(m_pPool, header.chunkCount, [&](uint32_t chunk, uint32_t thread)
+    {
+        const uint8_t* src = bitData + static_cast<size_t>(chunk) * header.chunkBytes;
+        uint32_t size = static_cast<uint32_t>(std::min<size_t>(header.chunkBytes, bitSize - static_cast<size_t>(chunk) * header.chunkBytes));
+        std::vector<uint8_t>& out = chunks[chunk];
+        CompressChunk(src, size, settings.searchDepth, matchers[thread], out);
+        uint32_t mode = ChunkPlain;
+        if (settings.shuffle && header.stride > 1)
+        {
+            shuffled[thread].resize(size);
+            Shuffle(src, size, header.stride, shuffled[thread].data());
+            CompressChunk(shuffled[thread].data(), size, settings.searchDepth, matchers[thread], candidates[thread]);
+            if (candidates[thread].size() < out.size())
+            {
+                out.swap(candidates[thread]);
+                mode = ChunkShuffled;
+            }
+        }
+        if (out.size() >= size)
+        {
+            out.assign(src, src + size);
+            mode = ChunkStored;
+        }
+        entries[chunk] = static_cast<uint32_t>(out.size()) | (mode << ChunkModeShift);
+    });
+
+    size_t packedSize = sizeof(header) + entries.size() * sizeof(uint32_t) + header.headerBytes;
+    for (const std::vector<uint8_t>& chunk : chunks)
+        packedSize += chunk.size();
+    packed.resize(packedSize);
+    uint8_t* pOut = packed.data();
+    memcpy(pOut, &header, sizeof(header));
+    pOut += sizeof(header);
+    if (!entries.empty())
+        memcpy(pOut, entries.data(), entries.size() * sizeof(uint32_t));
+    pOut += entries.size() * sizeof(uint32_t);
+    memcpy(pOut, dds, header.headerBytes);
+    pOut += header.headerBytes;
+    for (uint32_t i = 0; i < header.chunkCount; i++)
+    {
+        memcpy(pOut, chunks[i].data(), chunks[i].size());
+        pOut += chunks[i].size();
+        uint32_t mode = entries[i] >> ChunkModeShift;
+        m_stats.shuffledChunks += mode == ChunkShuffled ? 1 : 0;
+        m_stats.storedChunks += mode == ChunkStored ? 1 : 0;
+    }
+
+    m_stats.rawBytes = header.headerBytes + bitSize;
+    m_stats.packedBytes = packed.size();
+    m_stats.chunks = header.chunkCount;
+    m_stats.threads = threads;
+    m_stats.seconds = (Profiler::NowNs() - start) * 1.0e-9;
+    return true;
+}
+
+bool TexturePacker::Unpack(const uint8_t* packed, size_t packedSize, uint8_t* dds, size_t ddsSize)
+{
+    m_stats = {};
+    uint64_t start = Profiler::NowNs();
+    PackedLayout layout;
+    if (!dds || !ParseLayout(packed, packedSize, layout))
+        return false;
+    const TexturePackHeader& header = layout.header;
+    if (ddsSize != header.headerBytes + header.payloadBytes)
+        return false;
+
+    memcpy(dds, layout.pDdsHeader, header.headerBytes);
+    uint8_t* pPayload = dds + header.headerBytes;
+    uint32_t threads = m_pPool ? m_pPool->GetThreadCount() : 1;
+    std::vector<std::vector<uint8_t>> planes(threads);
+    std::atomic<uint32_t> failed(0);
+    RunParallel(m_pPool, header.chunkCount, [&](uint32_t chunk, uint32_t thread)
+    {
+        const uint8_t* src = packed + layout.offsets[chunk];
+        size_t srcSize = layout.offsets[chunk + 1] - layout.offsets[chunk];
+        uint8_t* dst = pPayload + static_cast<size_t>(chunk) * header.chunkBytes;
+        uint32_t size = static_cast<uint32_t>(std::min<uint64_t>(header.chunkBytes,
+            header.payloadBytes - static_cast<uint64_t>(chunk) * header.chunkBytes));
+        bool unpacked = true;
+        switch (layout.pChunks[chunk] >> ChunkModeShift)
+        {
+        case ChunkStored:
+            memcpy(dst, src, size);
+            break;
+        case ChunkPlain:
+            unpacked = DecompressChunk(src, srcSize, dst, size);
+            break;
+        default:
+            planes[thread].resize(size);
+            unpacked = DecompressChunk(src, srcSize, planes[thread].data(), size);
+            if (unpacked)
+                Unshuffle(planes[thread].data(), size, header.stride, dst);
+            break;
+        }
+        if (!unpacked)
+            failed++;
+    });
+
+    m_stats.rawBytes = ddsSize;
+    m_stats.packedBytes = packedSize;
+    m_stats.chunks = header.chunkCount;
+    m_stats.threads = threads;
+    m_stats.seconds = (Profiler::NowNs() - start) * 1.0e-9;
+    return failed == 0;
+}
+
+bool TexturePacker::Unpack(const uint8_t* packed, size_t packedSize, std::vector<uint8_t>& dds)
+{
+    uint64_t size = GetUnpackedSize(packed, packedSize);
+    if (size == 0 || size > SIZE_MAX)
+        return false;
+    dds.resize(static_cast<size_t>(size));
+    return Unpack(packed, packedSize, dds.data(), dds.size());
+}
+
+bool TexturePacker::PackFile(const char* sourcePath, const char* destPath, const TexturePackSettings& settings)
+{
+    std::vector<uint8_t> dds;
+    std::vector<uint8_t> packed;
+    if (!ReadWholeFile(sourcePath, dds) || !Pack(dds.data(), dds.size(), settings, packed))
+        return false;
+
+    // What gets written has to come back bit for bit
+    std::vector<uint8_t> check;
+    TexturePackStats stats = m_stats;
+    bool unpacked = Unpack(packed.data(), packed.size(), check) && check == dds;
+    m_stats = stats;
+    return unpacked && WriteWholeFile(destPath, packed);
+}
+
+TexturePackBenchmarkResult TexturePacker::Benchmark(ThreadPool* pPool, const std::vector<std::string>& paths, uint32_t passes)
+{
+    TexturePackBenchmarkResult result = {};
+    result.passes = passes;
+    result.threads = pPool ? pPool->GetThreadCount() : 1;
+    result.storageRates[0] = 100.0;     // hard disk
+    result.storageRates[1] = 500.0;     // SATA SSD
+
+    TexturePacker packer;
+    packer.SetThreadPool(pPool);
+    TexturePackSettings settings = GetDefaultSettings();
+    TexturePackSettings plainSettings = settings;
+    plainSettings.shuffle = false;
+
+    std::vector<std::vector<uint8_t>> sources;
+    std::vector<std::vector<uint8_t>> packedFiles;
+    double packSeconds = 0.0;
+    for (const std::string& path : paths)
+    {
+        std::vector<uint8_t> dds;
+        std::vector<uint8_t> packed;
+        std::vector<uint8_t> plain;
+        if (!ReadWholeFile(path.c_str(), dds) || !packer.Pack(dds.data(), dds.size(), plainSettings, plain) ||
+            !packer.Pack(dds.data(), dds.size(), settings, packed))
+        {
+            result.failed++;
+            continue;
+        }
+        packSeconds += packer.GetStats().seconds;
+        result.chunks += packer.GetStats().chunks;
+        result.shuffledChunks += packer.GetStats().shuffledChunks;
+        result.storedChunks += packer.GetStats().storedChunks;
+
+        TexturePackFileResult file = { path, dds.size(), packed.size(), plain.size() };
+        result.files.push_back(file);
+        result.rawBytes += file.rawBytes;
+        result.packedBytes += file.packedBytes;
+        result.plainBytes += file.plainBytes;
+        sources.push_back(std::move(dds));
+        packedFiles.push_back(std::move(packed));
+    }
+    if (sources.empty())
+        return result;
+
+    // Into buffers allocated up front, the way a loader hands out its upload memory
+    std::vector<std::vector<uint8_t>> unpacked(sources.size());
+    for (size_t i = 0; i < sources.size(); i++)
+        unpacked[i].resize(sources[i].size());
+    double seconds[2] = {};
+    for (uint32_t mode = 0; mode < 2; mode++)
+    {
+        packer.SetThreadPool(mode ? pPool : nullptr);
+        uint64_t start = Profiler::NowNs();
+        for (uint32_t pass = 0; pass < passes; pass++)
+        {
+            for (size_t i = 0; i < sources.size(); i++)
+            {
+                if (!packer.Unpack(packedFiles[i].data(), packedFiles[i].size(), unpacked[i].data(), unpacked[i].size()))
+                    result.mismatches++;
+            }
+        }
+        seconds[mode] = (Profiler::NowNs() - start) * 1.0e-9;
+        for (size_t i = 0; i < sources.size(); i++)
+        {
+            if (unpacked[i] != sources[i])
+                result.mismatches++;
+        }
+    }
+
+    double megabytes = result.rawBytes / (1024.0 * 1024.0);
+    result.packRate = packSeconds > 0.0 ? megabytes / packSeconds : 0.0;
+    result.unpackRate = seconds[0] > 0.0 ? megabytes * passes / seconds[0] : 0.0;
+    result.parallelUnpackRate = seconds[1] > 0.0 ? megabytes * passes / seconds[1] : 0.0;
+    double unpackMs = passes ? seconds[1] * 1000.0 / passes : 0.0;
+    for (uint32_t i = 0; i < 2; i++)
+    {
+        // Read, then unpack; a loader that overlaps the two only does better
+        result.rawLoadMs[i] = megabytes * 1000.0 / result.storageRates[i];
+        result.packedLoadMs[i] = result.packedBytes / (1024.0 * 1024.0) * 1000.0 / result.storageRates[i] + unpackMs;
+    }
+    return result;
+}
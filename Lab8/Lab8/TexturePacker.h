@@ -0,0 +1,112 @@
+#ifndef TEXTURE_PACKER_H
+#define TEXTURE_PACKER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class ThreadPool;
+
+// Packed DDS file, little endian:
+//   TexturePackHeader
+//   uint32_t chunks[chunkCount]    compressed size of every chunk, ChunkMode in the top two bits
+//   the DDS magic and headers, headerBytes of them, stored as they are
+//   the chunks, one after another
+// Every chunk holds chunkBytes of the pixel data, the last one the rest.
+struct TexturePackHeader
+{
+    uint32_t magic;             // TexturePackMagic
+    uint32_t version;
+    uint32_t headerBytes;
+    uint32_t chunkBytes;
+    uint64_t payloadBytes;      // pixel data after the DDS headers
+    uint32_t chunkCount;
+    uint32_t stride;            // bytes of one block or texel, the element size of the shuffled chunks
+};
+
+static const uint32_t TexturePackMagic = 0x5A534444; // "DDSZ"
+static const uint32_t TexturePackVersion = 1;
+
+struct TexturePackSettings
+{
+    uint32_t chunkBytes;        // at most 64 KB, so matches never reach into another chunk
+    uint32_t searchDepth;       // earlier positions with the same hash tried for every match
+    bool shuffle;               // also try the chunk split into byte planes, one per byte of a block
+};
+
+struct TexturePackStats
+{
+    uint64_t rawBytes;          // whole DDS file
+    uint64_t packedBytes;       // whole packed file
+    uint32_t chunks;
+    uint32_t shuffledChunks;
+    uint32_t storedChunks;      // that did not get smaller
+    uint32_t threads;
+    double seconds;
+};
+
+struct TexturePackFileResult
+{
+    std::string path;
+    uint64_t rawBytes;
+    uint64_t packedBytes;
+    uint64_t plainBytes;        // packed without the byte planes
+};
+
+struct TexturePackBenchmarkResult
+{
+    std::vector<TexturePackFileResult> files;
+    uint32_t failed;
+    uint32_t passes;
+    uint32_t threads;
+    uint64_t rawBytes;
+    uint64_t packedBytes;
+    uint64_t plainBytes;
+    uint32_t chunks;
+    uint32_t shuffledChunks;
+    uint32_t storedChunks;
+    double packRate;            // MB of DDS data per second, all threads
+    double unpackRate;          // one thread
+    double parallelUnpackRate;  // all threads
+    uint32_t mismatches;        // unpacked files that differ from the DDS files
+    double storageRates[2];     // MB/s of the slow storage the loads are modeled for
+    double rawLoadMs[2];        // reading the DDS files
+    double packedLoadMs[2];     // reading the packed files, then unpacking them on all threads
+};
+
+// Chunked supercompression of DDS files. The pixel data is cut into chunks that are compressed
+// on their own with a byte oriented LZ77: tokens of literal and match lengths, 16 bit offsets,
+// as in LZ4. Block compressed data compresses better split into byte planes, so every chunk is
+// compressed both ways and keeps the smaller, or stays raw. Chunks unpack on the thread pool
+// straight into the buffer that receives the DDS file; only shuffled chunks take a detour
+// through a per thread buffer. The DDS headers are kept as they are, so the unpacked file
+// goes to the loaders unchanged.
+class TexturePacker
+{
+public:
+    TexturePacker();
+
+    void SetThreadPool(ThreadPool* pPool) { m_pPool = pPool; }
+
+    bool Pack(const uint8_t* dds, size_t ddsSize, const TexturePackSettings& settings, std::vector<uint8_t>& packed);
+    // dds must hold GetUnpackedSize bytes
+    bool Unpack(const uint8_t* packed, size_t packedSize, uint8_t* dds, size_t ddsSize);
+    bool Unpack(const uint8_t* packed, size_t packedSize, std::vector<uint8_t>& dds);
+    bool PackFile(const char* sourcePath, const char* destPath, const TexturePackSettings& settings);
+    const TexturePackStats& GetStats() const { return m_stats; }
+
+    static TexturePackSettings GetDefaultSettings();
+    static bool IsPacked(const uint8_t* data, size_t size);
+    // Size of the DDS file, 0 when the header is not valid
+    static uint64_t GetUnpackedSize(const uint8_t* packed, size_t packedSize);
+
+    // Packs every file (UTF-8 paths), then unpacks all of them passes times on one thread and
+    // on the pool and compares the result with the files
+    static TexturePackBenchmarkResult Benchmark(ThreadPool* pPool, const std::vector<std::string>& paths, uint32_t passes);
+
+private:
+    ThreadPool* m_pPool;
+    TexturePackStats m_stats;
+};
+
+#endif
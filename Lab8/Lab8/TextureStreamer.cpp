@@ -0,0 +1,1029 @@
+#include "TextureStreamer.h"
+#include "MappedFile.h"
+#include "Profiler.h"
+#include "TexturePacker.h"
+#include <algorithm>
+
+using namespace DirectX::DDSLayout;
+
+namespace
+{
+    // Max-heap order of the I/O queue
+    template<typename Job>
+    bool RunsLater(const Job& a, const Job& b)
+    {
+        if (a.priority != b.priority)
+            return a.priority < b.priority;
+        return a.order > b.order;
+    }
+
+    uint32_t RowCount(const DDSSubresourceData& subresource)
+    {
+        return subresource.SysMemSlicePitch / subresource.SysMemPitch;
+    }
+
+    bool HasAllocation(StreamState state)
+    {
+        return state == StreamState::Streaming || state == StreamState::Resident || state == StreamState::Downgraded;
+    }
+}
+
+TextureStreamer::TextureStreamer()
+    : m_pDevice(nullptr)
+    , m_pPool(nullptr)
+    , m_settings()
+    , m_stats()
+    , m_frame(0)
+    , m_gpuBytes(0)
+    , m_cpuBytes(0)
+    , m_loading(0)
+    , m_nextOrder(0)
+    , m_stop(false)
+{
+}
+
+TextureStreamer::~TextureStreamer()
+{
+    Shutdown();
+}
+
+bool TextureStreamer::Init(TextureStreamDevice* pDevice, const TextureStreamSettings& settings)
+{
+    Shutdown();
+    if (!pDevice)
+        return false;
+
+    m_pDevice = pDevice;
+    m_settings = settings;
+    m_stop = false;
+    uint32_t threads = std::max(settings.ioThreads, 1u);
+    for (uint32_t i = 0; i < threads; i++)
+        m_threads.emplace_back(&TextureStreamer::IoThread, this);
+    return true;
+}
+
+void TextureStreamer::Shutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+        m_jobs.clear();
+        m_results.clear();
+    }
+    m_wake.notify_all();
+    for (std::thread& thread : m_threads)
+        thread.join();
+    m_threads.clear();
+
+    if (m_pDevice)
+    {
+        for (size_t i = 0; i < m_entries.size(); i++)
+        {
+            if (HasAllocation(m_entries[i].state))
+                m_pDevice->ReleaseTexture(static_cast<StreamedTexture>(i + 1));
+        }
+    }
+    m_entries.clear();
+    m_streaming.clear();
+    m_touched.clear();
+    m_stats = {};
+    m_frame = 0;
+    m_gpuBytes = 0;
+    m_cpuBytes = 0;
+    m_loading = 0;
+    m_pDevice = nullptr;
+}
+
+StreamedTexture TextureStreamer::Request(const std::vector<std::string>& paths, int priority)
+{
+    if (!m_pDevice || paths.empty())
+        return InvalidStreamedTexture;
+
+    Entry entry = {};
+    entry.state = StreamState::Queued;
+    entry.priority = priority;
+    entry.paths = paths;
+    entry.requestNs = Profiler::NowNs();
+    entry.lastUsedFrame = m_frame;
+    m_entries.push_back(std::move(entry));
+    StreamedTexture texture = static_cast<StreamedTexture>(m_entries.size());
+    m_stats.requested++;
+    QueueLoad(texture);
+    return texture;
+}
+
+StreamedTexture TextureStreamer::Request(const char* path, int priority)
+{
+    return Request(std::vector<std::string>(1, path), priority);
+}
+
+void TextureStreamer::QueueLoad(StreamedTexture texture)
+{
+    const Entry& entry = m_entries[texture - 1];
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_jobs.push_back({ texture, entry.priority, m_nextOrder++, entry.paths });
+        std::push_heap(m_jobs.begin(), m_jobs.end(), RunsLater<LoadJob>);
+    }
+    m_wake.notify_one();
+}
+
+void TextureStreamer::Release(StreamedTexture texture)
+{
+    if (texture == InvalidStreamedTexture || texture > m_entries.size())
+        return;
+
+    Entry& entry = m_entries[texture - 1];
+    if (entry.state == StreamState::Queued || entry.reloading)
+    {
+        // A job already taken by an I/O thread is dropped when its result comes back
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = std::find_if(m_jobs.begin(), m_jobs.end(), [texture](const LoadJob& job) { return job.texture == texture; });
+        if (it != m_jobs.end())
+        {
+            m_jobs.erase(it);
+            std::make_heap(m_jobs.begin(), m_jobs.end(), RunsLater<LoadJob>);
+        }
+    }
+    if (entry.state == StreamState::Streaming)
+        m_streaming.erase(std::find(m_streaming.begin(), m_streaming.end(), texture));
+    if (HasAllocation(entry.state))
+    {
+        m_pDevice->ReleaseTexture(texture);
+        m_gpuBytes -= AllocationBytes(entry, entry.allocatedMip);
+    }
+    m_touched.erase(std::remove(m_touched.begin(), m_touched.end(), texture), m_touched.end());
+
+    entry.state = StreamState::Released;
+    entry.reloading = false;
+    FreeFiles(entry);
+}
+
+void TextureStreamer::Touch(StreamedTexture texture, uint32_t mip)
+{
+    if (texture == InvalidStreamedTexture || texture > m_entries.size())
+        return;
+
+    Entry& entry = m_entries[texture - 1];
+    entry.wantedMip = entry.lastUsedFrame == m_frame ? std::min(entry.wantedMip, mip) : mip;
+    entry.lastUsedFrame = m_frame;
+    if (entry.state == StreamState::Downgraded && !entry.reloading &&
+        std::find(m_touched.begin(), m_touched.end(), texture) == m_touched.end())
+    {
+        m_touched.push_back(texture);
+    }
+}
+
+void TextureStreamer::IoThread()
+{
+    for (;;)
+    {
+        LoadJob job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [this]() { return m_stop || !m_jobs.empty(); });
+            if (m_stop)
+                return;
+            std::pop_heap(m_jobs.begin(), m_jobs.end(), RunsLater<LoadJob>);
+            job = std::move(m_jobs.back());
+            m_jobs.pop_back();
+            m_loading++;
+        }
+
+        LoadResult result;
+        result.texture = job.texture;
+        LoadFiles(job, m_pPool, result);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_loading--;
+        if (!m_stop)
+            m_results.push_back(std::move(result));
+    }
+}
+
+void TextureStreamer::LoadFiles(const LoadJob& job, ThreadPool* pPool, LoadResult& result)
+{
+    result.succeeded = false;
+    result.desc = {};
+    std::vector<DDSFileView> views;
+    for (const std::string& path : job.paths)
+    {
+        // The copy is what the uploads read later, so the render thread never faults pages in
+        MappedFile file;
+        if (!file.Open(path.c_str()))
+            return;
+        if (TexturePacker::IsPacked(file.GetData(), file.GetSize()))
+        {
+            // Packed chunks are unpacked straight into that copy
+            TexturePacker packer;
+            packer.SetThreadPool(pPool);
+            result.files.emplace_back();
+            if (!packer.Unpack(file.GetData(), file.GetSize(), result.files.back()))
+                return;
+        }
+        else
+            result.files.emplace_back(file.GetData(), file.GetData() + file.GetSize());
+        views.push_back({ result.files.back().data(), result.files.back().size() });
+    }
+
+    // The same checks and layout as CreateDDSTextureArrayFromFiles
+    DDSArrayLayout arrayLayout;
+    if (FAILED(GetArrayLayout(views.data(), views.size(), 0, DDS_MAX_TEXTURE2D_ARRAY_SIZE, arrayLayout)))
+        return;
+    const DDSTextureLayout& layout = arrayLayout.layout;
+    result.desc.width = layout.width;
+    result.desc.height = layout.height;
+    result.desc.mipCount = layout.mipCount;
+    result.desc.arraySize = layout.arraySize;
+    result.desc.format = layout.format;
+    result.desc.isCubeMap = layout.isCubeMap;
+    result.subresources = std::move(arrayLayout.initData);
+
+    // One row of a 4x4 texel surface is a whole block row for the block compressed formats
+    size_t blockRows = 0;
+    if (FAILED(GetSurfaceInfo(4, 4, result.desc.format, nullptr, nullptr, &blockRows)))
+        return;
+    result.desc.rowHeight = blockRows == 1 ? 4 : 1;
+    result.succeeded = true;
+}
+
+void TextureStreamer::Update()
+{
+    PROFILE_SCOPE("Texture Streaming");
+    m_frame++;
+
+    std::vector<LoadResult> results;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        results.swap(m_results);
+    }
+
+    m_stats.lastPlaceholderBytes = 0;
+    for (LoadResult& result : results)
+    {
+        Entry& entry = m_entries[result.texture - 1];
+        if (entry.state == StreamState::Queued)
+        {
+            if (result.succeeded)
+                StartStreaming(result);
+            else
+                entry.state = StreamState::Failed;
+        }
+        else if (entry.state == StreamState::Downgraded && entry.reloading)
+        {
+            // A file that cannot be read again leaves the texture where it is
+            entry.reloading = false;
+            if (result.succeeded)
+                ResumeStreaming(result);
+        }
+    }
+    ReloadTouched();
+
+    uint64_t budget = m_settings.frameBudgetBytes;
+    uint64_t spent = 0;
+    while (!m_streaming.empty())
+    {
+        StreamedTexture texture = PickNext();
+        uint64_t before = budget;
+        bool finished = UploadNextMip(texture, budget);
+        spent += before - budget;
+        if (finished)
+            continue;
+        if (spent > 0)
+            break;
+
+        // A single row above the whole budget still has to go through at some point
+        const Entry& entry = m_entries[texture - 1];
+        budget = entry.subresources[static_cast<size_t>(entry.uploadSlice) * entry.desc.mipCount + entry.residentMip - 1].SysMemPitch;
+    }
+
+    m_stats.lastFrameBytes = spent;
+    m_stats.maxFrameBytes = std::max(m_stats.maxFrameBytes, m_stats.lastFrameBytes);
+    EnforceMemoryBudget();
+}
+
+void TextureStreamer::TakeFiles(Entry& entry, LoadResult& result)
+{
+    entry.files.swap(result.files);
+    entry.subresources.swap(result.subresources);
+    entry.cpuBytes = 0;
+    for (const std::vector<uint8_t>& file : entry.files)
+        entry.cpuBytes += file.size();
+    m_cpuBytes += entry.cpuBytes;
+    m_stats.bytesRead += entry.cpuBytes;
+}
+
+void TextureStreamer::FreeFiles(Entry& entry)
+{
+    m_cpuBytes -= entry.cpuBytes;
+    entry.cpuBytes = 0;
+    entry.files.clear();
+    entry.files.shrink_to_fit();
+    entry.subresources.clear();
+    entry.subresources.shrink_to_fit();
+}
+
+void TextureStreamer::InitMips(Entry& entry) const
+{
+    uint32_t mipCount = entry.desc.mipCount;
+    entry.mipBytes.assign(mipCount, 0);
+    for (uint32_t slice = 0; slice < entry.desc.arraySize; slice++)
+    {
+        for (uint32_t mip = 0; mip < mipCount; mip++)
+            entry.mipBytes[mip] += entry.subresources[static_cast<size_t>(slice) * mipCount + mip].SysMemSlicePitch;
+    }
+    entry.bytes = AllocationBytes(entry, 0);
+
+    // At least the coarsest mip, then finer ones while they fit the placeholder size
+    uint32_t floorMip = mipCount - 1;
+    uint64_t placeholder = entry.mipBytes[floorMip];
+    while (floorMip > 0 && placeholder + entry.mipBytes[floorMip - 1] <= m_settings.placeholderBytes)
+        placeholder += entry.mipBytes[--floorMip];
+    while (floorMip > 0 && !CanAllocateFrom(entry, floorMip))
+        floorMip--;
+    entry.floorMip = floorMip;
+}
+
+void TextureStreamer::StartStreaming(LoadResult& result)
+{
+    StreamedTexture texture = result.texture;
+    Entry& entry = m_entries[texture - 1];
+    entry.desc = result.desc;
+    TakeFiles(entry, result);
+    InitMips(entry);
+
+    uint32_t mipCount = entry.desc.mipCount;
+    uint32_t floorMip = entry.floorMip;
+    entry.residentMip = mipCount;
+    entry.residentBytes = 0;
+    entry.uploadSlice = 0;
+    entry.uploadRow = 0;
+
+    // Nothing allocated yet, then whatever the memory budget leaves, never less than the placeholder
+    entry.allocatedMip = mipCount;
+    uint32_t firstMip = std::min(ReserveMips(texture), floorMip);
+    if (!m_pDevice->CreateTexture(texture, entry.desc, firstMip))
+    {
+        entry.state = StreamState::Failed;
+        FreeFiles(entry);
+        return;
+    }
+    entry.allocatedMip = firstMip;
+    m_gpuBytes += AllocationBytes(entry, firstMip);
+    entry.state = StreamState::Streaming;
+    m_streaming.push_back(texture);
+
+    while (entry.state == StreamState::Streaming && entry.residentMip > floorMip)
+    {
+        uint64_t unlimited = UINT64_MAX;
+        UploadNextMip(texture, unlimited);
+    }
+    m_stats.lastPlaceholderBytes += AllocationBytes(entry, floorMip);
+}
+
+void TextureStreamer::ResumeStreaming(LoadResult& result)
+{
+    StreamedTexture texture = result.texture;
+    Entry& entry = m_entries[texture - 1];
+    const StreamTextureDesc& desc = result.desc;
+    if (desc.width != entry.desc.width || desc.height != entry.desc.height || desc.mipCount != entry.desc.mipCount ||
+        desc.arraySize != entry.desc.arraySize || desc.format != entry.desc.format)
+    {
+        // The file changed under the texture, its mips no longer belong together
+        m_pDevice->ReleaseTexture(texture);
+        m_gpuBytes -= AllocationBytes(entry, entry.allocatedMip);
+        entry.state = StreamState::Failed;
+        return;
+    }
+
+    // The room may have gone since the Touch, then the file is read for nothing
+    uint32_t firstMip = ReserveMips(texture);
+    if (firstMip >= entry.allocatedMip || !Resize(texture, firstMip))
+        return;
+
+    TakeFiles(entry, result);
+    entry.state = StreamState::Streaming;
+    entry.uploadSlice = 0;
+    entry.uploadRow = 0;
+    m_streaming.push_back(texture);
+}
+
+bool TextureStreamer::UploadNextMip(StreamedTexture texture, uint64_t& budget)
+{
+    Entry& entry = m_entries[texture - 1];
+    uint32_t mip = entry.residentMip - 1;
+    while (entry.uploadSlice < entry.desc.arraySize)
+    {
+        const DDSSubresourceData& subresource = entry.subresources[static_cast<size_t>(entry.uploadSlice) * entry.desc.mipCount + mip];
+        uint32_t rows = RowCount(subresource) - entry.uploadRow;
+        uint32_t fit = static_cast<uint32_t>(std::min<uint64_t>(rows, budget / subresource.SysMemPitch));
+        if (fit == 0)
+            return false;
+
+        const uint8_t* pData = static_cast<const uint8_t*>(subresource.pSysMem) + static_cast<size_t>(entry.uploadRow) * subresource.SysMemPitch;
+        m_pDevice->UploadRows(texture, mip, entry.uploadSlice, entry.uploadRow, fit, pData, subresource.SysMemPitch);
+        uint64_t bytes = static_cast<uint64_t>(fit) * subresource.SysMemPitch;
+        budget -= bytes;
+        m_stats.bytesUploaded += bytes;
+
+        entry.uploadRow += fit;
+        if (entry.uploadRow == RowCount(subresource))
+        {
+            entry.uploadRow = 0;
+            entry.uploadSlice++;
+        }
+    }
+    FinishMip(texture);
+    return true;
+}
+
+void TextureStreamer::FinishMip(StreamedTexture texture)
+{
+    Entry& entry = m_entries[texture - 1];
+    entry.residentMip--;
+    entry.residentBytes += entry.mipBytes[entry.residentMip];
+    entry.uploadSlice = 0;
+    entry.uploadRow = 0;
+    m_pDevice->SetMostDetailedMip(texture, entry.residentMip);
+
+    uint64_t now = Profiler::NowNs();
+    if (!entry.placeholderNs)
+        entry.placeholderNs = now;
+    if (entry.residentMip > entry.allocatedMip &&
+        (entry.residentMip > TargetMip(entry) || !CanAllocateFrom(entry, entry.residentMip)))
+    {
+        return;
+    }
+
+    // The frames sample nothing finer than what is uploaded, the rest is given back unread
+    uint32_t allocatedMip = entry.allocatedMip;
+    if (entry.residentMip > allocatedMip)
+    {
+        if (!Resize(texture, entry.residentMip))
+            return;
+        m_stats.skippedMips += entry.residentMip - allocatedMip;
+    }
+
+    // Everything allocated is uploaded, the file copies are not needed any more
+    if (entry.allocatedMip == 0)
+    {
+        entry.state = StreamState::Resident;
+        if (!entry.residentNs)
+            entry.residentNs = now;
+    }
+    else
+    {
+        entry.state = StreamState::Downgraded;
+    }
+    FreeFiles(entry);
+    m_streaming.erase(std::find(m_streaming.begin(), m_streaming.end(), texture));
+}
+
+StreamedTexture TextureStreamer::PickNext() const
+{
+    // Priority first, then a mip already started, then the texture with the least detail
+    StreamedTexture best = InvalidStreamedTexture;
+    int bestPriority = 0;
+    bool bestStarted = false;
+    uint64_t bestBytes = 0;
+    for (StreamedTexture texture : m_streaming)
+    {
+        const Entry& entry = m_entries[texture - 1];
+        bool started = entry.uploadSlice > 0 || entry.uploadRow > 0;
+        uint64_t bytes = entry.mipBytes[entry.residentMip - 1];
+        bool better = best == InvalidStreamedTexture;
+        if (!better && entry.priority != bestPriority)
+            better = entry.priority > bestPriority;
+        else if (!better && started != bestStarted)
+            better = started;
+        else if (!better && bytes != bestBytes)
+            better = bytes < bestBytes;
+        else if (!better)
+            better = texture < best;
+        if (better)
+        {
+            best = texture;
+            bestPriority = entry.priority;
+            bestStarted = started;
+            bestBytes = bytes;
+        }
+    }
+    return best;
+}
+
+uint64_t TextureStreamer::AllocationBytes(const Entry& entry, uint32_t mip) const
+{
+    uint64_t bytes = 0;
+    for (size_t level = mip; level < entry.mipBytes.size(); level++)
+        bytes += entry.mipBytes[level];
+    return bytes;
+}
+
+bool TextureStreamer::CanAllocateFrom(const Entry& entry, uint32_t mip) const
+{
+    uint32_t block = entry.desc.rowHeight;
+    return mip == 0 || (std::max(entry.desc.width >> mip, 1u) % block == 0 && std::max(entry.desc.height >> mip, 1u) % block == 0);
+}
+
+bool TextureStreamer::IsProtected(const Entry& entry) const
+{
+    return entry.lastUsedFrame + std::max(m_settings.protectFrames, 1u) >= m_frame;
+}
+
+uint32_t TextureStreamer::TargetMip(const Entry& entry) const
+{
+    uint32_t mip = std::min(entry.wantedMip, entry.floorMip);
+    while (mip > 0 && !CanAllocateFrom(entry, mip))
+        mip--;
+    return mip;
+}
+
+uint32_t TextureStreamer::ReserveMips(StreamedTexture texture)
+{
+    const Entry& entry = m_entries[texture - 1];
+    uint32_t target = TargetMip(entry);
+    if (!m_settings.memoryBudgetBytes)
+        return target;
+
+    for (;;)
+    {
+        uint64_t others = m_gpuBytes - AllocationBytes(entry, entry.allocatedMip);
+        uint32_t fit = entry.floorMip;
+        for (uint32_t mip = target; mip < entry.floorMip; mip++)
+        {
+            if (CanAllocateFrom(entry, mip) && others + AllocationBytes(entry, mip) <= m_settings.memoryBudgetBytes)
+            {
+                fit = mip;
+                break;
+            }
+        }
+        if (fit == target || !EvictOne(texture))
+            return fit;
+    }
+}
+
+bool TextureStreamer::EvictOne(StreamedTexture keep)
+{
+    // Mips nobody samples go first, protected or not, then the stale textures. The next block
+    // aligned mip of a surplus texture is at most its target, which is aligned itself.
+    StreamedTexture victim = InvalidStreamedTexture;
+    bool victimSurplus = false;
+    for (size_t i = 0; i < m_entries.size(); i++)
+    {
+        const Entry& entry = m_entries[i];
+        StreamedTexture texture = static_cast<StreamedTexture>(i + 1);
+        if ((entry.state != StreamState::Resident && entry.state != StreamState::Downgraded) || entry.reloading ||
+            texture == keep || entry.allocatedMip >= entry.floorMip)
+        {
+            continue;
+        }
+        bool surplus = entry.allocatedMip < TargetMip(entry);
+        if (!surplus && IsProtected(entry))
+            continue;
+        if (victim == InvalidStreamedTexture || (surplus && !victimSurplus) ||
+            (surplus == victimSurplus && entry.lastUsedFrame < m_entries[victim - 1].lastUsedFrame))
+        {
+            victim = texture;
+            victimSurplus = surplus;
+        }
+    }
+    if (victim == InvalidStreamedTexture)
+        return false;
+
+    Entry& entry = m_entries[victim - 1];
+    uint32_t allocatedMip = entry.allocatedMip;
+    uint64_t before = AllocationBytes(entry, allocatedMip);
+    uint32_t mip = allocatedMip + 1;
+    while (mip < entry.floorMip && !CanAllocateFrom(entry, mip))
+        mip++;
+    if (!Resize(victim, mip))
+        return false;
+    entry.state = StreamState::Downgraded;
+    m_stats.evictedMips += mip - allocatedMip;
+    m_stats.evictedBytes += before - AllocationBytes(entry, mip);
+    return true;
+}
+
+bool TextureStreamer::Resize(StreamedTexture texture, uint32_t firstMip)
+{
+    Entry& entry = m_entries[texture - 1];
+    if (!m_pDevice->ResizeTexture(texture, firstMip))
+        return false;
+
+    uint64_t before = AllocationBytes(entry, entry.allocatedMip);
+    uint64_t after = AllocationBytes(entry, firstMip);
+    m_gpuBytes = m_gpuBytes - before + after;
+    entry.allocatedMip = firstMip;
+    if (entry.residentMip < firstMip)
+    {
+        entry.residentMip = firstMip;
+        entry.residentBytes = after;
+    }
+    return true;
+}
+
+void TextureStreamer::EnforceMemoryBudget()
+{
+    // Streaming textures keep their allocation, the budget is met again once they finish
+    if (!m_settings.memoryBudgetBytes)
+        return;
+    while (m_gpuBytes > m_settings.memoryBudgetBytes && EvictOne(InvalidStreamedTexture))
+    {
+    }
+}
+
+void TextureStreamer::ReloadTouched()
+{
+    if (m_touched.empty())
+        return;
+
+    // What a reload could get: the free part of the budget and whatever stale textures would give up
+    uint64_t room = UINT64_MAX;
+    if (m_settings.memoryBudgetBytes)
+    {
+        room = m_settings.memoryBudgetBytes > m_gpuBytes ? m_settings.memoryBudgetBytes - m_gpuBytes : 0;
+        for (const Entry& entry : m_entries)
+        {
+            if ((entry.state == StreamState::Resident || entry.state == StreamState::Downgraded) && !entry.reloading &&
+                entry.allocatedMip < entry.floorMip && !IsProtected(entry))
+            {
+                room += AllocationBytes(entry, entry.allocatedMip) - AllocationBytes(entry, entry.floorMip);
+            }
+        }
+    }
+
+    for (StreamedTexture texture : m_touched)
+    {
+        Entry& entry = m_entries[texture - 1];
+        if (entry.state != StreamState::Downgraded || entry.reloading || entry.wantedMip >= entry.allocatedMip)
+            continue;
+        uint32_t mip = entry.allocatedMip - 1;
+        while (mip > 0 && !CanAllocateFrom(entry, mip))
+            mip--;
+        uint64_t needed = AllocationBytes(entry, mip) - AllocationBytes(entry, entry.allocatedMip);
+        if (needed > room)
+            continue;
+
+        room -= needed;
+        entry.reloading = true;
+        m_stats.reloads++;
+        QueueLoad(texture);
+    }
+    m_touched.clear();
+}
+
+bool TextureStreamer::IsIdle() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_jobs.empty() && m_loading == 0 && m_results.empty() && m_streaming.empty();
+}
+
+StreamTextureInfo TextureStreamer::GetInfo(StreamedTexture texture) const
+{
+    StreamTextureInfo info = {};
+    if (texture == InvalidStreamedTexture || texture > m_entries.size())
+    {
+        info.state = StreamState::Failed;
+        return info;
+    }
+
+    const Entry& entry = m_entries[texture - 1];
+    info.state = entry.state;
+    info.width = entry.desc.width;
+    info.height = entry.desc.height;
+    info.mipCount = entry.desc.mipCount;
+    info.wantedMip = entry.wantedMip;
+    info.residentMip = entry.residentMip;
+    info.allocatedMip = entry.allocatedMip;
+    info.bytes = entry.bytes;
+    info.residentBytes = entry.residentBytes;
+    info.gpuBytes = HasAllocation(entry.state) ? AllocationBytes(entry, entry.allocatedMip) : 0;
+    info.cpuBytes = entry.cpuBytes;
+    info.lastUsedFrame = entry.lastUsedFrame;
+    info.placeholderMs = entry.placeholderNs ? (entry.placeholderNs - entry.requestNs) * 1.0e-6 : 0.0;
+    info.residentMs = entry.residentNs ? (entry.residentNs - entry.requestNs) * 1.0e-6 : 0.0;
+    return info;
+}
+
+uint64_t TextureStreamer::GetMipBytes(StreamedTexture texture, uint32_t mip) const
+{
+    if (texture == InvalidStreamedTexture || texture > m_entries.size() || mip >= m_entries[texture - 1].mipBytes.size())
+        return 0;
+    return m_entries[texture - 1].mipBytes[mip];
+}
+
+TextureStreamStats TextureStreamer::GetStats() const
+{
+    TextureStreamStats stats = m_stats;
+    for (const Entry& entry : m_entries)
+    {
+        switch (entry.state)
+        {
+        case StreamState::Queued:       stats.queued++; break;
+        case StreamState::Streaming:    stats.streaming++; stats.pendingBytes += AllocationBytes(entry, entry.allocatedMip) - entry.residentBytes; break;
+        case StreamState::Resident:     stats.resident++; break;
+        case StreamState::Downgraded:   stats.downgraded++; break;
+        case StreamState::Failed:       stats.failed++; break;
+        default: break;
+        }
+    }
+    stats.gpuBytes = m_gpuBytes;
+    stats.cpuBytes = m_cpuBytes;
+    stats.memoryBudgetBytes = m_settings.memoryBudgetBytes;
+    return stats;
+}
+
+TextureStreamBenchmarkResult TextureStreamer::Benchmark(const std::vector<std::string>& paths, uint32_t copies, uint64_t budgetBytes)
+{
+    TextureStreamBenchmarkResult result = {};
+    result.budgetBytes = budgetBytes;
+
+    NullTextureStreamDevice device;
+    TextureStreamer streamer;
+    TextureStreamSettings settings = { 2, budgetBytes, 64 * 1024, 0, 1 };
+    if (!streamer.Init(&device, settings))
+        return result;
+
+    // Three priorities, so the queue and the budget both have to sort
+    uint64_t start = Profiler::NowNs();
+    std::vector<StreamedTexture> textures;
+    for (uint32_t copy = 0; copy < copies; copy++)
+    {
+        for (const std::string& path : paths)
+            textures.push_back(streamer.Request(path.c_str(), static_cast<int>(copy % 3)));
+    }
+    result.textures = static_cast<uint32_t>(textures.size());
+
+    while (!streamer.IsIdle())
+    {
+        streamer.Update();
+        result.frames++;
+        const TextureStreamStats& stats = streamer.m_stats;
+        result.maxFrameBytes = std::max(result.maxFrameBytes, stats.lastFrameBytes);
+        if (!result.placeholderFrames)
+        {
+            bool sampled = true;
+            for (StreamedTexture texture : textures)
+            {
+                const Entry& entry = streamer.m_entries[texture - 1];
+                sampled = sampled && (entry.state == StreamState::Failed || entry.placeholderNs != 0);
+            }
+            if (sampled)
+                result.placeholderFrames = result.frames;
+        }
+        // The rest of a frame, where the I/O threads get the core on small machines
+        std::this_thread::yield();
+    }
+    result.seconds = (Profiler::NowNs() - start) * 1.0e-9;
+
+    // Everything the files hold has to arrive exactly once, and every texture must end up whole
+    uint64_t expected = 0;
+    for (StreamedTexture texture : textures)
+    {
+        StreamTextureInfo info = streamer.GetInfo(texture);
+        if (info.state == StreamState::Failed)
+        {
+            result.failed++;
+            continue;
+        }
+        expected += info.bytes;
+        if (info.state != StreamState::Resident || device.GetMostDetailedMip(texture) != 0)
+            result.deviceErrors++;
+    }
+    result.bytes = device.GetBytesUploaded();
+    result.deviceErrors += device.GetErrorCount() + (result.bytes != expected ? 1 : 0);
+    return result;
+}
+
+TextureResidencyBenchmarkResult TextureStreamer::BenchmarkResidency(const std::vector<std::string>& paths, uint32_t copies,
+    uint32_t hotTextures, float budgetScale, uint32_t frames)
+{
+    TextureResidencyBenchmarkResult result = {};
+
+    NullTextureStreamDevice device;
+    TextureStreamer streamer;
+    TextureStreamSettings settings = { 2, 1024 * 1024, 64 * 1024, 0, 4 };
+    if (!streamer.Init(&device, settings))
+        return result;
+
+    // Files that have a single mip cannot give anything up, so the budget starts above the placeholders
+    for (const std::string& path : paths)
+    {
+        LoadJob job = { InvalidStreamedTexture, 0, 0, std::vector<std::string>(1, path) };
+        LoadResult loaded;
+        LoadFiles(job, nullptr, loaded);
+        if (!loaded.succeeded)
+            continue;
+        Entry entry = {};
+        entry.desc = loaded.desc;
+        entry.subresources.swap(loaded.subresources);
+        streamer.InitMips(entry);
+        result.totalBytes += entry.bytes * copies;
+        result.floorBytes += streamer.AllocationBytes(entry, entry.floorMip) * copies;
+    }
+    result.budgetBytes = result.floorBytes + static_cast<uint64_t>((result.totalBytes - result.floorBytes) * static_cast<double>(budgetScale));
+    streamer.SetMemoryBudget(result.budgetBytes);
+
+    uint64_t start = Profiler::NowNs();
+    std::vector<StreamedTexture> textures;
+    for (uint32_t copy = 0; copy < copies; copy++)
+    {
+        for (const std::string& path : paths)
+            textures.push_back(streamer.Request(path.c_str()));
+    }
+    uint32_t count = static_cast<uint32_t>(textures.size());
+    uint32_t hot = std::min(hotTextures, count);
+    result.textures = count;
+    result.hotTextures = hot;
+
+    // A hot texture counts as thrashing when it loses a mip after it was resident once
+    std::vector<bool> hotResident(hot, false);
+    const uint32_t window = 4;
+    const uint32_t windowFrames = 8;
+    for (uint32_t frame = 0; frame < frames; frame++)
+    {
+        streamer.Update();
+        result.frames++;
+        result.maxGpuBytes = std::max(result.maxGpuBytes, streamer.m_gpuBytes);
+        if (streamer.m_gpuBytes > result.budgetBytes)
+            result.overBudgetFrames++;
+        if (streamer.m_gpuBytes != device.GetAllocatedBytes())
+            result.accountingErrors++;
+
+        bool allResident = true;
+        for (uint32_t i = 0; i < hot; i++)
+        {
+            const Entry& entry = streamer.m_entries[textures[i] - 1];
+            if (hotResident[i] && entry.allocatedMip > 0)
+            {
+                result.hotDowngrades++;
+                hotResident[i] = false;
+            }
+            hotResident[i] = hotResident[i] || entry.state == StreamState::Resident;
+            allResident = allResident && entry.state == StreamState::Resident;
+        }
+        if (allResident)
+            result.hotResidentFrames++;
+
+        // Binds of the frame: the hot set, then a window sliding over the cold textures
+        for (uint32_t i = 0; i < hot; i++)
+            streamer.Touch(textures[i]);
+        if (count > hot)
+        {
+            uint32_t first = (frame / windowFrames) * window;
+            for (uint32_t i = 0; i < window; i++)
+                streamer.Touch(textures[hot + (first + i) % (count - hot)]);
+        }
+        std::this_thread::yield();
+    }
+    result.seconds = (Profiler::NowNs() - start) * 1.0e-9;
+
+    // Every byte the streamer counts has to exist on the device and the other way round
+    uint64_t counted = 0;
+    for (StreamedTexture texture : textures)
+        counted += streamer.GetInfo(texture).gpuBytes;
+    if (counted != device.GetAllocatedBytes())
+        result.accountingErrors++;
+    result.evictedMips = streamer.m_stats.evictedMips;
+    result.reloads = streamer.m_stats.reloads;
+    result.deviceErrors = device.GetErrorCount();
+    return result;
+}
+
+NullTextureStreamDevice::Texture* NullTextureStreamDevice::Find(StreamedTexture texture)
+{
+    if (texture == InvalidStreamedTexture || texture > m_textures.size() || !m_textures[texture - 1].alive)
+    {
+        m_errorCount++;
+        return nullptr;
+    }
+    return &m_textures[texture - 1];
+}
+
+uint64_t NullTextureStreamDevice::AllocationBytes(const Texture& texture, uint32_t firstMip) const
+{
+    uint64_t bytes = 0;
+    for (uint32_t mip = firstMip; mip < texture.desc.mipCount; mip++)
+        bytes += static_cast<uint64_t>(texture.rowCounts[mip]) * texture.rowPitches[mip] * texture.desc.arraySize;
+    return bytes;
+}
+
+bool NullTextureStreamDevice::CreateTexture(StreamedTexture texture, const StreamTextureDesc& desc, uint32_t firstMip)
+{
+    if (texture == InvalidStreamedTexture || desc.mipCount == 0 || desc.arraySize == 0 || firstMip >= desc.mipCount)
+    {
+        m_errorCount++;
+        return false;
+    }
+    if (m_textures.size() < texture)
+        m_textures.resize(texture);
+    Texture& entry = m_textures[texture - 1];
+    if (entry.alive)
+        m_errorCount++;
+
+    entry.alive = true;
+    entry.desc = desc;
+    entry.mostDetailedMip = desc.mipCount;
+    entry.rowCounts.resize(desc.mipCount);
+    entry.rowPitches.resize(desc.mipCount);
+    for (uint32_t mip = 0; mip < desc.mipCount; mip++)
+    {
+        size_t rowBytes = 0;
+        size_t rows = 0;
+        if (FAILED(GetSurfaceInfo(std::max(desc.width >> mip, 1u), std::max(desc.height >> mip, 1u), desc.format, nullptr, &rowBytes, &rows)))
+            m_errorCount++;
+        entry.rowCounts[mip] = static_cast<uint32_t>(rows);
+        entry.rowPitches[mip] = static_cast<uint32_t>(rowBytes);
+    }
+    entry.uploadedRows.assign(static_cast<size_t>(desc.mipCount) * desc.arraySize, 0);
+    entry.firstMip = desc.mipCount;
+    return ResizeTexture(texture, firstMip);
+}
+
+bool NullTextureStreamDevice::ResizeTexture(StreamedTexture texture, uint32_t firstMip)
+{
+    Texture* pTexture = Find(texture);
+    if (!pTexture)
+        return false;
+
+    // A block compressed texture has to start at whole blocks, like on the GPU
+    const StreamTextureDesc& desc = pTexture->desc;
+    uint32_t block = desc.rowHeight;
+    if (firstMip >= desc.mipCount || (firstMip > 0 &&
+        (std::max(desc.width >> firstMip, 1u) % block != 0 || std::max(desc.height >> firstMip, 1u) % block != 0)))
+    {
+        m_errorCount++;
+        return false;
+    }
+
+    // Mips that leave the allocation lose their data
+    for (uint32_t mip = pTexture->firstMip; mip < firstMip && mip < desc.mipCount; mip++)
+    {
+        for (uint32_t slice = 0; slice < desc.arraySize; slice++)
+            pTexture->uploadedRows[static_cast<size_t>(mip) * desc.arraySize + slice] = 0;
+    }
+    m_allocatedBytes -= AllocationBytes(*pTexture, pTexture->firstMip);
+    m_allocatedBytes += AllocationBytes(*pTexture, firstMip);
+    pTexture->firstMip = firstMip;
+    pTexture->mostDetailedMip = std::max(pTexture->mostDetailedMip, firstMip);
+    return true;
+}
+
+void NullTextureStreamDevice::UploadRows(StreamedTexture texture, uint32_t mip, uint32_t slice, uint32_t firstRow, uint32_t rowCount,
+    const uint8_t* pData, uint32_t rowPitch)
+{
+    Texture* pTexture = Find(texture);
+    if (!pTexture)
+        return;
+    if (mip < pTexture->firstMip || mip >= pTexture->desc.mipCount || slice >= pTexture->desc.arraySize || !pData || rowCount == 0)
+    {
+        m_errorCount++;
+        return;
+    }
+
+    // Rows arrive in order, without gaps or overlaps, and never past the end
+    uint32_t& uploaded = pTexture->uploadedRows[static_cast<size_t>(mip) * pTexture->desc.arraySize + slice];
+    if (firstRow != uploaded || firstRow + rowCount > pTexture->rowCounts[mip] || rowPitch != pTexture->rowPitches[mip])
+        m_errorCount++;
+    uploaded = std::max(uploaded, firstRow + rowCount);
+    m_bytesUploaded += static_cast<uint64_t>(rowCount) * rowPitch;
+    m_uploads++;
+}
+
+void NullTextureStreamDevice::SetMostDetailedMip(StreamedTexture texture, uint32_t mip)
+{
+    Texture* pTexture = Find(texture);
+    if (!pTexture)
+        return;
+    if (mip >= pTexture->mostDetailedMip || mip < pTexture->firstMip)
+    {
+        m_errorCount++;
+        return;
+    }
+
+    for (uint32_t level = mip; level < pTexture->desc.mipCount; level++)
+    {
+        for (uint32_t slice = 0; slice < pTexture->desc.arraySize; slice++)
+        {
+            if (pTexture->uploadedRows[static_cast<size_t>(level) * pTexture->desc.arraySize + slice] != pTexture->rowCounts[level])
+                m_errorCount++;
+        }
+    }
+    pTexture->mostDetailedMip = mip;
+}
+
+void NullTextureStreamDevice::ReleaseTexture(StreamedTexture texture)
+{
+    Texture* pTexture = Find(texture);
+    if (!pTexture)
+        return;
+    m_allocatedBytes -= AllocationBytes(*pTexture, pTexture->firstMip);
+    pTexture->alive = false;
+}
+
+uint32_t NullTextureStreamDevice::GetMostDetailedMip(StreamedTexture texture) const
+{
+    if (texture == InvalidStreamedTexture || texture > m_textures.size() || !m_textures[texture - 1].alive)
+        return 0;
+    return m_textures[texture - 1].mostDetailedMip;
+}
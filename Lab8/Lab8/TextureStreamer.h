@@ -0,0 +1,339 @@
+#ifndef TEXTURE_STREAMER_H
+#define TEXTURE_STREAMER_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "DDSLayout.h"
+
+class ThreadPool;
+
+typedef uint32_t StreamedTexture;
+static const StreamedTexture InvalidStreamedTexture = 0;
+
+struct StreamTextureDesc
+{
+    uint32_t width;             // mip 0
+    uint32_t height;
+    uint32_t mipCount;
+    uint32_t arraySize;         // six per cube, the slices of all files one after another
+    uint32_t rowHeight;         // texels in one upload row, 4 for block compressed formats
+    DXGI_FORMAT format;
+    bool isCubeMap;
+};
+
+// Receives the streamed data, only ever called from the thread that runs TextureStreamer::Update.
+// Mip numbers always count from mip 0 of the file, whatever part of the chain is allocated.
+class TextureStreamDevice
+{
+public:
+    virtual ~TextureStreamDevice() {}
+
+    // Allocates firstMip and every coarser mip, none is sampled before SetMostDetailedMip
+    virtual bool CreateTexture(StreamedTexture texture, const StreamTextureDesc& desc, uint32_t firstMip) = 0;
+    // Reallocates from firstMip on; uploaded mips that stay allocated keep their data
+    virtual bool ResizeTexture(StreamedTexture texture, uint32_t firstMip) = 0;
+    // rowCount rows of rowHeight texels starting at firstRow, rowPitch bytes apart
+    virtual void UploadRows(StreamedTexture texture, uint32_t mip, uint32_t slice, uint32_t firstRow, uint32_t rowCount,
+        const uint8_t* pData, uint32_t rowPitch) = 0;
+    // Sampling may use mip and everything coarser, all of it uploaded
+    virtual void SetMostDetailedMip(StreamedTexture texture, uint32_t mip) = 0;
+    virtual void ReleaseTexture(StreamedTexture texture) = 0;
+};
+
+struct TextureStreamSettings
+{
+    uint32_t ioThreads;
+    uint64_t frameBudgetBytes;  // finer mips uploaded by one Update
+    uint64_t placeholderBytes;  // coarsest mips uploaded as soon as a file is read, outside the budget
+    uint64_t memoryBudgetBytes; // allocated mips of all textures, 0 for no limit
+    uint32_t protectFrames;     // Updates after a Touch during which a texture keeps its wanted mips
+};
+
+enum class StreamState : uint32_t
+{
+    Queued,         // waiting for or in I/O
+    Streaming,      // sampled at residentMip, finer mips on the way
+    Resident,       // every mip uploaded
+    Downgraded,     // held at allocatedMip by the memory budget or its wanted mip, a Touch may read the file again
+    Failed,
+    Released
+};
+
+struct StreamTextureInfo
+{
+    StreamState state;
+    uint32_t width;             // of mip 0, 0 until the file is read
+    uint32_t height;
+    uint32_t mipCount;
+    uint32_t wantedMip;         // finest mip asked for by the Touches of the last frame
+    uint32_t residentMip;       // mipCount until the placeholder is in
+    uint32_t allocatedMip;      // finest mip the device holds memory for
+    uint64_t bytes;             // every mip of every slice
+    uint64_t residentBytes;
+    uint64_t gpuBytes;          // allocated mips, uploaded or not
+    uint64_t cpuBytes;          // file copies kept while streaming
+    uint64_t lastUsedFrame;     // Update of the last Touch
+    double placeholderMs;       // Request to the first sampled mip
+    double residentMs;          // Request to the whole chain
+};
+
+struct TextureStreamStats
+{
+    uint32_t requested;
+    uint32_t queued;
+    uint32_t streaming;
+    uint32_t resident;
+    uint32_t failed;
+    uint64_t bytesRead;
+    uint64_t bytesUploaded;
+    uint64_t pendingBytes;      // read, not uploaded yet
+    uint64_t lastFrameBytes;    // budgeted uploads of the last Update
+    uint64_t lastPlaceholderBytes;
+    uint64_t maxFrameBytes;
+
+    uint32_t downgraded;
+    uint64_t gpuBytes;
+    uint64_t cpuBytes;
+    uint64_t memoryBudgetBytes;
+    uint64_t evictedMips;       // mip levels given up to the memory budget
+    uint64_t evictedBytes;
+    uint64_t skippedMips;       // never streamed, no frame asked for them
+    uint32_t reloads;           // downgraded textures read again after a Touch
+};
+
+struct TextureStreamBenchmarkResult
+{
+    uint32_t textures;
+    uint32_t failed;
+    uint32_t placeholderFrames; // Updates until every texture could be sampled
+    uint32_t frames;            // Updates until every texture was resident
+    uint64_t bytes;
+    uint64_t budgetBytes;
+    uint64_t maxFrameBytes;     // largest budgeted upload of one Update
+    uint64_t deviceErrors;      // out of order uploads, sampling mips that were not uploaded
+    double seconds;
+};
+
+struct TextureResidencyBenchmarkResult
+{
+    uint32_t textures;
+    uint32_t hotTextures;       // touched every frame, their mips must fit the budget
+    uint32_t frames;
+    uint64_t budgetBytes;
+    uint64_t totalBytes;        // every texture fully resident
+    uint64_t floorBytes;        // placeholders, never given up to the budget
+    uint64_t maxGpuBytes;       // largest allocation after an Update
+    uint32_t overBudgetFrames;  // while protected or streaming textures hold more than the budget
+    uint64_t evictedMips;
+    uint32_t reloads;
+    uint32_t hotDowngrades;     // hot textures that lost a mip, thrashing if not zero
+    uint32_t hotResidentFrames; // frames in which every hot texture was fully resident
+    uint64_t accountingErrors;  // streamer and device disagree on allocated bytes
+    uint64_t deviceErrors;
+    double seconds;
+};
+
+// Textures are requested by handle and read on I/O threads of their own, so a request never
+// blocks the caller. Once a file is read, Update creates the texture and uploads its coarsest
+// mips right away as a placeholder; finer mips follow in row bands that fit a byte budget per
+// Update, the highest priority and then the least detailed texture first, so no frame pays for
+// a whole large mip. A mip becomes visible only when every slice of it is complete.
+// Under a memory budget the textures that were not touched for the longest time give up their
+// finest mips, down to the placeholder; a texture touched within protectFrames is never
+// downgraded, a new or reloaded one gets the finest mips that fit instead, so the working set
+// does not thrash. A Touch may say which mip the frame needs: mips finer than that are neither
+// streamed nor kept under the budget, even while the texture is protected. A downgraded texture
+// reads its file again when touched for a finer mip than it holds and there is room.
+// The device is an interface, NullTextureStreamDevice checks the upload order without a GPU.
+class TextureStreamer
+{
+public:
+    TextureStreamer();
+    ~TextureStreamer();
+
+    bool Init(TextureStreamDevice* pDevice, const TextureStreamSettings& settings);
+    // Stops the I/O threads and releases every texture on the device
+    void Shutdown();
+
+    // Packed files (TexturePacker) unpack their chunks on this pool, on the I/O thread without one.
+    // Set before the first Request.
+    void SetThreadPool(ThreadPool* pPool) { m_pPool = pPool; }
+    void SetFrameBudget(uint64_t bytes) { m_settings.frameBudgetBytes = bytes; }
+    const TextureStreamSettings& GetSettings() const { return m_settings; }
+
+    // Several files become one array of all their slices and must match in size, format and mips
+    StreamedTexture Request(const std::vector<std::string>& paths, int priority = 0);
+    StreamedTexture Request(const char* path, int priority = 0);
+    void Release(StreamedTexture texture);
+
+    // Usage stamp, called where the texture is bound; keeps it from being downgraded for a while.
+    // mip is the finest one the caller samples, the Touches of one frame keep the finest of them.
+    void Touch(StreamedTexture texture, uint32_t mip = 0);
+    void SetMemoryBudget(uint64_t bytes) { m_settings.memoryBudgetBytes = bytes; }
+
+    // Creates the textures whose files were read, uploads their placeholders, spends the upload
+    // budget and then brings the allocations back under the memory budget
+    void Update();
+    // Nothing waits for I/O or upload
+    bool IsIdle() const;
+
+    StreamTextureInfo GetInfo(StreamedTexture texture) const;
+    // All slices of one mip, 0 until the file is read
+    uint64_t GetMipBytes(StreamedTexture texture, uint32_t mip) const;
+    TextureStreamStats GetStats() const;
+
+    // Streams copies of every file against NullTextureStreamDevice until all are resident
+    static TextureStreamBenchmarkResult Benchmark(const std::vector<std::string>& paths, uint32_t copies, uint64_t budgetBytes);
+    // Copies of every file under a memory budget: a hot set is touched every frame, the rest in
+    // a sliding window, so cold textures have to give up mips while the hot ones keep theirs.
+    // The budget is the placeholders plus budgetScale of everything above them.
+    static TextureResidencyBenchmarkResult BenchmarkResidency(const std::vector<std::string>& paths, uint32_t copies,
+        uint32_t hotTextures, float budgetScale, uint32_t frames);
+
+private:
+    struct LoadJob
+    {
+        StreamedTexture texture;
+        int priority;
+        uint64_t order;
+        std::vector<std::string> paths;
+    };
+
+    struct LoadResult
+    {
+        StreamedTexture texture;
+        bool succeeded;
+        StreamTextureDesc desc;
+        std::vector<std::vector<uint8_t>> files;
+        std::vector<DirectX::DDSLayout::DDSSubresourceData> subresources;  // slice * mipCount + mip
+    };
+
+    struct Entry
+    {
+        StreamState state;
+        int priority;
+        std::vector<std::string> paths;
+        uint64_t requestNs;
+        uint64_t placeholderNs;
+        uint64_t residentNs;
+        StreamTextureDesc desc;
+        std::vector<std::vector<uint8_t>> files;    // freed once the allocated mips are uploaded
+        std::vector<DirectX::DDSLayout::DDSSubresourceData> subresources;
+        std::vector<uint64_t> mipBytes;             // all slices of one mip
+        uint32_t residentMip;
+        uint32_t allocatedMip;
+        uint32_t floorMip;      // the budget never takes the placeholder
+        uint32_t uploadSlice;   // progress in residentMip - 1
+        uint32_t uploadRow;
+        uint64_t bytes;
+        uint64_t residentBytes;
+        uint64_t cpuBytes;
+        uint64_t lastUsedFrame;
+        uint32_t wantedMip;     // of the frame in lastUsedFrame
+        bool reloading;         // downgraded, file queued again
+    };
+
+    void IoThread();
+    static void LoadFiles(const LoadJob& job, ThreadPool* pPool, LoadResult& result);
+    void QueueLoad(StreamedTexture texture);
+    void StartStreaming(LoadResult& result);
+    void ResumeStreaming(LoadResult& result);
+    // Sizes of the mips and the placeholder of a texture whose files were just read
+    void InitMips(Entry& entry) const;
+    void TakeFiles(Entry& entry, LoadResult& result);
+    void FreeFiles(Entry& entry);
+    // Uploads what fits in budget of the next mip, true when the mip became visible
+    bool UploadNextMip(StreamedTexture texture, uint64_t& budget);
+    StreamedTexture PickNext() const;
+    void FinishMip(StreamedTexture texture);
+
+    // Bytes of mip and every coarser one
+    uint64_t AllocationBytes(const Entry& entry, uint32_t mip) const;
+    // Block compressed allocations have to start at a mip of whole blocks
+    bool CanAllocateFrom(const Entry& entry, uint32_t mip) const;
+    bool IsProtected(const Entry& entry) const;
+    // Finest mip worth allocating: the wanted one rounded to whole blocks, at most the placeholder
+    uint32_t TargetMip(const Entry& entry) const;
+    // Finest mip texture may allocate, after downgrading stale textures to make room for it
+    uint32_t ReserveMips(StreamedTexture texture);
+    // Drops the finest allocated mip of a texture holding more than it wants, else of the least
+    // recently used texture that is not protected
+    bool EvictOne(StreamedTexture keep);
+    bool Resize(StreamedTexture texture, uint32_t firstMip);
+    void EnforceMemoryBudget();
+    void ReloadTouched();
+
+    TextureStreamDevice* m_pDevice;
+    ThreadPool* m_pPool;
+    TextureStreamSettings m_settings;
+
+    // Owned by the thread that calls Update
+    std::vector<Entry> m_entries;       // handle - 1
+    std::vector<StreamedTexture> m_streaming;
+    std::vector<StreamedTexture> m_touched; // downgraded textures touched since the last Update
+    TextureStreamStats m_stats;
+    uint64_t m_frame;
+    uint64_t m_gpuBytes;
+    uint64_t m_cpuBytes;
+
+    // Shared with the I/O threads
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::vector<LoadJob> m_jobs;        // heap, highest priority first, then request order
+    std::vector<LoadResult> m_results;
+    uint32_t m_loading;                 // jobs taken by an I/O thread
+    uint64_t m_nextOrder;
+    bool m_stop;
+    std::vector<std::thread> m_threads;
+};
+
+// Device without a GPU: keeps the uploaded rows of every subresource and counts every call
+// that uploads out of order, twice or past the end, or exposes a mip before all of it arrived.
+class NullTextureStreamDevice : public TextureStreamDevice
+{
+public:
+    NullTextureStreamDevice() : m_errorCount(0), m_bytesUploaded(0), m_uploads(0), m_allocatedBytes(0) {}
+
+    bool CreateTexture(StreamedTexture texture, const StreamTextureDesc& desc, uint32_t firstMip) override;
+    bool ResizeTexture(StreamedTexture texture, uint32_t firstMip) override;
+    void UploadRows(StreamedTexture texture, uint32_t mip, uint32_t slice, uint32_t firstRow, uint32_t rowCount,
+        const uint8_t* pData, uint32_t rowPitch) override;
+    void SetMostDetailedMip(StreamedTexture texture, uint32_t mip) override;
+    void ReleaseTexture(StreamedTexture texture) override;
+
+    uint64_t GetErrorCount() const { return m_errorCount; }
+    uint64_t GetBytesUploaded() const { return m_bytesUploaded; }
+    uint64_t GetUploadCount() const { return m_uploads; }
+    // mipCount when nothing can be sampled
+    uint32_t GetMostDetailedMip(StreamedTexture texture) const;
+    // Memory of the allocated mips of every live texture
+    uint64_t GetAllocatedBytes() const { return m_allocatedBytes; }
+
+private:
+    struct Texture
+    {
+        bool alive;
+        StreamTextureDesc desc;
+        uint32_t firstMip;
+        uint32_t mostDetailedMip;
+        std::vector<uint32_t> rowCounts;    // per mip
+        std::vector<uint32_t> rowPitches;
+        std::vector<uint32_t> uploadedRows; // mip * arraySize + slice
+    };
+
+    Texture* Find(StreamedTexture texture);
+    uint64_t AllocationBytes(const Texture& texture, uint32_t firstMip) const;
+
+    std::vector<Texture> m_textures;    // handle - 1
+    uint64_t m_errorCount;
+    uint64_t m_bytesUploaded;
+    uint64_t m_uploads;
+    uint64_t m_allocatedBytes;
+};
+
+#endif
@@ -0,0 +1,153 @@
+#include "ThreadPool.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <string>
+
+namespace
+{
+    thread_local bool t_insideTask = false;
+    thread_local uint32_t t_threadIndex = 0;
+    thread_local ThreadPool::Priority t_priority = ThreadPool::Priority::Frame;
+}
+
+ThreadPool& ThreadPool::Get()
+{
+    // One thread is left for the caller, which also runs tasks
+    static ThreadPool pool(std::thread::hardware_concurrency() > 1 ? std::thread::hardware_concurrency() - 1 : 0);
+    return pool;
+}
+
+ThreadPool::ThreadPool(uint32_t workerCount)
+    : m_frameJobs(0),
+    m_stop(false)
+{
+    for (uint32_t i = 0; i < workerCount; i++)
+        m_workers.emplace_back(&ThreadPool::WorkerLoop, this, i + 1);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+    for (auto& worker : m_workers)
+        worker.join();
+}
+
+void ThreadPool::SetThreadPriority(Priority priority)
+{
+    t_priority = priority;
+}
+
+void ThreadPool::ParallelFor(uint32_t count, const Task& task)
+{
+    if (count == 0)
+        return;
+
+    if (m_workers.empty() || count == 1 || t_insideTask)
+    {
+        for (uint32_t i = 0; i < count; i++)
+            task(i, t_threadIndex);
+        return;
+    }
+
+    Job job;
+    job.pTask = &task;
+    job.count = count;
+    job.priority = t_priority;
+    job.nextIndex.store(0, std::memory_order_relaxed);
+    job.completed = 0;
+    job.activeWorkers = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queues[static_cast<uint32_t>(job.priority)].push_back(&job);
+        if (job.priority == Priority::Frame)
+            m_frameJobs++;
+    }
+    m_wake.notify_all();
+
+    // The caller never yields its own job, whatever its priority
+    t_insideTask = true;
+    uint32_t completed = RunTasks(job, t_threadIndex, false);
+    t_insideTask = false;
+
+    // Once the job is off the queue no worker can pick it up again; the ones still holding
+    // it check out under the lock, after which the job on this stack can go away
+    std::unique_lock<std::mutex> lock(m_mutex);
+    RemoveJob(&job);
+    job.completed += completed;
+    m_done.wait(lock, [&job]() { return job.completed == job.count && job.activeWorkers == 0; });
+}
+
+void ThreadPool::WorkerLoop(uint32_t threadIndex)
+{
+    t_insideTask = true;
+    t_threadIndex = threadIndex;
+    Profiler::Get().SetThreadName(("Worker " + std::to_string(threadIndex)).c_str());
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;)
+    {
+        Job* pJob = nullptr;
+        m_wake.wait(lock, [&]() { return m_stop || (pJob = FindJob()) != nullptr; });
+        if (m_stop)
+            return;
+
+        pJob->activeWorkers++;
+        lock.unlock();
+        uint32_t completed = RunTasks(*pJob, threadIndex, pJob->priority != Priority::Frame);
+        lock.lock();
+
+        pJob->completed += completed;
+        pJob->activeWorkers--;
+        if (pJob->nextIndex.load(std::memory_order_relaxed) >= pJob->count)
+            RemoveJob(pJob);
+        if (pJob->completed == pJob->count && pJob->activeWorkers == 0)
+            m_done.notify_all();
+    }
+}
+
+ThreadPool::Job* ThreadPool::FindJob()
+{
+    for (auto& queue : m_queues)
+    {
+        while (!queue.empty())
+        {
+            Job* pJob = queue.front();
+            if (pJob->nextIndex.load(std::memory_order_relaxed) < pJob->count)
+                return pJob;
+            RemoveJob(pJob);
+        }
+    }
+    return nullptr;
+}
+
+void ThreadPool::RemoveJob(Job* pJob)
+{
+    auto& queue = m_queues[static_cast<uint32_t>(pJob->priority)];
+    auto it = std::find(queue.begin(), queue.end(), pJob);
+    if (it == queue.end())
+        return;
+    queue.erase(it);
+    if (pJob->priority == Priority::Frame)
+        m_frameJobs--;
+}
+
+uint32_t ThreadPool::RunTasks(Job& job, uint32_t threadIndex, bool yieldToFrame)
+{
+    uint32_t completed = 0;
+    for (;;)
+    {
+        // A background index in flight is the longest a frame job waits for a worker
+        if (yieldToFrame && m_frameJobs.load(std::memory_order_relaxed) > 0)
+            break;
+        uint32_t index = job.nextIndex.fetch_add(1, std::memory_order_relaxed);
+        if (index >= job.count)
+            break;
+        (*job.pTask)(index, threadIndex);
+        completed++;
+    }
+    return completed;
+}
@@ -0,0 +1,74 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Shared worker threads for CPU-side frame work. ParallelFor hands out indices
+// dynamically, so uneven work items (screen tiles, BVH nodes) balance across workers.
+// The calling thread takes part in the work and the call returns once every index ran.
+// Several threads can be inside ParallelFor at once: each call is its own job, and
+// workers take indices from frame jobs before background ones.
+class ThreadPool
+{
+public:
+    typedef std::function<void(uint32_t index, uint32_t threadIndex)> Task;
+
+    enum class Priority : uint32_t
+    {
+        Frame,          // default: work the current frame waits for
+        Background,     // bakers: workers only run it when no frame job has indices left
+        Count
+    };
+
+    static ThreadPool& Get();
+
+    explicit ThreadPool(uint32_t workerCount);
+    ~ThreadPool();
+
+    // Workers plus the calling thread; threadIndex passed to tasks is below this value.
+    // Threads outside the pool all pass 0, so per-thread scratch is only unique per call.
+    uint32_t GetThreadCount() const { return static_cast<uint32_t>(m_workers.size()) + 1; }
+
+    // Priority of the ParallelFor calls made from the current thread afterwards
+    static void SetThreadPriority(Priority priority);
+
+    // Nested calls from inside a task run serially on the current thread
+    void ParallelFor(uint32_t count, const Task& task);
+
+private:
+    struct Job
+    {
+        const Task* pTask;
+        uint32_t count;
+        Priority priority;
+        std::atomic<uint32_t> nextIndex;
+        uint32_t completed;     // indices finished, under m_mutex
+        uint32_t activeWorkers; // workers holding the job, under m_mutex
+    };
+
+    void WorkerLoop(uint32_t threadIndex);
+    // First job in priority order with indices left; drops exhausted jobs. Under m_mutex.
+    Job* FindJob();
+    void RemoveJob(Job* pJob);
+    // Runs indices of the job until it is exhausted or, for background jobs, until a
+    // frame job is queued. Returns the number of indices it ran.
+    uint32_t RunTasks(Job& job, uint32_t threadIndex, bool yieldToFrame);
+
+    std::vector<std::thread> m_workers;
+
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+    std::deque<Job*> m_queues[static_cast<uint32_t>(Priority::Count)];
+    std::atomic<uint32_t> m_frameJobs;  // m_queues[Frame].size(), read without the lock
+    bool m_stop;
+};
+
+#endif
@@ -0,0 +1,212 @@
+#include "Test.h"
+#include "BlockDecoder.h"
+#include "DdsTestFiles.h"
+#include "TextureCooker.h"
+#include "TexturePacker.h"
+#include "ThreadPool.h"
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+using namespace DirectX::DDSLayout;
+
+namespace
+{
+    uint32_t Texel(const DecodedTexture& texture, size_t index)
+    {
+        uint32_t texel;
+        std::memcpy(&texel, texture.data.data() + index * 4, 4);
+        return texel;
+    }
+
+    const float* FloatTexel(const DecodedTexture& texture, size_t index)
+    {
+        return reinterpret_cast<const float*>(texture.data.data() + index * 16);
+    }
+
+    // One texel of a 4x4 single mip file, the rest of the file as BuildDds leaves it
+    std::vector<uint8_t> SingleTexelDds(DXGI_FORMAT format, uint32_t texel)
+    {
+        std::vector<uint8_t> file = BuildDds(DdsDesc(4, 4, 1, 1, format), 0);
+        std::memcpy(file.data() + DDS_DX10_HEADER_SIZE, &texel, sizeof(texel));
+        return file;
+    }
+
+    // size x size RGBA noise cooked into one mip of format
+    std::vector<uint8_t> CookedDds(BlockFormat format, uint32_t size, uint32_t seed)
+    {
+        CookImage image = { size, size, std::vector<uint32_t>(static_cast<size_t>(size) * size) };
+        for (uint32_t& texel : image.texels)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            texel = seed;
+        }
+        TextureCooker cooker;
+        TextureCookSettings settings = { format, 1, false, false, MipFilter::Box, false };
+        std::vector<std::vector<CookImage>> slices(1, std::vector<CookImage>(1, image));
+        std::vector<uint8_t> data;
+        std::vector<uint8_t> file;
+        if (!cooker.Compress(slices, false, settings, data) || !TextureCooker::BuildFile(format, size, size, 1, 1, false, data, file))
+            file.clear();
+        return file;
+    }
+
+    bool ChannelsDiffer(uint32_t a, uint32_t b)
+    {
+        for (uint32_t shift = 0; shift < 32; shift += 8)
+        {
+            int difference = static_cast<int>((a >> shift) & 0xFF) - static_cast<int>((b >> shift) & 0xFF);
+            if (difference > 1 || difference < -1)
+                return true;
+        }
+        return false;
+    }
+}
+
+TEST_CASE(BlockDecoder, TexelFormatsDecodeToRgba8)
+{
+    BlockDecoder decoder;
+    DecodedTexture texture;
+    std::vector<uint8_t> rgba = BuildDds(DdsDesc(8, 4, 1), 9);
+    CHECK(decoder.Decode(rgba.data(), rgba.size(), DecodeTarget::RGBA8, texture));
+    CHECK(texture.sourceFormat == DXGI_FORMAT_R8G8B8A8_UNORM);
+    CHECK(texture.subresources.size() == 1);
+    CHECK(texture.data.size() == 8 * 4 * 4);
+    CHECK(std::memcmp(texture.data.data(), rgba.data() + DDS_DX10_HEADER_SIZE, texture.data.size()) == 0);
+
+    // Blue and red swap places, a missing alpha reads as 1
+    std::vector<uint8_t> bgra = SingleTexelDds(DXGI_FORMAT_B8G8R8A8_UNORM, 0x80102030u);
+    CHECK(decoder.Decode(bgra.data(), bgra.size(), DecodeTarget::RGBA8, texture));
+    CHECK(Texel(texture, 0) == 0x80302010u);
+    std::vector<uint8_t> bgrx = SingleTexelDds(DXGI_FORMAT_B8G8R8X8_UNORM, 0x00102030u);
+    CHECK(decoder.Decode(bgrx.data(), bgrx.size(), DecodeTarget::RGBA8, texture));
+    CHECK(Texel(texture, 0) == 0xFF302010u);
+}
+
+TEST_CASE(BlockDecoder, FloatTargetDecodesSrgbAndSnorm)
+{
+    BlockDecoder decoder;
+    DecodedTexture texture;
+
+    // sRGB colour goes to linear light, alpha stays linear
+    std::vector<uint8_t> srgb = SingleTexelDds(DXGI_FORMAT_R8G8B8A8_UNORM_SRGB, 0x80FF00BCu);
+    CHECK(decoder.Decode(srgb.data(), srgb.size(), DecodeTarget::RGBA32F, texture));
+    const float* pSrgb = FloatTexel(texture, 0);
+    CHECK(std::fabs(pSrgb[0] - 0.5029f) < 1e-3f);
+    CHECK(pSrgb[1] == 0.0f && pSrgb[2] == 1.0f);
+    CHECK(std::fabs(pSrgb[3] - 128.0f / 255.0f) < 1e-6f);
+
+    // SNORM keeps its sign; -128 clamps to -1 like -127
+    std::vector<uint8_t> snorm = SingleTexelDds(DXGI_FORMAT_R8G8B8A8_SNORM, 0x0080817Fu);
+    CHECK(decoder.Decode(snorm.data(), snorm.size(), DecodeTarget::RGBA32F, texture));
+    const float* pSnorm = FloatTexel(texture, 0);
+    CHECK(pSnorm[0] == 1.0f && pSnorm[1] == -1.0f && pSnorm[2] == -1.0f && pSnorm[3] == 0.0f);
+
+    // Into RGBA8 SNORM is biased to 0..1 like a UNORM normal map
+    CHECK(decoder.Decode(snorm.data(), snorm.size(), DecodeTarget::RGBA8, texture));
+    CHECK(Texel(texture, 0) == 0x800000FFu);
+}
+
+// BC1, BC3 and BC7 from TextureCooker decode like its reference decoder, within the one step
+// the two may round their palettes apart
+TEST_CASE(BlockDecoder, CookedBlocksMatchTheReference)
+{
+    const BlockFormat formats[] = { BlockFormat::BC1, BlockFormat::BC3, BlockFormat::BC7 };
+    for (BlockFormat format : formats)
+    {
+        std::vector<uint8_t> file = CookedDds(format, 32, 17);
+        CHECK(!file.empty());
+        BlockDecoder decoder;
+        DecodedTexture texture;
+        CHECK(decoder.Decode(file.data(), file.size(), DecodeTarget::RGBA8, texture));
+        CHECK(texture.sourceFormat == static_cast<DXGI_FORMAT>(TextureCooker::GetDxgiFormat(format)));
+        if (texture.data.size() != 32 * 32 * 4)
+            continue;
+
+        uint32_t blockBytes = TextureCooker::GetBlockBytes(format);
+        uint32_t mismatches = 0;
+        for (uint32_t block = 0; block < 8 * 8; block++)
+        {
+            uint32_t texels[16];
+            CHECK(TextureCooker::DecompressBlock(format, file.data() + DDS_DX10_HEADER_SIZE + block * blockBytes, texels));
+            for (uint32_t t = 0; t < 16; t++)
+            {
+                size_t index = static_cast<size_t>((block / 8) * 4 + t / 4) * 32 + (block % 8) * 4 + t % 4;
+                mismatches += ChannelsDiffer(Texel(texture, index), texels[t]) ? 1 : 0;
+            }
+        }
+        CHECK(mismatches == 0);
+    }
+}
+
+TEST_CASE(BlockDecoder, PackedFilesDecodeLikeTheirSource)
+{
+    std::vector<uint8_t> file = CookedDds(BlockFormat::BC7, 64, 23);
+    TexturePacker packer;
+    std::vector<uint8_t> packed;
+    CHECK(packer.Pack(file.data(), file.size(), TexturePacker::GetDefaultSettings(), packed));
+
+    BlockDecoder decoder;
+    DecodedTexture source;
+    DecodedTexture unpacked;
+    CHECK(decoder.Decode(file.data(), file.size(), DecodeTarget::RGBA8, source));
+    CHECK(decoder.Decode(packed.data(), packed.size(), DecodeTarget::RGBA8, unpacked));
+    CHECK(unpacked.data == source.data);
+
+    packed.pop_back();
+    CHECK(!decoder.Decode(packed.data(), packed.size(), DecodeTarget::RGBA8, unpacked));
+}
+
+TEST_CASE(BlockDecoder, CubesKeepTheSubresourceOrder)
+{
+    std::vector<uint8_t> file = BuildDds(DdsDesc(8, 8, 4, 1, DXGI_FORMAT_R8G8B8A8_UNORM, true), 4);
+    ThreadPool pool(3);
+    BlockDecoder decoder;
+    decoder.SetThreadPool(&pool);
+    DecodedTexture texture;
+    CHECK(decoder.Decode(file.data(), file.size(), DecodeTarget::RGBA8, texture));
+    CHECK(texture.isCubeMap);
+    CHECK(texture.arraySize == 6);
+    CHECK(texture.subresources.size() == 24);
+    CHECK(texture.subresources[5].width == 4 && texture.subresources[7].width == 1);
+
+    // Every face holds 85 texels, one mip after another, like the file
+    CHECK(texture.data.size() == file.size() - DDS_DX10_HEADER_SIZE);
+    CHECK(texture.subresources[4].offset == 85 * 4);
+    CHECK(std::memcmp(texture.data.data(), file.data() + DDS_DX10_HEADER_SIZE, texture.data.size()) == 0);
+}
+
+TEST_CASE(BlockDecoder, BrokenFilesAreRejected)
+{
+    BlockDecoder decoder;
+    DecodedTexture texture;
+    std::vector<uint8_t> file = BuildDds(DdsDesc(16, 16, 5, 1, DXGI_FORMAT_BC1_UNORM), 0);
+    CHECK(decoder.Decode(file.data(), file.size(), DecodeTarget::RGBA8, texture));
+    file.pop_back();
+    CHECK(!decoder.Decode(file.data(), file.size(), DecodeTarget::RGBA8, texture));
+    file.assign(256, 0);
+    CHECK(!decoder.Decode(file.data(), file.size(), DecodeTarget::RGBA8, texture));
+
+    // Integer formats have no colour to decode to
+    CHECK(!BlockDecoder::IsSupported(DXGI_FORMAT_R32G32B32A32_UINT));
+    file = BuildDds(DdsDesc(4, 4, 1, 1, DXGI_FORMAT_R32G32B32A32_UINT), 0);
+    CHECK(!decoder.Decode(file.data(), file.size(), DecodeTarget::RGBA8, texture));
+    CHECK(BlockDecoder::IsSupported(DXGI_FORMAT_BC6H_SF16));
+}
+
+// Random blocks of every format, the pool against the calling thread, and BC6H blocks with
+// known endpoints
+TEST_CASE(BlockDecoder, BenchmarkFindsNoErrors)
+{
+    ThreadPool pool(3);
+    BlockDecodeBenchmarkResult result = BlockDecoder::Benchmark(&pool, std::vector<std::string>(), 32, 1);
+    CHECK(!result.formats.empty());
+    uint32_t mismatches = 0;
+    for (const BlockDecodeFormatResult& format : result.formats)
+        mismatches += format.mismatches;
+    CHECK(mismatches == 0);
+    CHECK(result.referenceTexels > 0);
+    CHECK(result.referenceErrors == 0);
+    CHECK(result.hdrChecks > 0);
+    CHECK(result.hdrErrors == 0);
+}
@@ -0,0 +1,211 @@
+#include "Test.h"
+#include "CascadedShadows.h"
+#include <cmath>
+#include <vector>
+
+namespace
+{
+    const float NearZ = 0.1f;
+    const float FarZ = 100.0f;
+    const XMFLOAT3 Down = { 0.0f, -1.0f, 0.0f };
+
+    // XMMatrixPerspectiveFovLH(0.8, 16:9, NearZ, FarZ)
+    XMFLOAT4X4 Projection()
+    {
+        float scale = 1.0f / std::tan(0.4f);
+        XMFLOAT4X4 m = {};
+        m._11 = scale * 9.0f / 16.0f;
+        m._22 = scale;
+        m._33 = FarZ / (FarZ - NearZ);
+        m._34 = 1.0f;
+        m._43 = -NearZ * FarZ / (FarZ - NearZ);
+        return m;
+    }
+
+    // Camera at eye turned by yaw around y, row-vector like XMMatrixLookToLH
+    XMFLOAT4X4 View(float eyeX, float eyeZ, float yaw)
+    {
+        float c = std::cos(yaw);
+        float s = std::sin(yaw);
+        XMFLOAT4X4 m = {};
+        m._11 = c; m._13 = s;
+        m._22 = 1.0f;
+        m._31 = -s; m._33 = c;
+        m._41 = -(eyeX * c - eyeZ * s);
+        m._43 = -(eyeX * s + eyeZ * c);
+        m._44 = 1.0f;
+        return m;
+    }
+
+    CascadeSettings Settings(uint32_t count)
+    {
+        CascadeSettings settings = { count, 0.75f, 60.0f, 2048 };
+        return settings;
+    }
+
+    ShadowCaster Caster(float x, float y, float z, float radius)
+    {
+        ShadowCaster caster = {};
+        caster.center = XMFLOAT3(x, y, z);
+        caster.radius = radius;
+        return caster;
+    }
+
+    bool Contains(const CascadedShadows& cascades, uint32_t cascade, uint32_t caster)
+    {
+        const ShadowCascade& c = cascades.GetCascade(cascade);
+        for (uint32_t i = 0; i < c.casterCount; i++)
+        {
+            if (cascades.GetCasters()[c.firstCaster + i] == caster)
+                return true;
+        }
+        return false;
+    }
+
+    bool Near(float a, float b, float tolerance)
+    {
+        return std::fabs(a - b) <= tolerance;
+    }
+}
+
+TEST_CASE(CascadedShadows, UniformAndLogarithmicSplits)
+{
+    float splits[4];
+    CascadedShadows::ComputeSplits(1.0f, 101.0f, 4, 0.0f, splits);
+    CHECK(Near(splits[0], 26.0f, 1e-4f) && Near(splits[1], 51.0f, 1e-4f) && Near(splits[2], 76.0f, 1e-4f));
+    CHECK(splits[3] == 101.0f);
+
+    CascadedShadows::ComputeSplits(1.0f, 10000.0f, 4, 1.0f, splits);
+    CHECK(Near(splits[0], 10.0f, 1e-3f) && Near(splits[1], 100.0f, 1e-2f) && Near(splits[2], 1000.0f, 0.1f));
+    CHECK(splits[3] == 10000.0f);
+
+    // The blend lies between the two schemes
+    float blended[4];
+    CascadedShadows::ComputeSplits(1.0f, 10000.0f, 4, 0.5f, blended);
+    CHECK(blended[0] > 10.0f && blended[0] < 2500.75f);
+}
+
+TEST_CASE(CascadedShadows, SlicesCoverTheShadowDistanceWithoutGaps)
+{
+    CascadedShadows cascades;
+    cascades.SetSettings(Settings(9));
+    cascades.Update(View(0.0f, 0.0f, 0.0f), Projection(), Down, nullptr, 0);
+
+    CHECK(cascades.GetCascadeCount() == CascadedShadows::MaxCascades);
+    CHECK(Near(cascades.GetCascade(0).splitNear, NearZ, 1e-4f));
+    for (uint32_t i = 1; i < cascades.GetCascadeCount(); i++)
+        CHECK(cascades.GetCascade(i).splitNear == cascades.GetCascade(i - 1).splitFar);
+    CHECK(Near(cascades.GetCascade(cascades.GetCascadeCount() - 1).splitFar, 60.0f, 1e-3f));
+
+    cascades.SetSettings(Settings(0));
+    cascades.Update(View(0.0f, 0.0f, 0.0f), Projection(), Down, nullptr, 0);
+    CHECK(cascades.GetCascadeCount() == 1);
+
+    // Past the camera far plane the last cascade stops at the far plane
+    CascadeSettings far = Settings(2);
+    far.shadowDistance = 500.0f;
+    cascades.SetSettings(far);
+    cascades.Update(View(0.0f, 0.0f, 0.0f), Projection(), Down, nullptr, 0);
+    CHECK(Near(cascades.GetCascade(1).splitFar, FarZ, 0.05f));
+}
+
+TEST_CASE(CascadedShadows, SphereHoldsEveryCornerOfItsSlice)
+{
+    CascadedShadows cascades;
+    cascades.SetSettings(Settings(4));
+    XMFLOAT4X4 proj = Projection();
+    cascades.Update(View(0.0f, 0.0f, 0.0f), proj, Down, nullptr, 0);
+
+    uint32_t outside = 0;
+    for (uint32_t i = 0; i < cascades.GetCascadeCount(); i++)
+    {
+        const ShadowCascade& cascade = cascades.GetCascade(i);
+        const float depths[2] = { cascade.splitNear, cascade.splitFar };
+        for (float depth : depths)
+        {
+            for (int corner = 0; corner < 4; corner++)
+            {
+                float x = (corner & 1 ? 1.0f : -1.0f) * depth / proj._11;
+                float y = (corner & 2 ? 1.0f : -1.0f) * depth / proj._22;
+                float dx = x - cascade.center.x;
+                float dy = y - cascade.center.y;
+                float dz = depth - cascade.center.z;
+                if (std::sqrt(dx * dx + dy * dy + dz * dz) > cascade.radius * 1.0001f)
+                    outside++;
+            }
+        }
+    }
+    CHECK(outside == 0);
+}
+
+TEST_CASE(CascadedShadows, CascadesDoNotCrawlWhenTheCameraMoves)
+{
+    CascadedShadows cascades;
+    cascades.SetSettings(Settings(4));
+    cascades.Update(View(0.0f, 0.0f, 0.0f), Projection(), Down, nullptr, 0);
+    float radius[CascadedShadows::MaxCascades];
+    for (uint32_t i = 0; i < cascades.GetCascadeCount(); i++)
+        radius[i] = cascades.GetCascade(i).radius;
+
+    // Turning and sliding keep the texel size; the centre stays on whole texels
+    uint32_t changedRadius = 0;
+    uint32_t offGrid = 0;
+    for (int step = 1; step <= 20; step++)
+    {
+        cascades.Update(View(step * 0.137f, step * -0.291f, step * 0.05f), Projection(), Down, nullptr, 0);
+        for (uint32_t i = 0; i < cascades.GetCascadeCount(); i++)
+        {
+            const ShadowCascade& cascade = cascades.GetCascade(i);
+            changedRadius += cascade.radius != radius[i] ? 1 : 0;
+            float texel = 2.0f * cascade.radius / 2048.0f;
+            float x = cascade.lightCenter.x / texel;
+            float y = cascade.lightCenter.y / texel;
+            if (!Near(x, std::round(x), 1e-2f) || !Near(y, std::round(y), 1e-2f))
+                offGrid++;
+        }
+    }
+    CHECK(changedRadius == 0);
+    CHECK(offGrid == 0);
+}
+
+TEST_CASE(CascadedShadows, CastersAreCulledSidewaysAndBeyondTheFarSide)
+{
+    CascadedShadows cascades;
+    cascades.SetSettings(Settings(4));
+    XMFLOAT4X4 view = View(0.0f, 0.0f, 0.0f);
+    cascades.Update(view, Projection(), Down, nullptr, 0);
+    const XMFLOAT3 center = cascades.GetCascade(0).center;
+
+    std::vector<ShadowCaster> casters;
+    casters.push_back(Caster(center.x, center.y, center.z, 0.5f));           // inside the first slice
+    casters.push_back(Caster(center.x, center.y + 50.0f, center.z, 0.5f));   // between the slice and the sun
+    casters.push_back(Caster(center.x, center.y - 50.0f, center.z, 0.5f));   // below it, away from the sun
+    casters.push_back(Caster(center.x + 500.0f, center.y, center.z, 0.5f));  // far to the side
+    cascades.Update(view, Projection(), Down, casters.data(), static_cast<uint32_t>(casters.size()));
+
+    CHECK(Contains(cascades, 0, 0));
+    CHECK(Contains(cascades, 0, 1));
+    CHECK(!Contains(cascades, 0, 2));
+    uint32_t sideways = 0;
+    for (uint32_t i = 0; i < cascades.GetCascadeCount(); i++)
+        sideways += Contains(cascades, i, 3) ? 1 : 0;
+    CHECK(sideways == 0);
+
+    // The near plane is pulled back to the caster above the slice: its top still lands in [0, 1]
+    const ShadowCascade& first = cascades.GetCascade(0);
+    CHECK(Near(first.depthNear, -(center.y + 50.0f) - 0.5f, 1e-3f));
+    const XMFLOAT4X4& m = first.viewProj;
+    float top = (center.y + 50.5f) * m._23 + center.x * m._13 + center.z * m._33 + m._43;
+    CHECK(Near(top, 0.0f, 1e-4f));
+    float bottom = (center.y - first.radius) * m._23 + center.x * m._13 + center.z * m._33 + m._43;
+    CHECK(bottom <= 1.0001f);
+    CHECK(cascades.GetStats().casters == 4);
+    CHECK(cascades.GetStats().casterReferences == cascades.GetCasters().size());
+}
+
+TEST_CASE(CascadedShadows, SimdCullingMatchesScalar)
+{
+    CascadeBenchmarkResult result = CascadedShadows::Benchmark(2003, 4);
+    CHECK(result.references > 0);
+    CHECK(result.mismatches == 0);
+}
@@ -0,0 +1,169 @@
+#include "Test.h"
+#include "DdsTestFiles.h"
+#include <string>
+#include <vector>
+
+using namespace DirectX::DDSLayout;
+
+namespace
+{
+    // 64x64 RGBA with 7 mips: every slice is 21844 bytes
+    const uint32_t SliceBytes = 21844;
+
+    DDSFileView View(const std::vector<uint8_t>& file)
+    {
+        DDSFileView view = { file.data(), file.size() };
+        return view;
+    }
+
+    HRESULT Layout(const std::vector<std::vector<uint8_t>>& files, size_t maxsize, size_t maxArraySize, DDSArrayLayout& layout)
+    {
+        std::vector<DDSFileView> views;
+        for (const std::vector<uint8_t>& file : files)
+            views.push_back(View(file));
+        return GetArrayLayout(views.data(), views.size(), maxsize, maxArraySize, layout);
+    }
+
+    // Two good files and then the one to check
+    bool FailsAsThirdFile(const DdsTestDesc& desc)
+    {
+        std::vector<std::vector<uint8_t>> files;
+        files.push_back(BuildDds(DdsDesc(64, 64, 7), 0));
+        files.push_back(BuildDds(DdsDesc(64, 64, 7), 1));
+        files.push_back(BuildDds(desc, 2));
+        DDSArrayLayout layout;
+        return FAILED(Layout(files, 0, DDS_MAX_TEXTURE2D_ARRAY_SIZE, layout)) && layout.failedFile == 2;
+    }
+}
+
+TEST_CASE(DDSLayout, MatchingFilesBecomeOneArray)
+{
+    std::vector<std::vector<uint8_t>> files;
+    files.push_back(BuildDds(DdsDesc(64, 64, 7, 2), 0));
+    files.push_back(BuildDds(DdsDesc(64, 64, 7), 1));
+
+    DDSArrayLayout layout;
+    CHECK(SUCCEEDED(Layout(files, 0, DDS_MAX_TEXTURE2D_ARRAY_SIZE, layout)));
+    CHECK(layout.layout.width == 64 && layout.layout.height == 64);
+    CHECK(layout.layout.mipCount == 7);
+    CHECK(layout.layout.arraySize == 3);
+    CHECK(layout.layout.format == DXGI_FORMAT_R8G8B8A8_UNORM);
+    CHECK(!layout.layout.isCubeMap);
+    CHECK(layout.skipMip == 0);
+    CHECK(layout.initData.size() == 21);
+
+    // Nothing is copied: every subresource points into its own file, slice after slice
+    uint32_t wrong = 0;
+    for (uint32_t slice = 0; slice < 3; slice++)
+    {
+        const uint8_t* pFile = files[slice < 2 ? 0 : 1].data();
+        size_t offset = DDS_DX10_HEADER_SIZE + (slice < 2 ? slice : 0) * SliceBytes;
+        for (uint32_t mip = 0; mip < 7; mip++)
+        {
+            const DDSSubresourceData& data = layout.initData[slice * 7 + mip];
+            uint32_t size = std::max(64u >> mip, 1u);
+            if (data.pSysMem != pFile + offset || data.SysMemPitch != size * 4 || data.SysMemSlicePitch != size * size * 4)
+                wrong++;
+            offset += size * size * 4;
+        }
+    }
+    CHECK(wrong == 0);
+}
+
+TEST_CASE(DDSLayout, CubeFilesCountSixSlicesEach)
+{
+    std::vector<std::vector<uint8_t>> files;
+    files.push_back(BuildDds(DdsDesc(64, 64, 7, 1, DXGI_FORMAT_R8G8B8A8_UNORM, true), 0));
+    files.push_back(BuildDds(DdsDesc(64, 64, 7, 1, DXGI_FORMAT_R8G8B8A8_UNORM, true), 1));
+
+    DDSArrayLayout layout;
+    CHECK(SUCCEEDED(Layout(files, 0, DDS_MAX_TEXTURE2D_ARRAY_SIZE, layout)));
+    CHECK(layout.layout.isCubeMap);
+    CHECK(layout.layout.arraySize == 12);
+    CHECK(layout.initData.size() == 84);
+    CHECK(layout.initData[6 * 7].pSysMem == files[1].data() + DDS_DX10_HEADER_SIZE);
+}
+
+TEST_CASE(DDSLayout, MismatchedFileIsReported)
+{
+    CHECK(FailsAsThirdFile(DdsDesc(64, 32, 7)));
+    CHECK(FailsAsThirdFile(DdsDesc(32, 64, 7)));
+    CHECK(FailsAsThirdFile(DdsDesc(64, 64, 6)));
+    CHECK(FailsAsThirdFile(DdsDesc(64, 64, 7, 1, DXGI_FORMAT_R16G16B16A16_FLOAT)));
+    CHECK(FailsAsThirdFile(DdsDesc(64, 64, 7, 1, DXGI_FORMAT_R8G8B8A8_UNORM, true)));
+    // The slice count of a file is not part of the match
+    CHECK(!FailsAsThirdFile(DdsDesc(64, 64, 7, 4)));
+}
+
+TEST_CASE(DDSLayout, BrokenFilesFail)
+{
+    std::vector<std::vector<uint8_t>> files;
+    files.push_back(BuildDds(DdsDesc(64, 64, 7), 0));
+    files.push_back(BuildDds(DdsDesc(64, 64, 7), 1));
+    files[1].pop_back();
+
+    DDSArrayLayout layout;
+    CHECK(FAILED(Layout(files, 0, DDS_MAX_TEXTURE2D_ARRAY_SIZE, layout)));
+    CHECK(layout.failedFile == 1);
+
+    // Shorter than the headers, then not a DDS file at all
+    files[1].resize(DDS_MIN_HEADER_SIZE - 1);
+    CHECK(FAILED(Layout(files, 0, DDS_MAX_TEXTURE2D_ARRAY_SIZE, layout)));
+    CHECK(layout.failedFile == 1);
+    files[1] = BuildDds(DdsDesc(64, 64, 7), 1);
+    files[1][0] = 'X';
+    CHECK(FAILED(Layout(files, 0, DDS_MAX_TEXTURE2D_ARRAY_SIZE, layout)));
+    CHECK(layout.failedFile == 1);
+
+    CHECK(Layout(std::vector<std::vector<uint8_t>>(), 0, DDS_MAX_TEXTURE2D_ARRAY_SIZE, layout) == E_INVALIDARG);
+}
+
+TEST_CASE(DDSLayout, SlicesAreLimitedByMaxArraySize)
+{
+    std::vector<std::vector<uint8_t>> files;
+    files.push_back(BuildDds(DdsDesc(64, 64, 7, 2), 0));
+    files.push_back(BuildDds(DdsDesc(64, 64, 7, 2), 1));
+
+    DDSArrayLayout layout;
+    CHECK(FAILED(Layout(files, 0, 3, layout)));
+    CHECK(layout.failedFile == 1);
+    CHECK(SUCCEEDED(Layout(files, 0, 4, layout)));
+    CHECK(layout.layout.arraySize == 4);
+}
+
+// maxsize 16 leaves out mips 0 and 1 of every file, the slices still follow each other
+TEST_CASE(DDSLayout, MaxsizeSkipsTheSameMipsInEveryFile)
+{
+    std::vector<std::vector<uint8_t>> files;
+    files.push_back(BuildDds(DdsDesc(64, 64, 7), 0));
+    files.push_back(BuildDds(DdsDesc(64, 64, 7), 1));
+
+    DDSArrayLayout layout;
+    CHECK(SUCCEEDED(Layout(files, 16, DDS_MAX_TEXTURE2D_ARRAY_SIZE, layout)));
+    CHECK(layout.skipMip == 2);
+    CHECK(layout.layout.width == 16 && layout.layout.height == 16);
+    CHECK(layout.layout.mipCount == 5);
+    CHECK(layout.initData.size() == 10);
+    size_t mip2 = DDS_DX10_HEADER_SIZE + 64 * 64 * 4 + 32 * 32 * 4;
+    CHECK(layout.initData[0].pSysMem == files[0].data() + mip2);
+    CHECK(layout.initData[5].pSysMem == files[1].data() + mip2);
+    CHECK(layout.initData[5].SysMemPitch == 64);
+}
+
+TEST_CASE(DDSLayout, BenchmarkFindsNoErrors)
+{
+    DdsTestFile square("ddslayout_square.dds", DdsDesc(64, 64, 7), 0);
+    DdsTestFile array("ddslayout_array.dds", DdsDesc(64, 64, 7, 3), 1);
+    DdsTestFile wide("ddslayout_wide.dds", DdsDesc(128, 64, 8), 2);
+    DdsTestFile cube("ddslayout_cube.dds", DdsDesc(64, 64, 7, 1, DXGI_FORMAT_R8G8B8A8_UNORM, true), 3);
+    std::vector<std::string> paths = { square.GetPath(), array.GetPath(), wide.GetPath(), cube.GetPath() };
+
+    DDSArrayBenchmarkResult result = BenchmarkArrayLayout(paths, 16);
+    CHECK(result.files == 4);
+    CHECK(result.slices >= 16);
+    CHECK(result.pairs > 0);
+    CHECK(result.pairErrors == 0);
+    CHECK(result.layoutErrors == 0);
+    CHECK(result.checks > 0);
+    CHECK(result.checkErrors == 0);
+}
@@ -0,0 +1,99 @@
+#ifndef DDS_TEST_FILES_H
+#define DDS_TEST_FILES_H
+
+#include "DDSLayout.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Small DX10 DDS files built in memory and written to the working directory of the tests
+struct DdsTestDesc
+{
+    uint32_t width;
+    uint32_t height;
+    uint32_t mipCount;
+    uint32_t arraySize;     // cubes count six slices each
+    DXGI_FORMAT format;
+    bool isCubeMap;
+};
+
+inline DdsTestDesc DdsDesc(uint32_t width, uint32_t height, uint32_t mipCount, uint32_t arraySize = 1,
+    DXGI_FORMAT format = DXGI_FORMAT_R8G8B8A8_UNORM, bool isCubeMap = false)
+{
+    DdsTestDesc desc = { width, height, mipCount, arraySize, format, isCubeMap };
+    return desc;
+}
+
+// Headers and every subresource, byte i of the pixel data is seed + i
+inline std::vector<uint8_t> BuildDds(const DdsTestDesc& desc, uint8_t seed)
+{
+    using namespace DirectX::DDSLayout;
+
+    DDS_HEADER header = {};
+    header.size = sizeof(DDS_HEADER);
+    header.flags = 0x1 | DDS_HEIGHT | 0x4 | 0x1000 | 0x20000;   // caps, height, width, pixel format, mip count
+    header.height = desc.height;
+    header.width = desc.width;
+    header.mipMapCount = desc.mipCount;
+    header.ddspf.size = sizeof(DDS_PIXELFORMAT);
+    header.ddspf.flags = DDS_FOURCC;
+    header.ddspf.fourCC = MAKEFOURCC('D', 'X', '1', '0');
+    header.caps = 0x1000 | 0x400000 | 0x8;                      // texture, mipmap, complex
+    header.caps2 = desc.isCubeMap ? DDS_CUBEMAP_ALLFACES : 0;
+
+    DDS_HEADER_DXT10 extension = {};
+    extension.dxgiFormat = desc.format;
+    extension.resourceDimension = DDS_DIMENSION_TEXTURE2D;
+    extension.miscFlag = desc.isCubeMap ? DDS_RESOURCE_MISC_TEXTURECUBE : 0;
+    extension.arraySize = desc.arraySize;
+
+    std::vector<uint8_t> data(DDS_DX10_HEADER_SIZE);
+    std::memcpy(data.data(), &DDS_MAGIC, sizeof(uint32_t));
+    std::memcpy(data.data() + sizeof(uint32_t), &header, sizeof(header));
+    std::memcpy(data.data() + sizeof(uint32_t) + sizeof(header), &extension, sizeof(extension));
+
+    uint32_t slices = desc.arraySize * (desc.isCubeMap ? 6 : 1);
+    uint8_t value = seed;
+    for (uint32_t slice = 0; slice < slices; slice++)
+    {
+        for (uint32_t mip = 0; mip < desc.mipCount; mip++)
+        {
+            size_t bytes = 0;
+            GetSurfaceInfo(std::max(desc.width >> mip, 1u), std::max(desc.height >> mip, 1u), desc.format, &bytes, nullptr, nullptr);
+            for (size_t i = 0; i < bytes; i++)
+                data.push_back(value++);
+        }
+    }
+    return data;
+}
+
+// Removes its file again when the test is over
+class DdsTestFile
+{
+public:
+    DdsTestFile(const std::string& path, const std::vector<uint8_t>& data) : m_path(path)
+    {
+        FILE* file = std::fopen(path.c_str(), "wb");
+        m_written = file && std::fwrite(data.data(), 1, data.size(), file) == data.size();
+        if (file)
+            std::fclose(file);
+    }
+
+    DdsTestFile(const std::string& path, const DdsTestDesc& desc, uint8_t seed = 0) : DdsTestFile(path, BuildDds(desc, seed)) {}
+
+    ~DdsTestFile() { std::remove(m_path.c_str()); }
+
+    const std::string& GetPath() const { return m_path; }
+    bool IsWritten() const { return m_written; }
+
+private:
+    DdsTestFile(const DdsTestFile&) = delete;
+    DdsTestFile& operator=(const DdsTestFile&) = delete;
+
+    std::string m_path;
+    bool m_written;
+};
+
+#endif
@@ -0,0 +1,193 @@
+#include "Test.h"
+#include "DrawBatcher.h"
+#include "NullRenderBackend.h"
+
+namespace
+{
+    enum TestMesh : uint32_t { MeshCube, MeshQuad };
+    enum TestShader : uint32_t { ShaderMarker, ShaderParallelogram, ShaderGlass };
+    enum TestState : uint32_t { StateOpaque, StateTransparent };
+
+    // Backend objects the batches resolve to, registered the way RenderClass does at startup
+    struct TestScene
+    {
+        NullRenderBackend backend;
+        BackendHandle markerPipeline;
+        BackendHandle parallelogramPipeline;
+        BackendHandle cubeVB;
+        BackendHandle cubeIB;
+        BackendHandle quadVB;
+        BackendHandle quadIB;
+        BackendHandle instanceBuffer;
+
+        TestScene()
+        {
+            markerPipeline = backend.RegisterPipeline("Marker");
+            parallelogramPipeline = backend.RegisterPipeline("Parallelogram");
+            cubeVB = backend.CreateBuffer({ BufferKind::Vertex, 24 * 32, false }, nullptr);
+            cubeIB = backend.CreateBuffer({ BufferKind::Index, 36 * 2, false }, nullptr);
+            quadVB = backend.CreateBuffer({ BufferKind::Vertex, 4 * 16, false }, nullptr);
+            quadIB = backend.CreateBuffer({ BufferKind::Index, 6 * 2, false }, nullptr);
+            instanceBuffer = backend.CreateBuffer({ BufferKind::Constant,
+                static_cast<uint32_t>(sizeof(InstanceColorData) * 256), true }, nullptr);
+        }
+
+        uint32_t Submit(const DrawBatcher& batcher)
+        {
+            return batcher.Submit(backend, instanceBuffer, [this](const DrawKey& key) {
+                BatchBinding binding = {};
+                binding.pipeline = key.shader == ShaderMarker ? markerPipeline : parallelogramPipeline;
+                binding.vertexBuffer = key.mesh == MeshCube ? cubeVB : quadVB;
+                binding.vertexStride = key.mesh == MeshCube ? 32 : 16;
+                binding.indexBuffer = key.mesh == MeshCube ? cubeIB : quadIB;
+                binding.indexCount = key.mesh == MeshCube ? 36 : 6;
+                return binding;
+            });
+        }
+    };
+
+    DrawItem MakeItem(DrawKey key, bool transparent, float depth, float tag)
+    {
+        DrawItem item = {};
+        item.key = key;
+        item.transparent = transparent;
+        item.sortDepth = depth;
+        item.instance.color = XMFLOAT4(tag, 0.0f, 0.0f, 1.0f);
+        return item;
+    }
+
+    const DrawKey MarkerKey = { MeshCube, ShaderMarker, StateOpaque };
+    const DrawKey ParallelogramKey = { MeshQuad, ShaderParallelogram, StateTransparent };
+    const DrawKey GlassKey = { MeshQuad, ShaderGlass, StateTransparent };
+}
+
+// The Lab8 frame: three light markers and two parallelograms used to be five draws
+TEST_CASE(DrawBatcher, SceneEmitsOneDrawPerMaterial)
+{
+    TestScene scene;
+    DrawBatcher batcher;
+    for (int i = 0; i < 3; i++)
+        batcher.Add(MakeItem(MarkerKey, false, 0.0f, static_cast<float>(i)));
+    batcher.Add(MakeItem(ParallelogramKey, true, 4.0f, 10.0f));
+    batcher.Add(MakeItem(ParallelogramKey, true, 6.0f, 11.0f));
+    batcher.Build();
+
+    scene.backend.BeginFrame();
+    uint32_t draws = scene.Submit(batcher);
+    scene.backend.EndFrame();
+
+    CHECK(draws == 2);
+    CHECK(scene.backend.GetLastFrameStats().draws == 2);
+    CHECK(scene.backend.GetLastFrameStats().instances == 5);
+    CHECK(scene.backend.GetLastFrameStats().pipelineBinds == 2);
+    CHECK(scene.backend.GetLastFrameStats().uploads == 2);
+    CHECK(scene.backend.GetErrorCount() == 0);
+}
+
+TEST_CASE(DrawBatcher, OpaqueDrawsScaleWithKeysNotObjects)
+{
+    TestScene scene;
+    DrawBatcher batcher;
+    const DrawKey keys[3] = { MarkerKey, { MeshQuad, ShaderMarker, StateOpaque }, { MeshCube, ShaderParallelogram, StateOpaque } };
+    for (int i = 0; i < 300; i++)
+        batcher.Add(MakeItem(keys[(i * 7) % 3], false, 0.0f, static_cast<float>(i)));
+    batcher.Build();
+
+    scene.backend.BeginFrame();
+    uint32_t draws = scene.Submit(batcher);
+    scene.backend.EndFrame();
+
+    CHECK(draws == 3);
+    CHECK(scene.backend.GetLastFrameStats().draws == 3);
+    CHECK(scene.backend.GetLastFrameStats().instances == 300);
+    CHECK(scene.backend.GetErrorCount() == 0);
+    for (const DrawBatch& batch : batcher.GetBatches())
+        CHECK(batch.instanceCount == 100 && !batch.transparent);
+}
+
+TEST_CASE(DrawBatcher, TransparentItemsKeepBackToFrontOrder)
+{
+    TestScene scene;
+    DrawBatcher batcher;
+    // Depths 10..1: the two keys alternate in pairs, so only neighbours may merge
+    const DrawKey order[10] = { ParallelogramKey, ParallelogramKey, GlassKey, GlassKey, ParallelogramKey,
+        GlassKey, GlassKey, GlassKey, ParallelogramKey, ParallelogramKey };
+    for (int i = 9; i >= 0; i--)
+        batcher.Add(MakeItem(order[9 - i], true, static_cast<float>(i + 1), static_cast<float>(i + 1)));
+    batcher.Add(MakeItem(MarkerKey, false, 0.0f, 0.0f));
+    batcher.Build();
+
+    const std::vector<DrawBatch>& batches = batcher.GetBatches();
+    CHECK(batches.size() == 6);
+    CHECK(!batches[0].transparent && batches[0].instanceCount == 1);
+    const uint32_t expectedCounts[5] = { 2, 2, 1, 3, 2 };
+    for (size_t i = 1; i < batches.size() && i < 6; i++)
+    {
+        CHECK(batches[i].transparent);
+        CHECK(batches[i].instanceCount == expectedCounts[i - 1]);
+    }
+
+    // Instances of the transparent batches run from the farthest to the nearest
+    const std::vector<InstanceColorData>& instances = batcher.GetInstances();
+    CHECK(instances.size() == 11);
+    for (size_t i = 1; i + 1 < instances.size(); i++)
+        CHECK(instances[i].color.x > instances[i + 1].color.x);
+
+    scene.backend.BeginFrame();
+    CHECK(scene.Submit(batcher) == 6);
+    scene.backend.EndFrame();
+    CHECK(scene.backend.GetLastFrameStats().pipelineBinds == 6);
+    CHECK(scene.backend.GetErrorCount() == 0);
+}
+
+TEST_CASE(DrawBatcher, EqualDepthsKeepSubmissionOrder)
+{
+    DrawBatcher batcher;
+    for (int i = 0; i < 4; i++)
+        batcher.Add(MakeItem(i % 2 ? GlassKey : ParallelogramKey, true, 5.0f, static_cast<float>(i)));
+    batcher.Build();
+
+    const std::vector<InstanceColorData>& instances = batcher.GetInstances();
+    CHECK(instances.size() == 4);
+    for (size_t i = 0; i < instances.size(); i++)
+        CHECK(instances[i].color.x == static_cast<float>(i));
+    CHECK(batcher.GetBatches().size() == 4);
+}
+
+TEST_CASE(DrawBatcher, BatchesSplitAtInstanceLimit)
+{
+    TestScene scene;
+    DrawBatcher batcher;
+    batcher.SetMaxInstancesPerBatch(256);
+    for (int i = 0; i < 600; i++)
+        batcher.Add(MakeItem(MarkerKey, false, 0.0f, static_cast<float>(i)));
+    batcher.Build();
+
+    scene.backend.BeginFrame();
+    uint32_t draws = scene.Submit(batcher);
+    scene.backend.EndFrame();
+
+    // Same key throughout: three draws, but the pipeline is bound once
+    CHECK(draws == 3);
+    CHECK(batcher.GetBatches()[0].instanceCount == 256);
+    CHECK(batcher.GetBatches()[2].instanceCount == 88);
+    CHECK(scene.backend.GetLastFrameStats().pipelineBinds == 1);
+    CHECK(scene.backend.GetLastFrameStats().instances == 600);
+    CHECK(scene.backend.GetErrorCount() == 0);
+}
+
+TEST_CASE(DrawBatcher, ClearStartsAnEmptyFrame)
+{
+    TestScene scene;
+    DrawBatcher batcher;
+    batcher.Add(MakeItem(MarkerKey, false, 0.0f, 0.0f));
+    batcher.Build();
+    batcher.Clear();
+    batcher.Build();
+
+    scene.backend.BeginFrame();
+    CHECK(scene.Submit(batcher) == 0);
+    scene.backend.EndFrame();
+    CHECK(scene.backend.GetLastFrameStats().draws == 0);
+    CHECK(batcher.GetItemCount() == 0);
+}
@@ -0,0 +1,311 @@
+#include "Test.h"
+#include "FrameManager.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+    // GPU timeline replayed by the test: work signaled on a slot finishes `latency` ticks
+    // later. Polling the same unfinished slot again lets time pass, as it does while the
+    // CPU spins on it; a single non-blocking poll does not.
+    class ReplayFence : public FrameFence
+    {
+    public:
+        explicit ReplayFence(uint64_t latency)
+            : m_latency(latency),
+            m_now(0),
+            m_lastPolled(FrameManager::MaxFramesInFlight)
+        {
+            for (uint32_t i = 0; i < FrameManager::MaxFramesInFlight; i++)
+                m_doneAt[i] = 0;
+        }
+
+        void Tick()
+        {
+            m_now++;
+            m_lastPolled = FrameManager::MaxFramesInFlight;
+        }
+
+        void Signal(uint32_t slot) override { m_doneAt[slot] = m_now + m_latency; }
+
+        bool IsComplete(uint32_t slot) override
+        {
+            if (m_now >= m_doneAt[slot])
+            {
+                m_lastPolled = FrameManager::MaxFramesInFlight;
+                return true;
+            }
+            if (m_lastPolled == slot)
+                m_now++;
+            m_lastPolled = slot;
+            return false;
+        }
+
+    private:
+        uint64_t m_latency;
+        uint64_t m_now;
+        uint32_t m_lastPolled;
+        uint64_t m_doneAt[FrameManager::MaxFramesInFlight];
+    };
+
+    const uint32_t CubeCount = 23;  // MaxInst
+    const float CubeSpacing = 2.0f;
+    const float ViewRadius = 3.0f;
+
+    // Ids the culling dispatch writes for a camera looking at a row of cubes
+    std::vector<uint32_t> CullCubes(float cameraX)
+    {
+        std::vector<uint32_t> ids;
+        for (uint32_t i = 0; i < CubeCount; i++)
+        {
+            if (std::fabs(i * CubeSpacing - cameraX) <= ViewRadius)
+                ids.push_back(i);
+        }
+        return ids;
+    }
+
+    bool Contains(const std::vector<uint32_t>& ids, uint32_t id)
+    {
+        return std::find(ids.begin(), ids.end(), id) != ids.end();
+    }
+
+    // The cube pass of RenderClass::RenderCubes: the dispatch fills the GPU id buffer, the
+    // indirect draw reads it in the same frame, and the per-slot staging copy is only read
+    // back once the frame that wrote it has retired
+    struct CullingReplay
+    {
+        explicit CullingReplay(uint64_t latency)
+            : fence(latency)
+        {
+            frames.SetFence(&fence);
+            for (uint32_t i = 0; i < FrameManager::MaxFramesInFlight; i++)
+                readbackFrame[i] = 0;
+        }
+
+        struct Frame
+        {
+            std::vector<uint32_t> visible;
+            std::vector<uint32_t> drawn;
+            std::vector<uint32_t> readback;
+            uint64_t readbackFrame;
+            bool readbackRetired;
+        };
+
+        Frame Run(float cameraX)
+        {
+            Frame frame;
+            fence.Tick();
+            uint32_t slot = frames.BeginFrame();
+
+            frame.visible = CullCubes(cameraX);
+            gpuIds = frame.visible;
+
+            frame.readbackFrame = readbackFrame[slot];
+            frame.readbackRetired = frames.IsSlotRetired(slot);
+            if (readbackFrame[slot] != 0)
+                frame.readback = staging[slot];
+            staging[slot] = gpuIds;
+            readbackFrame[slot] = frames.GetFrameNumber();
+
+            frame.drawn = gpuIds;
+            frames.EndFrame();
+            return frame;
+        }
+
+        ReplayFence fence;
+        FrameManager frames;
+        std::vector<uint32_t> gpuIds;
+        std::vector<uint32_t> staging[FrameManager::MaxFramesInFlight];
+        uint64_t readbackFrame[FrameManager::MaxFramesInFlight];
+    };
+}
+
+TEST_CASE(FrameManager, SlotsCycleThroughFramesInFlight)
+{
+    ReplayFence fence(1);
+    FrameManager frames;
+    frames.SetFence(&fence);
+    frames.SetFramesInFlight(3);
+
+    for (uint64_t frame = 1; frame <= 7; frame++)
+    {
+        fence.Tick();
+        uint32_t slot = frames.BeginFrame();
+        CHECK(slot == frame % 3);
+        CHECK(frames.GetSlotFrame(slot) == frame);
+        frames.EndFrame();
+    }
+}
+
+TEST_CASE(FrameManager, FramesInFlightIsClamped)
+{
+    FrameManager frames;
+    frames.SetFramesInFlight(0);
+    CHECK(frames.GetFramesInFlight() == 1);
+    frames.SetFramesInFlight(8);
+    CHECK(frames.GetFramesInFlight() == FrameManager::MaxFramesInFlight);
+}
+
+TEST_CASE(FrameManager, BlocksOnlyWhenTheGpuFallsBehind)
+{
+    for (uint32_t inFlight = 1; inFlight <= FrameManager::MaxFramesInFlight; inFlight++)
+    {
+        // A frame that takes exactly as long as the CPU needs for inFlight frames never stalls
+        ReplayFence fast(inFlight);
+        FrameManager frames;
+        frames.SetFence(&fast);
+        frames.SetFramesInFlight(inFlight);
+        for (int i = 0; i < 30; i++)
+        {
+            fast.Tick();
+            frames.BeginFrame();
+            frames.EndFrame();
+        }
+        CHECK(frames.GetWaitCount() == 0);
+
+        ReplayFence slow(inFlight + 2);
+        FrameManager stalled;
+        stalled.SetFence(&slow);
+        stalled.SetFramesInFlight(inFlight);
+        for (int i = 0; i < 30; i++)
+        {
+            slow.Tick();
+            stalled.BeginFrame();
+            stalled.EndFrame();
+        }
+        CHECK(stalled.GetWaitCount() > 0);
+    }
+}
+
+TEST_CASE(FrameManager, DeferredReleaseWaitsForItsFrame)
+{
+    ReplayFence fence(2);
+    FrameManager frames;
+    frames.SetFence(&fence);
+    frames.SetFramesInFlight(2);
+
+    int released = 0;
+    fence.Tick();
+    frames.BeginFrame();
+    frames.DeferRelease([&released]() { released++; });
+    frames.EndFrame();
+    CHECK(released == 0);
+    CHECK(frames.GetPendingReleaseCount() == 1);
+
+    // Frame 2 starts before frame 1 finished on the GPU
+    fence.Tick();
+    frames.BeginFrame();
+    CHECK(released == 0);
+    frames.EndFrame();
+
+    fence.Tick();
+    frames.BeginFrame();
+    CHECK(released == 1);
+    CHECK(frames.GetPendingReleaseCount() == 0);
+    frames.EndFrame();
+}
+
+TEST_CASE(FrameManager, WaitIdleRunsEveryPendingRelease)
+{
+    ReplayFence fence(5);
+    FrameManager frames;
+    frames.SetFence(&fence);
+    frames.SetFramesInFlight(3);
+
+    int released = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        fence.Tick();
+        frames.BeginFrame();
+        frames.DeferRelease([&released]() { released++; });
+        frames.EndFrame();
+    }
+    frames.WaitIdle();
+    CHECK(released == 3);
+    CHECK(frames.GetPendingReleaseCount() == 0);
+}
+
+TEST_CASE(FrameManager, WithoutFenceReleasesImmediately)
+{
+    FrameManager frames;
+    int released = 0;
+    frames.BeginFrame();
+    frames.EndFrame();
+    CHECK(frames.IsSlotRetired(frames.GetCurrentSlot()));
+    frames.DeferRelease([&released]() { released++; });
+    CHECK(released == 1);
+}
+
+// Camera sweeping along the row while frames are pipelined: every cube visible in a
+// frame must be drawn in that frame, whatever the frame count and GPU latency
+TEST_CASE(FrameManager, CullingReplayDrawsEveryVisibleCube)
+{
+    for (uint32_t inFlight = 1; inFlight <= FrameManager::MaxFramesInFlight; inFlight++)
+    {
+        for (uint64_t latency = 1; latency <= 4; latency++)
+        {
+            CullingReplay replay(latency);
+            replay.frames.SetFramesInFlight(inFlight);
+
+            int missing = 0;
+            for (int i = 0; i < 40; i++)
+            {
+                CullingReplay::Frame frame = replay.Run(i * 1.25f);
+                for (uint32_t id : frame.visible)
+                {
+                    if (!Contains(frame.drawn, id))
+                        missing++;
+                }
+                CHECK(frame.drawn.size() == frame.visible.size());
+            }
+            CHECK(missing == 0);
+        }
+    }
+}
+
+// The CPU copy of the culling result is only read from a frame that already retired,
+// exactly framesInFlight frames back, so the readback never stalls on the GPU
+TEST_CASE(FrameManager, CullingReadbackComesFromARetiredFrame)
+{
+    for (uint32_t inFlight = 1; inFlight <= FrameManager::MaxFramesInFlight; inFlight++)
+    {
+        CullingReplay replay(inFlight);
+        replay.frames.SetFramesInFlight(inFlight);
+
+        for (uint64_t i = 1; i <= 20; i++)
+        {
+            CullingReplay::Frame frame = replay.Run(i * 1.25f);
+            if (i <= inFlight)
+            {
+                CHECK(frame.readbackFrame == 0);
+                continue;
+            }
+            CHECK(frame.readbackRetired);
+            CHECK(frame.readbackFrame == i - inFlight);
+            CHECK(frame.readback == CullCubes((i - inFlight) * 1.25f));
+        }
+        CHECK(replay.frames.GetWaitCount() == 0);
+    }
+}
+
+// Why the readback is not used for drawing: with a moving camera it misses cubes
+TEST_CASE(FrameManager, StaleReadbackWouldMissVisibleCubes)
+{
+    CullingReplay replay(2);
+    replay.frames.SetFramesInFlight(2);
+
+    int missing = 0;
+    for (int i = 0; i < 40; i++)
+    {
+        CullingReplay::Frame frame = replay.Run(i * 1.25f);
+        if (frame.readbackFrame == 0)
+            continue;
+        for (uint32_t id : frame.visible)
+        {
+            if (!Contains(frame.readback, id))
+                missing++;
+        }
+    }
+    CHECK(missing > 0);
+}
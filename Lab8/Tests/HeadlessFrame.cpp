@@ -0,0 +1,272 @@
+// Runs the frame of SceneRenderer, the same one RenderClass drives, against NullRenderBackend
+// without a device or a window: cube animation, light clusters and lists, the shadow cache and
+// cascades, the batched markers and parallelograms, the render graph with the negative pass and
+// an ImGui frame. There is no compute on the null backend, so the cubes are culled on the CPU.
+// Reports the CPU frame time and the backend allocations and fails on backend errors, on
+// buffers created after the warm-up frames, or on a slow frame.
+//
+// Lab8Headless [frames] [maxAverageMs]
+#include "FrameManager.h"
+#include "ImGuiRenderer.h"
+#include "NullRenderBackend.h"
+#include "Profiler.h"
+#include "SceneRenderer.h"
+#include "ThreadPool.h"
+#include "imgui.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace
+{
+    const uint32_t WarmupFrames = 8;
+    const uint32_t Width = 1280;
+    const uint32_t Height = 720;
+    const uint32_t ColorFormat = 28;    // DXGI_FORMAT_R8G8B8A8_UNORM
+    const uint32_t ExtraLights = 1024;
+
+    class HeadlessHost : public SceneHost
+    {
+    public:
+        NullRenderBackend backend;
+        FrameManager frames;
+        SceneRenderer scene;
+        ImGuiRenderer imguiRenderer;
+
+        HeadlessHost()
+            : backBufferTarget(InvalidBackendHandle),
+            backBufferDepthTarget(InvalidBackendHandle)
+        {
+        }
+
+        bool Init()
+        {
+            ScenePipelines pipelines = {};
+            pipelines.cube = backend.RegisterPipeline("Cube");
+            pipelines.cubeLightmap = backend.RegisterPipeline("Cube Lightmap");
+            pipelines.cull = InvalidBackendHandle;
+            pipelines.skybox = backend.RegisterPipeline("Skybox");
+            pipelines.marker = backend.RegisterPipeline("Marker");
+            pipelines.parallelogram = backend.RegisterPipeline("Parallelogram");
+            pipelines.postProcess = backend.RegisterPipeline("Negative");
+            pipelines.shadowClear = backend.RegisterPipeline("Shadow Clear");
+            pipelines.shadowCaster = backend.RegisterPipeline("Shadow Caster");
+            pipelines.shadowSampler = backend.RegisterSampler("Shadow Sampler");
+
+            SceneTargets targets = {};
+            targets.shadowAtlas = backend.RegisterTarget("Shadow Atlas");
+            for (uint32_t i = 0; i < CascadedShadows::MaxCascades; i++)
+                targets.cascades[i] = backend.RegisterTarget("Cascade");
+            targets.cascadeSize = 2048;
+            targets.colorFormat = ColorFormat;
+            backBufferTarget = backend.RegisterTarget("BackBuffer");
+            backBufferDepthTarget = backend.RegisterTarget("BackBuffer Depth");
+
+            // No streamed, baked or environment textures: the scene leaves those slots empty
+            SceneTextures textures = {};
+            textures.shadowAtlas = backend.RegisterTexture("Shadow Atlas");
+            textures.cascades = backend.RegisterTexture("Cascades");
+
+            scene.SetThreadPool(&ThreadPool::Get());
+            scene.SetViewport(Width, Height);
+            scene.SetTextures(textures);
+            SceneSettings settings = scene.GetSettings();
+            settings.useNegative = true;
+            settings.useSun = true;
+            settings.extraLightCount = ExtraLights;
+            settings.useInstanceLights = true;
+            scene.SetSettings(settings);
+            if (!scene.Init(backend, pipelines, targets))
+                return false;
+
+            ImGui::CreateContext();
+            ImGuiIO& io = ImGui::GetIO();
+            io.IniFilename = nullptr;
+            io.BackendRendererName = "RenderBackend";
+            io.BackendFlags |= ImGuiBackendFlags_RendererHasVtxOffset;
+            io.DisplaySize = ImVec2(static_cast<float>(Width), static_cast<float>(Height));
+            unsigned char* pPixels = nullptr;
+            int fontWidth = 0;
+            int fontHeight = 0;
+            io.Fonts->GetTexDataAsRGBA32(&pPixels, &fontWidth, &fontHeight);
+            io.Fonts->SetTexID(static_cast<ImTextureID>(backend.RegisterTexture("ImGui Font")));
+            return imguiRenderer.Init(backend, backend.RegisterPipeline("ImGui"));
+        }
+
+        void Terminate()
+        {
+            imguiRenderer.Terminate(backend);
+            ImGui::DestroyContext();
+        }
+
+        bool RenderFrame(uint32_t frame)
+        {
+            PROFILE_SCOPE("Headless Frame");
+            frames.BeginFrame();
+
+            // Orbit the scene, looking at the centre cube
+            float angle = static_cast<float>(frame) / 60.0f * 0.3f;
+            XMFLOAT3 position(std::sin(angle) * 12.0f, 3.0f, -std::cos(angle) * 12.0f);
+            scene.SetCamera(position, -angle, 0.24f);
+            scene.Update();
+
+            bool compiled = scene.BuildGraph(backend, frames, *this);
+            if (compiled)
+            {
+                backend.BeginFrame();
+                scene.GetGraph().Execute();
+                backend.EndFrame();
+            }
+            frames.EndFrame();
+            return compiled;
+        }
+
+        // SceneHost
+        BackendHandle GetTarget(RenderGraph::ResourceHandle resource, bool depth) override
+        {
+            const RenderGraph& graph = scene.GetGraph();
+            if (graph.IsImported(resource))
+                return depth ? backBufferDepthTarget : backBufferTarget;
+            return GetGraphTarget(graph.GetPhysicalIndex(resource)).target;
+        }
+
+        BackendHandle GetTexture(RenderGraph::ResourceHandle resource) override
+        {
+            const RenderGraph& graph = scene.GetGraph();
+            if (graph.IsImported(resource))
+                return InvalidBackendHandle;
+            return GetGraphTarget(graph.GetPhysicalIndex(resource)).texture;
+        }
+
+        void RenderSoftware() override
+        {
+        }
+
+        void RenderUi() override
+        {
+            ImGuiIO& io = ImGui::GetIO();
+            io.DeltaTime = 1.0f / 60.0f;
+            ImGui::NewFrame();
+            ImGui::Begin("Options");
+            ImGui::Text("Visible cubes: %u", static_cast<uint32_t>(scene.GetVisibleIds().size()));
+            ImGui::Text("Shadow faces: %u", scene.GetShadowCache().GetStats().facesRendered);
+            ImGui::Text("Cluster references: %u", scene.GetLightClusters().GetStats().references);
+            ImGui::Text("Batch draw calls: %u", scene.GetBatchDrawCalls());
+            ImGui::End();
+            ImGui::Render();
+            imguiRenderer.Render(backend, ImGui::GetDrawData());
+        }
+
+    private:
+        struct GraphTarget
+        {
+            BackendHandle target;
+            BackendHandle texture;
+        };
+
+        // Registered on first use, a physical texture keeps its slot for the whole run
+        const GraphTarget& GetGraphTarget(uint32_t physical)
+        {
+            while (graphTargets.size() <= physical)
+            {
+                GraphTarget graphTarget = { backend.RegisterTarget("Graph Target"), backend.RegisterTexture("Graph Texture") };
+                graphTargets.push_back(graphTarget);
+            }
+            return graphTargets[physical];
+        }
+
+        BackendHandle backBufferTarget;
+        BackendHandle backBufferDepthTarget;
+        std::vector<GraphTarget> graphTargets;
+    };
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t frameCount = argc > 1 ? static_cast<uint32_t>(atoi(argv[1])) : 300;
+    double maxAverageMs = argc > 2 ? atof(argv[2]) : 0.0;
+    frameCount = std::max(frameCount, WarmupFrames + 1);
+
+    HeadlessHost host;
+    if (!host.Init())
+    {
+        printf("FAILED: the scene could not be initialized\n");
+        return 1;
+    }
+
+    double totalMs = 0.0;
+    double maxMs = 0.0;
+    uint64_t buffersAfterWarmup = 0;
+    uint64_t growsAfterWarmup = 0;
+    uint32_t graphErrors = 0;
+    for (uint32_t frame = 0; frame < frameCount; frame++)
+    {
+        if (frame == WarmupFrames)
+        {
+            buffersAfterWarmup = host.backend.GetStats().buffersCreated;
+            growsAfterWarmup = host.imguiRenderer.GetBufferGrowCount();
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        if (!host.RenderFrame(frame))
+            graphErrors++;
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (frame >= WarmupFrames)
+        {
+            totalMs += ms;
+            maxMs = std::max(maxMs, ms);
+        }
+    }
+
+    const BackendStats& stats = host.backend.GetStats();
+    const BackendStats& last = host.backend.GetLastFrameStats();
+    uint32_t measured = frameCount - WarmupFrames;
+    double averageMs = totalMs / measured;
+    uint64_t lateBuffers = stats.buffersCreated - buffersAfterWarmup;
+    uint64_t lateGrows = host.imguiRenderer.GetBufferGrowCount() - growsAfterWarmup;
+    uint64_t errors = host.backend.GetErrorCount();
+
+    printf("Frames: %u (%u warm-up)\n", frameCount, WarmupFrames);
+    printf("CPU frame: %.3f ms average, %.3f ms max\n", averageMs, maxMs);
+    printf("Last frame: %llu draws, %llu instances, %llu dispatches, %llu uploads (%llu bytes)\n",
+        static_cast<unsigned long long>(last.draws), static_cast<unsigned long long>(last.instances),
+        static_cast<unsigned long long>(last.dispatches), static_cast<unsigned long long>(last.uploads),
+        static_cast<unsigned long long>(last.bytesUploaded));
+    printf("Passes: %u of %u executed, %u visible cubes\n",
+        static_cast<uint32_t>(host.scene.GetGraph().GetExecutedPassCount()),
+        static_cast<uint32_t>(host.scene.GetGraph().GetPassCount()),
+        static_cast<uint32_t>(host.scene.GetVisibleIds().size()));
+    printf("Buffers: %llu created (%llu after warm-up), %llu bytes peak\n",
+        static_cast<unsigned long long>(stats.buffersCreated), static_cast<unsigned long long>(lateBuffers),
+        static_cast<unsigned long long>(stats.peakBytesAllocated));
+    printf("Backend errors: %llu, graph errors: %u\n", static_cast<unsigned long long>(errors), graphErrors);
+
+    host.Terminate();
+
+    bool failed = false;
+    if (errors > 0)
+    {
+        printf("FAILED: the frame made invalid backend calls\n");
+        failed = true;
+    }
+    if (graphErrors > 0)
+    {
+        printf("FAILED: the render graph did not compile: %s\n", host.scene.GetGraph().GetError().c_str());
+        failed = true;
+    }
+    if (lateBuffers > 0 || lateGrows > 0)
+    {
+        printf("FAILED: buffers were created after the warm-up frames\n");
+        failed = true;
+    }
+    if (maxAverageMs > 0.0 && averageMs > maxAverageMs)
+    {
+        printf("FAILED: %.3f ms average exceeds the %.3f ms budget\n", averageMs, maxAverageMs);
+        failed = true;
+    }
+    return failed ? 1 : 0;
+}
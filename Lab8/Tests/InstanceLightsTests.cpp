@@ -0,0 +1,173 @@
+#include "Test.h"
+#include "InstanceLights.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+    typedef InstanceLightLists Lists;
+
+    uint32_t Next(uint32_t& seed)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        return seed >> 8;
+    }
+
+    float NextFloat(uint32_t& seed)
+    {
+        return Next(seed) * (1.0f / 16777216.0f);
+    }
+
+    // Lights in a 20 x 6 x 20 box, a few per instance and too few for a list to overflow
+    std::vector<XMFLOAT4> RandomLights(uint32_t count, uint32_t seed)
+    {
+        std::vector<XMFLOAT4> lights(count);
+        for (XMFLOAT4& light : lights)
+            light = XMFLOAT4(NextFloat(seed) * 20.0f - 10.0f, NextFloat(seed) * 6.0f - 3.0f, NextFloat(seed) * 20.0f - 10.0f,
+                0.5f + NextFloat(seed) * 2.0f);
+        return lights;
+    }
+
+    std::vector<InstanceBounds> RandomBounds(uint32_t count, uint32_t seed)
+    {
+        std::vector<InstanceBounds> bounds(count);
+        for (InstanceBounds& box : bounds)
+        {
+            box.center = XMFLOAT3(NextFloat(seed) * 20.0f - 10.0f, NextFloat(seed) * 6.0f - 3.0f, NextFloat(seed) * 20.0f - 10.0f);
+            box.extents = XMFLOAT3(0.2f + NextFloat(seed), 0.2f + NextFloat(seed), 0.2f + NextFloat(seed));
+        }
+        return bounds;
+    }
+
+    // Distance from the light to the nearest point of the box, in double precision
+    double Distance(const XMFLOAT4& light, const InstanceBounds& box)
+    {
+        double dx = std::max(std::fabs(static_cast<double>(light.x) - box.center.x) - box.extents.x, 0.0);
+        double dy = std::max(std::fabs(static_cast<double>(light.y) - box.center.y) - box.extents.y, 0.0);
+        double dz = std::max(std::fabs(static_cast<double>(light.z) - box.center.z) - box.extents.z, 0.0);
+        return std::sqrt(dx * dx + dy * dy + dz * dz);
+    }
+
+    std::vector<uint32_t> List(const Lists& lists, uint32_t instance)
+    {
+        const uint32_t* pList = &lists.GetLists()[static_cast<size_t>(instance) * Lists::ListStride];
+        std::vector<uint32_t> list(pList + 1, pList + 1 + std::min(pList[0], Lists::MaxLightsPerInstance));
+        std::sort(list.begin(), list.end());
+        return list;
+    }
+}
+
+// Every light that reaches into a box is on its list and no other one; lights within 1e-4 of
+// the boundary may go either way
+TEST_CASE(InstanceLights, ListsMatchTheBruteForceReference)
+{
+    // Not a multiple of four, so the last SIMD group has padding lanes
+    std::vector<XMFLOAT4> lights = RandomLights(101, 5);
+    std::vector<InstanceBounds> bounds = RandomBounds(1000, 6);
+    Lists lists;
+    lists.Build(lights.data(), sizeof(XMFLOAT4), static_cast<uint32_t>(lights.size()), bounds.data(),
+        static_cast<uint32_t>(bounds.size()));
+    CHECK(lists.GetLists().size() == bounds.size() * Lists::ListStride);
+    CHECK(lists.GetStats().overflowedInstances == 0);
+
+    uint32_t mismatches = 0;
+    uint32_t references = 0;
+    uint32_t maxCount = 0;
+    for (uint32_t i = 0; i < bounds.size(); i++)
+    {
+        std::vector<uint32_t> list = List(lists, i);
+        references += static_cast<uint32_t>(list.size());
+        maxCount = std::max(maxCount, static_cast<uint32_t>(list.size()));
+        for (uint32_t light = 0; light < lights.size(); light++)
+        {
+            double margin = Distance(lights[light], bounds[i]) - lights[light].w;
+            bool listed = std::binary_search(list.begin(), list.end(), light);
+            if ((margin < -1e-4 && !listed) || (margin > 1e-4 && listed))
+                mismatches++;
+        }
+    }
+    CHECK(mismatches == 0);
+    CHECK(references > bounds.size());
+    CHECK(references == lists.GetStats().references);
+    CHECK(maxCount == lists.GetStats().maxLightsPerInstance);
+}
+
+// More lights than a list holds: the ones that are strongest at the nearest point of the box stay
+TEST_CASE(InstanceLights, OverflowKeepsTheStrongestLights)
+{
+    InstanceBounds box = { XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(1.0f, 1.0f, 1.0f) };
+    const uint32_t count = Lists::MaxLightsPerInstance + 9;
+    std::vector<XMFLOAT4> lights;
+    std::vector<double> attenuation;
+    uint32_t seed = 3;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        XMFLOAT4 light(1.5f + NextFloat(seed) * 2.0f, NextFloat(seed) * 2.0f - 1.0f, NextFloat(seed) * 2.0f - 1.0f, 4.0f);
+        lights.push_back(light);
+        attenuation.push_back(1.0 - Distance(light, box) / light.w);
+    }
+    // One far light that misses the box does not take a slot
+    lights.push_back(XMFLOAT4(20.0f, 0.0f, 0.0f, 4.0f));
+
+    Lists lists;
+    lists.Build(lights.data(), sizeof(XMFLOAT4), static_cast<uint32_t>(lights.size()), &box, 1);
+    std::vector<uint32_t> list = List(lists, 0);
+    CHECK(lists.GetLists()[0] == Lists::MaxLightsPerInstance);
+    CHECK(lists.GetStats().overflowedInstances == 1);
+
+    std::vector<uint32_t> order(count);
+    for (uint32_t i = 0; i < count; i++)
+        order[i] = i;
+    std::sort(order.begin(), order.end(), [&attenuation](uint32_t a, uint32_t b) { return attenuation[a] > attenuation[b]; });
+    std::vector<uint32_t> expected(order.begin(), order.begin() + Lists::MaxLightsPerInstance);
+    std::sort(expected.begin(), expected.end());
+    CHECK(list == expected);
+}
+
+TEST_CASE(InstanceLights, StrideAndEmptyInputs)
+{
+    std::vector<XMFLOAT4> lights = RandomLights(40, 9);
+    // Lights with extra data after the range, like the scene's light buffer
+    struct SceneLight
+    {
+        XMFLOAT4 positionRange;
+        XMFLOAT4 color;
+    };
+    std::vector<SceneLight> sceneLights;
+    for (const XMFLOAT4& light : lights)
+        sceneLights.push_back({ light, XMFLOAT4(1.0f, 0.0f, 0.0f, 1.0f) });
+    std::vector<InstanceBounds> bounds = RandomBounds(300, 10);
+
+    Lists packed;
+    packed.Build(lights.data(), sizeof(XMFLOAT4), 40, bounds.data(), 300);
+    Lists strided;
+    strided.Build(sceneLights.data(), sizeof(SceneLight), 40, bounds.data(), 300);
+    CHECK(strided.GetLists() == packed.GetLists());
+
+    // No lights: every list is empty; no instances: no lists
+    Lists empty;
+    empty.Build(nullptr, sizeof(XMFLOAT4), 0, bounds.data(), 300);
+    CHECK(empty.GetStats().references == 0);
+    CHECK(empty.GetLists().size() == 300 * Lists::ListStride);
+    empty.Build(lights.data(), sizeof(XMFLOAT4), 40, nullptr, 0);
+    CHECK(empty.GetLists().empty());
+    CHECK(empty.GetStats().references == 0);
+}
+
+TEST_CASE(InstanceLights, ThreadPoolBuildMatchesTheSerialOne)
+{
+    std::vector<XMFLOAT4> lights = RandomLights(500, 21);
+    std::vector<InstanceBounds> bounds = RandomBounds(5000, 22);
+    Lists serial;
+    serial.Build(lights.data(), sizeof(XMFLOAT4), 500, bounds.data(), 5000);
+
+    ThreadPool pool(3);
+    Lists parallel;
+    parallel.SetThreadPool(&pool);
+    parallel.Build(lights.data(), sizeof(XMFLOAT4), 500, bounds.data(), 5000);
+    CHECK(parallel.GetLists() == serial.GetLists());
+    CHECK(parallel.GetStats().references == serial.GetStats().references);
+    CHECK(parallel.GetStats().overflowedInstances == serial.GetStats().overflowedInstances);
+}
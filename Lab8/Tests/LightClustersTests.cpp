@@ -0,0 +1,241 @@
+#include "Test.h"
+#include "LightClusters.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+    typedef LightClusterGrid Grid;
+
+    const float NearZ = 0.1f;
+    const float FarZ = 100.0f;
+
+    // XMMatrixPerspectiveFovLH(XM_PIDIV4, 16:9, NearZ, FarZ)
+    XMFLOAT4X4 Projection()
+    {
+        float yScale = 1.0f / std::tan(XM_PIDIV4 * 0.5f);
+        XMFLOAT4X4 m = {};
+        m._11 = yScale * 9.0f / 16.0f;
+        m._22 = yScale;
+        m._33 = FarZ / (FarZ - NearZ);
+        m._34 = 1.0f;
+        m._43 = -NearZ * FarZ / (FarZ - NearZ);
+        return m;
+    }
+
+    // Camera at (eyeX, eyeY, eyeZ) turned by yaw around y, row vectors like XMMatrixLookToLH
+    XMFLOAT4X4 View(float eyeX, float eyeY, float eyeZ, float yaw)
+    {
+        float c = std::cos(yaw);
+        float s = std::sin(yaw);
+        XMFLOAT4X4 m = {};
+        m._11 = c; m._13 = s;
+        m._22 = 1.0f;
+        m._31 = -s; m._33 = c;
+        m._41 = -(eyeX * c - eyeZ * s);
+        m._42 = -eyeY;
+        m._43 = -(eyeX * s + eyeZ * c);
+        m._44 = 1.0f;
+        return m;
+    }
+
+    std::vector<XMFLOAT4> RandomLights(uint32_t count, uint32_t seed)
+    {
+        auto next = [&seed]()
+        {
+            seed = seed * 1664525u + 1013904223u;
+            return (seed >> 8) * (1.0f / 16777216.0f);
+        };
+        std::vector<XMFLOAT4> lights(count);
+        for (XMFLOAT4& light : lights)
+            light = XMFLOAT4(next() * 80.0f - 40.0f, next() * 30.0f - 15.0f, next() * 120.0f - 20.0f, 0.2f + next() * 4.0f);
+        return lights;
+    }
+
+    // Sphere against the planes of one cluster cell, in double precision. The grid gives a
+    // sphere around the eye every tile of its slices, the reference does the same.
+    class Reference
+    {
+    public:
+        Reference(const XMFLOAT4X4& view, const XMFLOAT4X4& proj) : m_view(view), m_proj(proj)
+        {
+            for (uint32_t k = 0; k <= Grid::GridZ; k++)
+                m_depths[k] = NearZ * std::pow(static_cast<double>(FarZ) / NearZ, static_cast<double>(k) / Grid::GridZ);
+        }
+
+        // Cluster indices the light reaches with its range grown by delta
+        std::vector<uint32_t> Clusters(const XMFLOAT4& light, double delta) const
+        {
+            std::vector<uint32_t> clusters;
+            const XMFLOAT4X4& v = m_view;
+            double vx = light.x * v._11 + light.y * v._21 + light.z * v._31 + v._41;
+            double vy = light.x * v._12 + light.y * v._22 + light.z * v._32 + v._42;
+            double vz = light.x * v._13 + light.y * v._23 + light.z * v._33 + v._43;
+            double r = light.w + delta;
+            double zMin = vz - r;
+            double zMax = vz + r;
+            if (r <= 0.0 || zMax <= NearZ || zMin >= FarZ)
+                return clusters;
+            if (Column(vx, vz, 0) < -r || Column(vx, vz, Grid::GridX) > r || Row(vy, vz, 0) < -r || Row(vy, vz, Grid::GridY) > r)
+                return clusters;
+
+            bool aroundEye = zMin < NearZ;
+            for (uint32_t z = 0; z < Grid::GridZ; z++)
+            {
+                if ((z > 0 && zMax < m_depths[z]) || (z + 1 < Grid::GridZ && zMin >= m_depths[z + 1]))
+                    continue;
+                for (uint32_t y = 0; y < Grid::GridY; y++)
+                {
+                    if (!aroundEye && ((y > 0 && Row(vy, vz, y) < -r) || (y + 1 < Grid::GridY && Row(vy, vz, y + 1) > r)))
+                        continue;
+                    for (uint32_t x = 0; x < Grid::GridX; x++)
+                    {
+                        if (!aroundEye && ((x > 0 && Column(vx, vz, x) < -r) || (x + 1 < Grid::GridX && Column(vx, vz, x + 1) > r)))
+                            continue;
+                        clusters.push_back((z * Grid::GridY + y) * Grid::GridX + x);
+                    }
+                }
+            }
+            return clusters;
+        }
+
+    private:
+        // Signed distances to the tile boundaries, positive to the right of and below them
+        double Column(double vx, double vz, uint32_t i) const
+        {
+            double a = -1.0 + 2.0 * i / Grid::GridX;
+            return (vx * m_proj._11 - a * vz) / std::sqrt(m_proj._11 * m_proj._11 + a * a);
+        }
+
+        double Row(double vy, double vz, uint32_t j) const
+        {
+            double b = 1.0 - 2.0 * j / Grid::GridY;
+            return (-vy * m_proj._22 + b * vz) / std::sqrt(m_proj._22 * m_proj._22 + b * b);
+        }
+
+        XMFLOAT4X4 m_view;
+        XMFLOAT4X4 m_proj;
+        double m_depths[Grid::GridZ + 1];
+    };
+
+    bool ClusterHasLight(const Grid& grid, uint32_t cluster, uint32_t light)
+    {
+        const std::vector<uint32_t>& ranges = grid.GetClusterRanges();
+        const uint32_t* pFirst = grid.GetLightIndices().data() + ranges[cluster * 2];
+        const uint32_t* pLast = pFirst + ranges[cluster * 2 + 1];
+        return std::binary_search(pFirst, pLast, light);
+    }
+
+    // Every cluster the slightly smaller sphere reaches has the light, no cluster outside the
+    // slightly larger one has it; the margin only absorbs float rounding at the boundaries
+    uint32_t CountMismatches(const Grid& grid, const XMFLOAT4X4& view, const std::vector<XMFLOAT4>& lights)
+    {
+        Reference reference(view, Projection());
+        std::vector<uint32_t> perCluster(Grid::ClusterCount, 0);
+        uint32_t mismatches = 0;
+        for (uint32_t i = 0; i < lights.size(); i++)
+        {
+            for (uint32_t cluster : reference.Clusters(lights[i], -1e-3))
+                mismatches += ClusterHasLight(grid, cluster, i) ? 0 : 1;
+            std::vector<uint32_t> loose = reference.Clusters(lights[i], 1e-3);
+            for (uint32_t cluster : loose)
+                perCluster[cluster] += ClusterHasLight(grid, cluster, i) ? 1 : 0;
+        }
+        for (uint32_t cluster = 0; cluster < Grid::ClusterCount; cluster++)
+            mismatches += perCluster[cluster] != grid.GetClusterRanges()[cluster * 2 + 1] ? 1 : 0;
+        return mismatches;
+    }
+}
+
+TEST_CASE(LightClusters, ClustersMatchTheBruteForceReference)
+{
+    std::vector<XMFLOAT4> lights = RandomLights(2000, 99);
+    // Around the eye, just behind it, and straddling the near and far planes
+    lights.push_back(XMFLOAT4(0.0f, 0.0f, 0.0f, 1.5f));
+    lights.push_back(XMFLOAT4(0.0f, 0.0f, -3.0f, 2.0f));
+    lights.push_back(XMFLOAT4(1.0f, 0.5f, 0.15f, 0.1f));
+    lights.push_back(XMFLOAT4(0.0f, 0.0f, 99.0f, 3.0f));
+
+    const XMFLOAT4X4 views[3] = { View(0.0f, 0.0f, 0.0f, 0.0f), View(3.0f, 2.0f, -5.0f, 0.4f), View(-10.0f, -1.0f, 30.0f, -1.1f) };
+    for (const XMFLOAT4X4& view : views)
+    {
+        Grid grid;
+        grid.Build(view, Projection(), 1920, 1080, lights.data(), sizeof(XMFLOAT4), static_cast<uint32_t>(lights.size()));
+        CHECK(!grid.GetStats().overflow);
+        CHECK(grid.GetStats().references > 0);
+        CHECK(CountMismatches(grid, view, lights) == 0);
+    }
+}
+
+TEST_CASE(LightClusters, ListsAreSortedAndRangesCoverTheIndices)
+{
+    std::vector<XMFLOAT4> lights = RandomLights(500, 7);
+    Grid grid;
+    grid.Build(View(0.0f, 0.0f, 0.0f, 0.0f), Projection(), 1280, 720, lights.data(), sizeof(XMFLOAT4),
+        static_cast<uint32_t>(lights.size()));
+
+    const std::vector<uint32_t>& ranges = grid.GetClusterRanges();
+    const std::vector<uint32_t>& indices = grid.GetLightIndices();
+    CHECK(ranges.size() == Grid::ClusterCount * 2);
+    uint64_t total = 0;
+    uint32_t maxCount = 0;
+    uint32_t unsorted = 0;
+    std::vector<bool> seen(lights.size(), false);
+    for (uint32_t cluster = 0; cluster < Grid::ClusterCount; cluster++)
+    {
+        uint32_t offset = ranges[cluster * 2];
+        uint32_t count = ranges[cluster * 2 + 1];
+        CHECK(offset + count <= indices.size());
+        for (uint32_t i = 0; i < count; i++)
+        {
+            if (i > 0 && indices[offset + i - 1] >= indices[offset + i])
+                unsorted++;
+            seen[indices[offset + i]] = true;
+        }
+        total += count;
+        maxCount = std::max(maxCount, count);
+    }
+    CHECK(unsorted == 0);
+    CHECK(total == grid.GetStats().references);
+    CHECK(total == indices.size());
+    CHECK(maxCount == grid.GetStats().maxLightsPerCluster);
+    CHECK(static_cast<uint32_t>(std::count(seen.begin(), seen.end(), true)) == grid.GetStats().visibleLights);
+
+    const ClusterConstants& constants = grid.GetConstants();
+    CHECK(constants.lightCount == 500);
+    CHECK(std::fabs(constants.screenScaleX * 1280.0f - Grid::GridX) < 1e-4f);
+    // The slice formula of the shaders puts the near plane at 0 and the far plane at GridZ
+    CHECK(std::fabs(std::log(NearZ) * constants.depthScale + constants.depthBias) < 1e-3f);
+    CHECK(std::fabs(std::log(FarZ) * constants.depthScale + constants.depthBias - Grid::GridZ) < 1e-3f);
+}
+
+TEST_CASE(LightClusters, LightsOutsideTheFrustumTouchNothing)
+{
+    std::vector<XMFLOAT4> lights;
+    lights.push_back(XMFLOAT4(0.0f, 0.0f, -10.0f, 2.0f));     // behind the eye
+    lights.push_back(XMFLOAT4(200.0f, 0.0f, 20.0f, 2.0f));    // far to the side
+    lights.push_back(XMFLOAT4(0.0f, 0.0f, 150.0f, 2.0f));     // beyond the far plane
+    lights.push_back(XMFLOAT4(0.0f, 0.0f, 20.0f, 0.0f));      // no range
+    Grid grid;
+    grid.Build(View(0.0f, 0.0f, 0.0f, 0.0f), Projection(), 1920, 1080, lights.data(), sizeof(XMFLOAT4),
+        static_cast<uint32_t>(lights.size()));
+    CHECK(grid.GetStats().visibleLights == 0);
+    CHECK(grid.GetStats().references == 0);
+}
+
+TEST_CASE(LightClusters, ThreadPoolBuildMatchesTheSerialOne)
+{
+    std::vector<XMFLOAT4> lights = RandomLights(3000, 3);
+    XMFLOAT4X4 view = View(1.0f, 0.0f, -2.0f, 0.2f);
+    Grid serial;
+    serial.Build(view, Projection(), 1920, 1080, lights.data(), sizeof(XMFLOAT4), static_cast<uint32_t>(lights.size()));
+
+    ThreadPool pool(3);
+    Grid parallel;
+    parallel.SetThreadPool(&pool);
+    parallel.Build(view, Projection(), 1920, 1080, lights.data(), sizeof(XMFLOAT4), static_cast<uint32_t>(lights.size()));
+    CHECK(parallel.GetClusterRanges() == serial.GetClusterRanges());
+    CHECK(parallel.GetLightIndices() == serial.GetLightIndices());
+}
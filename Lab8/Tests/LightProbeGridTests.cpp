@@ -0,0 +1,234 @@
+#include "Test.h"
+#include "LightProbeGrid.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+    const uint32_t Coefficients = LightProbeGrid::CoefficientCount;
+
+    // Cube from -1 to 1 with four vertices per face: position, outward normal and uv, the
+    // layout of the scene's Vertex
+    struct CubeMesh
+    {
+        std::vector<float> vertices;
+        std::vector<uint16_t> indices;
+
+        CubeMesh()
+        {
+            for (uint32_t face = 0; face < 6; face++)
+            {
+                uint32_t axis = face / 2;
+                float side = (face & 1) ? 1.0f : -1.0f;
+                uint16_t first = static_cast<uint16_t>(vertices.size() / 8);
+                for (uint32_t corner = 0; corner < 4; corner++)
+                {
+                    float position[3];
+                    position[axis] = side;
+                    position[(axis + 1) % 3] = (corner & 1) ? 1.0f : -1.0f;
+                    position[(axis + 2) % 3] = (corner & 2) ? 1.0f : -1.0f;
+                    float normal[3] = { 0.0f, 0.0f, 0.0f };
+                    normal[axis] = side;
+                    vertices.insert(vertices.end(), position, position + 3);
+                    vertices.insert(vertices.end(), normal, normal + 3);
+                    vertices.push_back((corner & 1) ? 1.0f : 0.0f);
+                    vertices.push_back((corner & 2) ? 1.0f : 0.0f);
+                }
+                const uint16_t quad[6] = { 0, 1, 3, 0, 3, 2 };
+                for (uint16_t index : quad)
+                    indices.push_back(static_cast<uint16_t>(first + index));
+            }
+        }
+
+        SwMeshData GetData() const
+        {
+            SwMeshData data = { vertices.data(), 8, static_cast<uint32_t>(vertices.size() / 8), indices.data(),
+                static_cast<uint32_t>(indices.size()) };
+            return data;
+        }
+    };
+
+    SwCubeInstance Cube(float x, float y, float z, float halfSize)
+    {
+        SwCubeInstance cube = {};
+        cube.model._11 = cube.model._22 = cube.model._33 = halfSize;
+        cube.model._41 = x;
+        cube.model._42 = y;
+        cube.model._43 = z;
+        cube.model._44 = 1.0f;
+        return cube;
+    }
+
+    // 5 x 3 x 5 probes 2 units apart over a floor with a few cubes that hide different parts
+    // of the sky from neighbouring probes; without textures the cubes are black, so the lights
+    // add nothing. The cube at (0, 1, 0) swallows a probe.
+    bool BakeScene(LightProbeGrid& grid, ThreadPool* pPool)
+    {
+        static const CubeMesh mesh;
+        grid.Init(pPool);
+        grid.SetMesh(mesh.GetData());
+
+        std::vector<SwCubeInstance> cubes;
+        cubes.push_back(Cube(0.0f, -11.0f, 0.0f, 10.0f));
+        cubes.push_back(Cube(0.0f, 1.0f, 0.0f, 0.8f));
+        cubes.push_back(Cube(-3.0f, 0.5f, 2.0f, 0.5f));
+        cubes.push_back(Cube(2.5f, 2.0f, -3.0f, 0.7f));
+        SwPointLight lights[3] = {};
+        XMFLOAT4 sky[Coefficients] = {};
+        sky[0] = XMFLOAT4(0.3f, 0.4f, 0.6f, 0.0f);
+        sky[2] = XMFLOAT4(0.05f, 0.05f, 0.1f, 0.0f);
+
+        ProbeGridSettings settings = { XMFLOAT3(-4.0f, -1.0f, -4.0f), XMFLOAT3(4.0f, 3.0f, 4.0f), 2.0f, 64 };
+        return grid.Bake(cubes, lights, sky, settings);
+    }
+
+    std::vector<XMFLOAT4> Interpolate(const LightProbeGrid& grid, const XMFLOAT3& position)
+    {
+        std::vector<XMFLOAT4> sh(Coefficients);
+        grid.Interpolate(&position, 1, sh.data());
+        return sh;
+    }
+
+    float MaxDifference(const XMFLOAT4* a, const XMFLOAT4* b, uint32_t count)
+    {
+        float difference = 0.0f;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            difference = std::max(difference, std::fabs(a[i].x - b[i].x));
+            difference = std::max(difference, std::fabs(a[i].y - b[i].y));
+            difference = std::max(difference, std::fabs(a[i].z - b[i].z));
+        }
+        return difference;
+    }
+
+    std::vector<XMFLOAT3> RandomPositions(uint32_t count, uint32_t seed)
+    {
+        auto next = [&seed]()
+        {
+            seed = seed * 1664525u + 1013904223u;
+            return (seed >> 8) * (1.0f / 16777216.0f);
+        };
+        // Inside the grid and a little past every side of it
+        std::vector<XMFLOAT3> positions(count);
+        for (XMFLOAT3& position : positions)
+            position = XMFLOAT3(next() * 10.0f - 5.0f, next() * 6.0f - 2.0f, next() * 10.0f - 5.0f);
+        return positions;
+    }
+}
+
+TEST_CASE(LightProbeGrid, BakeCoversTheBounds)
+{
+    LightProbeGrid grid;
+    CHECK(!grid.IsBaked());
+    CHECK(BakeScene(grid, nullptr));
+    CHECK(grid.IsBaked());
+    CHECK(grid.GetProbeCount() == 5 * 3 * 5);
+    CHECK(grid.GetStats().probes == 75);
+    CHECK(grid.GetStats().rays == 75 * 64);
+    // The probe inside the cube is replaced by its neighbours instead of staying black
+    CHECK(grid.GetStats().invalidProbes >= 1);
+    std::vector<XMFLOAT4> inside = Interpolate(grid, XMFLOAT3(0.0f, 1.0f, 0.0f));
+    CHECK(inside[0].x > 0.0f && inside[0].y > 0.0f && inside[0].z > 0.0f);
+
+    // No cubes or no spacing: nothing to bake
+    XMFLOAT4 sky[Coefficients] = {};
+    SwPointLight lights[3] = {};
+    ProbeGridSettings settings = { XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(1.0f, 1.0f, 1.0f), 0.0f, 16 };
+    std::vector<SwCubeInstance> cubes(1, Cube(0.0f, 0.0f, 0.0f, 1.0f));
+    LightProbeGrid empty;
+    empty.Init(nullptr);
+    CHECK(!empty.Bake(std::vector<SwCubeInstance>(), lights, sky, settings));
+    CHECK(!empty.Bake(cubes, lights, sky, settings));
+    CHECK(!empty.IsBaked());
+}
+
+// Inside a cell the result is the trilinear blend of the eight probes at its corners, which
+// the grid returns unchanged when asked at their own positions
+TEST_CASE(LightProbeGrid, InterpolationWeightsAreTrilinear)
+{
+    LightProbeGrid grid;
+    CHECK(BakeScene(grid, nullptr));
+
+    float maxError = 0.0f;
+    float maxSpread = 0.0f;
+    for (const XMFLOAT3& position : RandomPositions(200, 31))
+    {
+        // Clamped to the grid, the last probe of an axis closes the cell before it
+        const float sizes[3] = { 5.0f, 3.0f, 5.0f };
+        const float coords[3] = { (position.x + 4.0f) / 2.0f, (position.y + 1.0f) / 2.0f, (position.z + 4.0f) / 2.0f };
+        float cell[3];
+        float fraction[3];
+        for (int k = 0; k < 3; k++)
+        {
+            float scaled = std::min(std::max(coords[k], 0.0f), sizes[k] - 1.0f);
+            cell[k] = std::min(std::floor(scaled), sizes[k] - 2.0f);
+            fraction[k] = scaled - cell[k];
+        }
+
+        std::vector<XMFLOAT4> expected(Coefficients, XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f));
+        std::vector<XMFLOAT4> first;
+        for (int c = 0; c < 8; c++)
+        {
+            XMFLOAT3 corner(-4.0f + (cell[0] + (c & 1)) * 2.0f, -1.0f + (cell[1] + ((c >> 1) & 1)) * 2.0f,
+                -4.0f + (cell[2] + (c >> 2)) * 2.0f);
+            float weight = ((c & 1) ? fraction[0] : 1.0f - fraction[0]) * ((c & 2) ? fraction[1] : 1.0f - fraction[1]) *
+                ((c & 4) ? fraction[2] : 1.0f - fraction[2]);
+            std::vector<XMFLOAT4> probe = Interpolate(grid, corner);
+            if (c == 0)
+                first = probe;
+            maxSpread = std::max(maxSpread, MaxDifference(probe.data(), first.data(), Coefficients));
+            for (uint32_t i = 0; i < Coefficients; i++)
+            {
+                expected[i].x += probe[i].x * weight;
+                expected[i].y += probe[i].y * weight;
+                expected[i].z += probe[i].z * weight;
+            }
+        }
+        std::vector<XMFLOAT4> actual = Interpolate(grid, position);
+        maxError = std::max(maxError, MaxDifference(actual.data(), expected.data(), Coefficients));
+    }
+    // The probes differ, or any weights would pass
+    CHECK(maxSpread > 0.01f);
+    CHECK(maxError < 1e-5f);
+}
+
+TEST_CASE(LightProbeGrid, PositionsOutsideUseTheBorder)
+{
+    LightProbeGrid grid;
+    CHECK(BakeScene(grid, nullptr));
+    const XMFLOAT3 outside[] = { XMFLOAT3(-10.0f, 1.3f, 2.2f), XMFLOAT3(1.7f, 9.0f, -0.4f), XMFLOAT3(6.0f, -5.0f, 40.0f) };
+    const XMFLOAT3 border[] = { XMFLOAT3(-4.0f, 1.3f, 2.2f), XMFLOAT3(1.7f, 3.0f, -0.4f), XMFLOAT3(4.0f, -1.0f, 4.0f) };
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        std::vector<XMFLOAT4> a = Interpolate(grid, outside[i]);
+        std::vector<XMFLOAT4> b = Interpolate(grid, border[i]);
+        CHECK(MaxDifference(a.data(), b.data(), Coefficients) < 1e-6f);
+    }
+}
+
+// Batches of four with a partial last one, one position at a time and the pool all agree
+TEST_CASE(LightProbeGrid, BatchesAndThreadsAgree)
+{
+    ThreadPool pool(3);
+    LightProbeGrid grid;
+    CHECK(BakeScene(grid, &pool));
+
+    std::vector<XMFLOAT3> positions = RandomPositions(10001, 77);
+    std::vector<XMFLOAT4> batched(positions.size() * Coefficients);
+    std::vector<XMFLOAT4> parallel(positions.size() * Coefficients);
+    grid.Interpolate(positions.data(), static_cast<uint32_t>(positions.size()), batched.data());
+    grid.InterpolateParallel(positions.data(), static_cast<uint32_t>(positions.size()), parallel.data());
+    CHECK(MaxDifference(parallel.data(), batched.data(), static_cast<uint32_t>(batched.size())) == 0.0f);
+
+    float maxError = 0.0f;
+    for (size_t i = 0; i < positions.size(); i += 97)
+    {
+        std::vector<XMFLOAT4> single = Interpolate(grid, positions[i]);
+        maxError = std::max(maxError, MaxDifference(single.data(), &batched[i * Coefficients], Coefficients));
+    }
+    maxError = std::max(maxError, MaxDifference(Interpolate(grid, positions.back()).data(), &batched[(positions.size() - 1) * Coefficients],
+        Coefficients));
+    CHECK(maxError == 0.0f);
+}
@@ -0,0 +1,103 @@
+#include "Test.h"
+#include "MipFeedback.h"
+#include <cfloat>
+#include <cmath>
+
+namespace
+{
+    const float NearZ = 0.1f;
+    const float FarZ = 100.0f;
+
+    XMFLOAT4X4 Identity()
+    {
+        XMFLOAT4X4 m = {};
+        m._11 = m._22 = m._33 = m._44 = 1.0f;
+        return m;
+    }
+
+    // XMMatrixPerspectiveFovLH with a 90 degree vertical field of view and a square viewport
+    XMFLOAT4X4 Projection()
+    {
+        XMFLOAT4X4 m = {};
+        m._11 = 1.0f;
+        m._22 = 1.0f;
+        m._33 = FarZ / (FarZ - NearZ);
+        m._34 = 1.0f;
+        m._43 = -NearZ * FarZ / (FarZ - NearZ);
+        return m;
+    }
+
+    MipFeedbackInstance Instance(float x, float y, float z, float radius, float uvDensity, uint32_t key)
+    {
+        MipFeedbackInstance instance;
+        instance.center = XMFLOAT3(x, y, z);
+        instance.radius = radius;
+        instance.uvDensity = uvDensity;
+        instance.key = key;
+        return instance;
+    }
+}
+
+TEST_CASE(MipFeedback, RequiredMipFollowsTheTexelsPerPixel)
+{
+    // 1024 texels: one texel per pixel and finer keep mip 0, every doubling drops a mip
+    CHECK(MipFeedback::RequiredMip(1.0f / 2048.0f, 1024, 1024, 11) == 0);
+    CHECK(MipFeedback::RequiredMip(1.0f / 1024.0f, 1024, 1024, 11) == 0);
+    CHECK(MipFeedback::RequiredMip(1.99f / 1024.0f, 1024, 1024, 11) == 0);
+    CHECK(MipFeedback::RequiredMip(2.0f / 1024.0f, 1024, 1024, 11) == 1);
+    CHECK(MipFeedback::RequiredMip(5.0f / 1024.0f, 1024, 1024, 11) == 2);
+    CHECK(MipFeedback::RequiredMip(0.5f, 1024, 1024, 11) == 9);
+    // The larger side decides, the chain end clamps, nothing visible needs no mip at all
+    CHECK(MipFeedback::RequiredMip(4.0f / 1024.0f, 256, 1024, 11) == 2);
+    CHECK(MipFeedback::RequiredMip(100.0f, 1024, 1024, 11) == 10);
+    CHECK(MipFeedback::RequiredMip(FLT_MAX, 1024, 1024, 11) == 11);
+}
+
+TEST_CASE(MipFeedback, KeysKeepTheirFinestInstance)
+{
+    MipFeedback feedback;
+    feedback.SetCamera(Identity(), Projection(), 1000.0f);
+
+    // Nearer means more pixels per texture coordinate unit, so a smaller step per pixel
+    MipFeedbackInstance instances[] =
+    {
+        Instance(0.0f, 0.0f, 20.0f, 1.0f, 0.5f, 0),
+        Instance(0.0f, 0.0f, 5.0f, 1.0f, 0.5f, 0),
+        Instance(0.0f, 0.0f, 10.0f, 1.0f, 0.5f, 1),
+        Instance(0.0f, 0.0f, -10.0f, 1.0f, 0.5f, 2),   // behind the camera
+        Instance(0.0f, 0.0f, 10.0f, 1.0f, 0.5f, 7),    // key out of range
+    };
+    feedback.Build(instances, 5, 4);
+
+    float key0 = feedback.GetUvPerPixel(0);
+    float key1 = feedback.GetUvPerPixel(1);
+    CHECK(key0 < key1);
+    CHECK(key1 < FLT_MAX);
+    CHECK(feedback.GetUvPerPixel(2) == FLT_MAX);
+    CHECK(feedback.GetUvPerPixel(3) == FLT_MAX);
+    CHECK(feedback.GetUvPerPixel(7) == FLT_MAX);
+    CHECK(feedback.GetStats().instanceCount == 5);
+    CHECK(feedback.GetStats().keyCount == 4);
+    CHECK(feedback.GetStats().visibleKeys == 2);
+
+    // Straight ahead at depth 5 - 1: 0.5 units per world unit over 500 pixels per unit at depth 1,
+    // stretched by the largest angle the sphere reaches off the axis
+    float tanAngle = 1.0f / 4.0f;
+    float expected = 0.5f * 4.0f / (500.0f * std::sqrt(1.0f + 2.0f * tanAngle * tanAngle));
+    CHECK(std::fabs(key0 - expected) < 1e-6f);
+}
+
+// The estimate from the bounding sphere is never coarser than what exact derivatives of the
+// visible faces of randomly turned cubes ask for, and the SIMD path agrees with the scalar one
+TEST_CASE(MipFeedback, EstimateIsNeverCoarserThanTheDerivatives)
+{
+    MipFeedbackValidationResult result = MipFeedback::Validate(200, 64, 1024, 1027);
+    CHECK(result.scenes == 200);
+    CHECK(result.instances > 10000);
+    CHECK(result.samples > result.instances);
+    CHECK(result.coarser == 0);
+    CHECK(result.exact > 0);
+    CHECK(result.meanExcess < 1.0);
+    CHECK(result.timingInstances == 1027);
+    CHECK(result.mismatches == 0);
+}
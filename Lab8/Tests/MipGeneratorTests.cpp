@@ -0,0 +1,228 @@
+#include "Test.h"
+#include "MipGenerator.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+    CookImage Image(uint32_t width, uint32_t height, uint32_t texel)
+    {
+        CookImage image = { width, height, std::vector<uint32_t>(static_cast<size_t>(width) * height, texel) };
+        return image;
+    }
+
+    CookImage Noise(uint32_t width, uint32_t height, uint32_t seed)
+    {
+        CookImage image = Image(width, height, 0);
+        for (uint32_t& texel : image.texels)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            texel = seed;
+        }
+        return image;
+    }
+
+    // Unit normals of random bumps, RGBA8 like cube_normal.dds
+    CookImage Normals(uint32_t size, uint32_t seed)
+    {
+        CookImage image = Image(size, size, 0);
+        for (uint32_t& texel : image.texels)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            float x = ((seed >> 8) & 0xFF) / 255.0f - 0.5f;
+            float y = ((seed >> 16) & 0xFF) / 255.0f - 0.5f;
+            float invLength = 1.0f / std::sqrt(x * x + y * y + 1.0f);
+            float normal[3] = { x * invLength, y * invLength, invLength };
+            texel = 0xFF000000u;
+            for (uint32_t c = 0; c < 3; c++)
+                texel |= static_cast<uint32_t>(std::lround(normal[c] * 127.5f + 127.5f)) << (c * 8);
+        }
+        return image;
+    }
+
+    MipGenerateSettings Settings(MipFilter filter, bool srgb = false, bool normalMap = false)
+    {
+        MipGenerateSettings settings = { filter, srgb, normalMap, true };
+        return settings;
+    }
+
+    uint32_t Channel(uint32_t texel, uint32_t channel)
+    {
+        return (texel >> (channel * 8)) & 0xFF;
+    }
+
+    // Mips whose size is not the one above halved and clamped to 1, or whose texels do not fit it
+    uint32_t WrongMips(const std::vector<CookImage>& chain, uint32_t width, uint32_t height)
+    {
+        uint32_t wrong = 0;
+        for (size_t mip = 0; mip < chain.size(); mip++)
+        {
+            uint32_t mipWidth = std::max(width >> mip, 1u);
+            uint32_t mipHeight = std::max(height >> mip, 1u);
+            if (chain[mip].width != mipWidth || chain[mip].height != mipHeight ||
+                chain[mip].texels.size() != static_cast<size_t>(mipWidth) * mipHeight)
+            {
+                wrong++;
+            }
+        }
+        return wrong;
+    }
+}
+
+TEST_CASE(MipGenerator, ChainHalvesEveryMipDownToOneTexel)
+{
+    MipGenerator generator;
+    std::vector<std::vector<CookImage>> chains;
+    std::vector<CookImage> tops = { Noise(64, 16, 1), Noise(64, 16, 2) };
+    CHECK(generator.Generate(tops, false, Settings(MipFilter::Box), chains));
+    CHECK(chains.size() == 2);
+    for (const std::vector<CookImage>& chain : chains)
+    {
+        CHECK(chain.size() == 7);
+        CHECK(WrongMips(chain, 64, 16) == 0);
+    }
+    // The top mip is passed through as it is
+    CHECK(chains[1][0].texels == tops[1].texels);
+    CHECK(generator.GetStats().slices == 2);
+    CHECK(generator.GetStats().mips == 7);
+    CHECK(generator.GetStats().texels == 2 * (32 * 8 + 16 * 4 + 8 * 2 + 4 + 2 + 1));
+
+    // Sizes that are not powers of two round down
+    std::vector<CookImage> odd = { Noise(5, 3, 3) };
+    CHECK(generator.Generate(odd, false, Settings(MipFilter::Kaiser), chains));
+    CHECK(chains.size() == 1);
+    CHECK(chains[0].size() == 3);
+    CHECK(WrongMips(chains[0], 5, 3) == 0);
+}
+
+TEST_CASE(MipGenerator, CubeFacesGetFullChains)
+{
+    MipGenerator generator;
+    std::vector<std::vector<CookImage>> chains;
+    std::vector<CookImage> faces;
+    for (uint32_t face = 0; face < 12; face++)
+        faces.push_back(Noise(16, 16, face));
+    CHECK(generator.Generate(faces, true, Settings(MipFilter::Lanczos), chains));
+    CHECK(chains.size() == 12);
+    uint32_t wrong = 0;
+    for (const std::vector<CookImage>& chain : chains)
+        wrong += chain.size() == 5 ? WrongMips(chain, 16, 16) : 1;
+    CHECK(wrong == 0);
+}
+
+TEST_CASE(MipGenerator, MismatchedTopsAreRejected)
+{
+    MipGenerator generator;
+    std::vector<std::vector<CookImage>> chains;
+    CHECK(!generator.Generate(std::vector<CookImage>(), false, Settings(MipFilter::Box), chains));
+    CHECK(!generator.Generate({ Image(0, 4, 0) }, false, Settings(MipFilter::Box), chains));
+    CHECK(!generator.Generate({ Image(16, 16, 0), Image(16, 8, 0) }, false, Settings(MipFilter::Box), chains));
+
+    CookImage truncated = Image(16, 16, 0);
+    truncated.texels.pop_back();
+    CHECK(!generator.Generate({ truncated }, false, Settings(MipFilter::Box), chains));
+
+    // Cubes need whole sets of six square faces
+    CHECK(!generator.Generate(std::vector<CookImage>(5, Image(16, 16, 0)), true, Settings(MipFilter::Box), chains));
+    CHECK(!generator.Generate(std::vector<CookImage>(6, Image(16, 8, 0)), true, Settings(MipFilter::Box), chains));
+}
+
+// The filters are normalized: a flat colour stays flat in every mip, with and without sRGB
+TEST_CASE(MipGenerator, FlatColourStaysFlat)
+{
+    const uint32_t colour = 0x80C04020u;
+    const MipFilter filters[] = { MipFilter::Box, MipFilter::Kaiser, MipFilter::Lanczos };
+    uint32_t wrong = 0;
+    for (MipFilter filter : filters)
+    {
+        for (uint32_t srgb = 0; srgb < 2; srgb++)
+        {
+            MipGenerator generator;
+            std::vector<std::vector<CookImage>> chains;
+            CHECK(generator.Generate({ Image(32, 32, colour) }, false, Settings(filter, srgb != 0), chains));
+            for (const CookImage& image : chains[0])
+            {
+                for (uint32_t texel : image.texels)
+                {
+                    for (uint32_t c = 0; c < 4; c++)
+                    {
+                        int difference = static_cast<int>(Channel(texel, c)) - static_cast<int>(Channel(colour, c));
+                        wrong += std::abs(difference) > 1 ? 1 : 0;
+                    }
+                }
+            }
+        }
+    }
+    CHECK(wrong == 0);
+}
+
+// Black and white average to half the light: 188 in sRGB, 128 without it. Alpha is always linear.
+TEST_CASE(MipGenerator, SrgbIsFilteredInLinearLight)
+{
+    CookImage checker = Image(2, 2, 0xFFFFFFFFu);
+    checker.texels[0] = 0x00000000u;
+    checker.texels[3] = 0x00000000u;
+
+    MipGenerator generator;
+    std::vector<std::vector<CookImage>> chains;
+    CHECK(generator.Generate({ checker }, false, Settings(MipFilter::Box, true), chains));
+    uint32_t srgb = chains[0][1].texels[0];
+    CHECK(std::abs(static_cast<int>(Channel(srgb, 0)) - 188) <= 1);
+    CHECK(Channel(srgb, 0) == Channel(srgb, 1) && Channel(srgb, 1) == Channel(srgb, 2));
+    CHECK(std::abs(static_cast<int>(Channel(srgb, 3)) - 128) <= 1);
+
+    CHECK(generator.Generate({ checker }, false, Settings(MipFilter::Box, false), chains));
+    uint32_t linear = chains[0][1].texels[0];
+    CHECK(std::abs(static_cast<int>(Channel(linear, 0)) - 128) <= 1);
+}
+
+TEST_CASE(MipGenerator, NormalMapMipsStayUnitLength)
+{
+    MipGenerator generator;
+    std::vector<std::vector<CookImage>> chains;
+    CHECK(generator.Generate({ Normals(64, 5) }, false, Settings(MipFilter::Kaiser, false, true), chains));
+    float maxError = 0.0f;
+    for (size_t mip = 1; mip < chains[0].size(); mip++)
+    {
+        for (uint32_t texel : chains[0][mip].texels)
+        {
+            float length = 0.0f;
+            for (uint32_t c = 0; c < 3; c++)
+            {
+                float component = Channel(texel, c) * (2.0f / 255.0f) - 1.0f;
+                length += component * component;
+            }
+            maxError = std::max(maxError, std::fabs(std::sqrt(length) - 1.0f));
+        }
+    }
+    // One 8 bit step on every component
+    CHECK(maxError < 0.02f);
+}
+
+TEST_CASE(MipGenerator, OutputDoesNotDependOnTheThreadCount)
+{
+    std::vector<CookImage> faces;
+    for (uint32_t face = 0; face < 6; face++)
+        faces.push_back(Noise(64, 64, face + 10));
+
+    MipGenerator serial;
+    std::vector<std::vector<CookImage>> serialChains;
+    CHECK(serial.Generate(faces, true, Settings(MipFilter::Kaiser, true), serialChains));
+
+    ThreadPool pool(3);
+    MipGenerator parallel;
+    parallel.SetThreadPool(&pool);
+    std::vector<std::vector<CookImage>> parallelChains;
+    CHECK(parallel.Generate(faces, true, Settings(MipFilter::Kaiser, true), parallelChains));
+
+    uint32_t mismatches = 0;
+    for (size_t slice = 0; slice < serialChains.size(); slice++)
+    {
+        for (size_t mip = 0; mip < serialChains[slice].size(); mip++)
+            mismatches += parallelChains[slice][mip].texels == serialChains[slice][mip].texels ? 0 : 1;
+    }
+    CHECK(parallelChains.size() == serialChains.size());
+    CHECK(mismatches == 0);
+}
@@ -0,0 +1,149 @@
+#include "Test.h"
+#include "Profiler.h"
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    const char* const DepthNames[] = { "Depth0", "Depth1", "Depth2", "Depth3", "Depth4", "Depth5", "Depth6" };
+    const uint32_t DepthNameCount = 7;
+
+    size_t CountNamed(const std::vector<ProfileEvent>& events, const char* name)
+    {
+        size_t count = 0;
+        for (const auto& event : events)
+        {
+            if (strcmp(event.name, name) == 0)
+                count++;
+        }
+        return count;
+    }
+}
+
+// Runs first in the suite: nothing has touched the singleton yet
+TEST_CASE(Profiler, StartsDisabled)
+{
+    CHECK(!Profiler::Get().IsEnabled());
+
+    uint64_t start = Profiler::NowNs();
+    {
+        PROFILE_SCOPE("Disabled Scope");
+    }
+    std::vector<ProfileEvent> events;
+    Profiler::Get().Collect(events, start, UINT64_MAX);
+    CHECK(CountNamed(events, "Disabled Scope") == 0);
+}
+
+TEST_CASE(Profiler, NestedScopesKeepTheirDepth)
+{
+    Profiler::Get().SetEnabled(true);
+    uint64_t start = Profiler::NowNs();
+    {
+        PROFILE_SCOPE("Outer");
+        {
+            PROFILE_SCOPE("Inner");
+        }
+    }
+    uint64_t end = Profiler::NowNs();
+    Profiler::Get().SetEnabled(false);
+
+    std::vector<ProfileEvent> events;
+    Profiler::Get().Collect(events, start, end);
+    CHECK(events.size() == 2);
+    if (events.size() == 2)
+    {
+        // Sorted by start time, so the outer scope comes first
+        CHECK(strcmp(events[0].name, "Outer") == 0);
+        CHECK(events[0].depth == 0);
+        CHECK(strcmp(events[1].name, "Inner") == 0);
+        CHECK(events[1].depth == 1);
+        CHECK(events[1].startNs >= events[0].startNs);
+        CHECK(events[1].endNs <= events[0].endNs);
+    }
+}
+
+TEST_CASE(Profiler, CollectKeepsOnlyTheRequestedWindow)
+{
+    Profiler::Get().SetEnabled(true);
+    {
+        PROFILE_SCOPE("Before");
+    }
+    uint64_t start = Profiler::NowNs();
+    {
+        PROFILE_SCOPE("Inside");
+    }
+    uint64_t end = Profiler::NowNs();
+    Profiler::Get().SetEnabled(false);
+
+    std::vector<ProfileEvent> events;
+    Profiler::Get().Collect(events, start, end);
+    CHECK(CountNamed(events, "Inside") == 1);
+    CHECK(CountNamed(events, "Before") == 0);
+}
+
+// Writers lap their rings many times while the reader collects: every event handed out
+// must be one complete write, never fields of two different writes
+TEST_CASE(Profiler, CollectNeverReturnsTornEvents)
+{
+    Profiler::Get().SetEnabled(true);
+
+    const uint32_t writerCount = 3;
+    std::atomic<bool> stop(false);
+    std::atomic<uint32_t> lapped(0);
+    std::vector<std::thread> writers;
+    for (uint32_t w = 0; w < writerCount; w++)
+    {
+        writers.emplace_back([&stop, &lapped]()
+        {
+            uint64_t i = 0;
+            while (!stop.load(std::memory_order_relaxed))
+            {
+                uint32_t depth = static_cast<uint32_t>(i % DepthNameCount);
+                Profiler::Get().PopScope(DepthNames[depth], i * DepthNameCount + depth, depth);
+                if (++i == Profiler::RingCapacity)
+                    lapped++;
+            }
+        });
+    }
+
+    while (lapped.load() < writerCount)
+        std::this_thread::yield();
+
+    uint64_t checked = 0;
+    uint32_t torn = 0;
+    std::vector<ProfileEvent> events;
+    for (int pass = 0; pass < 20; pass++)
+    {
+        events.clear();
+        Profiler::Get().Collect(events, 0, UINT64_MAX);
+        for (const auto& event : events)
+        {
+            if (event.depth >= DepthNameCount || strncmp(event.name, "Depth", 5) != 0)
+                continue;
+            checked++;
+            if (event.name != DepthNames[event.depth] || event.startNs % DepthNameCount != event.depth)
+                torn++;
+        }
+    }
+
+    stop.store(true);
+    for (auto& writer : writers)
+        writer.join();
+    Profiler::Get().SetEnabled(false);
+
+    CHECK(checked > 0);
+    CHECK(torn == 0);
+}
+
+TEST_CASE(Profiler, BenchmarkRestoresTheEnabledState)
+{
+    Profiler::Get().SetEnabled(false);
+    ProfilerBenchmarkResult result = Profiler::Benchmark(10000);
+    CHECK(!Profiler::Get().IsEnabled());
+    CHECK(result.scopes == 10000);
+    CHECK(result.enabledNs > 0.0);
+    // A disabled scope skips the clock and the ring entirely
+    CHECK(result.disabledNs < result.enabledNs);
+}
@@ -0,0 +1,175 @@
+#include "Test.h"
+#include "RenderGraph.h"
+#include <string>
+
+namespace
+{
+    const RenderGraph::TextureDesc FullScreen = { 1280, 720, 28 };  // DXGI_FORMAT_R8G8B8A8_UNORM
+    const RenderGraph::TextureDesc HalfScreen = { 640, 360, 28 };
+}
+
+// The Lab8 frame with the negative effect off: everything lands in the back buffer
+TEST_CASE(RenderGraph, FrameWithoutPostEffectNeedsNoTransients)
+{
+    RenderGraph graph;
+    std::string executed;
+    RenderGraph::ResourceHandle backBuffer = graph.ImportTexture("BackBuffer");
+    RenderGraph::ResourceHandle atlas = graph.ImportTexture("ShadowAtlas");
+    RenderGraph::PassHandle shadows = graph.AddPass("Shadows", [&executed]() { executed += "S"; });
+    graph.Write(shadows, atlas);
+    RenderGraph::PassHandle scene = graph.AddPass("Scene", [&executed]() { executed += "C"; });
+    graph.Read(scene, atlas);
+    graph.Write(scene, backBuffer);
+    RenderGraph::PassHandle ui = graph.AddPass("ImGui", [&executed]() { executed += "U"; });
+    graph.Write(ui, backBuffer);
+
+    CHECK(graph.Compile());
+    CHECK(graph.GetPhysicalCount() == 0);
+    CHECK(graph.GetExecutedPassCount() == 3);
+    graph.Execute();
+    CHECK(executed == "SCU");
+}
+
+TEST_CASE(RenderGraph, PostEffectGetsOneTransient)
+{
+    RenderGraph graph;
+    RenderGraph::ResourceHandle backBuffer = graph.ImportTexture("BackBuffer");
+    RenderGraph::ResourceHandle sceneColor = graph.CreateTexture("SceneColor", FullScreen);
+    RenderGraph::PassHandle scene = graph.AddPass("Scene", nullptr);
+    graph.Write(scene, sceneColor);
+    RenderGraph::PassHandle negative = graph.AddPass("Negative", nullptr);
+    graph.Read(negative, sceneColor);
+    graph.Write(negative, backBuffer);
+
+    CHECK(graph.Compile());
+    CHECK(graph.GetPhysicalCount() == 1);
+    CHECK(graph.GetPhysicalIndex(sceneColor) == 0);
+    CHECK(graph.GetPhysicalIndex(backBuffer) == RenderGraph::Invalid);
+    CHECK(graph.GetPhysicalDesc(0) == FullScreen);
+}
+
+TEST_CASE(RenderGraph, TransientsThatNeverOverlapShareSlots)
+{
+    // A -> t0 -> B -> t1 -> C -> t2 -> D -> back buffer: t0 is dead once B ran, so t2 takes its slot
+    RenderGraph graph;
+    RenderGraph::ResourceHandle backBuffer = graph.ImportTexture("BackBuffer");
+    RenderGraph::ResourceHandle t0 = graph.CreateTexture("T0", FullScreen);
+    RenderGraph::ResourceHandle t1 = graph.CreateTexture("T1", FullScreen);
+    RenderGraph::ResourceHandle t2 = graph.CreateTexture("T2", FullScreen);
+    RenderGraph::PassHandle a = graph.AddPass("A", nullptr);
+    graph.Write(a, t0);
+    RenderGraph::PassHandle b = graph.AddPass("B", nullptr);
+    graph.Read(b, t0);
+    graph.Write(b, t1);
+    RenderGraph::PassHandle c = graph.AddPass("C", nullptr);
+    graph.Read(c, t1);
+    graph.Write(c, t2);
+    RenderGraph::PassHandle d = graph.AddPass("D", nullptr);
+    graph.Read(d, t2);
+    graph.Write(d, backBuffer);
+
+    CHECK(graph.Compile());
+    CHECK(graph.GetPhysicalCount() == 2);
+    CHECK(graph.GetPhysicalIndex(t0) == 0);
+    CHECK(graph.GetPhysicalIndex(t1) == 1);
+    CHECK(graph.GetPhysicalIndex(t2) == 0);
+}
+
+TEST_CASE(RenderGraph, OverlappingOrDifferentTransientsDoNotAlias)
+{
+    RenderGraph graph;
+    RenderGraph::ResourceHandle backBuffer = graph.ImportTexture("BackBuffer");
+    RenderGraph::ResourceHandle color = graph.CreateTexture("Color", FullScreen);
+    RenderGraph::ResourceHandle bloom = graph.CreateTexture("Bloom", HalfScreen);
+    RenderGraph::ResourceHandle blur = graph.CreateTexture("Blur", HalfScreen);
+    RenderGraph::PassHandle scene = graph.AddPass("Scene", nullptr);
+    graph.Write(scene, color);
+    RenderGraph::PassHandle bright = graph.AddPass("Bright", nullptr);
+    graph.Read(bright, color);
+    graph.Write(bright, bloom);
+    RenderGraph::PassHandle blurPass = graph.AddPass("Blur", nullptr);
+    graph.Read(blurPass, bloom);
+    graph.Write(blurPass, blur);
+    // Color stays alive until the composite, bloom dies after the blur
+    RenderGraph::PassHandle composite = graph.AddPass("Composite", nullptr);
+    graph.Read(composite, color);
+    graph.Read(composite, blur);
+    graph.Write(composite, backBuffer);
+
+    CHECK(graph.Compile());
+    CHECK(graph.GetPhysicalCount() == 3);
+    CHECK(graph.GetPhysicalIndex(color) != graph.GetPhysicalIndex(bloom));
+    CHECK(graph.GetPhysicalIndex(bloom) != graph.GetPhysicalIndex(blur));
+    CHECK(graph.GetPhysicalIndex(color) != graph.GetPhysicalIndex(blur));
+    CHECK(graph.GetPhysicalDesc(graph.GetPhysicalIndex(color)) == FullScreen);
+    CHECK(graph.GetPhysicalDesc(graph.GetPhysicalIndex(blur)) == HalfScreen);
+}
+
+TEST_CASE(RenderGraph, PassesWithoutConsumersAreCulled)
+{
+    RenderGraph graph;
+    int debugRuns = 0;
+    int feederRuns = 0;
+    int sceneRuns = 0;
+    RenderGraph::ResourceHandle backBuffer = graph.ImportTexture("BackBuffer");
+    RenderGraph::ResourceHandle depth = graph.CreateTexture("Depth", FullScreen);
+    RenderGraph::ResourceHandle debugView = graph.CreateTexture("DebugView", FullScreen);
+    // Feeder only writes what the unused debug pass reads, so it goes with it
+    RenderGraph::PassHandle feeder = graph.AddPass("Depth Prepass", [&feederRuns]() { feederRuns++; });
+    graph.Write(feeder, depth);
+    RenderGraph::PassHandle debug = graph.AddPass("Depth Debug", [&debugRuns]() { debugRuns++; });
+    graph.Read(debug, depth);
+    graph.Write(debug, debugView);
+    RenderGraph::PassHandle scene = graph.AddPass("Scene", [&sceneRuns]() { sceneRuns++; });
+    graph.Write(scene, backBuffer);
+
+    CHECK(graph.Compile());
+    CHECK(graph.IsPassCulled(feeder));
+    CHECK(graph.IsPassCulled(debug));
+    CHECK(!graph.IsPassCulled(scene));
+    CHECK(graph.GetExecutedPassCount() == 1);
+    CHECK(graph.GetPhysicalCount() == 0);
+    CHECK(graph.GetPhysicalIndex(depth) == RenderGraph::Invalid);
+
+    graph.Execute();
+    CHECK(feederRuns == 0);
+    CHECK(debugRuns == 0);
+    CHECK(sceneRuns == 1);
+}
+
+TEST_CASE(RenderGraph, ReadBeforeWriteFailsToCompile)
+{
+    RenderGraph graph;
+    RenderGraph::ResourceHandle backBuffer = graph.ImportTexture("BackBuffer");
+    RenderGraph::ResourceHandle color = graph.CreateTexture("SceneColor", FullScreen);
+    RenderGraph::PassHandle negative = graph.AddPass("Negative", nullptr);
+    graph.Read(negative, color);
+    graph.Write(negative, backBuffer);
+    RenderGraph::PassHandle scene = graph.AddPass("Scene", nullptr);
+    graph.Write(scene, color);
+
+    CHECK(!graph.Compile());
+    CHECK(graph.GetError().find("SceneColor") != std::string::npos);
+}
+
+TEST_CASE(RenderGraph, ResetClearsThePreviousFrame)
+{
+    RenderGraph graph;
+    RenderGraph::ResourceHandle backBuffer = graph.ImportTexture("BackBuffer");
+    RenderGraph::ResourceHandle color = graph.CreateTexture("SceneColor", FullScreen);
+    RenderGraph::PassHandle scene = graph.AddPass("Scene", nullptr);
+    graph.Write(scene, color);
+    RenderGraph::PassHandle negative = graph.AddPass("Negative", nullptr);
+    graph.Read(negative, color);
+    graph.Write(negative, backBuffer);
+    CHECK(graph.Compile());
+    CHECK(graph.GetPhysicalCount() == 1);
+
+    graph.Reset();
+    backBuffer = graph.ImportTexture("BackBuffer");
+    scene = graph.AddPass("Scene", nullptr);
+    graph.Write(scene, backBuffer);
+    CHECK(graph.Compile());
+    CHECK(graph.GetPassCount() == 1);
+    CHECK(graph.GetPhysicalCount() == 0);
+}
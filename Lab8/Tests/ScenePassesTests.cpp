@@ -0,0 +1,188 @@
+#include "Test.h"
+#include "NullRenderBackend.h"
+#include "ScenePasses.h"
+#include <cstring>
+
+namespace
+{
+    const uint32_t MaxInstances = 8;
+
+    // Cube pass resources as RenderClass creates them, culled on the CPU unless gpu is set
+    struct CubeScene
+    {
+        NullRenderBackend backend;
+        FrameManager frames;
+        CubePass pass;
+        BackendHandle pipeline;
+
+        explicit CubeScene(bool gpu)
+        {
+            CubePassResources resources = {};
+            resources.vertexBuffer = Create(BufferKind::Vertex, 24 * 32, false);
+            resources.indexBuffer = Create(BufferKind::Index, 36 * 2, false);
+            resources.vertexStride = 32;
+            resources.indexCount = 36;
+            resources.instanceBuffer = Create(BufferKind::Constant, sizeof(CubeInstanceData) * MaxInstances, false);
+            resources.cameraBuffer = Create(BufferKind::Constant, sizeof(XMFLOAT4X4) * 2, false);
+            resources.cullPipeline = gpu ? backend.RegisterPipeline("Culling") : InvalidBackendHandle;
+            resources.frustumBuffer = Create(BufferKind::Constant, sizeof(XMFLOAT4) * 6, true);
+            resources.cullInstanceBuffer = Create(BufferKind::Structured, sizeof(CubeInstanceData) * MaxInstances, true, sizeof(CubeInstanceData));
+            resources.argumentsBuffer = Create(BufferKind::Arguments, sizeof(uint32_t) * 5, false);
+            resources.visibleIdsBuffer = Create(BufferKind::Structured, sizeof(uint32_t) * MaxInstances, false, sizeof(uint32_t));
+            for (uint32_t i = 0; i < FrameManager::MaxFramesInFlight; i++)
+            {
+                resources.argumentsReadback[i] = Create(BufferKind::Readback, sizeof(uint32_t) * 5, false);
+                resources.idsReadback[i] = Create(BufferKind::Readback, sizeof(uint32_t) * MaxInstances, false);
+            }
+            pass.SetResources(resources);
+            pipeline = backend.RegisterPipeline("Cube");
+        }
+
+        BackendHandle Create(BufferKind kind, uint32_t size, bool dynamic, uint32_t stride = 0)
+        {
+            BufferDesc desc = { kind, size, dynamic, stride };
+            return backend.CreateBuffer(desc, nullptr);
+        }
+
+        // Cubes along x, the planes keep x in [-1, 1] and nothing else
+        void Upload(uint32_t count)
+        {
+            std::vector<CubeInstanceData> instances(count);
+            for (uint32_t i = 0; i < count; i++)
+            {
+                CubeInstanceData& instance = instances[i];
+                memset(&instance, 0, sizeof(instance));
+                instance.model._11 = instance.model._22 = instance.model._33 = instance.model._44 = 1.0f;
+                instance.model._41 = static_cast<float>(i) * 2.0f - 2.0f;
+            }
+            pass.Upload(backend, instances.data(), count, MaxInstances);
+        }
+
+        void Cull()
+        {
+            XMFLOAT4 planes[6] = {
+                { 1.0f, 0.0f, 0.0f, 1.0f }, { -1.0f, 0.0f, 0.0f, 1.0f },
+                { 0.0f, 1.0f, 0.0f, 100.0f }, { 0.0f, -1.0f, 0.0f, 100.0f },
+                { 0.0f, 0.0f, 1.0f, 100.0f }, { 0.0f, 0.0f, -1.0f, 100.0f } };
+            pass.Cull(backend, planes, 0.5f);
+        }
+
+        // What ComputeShader.cs writes for the visible ids
+        void WriteCullResult(const std::vector<uint32_t>& ids)
+        {
+            uint32_t count = static_cast<uint32_t>(ids.size());
+            backend.WriteBuffer(pass.GetResources().argumentsBuffer, sizeof(uint32_t), &count, sizeof(count));
+            if (count > 0)
+                backend.WriteBuffer(pass.GetResources().visibleIdsBuffer, 0, ids.data(), static_cast<uint32_t>(sizeof(uint32_t) * count));
+        }
+
+        const NullRenderBackend::Command* FindLast(NullRenderBackend::CommandType type) const
+        {
+            const auto& commands = backend.GetCommands();
+            for (size_t i = commands.size(); i-- > 0;)
+            {
+                if (commands[i].type == type)
+                    return &commands[i];
+            }
+            return nullptr;
+        }
+    };
+}
+
+TEST_CASE(ScenePasses, IndirectDrawUsesTheCulledInstanceCount)
+{
+    CubeScene scene(true);
+    scene.backend.SetRecording(true);
+    scene.frames.BeginFrame();
+    scene.Upload(4);
+    scene.Cull();
+    scene.WriteCullResult({ 1 });
+    scene.pass.Readback(scene.backend, scene.frames);
+    scene.pass.Draw(scene.backend, scene.pipeline);
+    scene.frames.EndFrame();
+
+    const NullRenderBackend::Command* pDraw = scene.FindLast(NullRenderBackend::CommandType::DrawIndexedInstancedIndirect);
+    CHECK(pDraw != nullptr);
+    CHECK(scene.FindLast(NullRenderBackend::CommandType::Dispatch) != nullptr);
+    // Four cubes uploaded, one survived: the draw takes its count from the arguments buffer
+    CHECK(scene.backend.GetStats().instances == 1);
+    CHECK(scene.backend.GetErrorCount() == 0);
+}
+
+TEST_CASE(ScenePasses, CpuCullingKeepsTheCubesInsideThePlanes)
+{
+    CubeScene scene(false);
+    scene.Upload(4);
+    scene.Cull();
+    // x = -2, 0, 2, 4 with radius 0.5 against |x| <= 1
+    CHECK(scene.pass.GetVisibleIds() == std::vector<uint32_t>({ 1 }));
+
+    const uint32_t* pIds = reinterpret_cast<const uint32_t*>(scene.backend.GetBufferData(scene.pass.GetResources().visibleIdsBuffer));
+    CHECK(pIds != nullptr && pIds[0] == 1);
+    CHECK(scene.backend.GetErrorCount() == 0);
+}
+
+TEST_CASE(ScenePasses, UnbindingWithTheInvalidHandleIsAccepted)
+{
+    CubeScene scene(true);
+    scene.backend.SetRecording(true);
+    scene.Upload(2);
+    scene.Cull();
+    scene.pass.Draw(scene.backend, scene.pipeline);
+
+    // Cull leaves u0, u1 and CS t0 empty, Draw leaves VS t0 empty
+    const NullRenderBackend::Command* pUnbind = scene.FindLast(NullRenderBackend::CommandType::BindStructuredBuffer);
+    CHECK(pUnbind != nullptr && pUnbind->handle == InvalidBackendHandle);
+    const NullRenderBackend::Command* pUav = scene.FindLast(NullRenderBackend::CommandType::BindUnorderedAccess);
+    CHECK(pUav != nullptr && pUav->handle == InvalidBackendHandle);
+    CHECK(scene.backend.GetErrorCount() == 0);
+}
+
+TEST_CASE(ScenePasses, ShortConstantWritesAreZeroPadded)
+{
+    CubeScene scene(false);
+    scene.Upload(3);
+    scene.Upload(1);
+
+    // The second upload covers one instance, the rest of the constant buffer is cleared
+    const uint8_t* pData = scene.backend.GetBufferData(scene.pass.GetResources().instanceBuffer);
+    CHECK(pData != nullptr);
+    if (pData)
+    {
+        const CubeInstanceData* pInstances = reinterpret_cast<const CubeInstanceData*>(pData);
+        CHECK(pInstances[0].countInstance == 1);
+        CHECK(pInstances[1].model._11 == 0.0f);
+        CHECK(pInstances[2].countInstance == 0);
+    }
+    CHECK(scene.backend.GetErrorCount() == 0);
+}
+
+TEST_CASE(ScenePasses, ReadbackReturnsTheRetiredFrameOfTheSlot)
+{
+    CubeScene scene(true);
+    scene.frames.SetFramesInFlight(2);
+
+    const std::vector<uint32_t> results[] = { { 0, 1 }, { 1 }, { 1, 2 } };
+    for (uint32_t frame = 0; frame < 3; frame++)
+    {
+        scene.frames.BeginFrame();
+        scene.Upload(4);
+        scene.Cull();
+        scene.WriteCullResult(results[frame]);
+        scene.pass.Readback(scene.backend, scene.frames);
+
+        if (frame < 2)
+        {
+            // Nothing has retired in this slot yet: every cube counts as visible
+            CHECK(scene.pass.GetVisibleIds().size() == 4);
+        }
+        else
+        {
+            // Two frames in flight: the slot was last used by frame 0
+            CHECK(scene.pass.GetVisibleIds() == results[0]);
+        }
+        scene.pass.Draw(scene.backend, scene.pipeline);
+        scene.frames.EndFrame();
+    }
+    CHECK(scene.backend.GetErrorCount() == 0);
+}
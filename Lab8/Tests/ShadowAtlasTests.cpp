@@ -0,0 +1,314 @@
+#include "Test.h"
+#include "ShadowAtlas.h"
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+namespace
+{
+    bool Overlap(const ShadowTile& a, const ShadowTile& b)
+    {
+        return a.x < b.x + b.size && b.x < a.x + a.size && a.y < b.y + b.size && b.y < a.y + a.size;
+    }
+
+    XMFLOAT4X4 Identity()
+    {
+        XMFLOAT4X4 m = {};
+        m._11 = m._22 = m._33 = m._44 = 1.0f;
+        return m;
+    }
+
+    // Camera at the origin looking down +z, the layout XMMatrixPerspectiveFovLH produces
+    XMFLOAT4X4 Projection()
+    {
+        const float nearZ = 0.1f;
+        const float farZ = 100.0f;
+        float scale = 1.0f / std::tan(0.4f);
+        XMFLOAT4X4 m = {};
+        m._11 = scale;
+        m._22 = scale;
+        m._33 = farZ / (farZ - nearZ);
+        m._34 = 1.0f;
+        m._43 = -nearZ * farZ / (farZ - nearZ);
+        return m;
+    }
+
+    ShadowLightDesc Omni(uint32_t id, float x, float y, float z, float range)
+    {
+        ShadowLightDesc light = {};
+        light.id = id;
+        light.type = ShadowLightType::Omni;
+        light.position = { x, y, z };
+        light.range = range;
+        return light;
+    }
+
+    ShadowLightDesc Spot(uint32_t id, float x, float y, float z)
+    {
+        ShadowLightDesc light = {};
+        light.id = id;
+        light.type = ShadowLightType::Spot;
+        light.position = { x, y, z };
+        light.range = 3.0f;
+        light.direction = { 0.0f, 0.0f, 1.0f };
+        light.coneAngle = 1.0f;
+        return light;
+    }
+
+    ShadowCaster Caster(float x, float y, float z)
+    {
+        ShadowCaster caster = {};
+        caster.center = { x, y, z };
+        caster.radius = 0.5f;
+        caster.transform = Identity();
+        caster.transform._41 = x;
+        caster.transform._42 = y;
+        caster.transform._43 = z;
+        return caster;
+    }
+
+    struct CacheScene
+    {
+        ShadowCache cache;
+        XMFLOAT4X4 view;
+        XMFLOAT4X4 proj;
+        uint32_t viewportHeight;
+        std::vector<ShadowLightDesc> lights;
+        std::vector<ShadowCaster> casters;
+
+        CacheScene() : view(Identity()), proj(Projection()), viewportHeight(720) {}
+
+        void Update()
+        {
+            cache.Update(view, proj, viewportHeight, lights.data(), static_cast<uint32_t>(lights.size()),
+                casters.data(), static_cast<uint32_t>(casters.size()));
+        }
+
+        bool HasJob(uint32_t light, uint32_t face) const
+        {
+            for (const ShadowRenderJob& job : cache.GetJobs())
+            {
+                if (job.light == light && job.face == face)
+                    return true;
+            }
+            return false;
+        }
+    };
+}
+
+TEST_CASE(ShadowAtlas, AllocatorFillsTheAtlasExactly)
+{
+    ShadowAtlasAllocator allocator;
+    allocator.Init(256, 32);
+
+    std::vector<ShadowTile> tiles;
+    ShadowTile tile;
+    while (allocator.Allocate(64, tile))
+        tiles.push_back(tile);
+
+    CHECK(tiles.size() == 16);
+    CHECK(allocator.GetTileCount() == 16);
+    CHECK(allocator.GetUsedTexels() == 256u * 256u);
+    CHECK(!allocator.Allocate(32, tile));
+
+    uint32_t overlaps = 0;
+    for (size_t i = 0; i < tiles.size(); i++)
+    {
+        CHECK(tiles[i].size == 64);
+        CHECK(tiles[i].x % 64 == 0 && tiles[i].y % 64 == 0);
+        for (size_t j = i + 1; j < tiles.size(); j++)
+            overlaps += Overlap(tiles[i], tiles[j]) ? 1 : 0;
+    }
+    CHECK(overlaps == 0);
+}
+
+TEST_CASE(ShadowAtlas, AllocatorRoundsUpToPowersOfTwo)
+{
+    ShadowAtlasAllocator allocator;
+    allocator.Init(256, 32);
+
+    ShadowTile tile;
+    CHECK(allocator.Allocate(40, tile) && tile.size == 64);
+    CHECK(allocator.Allocate(10, tile) && tile.size == 32);
+    CHECK(!allocator.Allocate(512, tile));
+    CHECK(allocator.GetUsedTexels() == 64u * 64u + 32u * 32u);
+}
+
+TEST_CASE(ShadowAtlas, FreedSiblingsMergeBackIntoTheParent)
+{
+    ShadowAtlasAllocator allocator;
+    allocator.Init(256, 32);
+
+    std::vector<ShadowTile> tiles(64);
+    for (ShadowTile& tile : tiles)
+        CHECK(allocator.Allocate(32, tile));
+
+    ShadowTile whole;
+    CHECK(!allocator.Allocate(256, whole));
+    for (const ShadowTile& tile : tiles)
+        allocator.Free(tile);
+
+    CHECK(allocator.GetTileCount() == 0);
+    CHECK(allocator.GetUsedTexels() == 0);
+    CHECK(allocator.Allocate(256, whole) && whole.x == 0 && whole.y == 0 && whole.size == 256);
+}
+
+TEST_CASE(ShadowAtlas, RandomAllocationsNeverOverlap)
+{
+    ShadowAtlasAllocator allocator;
+    allocator.Init(1024, 32);
+    srand(7);
+
+    std::vector<ShadowTile> live;
+    uint32_t overlaps = 0;
+    uint64_t expectedTexels = 0;
+    for (int step = 0; step < 2000; step++)
+    {
+        if (!live.empty() && rand() % 3 == 0)
+        {
+            size_t index = static_cast<size_t>(rand()) % live.size();
+            expectedTexels -= static_cast<uint64_t>(live[index].size) * live[index].size;
+            allocator.Free(live[index]);
+            live[index] = live.back();
+            live.pop_back();
+            continue;
+        }
+
+        ShadowTile tile;
+        if (!allocator.Allocate(32u << (rand() % 4), tile))
+            continue;
+        for (const ShadowTile& other : live)
+            overlaps += Overlap(tile, other) ? 1 : 0;
+        CHECK(tile.x + tile.size <= 1024 && tile.y + tile.size <= 1024);
+        expectedTexels += static_cast<uint64_t>(tile.size) * tile.size;
+        live.push_back(tile);
+    }
+    CHECK(overlaps == 0);
+    CHECK(allocator.GetUsedTexels() == expectedTexels);
+    CHECK(allocator.GetTileCount() == live.size());
+}
+
+TEST_CASE(ShadowAtlas, StaticLightsAreDrawnOnce)
+{
+    CacheScene scene;
+    scene.lights.push_back(Omni(1, 0.0f, 0.0f, 10.0f, 5.0f));
+    scene.lights.push_back(Spot(2, 3.0f, 0.0f, 8.0f));
+    scene.casters.push_back(Caster(2.0f, 0.0f, 10.0f));
+    scene.casters.push_back(Caster(3.0f, 0.0f, 9.5f));
+
+    scene.Update();
+    CHECK(scene.cache.GetJobs().size() == 7);
+    CHECK(scene.cache.GetStats().shadowedLights == 2);
+    CHECK(scene.cache.GetShadowIndices()[0] >= 0 && scene.cache.GetShadowIndices()[1] >= 0);
+
+    scene.Update();
+    CHECK(scene.cache.GetJobs().empty());
+    CHECK(scene.cache.GetStats().facesCached == 7);
+    CHECK(scene.cache.GetStats().shadowedLights == 2);
+}
+
+TEST_CASE(ShadowAtlas, MovingCasterRedrawsOnlyTheFacesItTouches)
+{
+    CacheScene scene;
+    scene.lights.push_back(Omni(1, 0.0f, 0.0f, 10.0f, 5.0f));
+    scene.casters.push_back(Caster(2.0f, 0.0f, 10.0f));     // +x face
+    scene.casters.push_back(Caster(-2.0f, 0.0f, 10.0f));    // -x face
+    scene.Update();
+    scene.Update();
+    CHECK(scene.cache.GetJobs().empty());
+
+    scene.casters[0] = Caster(2.0f, 0.1f, 10.0f);
+    scene.Update();
+    CHECK(scene.cache.GetJobs().size() == 1);
+    CHECK(scene.HasJob(0, 0));
+    if (scene.cache.GetJobs().size() == 1)
+    {
+        // Only the caster inside the face frustum is drawn into it
+        const ShadowRenderJob& job = scene.cache.GetJobs()[0];
+        CHECK(job.casterCount == 1);
+        CHECK(scene.cache.GetJobCasters()[job.firstCaster] == 0);
+    }
+    CHECK(scene.cache.GetStats().facesCached == 5);
+}
+
+TEST_CASE(ShadowAtlas, InvalidateAndLightChangesRedrawTheFaces)
+{
+    CacheScene scene;
+    scene.lights.push_back(Omni(1, 0.0f, 0.0f, 10.0f, 5.0f));
+    scene.lights.push_back(Spot(2, 3.0f, 0.0f, 8.0f));
+    scene.casters.push_back(Caster(2.0f, 0.0f, 10.0f));
+    scene.Update();
+    scene.Update();
+    CHECK(scene.cache.GetJobs().empty());
+
+    scene.cache.Invalidate();
+    scene.Update();
+    CHECK(scene.cache.GetJobs().size() == 7);
+
+    // Moving the spot light only redraws its own face
+    scene.lights[1].position.x = 2.5f;
+    scene.Update();
+    CHECK(scene.cache.GetJobs().size() == 1);
+    CHECK(scene.HasJob(1, 0));
+}
+
+TEST_CASE(ShadowAtlas, NewLightOverBudgetWaitsForAFrameWithRoom)
+{
+    CacheScene scene;
+    ShadowCacheSettings settings = scene.cache.GetSettings();
+    settings.maxFacesPerFrame = 4;
+    scene.cache.SetSettings(settings);
+    scene.lights.push_back(Omni(1, 0.0f, 0.0f, 10.0f, 5.0f));
+    scene.casters.push_back(Caster(2.0f, 0.0f, 10.0f));
+
+    // Six undrawn faces do not fit a budget of four: no half-drawn omni light is shown
+    scene.Update();
+    CHECK(scene.cache.GetJobs().empty());
+    CHECK(scene.cache.GetShadowIndices()[0] == -1);
+    CHECK(scene.cache.GetStats().facesDeferred == 6);
+}
+
+TEST_CASE(ShadowAtlas, FullAtlasEvictsTheLeastRecentlyUsedLight)
+{
+    CacheScene scene;
+    ShadowCacheSettings settings = scene.cache.GetSettings();
+    settings.maxTileSize = 2048;
+    scene.cache.SetSettings(settings);
+    // Large enough on screen that every spot light asks for a quarter of the atlas
+    scene.viewportHeight = 4096;
+    for (uint32_t i = 0; i < 5; i++)
+        scene.casters.push_back(Caster(static_cast<float>(i) * 2.0f - 4.0f, 0.0f, 11.0f));
+
+    std::vector<ShadowLightDesc> all;
+    for (uint32_t i = 0; i < 5; i++)
+        all.push_back(Spot(10 + i, static_cast<float>(i) * 2.0f - 4.0f, 0.0f, 10.0f));
+
+    scene.lights.assign(all.begin(), all.begin() + 3);
+    scene.Update();
+    CHECK(scene.cache.GetStats().shadowedLights == 3);
+    CHECK(scene.cache.GetAllocator().GetTileCount() == 3);
+
+    // The fourth quarter is still free, nothing is evicted
+    scene.lights.assign(1, all[3]);
+    scene.Update();
+    CHECK(scene.cache.GetStats().evictedLights == 0);
+    CHECK(scene.cache.GetAllocator().GetTileCount() == 4);
+
+    // Lights 10, 11 and 12 were last used together; the lowest id goes first
+    scene.lights.assign(1, all[4]);
+    scene.Update();
+    CHECK(scene.cache.GetStats().evictedLights == 1);
+    CHECK(scene.cache.GetStats().shadowedLights == 1);
+    CHECK(scene.cache.GetAllocator().GetTileCount() == 4);
+
+    // Light 11 kept its tile and depth, light 10 has to be drawn again
+    scene.lights.assign(1, all[1]);
+    scene.Update();
+    CHECK(scene.cache.GetJobs().empty());
+    CHECK(scene.cache.GetStats().facesCached == 1);
+
+    scene.lights.assign(1, all[0]);
+    scene.Update();
+    CHECK(scene.cache.GetJobs().size() == 1);
+    CHECK(scene.cache.GetStats().evictedLights == 1);
+}
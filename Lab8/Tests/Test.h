@@ -0,0 +1,56 @@
+#ifndef LAB8_TEST_H
+#define LAB8_TEST_H
+
+#include <cstdio>
+#include <vector>
+
+// Console test harness for the modules that build without a device. TEST_CASE registers a
+// function at static initialization; CHECK records a failure and keeps the test running so
+// one run reports every broken expectation. Lab8Tests <suite> runs one suite only.
+struct TestCase
+{
+    const char* suite;
+    const char* name;
+    void (*function)();
+};
+
+class TestRegistry
+{
+public:
+    static std::vector<TestCase>& GetCases()
+    {
+        static std::vector<TestCase> cases;
+        return cases;
+    }
+
+    static int& GetFailureCount()
+    {
+        static int failures = 0;
+        return failures;
+    }
+
+    static void Fail(const char* file, int line, const char* expression)
+    {
+        printf("  %s(%d): CHECK(%s) failed\n", file, line, expression);
+        GetFailureCount()++;
+    }
+};
+
+struct TestRegistrar
+{
+    TestRegistrar(const char* suite, const char* name, void (*function)())
+    {
+        TestCase test = { suite, name, function };
+        TestRegistry::GetCases().push_back(test);
+    }
+};
+
+#define TEST_CASE(suite, name) \
+    static void suite##_##name(); \
+    static TestRegistrar suite##_##name##_registrar(#suite, #name, &suite##_##name); \
+    static void suite##_##name()
+
+#define CHECK(expression) \
+    do { if (!(expression)) TestRegistry::Fail(__FILE__, __LINE__, #expression); } while (0)
+
+#endif
@@ -0,0 +1,26 @@
+#include "Test.h"
+#include <cstring>
+
+int main(int argc, char** argv)
+{
+    const char* suite = argc > 1 ? argv[1] : nullptr;
+    int run = 0;
+    int failed = 0;
+    for (const TestCase& test : TestRegistry::GetCases())
+    {
+        if (suite && strcmp(suite, test.suite) != 0)
+            continue;
+
+        int failuresBefore = TestRegistry::GetFailureCount();
+        test.function();
+        run++;
+        if (TestRegistry::GetFailureCount() != failuresBefore)
+        {
+            printf("FAILED %s.%s\n", test.suite, test.name);
+            failed++;
+        }
+    }
+
+    printf("%d tests, %d failed\n", run, failed);
+    return run == 0 || failed != 0 ? 1 : 0;
+}
@@ -0,0 +1,199 @@
+#include "Test.h"
+#include "BlockDecoder.h"
+#include "TextureCooker.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+    const uint32_t Size = 64;
+    const uint32_t MipCount = 7;
+    const float Pi = 3.14159265f;
+
+    struct NormalMap
+    {
+        CookImage image;
+        std::vector<float> normals;     // exact unit normals, three floats per texel
+    };
+
+    // Analytic bumps: the normals of a height field of sines, stored as RGBA8 like cube_normal.dds
+    NormalMap Bumps()
+    {
+        NormalMap map;
+        map.image.width = Size;
+        map.image.height = Size;
+        for (uint32_t y = 0; y < Size; y++)
+        {
+            for (uint32_t x = 0; x < Size; x++)
+            {
+                float u = (x + 0.5f) / Size * 2.0f * Pi;
+                float v = (y + 0.5f) / Size * 2.0f * Pi;
+                float dx = 0.6f * std::cos(2.0f * u) * std::cos(3.0f * v);
+                float dy = -0.9f * std::sin(2.0f * u) * std::sin(3.0f * v);
+                float invLength = 1.0f / std::sqrt(dx * dx + dy * dy + 1.0f);
+                float normal[3] = { -dx * invLength, -dy * invLength, invLength };
+                uint32_t texel = 0xFF000000u;
+                for (uint32_t c = 0; c < 3; c++)
+                {
+                    map.normals.push_back(normal[c]);
+                    texel |= static_cast<uint32_t>(std::lround(normal[c] * 127.5f + 127.5f)) << (c * 8);
+                }
+                map.image.texels.push_back(texel);
+            }
+        }
+        return map;
+    }
+
+    bool CookBc5(const NormalMap& map, ThreadPool* pPool, std::vector<uint8_t>& data)
+    {
+        TextureCooker cooker;
+        cooker.SetThreadPool(pPool);
+        TextureCookSettings settings = { BlockFormat::BC5, 2, true, true, MipFilter::Box, false };
+        std::vector<std::vector<CookImage>> slices(1, std::vector<CookImage>(1, map.image));
+        return cooker.Compress(slices, false, settings, data);
+    }
+
+    float AngleDegrees(const float* a, const float* b)
+    {
+        float dot = a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+        return std::acos(std::min(std::max(dot, -1.0f), 1.0f)) * (180.0f / Pi);
+    }
+
+    // Channels more than one step apart: the palettes of the two decoders may round their
+    // interpolated entries differently
+    bool TexelsDiffer(uint32_t a, uint32_t b)
+    {
+        for (uint32_t shift = 0; shift < 32; shift += 8)
+        {
+            int difference = static_cast<int>((a >> shift) & 0xFF) - static_cast<int>((b >> shift) & 0xFF);
+            if (difference > 1 || difference < -1)
+                return true;
+        }
+        return false;
+    }
+
+    uint32_t DecodedTexel(const DecodedTexture& texture, uint32_t mip, uint32_t x, uint32_t y)
+    {
+        const DecodedSubresource& subresource = texture.subresources[mip];
+        uint32_t texel;
+        std::memcpy(&texel, texture.data.data() + subresource.offset + (static_cast<size_t>(y) * subresource.width + x) * 4, 4);
+        return texel;
+    }
+}
+
+// Cooked to BC5, written as a DDS file, read back by BlockDecoder and rebuilt the way
+// ColorPixel.ps does it: the normals stay within a few degrees of the exact ones
+TEST_CASE(TextureCooker, Bc5RoundTripKeepsTheNormals)
+{
+    NormalMap map = Bumps();
+    std::vector<uint8_t> data;
+    CHECK(CookBc5(map, nullptr, data));
+    size_t blocks = 0;
+    for (uint32_t mip = 0; mip < MipCount; mip++)
+        blocks += static_cast<size_t>(std::max((Size >> mip) / 4, 1u)) * std::max((Size >> mip) / 4, 1u);
+    CHECK(data.size() == blocks * TextureCooker::GetBlockBytes(BlockFormat::BC5));
+
+    std::vector<uint8_t> file;
+    CHECK(TextureCooker::BuildFile(BlockFormat::BC5, Size, Size, MipCount, 1, false, data, file));
+    BlockDecoder decoder;
+    DecodedTexture texture;
+    CHECK(decoder.Decode(file.data(), file.size(), DecodeTarget::RGBA8, texture));
+    CHECK(texture.sourceFormat == DXGI_FORMAT_BC5_UNORM);
+    CHECK(texture.width == Size && texture.height == Size);
+    CHECK(texture.mipCount == MipCount);
+    CHECK(texture.subresources.size() == MipCount);
+    if (texture.subresources.size() != MipCount)
+        return;
+
+    double sumAngle = 0.0;
+    float maxAngle = 0.0f;
+    uint32_t wrongChannels = 0;
+    for (uint32_t y = 0; y < Size; y++)
+    {
+        for (uint32_t x = 0; x < Size; x++)
+        {
+            uint32_t texel = DecodedTexel(texture, 0, x, y);
+            // Blue 0 and alpha 1, as the GPU returns BC5
+            wrongChannels += (texel & 0xFFFF0000u) == 0xFF000000u ? 0 : 1;
+            float normal[3];
+            TextureCooker::RebuildNormal(texel, normal);
+            float angle = AngleDegrees(normal, &map.normals[(static_cast<size_t>(y) * Size + x) * 3]);
+            sumAngle += angle;
+            maxAngle = std::max(maxAngle, angle);
+        }
+    }
+    CHECK(wrongChannels == 0);
+    CHECK(sumAngle / (Size * Size) < 2.0);
+    CHECK(maxAngle < 5.0f);
+
+    // Every generated mip still decodes to unit normals pointing out of the surface
+    uint32_t flipped = 0;
+    for (uint32_t mip = 1; mip < MipCount; mip++)
+    {
+        const DecodedSubresource& subresource = texture.subresources[mip];
+        CHECK(subresource.width == std::max(Size >> mip, 1u));
+        for (uint32_t y = 0; y < subresource.height; y++)
+        {
+            for (uint32_t x = 0; x < subresource.width; x++)
+            {
+                float normal[3];
+                TextureCooker::RebuildNormal(DecodedTexel(texture, mip, x, y), normal);
+                flipped += normal[2] > 0.0f ? 0 : 1;
+            }
+        }
+    }
+    CHECK(flipped == 0);
+}
+
+// BlockDecoder, the reference DecompressBlock and the SIMD DecodeNormalBlock agree block by block
+TEST_CASE(TextureCooker, DecodersAgreeOnBc5Blocks)
+{
+    NormalMap map = Bumps();
+    std::vector<uint8_t> data;
+    CHECK(CookBc5(map, nullptr, data));
+    std::vector<uint8_t> file;
+    CHECK(TextureCooker::BuildFile(BlockFormat::BC5, Size, Size, MipCount, 1, false, data, file));
+    BlockDecoder decoder;
+    DecodedTexture texture;
+    CHECK(decoder.Decode(file.data(), file.size(), DecodeTarget::RGBA8, texture));
+    if (texture.subresources.empty())
+        return;
+
+    uint32_t texelMismatches = 0;
+    float maxNormalError = 0.0f;
+    const uint32_t blocksX = Size / 4;
+    for (uint32_t block = 0; block < blocksX * blocksX; block++)
+    {
+        const uint8_t* pBlock = data.data() + block * 16;
+        uint32_t texels[16];
+        CHECK(TextureCooker::DecompressBlock(BlockFormat::BC5, pBlock, texels));
+        float normals[3][16];
+        TextureCooker::DecodeNormalBlock(BlockFormat::BC5, pBlock, normals);
+        for (uint32_t t = 0; t < 16; t++)
+        {
+            uint32_t x = (block % blocksX) * 4 + t % 4;
+            uint32_t y = (block / blocksX) * 4 + t / 4;
+            texelMismatches += TexelsDiffer(DecodedTexel(texture, 0, x, y), texels[t]) ? 1 : 0;
+            float normal[3];
+            TextureCooker::RebuildNormal(texels[t], normal);
+            for (uint32_t c = 0; c < 3; c++)
+                maxNormalError = std::max(maxNormalError, std::fabs(normals[c][t] - normal[c]));
+        }
+    }
+    CHECK(texelMismatches == 0);
+    CHECK(maxNormalError < 1e-5f);
+}
+
+TEST_CASE(TextureCooker, OutputDoesNotDependOnTheThreadCount)
+{
+    NormalMap map = Bumps();
+    std::vector<uint8_t> serial;
+    CHECK(CookBc5(map, nullptr, serial));
+    ThreadPool pool(3);
+    std::vector<uint8_t> parallel;
+    CHECK(CookBc5(map, &pool, parallel));
+    CHECK(parallel == serial);
+}
@@ -0,0 +1,220 @@
+#include "Test.h"
+#include "DdsTestFiles.h"
+#include "TexturePacker.h"
+#include "ThreadPool.h"
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+    const uint32_t ChunkBytes = 4096;
+
+    TexturePackSettings Settings(uint32_t chunkBytes = ChunkBytes)
+    {
+        TexturePackSettings settings = TexturePacker::GetDefaultSettings();
+        settings.chunkBytes = chunkBytes;
+        return settings;
+    }
+
+    uint32_t Next(uint32_t& seed)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        return seed >> 8;
+    }
+
+    // Pixel data that does not compress at all
+    std::vector<uint8_t> RandomDds(const DdsTestDesc& desc, uint32_t seed)
+    {
+        std::vector<uint8_t> file = BuildDds(desc, 0);
+        for (size_t i = DirectX::DDSLayout::DDS_DX10_HEADER_SIZE; i < file.size(); i++)
+            file[i] = static_cast<uint8_t>(Next(seed));
+        return file;
+    }
+
+    // BC1 blocks with random indices whose endpoints change every 64 blocks: in a row the
+    // colours never repeat for long enough to match, in byte planes they are long runs
+    std::vector<uint8_t> BlockDds(uint32_t seed)
+    {
+        std::vector<uint8_t> file = BuildDds(DdsDesc(128, 128, 8, 1, DXGI_FORMAT_BC1_UNORM), 0);
+        uint32_t colours = 0;
+        for (size_t i = DirectX::DDSLayout::DDS_DX10_HEADER_SIZE; i + 8 <= file.size(); i += 8)
+        {
+            if ((i - DirectX::DDSLayout::DDS_DX10_HEADER_SIZE) % (64 * 8) == 0)
+                colours = Next(seed) ^ (Next(seed) << 16);
+            uint32_t indices = Next(seed) ^ (Next(seed) << 16);
+            std::memcpy(&file[i], &colours, 4);
+            std::memcpy(&file[i + 4], &indices, 4);
+        }
+        return file;
+    }
+
+    struct PackedFile
+    {
+        TexturePackHeader header;
+        std::vector<uint32_t> chunks;
+        size_t firstChunk;      // offset of the chunk data, after the table and the DDS headers
+    };
+
+    PackedFile Parse(const std::vector<uint8_t>& packed)
+    {
+        PackedFile file;
+        std::memcpy(&file.header, packed.data(), sizeof(file.header));
+        file.chunks.resize(file.header.chunkCount);
+        std::memcpy(file.chunks.data(), packed.data() + sizeof(file.header), file.chunks.size() * sizeof(uint32_t));
+        file.firstChunk = sizeof(file.header) + file.chunks.size() * sizeof(uint32_t) + file.header.headerBytes;
+        return file;
+    }
+
+    void SetChunkEntry(std::vector<uint8_t>& packed, uint32_t chunk, uint32_t entry)
+    {
+        std::memcpy(packed.data() + sizeof(TexturePackHeader) + chunk * sizeof(uint32_t), &entry, sizeof(entry));
+    }
+
+    bool Unpacks(const std::vector<uint8_t>& packed)
+    {
+        TexturePacker packer;
+        std::vector<uint8_t> dds;
+        return packer.Unpack(packed.data(), packed.size(), dds);
+    }
+}
+
+TEST_CASE(TexturePacker, RoundTripRestoresTheFile)
+{
+    // A smooth ramp that compresses, blocks that compress shuffled, noise that is stored
+    std::vector<std::vector<uint8_t>> files;
+    files.push_back(BuildDds(DdsDesc(64, 64, 7, 2), 3));
+    files.push_back(BlockDds(5));
+    files.push_back(RandomDds(DdsDesc(64, 32, 1), 7));
+
+    TexturePacker packer;
+    std::vector<TexturePackStats> stats;
+    for (const std::vector<uint8_t>& dds : files)
+    {
+        std::vector<uint8_t> packed;
+        CHECK(packer.Pack(dds.data(), dds.size(), Settings(), packed));
+        stats.push_back(packer.GetStats());
+        CHECK(TexturePacker::IsPacked(packed.data(), packed.size()));
+        CHECK(!TexturePacker::IsPacked(dds.data(), dds.size()));
+        CHECK(TexturePacker::GetUnpackedSize(packed.data(), packed.size()) == dds.size());
+
+        // The payload is not a whole number of chunks, the last one is shorter
+        PackedFile file = Parse(packed);
+        CHECK(file.header.headerBytes == DirectX::DDSLayout::DDS_DX10_HEADER_SIZE);
+        CHECK(file.header.chunkCount == (dds.size() - file.header.headerBytes + ChunkBytes - 1) / ChunkBytes);
+
+        std::vector<uint8_t> unpacked;
+        CHECK(packer.Unpack(packed.data(), packed.size(), unpacked));
+        CHECK(unpacked == dds);
+    }
+    CHECK(stats[0].packedBytes * 4 < stats[0].rawBytes);
+    CHECK(stats[0].storedChunks == 0);
+    CHECK(stats[1].shuffledChunks == stats[1].chunks);
+    CHECK(stats[1].packedBytes < stats[1].rawBytes);
+    CHECK(stats[2].storedChunks == stats[2].chunks);
+}
+
+TEST_CASE(TexturePacker, OutputDoesNotDependOnTheThreadCount)
+{
+    std::vector<uint8_t> dds = BlockDds(11);
+    TexturePacker serial;
+    std::vector<uint8_t> serialPacked;
+    CHECK(serial.Pack(dds.data(), dds.size(), Settings(), serialPacked));
+
+    ThreadPool pool(3);
+    TexturePacker parallel;
+    parallel.SetThreadPool(&pool);
+    std::vector<uint8_t> parallelPacked;
+    CHECK(parallel.Pack(dds.data(), dds.size(), Settings(), parallelPacked));
+    CHECK(parallelPacked == serialPacked);
+
+    std::vector<uint8_t> unpacked;
+    CHECK(parallel.Unpack(parallelPacked.data(), parallelPacked.size(), unpacked));
+    CHECK(unpacked == dds);
+    CHECK(parallel.GetStats().threads == 4);
+}
+
+TEST_CASE(TexturePacker, PackRejectsBadInput)
+{
+    TexturePacker packer;
+    std::vector<uint8_t> packed;
+    std::vector<uint8_t> dds = BuildDds(DdsDesc(16, 16, 1), 0);
+    CHECK(!packer.Pack(dds.data(), dds.size(), Settings(0), packed));
+    CHECK(!packer.Pack(dds.data(), dds.size(), Settings(65536 + 4), packed));
+    dds.assign(256, 0x55);
+    CHECK(!packer.Pack(dds.data(), dds.size(), Settings(), packed));
+}
+
+// Every cut of the file fails: in the header, the chunk table, the DDS headers and the chunks
+TEST_CASE(TexturePacker, TruncatedFilesAreRejected)
+{
+    std::vector<uint8_t> dds = BuildDds(DdsDesc(64, 64, 7), 1);
+    TexturePacker packer;
+    std::vector<uint8_t> packed;
+    CHECK(packer.Pack(dds.data(), dds.size(), Settings(), packed));
+    PackedFile file = Parse(packed);
+
+    const size_t cuts[] = { 0, sizeof(TexturePackHeader) - 1, sizeof(TexturePackHeader) + 2, file.firstChunk - 1,
+        file.firstChunk, file.firstChunk + (file.chunks[0] & 0x3FFFFFFFu) / 2, packed.size() - 1 };
+    uint32_t accepted = 0;
+    for (size_t cut : cuts)
+        accepted += Unpacks(std::vector<uint8_t>(packed.begin(), packed.begin() + cut)) ? 1 : 0;
+    CHECK(accepted == 0);
+
+    // Trailing bytes are not part of any chunk
+    std::vector<uint8_t> longer = packed;
+    longer.push_back(0);
+    CHECK(!Unpacks(longer));
+
+    // The raw overload needs the exact size
+    std::vector<uint8_t> out(dds.size() - 1);
+    CHECK(!packer.Unpack(packed.data(), packed.size(), out.data(), out.size()));
+    CHECK(Unpacks(packed));
+}
+
+TEST_CASE(TexturePacker, CorruptHeadersAndChunksAreRejected)
+{
+    std::vector<uint8_t> dds = BuildDds(DdsDesc(64, 64, 7), 1);
+    TexturePacker packer;
+    std::vector<uint8_t> packed;
+    CHECK(packer.Pack(dds.data(), dds.size(), Settings(), packed));
+    PackedFile file = Parse(packed);
+    CHECK(file.chunks.size() > 2);
+    CHECK((file.chunks[0] >> 30) != 0);
+
+    // Header fields: magic, version, chunk size, and a chunk count that does not fit the payload
+    const size_t fields[] = { offsetof(TexturePackHeader, magic), offsetof(TexturePackHeader, version),
+        offsetof(TexturePackHeader, chunkBytes), offsetof(TexturePackHeader, chunkCount), offsetof(TexturePackHeader, stride) };
+    for (size_t field : fields)
+    {
+        std::vector<uint8_t> broken = packed;
+        uint32_t value = field == offsetof(TexturePackHeader, stride) ? 0 : 0x12345;
+        std::memcpy(broken.data() + field, &value, sizeof(value));
+        CHECK(!TexturePacker::IsPacked(broken.data(), broken.size()));
+        CHECK(!Unpacks(broken));
+    }
+
+    // An unknown chunk mode
+    std::vector<uint8_t> broken = packed;
+    SetChunkEntry(broken, 1, file.chunks[1] | 0xC0000000u);
+    CHECK(!Unpacks(broken));
+
+    // A stored chunk must hold the whole chunk
+    broken = packed;
+    SetChunkEntry(broken, 1, file.chunks[1] & 0x3FFFFFFFu);
+    CHECK(!Unpacks(broken));
+
+    // A chunk that reaches past the end of the file
+    broken = packed;
+    SetChunkEntry(broken, 1, file.chunks[1] + static_cast<uint32_t>(packed.size()));
+    CHECK(!Unpacks(broken));
+
+    // The last byte of a compressed chunk missing, the table still consistent: the last literal
+    // run comes up short, so the chunk cannot fill its part of the payload
+    broken = packed;
+    size_t chunkEnd = file.firstChunk + (file.chunks[0] & 0x3FFFFFFFu);
+    broken.erase(broken.begin() + chunkEnd - 1);
+    SetChunkEntry(broken, 0, file.chunks[0] - 1);
+    CHECK(TexturePacker::IsPacked(broken.data(), broken.size()));
+    CHECK(!Unpacks(broken));
+}
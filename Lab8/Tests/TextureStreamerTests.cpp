@@ -0,0 +1,408 @@
+#include "Test.h"
+#include "DdsTestFiles.h"
+#include "TextureStreamer.h"
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    // Null device that also remembers the order of the calls
+    class RecordingDevice : public NullTextureStreamDevice
+    {
+    public:
+        struct Upload
+        {
+            StreamedTexture texture;
+            uint32_t mip;
+            uint64_t bytes;
+        };
+
+        bool CreateTexture(StreamedTexture texture, const StreamTextureDesc& desc, uint32_t firstMip) override
+        {
+            created.push_back(texture);
+            return NullTextureStreamDevice::CreateTexture(texture, desc, firstMip);
+        }
+
+        void UploadRows(StreamedTexture texture, uint32_t mip, uint32_t slice, uint32_t firstRow, uint32_t rowCount,
+            const uint8_t* pData, uint32_t rowPitch) override
+        {
+            Upload upload = { texture, mip, static_cast<uint64_t>(rowCount) * rowPitch };
+            uploads.push_back(upload);
+            NullTextureStreamDevice::UploadRows(texture, mip, slice, firstRow, rowCount, pData, rowPitch);
+        }
+
+        std::vector<StreamedTexture> created;
+        std::vector<Upload> uploads;
+    };
+
+    TextureStreamSettings Settings(uint64_t frameBudgetBytes, uint64_t memoryBudgetBytes = 0)
+    {
+        TextureStreamSettings settings = { 1, frameBudgetBytes, 1024, memoryBudgetBytes, 1 };
+        return settings;
+    }
+
+    // Updates until done holds, false if it does not within ten seconds
+    bool UpdateUntil(TextureStreamer& streamer, const std::function<bool()>& done)
+    {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (!done())
+        {
+            if (std::chrono::steady_clock::now() > deadline)
+                return false;
+            streamer.Update();
+            std::this_thread::yield();
+        }
+        return true;
+    }
+
+    bool IsQueued(const TextureStreamer& streamer, StreamedTexture texture)
+    {
+        return streamer.GetInfo(texture).state == StreamState::Queued;
+    }
+
+    // The streamer, the sum over its textures and the device agree on the allocated bytes
+    bool AccountingMatches(const TextureStreamer& streamer, const NullTextureStreamDevice& device,
+        const std::vector<StreamedTexture>& textures)
+    {
+        uint64_t counted = 0;
+        for (StreamedTexture texture : textures)
+            counted += streamer.GetInfo(texture).gpuBytes;
+        return counted == streamer.GetStats().gpuBytes && counted == device.GetAllocatedBytes();
+    }
+
+    // 128x128 RGBA with 8 mips, all of them resident without a memory budget
+    struct ResidentSet
+    {
+        std::vector<std::unique_ptr<DdsTestFile>> files;
+        std::vector<StreamedTexture> textures;
+        RecordingDevice device;
+        TextureStreamer streamer;
+
+        ResidentSet(const char* name, uint32_t count, uint32_t protectFrames)
+        {
+            TextureStreamSettings settings = Settings(1 << 20);
+            settings.protectFrames = protectFrames;
+            streamer.Init(&device, settings);
+            for (uint32_t i = 0; i < count; i++)
+            {
+                std::string path = std::string(name) + std::to_string(i) + ".dds";
+                files.emplace_back(new DdsTestFile(path, DdsDesc(128, 128, 8), static_cast<uint8_t>(i)));
+                textures.push_back(streamer.Request(path.c_str()));
+            }
+            CHECK(UpdateUntil(streamer, [this]() { return streamer.IsIdle(); }));
+        }
+
+        uint32_t AllocatedMip(uint32_t index) const { return streamer.GetInfo(textures[index]).allocatedMip; }
+    };
+
+    const uint64_t TextureBytes = 87380;
+}
+
+// 128x128 RGBA with 8 mips: 8x8 and coarser is 340 bytes and fits the 1024 byte placeholder
+TEST_CASE(TextureStreamer, PlaceholderIsUploadedAtOnceOutsideTheBudget)
+{
+    DdsTestFile file("streamer_placeholder.dds", DdsDesc(128, 128, 8));
+    CHECK(file.IsWritten());
+
+    RecordingDevice device;
+    TextureStreamer streamer;
+    streamer.Init(&device, Settings(512));
+    StreamedTexture texture = streamer.Request(file.GetPath().c_str());
+    CHECK(UpdateUntil(streamer, [&]() { return !IsQueued(streamer, texture); }));
+
+    // The same Update spent one 512 byte band of mip 3 on top of it
+    StreamTextureInfo info = streamer.GetInfo(texture);
+    CHECK(info.state == StreamState::Streaming);
+    CHECK(info.residentMip == 4);
+    CHECK(device.GetMostDetailedMip(texture) == 4);
+    CHECK(streamer.GetStats().lastPlaceholderBytes == 340);
+    CHECK(streamer.GetStats().lastFrameBytes == 512);
+    CHECK(device.GetErrorCount() == 0);
+}
+
+TEST_CASE(TextureStreamer, UploadsStayWithinTheFrameBudget)
+{
+    DdsTestFile first("streamer_budget0.dds", DdsDesc(256, 256, 9), 1);
+    DdsTestFile second("streamer_budget1.dds", DdsDesc(256, 128, 9, 2), 2);
+
+    RecordingDevice device;
+    TextureStreamer streamer;
+    const uint64_t budget = 3000;
+    streamer.Init(&device, Settings(budget));
+    StreamedTexture a = streamer.Request(first.GetPath().c_str());
+    StreamedTexture b = streamer.Request(second.GetPath().c_str());
+
+    uint32_t overBudget = 0;
+    CHECK(UpdateUntil(streamer, [&]()
+    {
+        overBudget += streamer.GetStats().lastFrameBytes > budget ? 1 : 0;
+        return streamer.IsIdle();
+    }));
+
+    CHECK(overBudget == 0);
+    CHECK(streamer.GetStats().maxFrameBytes <= budget);
+    CHECK(streamer.GetInfo(a).state == StreamState::Resident);
+    CHECK(streamer.GetInfo(b).state == StreamState::Resident);
+    CHECK(device.GetMostDetailedMip(a) == 0 && device.GetMostDetailedMip(b) == 0);
+    uint64_t bytes = streamer.GetInfo(a).bytes + streamer.GetInfo(b).bytes;
+    CHECK(device.GetBytesUploaded() == bytes);
+    CHECK(streamer.GetStats().bytesUploaded == bytes);
+    CHECK(streamer.GetStats().cpuBytes == 0);
+    CHECK(device.GetErrorCount() == 0);
+}
+
+// A 256 byte row of mip 0 is wider than the whole budget: it goes alone, one row per Update
+TEST_CASE(TextureStreamer, RowWiderThanTheBudgetStillGoesThrough)
+{
+    DdsTestFile file("streamer_wide.dds", DdsDesc(64, 64, 7));
+
+    RecordingDevice device;
+    TextureStreamer streamer;
+    streamer.Init(&device, Settings(16));
+    StreamedTexture texture = streamer.Request(file.GetPath().c_str());
+    CHECK(UpdateUntil(streamer, [&]() { return streamer.IsIdle(); }));
+
+    CHECK(streamer.GetInfo(texture).state == StreamState::Resident);
+    CHECK(streamer.GetStats().maxFrameBytes == 256);
+    uint32_t mip0Uploads = 0;
+    for (const RecordingDevice::Upload& upload : device.uploads)
+    {
+        if (upload.mip == 0)
+        {
+            mip0Uploads++;
+            CHECK(upload.bytes == 256);
+        }
+    }
+    CHECK(mip0Uploads == 64);
+    CHECK(device.GetErrorCount() == 0);
+}
+
+TEST_CASE(TextureStreamer, HigherPriorityTextureUploadsFirst)
+{
+    DdsTestFile low("streamer_low.dds", DdsDesc(128, 128, 8), 3);
+    DdsTestFile high("streamer_high.dds", DdsDesc(128, 128, 8), 4);
+
+    RecordingDevice device;
+    TextureStreamer streamer;
+    streamer.Init(&device, Settings(64));
+    StreamedTexture a = streamer.Request(low.GetPath().c_str(), 0);
+    StreamedTexture b = streamer.Request(high.GetPath().c_str(), 5);
+
+    // Whatever went up while only one of them was read does not count
+    CHECK(UpdateUntil(streamer, [&]() { return !IsQueued(streamer, a) && !IsQueued(streamer, b); }));
+    device.uploads.clear();
+    CHECK(UpdateUntil(streamer, [&]() { return streamer.IsIdle(); }));
+
+    size_t lastHigh = 0;
+    size_t firstLow = device.uploads.size();
+    for (size_t i = 0; i < device.uploads.size(); i++)
+    {
+        if (device.uploads[i].texture == b)
+            lastHigh = i;
+        else if (firstLow == device.uploads.size())
+            firstLow = i;
+    }
+    CHECK(lastHigh < firstLow);
+    CHECK(streamer.GetInfo(a).state == StreamState::Resident);
+    CHECK(streamer.GetInfo(b).state == StreamState::Resident);
+    CHECK(device.GetErrorCount() == 0);
+}
+
+// One I/O thread: a request queued behind others is read before them if it has a higher priority.
+// The first low request may already be in I/O, the rest are still waiting.
+TEST_CASE(TextureStreamer, IoQueueReadsTheHighestPriorityFirst)
+{
+    std::vector<std::unique_ptr<DdsTestFile>> files;
+    for (uint32_t i = 0; i < 9; i++)
+    {
+        std::string path = "streamer_io" + std::to_string(i) + ".dds";
+        files.emplace_back(new DdsTestFile(path, DdsDesc(512, 512, 10), static_cast<uint8_t>(i)));
+    }
+
+    RecordingDevice device;
+    TextureStreamer streamer;
+    streamer.Init(&device, Settings(1 << 20));
+    std::vector<StreamedTexture> lows;
+    for (uint32_t i = 0; i < 8; i++)
+        lows.push_back(streamer.Request(files[i]->GetPath().c_str(), 0));
+    StreamedTexture high = streamer.Request(files[8]->GetPath().c_str(), 1);
+    CHECK(UpdateUntil(streamer, [&]() { return streamer.IsIdle(); }));
+
+    CHECK(device.created.size() == 9);
+    auto position = [&](StreamedTexture texture)
+    {
+        return std::find(device.created.begin(), device.created.end(), texture) - device.created.begin();
+    };
+    CHECK(position(high) < position(lows.back()));
+    // Equal priorities keep the request order
+    for (size_t i = 2; i < lows.size(); i++)
+        CHECK(position(lows[i - 1]) < position(lows[i]));
+    CHECK(device.GetErrorCount() == 0);
+}
+
+TEST_CASE(TextureStreamer, MissingFileFails)
+{
+    RecordingDevice device;
+    TextureStreamer streamer;
+    streamer.Init(&device, Settings(4096));
+    StreamedTexture texture = streamer.Request("streamer_missing.dds");
+    CHECK(UpdateUntil(streamer, [&]() { return !IsQueued(streamer, texture); }));
+
+    CHECK(streamer.GetInfo(texture).state == StreamState::Failed);
+    CHECK(device.created.empty());
+    CHECK(streamer.IsIdle());
+}
+
+TEST_CASE(TextureStreamer, LeastRecentlyTouchedTextureIsDowngradedFirst)
+{
+    ResidentSet set("streamer_lru", 3, 1);
+    CHECK(set.streamer.GetInfo(set.textures[0]).bytes == TextureBytes);
+
+    // Texture 0 was last touched before 1, 2 is touched every frame
+    for (uint32_t frame = 0; frame < 6; frame++)
+    {
+        if (frame == 0)
+            set.streamer.Touch(set.textures[0]);
+        if (frame < 3)
+            set.streamer.Touch(set.textures[1]);
+        set.streamer.Touch(set.textures[2]);
+        set.streamer.Update();
+    }
+
+    uint64_t budget = 3 * TextureBytes - 1000;
+    set.streamer.SetMemoryBudget(budget);
+    set.streamer.Touch(set.textures[2]);
+    set.streamer.Update();
+
+    CHECK(set.AllocatedMip(0) == 1 && set.AllocatedMip(1) == 0 && set.AllocatedMip(2) == 0);
+    CHECK(set.streamer.GetInfo(set.textures[0]).state == StreamState::Downgraded);
+    CHECK(set.streamer.GetInfo(set.textures[1]).state == StreamState::Resident);
+    CHECK(set.streamer.GetStats().evictedMips == 1);
+    CHECK(set.streamer.GetStats().evictedBytes == set.streamer.GetMipBytes(set.textures[0], 0));
+    CHECK(set.streamer.GetStats().gpuBytes <= budget);
+    CHECK(set.device.GetMostDetailedMip(set.textures[0]) == 1);
+    CHECK(AccountingMatches(set.streamer, set.device, set.textures));
+
+    // The stalest texture goes down to its 340 byte placeholder before the next one loses a mip
+    budget = 2 * TextureBytes + 340 - 100;
+    set.streamer.SetMemoryBudget(budget);
+    set.streamer.Touch(set.textures[2]);
+    set.streamer.Update();
+
+    CHECK(set.AllocatedMip(0) == 4 && set.AllocatedMip(1) == 1 && set.AllocatedMip(2) == 0);
+    CHECK(set.streamer.GetStats().evictedMips == 5);
+    CHECK(set.streamer.GetStats().evictedBytes == 2 * TextureBytes - 2 * 340 - (TextureBytes - 340 - 65536));
+    CHECK(set.streamer.GetStats().gpuBytes <= budget);
+    CHECK(AccountingMatches(set.streamer, set.device, set.textures));
+
+    // Nothing is below the placeholder, whatever the budget
+    set.streamer.SetMemoryBudget(1);
+    set.streamer.Touch(set.textures[2]);
+    set.streamer.Update();
+    CHECK(set.AllocatedMip(0) == 4 && set.AllocatedMip(1) == 4 && set.AllocatedMip(2) == 0);
+    CHECK(set.device.GetErrorCount() == 0);
+}
+
+// protectFrames 3: a texture keeps its mips for the Update after its last Touch and two more
+TEST_CASE(TextureStreamer, ProtectedTexturesKeepTheirMipsOverBudget)
+{
+    ResidentSet set("streamer_protect", 2, 3);
+    uint64_t budget = TextureBytes + 1000;
+    set.streamer.SetMemoryBudget(budget);
+
+    for (uint32_t frame = 0; frame < 4; frame++)
+    {
+        set.streamer.Touch(set.textures[0]);
+        set.streamer.Touch(set.textures[1]);
+        set.streamer.Update();
+    }
+    CHECK(set.AllocatedMip(0) == 0 && set.AllocatedMip(1) == 0);
+    CHECK(set.streamer.GetStats().gpuBytes > budget);
+    CHECK(set.streamer.GetStats().evictedMips == 0);
+
+    for (uint32_t frame = 0; frame < 2; frame++)
+    {
+        set.streamer.Touch(set.textures[0]);
+        set.streamer.Update();
+    }
+    CHECK(set.AllocatedMip(1) == 0);
+
+    set.streamer.Touch(set.textures[0]);
+    set.streamer.Update();
+    CHECK(set.AllocatedMip(0) == 0);
+    CHECK(set.AllocatedMip(1) > 0);
+    CHECK(set.streamer.GetStats().gpuBytes <= budget);
+    CHECK(AccountingMatches(set.streamer, set.device, set.textures));
+    CHECK(set.device.GetErrorCount() == 0);
+}
+
+// Mips finer than the wanted one go before those of a stale texture, even while protected
+TEST_CASE(TextureStreamer, UnwantedMipsAreEvictedBeforeStaleTextures)
+{
+    ResidentSet set("streamer_wanted", 2, 1);
+    set.streamer.Touch(set.textures[0], 2);
+    set.streamer.Update();
+
+    set.streamer.SetMemoryBudget(2 * TextureBytes - 1000);
+    set.streamer.Touch(set.textures[0], 2);
+    set.streamer.Update();
+
+    CHECK(set.AllocatedMip(0) == 1 && set.AllocatedMip(1) == 0);
+    CHECK(set.streamer.GetInfo(set.textures[0]).wantedMip == 2);
+    CHECK(AccountingMatches(set.streamer, set.device, set.textures));
+    CHECK(set.device.GetErrorCount() == 0);
+}
+
+TEST_CASE(TextureStreamer, TouchReloadsADowngradedTexture)
+{
+    ResidentSet set("streamer_reload", 2, 1);
+    for (uint32_t frame = 0; frame < 3; frame++)
+    {
+        set.streamer.Touch(set.textures[1]);
+        set.streamer.Update();
+    }
+    set.streamer.SetMemoryBudget(TextureBytes + 340);
+    set.streamer.Touch(set.textures[1]);
+    set.streamer.Update();
+    CHECK(set.AllocatedMip(0) == 4);
+    uint64_t bytesRead = set.streamer.GetStats().bytesRead;
+
+    // No room while the other texture is protected: the Touch does not read the file again
+    set.streamer.Touch(set.textures[0]);
+    set.streamer.Touch(set.textures[1]);
+    set.streamer.Update();
+    CHECK(set.streamer.GetStats().reloads == 0);
+
+    set.streamer.SetMemoryBudget(0);
+    set.streamer.Touch(set.textures[0]);
+    CHECK(UpdateUntil(set.streamer, [&]()
+    {
+        return set.streamer.GetInfo(set.textures[0]).state == StreamState::Resident && set.streamer.IsIdle();
+    }));
+
+    CHECK(set.streamer.GetStats().reloads == 1);
+    CHECK(set.streamer.GetStats().bytesRead > bytesRead);
+    CHECK(set.device.GetMostDetailedMip(set.textures[0]) == 0);
+    CHECK(set.streamer.GetStats().cpuBytes == 0);
+    CHECK(AccountingMatches(set.streamer, set.device, set.textures));
+    CHECK(set.device.GetErrorCount() == 0);
+}
+
+TEST_CASE(TextureStreamer, ResidencyBenchmarkKeepsTheHotSetAndTheBooks)
+{
+    DdsTestFile first("streamer_hot0.dds", DdsDesc(256, 256, 9), 5);
+    DdsTestFile second("streamer_hot1.dds", DdsDesc(256, 256, 9), 6);
+    std::vector<std::string> paths = { first.GetPath(), second.GetPath() };
+
+    TextureResidencyBenchmarkResult result = TextureStreamer::BenchmarkResidency(paths, 8, 4, 0.75f, 300);
+    CHECK(result.textures == 16);
+    CHECK(result.evictedMips > 0);
+    CHECK(result.hotDowngrades == 0);
+    CHECK(result.hotResidentFrames > 0);
+    CHECK(result.accountingErrors == 0);
+    CHECK(result.deviceErrors == 0);
+}
@@ -0,0 +1,141 @@
+#include "Test.h"
+#include "ThreadPool.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+TEST_CASE(ThreadPool, EveryIndexRunsOnce)
+{
+    ThreadPool pool(3);
+    std::vector<std::atomic<uint32_t>> runs(1000);
+    for (auto& run : runs)
+        run.store(0);
+
+    std::atomic<uint32_t> badThread(0);
+    pool.ParallelFor(static_cast<uint32_t>(runs.size()), [&](uint32_t index, uint32_t threadIndex)
+    {
+        runs[index]++;
+        if (threadIndex >= pool.GetThreadCount())
+            badThread++;
+    });
+
+    uint32_t wrong = 0;
+    for (auto& run : runs)
+    {
+        if (run.load() != 1)
+            wrong++;
+    }
+    CHECK(wrong == 0);
+    CHECK(badThread.load() == 0);
+}
+
+TEST_CASE(ThreadPool, NestedCallsRunOnTheCurrentThread)
+{
+    ThreadPool pool(2);
+    std::atomic<uint32_t> inner(0);
+    std::atomic<uint32_t> foreign(0);
+    pool.ParallelFor(8, [&](uint32_t, uint32_t outerThread)
+    {
+        pool.ParallelFor(4, [&](uint32_t, uint32_t innerThread)
+        {
+            inner++;
+            if (innerThread != outerThread)
+                foreign++;
+        });
+    });
+    CHECK(inner.load() == 32);
+    CHECK(foreign.load() == 0);
+}
+
+// A bake holding every worker must not keep the frame's ParallelFor from returning
+TEST_CASE(ThreadPool, FrameCallIsNotSerializedBehindABake)
+{
+    ThreadPool pool(2);
+    std::atomic<bool> release(false);
+    std::atomic<uint32_t> started(0);
+    std::thread baker([&]()
+    {
+        ThreadPool::SetThreadPriority(ThreadPool::Priority::Background);
+        pool.ParallelFor(3, [&](uint32_t, uint32_t)
+        {
+            started++;
+            while (!release.load())
+                std::this_thread::yield();
+        });
+    });
+
+    // The baker thread and both workers are stuck inside the bake
+    while (started.load() < 3)
+        std::this_thread::yield();
+
+    std::atomic<uint32_t> frameRuns(0);
+    pool.ParallelFor(100, [&](uint32_t, uint32_t) { frameRuns++; });
+    CHECK(frameRuns.load() == 100);
+    CHECK(started.load() == 3);
+
+    release.store(true);
+    baker.join();
+}
+
+TEST_CASE(ThreadPool, WorkersLeaveABakeForFrameWork)
+{
+    ThreadPool pool(2);
+    std::atomic<bool> stop(false);
+    std::atomic<uint32_t> bakeRuns(0);
+    std::thread baker([&]()
+    {
+        ThreadPool::SetThreadPriority(ThreadPool::Priority::Background);
+        while (!stop.load())
+        {
+            pool.ParallelFor(64, [&](uint32_t, uint32_t)
+            {
+                bakeRuns++;
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+            });
+        }
+    });
+
+    while (bakeRuns.load() < 16)
+        std::this_thread::yield();
+
+    // Long enough per index that the caller alone cannot finish before a worker joins in
+    std::atomic<uint32_t> workerRuns(0);
+    pool.ParallelFor(32, [&](uint32_t, uint32_t threadIndex)
+    {
+        if (threadIndex != 0)
+            workerRuns++;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    });
+
+    stop.store(true);
+    baker.join();
+    CHECK(workerRuns.load() > 0);
+}
+
+TEST_CASE(ThreadPool, ConcurrentCallsFromManyThreads)
+{
+    ThreadPool pool(3);
+    const uint32_t callerCount = 4;
+    const uint32_t callsPerCaller = 200;
+    std::atomic<uint32_t> total(0);
+    std::vector<std::thread> callers;
+    for (uint32_t c = 0; c < callerCount; c++)
+    {
+        callers.emplace_back([&pool, &total, c]()
+        {
+            if (c % 2 == 1)
+                ThreadPool::SetThreadPriority(ThreadPool::Priority::Background);
+            for (uint32_t call = 0; call < callsPerCaller; call++)
+            {
+                std::atomic<uint32_t> runs(0);
+                pool.ParallelFor(17, [&runs](uint32_t, uint32_t) { runs++; });
+                // Every index of this call ran before it returned
+                total += runs.load() == 17 ? 1 : 0;
+            }
+        });
+    }
+    for (auto& caller : callers)
+        caller.join();
+    CHECK(total.load() == callerCount * callsPerCaller);
+}